@@ -94,6 +94,107 @@ ProtobufCAllocator protobuf_c_system_allocator =
   NULL
 };
 
+/* === arena allocator === */
+struct _ProtobufCArenaChunk
+{
+  ProtobufCArenaChunk *next;
+  size_t size;
+  size_t used;
+};
+
+#define ARENA_ALIGNMENT         16
+#define ARENA_ALIGN(size)       (((size) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+#define ARENA_CHUNK_HEADER_SIZE ARENA_ALIGN (sizeof (ProtobufCArenaChunk))
+#define ARENA_MIN_CHUNK_SIZE    4096
+
+static ProtobufCArenaChunk *arena_chunk_new (size_t size)
+{
+  ProtobufCArenaChunk *chunk = malloc (ARENA_CHUNK_HEADER_SIZE + size);
+  if (chunk == NULL)
+    {
+      protobuf_c_out_of_memory ();
+      return NULL;
+    }
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  return chunk;
+}
+
+static void *arena_alloc (void *allocator_data, size_t size)
+{
+  ProtobufCArena *arena = allocator_data;
+  ProtobufCArenaChunk *chunk = arena->chunks;
+  void *rv;
+  if (size == 0)
+    return NULL;
+  size = ARENA_ALIGN (size);
+
+  if (chunk == NULL || chunk->size - chunk->used < size)
+    {
+      if (size > arena->chunk_size && chunk != NULL)
+        {
+          /* Oversized: give it a chunk of its own, behind the current one */
+          ProtobufCArenaChunk *big = arena_chunk_new (size);
+          if (big == NULL)
+            return NULL;
+          big->used = size;
+          big->next = chunk->next;
+          chunk->next = big;
+          return (uint8_t *) big + ARENA_CHUNK_HEADER_SIZE;
+        }
+
+      /* Start a new chunk; each is twice the size of the last */
+      chunk = arena_chunk_new (size > arena->chunk_size ? size : arena->chunk_size);
+      if (chunk == NULL)
+        return NULL;
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+      arena->chunk_size *= 2;
+    }
+
+  rv = (uint8_t *) chunk + ARENA_CHUNK_HEADER_SIZE + chunk->used;
+  chunk->used += size;
+  return rv;
+}
+
+static void arena_free (void *allocator_data, void *data)
+{
+  /* released by protobuf_c_arena_destroy() */
+  (void) allocator_data;
+  (void) data;
+}
+
+void
+protobuf_c_arena_init (ProtobufCArena *arena,
+                       size_t          input_len)
+{
+  arena->allocator.alloc = arena_alloc;
+  arena->allocator.free = arena_free;
+  arena->allocator.tmp_alloc = NULL;
+  arena->allocator.max_alloca = 8192;
+  arena->allocator.allocator_data = arena;
+  arena->chunks = NULL;
+
+  /* The first chunk is allocated on demand */
+  arena->chunk_size = input_len * PROTOBUF_C_ARENA_EXPANSION;
+  if (arena->chunk_size < ARENA_MIN_CHUNK_SIZE)
+    arena->chunk_size = ARENA_MIN_CHUNK_SIZE;
+}
+
+void
+protobuf_c_arena_destroy (ProtobufCArena *arena)
+{
+  ProtobufCArenaChunk *chunk = arena->chunks;
+  while (chunk != NULL)
+    {
+      ProtobufCArenaChunk *next = chunk->next;
+      free (chunk);
+      chunk = next;
+    }
+  arena->chunks = NULL;
+}
+
 /* === buffer-simple === */
 void
 protobuf_c_buffer_simple_append (ProtobufCBuffer *buffer,
@@ -993,7 +1094,8 @@ scan_length_prefixed_data (size_t len, const uint8_t *data, size_t *prefix_len_o
     }
   hdr_len = i + 1;
   *prefix_len_out = hdr_len;
-  if (hdr_len + val > len)
+  // plcrash - 10/18/2026 (avoid overflow of hdr_len + val when checking the length)
+  if (val > len - hdr_len)
     {
       UNPACK_ERROR (("data too short after length-prefix of %u",
                      val));
@@ -1181,7 +1283,8 @@ parse_required_member (ScannedMember *scanned_member,
         const ProtobufCBinaryData *def_bd;
         unsigned pref_len = scanned_member->length_prefix_len;
         def_bd = scanned_member->field->default_value;
-        if (maybe_clear && bd->data != NULL && bd->data != def_bd->data)
+        // plcrash - 10/18/2026 (bytes fields without a default value have a NULL def_bd)
+        if (maybe_clear && bd->data != NULL && (def_bd == NULL || bd->data != def_bd->data))
           FREE (allocator, bd->data);
         bd->data = ALLOC (allocator, len - pref_len);
         memcpy (bd->data, data + pref_len, len - pref_len);
@@ -91,6 +91,31 @@ extern ProtobufCAllocator protobuf_c_system_allocator;  /* use malloc, free etc
 
 extern void (*protobuf_c_out_of_memory) (void);
 
+/* --- arena allocator --- */
+/* A bump-pointer allocator for protobuf_c_message_unpack().
+   Allocations are carved from large chunks, sized from the
+   length of the input; the allocator's free() is a no-op,
+   and all memory is released in one call to
+   protobuf_c_arena_destroy().  There is no need to call
+   protobuf_c_message_free_unpacked() on messages unpacked
+   with an arena, and they must not be used once the arena
+   has been destroyed. */
+typedef struct _ProtobufCArenaChunk ProtobufCArenaChunk;
+typedef struct _ProtobufCArena ProtobufCArena;
+struct _ProtobufCArena
+{
+  ProtobufCAllocator allocator;         /* pass &arena->allocator to unpack */
+  ProtobufCArenaChunk *chunks;          /* current chunk first */
+  size_t chunk_size;                    /* size of the next chunk */
+};
+
+/* Estimated bytes of unpacked message per byte of input */
+#define PROTOBUF_C_ARENA_EXPANSION      4
+
+void      protobuf_c_arena_init             (ProtobufCArena      *arena,
+                                             size_t               input_len);
+void      protobuf_c_arena_destroy          (ProtobufCArena      *arena);
+
 /* --- append-only data buffer --- */
 typedef struct _ProtobufCBuffer ProtobufCBuffer;
 struct _ProtobufCBuffer
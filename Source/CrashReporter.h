@@ -89,6 +89,9 @@ typedef enum {
 
     /** The crash report log file is corrupt or invalid */
     PLCrashReporterErrorCrashReportInvalid = 2,
+
+    /** The requested crash report is not pending */
+    PLCrashReporterErrorCrashReportNotFound = 3,
 } PLCrashReporterError;
 
 
@@ -225,5 +228,9 @@ typedef enum {
  * Most notably, the Objective-C runtime itself is not async-safe, and Objective-C may not be used within a signal
  * handler.
  *
+ * If a dedicated handler thread has been enabled via PLCrashReporter::setHandlerThreadEnabled:, the post-crash
+ * handler will be executed on that thread rather than the crashed thread. The same restrictions apply; the crashed
+ * thread remains blocked in its signal handler, and any locks it holds will never be released.
+ *
  * @sa PLCrashReporter::setCrashCallbacks:
  */
\ No newline at end of file
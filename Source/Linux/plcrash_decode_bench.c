@@ -0,0 +1,492 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Crash report decoding throughput benchmark.
+ *
+ * Decodes every section of each report in a corpus using the portable decoder core, from a pool of worker
+ * threads, and reports the aggregate throughput. The corpus is either read from the report files named on the
+ * command line, or generated. With -t, each report is instead formatted as iOS text using the C text writer.
+ *
+ * Usage: plcrash_decode_bench [-t] [-j threads] [-n reports] [-i iterations] [file ...]
+ *
+ * If -j is not specified, the benchmark is run with 1, 2, 4, ... threads, up to the number of online CPUs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#import "PLCrashReportDecoder.h"
+#import "PLCrashReportTextWriter.h"
+
+/** Default number of generated reports. */
+#define DEFAULT_REPORT_COUNT 1000
+
+/** Default number of passes over the corpus. */
+#define DEFAULT_ITERATIONS 5
+
+/** Size of each worker's text output buffer. */
+#define TEXT_BUFFER_SIZE (4 * 1024 * 1024)
+
+/** An encoded crash report file. */
+typedef struct bench_report {
+    uint8_t *data;
+    size_t len;
+} bench_report_t;
+
+/** Shared benchmark state. */
+typedef struct bench_state {
+    /** The corpus */
+    bench_report_t *reports;
+
+    /** Number of reports in the corpus */
+    size_t report_count;
+
+    /** Total number of decode operations to perform */
+    size_t total;
+
+    /** Next decode operation to claim */
+    size_t next;
+
+    /** If true, format reports as text rather than decoding every section */
+    bool format;
+
+    /** Number of reports that failed to decode */
+    size_t failures;
+} bench_state_t;
+
+/** Generated register names. */
+static char *register_names[] = {
+    "rax", "rbx", "rcx", "rdx", "rdi", "rsi", "rbp", "rsp", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15", "rip"
+};
+
+/**
+ * Allocate a zero-filled message of the given type.
+ */
+static void *message_new (const ProtobufCMessageDescriptor *descriptor) {
+    ProtobufCMessage *message = calloc(1, descriptor->sizeof_message);
+    if (message == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+
+    message->descriptor = descriptor;
+    return message;
+}
+
+/**
+ * Generate a version 2 crash report file, using @a seed to vary the number of threads, frames and images.
+ */
+static bench_report_t generate_report (unsigned int seed) {
+    static uint8_t uuid[16] = { 0x8d, 0x3c, 0x11, 0x7e, 0x52, 0x09, 0x4a, 0x65, 0xb1, 0x6f, 0x02, 0x5e, 0x9a, 0x44, 0xd0, 0x13 };
+    Plcrash__CrashReport *report = message_new(&plcrash__crash_report__descriptor);
+    size_t thread_count = 4 + rand_r(&seed) % 29;
+    size_t image_count = 50 + rand_r(&seed) % 251;
+    size_t crashed = rand_r(&seed) % thread_count;
+    char image_names[image_count][96];
+
+    /* System, application, process and machine info */
+    Plcrash__CrashReport__SystemInfo *systemInfo = message_new(&plcrash__crash_report__system_info__descriptor);
+    systemInfo->has_operating_system = 1;
+    systemInfo->operating_system = PLCRASH__CRASH_REPORT__SYSTEM_INFO__OPERATING_SYSTEM__IPHONE_OS;
+    systemInfo->os_version = "4.3.3";
+    systemInfo->os_build = "8J2";
+    systemInfo->timestamp = 1300000000 + seed;
+    report->system_info = systemInfo;
+
+    Plcrash__CrashReport__ApplicationInfo *appInfo = message_new(&plcrash__crash_report__application_info__descriptor);
+    appInfo->identifier = "com.example.CrashDemo";
+    appInfo->version = "1.0";
+    report->application_info = appInfo;
+
+    Plcrash__CrashReport__ProcessInfo *processInfo = message_new(&plcrash__crash_report__process_info__descriptor);
+    processInfo->process_name = "CrashDemo";
+    processInfo->process_id = 1024 + seed % 4096;
+    processInfo->process_path = "/var/mobile/Applications/CrashDemo.app/CrashDemo";
+    processInfo->parent_process_name = "launchd";
+    processInfo->parent_process_id = 1;
+    processInfo->native = 1;
+    report->process_info = processInfo;
+
+    Plcrash__CrashReport__Processor *processor = message_new(&plcrash__crash_report__processor__descriptor);
+    processor->has_encoding = 1;
+    processor->encoding = PLCRASH__CRASH_REPORT__PROCESSOR__TYPE_ENCODING__TYPE_ENCODING_MACH;
+    processor->type = 12;
+    processor->subtype = 9;
+
+    Plcrash__CrashReport__MachineInfo *machineInfo = message_new(&plcrash__crash_report__machine_info__descriptor);
+    machineInfo->model = "iPhone3,1";
+    machineInfo->processor = processor;
+    machineInfo->processor_count = 1;
+    machineInfo->logical_processor_count = 1;
+    report->machine_info = machineInfo;
+
+    /* Threads */
+    report->n_threads = thread_count;
+    report->threads = calloc(thread_count, sizeof(*report->threads));
+    for (size_t i = 0; i < thread_count; i++) {
+        Plcrash__CrashReport__Thread *thread = message_new(&plcrash__crash_report__thread__descriptor);
+        thread->thread_number = i;
+        thread->crashed = (i == crashed);
+
+        thread->n_frames = 8 + rand_r(&seed) % 57;
+        thread->frames = calloc(thread->n_frames, sizeof(*thread->frames));
+        for (size_t f = 0; f < thread->n_frames; f++) {
+            thread->frames[f] = message_new(&plcrash__crash_report__thread__stack_frame__descriptor);
+            thread->frames[f]->pc = 0x1000 + ((uint64_t) (rand_r(&seed) % image_count) << 20) + rand_r(&seed) % 0x10000;
+        }
+
+        if (thread->crashed) {
+            thread->n_registers = sizeof(register_names) / sizeof(register_names[0]);
+            thread->registers = calloc(thread->n_registers, sizeof(*thread->registers));
+            for (size_t r = 0; r < thread->n_registers; r++) {
+                thread->registers[r] = message_new(&plcrash__crash_report__thread__register_value__descriptor);
+                thread->registers[r]->name = register_names[r];
+                thread->registers[r]->value = ((uint64_t) rand_r(&seed) << 32) | rand_r(&seed);
+            }
+        }
+
+        report->threads[i] = thread;
+    }
+
+    /* Binary images */
+    report->n_binary_images = image_count;
+    report->binary_images = calloc(image_count, sizeof(*report->binary_images));
+    for (size_t i = 0; i < image_count; i++) {
+        Plcrash__CrashReport__BinaryImage *image = message_new(&plcrash__crash_report__binary_image__descriptor);
+        snprintf(image_names[i], sizeof(image_names[i]), "/System/Library/Frameworks/Framework%zu.framework/Framework%zu", i, i);
+        image->base_address = 0x1000 + ((uint64_t) i << 20);
+        image->size = 0x80000;
+        image->name = image_names[i];
+        image->has_uuid = 1;
+        image->uuid.len = sizeof(uuid);
+        image->uuid.data = uuid;
+        image->code_type = processor;
+        report->binary_images[i] = image;
+    }
+
+    /* Signal and exception */
+    Plcrash__CrashReport__Signal *signal = message_new(&plcrash__crash_report__signal__descriptor);
+    signal->name = "SIGSEGV";
+    signal->code = "SEGV_MAPERR";
+    signal->address = 0x8;
+    report->signal = signal;
+
+    Plcrash__CrashReport__Exception *exception = message_new(&plcrash__crash_report__exception__descriptor);
+    exception->name = "NSInvalidArgumentException";
+    exception->reason = "-[NSNull length]: unrecognized selector sent to instance 0x3e4b5a10";
+    report->exception = exception;
+
+    Plcrash__CrashReport__HandlerInfo *handlerInfo = message_new(&plcrash__crash_report__handler_info__descriptor);
+    handlerInfo->stack_size = 65536;
+    handlerInfo->stack_used = 4096 + seed % 8192;
+    report->handler_info = handlerInfo;
+
+    /* Encode the file: magic, version, summary header, message */
+    plcrash_report_summary_t summary;
+    plcrash_report_summary_header_t header;
+    memset(&summary, 0, sizeof(summary));
+    summary.timestamp = systemInfo->timestamp;
+    summary.signal = 11;
+    summary.crashed_thread = crashed;
+    plcrash_report_summary_encode(&summary, &header);
+
+    size_t message_len = protobuf_c_message_get_packed_size(&report->base);
+    bench_report_t result;
+    result.len = 8 + sizeof(header) + message_len;
+    result.data = malloc(result.len);
+    if (result.data == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    memcpy(result.data, "plcrash", 7);
+    result.data[7] = PLCRASH_REPORT_SUMMARY_FILE_VERSION;
+    memcpy(result.data + 8, &header, sizeof(header));
+    protobuf_c_message_pack(&report->base, result.data + 8 + sizeof(header));
+
+    /* Clean up. Strings, the UUID and the shared processor are not owned by their messages. */
+    for (size_t i = 0; i < report->n_threads; i++) {
+        Plcrash__CrashReport__Thread *thread = report->threads[i];
+        for (size_t f = 0; f < thread->n_frames; f++)
+            free(thread->frames[f]);
+        for (size_t r = 0; r < thread->n_registers; r++)
+            free(thread->registers[r]);
+        free(thread->frames);
+        free(thread->registers);
+        free(thread);
+    }
+    for (size_t i = 0; i < report->n_binary_images; i++)
+        free(report->binary_images[i]);
+
+    free(report->threads);
+    free(report->binary_images);
+    free(systemInfo);
+    free(appInfo);
+    free(processInfo);
+    free(processor);
+    free(machineInfo);
+    free(signal);
+    free(exception);
+    free(handlerInfo);
+    free(report);
+
+    return result;
+}
+
+/**
+ * Read a crash report file.
+ */
+static bool read_report (const char *path, bench_report_t *report) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror(path);
+        return false;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    report->len = (len > 0) ? (size_t) len : 0;
+    report->data = malloc(report->len > 0 ? report->len : 1);
+    if (report->data == NULL || fread(report->data, 1, report->len, fp) != report->len) {
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(fp);
+        return false;
+    }
+
+    fclose(fp);
+    return true;
+}
+
+/**
+ * Decode every section of @a report. Returns false if the report or any of its sections could not be decoded.
+ */
+static bool decode_report (const bench_report_t *report) {
+    plcrash_report_decoder_t decoder;
+    ProtobufCArena arena;
+    bool ok = true;
+
+    if (plcrash_report_decoder_init(&decoder, report->data, report->len) != PLCRASH_ESUCCESS) {
+        plcrash_report_decoder_free(&decoder);
+        return false;
+    }
+
+    /* Each top-level field is decoded into its own arena, as PLCrashReport does */
+    for (uint32_t number = 1; number <= PLCRASH_REPORT_FIELD_MAX && ok; number++) {
+        size_t count = plcrash_report_decoder_count(&decoder, number);
+        for (size_t i = 0; i < count && ok; i++) {
+            if (plcrash_report_decoder_unpack(&decoder, number, i, &arena) == NULL)
+                ok = false;
+            protobuf_c_arena_destroy(&arena);
+        }
+    }
+
+    plcrash_report_decoder_free(&decoder);
+    return ok;
+}
+
+/**
+ * Format @a report as iOS text into @a buffer. Returns false if the report could not be decoded or formatted.
+ */
+static bool format_report (const bench_report_t *report, char *buffer, size_t size) {
+    plcrash_report_decoder_t decoder;
+    plcrash_report_text_writer_t writer;
+    bool ok = false;
+
+    if (plcrash_report_decoder_init(&decoder, report->data, report->len) == PLCRASH_ESUCCESS) {
+        plcrash_report_text_writer_init_buffer(&writer, buffer, size);
+        ok = (plcrash_report_text_write(&writer, &decoder, PLCRASH_REPORT_TEXT_FORMAT_IOS) == PLCRASH_ESUCCESS);
+    }
+
+    plcrash_report_decoder_free(&decoder);
+    return ok;
+}
+
+/**
+ * Worker thread. Claims and decodes reports until the shared operation count is exhausted.
+ */
+static void *bench_worker (void *arg) {
+    bench_state_t *state = arg;
+    char *buffer = NULL;
+    size_t i;
+
+    if (state->format && (buffer = malloc(TEXT_BUFFER_SIZE)) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    while ((i = __sync_fetch_and_add(&state->next, 1)) < state->total) {
+        const bench_report_t *report = &state->reports[i % state->report_count];
+        bool ok = state->format ? format_report(report, buffer, TEXT_BUFFER_SIZE) : decode_report(report);
+        if (!ok)
+            __sync_fetch_and_add(&state->failures, 1);
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+/**
+ * Run the benchmark with @a thread_count workers, printing the results.
+ */
+static bool run_bench (bench_report_t *reports, size_t report_count, unsigned int iterations, unsigned int thread_count,
+                       bool format)
+{
+    bench_state_t state;
+    pthread_t threads[thread_count];
+    struct timeval start, end;
+
+    state.reports = reports;
+    state.report_count = report_count;
+    state.total = report_count * iterations;
+    state.next = 0;
+    state.format = format;
+    state.failures = 0;
+
+    gettimeofday(&start, NULL);
+    for (unsigned int i = 0; i < thread_count; i++) {
+        if (pthread_create(&threads[i], NULL, bench_worker, &state) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    for (unsigned int i = 0; i < thread_count; i++)
+        pthread_join(threads[i], NULL);
+    gettimeofday(&end, NULL);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+    size_t bytes = 0;
+    for (size_t i = 0; i < report_count; i++)
+        bytes += reports[i].len;
+    bytes *= iterations;
+
+    printf("%3u threads: %8zu reports in %7.3f s, %10.0f reports/s, %8.1f MB/s\n", thread_count, state.total, seconds,
+           state.total / seconds, bytes / seconds / (1024.0 * 1024.0));
+
+    if (state.failures > 0) {
+        fprintf(stderr, "%zu reports could not be %s\n", state.failures, format ? "formatted" : "decoded");
+        return false;
+    }
+
+    return true;
+}
+
+static void print_usage (const char *progname) {
+    fprintf(stderr, "Usage: %s [-t] [-j threads] [-n reports] [-i iterations] [file ...]\n", progname);
+}
+
+int main (int argc, char *argv[]) {
+    const char *progname = argv[0];
+    unsigned int thread_count = 0;
+    unsigned int iterations = DEFAULT_ITERATIONS;
+    size_t report_count = DEFAULT_REPORT_COUNT;
+    bool format = false;
+    bench_report_t *reports;
+    int ch;
+
+    while ((ch = getopt(argc, argv, "tj:n:i:h")) != -1) {
+        switch (ch) {
+            case 't':
+                format = true;
+                break;
+            case 'j':
+                thread_count = (unsigned int) strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                report_count = strtoul(optarg, NULL, 10);
+                break;
+            case 'i':
+                iterations = (unsigned int) strtoul(optarg, NULL, 10);
+                break;
+            default:
+                print_usage(progname);
+                return 1;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (iterations == 0 || (argc == 0 && report_count == 0)) {
+        print_usage(progname);
+        return 1;
+    }
+
+    /* Load or generate the corpus */
+    if (argc > 0)
+        report_count = argc;
+
+    reports = calloc(report_count, sizeof(*reports));
+    if (reports == NULL) {
+        perror("calloc");
+        return 1;
+    }
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < report_count; i++) {
+        if (argc > 0) {
+            if (!read_report(argv[i], &reports[i]))
+                return 1;
+        } else {
+            reports[i] = generate_report(i);
+        }
+        bytes += reports[i].len;
+    }
+
+    printf("Corpus: %zu reports, %.1f MB, %u iterations\n", report_count, bytes / (1024.0 * 1024.0), iterations);
+
+    /* Run the benchmark */
+    bool ok = true;
+    if (thread_count > 0) {
+        ok = run_bench(reports, report_count, iterations, thread_count, format);
+    } else {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpus < 1)
+            cpus = 1;
+
+        for (unsigned int n = 1; ok; n *= 2) {
+            if (n > cpus)
+                n = cpus;
+            ok = run_bench(reports, report_count, iterations, n, format);
+            if (n == cpus)
+                break;
+        }
+    }
+
+    for (size_t i = 0; i < report_count; i++)
+        free(reports[i].data);
+    free(reports);
+
+    return ok ? 0 : 1;
+}
@@ -84,6 +84,29 @@ void *plcrash_async_memcpy (void *dest, const void *source, size_t n) {
     return (void *) source;
 }
 
+/**
+ * Return the high-water mark of a downward-growing stack that was zero-filled prior to use, such as a stack
+ * allocated from fresh anonymous memory.
+ *
+ * The stack is scanned upwards from its lowest address for the first non-zero byte. A stack frame that
+ * happens to leave zeros at its deepest extent will be under-reported by the size of those zeros.
+ *
+ * @param stack_base The lowest address of the stack.
+ * @param stack_size The size of the stack, in bytes.
+ *
+ * @return Returns the number of bytes of the stack that have been used.
+ */
+size_t plcrash_async_stack_high_water (const void *stack_base, size_t stack_size) {
+    const uint8_t *p = stack_base;
+
+    for (size_t i = 0; i < stack_size; i++) {
+        if (p[i] != 0)
+            return stack_size - i;
+    }
+
+    return 0;
+}
+
 /**
  * @internal
  * @ingroup plcrash_async
@@ -138,6 +161,8 @@ void plcrash_async_file_init (plcrash_async_file_t *file, int fd, off_t output_l
     file->buflen = 0;
     file->total_bytes = 0;
     file->limit_bytes = output_limit;
+    file->offset = 0;
+    file->base_offset = lseek(fd, 0, SEEK_CUR);
 }
 
 
@@ -167,6 +192,7 @@ bool plcrash_async_file_write (plcrash_async_file_t *file, const void *data, siz
     if (len + file->buflen <= sizeof(file->buffer)) {
         plcrash_async_memcpy(file->buffer + file->buflen, data, len);
         file->buflen += len;
+        file->offset += len;
         
         return true;
         
@@ -176,6 +202,7 @@ bool plcrash_async_file_write (plcrash_async_file_t *file, const void *data, siz
             return false;
         }
         
+        file->offset += len;
         return true;
     } 
 }
@@ -199,6 +226,45 @@ bool plcrash_async_file_flush (plcrash_async_file_t *file) {
 }
 
 
+/**
+ * Return the output offset of the next byte to be written, relative to the descriptor's position at
+ * initialization. Buffered bytes are included.
+ */
+off_t plcrash_async_file_offset (plcrash_async_file_t *file) {
+    return file->offset;
+}
+
+/**
+ * Overwrite previously written bytes. Any buffered data is flushed, and subsequent writes continue
+ * at the end of the output.
+ *
+ * @param file The file.
+ * @param offset The offset at which to write, as returned by plcrash_async_file_offset().
+ * @param data The data to write.
+ * @param len The length of @a data. The range must lie within the bytes already written.
+ *
+ * @return Returns true on success, or false if the range is invalid, the descriptor is not seekable,
+ * or an error occurs.
+ */
+bool plcrash_async_file_patch (plcrash_async_file_t *file, off_t offset, const void *data, size_t len) {
+    if (file->base_offset < 0 || offset < 0 || offset + (off_t) len > file->offset)
+        return false;
+
+    if (!plcrash_async_file_flush(file))
+        return false;
+
+    if (lseek(file->fd, file->base_offset + offset, SEEK_SET) < 0)
+        return false;
+
+    bool success = (writen(file->fd, data, len) >= 0);
+
+    /* Restore the output position */
+    if (lseek(file->fd, file->base_offset + file->offset, SEEK_SET) < 0)
+        return false;
+
+    return success;
+}
+
 /**
  * Close the backing file descriptor.
  */
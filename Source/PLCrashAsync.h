@@ -78,6 +78,7 @@ typedef enum  {
 const char *plcrash_strerror (plcrash_error_t error);
 
 void *plcrash_async_memcpy(void *dest, const void *source, size_t n);
+size_t plcrash_async_stack_high_water (const void *stack_base, size_t stack_size);
 
 /**
  * @internal
@@ -96,6 +97,12 @@ typedef struct plcrash_async_file {
     /** Total bytes written */
     off_t total_bytes;
 
+    /** Descriptor position at initialization, or -1 if the descriptor is not seekable */
+    off_t base_offset;
+
+    /** Number of bytes accepted for output, including buffered bytes */
+    off_t offset;
+
     /** Current length of data in buffer */
     size_t buflen;
 
@@ -107,4 +114,6 @@ typedef struct plcrash_async_file {
 void plcrash_async_file_init (plcrash_async_file_t *file, int fd, off_t output_limit);
 bool plcrash_async_file_write (plcrash_async_file_t *file, const void *data, size_t len);
 bool plcrash_async_file_flush (plcrash_async_file_t *file);
+off_t plcrash_async_file_offset (plcrash_async_file_t *file);
+bool plcrash_async_file_patch (plcrash_async_file_t *file, off_t offset, const void *data, size_t len);
 bool plcrash_async_file_close (plcrash_async_file_t *file);
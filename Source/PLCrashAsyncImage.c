@@ -75,6 +75,7 @@ void plcrash_async_image_list_free (plcrash_async_image_list_t *list) {
         /* Deallocate the current item. */
         if (cur->name != NULL)
             free(cur->name);
+        plcrash_async_symtab_free(&cur->symtab);
         free(cur);
     }
 }
@@ -89,10 +90,42 @@ void plcrash_async_image_list_free (plcrash_async_image_list_t *list) {
  * @warning This method is not async safe.
  */
 void plcrash_async_image_list_append (plcrash_async_image_list_t *list, intptr_t header, const char *name) {
+    plcrash_async_image_list_append_image(list, header, name, 0, NULL, NULL);
+}
+
+/**
+ * Append a new binary image record to @a list, together with the image's precomputed Mach-O information and
+ * symbol table. Recording this information when the image is registered avoids parsing the image's load
+ * commands at crash time.
+ *
+ * @param list The list to which the image record should be appended.
+ * @param header The image's header address.
+ * @param name The image's name.
+ * @param text_size The size of the image's __TEXT segment, or 0 if unknown.
+ * @param uuid The image's 16 byte UUID, or NULL if the image has no UUID.
+ * @param symtab The image's symbol table, or NULL. The list takes ownership of the table's contents, and
+ * @a symtab is left empty.
+ *
+ * @warning This method is not async safe.
+ */
+void plcrash_async_image_list_append_image (plcrash_async_image_list_t *list, intptr_t header, const char *name, uint64_t text_size,
+                                            const uint8_t *uuid, plcrash_async_symtab_t *symtab)
+{
     /* Initialize the new entry. */
     plcrash_async_image_t *new = calloc(1, sizeof(plcrash_async_image_t));
     new->header = header;
     new->name = strdup(name);
+    new->text_size = text_size;
+
+    if (uuid != NULL) {
+        new->has_uuid = true;
+        memcpy(new->uuid, uuid, sizeof(new->uuid));
+    }
+
+    if (symtab != NULL) {
+        new->symtab = *symtab;
+        memset(symtab, 0, sizeof(*symtab));
+    }
     
     /* Update the image record and issue a memory barrier to ensure a consistent view. */
     OSMemoryBarrier();
@@ -185,6 +218,7 @@ void plcrash_async_image_list_remove (plcrash_async_image_list_t *list, intptr_t
 
         if (item->name != NULL)
             free(item->name);
+        plcrash_async_symtab_free(&item->symtab);
         free(item);
     } OSSpinLockUnlock(&list->write_lock);
 }
@@ -30,6 +30,8 @@
 #include <libkern/OSAtomic.h>
 #include <stdbool.h>
 
+#include "PLCrashAsyncSymbolTable.h"
+
 /**
  * @internal
  * @ingroup plcrash_async_image
@@ -43,6 +45,18 @@ typedef struct plcrash_async_image {
     /** The binary image's name/path. */
     char *name;
 
+    /** The size of the image's __TEXT segment, or 0 if unknown. */
+    uint64_t text_size;
+
+    /** If true, uuid contains the image's LC_UUID value. */
+    bool has_uuid;
+
+    /** The image's UUID. Only valid if has_uuid is true. */
+    uint8_t uuid[16];
+
+    /** The binary image's exported symbols. Empty if no symbol table was supplied. */
+    plcrash_async_symtab_t symtab;
+
     /** The previous image in the list, or NULL */
     struct plcrash_async_image *prev;
     
@@ -78,6 +92,8 @@ typedef struct plcrash_async_image_list {
 void plcrash_async_image_list_init (plcrash_async_image_list_t *list);
 void plcrash_async_image_list_free (plcrash_async_image_list_t *list);
 void plcrash_async_image_list_append (plcrash_async_image_list_t *list, intptr_t header, const char *name);
+void plcrash_async_image_list_append_image (plcrash_async_image_list_t *list, intptr_t header, const char *name, uint64_t text_size,
+                                            const uint8_t *uuid, plcrash_async_symtab_t *symtab);
 void plcrash_async_image_list_remove (plcrash_async_image_list_t *list, intptr_t header);
 
 void plcrash_async_image_list_set_reading (plcrash_async_image_list_t *list, bool enable);
@@ -75,6 +75,37 @@
     }
 }
 
+/* Test appending an image with its Mach-O information and a symbol table; the list takes ownership of the table. */
+- (void) testAppendImage {
+    plcrash_async_symtab_t symtab;
+    const uint8_t uuid[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+
+    memset(&symtab, 0, sizeof(symtab));
+    symtab.count = 1;
+    symtab.text_size = 0x1000;
+    symtab.entries = calloc(1, sizeof(plcrash_async_symtab_entry_t));
+
+    plcrash_async_image_list_append_image(&_list, 0x1000, "image_name", 0x1000, uuid, &symtab);
+    STAssertNULL(symtab.entries, @"The table should have been transferred to the list");
+
+    plcrash_async_image_t *item = plcrash_async_image_list_next(&_list, NULL);
+    STAssertNotNULL(item, @"Item should not be NULL");
+    STAssertEquals((uint32_t) 1, item->symtab.count, @"Incorrect symbol count");
+    STAssertEquals((uint64_t) 0x1000, item->symtab.text_size, @"Incorrect text size");
+    STAssertEquals((uint64_t) 0x1000, item->text_size, @"Incorrect image text size");
+    STAssertTrue(item->has_uuid, @"UUID should be set");
+    STAssertTrue(memcmp(uuid, item->uuid, sizeof(uuid)) == 0, @"Incorrect UUID");
+
+    /* Images appended without a table have an empty table, and no Mach-O information */
+    plcrash_async_image_list_append(&_list, 0x2000, "image_name");
+    item = plcrash_async_image_list_next(&_list, item);
+    STAssertEquals((uint32_t) 0, item->symtab.count, @"Table should be empty");
+    STAssertEquals((uint64_t) 0, item->text_size, @"Text size should be unknown");
+    STAssertFalse(item->has_uuid, @"UUID should not be set");
+
+    /* The table is freed with the image */
+    plcrash_async_image_list_remove(&_list, 0x1000);
+}
 
 /* Test removing the last image in the list. */
 - (void) testRemoveLastImage {
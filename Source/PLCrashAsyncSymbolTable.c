@@ -0,0 +1,383 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PLCrashAsyncSymbolTable.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mach-o/loader.h>
+#include <mach-o/nlist.h>
+
+/**
+ * @internal
+ * @ingroup plcrash_async
+ * @defgroup plcrash_async_symtab In-Process Symbol Tables
+ *
+ * Builds compact, address-sorted tables of a loaded image's exported symbols, which may be searched from within
+ * the crash handler to record the nearest preceding symbol of each stack frame.
+ *
+ * Tables are built from the image's in-memory LC_SYMTAB and LC_DYSYMTAB data when the image is registered; this
+ * is not async-safe. Each entry consists of a 32-bit address and a 32-bit offset into the image's own string table,
+ * so a table costs 8 bytes per exported symbol, and names are never copied. Lookups are a binary search, and
+ * perform no allocation.
+ *
+ * Only external symbols defined within the image's __TEXT segment are recorded. Most images are stripped of their
+ * local symbols, and a frame within a non-exported function will be attributed to the nearest preceding exported
+ * symbol.
+ * @{
+ */
+
+/**
+ * @internal
+ * Segment values shared by LC_SEGMENT and LC_SEGMENT_64.
+ */
+typedef struct segment_info {
+    uint64_t vmaddr;
+    uint64_t vmsize;
+    uint64_t fileoff;
+    uint64_t filesize;
+} segment_info_t;
+
+/**
+ * @internal
+ * Symbol values shared by nlist and nlist_64.
+ */
+typedef struct symbol_info {
+    uint32_t strx;
+    uint8_t type;
+    uint64_t value;
+} symbol_info_t;
+
+/**
+ * @internal
+ * If @a cmd is a segment command named @a segname, populate @a info and return true.
+ */
+static bool read_segment (const struct load_command *cmd, const char *segname, segment_info_t *info) {
+    if (cmd->cmd == LC_SEGMENT && cmd->cmdsize >= sizeof(struct segment_command)) {
+        const struct segment_command *segment = (const struct segment_command *) cmd;
+        if (strncmp(segment->segname, segname, sizeof(segment->segname)) != 0)
+            return false;
+
+        info->vmaddr = segment->vmaddr;
+        info->vmsize = segment->vmsize;
+        info->fileoff = segment->fileoff;
+        info->filesize = segment->filesize;
+        return true;
+    }
+
+    if (cmd->cmd == LC_SEGMENT_64 && cmd->cmdsize >= sizeof(struct segment_command_64)) {
+        const struct segment_command_64 *segment = (const struct segment_command_64 *) cmd;
+        if (strncmp(segment->segname, segname, sizeof(segment->segname)) != 0)
+            return false;
+
+        info->vmaddr = segment->vmaddr;
+        info->vmsize = segment->vmsize;
+        info->fileoff = segment->fileoff;
+        info->filesize = segment->filesize;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @internal
+ * Read the symbol at @a index from the nlist or nlist_64 array at @a symbols.
+ */
+static void read_symbol (const void *symbols, uint32_t index, bool is64, symbol_info_t *info) {
+    if (is64) {
+        const struct nlist_64 *nl = (const struct nlist_64 *) symbols + index;
+        info->strx = nl->n_un.n_strx;
+        info->type = nl->n_type;
+        info->value = nl->n_value;
+    } else {
+        const struct nlist *nl = (const struct nlist *) symbols + index;
+        info->strx = nl->n_un.n_strx;
+        info->type = nl->n_type;
+        info->value = nl->n_value;
+    }
+}
+
+/**
+ * @internal
+ * Return true if the range at @a offset of @a length bytes lies within @a segment's file data.
+ */
+static bool segment_contains (const segment_info_t *segment, uint64_t offset, uint64_t length) {
+    if (offset < segment->fileoff || offset - segment->fileoff > segment->filesize)
+        return false;
+
+    return length <= segment->filesize - (offset - segment->fileoff);
+}
+
+/**
+ * @internal
+ * Sort entries by address, and then by name offset, so that the table contents do not depend on the sort
+ * implementation.
+ */
+static int compare_entries (const void *a, const void *b) {
+    const plcrash_async_symtab_entry_t *lhs = a;
+    const plcrash_async_symtab_entry_t *rhs = b;
+
+    if (lhs->address != rhs->address)
+        return lhs->address < rhs->address ? -1 : 1;
+
+    if (lhs->name != rhs->name)
+        return lhs->name < rhs->name ? -1 : 1;
+
+    return 0;
+}
+
+/**
+ * Build the symbol table of the loaded image at @a header.
+ *
+ * @param symtab The symbol table to initialize. On failure, the table is left empty, and need not be freed.
+ * @param header The image's in-memory Mach-O header. The image must remain loaded for as long as the table is used.
+ * @param max_count The maximum number of symbols to record. If the image exports more symbols than this, no table
+ * is built and PLCRASH_ENOMEM is returned; truncating the table would attribute frames to the wrong symbols.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if the image's load commands are invalid,
+ * PLCRASH_ENOTSUP if the image has no symbol table, or PLCRASH_ENOMEM if the table would exceed @a max_count entries
+ * or could not be allocated.
+ *
+ * @warning This function is not async-safe.
+ */
+plcrash_error_t plcrash_async_symtab_init (plcrash_async_symtab_t *symtab, const void *header, uint32_t max_count) {
+    const struct mach_header *header32 = (const struct mach_header *) header;
+    const struct mach_header_64 *header64 = (const struct mach_header_64 *) header;
+    const struct load_command *cmd;
+    uint32_t ncmds;
+    const uint8_t *cmds_end;
+    bool is64;
+
+    memset(symtab, 0, sizeof(*symtab));
+
+    /* Only images of the host's byte order are loaded in-process */
+    switch (header32->magic) {
+        case MH_MAGIC:
+            ncmds = header32->ncmds;
+            cmd = (const struct load_command *) (header32 + 1);
+            cmds_end = (const uint8_t *) cmd + header32->sizeofcmds;
+            is64 = false;
+            break;
+
+        case MH_MAGIC_64:
+            ncmds = header64->ncmds;
+            cmd = (const struct load_command *) (header64 + 1);
+            cmds_end = (const uint8_t *) cmd + header64->sizeofcmds;
+            is64 = true;
+            break;
+
+        default:
+            PLCF_DEBUG("Invalid Mach-O header magic value: %x", header32->magic);
+            return PLCRASH_EINVAL;
+    }
+
+    /* Find the __TEXT and __LINKEDIT segments, and the symbol table commands */
+    segment_info_t text;
+    segment_info_t linkedit;
+    bool found_text = false;
+    bool found_linkedit = false;
+    const struct symtab_command *symtab_cmd = NULL;
+    const struct dysymtab_command *dysymtab_cmd = NULL;
+
+    for (uint32_t i = 0; i < ncmds; i++) {
+        if ((size_t) (cmds_end - (const uint8_t *) cmd) < sizeof(struct load_command) ||
+            cmd->cmdsize < sizeof(struct load_command) || cmd->cmdsize > (size_t) (cmds_end - (const uint8_t *) cmd))
+        {
+            PLCF_DEBUG("Invalid load command %" PRIu32 " in image at %p", i, header);
+            return PLCRASH_EINVAL;
+        }
+
+        if (!found_text && read_segment(cmd, SEG_TEXT, &text)) {
+            found_text = true;
+        } else if (!found_linkedit && read_segment(cmd, SEG_LINKEDIT, &linkedit)) {
+            found_linkedit = true;
+        } else if (cmd->cmd == LC_SYMTAB && cmd->cmdsize >= sizeof(struct symtab_command)) {
+            symtab_cmd = (const struct symtab_command *) cmd;
+        } else if (cmd->cmd == LC_DYSYMTAB && cmd->cmdsize >= sizeof(struct dysymtab_command)) {
+            dysymtab_cmd = (const struct dysymtab_command *) cmd;
+        }
+
+        cmd = (const struct load_command *) ((const uint8_t *) cmd + cmd->cmdsize);
+    }
+
+    if (!found_text || !found_linkedit || symtab_cmd == NULL)
+        return PLCRASH_ENOTSUP;
+
+    /* The symbol and string tables live in __LINKEDIT, which is mapped at its vmaddr plus the image's slide. This
+     * also holds for images in the shared cache, whose __LINKEDIT is shared. */
+    size_t nlist_size = is64 ? sizeof(struct nlist_64) : sizeof(struct nlist);
+    if (!segment_contains(&linkedit, symtab_cmd->symoff, (uint64_t) symtab_cmd->nsyms * nlist_size) ||
+        !segment_contains(&linkedit, symtab_cmd->stroff, symtab_cmd->strsize))
+    {
+        PLCF_DEBUG("Symbol table of image at %p lies outside of __LINKEDIT", header);
+        return PLCRASH_EINVAL;
+    }
+
+    uintptr_t slide = (uintptr_t) header - (uintptr_t) text.vmaddr;
+    uintptr_t linkedit_base = (uintptr_t) linkedit.vmaddr + slide - (uintptr_t) linkedit.fileoff;
+    const void *symbols = (const void *) (linkedit_base + symtab_cmd->symoff);
+    const char *strings = (const char *) (linkedit_base + symtab_cmd->stroff);
+    uint32_t strsize = symtab_cmd->strsize;
+
+    /* Restrict the search to the exported symbols, if they have been grouped by the linker */
+    uint32_t first = 0;
+    uint32_t last = symtab_cmd->nsyms;
+    if (dysymtab_cmd != NULL && dysymtab_cmd->iextdefsym <= symtab_cmd->nsyms &&
+        dysymtab_cmd->nextdefsym <= symtab_cmd->nsyms - dysymtab_cmd->iextdefsym)
+    {
+        first = dysymtab_cmd->iextdefsym;
+        last = first + dysymtab_cmd->nextdefsym;
+    }
+
+    /* The table is sized by a first pass, and populated by a second */
+    uint32_t count = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        count = 0;
+
+        for (uint32_t i = first; i < last; i++) {
+            symbol_info_t sym;
+            read_symbol(symbols, i, is64, &sym);
+
+            /* Only named, external symbols defined within __TEXT */
+            if ((sym.type & N_STAB) != 0 || (sym.type & N_TYPE) != N_SECT || (sym.type & N_EXT) == 0)
+                continue;
+
+            if (sym.value < text.vmaddr || sym.value - text.vmaddr >= text.vmsize || sym.value - text.vmaddr > UINT32_MAX)
+                continue;
+
+            if (sym.strx == 0 || sym.strx >= strsize || strings[sym.strx] == '\0' ||
+                memchr(strings + sym.strx, '\0', strsize - sym.strx) == NULL)
+            {
+                continue;
+            }
+
+            if (pass == 1) {
+                symtab->entries[count].address = (uint32_t) (sym.value - text.vmaddr);
+                symtab->entries[count].name = sym.strx;
+            }
+            count++;
+        }
+
+        if (pass == 0) {
+            if (count == 0)
+                return PLCRASH_ENOTSUP;
+
+            if (count > max_count) {
+                PLCF_DEBUG("Image at %p exports %" PRIu32 " symbols, exceeding the limit of %" PRIu32, header, count, max_count);
+                return PLCRASH_ENOMEM;
+            }
+
+            symtab->entries = malloc(count * sizeof(plcrash_async_symtab_entry_t));
+            if (symtab->entries == NULL)
+                return PLCRASH_ENOMEM;
+        }
+    }
+
+    /* Sort, retaining a single entry per address */
+    qsort(symtab->entries, count, sizeof(plcrash_async_symtab_entry_t), compare_entries);
+
+    uint32_t unique = 1;
+    for (uint32_t i = 1; i < count; i++) {
+        if (symtab->entries[i].address != symtab->entries[unique - 1].address)
+            symtab->entries[unique++] = symtab->entries[i];
+    }
+
+    if (unique < count) {
+        plcrash_async_symtab_entry_t *entries = realloc(symtab->entries, unique * sizeof(plcrash_async_symtab_entry_t));
+        if (entries != NULL)
+            symtab->entries = entries;
+    }
+
+    symtab->strings = strings;
+    symtab->text_size = text.vmsize;
+    symtab->count = unique;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Find the nearest symbol at or below @a offset. This function is async-safe.
+ *
+ * @param symtab The symbol table to search.
+ * @param offset The address to look up, relative to the image's Mach-O header.
+ * @param name On success, the symbol's NUL-terminated name, as stored in the image's string table.
+ * @param symbol_offset On success, the offset of @a offset from the symbol's address.
+ *
+ * @return Returns true if a symbol was found. Addresses outside the image's __TEXT segment are not resolved.
+ */
+bool plcrash_async_symtab_lookup (const plcrash_async_symtab_t *symtab, uint64_t offset, const char **name, uint64_t *symbol_offset) {
+    if (symtab->count == 0 || offset >= symtab->text_size)
+        return false;
+
+    /* Find the first entry above the offset */
+    uint32_t low = 0;
+    uint32_t high = symtab->count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (symtab->entries[mid].address <= offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low == 0)
+        return false;
+
+    const plcrash_async_symtab_entry_t *entry = &symtab->entries[low - 1];
+    *name = symtab->strings + entry->name;
+    *symbol_offset = offset - entry->address;
+
+    return true;
+}
+
+/**
+ * Return the number of bytes allocated by @a symtab.
+ */
+size_t plcrash_async_symtab_size (const plcrash_async_symtab_t *symtab) {
+    return symtab->count * sizeof(plcrash_async_symtab_entry_t);
+}
+
+/**
+ * Free any symbol table resources.
+ *
+ * @warning This function is not async-safe.
+ */
+void plcrash_async_symtab_free (plcrash_async_symtab_t *symtab) {
+    if (symtab->entries != NULL)
+        free(symtab->entries);
+
+    memset(symtab, 0, sizeof(*symtab));
+}
+
+/**
+ * @} plcrash_async_symtab
+ */
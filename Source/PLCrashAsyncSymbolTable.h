@@ -0,0 +1,73 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#import "PLCrashAsync.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_async_symtab
+ *
+ * Symbol table entry.
+ */
+typedef struct plcrash_async_symtab_entry {
+    /** The symbol's address, relative to the image's Mach-O header */
+    uint32_t address;
+
+    /** Offset of the symbol's NUL-terminated name within the image's string table */
+    uint32_t name;
+} plcrash_async_symtab_entry_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_async_symtab
+ *
+ * Async-safe symbol table of a loaded image's exported symbols, sorted by address. Symbol names are not copied; they
+ * reference the image's string table, which remains mapped for as long as the image is loaded.
+ */
+typedef struct plcrash_async_symtab {
+    /** The image's in-memory string table */
+    const char *strings;
+
+    /** Size of the __TEXT segment. Addresses at or beyond this offset from the image header are not resolved. */
+    uint64_t text_size;
+
+    /** Number of entries */
+    uint32_t count;
+
+    /** Symbol entries, sorted by address. No two entries share an address. */
+    plcrash_async_symtab_entry_t *entries;
+} plcrash_async_symtab_t;
+
+plcrash_error_t plcrash_async_symtab_init (plcrash_async_symtab_t *symtab, const void *header, uint32_t max_count);
+bool plcrash_async_symtab_lookup (const plcrash_async_symtab_t *symtab, uint64_t offset, const char **name, uint64_t *symbol_offset);
+size_t plcrash_async_symtab_size (const plcrash_async_symtab_t *symtab);
+void plcrash_async_symtab_free (plcrash_async_symtab_t *symtab);
@@ -0,0 +1,317 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+
+#import "PLCrashAsyncSymbolTable.h"
+
+#import <dlfcn.h>
+#import <mach-o/loader.h>
+#import <mach-o/nlist.h>
+
+@interface PLCrashAsyncSymbolTableTests : SenTestCase {
+@private
+    /** Synthetic image, or NULL */
+    uint8_t *_image;
+}
+@end
+
+/* Synthetic image layout. The __TEXT segment (which includes the Mach-O header) is followed by __LINKEDIT, which
+ * holds the symbol table and then the string table. */
+#define TEXT_SIZE 0x2000
+#define LINKEDIT_SIZE 0x1000
+#define SYMTAB_OFFSET TEXT_SIZE
+#define STRTAB_OFFSET (TEXT_SIZE + 0x800)
+
+/* Synthetic string table, and the offset of each name within it */
+static const char test_strings[] = "\0_local\0_foo\0_alias\0_bar\0_data\0_printf";
+enum {
+    STR_LOCAL = 1,
+    STR_FOO = 8,
+    STR_ALIAS = 13,
+    STR_BAR = 20,
+    STR_DATA = 25,
+    STR_PRINTF = 31
+};
+
+/* Synthetic symbols: a local symbol, four defined external symbols (two sharing an address, and one outside of
+ * __TEXT), and an undefined symbol. */
+static const struct {
+    uint32_t strx;
+    uint8_t type;
+    uint64_t offset;
+} test_symbols[] = {
+    { STR_LOCAL,  N_SECT,         0x180 },
+    { STR_FOO,    N_SECT | N_EXT, 0x100 },
+    { STR_ALIAS,  N_SECT | N_EXT, 0x100 },
+    { STR_BAR,    N_SECT | N_EXT, 0x200 },
+    { STR_DATA,   N_SECT | N_EXT, TEXT_SIZE + 0x100 },
+    { STR_PRINTF, N_UNDF | N_EXT, 0 }
+};
+#define TEST_SYMBOL_COUNT (sizeof(test_symbols) / sizeof(test_symbols[0]))
+
+static uint8_t *append_segment (uint8_t *cursor, bool is64, const char *name, uint64_t vmaddr, uint64_t vmsize, uint64_t fileoff) {
+    if (is64) {
+        struct segment_command_64 *segment = (struct segment_command_64 *) cursor;
+        segment->cmd = LC_SEGMENT_64;
+        segment->cmdsize = sizeof(*segment);
+        strncpy(segment->segname, name, sizeof(segment->segname));
+        segment->vmaddr = vmaddr;
+        segment->vmsize = vmsize;
+        segment->fileoff = fileoff;
+        segment->filesize = vmsize;
+        return cursor + sizeof(*segment);
+    } else {
+        struct segment_command *segment = (struct segment_command *) cursor;
+        segment->cmd = LC_SEGMENT;
+        segment->cmdsize = sizeof(*segment);
+        strncpy(segment->segname, name, sizeof(segment->segname));
+        segment->vmaddr = (uint32_t) vmaddr;
+        segment->vmsize = (uint32_t) vmsize;
+        segment->fileoff = (uint32_t) fileoff;
+        segment->filesize = (uint32_t) vmsize;
+        return cursor + sizeof(*segment);
+    }
+}
+
+/* Build a synthetic image, as it would be mapped in-process. */
+static uint8_t *build_image (bool is64, bool dysymtab) {
+    uint8_t *image = calloc(1, TEXT_SIZE + LINKEDIT_SIZE);
+    uint64_t text_vmaddr = is64 ? 0x100000000ULL : 0x1000;
+    uint8_t *cursor;
+    uint32_t ncmds = 0;
+
+    cursor = image + (is64 ? sizeof(struct mach_header_64) : sizeof(struct mach_header));
+
+    /* Segments */
+    cursor = append_segment(cursor, is64, SEG_TEXT, text_vmaddr, TEXT_SIZE, 0);
+    cursor = append_segment(cursor, is64, SEG_LINKEDIT, text_vmaddr + TEXT_SIZE, LINKEDIT_SIZE, TEXT_SIZE);
+    ncmds += 2;
+
+    /* Symbol table */
+    struct symtab_command *symtab = (struct symtab_command *) cursor;
+    symtab->cmd = LC_SYMTAB;
+    symtab->cmdsize = sizeof(*symtab);
+    symtab->symoff = SYMTAB_OFFSET;
+    symtab->nsyms = TEST_SYMBOL_COUNT;
+    symtab->stroff = STRTAB_OFFSET;
+    symtab->strsize = sizeof(test_strings);
+    cursor += sizeof(*symtab);
+    ncmds++;
+
+    /* Symbol groupings */
+    if (dysymtab) {
+        struct dysymtab_command *dysym = (struct dysymtab_command *) cursor;
+        dysym->cmd = LC_DYSYMTAB;
+        dysym->cmdsize = sizeof(*dysym);
+        dysym->ilocalsym = 0;
+        dysym->nlocalsym = 1;
+        dysym->iextdefsym = 1;
+        dysym->nextdefsym = 4;
+        dysym->iundefsym = 5;
+        dysym->nundefsym = 1;
+        cursor += sizeof(*dysym);
+        ncmds++;
+    }
+
+    /* Header */
+    uint32_t sizeofcmds = (uint32_t) (cursor - image) - (is64 ? sizeof(struct mach_header_64) : sizeof(struct mach_header));
+    if (is64) {
+        struct mach_header_64 *header = (struct mach_header_64 *) image;
+        header->magic = MH_MAGIC_64;
+        header->filetype = MH_DYLIB;
+        header->ncmds = ncmds;
+        header->sizeofcmds = sizeofcmds;
+    } else {
+        struct mach_header *header = (struct mach_header *) image;
+        header->magic = MH_MAGIC;
+        header->filetype = MH_DYLIB;
+        header->ncmds = ncmds;
+        header->sizeofcmds = sizeofcmds;
+    }
+
+    /* Symbols and strings */
+    for (uint32_t i = 0; i < TEST_SYMBOL_COUNT; i++) {
+        uint64_t value = (test_symbols[i].type & N_TYPE) == N_SECT ? text_vmaddr + test_symbols[i].offset : 0;
+
+        if (is64) {
+            struct nlist_64 *nl = (struct nlist_64 *) (image + SYMTAB_OFFSET) + i;
+            nl->n_un.n_strx = test_symbols[i].strx;
+            nl->n_type = test_symbols[i].type;
+            nl->n_sect = (test_symbols[i].type & N_TYPE) == N_SECT ? 1 : NO_SECT;
+            nl->n_value = value;
+        } else {
+            struct nlist *nl = (struct nlist *) (image + SYMTAB_OFFSET) + i;
+            nl->n_un.n_strx = test_symbols[i].strx;
+            nl->n_type = test_symbols[i].type;
+            nl->n_sect = (test_symbols[i].type & N_TYPE) == N_SECT ? 1 : NO_SECT;
+            nl->n_value = (uint32_t) value;
+        }
+    }
+    memcpy(image + STRTAB_OFFSET, test_strings, sizeof(test_strings));
+
+    return image;
+}
+
+@implementation PLCrashAsyncSymbolTableTests
+
+- (void) tearDown {
+    free(_image);
+    _image = NULL;
+}
+
+- (void) checkImage: (uint8_t *) image {
+    plcrash_async_symtab_t symtab;
+    const char *name;
+    uint64_t offset;
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_symtab_init(&symtab, image, UINT32_MAX), @"Failed to build table");
+
+    /* Only the external symbols within __TEXT are recorded, with a single entry per address */
+    STAssertEquals((uint32_t) 2, symtab.count, @"Incorrect symbol count");
+    STAssertEquals((uint64_t) TEXT_SIZE, symtab.text_size, @"Incorrect text size");
+    STAssertEquals(symtab.count * sizeof(plcrash_async_symtab_entry_t), plcrash_async_symtab_size(&symtab), @"Incorrect table size");
+
+    /* Exact and interior addresses */
+    STAssertTrue(plcrash_async_symtab_lookup(&symtab, 0x100, &name, &offset), @"Lookup failed");
+    STAssertEqualCStrings("_foo", name, @"Incorrect symbol");
+    STAssertEquals((uint64_t) 0, offset, @"Incorrect offset");
+
+    STAssertTrue(plcrash_async_symtab_lookup(&symtab, 0x1ff, &name, &offset), @"Lookup failed");
+    STAssertEqualCStrings("_foo", name, @"Incorrect symbol");
+    STAssertEquals((uint64_t) 0xff, offset, @"Incorrect offset");
+
+    STAssertTrue(plcrash_async_symtab_lookup(&symtab, 0x200, &name, &offset), @"Lookup failed");
+    STAssertEqualCStrings("_bar", name, @"Incorrect symbol");
+    STAssertEquals((uint64_t) 0, offset, @"Incorrect offset");
+
+    STAssertTrue(plcrash_async_symtab_lookup(&symtab, TEXT_SIZE - 1, &name, &offset), @"Lookup failed");
+    STAssertEqualCStrings("_bar", name, @"Incorrect symbol");
+    STAssertEquals((uint64_t) TEXT_SIZE - 1 - 0x200, offset, @"Incorrect offset");
+
+    /* Addresses before the first symbol, and beyond __TEXT */
+    STAssertFalse(plcrash_async_symtab_lookup(&symtab, 0xff, &name, &offset), @"Lookup should fail before the first symbol");
+    STAssertFalse(plcrash_async_symtab_lookup(&symtab, TEXT_SIZE, &name, &offset), @"Lookup should fail beyond __TEXT");
+
+    plcrash_async_symtab_free(&symtab);
+}
+
+- (void) testLookup64 {
+    _image = build_image(true, true);
+    [self checkImage: _image];
+}
+
+- (void) testLookup32 {
+    _image = build_image(false, true);
+    [self checkImage: _image];
+}
+
+/* Without LC_DYSYMTAB, all symbols are scanned for external definitions */
+- (void) testNoDysymtab {
+    _image = build_image(true, false);
+    [self checkImage: _image];
+}
+
+/* An image exceeding the entry limit is rejected, rather than truncated */
+- (void) testLimit {
+    plcrash_async_symtab_t symtab;
+
+    _image = build_image(true, true);
+    STAssertEquals(PLCRASH_ENOMEM, plcrash_async_symtab_init(&symtab, _image, 1), @"Table should exceed the limit");
+    STAssertNULL(symtab.entries, @"No table should be allocated");
+    STAssertEquals((uint32_t) 0, symtab.count, @"Table should be empty");
+
+    /* An empty table resolves nothing */
+    const char *name;
+    uint64_t offset;
+    STAssertFalse(plcrash_async_symtab_lookup(&symtab, 0x100, &name, &offset), @"Lookup should fail");
+}
+
+- (void) testInvalid {
+    plcrash_async_symtab_t symtab;
+    struct mach_header_64 *header;
+    struct symtab_command *symcmd;
+    struct load_command *cmd;
+
+    /* Bad magic */
+    _image = build_image(true, true);
+    header = (struct mach_header_64 *) _image;
+    header->magic = 0;
+    STAssertEquals(PLCRASH_EINVAL, plcrash_async_symtab_init(&symtab, _image, UINT32_MAX), @"Bad magic accepted");
+    free(_image);
+
+    /* Load command overrunning sizeofcmds */
+    _image = build_image(true, true);
+    header = (struct mach_header_64 *) _image;
+    cmd = (struct load_command *) (header + 1);
+    cmd->cmdsize = header->sizeofcmds + 8;
+    STAssertEquals(PLCRASH_EINVAL, plcrash_async_symtab_init(&symtab, _image, UINT32_MAX), @"Overlong load command accepted");
+    free(_image);
+
+    /* Zero-length load command */
+    _image = build_image(true, true);
+    cmd = (struct load_command *) ((struct mach_header_64 *) _image + 1);
+    cmd->cmdsize = 0;
+    STAssertEquals(PLCRASH_EINVAL, plcrash_async_symtab_init(&symtab, _image, UINT32_MAX), @"Empty load command accepted");
+    free(_image);
+
+    /* Symbol table outside of __LINKEDIT */
+    _image = build_image(true, true);
+    symcmd = (struct symtab_command *) ((uint8_t *) ((struct mach_header_64 *) _image + 1) + 2 * sizeof(struct segment_command_64));
+    symcmd->nsyms = LINKEDIT_SIZE;
+    STAssertEquals(PLCRASH_EINVAL, plcrash_async_symtab_init(&symtab, _image, UINT32_MAX), @"Out of bounds symbol table accepted");
+    free(_image);
+
+    /* No symbol table */
+    _image = build_image(true, true);
+    symcmd = (struct symtab_command *) ((uint8_t *) ((struct mach_header_64 *) _image + 1) + 2 * sizeof(struct segment_command_64));
+    symcmd->cmd = LC_UUID;
+    STAssertEquals(PLCRASH_ENOTSUP, plcrash_async_symtab_init(&symtab, _image, UINT32_MAX), @"Missing symbol table accepted");
+}
+
+/* Resolve one of our own exported functions, and compare against dladdr() */
+- (void) testLoadedImage {
+    plcrash_async_symtab_t symtab;
+    const char *name;
+    uint64_t offset;
+    Dl_info info;
+
+    uintptr_t pc = (uintptr_t) &plcrash_async_symtab_lookup + 4;
+    STAssertTrue(dladdr((void *) pc, &info) != 0, @"dladdr() failed");
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_async_symtab_init(&symtab, info.dli_fbase, UINT32_MAX), @"Failed to build table");
+    STAssertTrue(plcrash_async_symtab_lookup(&symtab, pc - (uintptr_t) info.dli_fbase, &name, &offset), @"Lookup failed");
+
+    /* dladdr() omits the leading underscore */
+    STAssertEqualCStrings(info.dli_sname, name + 1, @"Symbol does not match dladdr()");
+    STAssertEquals((uint64_t) (pc - (uintptr_t) info.dli_saddr), offset, @"Offset does not match dladdr()");
+
+    plcrash_async_symtab_free(&symtab);
+}
+
+@end
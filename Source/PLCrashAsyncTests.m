@@ -108,6 +108,32 @@
     STAssertEquals((off_t)8, fs.st_size, @"File size is not 8 bytes");
 }
 
+- (void) testPatch {
+    plcrash_async_file_t file;
+    uint32_t data = 0;
+    uint32_t patch = 0xFFFFFFFF;
+
+    plcrash_async_file_init(&file, _testFd, 0);
+
+    /* Write out three words, and then patch the second */
+    for (int i = 0; i < 3; i++) {
+        STAssertEquals((off_t) (i * sizeof(data)), plcrash_async_file_offset(&file), @"Incorrect offset");
+        STAssertTrue(plcrash_async_file_write(&file, &data, sizeof(data)), @"Write failed");
+    }
+
+    STAssertTrue(plcrash_async_file_patch(&file, sizeof(data), &patch, sizeof(patch)), @"Patch failed");
+    STAssertFalse(plcrash_async_file_patch(&file, 2 * sizeof(data) + 1, &patch, sizeof(patch)), @"Patch past the end of the output accepted");
+
+    /* Writes continue at the end of the output */
+    STAssertTrue(plcrash_async_file_write(&file, &data, sizeof(data)), @"Write failed");
+    STAssertTrue(plcrash_async_file_close(&file), @"File not closed");
+
+    uint32_t expected[] = { 0, 0xFFFFFFFF, 0, 0 };
+    NSData *contents = [NSData dataWithContentsOfFile: _outputFile];
+    STAssertEquals((NSUInteger) sizeof(expected), [contents length], @"Incorrect file size");
+    STAssertTrue(memcmp(expected, [contents bytes], sizeof(expected)) == 0, @"Incorrect file contents");
+}
+
 /*
  * Read in the test file, verify that it matches the given data block. Returns the
  * total number of bytes read (which may be less than the data block, which will
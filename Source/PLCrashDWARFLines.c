@@ -0,0 +1,1315 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashDWARFLines.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_dwarf_lines DWARF Line Tables
+ * @ingroup plcrash_internal
+ *
+ * Source file and line lookup from the DWARF __debug_line section of a Mach-O image or dSYM.
+ *
+ * On initialization, only an address range index over the image's compile units is built, from __debug_aranges
+ * where available, or otherwise from the DW_AT_low_pc, DW_AT_high_pc, and DW_AT_ranges attributes of each compile
+ * unit. A compile unit's line program is decoded when an address within the unit is first looked up, and decoded
+ * line tables are retained in a least recently used cache with a fixed memory limit. The debug information itself is memory mapped,
+ * and only the pages touched by decoding are read, so memory use remains bounded regardless of the size of the
+ * debug information.
+ *
+ * DWARF versions 2 through 4 are supported; compile units and line programs of other versions produce no line
+ * information.
+ *
+ * @{
+ */
+
+/* DWARF constants. See the DWARF 4 specification, section 7. */
+#define DW_AT_stmt_list         0x10
+#define DW_AT_low_pc            0x11
+#define DW_AT_high_pc           0x12
+#define DW_AT_ranges            0x55
+
+#define DW_FORM_addr            0x01
+#define DW_FORM_block2          0x03
+#define DW_FORM_block4          0x04
+#define DW_FORM_data2           0x05
+#define DW_FORM_data4           0x06
+#define DW_FORM_data8           0x07
+#define DW_FORM_string          0x08
+#define DW_FORM_block           0x09
+#define DW_FORM_block1          0x0a
+#define DW_FORM_data1           0x0b
+#define DW_FORM_flag            0x0c
+#define DW_FORM_sdata           0x0d
+#define DW_FORM_strp            0x0e
+#define DW_FORM_udata           0x0f
+#define DW_FORM_ref_addr        0x10
+#define DW_FORM_ref1            0x11
+#define DW_FORM_ref2            0x12
+#define DW_FORM_ref4            0x13
+#define DW_FORM_ref8            0x14
+#define DW_FORM_ref_udata       0x15
+#define DW_FORM_indirect        0x16
+#define DW_FORM_sec_offset      0x17
+#define DW_FORM_exprloc         0x18
+#define DW_FORM_flag_present    0x19
+#define DW_FORM_ref_sig8        0x20
+
+#define DW_LNS_copy                 1
+#define DW_LNS_advance_pc           2
+#define DW_LNS_advance_line         3
+#define DW_LNS_set_file             4
+#define DW_LNS_set_column           5
+#define DW_LNS_negate_stmt          6
+#define DW_LNS_set_basic_block      7
+#define DW_LNS_const_add_pc         8
+#define DW_LNS_fixed_advance_pc     9
+
+#define DW_LNE_end_sequence         1
+#define DW_LNE_set_address          2
+#define DW_LNE_define_file          3
+
+/** @internal Maximum nesting of DW_FORM_indirect forms. */
+#define MAX_INDIRECT_DEPTH 4
+
+/**
+ * @internal
+ *
+ * A bounds-checked reader of a DWARF section. Once a read fails, all further reads return 0.
+ */
+typedef struct dwarf_cursor {
+    /** Section contents */
+    const uint8_t *data;
+
+    /** Section size */
+    size_t len;
+
+    /** Current position */
+    size_t pos;
+
+    /** If true, multi-byte values are big-endian */
+    bool big_endian;
+
+    /** If true, a read has failed */
+    bool failed;
+} dwarf_cursor_t;
+
+/**
+ * @internal
+ *
+ * A compile unit header.
+ */
+typedef struct dwarf_unit_header {
+    /** Offset of the end of the unit */
+    uint64_t end;
+
+    /** DWARF version */
+    uint16_t version;
+
+    /** Size of section offsets: 4 for 32-bit DWARF, or 8 for 64-bit DWARF */
+    uint8_t offset_size;
+
+    /** Size of target addresses */
+    uint8_t address_size;
+
+    /** Offset of the unit's abbreviations within __debug_abbrev */
+    uint64_t abbrev_offset;
+
+    /** Offset of the unit's first DIE */
+    uint64_t die_offset;
+} dwarf_unit_header_t;
+
+/**
+ * @internal
+ *
+ * Attributes of a compile unit DIE.
+ */
+typedef struct dwarf_unit_attributes {
+    /** If true, line_offset is valid */
+    bool has_line_offset;
+
+    /** DW_AT_stmt_list */
+    uint64_t line_offset;
+
+    /** If true, low_pc and high_pc are valid */
+    bool has_range;
+
+    /** DW_AT_low_pc */
+    uint64_t low_pc;
+
+    /** DW_AT_high_pc, as an address */
+    uint64_t high_pc;
+
+    /** If true, ranges_offset is valid */
+    bool has_ranges;
+
+    /** DW_AT_ranges */
+    uint64_t ranges_offset;
+} dwarf_unit_attributes_t;
+
+/**
+ * @internal
+ *
+ * Return true if the host is big-endian.
+ */
+static bool host_big_endian (void) {
+    const uint16_t value = 1;
+    return *(const uint8_t *) &value == 0;
+}
+
+/**
+ * @internal
+ *
+ * Initialize @a c to read @a section from @a offset.
+ */
+static void cursor_init (dwarf_cursor_t *c, const plcrash_symbol_index_section_t *section, uint64_t offset) {
+    c->data = section->data;
+    c->len = section->size;
+    c->pos = (size_t) offset;
+    c->big_endian = host_big_endian() != section->swap;
+    c->failed = (offset > section->size);
+}
+
+/**
+ * @internal
+ *
+ * Verify that @a len bytes are available, marking the cursor as failed if not.
+ */
+static bool cursor_need (dwarf_cursor_t *c, uint64_t len) {
+    if (c->failed || len > c->len - c->pos)
+        c->failed = true;
+
+    return !c->failed;
+}
+
+/**
+ * @internal
+ *
+ * Move the cursor to @a offset, which must lie within the section.
+ */
+static void cursor_seek (dwarf_cursor_t *c, uint64_t offset) {
+    if (offset > c->len)
+        c->failed = true;
+    else
+        c->pos = (size_t) offset;
+}
+
+/**
+ * @internal
+ *
+ * Read an unsigned value of @a size bytes.
+ */
+static uint64_t read_sized (dwarf_cursor_t *c, uint8_t size) {
+    uint64_t value = 0;
+
+    if (size == 0 || size > 8 || !cursor_need(c, size)) {
+        c->failed = true;
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < size; i++) {
+        uint8_t byte = c->data[c->pos + (c->big_endian ? i : size - 1 - i)];
+        value = (value << 8) | byte;
+    }
+
+    c->pos += size;
+    return value;
+}
+
+/**
+ * @internal
+ *
+ * Read an unsigned LEB128 value.
+ */
+static uint64_t read_uleb (dwarf_cursor_t *c) {
+    uint64_t value = 0;
+    unsigned int shift = 0;
+
+    while (cursor_need(c, 1)) {
+        uint8_t byte = c->data[c->pos++];
+        if (shift < 64)
+            value |= (uint64_t) (byte & 0x7f) << shift;
+        shift += 7;
+
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * Read a signed LEB128 value.
+ */
+static int64_t read_sleb (dwarf_cursor_t *c) {
+    uint64_t value = 0;
+    unsigned int shift = 0;
+
+    while (cursor_need(c, 1)) {
+        uint8_t byte = c->data[c->pos++];
+        if (shift < 64)
+            value |= (uint64_t) (byte & 0x7f) << shift;
+        shift += 7;
+
+        if ((byte & 0x80) == 0) {
+            if (shift < 64 && (byte & 0x40) != 0)
+                value |= ~(uint64_t) 0 << shift;
+            return (int64_t) value;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @internal
+ *
+ * Read a NUL-terminated string. Returns NULL on failure.
+ */
+static const char *read_string (dwarf_cursor_t *c) {
+    if (c->failed || c->pos >= c->len) {
+        c->failed = true;
+        return NULL;
+    }
+
+    const char *str = (const char *) c->data + c->pos;
+    const char *end = memchr(str, '\0', c->len - c->pos);
+    if (end == NULL) {
+        c->failed = true;
+        return NULL;
+    }
+
+    c->pos += (end - str) + 1;
+    return str;
+}
+
+/**
+ * @internal
+ *
+ * Skip @a len bytes.
+ */
+static void skip (dwarf_cursor_t *c, uint64_t len) {
+    if (cursor_need(c, len))
+        c->pos += (size_t) len;
+}
+
+/**
+ * @internal
+ *
+ * Read an initial length field, returning the length of the data that follows it, and setting @a offset_size to
+ * 4 (32-bit DWARF) or 8 (64-bit DWARF). The cursor is marked as failed if the data extends past the section.
+ */
+static uint64_t read_initial_length (dwarf_cursor_t *c, uint8_t *offset_size) {
+    uint64_t length = read_sized(c, 4);
+
+    *offset_size = 4;
+    if (length == 0xffffffff) {
+        length = read_sized(c, 8);
+        *offset_size = 8;
+    } else if (length >= 0xfffffff0) {
+        c->failed = true;
+    }
+
+    if (!c->failed && length > c->len - c->pos)
+        c->failed = true;
+
+    return c->failed ? 0 : length;
+}
+
+/**
+ * @internal
+ *
+ * Read the value of an attribute of @a form. Address, constant, and section offset values are returned in
+ * @a value; other values are skipped, and @a value is set to 0. Returns false if the value could not be read.
+ */
+static bool read_attribute (dwarf_cursor_t *c, const dwarf_unit_header_t *unit, uint64_t form, uint64_t *value, unsigned int depth) {
+    *value = 0;
+
+    switch (form) {
+        case DW_FORM_addr:
+            *value = read_sized(c, unit->address_size);
+            break;
+
+        case DW_FORM_data1:
+        case DW_FORM_ref1:
+        case DW_FORM_flag:
+            *value = read_sized(c, 1);
+            break;
+
+        case DW_FORM_data2:
+        case DW_FORM_ref2:
+            *value = read_sized(c, 2);
+            break;
+
+        case DW_FORM_data4:
+        case DW_FORM_ref4:
+            *value = read_sized(c, 4);
+            break;
+
+        case DW_FORM_data8:
+        case DW_FORM_ref8:
+        case DW_FORM_ref_sig8:
+            *value = read_sized(c, 8);
+            break;
+
+        case DW_FORM_sdata:
+            *value = (uint64_t) read_sleb(c);
+            break;
+
+        case DW_FORM_udata:
+        case DW_FORM_ref_udata:
+            *value = read_uleb(c);
+            break;
+
+        case DW_FORM_strp:
+        case DW_FORM_sec_offset:
+            *value = read_sized(c, unit->offset_size);
+            break;
+
+        case DW_FORM_ref_addr:
+            /* DWARF 2 encodes DW_FORM_ref_addr as an address */
+            *value = read_sized(c, unit->version <= 2 ? unit->address_size : unit->offset_size);
+            break;
+
+        case DW_FORM_string:
+            read_string(c);
+            break;
+
+        case DW_FORM_block1:
+            skip(c, read_sized(c, 1));
+            break;
+
+        case DW_FORM_block2:
+            skip(c, read_sized(c, 2));
+            break;
+
+        case DW_FORM_block4:
+            skip(c, read_sized(c, 4));
+            break;
+
+        case DW_FORM_block:
+        case DW_FORM_exprloc:
+            skip(c, read_uleb(c));
+            break;
+
+        case DW_FORM_flag_present:
+            *value = 1;
+            break;
+
+        case DW_FORM_indirect:
+            if (depth >= MAX_INDIRECT_DEPTH)
+                return false;
+            return read_attribute(c, unit, read_uleb(c), value, depth + 1);
+
+        default:
+            return false;
+    }
+
+    return !c->failed;
+}
+
+/**
+ * @internal
+ *
+ * Read the header of the compile unit at @a offset within __debug_info.
+ */
+static bool read_unit_header (const plcrash_dwarf_lines_t *lines, uint64_t offset, dwarf_unit_header_t *unit) {
+    dwarf_cursor_t c;
+
+    cursor_init(&c, &lines->info, offset);
+    uint64_t length = read_initial_length(&c, &unit->offset_size);
+    unit->end = c.pos + length;
+
+    unit->version = read_sized(&c, 2);
+    unit->abbrev_offset = read_sized(&c, unit->offset_size);
+    unit->address_size = read_sized(&c, 1);
+    unit->die_offset = c.pos;
+
+    if (c.failed || unit->version < 2 || unit->version > 4 || unit->die_offset > unit->end)
+        return false;
+
+    return unit->address_size == 4 || unit->address_size == 8;
+}
+
+/**
+ * @internal
+ *
+ * Read the line program offset and address range of the compile unit DIE of @a unit.
+ */
+static bool read_unit_attributes (const plcrash_dwarf_lines_t *lines, const dwarf_unit_header_t *unit, dwarf_unit_attributes_t *attrs) {
+    dwarf_cursor_t die;
+    dwarf_cursor_t abbrev;
+
+    memset(attrs, 0, sizeof(*attrs));
+
+    cursor_init(&die, &lines->info, unit->die_offset);
+    uint64_t code = read_uleb(&die);
+    if (die.failed || code == 0)
+        return false;
+
+    /* Find the DIE's abbreviation */
+    cursor_init(&abbrev, &lines->abbrev, unit->abbrev_offset);
+    while (true) {
+        uint64_t abbrev_code = read_uleb(&abbrev);
+        if (abbrev.failed || abbrev_code == 0)
+            return false;
+
+        read_uleb(&abbrev); /* tag */
+        read_sized(&abbrev, 1); /* children */
+        if (abbrev_code == code)
+            break;
+
+        /* Skip this abbreviation's attribute specifications */
+        uint64_t name, form;
+        do {
+            name = read_uleb(&abbrev);
+            form = read_uleb(&abbrev);
+        } while (!abbrev.failed && (name != 0 || form != 0));
+    }
+
+    /* Read the attributes */
+    bool has_low_pc = false;
+    bool has_high_pc = false;
+    bool high_pc_offset = false;
+    while (true) {
+        uint64_t name = read_uleb(&abbrev);
+        uint64_t form = read_uleb(&abbrev);
+        uint64_t value;
+
+        if (abbrev.failed)
+            return false;
+        if (name == 0 && form == 0)
+            break;
+
+        if (!read_attribute(&die, unit, form, &value, 0))
+            return false;
+
+        switch (name) {
+            case DW_AT_stmt_list:
+                if (form == DW_FORM_data4 || form == DW_FORM_data8 || form == DW_FORM_sec_offset) {
+                    attrs->line_offset = value;
+                    attrs->has_line_offset = true;
+                }
+                break;
+
+            case DW_AT_low_pc:
+                if (form == DW_FORM_addr) {
+                    attrs->low_pc = value;
+                    has_low_pc = true;
+                }
+                break;
+
+            case DW_AT_ranges:
+                if (form == DW_FORM_data4 || form == DW_FORM_data8 || form == DW_FORM_sec_offset) {
+                    attrs->ranges_offset = value;
+                    attrs->has_ranges = true;
+                }
+                break;
+
+            case DW_AT_high_pc:
+                /* Since DWARF 4, a constant high_pc is an offset from low_pc */
+                attrs->high_pc = value;
+                high_pc_offset = (form != DW_FORM_addr);
+                has_high_pc = true;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (has_low_pc && has_high_pc) {
+        if (high_pc_offset)
+            attrs->high_pc += attrs->low_pc;
+        attrs->has_range = attrs->high_pc > attrs->low_pc;
+    }
+
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Order ranges by start address.
+ */
+static int range_compare (const void *a, const void *b) {
+    const plcrash_dwarf_range_t *lhs = a;
+    const plcrash_dwarf_range_t *rhs = b;
+
+    if (lhs->start != rhs->start)
+        return (lhs->start < rhs->start) ? -1 : 1;
+
+    return (lhs->end < rhs->end) ? -1 : (lhs->end > rhs->end);
+}
+
+/**
+ * @internal
+ *
+ * Order units by __debug_info offset.
+ */
+static int unit_compare (const void *a, const void *b) {
+    const plcrash_dwarf_unit_t *lhs = a;
+    const plcrash_dwarf_unit_t *rhs = b;
+
+    return (lhs->info_offset < rhs->info_offset) ? -1 : (lhs->info_offset > rhs->info_offset);
+}
+
+/**
+ * @internal
+ *
+ * Append a range to the lines' range list. The unit member of the range temporarily holds the unit's __debug_info
+ * offset, rather than its index.
+ */
+static bool append_range (plcrash_dwarf_lines_t *lines, size_t *capacity, uint64_t start, uint64_t end, uint64_t info_offset) {
+    if (lines->range_count == *capacity) {
+        size_t new_capacity = (*capacity > 0) ? *capacity * 2 : 64;
+        plcrash_dwarf_range_t *ranges = realloc(lines->ranges, new_capacity * sizeof(*ranges));
+        if (ranges == NULL)
+            return false;
+
+        lines->ranges = ranges;
+        *capacity = new_capacity;
+    }
+
+    plcrash_dwarf_range_t *range = &lines->ranges[lines->range_count++];
+    range->start = start;
+    range->end = end;
+    range->unit = (size_t) info_offset;
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Populate the range list from __debug_aranges.
+ */
+static bool read_aranges (plcrash_dwarf_lines_t *lines, const plcrash_symbol_index_section_t *aranges, size_t *capacity) {
+    dwarf_cursor_t c;
+
+    cursor_init(&c, aranges, 0);
+    while (!c.failed && c.pos < c.len) {
+        size_t set_start = c.pos;
+        uint8_t offset_size;
+
+        uint64_t length = read_initial_length(&c, &offset_size);
+        uint64_t set_end = c.pos + length;
+        if (c.failed)
+            break;
+
+        uint16_t version = read_sized(&c, 2);
+        uint64_t info_offset = read_sized(&c, offset_size);
+        uint8_t address_size = read_sized(&c, 1);
+        uint8_t segment_size = read_sized(&c, 1);
+
+        if (!c.failed && version == 2 && (address_size == 4 || address_size == 8) && segment_size == 0) {
+            /* Tuples are aligned to twice the address size, relative to the start of the set */
+            size_t tuple_size = address_size * 2;
+            cursor_seek(&c, set_start + ((c.pos - set_start + tuple_size - 1) / tuple_size) * tuple_size);
+
+            while (!c.failed && c.pos + tuple_size <= set_end) {
+                uint64_t address = read_sized(&c, address_size);
+                uint64_t size = read_sized(&c, address_size);
+                if (address == 0 && size == 0)
+                    break;
+
+                if (size > 0 && address + size > address && !append_range(lines, capacity, address, address + size, info_offset))
+                    return false;
+            }
+        }
+
+        c.failed = false;
+        cursor_seek(&c, set_end);
+    }
+
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Append the address ranges of the compile unit with index @a unit and attributes @a attrs to the range list,
+ * reading DW_AT_ranges from @a debug_ranges if available.
+ */
+static bool append_unit_ranges (plcrash_dwarf_lines_t *lines, size_t *capacity, const dwarf_unit_header_t *header,
+                                const dwarf_unit_attributes_t *attrs, const plcrash_symbol_index_section_t *debug_ranges, size_t unit)
+{
+    size_t first = lines->range_count;
+
+    if (attrs->has_range) {
+        if (!append_range(lines, capacity, attrs->low_pc, attrs->high_pc, 0))
+            return false;
+    } else if (attrs->has_ranges && debug_ranges != NULL) {
+        /* A list of address pairs relative to the base address, which defaults to the unit's DW_AT_low_pc */
+        uint64_t max_address = (header->address_size == 8) ? UINT64_MAX : UINT32_MAX;
+        uint64_t base = attrs->low_pc;
+        dwarf_cursor_t c;
+
+        cursor_init(&c, debug_ranges, attrs->ranges_offset);
+        while (!c.failed) {
+            uint64_t start = read_sized(&c, header->address_size);
+            uint64_t end = read_sized(&c, header->address_size);
+
+            if (c.failed || (start == 0 && end == 0))
+                break;
+
+            if (start == max_address) {
+                base = end;
+            } else if (end > start && !append_range(lines, capacity, base + start, base + end, 0)) {
+                return false;
+            }
+        }
+    }
+
+    for (size_t i = first; i < lines->range_count; i++)
+        lines->ranges[i].unit = unit;
+
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Build the compile unit and range lists.
+ */
+static plcrash_error_t build_index (plcrash_dwarf_lines_t *lines, const plcrash_symbol_index_section_t *aranges,
+                                    const plcrash_symbol_index_section_t *debug_ranges)
+{
+    size_t range_capacity = 0;
+    size_t unit_capacity = 0;
+
+    if (aranges != NULL && !read_aranges(lines, aranges, &range_capacity))
+        return PLCRASH_ENOMEM;
+
+    if (lines->range_count > 0) {
+        /* Create a unit for each distinct __debug_info offset; attributes are read on first use */
+        unit_capacity = lines->range_count;
+        if ((lines->units = malloc(unit_capacity * sizeof(*lines->units))) == NULL)
+            return PLCRASH_ENOMEM;
+
+        for (size_t i = 0; i < lines->range_count; i++) {
+            memset(&lines->units[i], 0, sizeof(lines->units[i]));
+            lines->units[i].info_offset = lines->ranges[i].unit;
+        }
+
+        qsort(lines->units, lines->range_count, sizeof(*lines->units), unit_compare);
+        for (size_t i = 0; i < lines->range_count; i++) {
+            if (lines->unit_count == 0 || lines->units[lines->unit_count - 1].info_offset != lines->units[i].info_offset)
+                lines->units[lines->unit_count++] = lines->units[i];
+        }
+
+        /* Replace each range's __debug_info offset with its unit index */
+        for (size_t i = 0; i < lines->range_count; i++) {
+            size_t lo = 0;
+            size_t hi = lines->unit_count;
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (lines->units[mid].info_offset < lines->ranges[i].unit)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            lines->ranges[i].unit = lo;
+        }
+    } else {
+        /* No usable __debug_aranges; read the ranges of every compile unit */
+        dwarf_unit_header_t header;
+        uint64_t offset = 0;
+
+        while (offset < lines->info.size && read_unit_header(lines, offset, &header)) {
+            dwarf_unit_attributes_t attrs;
+
+            if (lines->unit_count == unit_capacity) {
+                size_t new_capacity = (unit_capacity > 0) ? unit_capacity * 2 : 64;
+                plcrash_dwarf_unit_t *units = realloc(lines->units, new_capacity * sizeof(*units));
+                if (units == NULL)
+                    return PLCRASH_ENOMEM;
+
+                lines->units = units;
+                unit_capacity = new_capacity;
+            }
+
+            plcrash_dwarf_unit_t *unit = &lines->units[lines->unit_count];
+            memset(unit, 0, sizeof(*unit));
+            unit->info_offset = offset;
+            unit->resolved = true;
+
+            if (read_unit_attributes(lines, &header, &attrs)) {
+                unit->line_offset = attrs.line_offset;
+                unit->has_line_offset = attrs.has_line_offset;
+
+                if (!append_unit_ranges(lines, &range_capacity, &header, &attrs, debug_ranges, lines->unit_count))
+                    return PLCRASH_ENOMEM;
+            }
+
+            lines->unit_count++;
+            offset = header.end;
+        }
+    }
+
+    qsort(lines->ranges, lines->range_count, sizeof(*lines->ranges), range_compare);
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * @internal
+ *
+ * Return true if row @a lhs must be ordered after @a rhs. At equal addresses, the end of one sequence precedes the
+ * start of the next.
+ */
+static bool row_after (const plcrash_dwarf_line_row_t *lhs, const plcrash_dwarf_line_row_t *rhs) {
+    if (lhs->address != rhs->address)
+        return lhs->address > rhs->address;
+
+    return lhs->file != PLCRASH_DWARF_LINE_END && rhs->file == PLCRASH_DWARF_LINE_END;
+}
+
+/**
+ * @internal
+ *
+ * Stable sort of @a rows by address. Line programs usually emit their sequences in address order, in which case no
+ * sorting is performed.
+ */
+static bool sort_rows (plcrash_dwarf_line_row_t *rows, size_t count) {
+    bool sorted = true;
+    for (size_t i = 1; i < count && sorted; i++) {
+        if (row_after(&rows[i - 1], &rows[i]))
+            sorted = false;
+    }
+
+    if (sorted)
+        return true;
+
+    plcrash_dwarf_line_row_t *tmp = malloc(count * sizeof(*tmp));
+    if (tmp == NULL)
+        return false;
+
+    /* Bottom-up merge sort */
+    plcrash_dwarf_line_row_t *src = rows;
+    plcrash_dwarf_line_row_t *dst = tmp;
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t lo = 0; lo < count; lo += 2 * width) {
+            size_t mid = (lo + width < count) ? lo + width : count;
+            size_t hi = (lo + 2 * width < count) ? lo + 2 * width : count;
+            size_t i = lo, j = mid, k = lo;
+
+            while (i < mid && j < hi)
+                dst[k++] = row_after(&src[i], &src[j]) ? src[j++] : src[i++];
+            while (i < mid)
+                dst[k++] = src[i++];
+            while (j < hi)
+                dst[k++] = src[j++];
+        }
+
+        plcrash_dwarf_line_row_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != rows)
+        memcpy(rows, src, count * sizeof(*rows));
+
+    free(tmp);
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * A growable array.
+ */
+static bool grow (void **items, size_t *capacity, size_t count, size_t item_size) {
+    if (count < *capacity)
+        return true;
+
+    size_t new_capacity = (*capacity > 0) ? *capacity * 2 : 32;
+    void *new_items = realloc(*items, new_capacity * item_size);
+    if (new_items == NULL)
+        return false;
+
+    *items = new_items;
+    *capacity = new_capacity;
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Append a row to @a table.
+ */
+static bool append_row (plcrash_dwarf_line_table_t *table, size_t *capacity, uint64_t address, uint32_t file, uint32_t line) {
+    if (!grow((void **) &table->rows, capacity, table->row_count, sizeof(*table->rows)))
+        return false;
+
+    plcrash_dwarf_line_row_t *row = &table->rows[table->row_count++];
+    row->address = address;
+    row->file = file;
+    row->line = line;
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Free a decoded line table.
+ */
+static void table_free (plcrash_dwarf_line_table_t *table) {
+    free(table->rows);
+    free(table->files);
+    free(table);
+}
+
+/**
+ * @internal
+ *
+ * Decode the line program at @a offset within __debug_line. Returns NULL if the program could not be decoded.
+ */
+static plcrash_dwarf_line_table_t *decode_table (const plcrash_dwarf_lines_t *lines, uint64_t offset) {
+    dwarf_cursor_t c;
+    uint8_t offset_size;
+
+    plcrash_dwarf_line_table_t *table = calloc(1, sizeof(*table));
+    if (table == NULL)
+        return NULL;
+
+    /* Header */
+    cursor_init(&c, &lines->line, offset);
+    uint64_t length = read_initial_length(&c, &offset_size);
+    uint64_t end = c.pos + length;
+
+    uint16_t version = read_sized(&c, 2);
+    uint64_t header_length = read_sized(&c, offset_size);
+    uint64_t program = c.pos + header_length;
+
+    uint8_t min_inst_length = read_sized(&c, 1);
+    if (version >= 4)
+        read_sized(&c, 1); /* maximum_operations_per_instruction */
+    bool default_is_stmt = read_sized(&c, 1) != 0;
+    int8_t line_base = (int8_t) read_sized(&c, 1);
+    uint8_t line_range = read_sized(&c, 1);
+    uint8_t opcode_base = read_sized(&c, 1);
+    const uint8_t *opcode_lengths = c.data + c.pos;
+    skip(&c, opcode_base > 0 ? opcode_base - 1 : 0);
+
+    (void) default_is_stmt;
+    if (c.failed || version < 2 || version > 4 || line_range == 0 || opcode_base == 0 || program > end)
+        goto failed;
+
+    /* Include directories are not needed to produce file names */
+    const char *str;
+    while ((str = read_string(&c)) != NULL && *str != '\0');
+
+    /* File names */
+    size_t file_capacity = 0;
+    while ((str = read_string(&c)) != NULL && *str != '\0') {
+        read_uleb(&c); /* directory */
+        read_uleb(&c); /* modification time */
+        read_uleb(&c); /* length */
+
+        if (!grow((void **) &table->files, &file_capacity, table->file_count, sizeof(*table->files)))
+            goto failed;
+        table->files[table->file_count++] = str;
+    }
+
+    if (c.failed || c.pos > program)
+        goto failed;
+
+    /* Run the line program */
+    size_t row_capacity = 0;
+    uint64_t address = 0;
+    uint32_t file = 1;
+    int64_t line = 1;
+
+    cursor_seek(&c, program);
+    c.len = (size_t) end;
+    while (!c.failed && c.pos < c.len) {
+        uint8_t opcode = read_sized(&c, 1);
+
+        if (opcode >= opcode_base) {
+            /* Special opcode */
+            uint8_t adjusted = opcode - opcode_base;
+            address += (uint64_t) (adjusted / line_range) * min_inst_length;
+            line += line_base + (adjusted % line_range);
+            if (!append_row(table, &row_capacity, address, file, (uint32_t) line))
+                goto failed;
+            continue;
+        }
+
+        switch (opcode) {
+            case 0: {
+                /* Extended opcode */
+                uint64_t len = read_uleb(&c);
+                uint64_t next = c.pos + len;
+                if (c.failed || len == 0 || len > c.len - c.pos)
+                    goto failed;
+
+                switch (read_sized(&c, 1)) {
+                    case DW_LNE_end_sequence:
+                        if (!append_row(table, &row_capacity, address, PLCRASH_DWARF_LINE_END, 0))
+                            goto failed;
+                        address = 0;
+                        file = 1;
+                        line = 1;
+                        break;
+
+                    case DW_LNE_set_address:
+                        address = read_sized(&c, (uint8_t) (len - 1));
+                        break;
+
+                    case DW_LNE_define_file:
+                        if ((str = read_string(&c)) == NULL)
+                            goto failed;
+                        if (!grow((void **) &table->files, &file_capacity, table->file_count, sizeof(*table->files)))
+                            goto failed;
+                        table->files[table->file_count++] = str;
+                        break;
+
+                    default:
+                        break;
+                }
+
+                cursor_seek(&c, next);
+                break;
+            }
+
+            case DW_LNS_copy:
+                if (!append_row(table, &row_capacity, address, file, (uint32_t) line))
+                    goto failed;
+                break;
+
+            case DW_LNS_advance_pc:
+                address += read_uleb(&c) * min_inst_length;
+                break;
+
+            case DW_LNS_advance_line:
+                line += read_sleb(&c);
+                break;
+
+            case DW_LNS_set_file:
+                file = (uint32_t) read_uleb(&c);
+                break;
+
+            case DW_LNS_const_add_pc:
+                address += (uint64_t) ((255 - opcode_base) / line_range) * min_inst_length;
+                break;
+
+            case DW_LNS_fixed_advance_pc:
+                address += read_sized(&c, 2);
+                break;
+
+            default:
+                /* Skip the operands of any other standard opcode */
+                for (uint8_t i = 0; i < opcode_lengths[opcode - 1]; i++)
+                    read_uleb(&c);
+                break;
+        }
+    }
+
+    if (c.failed || !sort_rows(table->rows, table->row_count))
+        goto failed;
+
+    table->memory = sizeof(*table) + table->row_count * sizeof(*table->rows) + table->file_count * sizeof(*table->files);
+    return table;
+
+failed:
+    table_free(table);
+    return NULL;
+}
+
+/**
+ * @internal
+ *
+ * Remove @a table from the LRU list.
+ */
+static void lru_unlink (plcrash_dwarf_lines_t *lines, plcrash_dwarf_line_table_t *table) {
+    if (table->prev != NULL)
+        table->prev->next = table->next;
+    else
+        lines->lru_head = table->next;
+
+    if (table->next != NULL)
+        table->next->prev = table->prev;
+    else
+        lines->lru_tail = table->prev;
+
+    table->prev = table->next = NULL;
+}
+
+/**
+ * @internal
+ *
+ * Insert @a table at the head of the LRU list.
+ */
+static void lru_push (plcrash_dwarf_lines_t *lines, plcrash_dwarf_line_table_t *table) {
+    table->prev = NULL;
+    table->next = lines->lru_head;
+
+    if (lines->lru_head != NULL)
+        lines->lru_head->prev = table;
+    else
+        lines->lru_tail = table;
+
+    lines->lru_head = table;
+}
+
+/**
+ * @internal
+ *
+ * Return the decoded line table of @a unit, decoding it if necessary, and mark it as most recently used. Less recently
+ * used tables are evicted to remain within the memory limit; the returned table itself is never evicted.
+ */
+static plcrash_dwarf_line_table_t *unit_table (plcrash_dwarf_lines_t *lines, size_t index) {
+    plcrash_dwarf_unit_t *unit = &lines->units[index];
+
+    if (unit->table != NULL) {
+        if (lines->lru_head != unit->table) {
+            lru_unlink(lines, unit->table);
+            lru_push(lines, unit->table);
+        }
+        return unit->table;
+    }
+
+    if (unit->failed)
+        return NULL;
+
+    /* Read the unit's DW_AT_stmt_list on first use */
+    if (!unit->resolved) {
+        dwarf_unit_header_t header;
+        dwarf_unit_attributes_t attrs;
+
+        unit->resolved = true;
+        if (read_unit_header(lines, unit->info_offset, &header) && read_unit_attributes(lines, &header, &attrs)) {
+            unit->line_offset = attrs.line_offset;
+            unit->has_line_offset = attrs.has_line_offset;
+        }
+    }
+
+    plcrash_dwarf_line_table_t *table = NULL;
+    if (!unit->has_line_offset || (table = decode_table(lines, unit->line_offset)) == NULL) {
+        unit->failed = true;
+        return NULL;
+    }
+
+    table->unit = index;
+    unit->table = table;
+    lru_push(lines, table);
+    lines->memory += table->memory;
+
+    while (lines->memory > lines->memory_limit && lines->lru_tail != table) {
+        plcrash_dwarf_line_table_t *evict = lines->lru_tail;
+
+        lru_unlink(lines, evict);
+        lines->units[evict->unit].table = NULL;
+        lines->memory -= evict->memory;
+        table_free(evict);
+    }
+
+    return table;
+}
+
+/**
+ * Initialize line lookup for the Mach-O image with @a uuid within @a data, which must remain valid until
+ * plcrash_dwarf_lines_free() is called.
+ *
+ * @param lines The line lookup state to initialize.
+ * @param data Contents of a Mach-O binary or dSYM DWARF file, thin or fat.
+ * @param len Length of @a data.
+ * @param uuid The PLCRASH_SYMBOL_INDEX_UUID_LEN byte UUID of the image.
+ * @param memory_limit Limit on the memory used by decoded line tables, in bytes. The most recently used table is
+ * retained even if it alone exceeds the limit.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if no image with @a uuid and DWARF line information was
+ * found, or PLCRASH_ENOMEM if state could not be allocated.
+ */
+plcrash_error_t plcrash_dwarf_lines_init (plcrash_dwarf_lines_t *lines, const void *data, size_t len, const uint8_t *uuid, size_t memory_limit) {
+    plcrash_symbol_index_section_t text;
+    plcrash_symbol_index_section_t aranges;
+    plcrash_symbol_index_section_t ranges;
+    size_t slice_count = plcrash_symbol_index_slice_count(data, len);
+    size_t slice;
+
+    memset(lines, 0, sizeof(*lines));
+    lines->memory_limit = memory_limit;
+
+    for (slice = 0; slice < slice_count; slice++) {
+        uint8_t slice_uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+
+        if (plcrash_symbol_index_slice_uuid(data, len, slice, slice_uuid) == PLCRASH_ESUCCESS &&
+            memcmp(slice_uuid, uuid, PLCRASH_SYMBOL_INDEX_UUID_LEN) == 0)
+        {
+            break;
+        }
+    }
+
+    if (slice == slice_count)
+        return PLCRASH_EINVAL;
+
+    if (plcrash_symbol_index_slice_section(data, len, slice, "__TEXT", NULL, &text) != PLCRASH_ESUCCESS ||
+        plcrash_symbol_index_slice_section(data, len, slice, "__DWARF", "__debug_info", &lines->info) != PLCRASH_ESUCCESS ||
+        plcrash_symbol_index_slice_section(data, len, slice, "__DWARF", "__debug_abbrev", &lines->abbrev) != PLCRASH_ESUCCESS ||
+        plcrash_symbol_index_slice_section(data, len, slice, "__DWARF", "__debug_line", &lines->line) != PLCRASH_ESUCCESS)
+    {
+        return PLCRASH_EINVAL;
+    }
+
+    lines->text_vmaddr = text.vmaddr;
+
+    bool has_aranges = plcrash_symbol_index_slice_section(data, len, slice, "__DWARF", "__debug_aranges", &aranges) == PLCRASH_ESUCCESS;
+    bool has_ranges = plcrash_symbol_index_slice_section(data, len, slice, "__DWARF", "__debug_ranges", &ranges) == PLCRASH_ESUCCESS;
+    plcrash_error_t err = build_index(lines, has_aranges ? &aranges : NULL, has_ranges ? &ranges : NULL);
+    if (err != PLCRASH_ESUCCESS)
+        plcrash_dwarf_lines_free(lines);
+
+    return err;
+}
+
+/**
+ * Map the Mach-O binary or dSYM DWARF file at @a path, and initialize line lookup for the image with @a uuid.
+ *
+ * @param lines The line lookup state to initialize.
+ * @param path File path.
+ * @param uuid The PLCRASH_SYMBOL_INDEX_UUID_LEN byte UUID of the image.
+ * @param memory_limit Limit on the memory used by decoded line tables, in bytes.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if the file could not be mapped, or if no image with
+ * @a uuid and DWARF line information was found, or PLCRASH_ENOMEM if state could not be allocated.
+ */
+plcrash_error_t plcrash_dwarf_lines_open (plcrash_dwarf_lines_t *lines, const char *path, const uint8_t *uuid, size_t memory_limit) {
+    struct stat sb;
+    int fd;
+
+    memset(lines, 0, sizeof(*lines));
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return PLCRASH_EINVAL;
+
+    if (fstat(fd, &sb) != 0 || sb.st_size == 0 || (uint64_t) sb.st_size > SIZE_MAX) {
+        close(fd);
+        return PLCRASH_EINVAL;
+    }
+
+    void *map = mmap(NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return PLCRASH_EINVAL;
+
+    plcrash_error_t err = plcrash_dwarf_lines_init(lines, map, (size_t) sb.st_size, uuid, memory_limit);
+    if (err != PLCRASH_ESUCCESS) {
+        munmap(map, (size_t) sb.st_size);
+        return err;
+    }
+
+    lines->map = map;
+    lines->map_len = (size_t) sb.st_size;
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Look up the source file and line of @a address.
+ *
+ * @param lines Initialized line lookup state.
+ * @param address The address to look up, relative to the image's load address.
+ * @param file On success, the source file name, as recorded in the line program. The name is valid until @a lines
+ * is freed.
+ * @param line On success, the source line.
+ *
+ * @return Returns true if a line was found.
+ */
+bool plcrash_dwarf_lines_lookup (plcrash_dwarf_lines_t *lines, uint64_t address, const char **file, uint32_t *line) {
+    address += lines->text_vmaddr;
+
+    /* Find the last range starting at or before address */
+    size_t lo = 0;
+    size_t hi = lines->range_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (lines->ranges[mid].start <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == 0 || address >= lines->ranges[lo - 1].end)
+        return false;
+
+    plcrash_dwarf_line_table_t *table = unit_table(lines, lines->ranges[lo - 1].unit);
+    if (table == NULL)
+        return false;
+
+    /* Find the last row starting at or before address */
+    lo = 0;
+    hi = table->row_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (table->rows[mid].address <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == 0)
+        return false;
+
+    const plcrash_dwarf_line_row_t *row = &table->rows[lo - 1];
+    if (row->file == PLCRASH_DWARF_LINE_END || row->line == 0 || row->file == 0 || row->file > table->file_count)
+        return false;
+
+    *file = table->files[row->file - 1];
+    *line = row->line;
+    return true;
+}
+
+/**
+ * Free all resources associated with @a lines, including all decoded line tables.
+ */
+void plcrash_dwarf_lines_free (plcrash_dwarf_lines_t *lines) {
+    while (lines->lru_head != NULL) {
+        plcrash_dwarf_line_table_t *table = lines->lru_head;
+        lru_unlink(lines, table);
+        table_free(table);
+    }
+
+    free(lines->units);
+    free(lines->ranges);
+
+    if (lines->map != NULL)
+        munmap(lines->map, lines->map_len);
+
+    memset(lines, 0, sizeof(*lines));
+}
+
+/**
+ * @} plcrash_dwarf_lines
+ */
@@ -0,0 +1,197 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#import "PLCrashAsync.h"
+#import "PLCrashSymbolIndex.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_dwarf_lines
+ *
+ * Default limit on the memory used by decoded line tables, in bytes.
+ */
+#define PLCRASH_DWARF_LINES_DEFAULT_LIMIT (8 * 1024 * 1024)
+
+/**
+ * @internal
+ * @ingroup plcrash_dwarf_lines
+ *
+ * File index of a row marking the end of a sequence.
+ */
+#define PLCRASH_DWARF_LINE_END UINT32_MAX
+
+/**
+ * @internal
+ * @ingroup plcrash_dwarf_lines
+ *
+ * A decoded line table row.
+ */
+typedef struct plcrash_dwarf_line_row {
+    /** Address of the first instruction of the row */
+    uint64_t address;
+
+    /** The row's DWARF file number, or PLCRASH_DWARF_LINE_END if the row marks the end of a sequence */
+    uint32_t file;
+
+    /** Source line, or 0 if unknown */
+    uint32_t line;
+} plcrash_dwarf_line_row_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_dwarf_lines
+ *
+ * The decoded line table of a single compile unit.
+ */
+typedef struct plcrash_dwarf_line_table {
+    /** Rows, sorted by address */
+    plcrash_dwarf_line_row_t *rows;
+
+    /** Number of rows */
+    size_t row_count;
+
+    /** File names, referencing the mapped debug information */
+    const char **files;
+
+    /** Number of file names */
+    size_t file_count;
+
+    /** Memory used by the table, in bytes */
+    size_t memory;
+
+    /** Owning compile unit */
+    size_t unit;
+
+    /** Previous (more recently used) table in the LRU list */
+    struct plcrash_dwarf_line_table *prev;
+
+    /** Next (less recently used) table in the LRU list */
+    struct plcrash_dwarf_line_table *next;
+} plcrash_dwarf_line_table_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_dwarf_lines
+ *
+ * A compile unit.
+ */
+typedef struct plcrash_dwarf_unit {
+    /** Offset of the unit within __debug_info */
+    uint64_t info_offset;
+
+    /** Offset of the unit's line program within __debug_line. Only valid if has_line_offset is true. */
+    uint64_t line_offset;
+
+    /** If true, the unit's DW_AT_stmt_list has been read */
+    bool resolved;
+
+    /** If true, the unit has a line program */
+    bool has_line_offset;
+
+    /** If true, the unit's line program could not be decoded */
+    bool failed;
+
+    /** Decoded line table, or NULL if not cached */
+    plcrash_dwarf_line_table_t *table;
+} plcrash_dwarf_unit_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_dwarf_lines
+ *
+ * An address range covered by a compile unit.
+ */
+typedef struct plcrash_dwarf_range {
+    /** Start address */
+    uint64_t start;
+
+    /** End address (exclusive) */
+    uint64_t end;
+
+    /** Index of the compile unit */
+    size_t unit;
+} plcrash_dwarf_range_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_dwarf_lines
+ *
+ * Line number information of a single Mach-O image.
+ */
+typedef struct plcrash_dwarf_lines {
+    /** Mapped file, or NULL if the data is owned by the caller */
+    void *map;
+
+    /** Size of the mapping, in bytes */
+    size_t map_len;
+
+    /** __debug_info section */
+    plcrash_symbol_index_section_t info;
+
+    /** __debug_abbrev section */
+    plcrash_symbol_index_section_t abbrev;
+
+    /** __debug_line section */
+    plcrash_symbol_index_section_t line;
+
+    /** __TEXT segment address */
+    uint64_t text_vmaddr;
+
+    /** Compile units, sorted by info_offset */
+    plcrash_dwarf_unit_t *units;
+
+    /** Number of compile units */
+    size_t unit_count;
+
+    /** Compile unit address ranges, sorted by start address */
+    plcrash_dwarf_range_t *ranges;
+
+    /** Number of address ranges */
+    size_t range_count;
+
+    /** Most recently used decoded table */
+    plcrash_dwarf_line_table_t *lru_head;
+
+    /** Least recently used decoded table */
+    plcrash_dwarf_line_table_t *lru_tail;
+
+    /** Memory used by decoded tables, in bytes */
+    size_t memory;
+
+    /** Limit on memory used by decoded tables, in bytes */
+    size_t memory_limit;
+} plcrash_dwarf_lines_t;
+
+plcrash_error_t plcrash_dwarf_lines_init (plcrash_dwarf_lines_t *lines, const void *data, size_t len, const uint8_t *uuid, size_t memory_limit);
+plcrash_error_t plcrash_dwarf_lines_open (plcrash_dwarf_lines_t *lines, const char *path, const uint8_t *uuid, size_t memory_limit);
+bool plcrash_dwarf_lines_lookup (plcrash_dwarf_lines_t *lines, uint64_t address, const char **file, uint32_t *line);
+void plcrash_dwarf_lines_free (plcrash_dwarf_lines_t *lines);
@@ -0,0 +1,481 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+#import "PLCrashDWARFLines.h"
+#import "PLCrashSymbolCache.h"
+
+#import <mach/mach_time.h>
+
+@interface PLCrashDWARFLinesTests : SenTestCase {
+@private
+    /* Temporary directory for test images */
+    NSString *_tempPath;
+}
+@end
+
+/* Address of the __TEXT segment of the test image */
+#define TEST_TEXT_VMADDR 0x100000000ULL
+
+/* Offset of the first compile unit from the __TEXT segment, and the spacing and size of each unit's code */
+#define TEST_UNIT_BASE 0x1000
+#define TEST_UNIT_STRIDE 0x200
+#define TEST_UNIT_SIZE 0x100
+
+/* Number of compile units in the test image */
+#define TEST_UNIT_COUNT 64
+
+/* Number of lookups per pass in the lookup benchmark; roughly the frame count of a large report */
+#define BENCH_LOOKUPS 256
+
+/* Number of passes in the lookup benchmark */
+#define BENCH_ITERATIONS 1000
+
+/* A growable little-endian output buffer */
+typedef struct test_buffer {
+    uint8_t *data;
+    size_t len;
+} test_buffer_t;
+
+static void append (test_buffer_t *buf, const void *data, size_t len) {
+    buf->data = realloc(buf->data, buf->len + len);
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+}
+
+static void append_uint (test_buffer_t *buf, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        uint8_t byte = (i < sizeof(value)) ? (uint8_t) (value >> (i * 8)) : 0;
+        append(buf, &byte, 1);
+    }
+}
+
+static void append_name (test_buffer_t *buf, const char *name) {
+    char padded[16];
+    memset(padded, 0, sizeof(padded));
+    strncpy(padded, name, sizeof(padded));
+    append(buf, padded, sizeof(padded));
+}
+
+static void put_uint (test_buffer_t *buf, size_t offset, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++)
+        buf->data[offset + i] = (uint8_t) (value >> (i * 8));
+}
+
+/* Return the test image address of the first instruction of unit */
+static uint64_t unit_address (size_t unit) {
+    return TEST_TEXT_VMADDR + TEST_UNIT_BASE + unit * TEST_UNIT_STRIDE;
+}
+
+/*
+ * Build the DWARF sections of the test image. Each compile unit has a line program with rows for lines
+ * (unit * 10) + 1 and (unit * 10) + 2, covering the first and second half of the unit's code respectively.
+ */
+static void build_dwarf (size_t unit_count, test_buffer_t *info, test_buffer_t *abbrev, test_buffer_t *line, test_buffer_t *aranges) {
+    /* DW_TAG_compile_unit, no children: DW_AT_stmt_list (data4), DW_AT_low_pc (addr), DW_AT_high_pc (addr) */
+    static const uint8_t abbrev_data[] = { 1, 0x11, 0, 0x10, 0x06, 0x11, 0x01, 0x12, 0x01, 0, 0, 0 };
+    append(abbrev, abbrev_data, sizeof(abbrev_data));
+
+    for (size_t unit = 0; unit < unit_count; unit++) {
+        uint64_t address = unit_address(unit);
+        char file[32];
+
+        /* Address range set */
+        append_uint(aranges, 44, 4);
+        append_uint(aranges, 2, 2);
+        append_uint(aranges, info->len, 4);
+        append_uint(aranges, 8, 1);
+        append_uint(aranges, 0, 1);
+        append_uint(aranges, 0, 4); /* Pad the tuples to 16 bytes */
+        append_uint(aranges, address, 8);
+        append_uint(aranges, TEST_UNIT_SIZE, 8);
+        append_uint(aranges, 0, 8);
+        append_uint(aranges, 0, 8);
+
+        /* DWARF 2 compile unit */
+        append_uint(info, 28, 4);
+        append_uint(info, 2, 2);
+        append_uint(info, 0, 4);
+        append_uint(info, 8, 1);
+        append_uint(info, 1, 1);
+        append_uint(info, line->len, 4);
+        append_uint(info, address, 8);
+        append_uint(info, address + TEST_UNIT_SIZE, 8);
+
+        /* DWARF 2 line program header */
+        size_t line_start = line->len;
+        static const uint8_t line_header[] = {
+            1, /* minimum_instruction_length */
+            1, /* default_is_stmt */
+            (uint8_t) -5, /* line_base */
+            14, /* line_range */
+            13, /* opcode_base */
+            0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1, /* standard_opcode_lengths */
+            0 /* include_directories */
+        };
+        append_uint(line, 0, 4);
+        append_uint(line, 2, 2);
+        append_uint(line, 0, 4);
+        size_t header_start = line->len;
+        append(line, line_header, sizeof(line_header));
+
+        snprintf(file, sizeof(file), "src/unit%lu.c", (unsigned long) unit);
+        append(line, file, strlen(file) + 1);
+        append_uint(line, 0, 3); /* directory, modification time, length */
+        append_uint(line, 0, 1);
+        put_uint(line, header_start - 4, line->len - header_start, 4);
+
+        /* DW_LNE_set_address */
+        append_uint(line, 0, 1);
+        append_uint(line, 9, 1);
+        append_uint(line, 2, 1);
+        append_uint(line, address, 8);
+
+        /* DW_LNS_advance_line, DW_LNS_copy */
+        append_uint(line, 3, 1);
+        append_uint(line, unit * 10, 2);
+        put_uint(line, line->len - 2, ((unit * 10) & 0x7f) | 0x80, 1);
+        put_uint(line, line->len - 1, (unit * 10) >> 7, 1);
+        append_uint(line, 1, 1);
+
+        /* Special opcode: advance the address by half of the unit, and the line by one */
+        append_uint(line, 2, 1);
+        append_uint(line, TEST_UNIT_SIZE / 2, 2);
+        put_uint(line, line->len - 2, ((TEST_UNIT_SIZE / 2) & 0x7f) | 0x80, 1);
+        put_uint(line, line->len - 1, (TEST_UNIT_SIZE / 2) >> 7, 1);
+        append_uint(line, 13 + (1 - (-5)), 1);
+
+        /* DW_LNS_advance_pc to the end of the unit, DW_LNE_end_sequence */
+        append_uint(line, 2, 1);
+        append_uint(line, TEST_UNIT_SIZE / 2, 2);
+        put_uint(line, line->len - 2, ((TEST_UNIT_SIZE / 2) & 0x7f) | 0x80, 1);
+        put_uint(line, line->len - 1, (TEST_UNIT_SIZE / 2) >> 7, 1);
+        append_uint(line, 0, 1);
+        append_uint(line, 1, 1);
+        append_uint(line, 1, 1);
+
+        put_uint(line, line_start, line->len - line_start - 4, 4);
+    }
+}
+
+/*
+ * Build a little-endian 64-bit Mach-O image with a __TEXT,__text section, a symbol for each compile unit, and
+ * __DWARF debug sections. The caller is responsible for freeing the returned buffer's data.
+ */
+static test_buffer_t build_image (size_t unit_count, const uint8_t *uuid, bool with_aranges) {
+    test_buffer_t info = { NULL, 0 }, abbrev = { NULL, 0 }, line = { NULL, 0 }, aranges = { NULL, 0 };
+    test_buffer_t symbols = { NULL, 0 }, strings = { NULL, 0 };
+    test_buffer_t image = { NULL, 0 };
+
+    build_dwarf(unit_count, &info, &abbrev, &line, &aranges);
+
+    /* Symbol table; each unit has a single function */
+    append_uint(&strings, 0, 1);
+    for (size_t unit = 0; unit < unit_count; unit++) {
+        char name[32];
+
+        snprintf(name, sizeof(name), "_unit%lu", (unsigned long) unit);
+        append_uint(&symbols, strings.len, 4);
+        append_uint(&symbols, 0x0f, 1); /* N_SECT | N_EXT */
+        append_uint(&symbols, 1, 1);
+        append_uint(&symbols, 0, 2);
+        append_uint(&symbols, unit_address(unit), 8);
+        append(&strings, name, strlen(name) + 1);
+    }
+
+    const test_buffer_t *sections[] = { &info, &abbrev, &line, &aranges };
+    const char *section_names[] = { "__debug_info", "__debug_abbrev", "__debug_line", "__debug_aranges" };
+    uint32_t section_count = with_aranges ? 4 : 3;
+
+    uint32_t sizeofcmds = (72 + 80) + (72 + 80 * section_count) + 24 + 24;
+    uint64_t offset = 32 + sizeofcmds;
+
+    /* mach_header_64: MH_MAGIC_64, CPU_TYPE_X86_64, CPU_SUBTYPE_X86_64_ALL, MH_DSYM */
+    append_uint(&image, 0xfeedfacf, 4);
+    append_uint(&image, 0x01000007, 4);
+    append_uint(&image, 3, 4);
+    append_uint(&image, 0xa, 4);
+    append_uint(&image, 4, 4);
+    append_uint(&image, sizeofcmds, 4);
+    append_uint(&image, 0, 4);
+    append_uint(&image, 0, 4);
+
+    /* LC_SEGMENT_64 __TEXT, with a __text section containing no file data */
+    append_uint(&image, 0x19, 4);
+    append_uint(&image, 72 + 80, 4);
+    append_name(&image, "__TEXT");
+    append_uint(&image, TEST_TEXT_VMADDR, 8);
+    append_uint(&image, unit_address(unit_count), 8);
+    append_uint(&image, 0, 8);
+    append_uint(&image, 0, 8);
+    append_uint(&image, 5, 4);
+    append_uint(&image, 5, 4);
+    append_uint(&image, 1, 4);
+    append_uint(&image, 0, 4);
+
+    append_name(&image, "__text");
+    append_name(&image, "__TEXT");
+    append_uint(&image, unit_address(0), 8);
+    append_uint(&image, unit_address(unit_count) - unit_address(0), 8);
+    append_uint(&image, 0, 4 * 4);
+    append_uint(&image, 0x80000400, 4); /* S_ATTR_PURE_INSTRUCTIONS | S_ATTR_SOME_INSTRUCTIONS */
+    append_uint(&image, 0, 4 * 3);
+
+    /* LC_SEGMENT_64 __DWARF */
+    uint64_t dwarf_offset = offset + symbols.len + strings.len;
+    uint64_t dwarf_size = 0;
+    for (uint32_t i = 0; i < section_count; i++)
+        dwarf_size += sections[i]->len;
+
+    append_uint(&image, 0x19, 4);
+    append_uint(&image, 72 + 80 * section_count, 4);
+    append_name(&image, "__DWARF");
+    append_uint(&image, 0, 8);
+    append_uint(&image, dwarf_size, 8);
+    append_uint(&image, dwarf_offset, 8);
+    append_uint(&image, dwarf_size, 8);
+    append_uint(&image, 3, 4);
+    append_uint(&image, 3, 4);
+    append_uint(&image, section_count, 4);
+    append_uint(&image, 0, 4);
+
+    uint64_t section_offset = dwarf_offset;
+    for (uint32_t i = 0; i < section_count; i++) {
+        append_name(&image, section_names[i]);
+        append_name(&image, "__DWARF");
+        append_uint(&image, 0, 8);
+        append_uint(&image, sections[i]->len, 8);
+        append_uint(&image, section_offset, 4);
+        append_uint(&image, 0, 4 * 7);
+        section_offset += sections[i]->len;
+    }
+
+    /* LC_SYMTAB */
+    append_uint(&image, 0x2, 4);
+    append_uint(&image, 24, 4);
+    append_uint(&image, offset, 4);
+    append_uint(&image, unit_count, 4);
+    append_uint(&image, offset + symbols.len, 4);
+    append_uint(&image, strings.len, 4);
+
+    /* LC_UUID */
+    append_uint(&image, 0x1b, 4);
+    append_uint(&image, 24, 4);
+    append(&image, uuid, PLCRASH_SYMBOL_INDEX_UUID_LEN);
+
+    append(&image, symbols.data, symbols.len);
+    append(&image, strings.data, strings.len);
+    for (uint32_t i = 0; i < section_count; i++)
+        append(&image, sections[i]->data, sections[i]->len);
+
+    free(info.data);
+    free(abbrev.data);
+    free(line.data);
+    free(aranges.data);
+    free(symbols.data);
+    free(strings.data);
+
+    return image;
+}
+
+@implementation PLCrashDWARFLinesTests
+
+- (void) setUp {
+    _tempPath = [[NSTemporaryDirectory() stringByAppendingPathComponent: [[NSProcessInfo processInfo] globallyUniqueString]] retain];
+    [[NSFileManager defaultManager] createDirectoryAtPath: _tempPath withIntermediateDirectories: YES attributes: nil error: NULL];
+}
+
+- (void) tearDown {
+    STAssertTrue([[NSFileManager defaultManager] removeItemAtPath: _tempPath error: NULL], @"Could not remove temporary directory");
+    [_tempPath release];
+}
+
+/* Verify the lines of every unit, in the given order */
+- (void) assertLines: (plcrash_dwarf_lines_t *) lines unitCount: (size_t) unit_count stride: (size_t) stride {
+    for (size_t i = 0, unit = 0; i < unit_count; i++, unit = (unit + stride) % unit_count) {
+        uint64_t address = unit_address(unit) - TEST_TEXT_VMADDR;
+        char file[32];
+        const char *found_file;
+        uint32_t found_line;
+
+        snprintf(file, sizeof(file), "src/unit%lu.c", (unsigned long) unit);
+
+        STAssertTrue(plcrash_dwarf_lines_lookup(lines, address, &found_file, &found_line), @"No line for unit %lu", (unsigned long) unit);
+        STAssertTrue(strcmp(file, found_file) == 0, @"Incorrect file %s", found_file);
+        STAssertEquals((uint32_t) (unit * 10 + 1), found_line, @"Incorrect line");
+
+        STAssertTrue(plcrash_dwarf_lines_lookup(lines, address + TEST_UNIT_SIZE / 2 - 1, &found_file, &found_line), @"No line");
+        STAssertEquals((uint32_t) (unit * 10 + 1), found_line, @"Incorrect line");
+
+        STAssertTrue(plcrash_dwarf_lines_lookup(lines, address + TEST_UNIT_SIZE - 1, &found_file, &found_line), @"No line");
+        STAssertEquals((uint32_t) (unit * 10 + 2), found_line, @"Incorrect line");
+
+        /* The gap between units has no line information */
+        STAssertFalse(plcrash_dwarf_lines_lookup(lines, address + TEST_UNIT_SIZE, &found_file, &found_line), @"Found a line outside of the unit");
+    }
+}
+
+/* Verify lookups, with and without __debug_aranges */
+- (void) testLookup {
+    uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+    plcrash_dwarf_lines_t lines;
+    const char *file;
+    uint32_t line;
+
+    memset(uuid, 0x42, sizeof(uuid));
+    for (int with_aranges = 0; with_aranges <= 1; with_aranges++) {
+        test_buffer_t image = build_image(TEST_UNIT_COUNT, uuid, with_aranges);
+
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_dwarf_lines_init(&lines, image.data, image.len, uuid, PLCRASH_DWARF_LINES_DEFAULT_LIMIT), @"Could not read lines");
+        STAssertEquals((size_t) TEST_UNIT_COUNT, lines.unit_count, @"Incorrect unit count");
+
+        /* Line programs are only decoded on first use */
+        STAssertEquals((size_t) 0, lines.memory, @"Line programs were decoded eagerly");
+        [self assertLines: &lines unitCount: TEST_UNIT_COUNT stride: 1];
+
+        STAssertFalse(plcrash_dwarf_lines_lookup(&lines, 0, &file, &line), @"Found a line before the first unit");
+        STAssertFalse(plcrash_dwarf_lines_lookup(&lines, UINT64_MAX - TEST_TEXT_VMADDR, &file, &line), @"Found a line after the last unit");
+
+        plcrash_dwarf_lines_free(&lines);
+        free(image.data);
+    }
+}
+
+/* Verify that decoded line tables are evicted to remain within the memory limit */
+- (void) testMemoryLimit {
+    uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+    plcrash_dwarf_lines_t lines;
+
+    memset(uuid, 0x42, sizeof(uuid));
+    test_buffer_t image = build_image(TEST_UNIT_COUNT, uuid, true);
+
+    /* Determine the size of a single decoded table */
+    const char *file;
+    uint32_t line;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_dwarf_lines_init(&lines, image.data, image.len, uuid, 0), @"Could not read lines");
+    STAssertTrue(plcrash_dwarf_lines_lookup(&lines, unit_address(0) - TEST_TEXT_VMADDR, &file, &line), @"No line");
+    size_t table_size = lines.memory;
+    STAssertTrue(table_size > 0, @"No table was decoded");
+    plcrash_dwarf_lines_free(&lines);
+
+    /* Allow four tables, and look up units in an order that defeats the cache */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_dwarf_lines_init(&lines, image.data, image.len, uuid, table_size * 4), @"Could not read lines");
+    for (int pass = 0; pass < 3; pass++) {
+        [self assertLines: &lines unitCount: TEST_UNIT_COUNT stride: 7];
+        STAssertTrue(lines.memory <= table_size * 4, @"Memory limit exceeded: %lu", (unsigned long) lines.memory);
+    }
+
+    plcrash_dwarf_lines_free(&lines);
+    free(image.data);
+}
+
+/* Verify that images are matched by UUID, and that images without DWARF line information are rejected */
+- (void) testInvalid {
+    uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+    uint8_t other_uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+    plcrash_dwarf_lines_t lines;
+    char garbage[64];
+
+    memset(uuid, 0x42, sizeof(uuid));
+    memset(other_uuid, 0x43, sizeof(other_uuid));
+    test_buffer_t image = build_image(1, uuid, false);
+
+    STAssertEquals(PLCRASH_EINVAL, plcrash_dwarf_lines_init(&lines, image.data, image.len, other_uuid, PLCRASH_DWARF_LINES_DEFAULT_LIMIT), @"Matched an incorrect UUID");
+
+    memset(garbage, 0x42, sizeof(garbage));
+    STAssertEquals(PLCRASH_EINVAL, plcrash_dwarf_lines_init(&lines, garbage, sizeof(garbage), uuid, PLCRASH_DWARF_LINES_DEFAULT_LIMIT), @"Accepted a non-Mach-O file");
+
+    free(image.data);
+}
+
+/* Verify that the symbol cache links DWARF files, and returns the file and line of looked up symbols */
+- (void) testCache {
+    uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+    plcrash_symbol_cache_t cache;
+    plcrash_symbol_t symbol;
+
+    memset(uuid, 0x42, sizeof(uuid));
+    test_buffer_t image = build_image(TEST_UNIT_COUNT, uuid, true);
+    NSString *imagePath = [_tempPath stringByAppendingPathComponent: @"Test"];
+    STAssertTrue([[NSData dataWithBytes: image.data length: image.len] writeToFile: imagePath atomically: NO], @"Could not write image");
+    free(image.data);
+
+    NSString *cachePath = [_tempPath stringByAppendingPathComponent: @"cache"];
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_cache_init(&cache, [cachePath fileSystemRepresentation]), @"Could not create cache");
+
+    size_t added = 0;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_cache_add(&cache, [imagePath fileSystemRepresentation], &added), @"Could not add image");
+    STAssertEquals((size_t) 1, added, @"Incorrect index count");
+
+    uint64_t address = unit_address(3) - TEST_TEXT_VMADDR + TEST_UNIT_SIZE / 2 + 4;
+    STAssertTrue(plcrash_symbol_cache_lookup(&cache, uuid, address, &symbol), @"No symbol found");
+    STAssertTrue(strcmp("unit3", symbol.name) == 0, @"Incorrect symbol %s", symbol.name);
+    STAssertEquals((uint64_t) (TEST_UNIT_SIZE / 2 + 4), symbol.offset, @"Incorrect offset");
+    STAssertTrue(symbol.file != NULL && strcmp("src/unit3.c", symbol.file) == 0, @"Incorrect file");
+    STAssertEquals((uint32_t) 32, symbol.line, @"Incorrect line");
+
+    plcrash_symbol_cache_free(&cache);
+}
+
+/* Measure warm lookup latency, as when symbolicating a report against a populated cache */
+- (void) testLookupPerformance {
+    uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+    uint64_t addresses[BENCH_LOOKUPS];
+    plcrash_dwarf_lines_t lines;
+    const char *file;
+    uint32_t line;
+
+    memset(uuid, 0x42, sizeof(uuid));
+    test_buffer_t image = build_image(TEST_UNIT_COUNT, uuid, true);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_dwarf_lines_init(&lines, image.data, image.len, uuid, PLCRASH_DWARF_LINES_DEFAULT_LIMIT), @"Could not read lines");
+
+    for (size_t i = 0; i < BENCH_LOOKUPS; i++) {
+        addresses[i] = unit_address((i * 7) % TEST_UNIT_COUNT) - TEST_TEXT_VMADDR + (i % TEST_UNIT_SIZE);
+        plcrash_dwarf_lines_lookup(&lines, addresses[i], &file, &line);
+    }
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+
+    size_t found = 0;
+    uint64_t start = mach_absolute_time();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        for (size_t j = 0; j < BENCH_LOOKUPS; j++)
+            found += plcrash_dwarf_lines_lookup(&lines, addresses[j], &file, &line);
+    }
+    uint64_t elapsed_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    STAssertEquals((size_t) BENCH_LOOKUPS * BENCH_ITERATIONS, found, @"Lookups failed");
+    NSLog(@"%d passes of %d warm line lookups in %llu us (%.1f us per pass)", BENCH_ITERATIONS, BENCH_LOOKUPS,
+          elapsed_ns / 1000, elapsed_ns / 1000.0 / BENCH_ITERATIONS);
+
+    plcrash_dwarf_lines_free(&lines);
+    free(image.data);
+}
+
+@end
@@ -89,28 +89,49 @@ typedef int plframe_regnum_t;
 /** Platform-specific length of stack to be read when iterating frames */
 #define PLFRAME_STACKFRAME_LEN PLFRAME_PDEF_STACKFRAME_LEN
 
+/** Platform word type */
+typedef plframe_pdef_greg_t plframe_greg_t;
+
+/** Platform floating point register type */
+typedef plframe_pdef_fpreg_t plframe_fpreg_t;
+
 /**
  * @internal
  * Frame cursor context.
+ *
+ * The cursor holds only the state required to unwind the stack; the complete register state of a thread
+ * is only available when the cursor is initialized from a full thread context via plframe_cursor_init().
  */
 typedef struct plframe_cursor {
     /** true if this is the initial frame */
     bool init_frame;
     
-    /** Thread context */
+    /** Thread context, or NULL if the cursor was initialized via plframe_cursor_thread_init(). */
     ucontext_t *uap;
-    
+
+    /** Instruction pointer of the initial frame */
+    plframe_greg_t init_ip;
+
+    /** Frame pointer (stack pointer on PPC) of the initial frame */
+    plframe_greg_t init_fp;
+
     /** Stack frame data */
     void *fp[PLFRAME_STACKFRAME_LEN];
-    
-    // for thread-initialized cursors
-    /** Generated ucontext_t */
-    ucontext_t _uap_data;
-
-    /** Generated mcontext_t */
-    _STRUCT_MCONTEXT _mcontext_data;
 } plframe_cursor_t;
 
+/**
+ * @internal
+ * Caller-allocated storage for a thread's complete register state, including
+ * floating point and exception state. See plframe_thread_state_fetch().
+ */
+typedef struct plframe_thread_state {
+    /** Thread context. uap.uc_mcontext refers to the mcontext member. */
+    ucontext_t uap;
+
+    /** Machine context */
+    _STRUCT_MCONTEXT mcontext;
+} plframe_thread_state_t;
+
 /**
  * General pseudo-registers common across platforms.
  *
@@ -127,12 +148,6 @@ typedef enum {
 } plframe_gen_regnum_t;
 
 
-/** Platform word type */
-typedef plframe_pdef_greg_t plframe_greg_t;
-
-/** Platform floating point register type */
-typedef plframe_pdef_fpreg_t plframe_fpreg_t;
-
 
 /**
  * @internal
@@ -171,6 +186,10 @@ plframe_error_t plframe_cursor_init (plframe_cursor_t *cursor, ucontext_t *uap);
 /**
  * Initialize the frame cursor by acquiring state from the provided mach thread.
  *
+ * Only the registers required for unwinding are fetched; plframe_get_reg() will return PLFRAME_ENOTSUP
+ * for all other registers of the initial frame. Use plframe_thread_state_fetch() and plframe_cursor_init()
+ * if the complete register state is required.
+ *
  * @param cursor Cursor record to be initialized.
  * @param thread The thread to use for cursor initialization.
  *
@@ -178,6 +197,18 @@ plframe_error_t plframe_cursor_init (plframe_cursor_t *cursor, ucontext_t *uap);
  */
 plframe_error_t plframe_cursor_thread_init (plframe_cursor_t *cursor, thread_t thread);
 
+/**
+ * Fetch the complete register state of the provided mach thread into a caller-provided buffer.
+ *
+ * The resulting context may be passed to plframe_cursor_init() via state->uap.
+ *
+ * @param state State record to be populated.
+ * @param thread The thread from which state will be fetched. The thread must be suspended.
+ *
+ * @return Returns PLFRAME_ESUCCESS on success, or standard plframe_error_t code if an error occurs.
+ */
+plframe_error_t plframe_thread_state_fetch (plframe_thread_state_t *state, thread_t thread);
+
 /**
  * Fetch the next cursor.
  *
@@ -69,8 +69,8 @@
 }
 
 
-/* test plframe_cursor_init() */
-- (void) testInitFrame {
+/* test plframe_cursor_thread_init() */
+- (void) testThreadInitFrame {
     plframe_cursor_t cursor;
 
     /* Initialize the cursor */
@@ -80,6 +80,30 @@
     plframe_error_t ferr = plframe_cursor_next(&cursor);
     STAssertEquals(PLFRAME_ESUCCESS, ferr, @"Next failed: %s", plframe_strerror(ferr));
 
+    /* Only the unwinding registers are available */
+    plframe_greg_t ip;
+    STAssertEquals(PLFRAME_ESUCCESS, plframe_get_reg(&cursor, PLFRAME_REG_IP, &ip), @"Could not fetch IP");
+    STAssertNotEquals((plframe_greg_t) 0, ip, @"IP is zero");
+
+    /* Walk the next frame */
+    ferr = plframe_cursor_next(&cursor);
+    STAssertEquals(PLFRAME_ESUCCESS, ferr, @"Next failed: %s", plframe_strerror(ferr));
+    STAssertEquals(PLFRAME_ESUCCESS, plframe_get_reg(&cursor, PLFRAME_REG_IP, &ip), @"Could not fetch IP");
+}
+
+/* test plframe_cursor_init() */
+- (void) testInitFrame {
+    plframe_thread_state_t state;
+    plframe_cursor_t cursor;
+
+    /* Fetch the complete thread state, and initialize the cursor */
+    STAssertEquals(PLFRAME_ESUCCESS, plframe_thread_state_fetch(&state, pthread_mach_thread_np(_thr_args.thread)), @"State fetch failed");
+    STAssertEquals(PLFRAME_ESUCCESS, plframe_cursor_init(&cursor, &state.uap), @"Initialization failed");
+
+    /* Try fetching the first frame */
+    plframe_error_t ferr = plframe_cursor_next(&cursor);
+    STAssertEquals(PLFRAME_ESUCCESS, ferr, @"Next failed: %s", plframe_strerror(ferr));
+
     /* Verify that all registers are supported */
     for (int i = 0; i < PLFRAME_REG_LAST + 1; i++) {
         plframe_greg_t val;
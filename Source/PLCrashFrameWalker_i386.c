@@ -44,6 +44,8 @@
 plframe_error_t plframe_cursor_init (plframe_cursor_t *cursor, ucontext_t *uap) {
     cursor->uap = uap;
     cursor->init_frame = true;
+    cursor->init_ip = uap->uc_mcontext->__ss.__eip;
+    cursor->init_fp = uap->uc_mcontext->__ss.__ebp;
     cursor->fp[0] = NULL;
 
     return PLFRAME_ESUCCESS;
@@ -51,12 +53,35 @@ plframe_error_t plframe_cursor_init (plframe_cursor_t *cursor, ucontext_t *uap)
 
 // PLFrameWalker API
 plframe_error_t plframe_cursor_thread_init (plframe_cursor_t *cursor, thread_t thread) {
+    x86_thread_state32_t state;
+    mach_msg_type_number_t state_count;
+    kern_return_t kr;
+
+    /* Fetch only the thread state; this is all that is required to walk the stack */
+    state_count = x86_THREAD_STATE32_COUNT;
+    kr = thread_get_state(thread, x86_THREAD_STATE32, (thread_state_t) &state, &state_count);
+    if (kr != KERN_SUCCESS) {
+        PLCF_DEBUG("Fetch of x86 thread state failed with mach error: %d", kr);
+        return PLFRAME_INTERNAL;
+    }
+
+    cursor->uap = NULL;
+    cursor->init_frame = true;
+    cursor->init_ip = state.__eip;
+    cursor->init_fp = state.__ebp;
+    cursor->fp[0] = NULL;
+
+    return PLFRAME_ESUCCESS;
+}
+
+// PLFrameWalker API
+plframe_error_t plframe_thread_state_fetch (plframe_thread_state_t *state, thread_t thread) {
     kern_return_t kr;
     ucontext_t *uap;
 
     /* Perform basic initialization */
-    uap = &cursor->_uap_data;
-    uap->uc_mcontext = (void *) &cursor->_mcontext_data;
+    uap = &state->uap;
+    uap->uc_mcontext = (void *) &state->mcontext;
 
     /* Zero the signal mask */
     sigemptyset(&uap->uc_sigmask);
@@ -65,13 +90,13 @@ plframe_error_t plframe_cursor_thread_init (plframe_cursor_t *cursor, thread_t t
     mach_msg_type_number_t state_count;
 
     /* Sanity check */
-    assert(sizeof(cursor->_mcontext_data.__ss) == sizeof(x86_thread_state32_t));
-    assert(sizeof(cursor->_mcontext_data.__es) == sizeof(x86_exception_state32_t));
-    assert(sizeof(cursor->_mcontext_data.__fs) == sizeof(x86_float_state32_t));
+    assert(sizeof(state->mcontext.__ss) == sizeof(x86_thread_state32_t));
+    assert(sizeof(state->mcontext.__es) == sizeof(x86_exception_state32_t));
+    assert(sizeof(state->mcontext.__fs) == sizeof(x86_float_state32_t));
     
     // thread state
     state_count = x86_THREAD_STATE32_COUNT;
-    kr = thread_get_state(thread, x86_THREAD_STATE32, (thread_state_t) &cursor->_mcontext_data.__ss, &state_count);
+    kr = thread_get_state(thread, x86_THREAD_STATE32, (thread_state_t) &state->mcontext.__ss, &state_count);
     if (kr != KERN_SUCCESS) {
         PLCF_DEBUG("Fetch of x86 thread state failed with mach error: %d", kr);
         return PLFRAME_INTERNAL;
@@ -79,7 +104,7 @@ plframe_error_t plframe_cursor_thread_init (plframe_cursor_t *cursor, thread_t t
 
     // floating point state
     state_count = x86_FLOAT_STATE32_COUNT;
-    kr = thread_get_state(thread, x86_FLOAT_STATE32, (thread_state_t) &cursor->_mcontext_data.__fs, &state_count);
+    kr = thread_get_state(thread, x86_FLOAT_STATE32, (thread_state_t) &state->mcontext.__fs, &state_count);
     if (kr != KERN_SUCCESS) {
         PLCF_DEBUG("Fetch of x86 float state failed with mach error: %d", kr);
         return PLFRAME_INTERNAL;
@@ -87,15 +112,12 @@ plframe_error_t plframe_cursor_thread_init (plframe_cursor_t *cursor, thread_t t
 
     // exception state
     state_count = x86_EXCEPTION_STATE32_COUNT;
-    kr = thread_get_state(thread, x86_EXCEPTION_STATE32, (thread_state_t) &cursor->_mcontext_data.__es, &state_count);
+    kr = thread_get_state(thread, x86_EXCEPTION_STATE32, (thread_state_t) &state->mcontext.__es, &state_count);
     if (kr != KERN_SUCCESS) {
         PLCF_DEBUG("Fetch of x86 exception state failed with mach error: %d", kr);
         return PLFRAME_INTERNAL;
     }
 
-    /* Perform standard initialization */
-    plframe_cursor_init(cursor, uap);
-
     return PLFRAME_ESUCCESS;
 }
 
@@ -113,7 +135,7 @@ plframe_error_t plframe_cursor_next (plframe_cursor_t *cursor) {
     } else {
         if (cursor->fp[0] == NULL) {
             /* No frame data has been loaded, fetch it from register state */
-            kr = plframe_read_addr((void *) cursor->uap->uc_mcontext->__ss.__ebp, cursor->fp, sizeof(cursor->fp));
+            kr = plframe_read_addr((void *) cursor->init_fp, cursor->fp, sizeof(cursor->fp));
         } else {
             /* Frame data loaded, walk the stack */
             kr = plframe_read_addr(cursor->fp[0], cursor->fp, sizeof(cursor->fp));
@@ -151,6 +173,19 @@ plframe_error_t plframe_get_reg (plframe_cursor_t *cursor, plframe_regnum_t regn
         return PLFRAME_ENOTSUP;
     }
 
+    /* Only the unwinding registers are available for thread-initialized cursors */
+    if (uap == NULL) {
+        if (regnum == PLFRAME_X86_EIP) {
+            *reg = cursor->init_ip;
+            return PLFRAME_ESUCCESS;
+        } else if (regnum == PLFRAME_X86_EBP) {
+            *reg = cursor->init_fp;
+            return PLFRAME_ESUCCESS;
+        }
+
+        return PLFRAME_ENOTSUP;
+    }
+
     /* All word-sized registers */
     switch (regnum) {
         case PLFRAME_X86_EAX:
@@ -0,0 +1,282 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PLCrashHandlerThread.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <libkern/OSAtomic.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_handler_thread Crash Handler Thread
+ * @ingroup plcrash_internal
+ *
+ * Implements a pre-spawned, parked crash handler thread.
+ *
+ * The thread is created with a large, preallocated stack and blocks in read(2) on a pipe until a crash occurs.
+ * The crashed thread populates a preallocated request slot with its signal context, wakes the handler thread
+ * with a single-byte write(2), and then blocks waiting for the handler to complete. Both read(2) and write(2) are
+ * async-safe, and the crashed thread's own stack and alternate signal stack usage is limited to the hand-off
+ * itself, allowing the report to be generated even when the crashed thread has exhausted its stack.
+ *
+ * @{
+ */
+
+/** @internal Request command: handle the crash described by the request slot. */
+#define PLCRASH_HANDLER_THREAD_CMD_CRASH 'c'
+
+/** @internal Request command: terminate the handler thread. */
+#define PLCRASH_HANDLER_THREAD_CMD_EXIT 'x'
+
+/**
+ * @internal
+ * Write a single byte to @a fd, retrying on EINTR.
+ */
+static bool write_byte (int fd, char byte) {
+    ssize_t ret;
+    while ((ret = write(fd, &byte, 1)) < 0 && errno == EINTR);
+
+    return (ret == 1);
+}
+
+/**
+ * @internal
+ * Read a single byte from @a fd, retrying on EINTR.
+ */
+static bool read_byte (int fd, char *byte) {
+    ssize_t ret;
+    while ((ret = read(fd, byte, 1)) < 0 && errno == EINTR);
+
+    return (ret == 1);
+}
+
+/**
+ * @internal
+ * Handler thread entry point. Parks until a crash is dispatched.
+ */
+static void *handler_thread_main (void *arg) {
+    plcrash_handler_thread_t *handler = arg;
+    char cmd;
+
+    while (read_byte(handler->request_fd[0], &cmd)) {
+        if (cmd == PLCRASH_HANDLER_THREAD_CMD_EXIT)
+            break;
+
+        /* Ensure that we observe the crashed thread's writes to the request slot */
+        OSMemoryBarrier();
+        handler->callback(handler->request.signal, handler->request.info, handler->request.uap,
+                          handler->request.crashed_thread, handler->context);
+
+        /* Release the crashed thread */
+        write_byte(handler->reply_fd[1], 0);
+    }
+
+    return NULL;
+}
+
+/**
+ * @internal
+ * Create a close-on-exec pipe.
+ */
+static bool create_pipe (int fds[2]) {
+    if (pipe(fds) != 0)
+        return false;
+
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+/**
+ * Spawn a new parked crash handler thread.
+ *
+ * @param handler The handler thread structure to be initialized.
+ * @param stack_size The size of the handler thread's stack, in bytes. Will be rounded up to the page size.
+ * @param callback The callback to be executed on the handler thread when a crash is dispatched.
+ * @param context Context to be passed to @a callback. May be NULL.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or an error code if the thread or its resources could not be allocated.
+ *
+ * @warning This method is not async safe.
+ */
+plcrash_error_t plcrash_handler_thread_init (plcrash_handler_thread_t *handler, size_t stack_size, plcrash_handler_thread_callback_t callback, void *context) {
+    pthread_attr_t attr;
+    sigset_t block_set;
+    sigset_t saved_set;
+    size_t page_size = getpagesize();
+    int err;
+
+    memset(handler, 0, sizeof(*handler));
+    handler->request_fd[0] = handler->request_fd[1] = -1;
+    handler->reply_fd[0] = handler->reply_fd[1] = -1;
+    handler->callback = callback;
+    handler->context = context;
+
+    /* Map the stack, reserving a guard page at its base. */
+    stack_size = (stack_size + page_size - 1) & ~(page_size - 1);
+    handler->stack_map_size = stack_size + page_size;
+    handler->stack_map = mmap(NULL, handler->stack_map_size, PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE, -1, 0);
+    if (handler->stack_map == MAP_FAILED) {
+        PLCF_DEBUG("Could not allocate handler thread stack: %s", strerror(errno));
+        handler->stack_map = NULL;
+        return PLCRASH_ENOMEM;
+    }
+
+    if (mprotect(handler->stack_map, page_size, PROT_NONE) != 0) {
+        PLCF_DEBUG("Could not protect handler thread guard page: %s", strerror(errno));
+        plcrash_handler_thread_free(handler);
+        return PLCRASH_EINTERNAL;
+    }
+
+    /* Create the wakeup pipes */
+    if (!create_pipe(handler->request_fd) || !create_pipe(handler->reply_fd)) {
+        PLCF_DEBUG("Could not create handler thread pipes: %s", strerror(errno));
+        plcrash_handler_thread_free(handler);
+        return PLCRASH_EINTERNAL;
+    }
+
+    /* Configure the thread's stack */
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, (uint8_t *) handler->stack_map + page_size, stack_size);
+
+    /* Spawn the thread with all signals blocked; asynchronous signals should never be delivered to the handler
+     * thread. The new thread inherits our signal mask, which we then restore. */
+    sigfillset(&block_set);
+    pthread_sigmask(SIG_SETMASK, &block_set, &saved_set);
+    err = pthread_create(&handler->thread, &attr, handler_thread_main, handler);
+    pthread_sigmask(SIG_SETMASK, &saved_set, NULL);
+    pthread_attr_destroy(&attr);
+
+    if (err != 0) {
+        PLCF_DEBUG("Could not create handler thread: %s", strerror(err));
+        plcrash_handler_thread_free(handler);
+        return PLCRASH_EINTERNAL;
+    }
+
+    handler->running = true;
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Return true if the calling thread is @a handler's thread.
+ *
+ * @param handler An initialized handler thread.
+ */
+bool plcrash_handler_thread_is_current (plcrash_handler_thread_t *handler) {
+    return (handler->running && pthread_equal(pthread_self(), handler->thread));
+}
+
+/**
+ * Fetch the bounds of the handler thread's stack. The stack is zero-filled prior to use, and its high-water mark
+ * may be measured with plcrash_async_stack_high_water().
+ *
+ * @param handler An initialized handler thread.
+ * @param stack_base Will be set to the stack's lowest address.
+ * @param stack_size Will be set to the stack's size.
+ */
+void plcrash_handler_thread_get_stack (plcrash_handler_thread_t *handler, void **stack_base, size_t *stack_size) {
+    size_t page_size = getpagesize();
+
+    *stack_base = (uint8_t *) handler->stack_map + page_size;
+    *stack_size = handler->stack_map_size - page_size;
+}
+
+/**
+ * Hand off a crash to the handler thread, and block until the handler callback has returned.
+ *
+ * Only a single crash may be dispatched. Callers are responsible for serializing crashed threads prior to dispatch;
+ * the signal handler admits only the first crashed thread (see plcrash_signal_gate_enter()).
+ *
+ * @param handler An initialized handler thread.
+ * @param signal The signal that triggered the crash.
+ * @param info The crashed thread's signal info.
+ * @param uap The crashed thread's context.
+ * @param crashed_thread The Mach thread port of the crashed (calling) thread.
+ *
+ * @return Returns true if the crash was handled by the handler thread. If false is returned, the crash was
+ * not dispatched -- either because the calling thread is the handler thread, or because the handler thread
+ * could not be woken -- and the caller is responsible for handling the crash directly.
+ */
+bool plcrash_handler_thread_dispatch (plcrash_handler_thread_t *handler, int signal, siginfo_t *info, ucontext_t *uap, thread_t crashed_thread) {
+    char reply;
+
+    /* A crash on the handler thread can not be handed off to itself */
+    if (plcrash_handler_thread_is_current(handler))
+        return false;
+
+    /* Populate the request slot and issue a barrier before waking the handler thread */
+    handler->request.signal = signal;
+    handler->request.info = info;
+    handler->request.uap = uap;
+    handler->request.crashed_thread = crashed_thread;
+    OSMemoryBarrier();
+
+    if (!write_byte(handler->request_fd[1], PLCRASH_HANDLER_THREAD_CMD_CRASH)) {
+        PLCF_DEBUG("Could not wake the crash handler thread: %s", strerror(errno));
+        return false;
+    }
+
+    /* Wait for completion. If the read fails, the handler thread has terminated and there is nothing
+     * left to wait for. */
+    read_byte(handler->reply_fd[0], &reply);
+    return true;
+}
+
+/**
+ * Terminate the handler thread, if running, and free all associated resources.
+ *
+ * @param handler The handler thread to free.
+ *
+ * @warning This method is not async safe, and must not be called while a crash is being handled.
+ */
+void plcrash_handler_thread_free (plcrash_handler_thread_t *handler) {
+    if (handler->running) {
+        write_byte(handler->request_fd[1], PLCRASH_HANDLER_THREAD_CMD_EXIT);
+        pthread_join(handler->thread, NULL);
+        handler->running = false;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (handler->request_fd[i] >= 0)
+            close(handler->request_fd[i]);
+        if (handler->reply_fd[i] >= 0)
+            close(handler->reply_fd[i]);
+    }
+
+    if (handler->stack_map != NULL)
+        munmap(handler->stack_map, handler->stack_map_size);
+}
+
+/**
+ * @} plcrash_handler_thread
+ */
@@ -0,0 +1,103 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/ucontext.h>
+#include <mach/mach.h>
+
+#include "PLCrashAsync.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_handler_thread
+ *
+ * Crash handler callback, executed on the dedicated handler thread.
+ *
+ * @param signal The signal that triggered the crash.
+ * @param info The crashed thread's signal info.
+ * @param uap The crashed thread's context.
+ * @param crashed_thread The Mach thread port of the crashed thread.
+ * @param context The context value supplied to plcrash_handler_thread_init().
+ */
+typedef void (*plcrash_handler_thread_callback_t)(int signal, siginfo_t *info, ucontext_t *uap, thread_t crashed_thread, void *context);
+
+/**
+ * @internal
+ * @ingroup plcrash_handler_thread
+ *
+ * A parked crash handler thread. All fields are private, and must not be accessed directly.
+ */
+typedef struct plcrash_handler_thread {
+    /** The parked thread. */
+    pthread_t thread;
+
+    /** True if thread has been successfully spawned. */
+    bool running;
+
+    /** The thread's stack mapping, including the guard page. */
+    void *stack_map;
+
+    /** The total size of stack_map, in bytes. */
+    size_t stack_map_size;
+
+    /** Request pipe. The crashed thread writes a single byte to wake the handler thread. */
+    int request_fd[2];
+
+    /** Reply pipe. The handler thread writes a single byte once the callback has returned. */
+    int reply_fd[2];
+
+    /** The handler callback. */
+    plcrash_handler_thread_callback_t callback;
+
+    /** The handler callback's context. */
+    void *context;
+
+    /** The preallocated request slot, populated by the crashed thread prior to wakeup. */
+    struct {
+        /** The signal number. */
+        int signal;
+
+        /** The crashed thread's signal info. */
+        siginfo_t *info;
+
+        /** The crashed thread's context. */
+        ucontext_t *uap;
+
+        /** The crashed thread. */
+        thread_t crashed_thread;
+    } request;
+} plcrash_handler_thread_t;
+
+plcrash_error_t plcrash_handler_thread_init (plcrash_handler_thread_t *handler, size_t stack_size, plcrash_handler_thread_callback_t callback, void *context);
+bool plcrash_handler_thread_dispatch (plcrash_handler_thread_t *handler, int signal, siginfo_t *info, ucontext_t *uap, thread_t crashed_thread);
+bool plcrash_handler_thread_is_current (plcrash_handler_thread_t *handler);
+void plcrash_handler_thread_get_stack (plcrash_handler_thread_t *handler, void **stack_base, size_t *stack_size);
+void plcrash_handler_thread_free (plcrash_handler_thread_t *handler);
@@ -0,0 +1,221 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+
+#import "PLCrashHandlerThread.h"
+#import "PLCrashLogWriter.h"
+#import "PLCrashReport.h"
+
+#import <fcntl.h>
+#import <sys/wait.h>
+#import <mach-o/dyld.h>
+
+@interface PLCrashHandlerThreadTests : SenTestCase {
+@private
+    /* Path to crash log */
+    NSString *_logPath;
+}
+@end
+
+/* Values recorded by dispatch_callback */
+struct dispatch_result {
+    bool called;
+    pthread_t thread;
+    int signal;
+    siginfo_t *info;
+    ucontext_t *uap;
+    thread_t crashed_thread;
+};
+
+static void dispatch_callback (int signal, siginfo_t *info, ucontext_t *uap, thread_t crashed_thread, void *context) {
+    struct dispatch_result *result = context;
+
+    result->called = true;
+    result->thread = pthread_self();
+    result->signal = signal;
+    result->info = info;
+    result->uap = uap;
+    result->crashed_thread = crashed_thread;
+}
+
+
+/* Stack overflow test state. Must be global for access from the signal handler. */
+static plcrash_handler_thread_t overflow_handler;
+
+struct overflow_context {
+    plcrash_log_writer_t *writer;
+    const char *path;
+};
+
+/* Writes the crash report on the handler thread */
+static void overflow_report_callback (int signal, siginfo_t *info, ucontext_t *uap, thread_t crashed_thread, void *context) {
+    struct overflow_context *ctx = context;
+    plcrash_async_file_t file;
+
+    int fd = open(ctx->path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0)
+        return;
+
+    plcrash_async_file_init(&file, fd, 0);
+    plcrash_log_writer_write(ctx->writer, crashed_thread, &file, info, uap);
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+}
+
+/* Hands off the crash and exits with a known status code */
+static void overflow_signal_handler (int signal, siginfo_t *info, void *uap) {
+    if (plcrash_handler_thread_dispatch(&overflow_handler, signal, info, uap, mach_thread_self()))
+        _exit(0);
+
+    _exit(2);
+}
+
+static int overflow_recurse (int depth) {
+    volatile char buf[256];
+    buf[0] = (char) depth;
+    return overflow_recurse(depth + 1) + buf[0];
+}
+
+/* Overflows the stack of a secondary thread, with only a minimal alternate signal stack available. */
+static void *overflow_thread (void *arg) {
+    stack_t sigstk;
+
+    sigstk.ss_size = MINSIGSTKSZ;
+    sigstk.ss_sp = malloc(sigstk.ss_size);
+    sigstk.ss_flags = 0;
+    if (sigstk.ss_sp == NULL || sigaltstack(&sigstk, NULL) != 0)
+        _exit(3);
+
+    overflow_recurse(0);
+    return NULL;
+}
+
+@implementation PLCrashHandlerThreadTests
+
+- (void) setUp {
+    /* Create a temporary log path */
+    _logPath = [[NSTemporaryDirectory() stringByAppendingString: [[NSProcessInfo processInfo] globallyUniqueString]] retain];
+}
+
+- (void) tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath: _logPath error: NULL];
+    [_logPath release];
+}
+
+- (void) testDispatch {
+    plcrash_handler_thread_t handler;
+    struct dispatch_result result;
+    siginfo_t info;
+    ucontext_t uap;
+
+    memset(&result, 0, sizeof(result));
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_handler_thread_init(&handler, 256 * 1024, dispatch_callback, &result), @"Failed to spawn handler thread");
+    STAssertFalse(plcrash_handler_thread_is_current(&handler), @"Test thread reported as the handler thread");
+
+    /* Dispatch, and verify that the callback ran on the handler thread with our arguments */
+    STAssertTrue(plcrash_handler_thread_dispatch(&handler, SIGSEGV, &info, &uap, mach_thread_self()), @"Dispatch failed");
+    STAssertTrue(result.called, @"Callback was not executed prior to dispatch returning");
+    STAssertFalse(pthread_equal(result.thread, pthread_self()), @"Callback executed on the crashed thread");
+    STAssertEquals(SIGSEGV, result.signal, @"Incorrect signal");
+    STAssertEquals(&info, result.info, @"Incorrect siginfo");
+    STAssertEquals(&uap, result.uap, @"Incorrect context");
+    STAssertEquals(mach_thread_self(), result.crashed_thread, @"Incorrect crashed thread");
+
+    plcrash_handler_thread_free(&handler);
+}
+
+/* Overflow the stack of a secondary thread in a child process, and verify that the handler thread writes a
+ * complete report. */
+- (void) testSecondaryThreadStackOverflow {
+    plcrash_log_writer_t writer;
+    struct overflow_context ctx;
+    NSError *error = nil;
+    int status;
+
+    /* Initialize a writer */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++)
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+
+    ctx.writer = &writer;
+    ctx.path = [_logPath fileSystemRepresentation];
+
+    pid_t pid = fork();
+    STAssertTrue(pid >= 0, @"fork() failed: %s", strerror(errno));
+    if (pid == 0) {
+        struct sigaction sa;
+        pthread_t thr;
+
+        if (plcrash_handler_thread_init(&overflow_handler, 1024 * 1024, overflow_report_callback, &ctx) != PLCRASH_ESUCCESS)
+            _exit(4);
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_flags = SA_SIGINFO|SA_ONSTACK;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_sigaction = &overflow_signal_handler;
+        sigaction(SIGSEGV, &sa, NULL);
+        sigaction(SIGBUS, &sa, NULL);
+
+        pthread_create(&thr, NULL, overflow_thread, NULL);
+        pthread_join(thr, NULL);
+
+        /* Unreachable */
+        _exit(5);
+    }
+
+    /* Wait for the child to crash */
+    STAssertEquals(pid, waitpid(pid, &status, 0), @"waitpid() failed: %s", strerror(errno));
+    STAssertTrue(WIFEXITED(status), @"Child terminated without executing the signal handler");
+    STAssertEquals(0, WEXITSTATUS(status), @"Child failed with status %d", WEXITSTATUS(status));
+
+    plcrash_log_writer_free(&writer);
+
+    /* Parse the report */
+    PLCrashReport *crashLog = [[[PLCrashReport alloc] initWithData: [NSData dataWithContentsOfMappedFile: _logPath] error: &error] autorelease];
+    STAssertNotNil(crashLog, @"Could not decode crash log: %@", error);
+
+    STAssertTrue([crashLog.signalInfo.name isEqual: @"SIGSEGV"] || [crashLog.signalInfo.name isEqual: @"SIGBUS"], @"Unexpected signal %@", crashLog.signalInfo.name);
+
+    /* The report should include the main and crashed threads, but not the handler thread */
+    STAssertEquals((NSUInteger) 2, [crashLog.threads count], @"Unexpected thread count");
+
+    BOOL crashedFound = NO;
+    for (PLCrashReportThreadInfo *threadInfo in crashLog.threads) {
+        if (!threadInfo.crashed)
+            continue;
+
+        crashedFound = YES;
+        STAssertTrue([threadInfo.stackFrames count] > 100, @"Expected a deep backtrace, found %lu frames", (unsigned long) [threadInfo.stackFrames count]);
+        STAssertNotEquals((NSUInteger)0, [threadInfo.registers count], @"No registers recorded for the crashed thread");
+    }
+    STAssertTrue(crashedFound, @"No crashed thread was found in the crash log");
+}
+
+@end
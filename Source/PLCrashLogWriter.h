@@ -31,6 +31,17 @@
 
 #import "PLCrashAsync.h"
 #import "PLCrashAsyncImage.h"
+#import "PLCrashFrameWalker.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_log_writer
+ *
+ * Default limit on the total size of the image symbol tables built for in-process symbolication, in bytes. At
+ * 8 bytes per exported symbol, this accommodates the exports of a typical application's full set of system
+ * libraries.
+ */
+#define PLCRASH_LOG_WRITER_DEFAULT_SYMBOLICATION_LIMIT (8 * 1024 * 1024)
 
 /**
  * @internal
@@ -49,6 +60,10 @@
  * Crash log writer context.
  */
 typedef struct plcrash_log_writer {
+    /** If true, the system, machine and process data fetched by plcrash_log_writer_load_host_info() has been
+     * populated. Until set, that data must not be read by the crash handler. */
+    volatile bool host_info_loaded;
+
     /** System data */
     struct {
         /** The host OS version. */
@@ -83,6 +98,9 @@ typedef struct plcrash_log_writer {
 
         /** Application version */
         char *app_version;
+
+        /** Summary hash of the application identifier and version */
+        uint64_t app_version_hash;
     } application_info;
     
     /** Process data */
@@ -112,6 +130,25 @@ typedef struct plcrash_log_writer {
         plcrash_async_image_list_t image_list;
     } image_info;
 
+    /** In-process symbolication. Disabled unless enabled via plcrash_log_writer_enable_symbolication(). */
+    struct {
+        /** If true, a symbol table is built for each image registered via plcrash_log_writer_add_image(), and each
+         * stack frame is written with its nearest preceding exported symbol. */
+        bool enabled;
+
+        /** The maximum total size of all image symbol tables, in bytes. */
+        size_t limit;
+
+        /** The total size of the registered images' symbol tables, in bytes. */
+        size_t size;
+
+        /** The total number of symbols in the registered images' symbol tables. */
+        size_t symbol_count;
+
+        /** The number of images registered without a symbol table, as their table would have exceeded the limit. */
+        uint32_t skipped_images;
+    } symbolication;
+
     /** Uncaught exception (if any) */
     struct {
         /** Flag specifying wether an uncaught exception is available. */
@@ -123,16 +160,26 @@ typedef struct plcrash_log_writer {
         /** Exception reason (may be null) */
         char *reason;
     } uncaught_exception;
+
+    /** Storage for the crashed thread's complete register state, populated at crash time if no
+     * crash context is supplied to plcrash_log_writer_write(). Held here, rather than on the
+     * (size-constrained) signal handler stack. */
+    plframe_thread_state_t crashed_thread_state;
 } plcrash_log_writer_t;
 
 
 plcrash_error_t plcrash_log_writer_init (plcrash_log_writer_t *writer, NSString *app_identifier, NSString *app_version);
+plcrash_error_t plcrash_log_writer_init_minimal (plcrash_log_writer_t *writer, NSString *app_identifier, NSString *app_version);
+plcrash_error_t plcrash_log_writer_load_host_info (plcrash_log_writer_t *writer);
 void plcrash_log_writer_set_exception (plcrash_log_writer_t *writer, NSException *exception);
 
+void plcrash_log_writer_enable_symbolication (plcrash_log_writer_t *writer, size_t limit);
 void plcrash_log_writer_add_image (plcrash_log_writer_t *writer, const void *header_addr);
 void plcrash_log_writer_remove_image (plcrash_log_writer_t *writer, const void *header_addr);
 
-plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_async_file_t *file, siginfo_t *siginfo, ucontext_t *crashctx);
+plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, thread_t crashed_thread, plcrash_async_file_t *file, siginfo_t *siginfo, ucontext_t *crashctx);
+plcrash_error_t plcrash_log_writer_write_handler_info (plcrash_log_writer_t *writer, plcrash_async_file_t *file, uint64_t stack_size, uint64_t stack_used);
+plcrash_error_t plcrash_log_writer_write_secondary_crash (plcrash_log_writer_t *writer, plcrash_async_file_t *file, siginfo_t *siginfo, uint64_t pc);
 plcrash_error_t plcrash_log_writer_close (plcrash_log_writer_t *writer);
 void plcrash_log_writer_free (plcrash_log_writer_t *writer);
 
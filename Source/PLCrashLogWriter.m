@@ -39,6 +39,7 @@
 #import <mach-o/dyld.h>
 
 #import <libkern/OSAtomic.h>
+#import <libkern/OSByteOrder.h>
 
 #import "PLCrashReport.h"
 #import "PLCrashLogWriter.h"
@@ -46,6 +47,8 @@
 #import "PLCrashAsync.h"
 #import "PLCrashAsyncSignalInfo.h"
 #import "PLCrashFrameWalker.h"
+#import "PLCrashReportSummary.h"
+#import "PLCrashReportSignature.h"
 
 #import "PLCrashSysctl.h"
 
@@ -106,6 +109,12 @@ enum {
     /** CrashReport.thread.frame.pc */
     PLCRASH_PROTO_THREAD_FRAME_PC_ID = 3,
 
+    /** CrashReport.thread.frame.symbol_name */
+    PLCRASH_PROTO_THREAD_FRAME_SYMBOL_NAME_ID = 4,
+
+    /** CrashReport.thread.frame.symbol_offset */
+    PLCRASH_PROTO_THREAD_FRAME_SYMBOL_OFFSET_ID = 5,
+
     /** CrashReport.thread.crashed */
     PLCRASH_PROTO_THREAD_CRASHED_ID = 3,
 
@@ -205,12 +214,36 @@ enum {
 
     /** CrashReport.machine_info.logical_processor_count */
     PLCRASH_PROTO_MACHINE_INFO_LOGICAL_PROCESSOR_COUNT_ID = 4,
+
+
+    /** CrashReport.handler_info */
+    PLCRASH_PROTO_HANDLER_INFO_ID = 9,
+
+    /** CrashReport.handler_info.stack_size */
+    PLCRASH_PROTO_HANDLER_INFO_STACK_SIZE_ID = 1,
+
+    /** CrashReport.handler_info.stack_used */
+    PLCRASH_PROTO_HANDLER_INFO_STACK_USED_ID = 2,
+
+
+    /** CrashReport.secondary_crashes */
+    PLCRASH_PROTO_SECONDARY_CRASHES_ID = 10,
+
+    /** CrashReport.secondary_crashes.signal */
+    PLCRASH_PROTO_SECONDARY_CRASHES_SIGNAL_ID = 1,
+
+    /** CrashReport.secondary_crashes.pc */
+    PLCRASH_PROTO_SECONDARY_CRASHES_PC_ID = 2,
 };
 
+static void plcrash_writer_image_info (const void *header, uint64_t *text_size, const uint8_t **uuid);
+
 /**
  * Initialize a new crash log writer instance and issue a memory barrier upon completion. This fetches all necessary
  * environment information.
  *
+ * This is equivalent to calling plcrash_log_writer_init_minimal() followed by plcrash_log_writer_load_host_info().
+ *
  * @param writer Writer instance to be initialized.
  * @param app_identifier Unique per-application identifier. On Mac OS X, this is likely the CFBundleIdentifier.
  * @param app_version Application version string.
@@ -221,6 +254,34 @@ enum {
  * @warning This function is not guaranteed to be async-safe, and must be called prior to enabling the crash handler.
  */
 plcrash_error_t plcrash_log_writer_init (plcrash_log_writer_t *writer, NSString *app_identifier, NSString *app_version) {
+    plcrash_error_t err;
+
+    if ((err = plcrash_log_writer_init_minimal(writer, app_identifier, app_version)) != PLCRASH_ESUCCESS)
+        return err;
+
+    return plcrash_log_writer_load_host_info(writer);
+}
+
+/**
+ * Initialize a new crash log writer instance with only the information that is inexpensive to fetch, and issue a
+ * memory barrier upon completion. The writer may be used to write crash reports immediately; host information
+ * (process names and path, machine model and processor counts, and the OS version and build) is omitted from those
+ * reports until plcrash_log_writer_load_host_info() has completed.
+ *
+ * The binary images loaded at the time of the call are registered, without symbol tables, so that every report
+ * written by the writer includes its binary images. Registering an image again via plcrash_log_writer_add_image()
+ * replaces its entry.
+ *
+ * @param writer Writer instance to be initialized.
+ * @param app_identifier Unique per-application identifier. On Mac OS X, this is likely the CFBundleIdentifier.
+ * @param app_version Application version string.
+ *
+ * @note If this function fails, plcrash_log_writer_free() should be called
+ * to free any partially allocated data.
+ *
+ * @warning This function is not guaranteed to be async-safe, and must be called prior to enabling the crash handler.
+ */
+plcrash_error_t plcrash_log_writer_init_minimal (plcrash_log_writer_t *writer, NSString *app_identifier, NSString *app_version) {
     /* Default to 0 */
     memset(writer, 0, sizeof(*writer));
     
@@ -228,8 +289,71 @@ plcrash_error_t plcrash_log_writer_init (plcrash_log_writer_t *writer, NSString
     {
         writer->application_info.app_identifier = strdup([app_identifier UTF8String]);
         writer->application_info.app_version = strdup([app_version UTF8String]);
+
+        /* Hash both strings, including their terminating NULs */
+        uint64_t hash = plcrash_report_summary_hash_init();
+        hash = plcrash_report_summary_hash(hash, writer->application_info.app_identifier, strlen(writer->application_info.app_identifier) + 1);
+        hash = plcrash_report_summary_hash(hash, writer->application_info.app_version, strlen(writer->application_info.app_version) + 1);
+        writer->application_info.app_version_hash = hash;
     }
     
+    /* Process and parent process IDs */
+    writer->process_info.process_id = getpid();
+    writer->process_info.parent_process_id = getppid();
+
+    /* Assume a native process until the host information has been loaded */
+    writer->process_info.native = true;
+
+    /* Fetch the CPU types; these are required to symbolicate any report */
+    {
+        int retval;
+
+        if (plcrash_sysctl_int("hw.cputype", &retval)) {
+            writer->machine_info.cpu_type = retval;
+        } else {
+            PLCF_DEBUG("Could not retrive hw.cputype: %s", strerror(errno));
+        }
+        
+        if (plcrash_sysctl_int("hw.cpusubtype", &retval)) {
+            writer->machine_info.cpu_subtype = retval;
+        } else {
+            PLCF_DEBUG("Could not retrive hw.cpusubtype: %s", strerror(errno));
+        }
+    }
+
+    /* Initialize the image info list, and register the loaded images. Only the images' load commands are read;
+     * symbol tables are built when the image is registered via plcrash_log_writer_add_image(). */
+    plcrash_async_image_list_init(&writer->image_info.image_list);
+    for (uint32_t i = 0; i < _dyld_image_count(); i++) {
+        const struct mach_header *header = _dyld_get_image_header(i);
+        const char *name = _dyld_get_image_name(i);
+        uint64_t text_size;
+        const uint8_t *uuid;
+
+        if (header == NULL || name == NULL)
+            continue;
+
+        plcrash_writer_image_info(header, &text_size, &uuid);
+        plcrash_async_image_list_append_image(&writer->image_info.image_list, (intptr_t) header, name, text_size, uuid, NULL);
+    }
+
+    /* Ensure that any signal handler has a consistent view of the above initialization. */
+    OSMemoryBarrier();
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Fetch the host information omitted by plcrash_log_writer_init_minimal(), and publish it to the crash handler.
+ *
+ * This may be called on any thread, including while the crash handler is enabled. The crash handler will not
+ * make use of any of the fetched information until it has been fully populated and a memory barrier issued.
+ *
+ * @param writer A writer initialized via plcrash_log_writer_init_minimal().
+ *
+ * @warning This function is not async-safe, and must not be called more than once for a writer.
+ */
+plcrash_error_t plcrash_log_writer_load_host_info (plcrash_log_writer_t *writer) {
     /* Fetch the process information */
     {
         /* MIB used to fetch process info */
@@ -240,9 +364,6 @@ plcrash_error_t plcrash_log_writer_init (plcrash_log_writer_t *writer, NSString
 
         /* Current process */
         {            
-            /* Retrieve PID */
-            writer->process_info.process_id = getpid();
-
             /* Retrieve name */
             process_info_mib[3] = writer->process_info.process_id;
             if (sysctl(process_info_mib, process_info_mib_len, &process_info, &process_info_len, NULL, 0) == 0) {
@@ -265,9 +386,6 @@ plcrash_error_t plcrash_log_writer_init (plcrash_log_writer_t *writer, NSString
 
         /* Parent process */
         {            
-            /* Retrieve PID */
-            writer->process_info.parent_process_id = getppid();
-
             /* Retrieve name */
             process_info_mib[3] = writer->process_info.parent_process_id;
             if (sysctl(process_info_mib, process_info_mib_len, &process_info, &process_info_len, NULL, 0) == 0) {
@@ -291,19 +409,6 @@ plcrash_error_t plcrash_log_writer_init (plcrash_log_writer_t *writer, NSString
         {
             int retval;
 
-            /* Fetch the CPU types */
-            if (plcrash_sysctl_int("hw.cputype", &retval)) {
-                writer->machine_info.cpu_type = retval;
-            } else {
-                PLCF_DEBUG("Could not retrive hw.cputype: %s", strerror(errno));
-            }
-            
-            if (plcrash_sysctl_int("hw.cpusubtype", &retval)) {
-                writer->machine_info.cpu_subtype = retval;
-            } else {
-                PLCF_DEBUG("Could not retrive hw.cpusubtype: %s", strerror(errno));
-            }
-
             /* Processor count */
             if (plcrash_sysctl_int("hw.physicalcpu_max", &retval)) {
                 writer->machine_info.processor_count = retval;
@@ -376,17 +481,101 @@ plcrash_error_t plcrash_log_writer_init (plcrash_log_writer_t *writer, NSString
 #error Unsupported Platform
 #endif
     
-    /* Initialize the image info list. */
-    plcrash_async_image_list_init(&writer->image_info.image_list);
-
-    /* Ensure that any signal handler has a consistent view of the above initialization. */
+    /* Ensure that any signal handler has a consistent view of the above before publishing it. */
+    OSMemoryBarrier();
+    writer->host_info_loaded = true;
     OSMemoryBarrier();
 
     return PLCRASH_ESUCCESS;
 }
 
 /**
- * Register a binary image with this writer.
+ * Enable in-process symbolication. Once enabled, a table of exported symbols is built for each subsequently
+ * registered image, and each stack frame is written with the name of its nearest preceding exported symbol, and its
+ * offset from that symbol.
+ *
+ * Building the tables adds to the cost of registering each image, and the tables are held in memory for as long as
+ * their images remain loaded. Once the total size of the tables would exceed @a limit, images are registered without
+ * a table, and their frames are written without symbol names.
+ *
+ * @param writer The writer for which symbolication will be enabled.
+ * @param limit The maximum total size of all image symbol tables, in bytes. PLCRASH_LOG_WRITER_DEFAULT_SYMBOLICATION_LIMIT
+ * is recommended.
+ *
+ * @warning This function is not async safe, and must be called prior to registering any images.
+ */
+void plcrash_log_writer_enable_symbolication (plcrash_log_writer_t *writer, size_t limit) {
+    writer->symbolication.enabled = true;
+    writer->symbolication.limit = limit;
+}
+
+/**
+ * @internal
+ *
+ * Find the __TEXT segment size and UUID of the Mach-O image at @a header.
+ *
+ * @param header Mach-O image header.
+ * @param text_size On return, the size of the image's __TEXT segment, or 0 if not found.
+ * @param uuid On return, a pointer to the image's 16 byte UUID, or NULL if the image has no UUID.
+ */
+static void plcrash_writer_image_info (const void *header, uint64_t *text_size, const uint8_t **uuid) {
+    uint32_t ncmds;
+    const struct mach_header *header32 = (const struct mach_header *) header;
+    const struct mach_header_64 *header64 = (const struct mach_header_64 *) header;
+    struct load_command *cmd;
+
+    *text_size = 0;
+    *uuid = NULL;
+
+    /* Check for 32-bit/64-bit header and extract required values */
+    switch (header32->magic) {
+        /* 32-bit */
+        case MH_MAGIC:
+        case MH_CIGAM:
+            ncmds = header32->ncmds;
+            cmd = (struct load_command *) (header32 + 1);
+            break;
+
+        /* 64-bit */
+        case MH_MAGIC_64:
+        case MH_CIGAM_64:
+            ncmds = header64->ncmds;
+            cmd = (struct load_command *) (header64 + 1);
+            break;
+
+        default:
+            PLCF_DEBUG("Invalid Mach-O header magic value: %x", header32->magic);
+            return;
+    }
+
+    /* Compute the image size and search for a UUID */
+    for (uint32_t i = 0; cmd != NULL && i < ncmds; i++) {
+        /* 32-bit text segment */
+        if (cmd->cmd == LC_SEGMENT) {
+            struct segment_command *segment = (struct segment_command *) cmd;
+            if (strcmp(segment->segname, SEG_TEXT) == 0) {
+                *text_size = segment->vmsize;
+            }
+        }
+        /* 64-bit text segment */
+        else if (cmd->cmd == LC_SEGMENT_64) {
+            struct segment_command_64 *segment = (struct segment_command_64 *) cmd;
+
+            if (strcmp(segment->segname, SEG_TEXT) == 0) {
+                *text_size = segment->vmsize;
+            }
+        }
+        /* DWARF dSYM UUID */
+        else if (cmd->cmd == LC_UUID && cmd->cmdsize == sizeof(struct uuid_command)) {
+            *uuid = ((struct uuid_command *) cmd)->uuid;
+        }
+
+        cmd = (struct load_command *) ((uint8_t *) cmd + cmd->cmdsize);
+    }
+}
+
+/**
+ * Register a binary image with this writer. If the image is already registered, its existing entry is replaced.
  *
  * @param writer The writer to which the image's information will be added.
  * @param header_addr The image's address.
@@ -394,7 +583,13 @@ plcrash_error_t plcrash_log_writer_init (plcrash_log_writer_t *writer, NSString
  * @warning This function is not async safe, and must be called outside of a signal handler.
  */
 void plcrash_log_writer_add_image (plcrash_log_writer_t *writer, const void *header_addr) {
+    plcrash_async_symtab_t symtab;
+    plcrash_async_symtab_t *table = NULL;
+    plcrash_async_image_t *image = NULL;
+    bool registered = false;
     Dl_info info;
+    uint64_t text_size;
+    const uint8_t *uuid;
 
     /* Look up the image info */
     if (dladdr(header_addr, &info) == 0) {
@@ -402,8 +597,45 @@ void plcrash_log_writer_add_image (plcrash_log_writer_t *writer, const void *hea
         return;
     }
 
-    /* Register the image */
-    plcrash_async_image_list_append(&writer->image_info.image_list, (intptr_t)header_addr, info.dli_fname);
+    /* Record the image's size and UUID now, rather than parsing its load commands at crash time */
+    plcrash_writer_image_info(header_addr, &text_size, &uuid);
+
+    /* Build the image's symbol table, within the remaining symbolication budget */
+    if (writer->symbolication.enabled) {
+        size_t available = writer->symbolication.limit - writer->symbolication.size;
+        size_t max_count = available / sizeof(plcrash_async_symtab_entry_t);
+        plcrash_error_t err;
+
+        if (max_count > UINT32_MAX)
+            max_count = UINT32_MAX;
+
+        err = plcrash_async_symtab_init(&symtab, header_addr, (uint32_t) max_count);
+        if (err == PLCRASH_ESUCCESS) {
+            writer->symbolication.size += plcrash_async_symtab_size(&symtab);
+            writer->symbolication.symbol_count += symtab.count;
+        } else if (err == PLCRASH_ENOMEM) {
+            writer->symbolication.skipped_images++;
+        }
+
+        /* On failure, the table is empty */
+        table = &symtab;
+    }
+
+    /* Check for an existing entry, such as one registered by plcrash_log_writer_init_minimal() */
+    plcrash_async_image_list_set_reading(&writer->image_info.image_list, true);
+    while ((image = plcrash_async_image_list_next(&writer->image_info.image_list, image)) != NULL) {
+        if (image->header == (intptr_t) header_addr) {
+            registered = true;
+            break;
+        }
+    }
+    plcrash_async_image_list_set_reading(&writer->image_info.image_list, false);
+
+    /* Register the image. An existing entry is removed only once its replacement has been appended, so that the
+     * image remains visible to a concurrent crash; removal finds the earlier, existing entry first. */
+    plcrash_async_image_list_append_image(&writer->image_info.image_list, (intptr_t)header_addr, info.dli_fname, text_size, uuid, table);
+    if (registered)
+        plcrash_log_writer_remove_image(writer, header_addr);
 }
 
 /**
@@ -415,6 +647,21 @@ void plcrash_log_writer_add_image (plcrash_log_writer_t *writer, const void *hea
  * @warning This function is not async safe, and must be called outside of a signal handler.
  */
 void plcrash_log_writer_remove_image (plcrash_log_writer_t *writer, const void *header_addr) {
+    /* Return the image's symbol table to the symbolication budget */
+    if (writer->symbolication.enabled) {
+        plcrash_async_image_t *image = NULL;
+
+        plcrash_async_image_list_set_reading(&writer->image_info.image_list, true);
+        while ((image = plcrash_async_image_list_next(&writer->image_info.image_list, image)) != NULL) {
+            if (image->header == (intptr_t) header_addr) {
+                writer->symbolication.size -= plcrash_async_symtab_size(&image->symtab);
+                writer->symbolication.symbol_count -= image->symtab.count;
+                break;
+            }
+        }
+        plcrash_async_image_list_set_reading(&writer->image_info.image_list, false);
+    }
+
     plcrash_async_image_list_remove(&writer->image_info.image_list, (intptr_t)header_addr);
 }
 
@@ -492,9 +739,11 @@ void plcrash_log_writer_free (plcrash_log_writer_t *writer) {
  * Write the system info message.
  *
  * @param file Output file
+ * @param writer Writer context
  * @param timestamp Timestamp to use (seconds since epoch). Must be same across calls, as varint encoding.
+ * @param host_info If false, the writer's host information has not been loaded, and must not be read.
  */
-static size_t plcrash_writer_write_system_info (plcrash_async_file_t *file, plcrash_log_writer_t *writer, int64_t timestamp) {
+static size_t plcrash_writer_write_system_info (plcrash_async_file_t *file, plcrash_log_writer_t *writer, int64_t timestamp, bool host_info) {
     size_t rv = 0;
     uint32_t enumval;
 
@@ -502,11 +751,13 @@ static size_t plcrash_writer_write_system_info (plcrash_async_file_t *file, plcr
     enumval = PLCrashReportHostOperatingSystem;
     rv += plcrash_writer_pack(file, PLCRASH_PROTO_SYSTEM_INFO_OS_ID, PLPROTOBUF_C_TYPE_ENUM, &enumval);
 
-    /* OS Version */
-    rv += plcrash_writer_pack(file, PLCRASH_PROTO_SYSTEM_INFO_OS_VERSION_ID, PLPROTOBUF_C_TYPE_STRING, writer->system_info.version);
+    /* OS Version (required; empty if not yet loaded) */
+    const char *version = (host_info && writer->system_info.version != NULL) ? writer->system_info.version : "";
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_SYSTEM_INFO_OS_VERSION_ID, PLPROTOBUF_C_TYPE_STRING, version);
     
     /* OS Build */
-    rv += plcrash_writer_pack(file, PLCRASH_PROTO_SYSTEM_INFO_OS_BUILD_ID, PLPROTOBUF_C_TYPE_STRING, writer->system_info.build);
+    if (host_info && writer->system_info.build != NULL)
+        rv += plcrash_writer_pack(file, PLCRASH_PROTO_SYSTEM_INFO_OS_BUILD_ID, PLPROTOBUF_C_TYPE_STRING, writer->system_info.build);
 
     /* Machine type */
     enumval = PLCrashReportHostArchitecture;
@@ -550,12 +801,14 @@ static size_t plcrash_writer_write_processor_info (plcrash_async_file_t *file, u
  * Write the machine info message.
  *
  * @param file Output file
+ * @param writer Writer context
+ * @param host_info If false, the writer's host information has not been loaded, and must not be read.
  */
-static size_t plcrash_writer_write_machine_info (plcrash_async_file_t *file, plcrash_log_writer_t *writer) {
+static size_t plcrash_writer_write_machine_info (plcrash_async_file_t *file, plcrash_log_writer_t *writer, bool host_info) {
     size_t rv = 0;
     
     /* Model */
-    if (writer->machine_info.model != NULL)
+    if (host_info && writer->machine_info.model != NULL)
         rv += plcrash_writer_pack(file, PLCRASH_PROTO_MACHINE_INFO_MODEL_ID, PLPROTOBUF_C_TYPE_STRING, writer->machine_info.model);
 
     /* Processor */
@@ -722,27 +975,58 @@ static size_t plcrash_writer_write_thread_registers (plcrash_async_file_t *file,
     return rv;
 }
 
+/**
+ * @internal
+ *
+ * Find the nearest preceding exported symbol of @a pc, using the registered images' symbol tables. The image
+ * list must be retained for reading by the caller for as long as @a name is used.
+ *
+ * @param writer The writer context.
+ * @param pc The address to look up.
+ * @param name On success, the symbol's name, without any leading underscore.
+ * @param offset On success, the offset of @a pc from the symbol.
+ */
+static bool plcrash_writer_find_symbol (plcrash_log_writer_t *writer, uint64_t pc, const char **name, uint64_t *offset) {
+    plcrash_async_image_t *image = NULL;
+
+    while ((image = plcrash_async_image_list_next(&writer->image_info.image_list, image)) != NULL) {
+        if (pc < (uintptr_t) image->header || pc - (uintptr_t) image->header >= image->symtab.text_size)
+            continue;
+
+        if (!plcrash_async_symtab_lookup(&image->symtab, pc - (uintptr_t) image->header, name, offset))
+            return false;
+
+        /* C symbols carry a leading underscore, which is not displayed */
+        if ((*name)[0] == '_' && (*name)[1] != '\0')
+            (*name)++;
+
+        return true;
+    }
+
+    return false;
+}
+
 /**
  * @internal
  *
  * Write a thread backtrace frame
  *
  * @param file Output file
- * @param cursor The cursor from which to acquire frame data.
+ * @param pc The frame's instruction pointer.
+ * @param symbol_name The name of the frame's nearest preceding symbol, or NULL.
+ * @param symbol_offset The offset of @a pc from @a symbol_name.
  */
-static size_t plcrash_writer_write_thread_frame (plcrash_async_file_t *file, plframe_cursor_t *cursor) {
-    plframe_error_t err;
-    uint64_t uint64val;
+static size_t plcrash_writer_write_thread_frame (plcrash_async_file_t *file, uint64_t pc, const char *symbol_name, uint64_t symbol_offset) {
     size_t rv = 0;
 
     /* PC */
-    plframe_greg_t pc = 0;
-    if ((err = plframe_get_reg(cursor, PLFRAME_REG_IP, &pc)) != PLFRAME_ESUCCESS) {
-        PLCF_DEBUG("Could not retrieve frame PC register: %s", plframe_strerror(err));
-        return 0;
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_THREAD_FRAME_PC_ID, PLPROTOBUF_C_TYPE_UINT64, &pc);
+
+    /* Symbol */
+    if (symbol_name != NULL) {
+        rv += plcrash_writer_pack(file, PLCRASH_PROTO_THREAD_FRAME_SYMBOL_NAME_ID, PLPROTOBUF_C_TYPE_STRING, symbol_name);
+        rv += plcrash_writer_pack(file, PLCRASH_PROTO_THREAD_FRAME_SYMBOL_OFFSET_ID, PLPROTOBUF_C_TYPE_UINT64, &symbol_offset);
     }
-    uint64val = pc;
-    rv += plcrash_writer_pack(file, PLCRASH_PROTO_THREAD_FRAME_PC_ID, PLPROTOBUF_C_TYPE_UINT64, &uint64val);
 
     return rv;
 }
@@ -753,11 +1037,15 @@ static size_t plcrash_writer_write_thread_frame (plcrash_async_file_t *file, plf
  * Write a thread message
  *
  * @param file Output file
+ * @param writer The writer context. If symbolication is enabled, the image list must be retained for reading.
  * @param thread Thread for which we'll output data.
- * @param crashctx Context to use for currently running thread (rather than fetching the thread
- * context, which we've invalidated by running at all)
+ * @param thread_number The thread's index within the report.
+ * @param crashed_thr The crashed thread.
+ * @param crashctx Context to use for the crashed thread (rather than fetching the thread
+ * context, which has been invalidated by signal handling). If NULL, the crashed thread's
+ * registers will not be written.
  */
-static size_t plcrash_writer_write_thread (plcrash_async_file_t *file, thread_t thread, uint32_t thread_number, ucontext_t *crashctx) {
+static size_t plcrash_writer_write_thread (plcrash_async_file_t *file, plcrash_log_writer_t *writer, thread_t thread, uint32_t thread_number, thread_t crashed_thr, ucontext_t *crashctx) {
     size_t rv = 0;
     plframe_cursor_t cursor;
     plframe_error_t ferr;
@@ -770,8 +1058,7 @@ static size_t plcrash_writer_write_thread (plcrash_async_file_t *file, thread_t
         rv += plcrash_writer_pack(file, PLCRASH_PROTO_THREAD_THREAD_NUMBER_ID, PLPROTOBUF_C_TYPE_UINT32, &thread_number);
 
         /* Is this the crashed thread? */
-        thread_t thr_self = mach_thread_self();
-        if (MACH_PORT_INDEX(thread) == MACH_PORT_INDEX(thr_self))
+        if (MACH_PORT_INDEX(thread) == MACH_PORT_INDEX(crashed_thr))
             crashed_thread = true;
 
         /* Note crashed status */
@@ -783,8 +1070,9 @@ static size_t plcrash_writer_write_thread (plcrash_async_file_t *file, thread_t
     {
         /* Set up the frame cursor. */
         {
-            /* Use the crashctx if we're running on the crashed thread */
-            if (crashed_thread) {
+            /* Use the crashctx for the crashed thread. All other threads only require the compact
+             * unwinding state */
+            if (crashed_thread && crashctx != NULL) {
                 ferr = plframe_cursor_init(&cursor, crashctx);
             } else {
                 ferr = plframe_cursor_thread_init(&cursor, thread);
@@ -801,12 +1089,24 @@ static size_t plcrash_writer_write_thread (plcrash_async_file_t *file, thread_t
         uint32_t frame_count = 0;
         while ((ferr = plframe_cursor_next(&cursor)) == PLFRAME_ESUCCESS && frame_count < MAX_THREAD_FRAMES) {
             uint32_t frame_size;
+            plframe_greg_t pc = 0;
+            const char *symbol_name = NULL;
+            uint64_t symbol_offset = 0;
+
+            if ((ferr = plframe_get_reg(&cursor, PLFRAME_REG_IP, &pc)) != PLFRAME_ESUCCESS) {
+                PLCF_DEBUG("Could not retrieve frame PC register: %s", plframe_strerror(ferr));
+                break;
+            }
+
+            /* Look up the symbol once, for both the size computation and the write */
+            if (writer->symbolication.enabled && !plcrash_writer_find_symbol(writer, pc, &symbol_name, &symbol_offset))
+                symbol_name = NULL;
 
             /* Determine the size */
-            frame_size = plcrash_writer_write_thread_frame(NULL, &cursor);
+            frame_size = plcrash_writer_write_thread_frame(NULL, pc, symbol_name, symbol_offset);
             
             rv += plcrash_writer_pack(file, PLCRASH_PROTO_THREAD_FRAMES_ID, PLPROTOBUF_C_TYPE_MESSAGE, &frame_size);
-            rv += plcrash_writer_write_thread_frame(file, &cursor);
+            rv += plcrash_writer_write_thread_frame(file, pc, symbol_name, symbol_offset);
             frame_count++;
         }
 
@@ -819,7 +1119,7 @@ static size_t plcrash_writer_write_thread (plcrash_async_file_t *file, thread_t
     }
 
     /* Dump registers for the crashed thread */
-    if (crashed_thread) {
+    if (crashed_thread && crashctx != NULL) {
         rv += plcrash_writer_write_thread_registers(file, crashctx);
     }
 
@@ -833,65 +1133,13 @@ static size_t plcrash_writer_write_thread (plcrash_async_file_t *file, thread_t
  * Write a binary image frame
  *
  * @param file Output file
- * @param name binary image path (or name).
- * @param image_base Mach-O image base.
+ * @param image The binary image.
  */
-static size_t plcrash_writer_write_binary_image (plcrash_async_file_t *file, const char *name, const void *header) {
+static size_t plcrash_writer_write_binary_image (plcrash_async_file_t *file, plcrash_async_image_t *image) {
     size_t rv = 0;
-    uint64_t mach_size = 0;
-    uint32_t ncmds;
-    const struct mach_header *header32 = (const struct mach_header *) header;
-    const struct mach_header_64 *header64 = (const struct mach_header_64 *) header;
-    struct load_command *cmd;
-
-    /* Check for 32-bit/64-bit header and extract required values */
-    switch (header32->magic) {
-        /* 32-bit */
-        case MH_MAGIC:
-        case MH_CIGAM:
-            ncmds = header32->ncmds;
-            cmd = (struct load_command *) (header32 + 1);
-            break;
-
-        /* 64-bit */
-        case MH_MAGIC_64:
-        case MH_CIGAM_64:
-            ncmds = header64->ncmds;
-            cmd = (struct load_command *) (header64 + 1);
-            break;
-
-        default:
-            PLCF_DEBUG("Invalid Mach-O header magic value: %x", header32->magic);
-            return 0;
-    }
-
-    /* Compute the image size and search for a UUID */
-    struct uuid_command *uuid = NULL;
-
-    for (uint32_t i = 0; cmd != NULL && i < ncmds; i++) {
-        /* 32-bit text segment */
-        if (cmd->cmd == LC_SEGMENT) {
-            struct segment_command *segment = (struct segment_command *) cmd;
-            if (strcmp(segment->segname, SEG_TEXT) == 0) {
-                mach_size = segment->vmsize;
-            }
-        }
-        /* 64-bit text segment */
-        else if (cmd->cmd == LC_SEGMENT_64) {
-            struct segment_command_64 *segment = (struct segment_command_64 *) cmd;
-
-            if (strcmp(segment->segname, SEG_TEXT) == 0) {
-                mach_size = segment->vmsize;
-            }
-        }
-        /* DWARF dSYM UUID */
-        else if (cmd->cmd == LC_UUID && cmd->cmdsize == sizeof(struct uuid_command)) {
-            uuid = (struct uuid_command *) cmd;
-        }
-
-        cmd = (struct load_command *) ((uint8_t *) cmd + cmd->cmdsize);
-    }
+    uint64_t mach_size = image->text_size;
 
+    /* Image size, as recorded when the image was registered */
     rv += plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGE_SIZE_ID, PLPROTOBUF_C_TYPE_UINT64, &mach_size);
     
     /* Base address */
@@ -899,21 +1147,21 @@ static size_t plcrash_writer_write_binary_image (plcrash_async_file_t *file, con
         uintptr_t base_addr;
         uint64_t u64;
 
-        base_addr = (uintptr_t) header;
+        base_addr = (uintptr_t) image->header;
         u64 = base_addr;
         rv += plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGE_ADDR_ID, PLPROTOBUF_C_TYPE_UINT64, &u64);
     }
 
     /* Name */
-    rv += plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGE_NAME_ID, PLPROTOBUF_C_TYPE_STRING, name);
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGE_NAME_ID, PLPROTOBUF_C_TYPE_STRING, image->name);
 
     /* UUID */
-    if (uuid != NULL) {
+    if (image->has_uuid) {
         PLProtobufCBinaryData binary;
     
         /* Write the 128-bit UUID */
-        binary.len = sizeof(uuid->uuid);
-        binary.data = uuid->uuid;
+        binary.len = sizeof(image->uuid);
+        binary.data = image->uuid;
         rv += plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGE_UUID_ID, PLPROTOBUF_C_TYPE_BYTES, &binary);
     }
 
@@ -940,34 +1188,56 @@ static size_t plcrash_writer_write_exception (plcrash_async_file_t *file, plcras
     return rv;
 }
 
+/**
+ * @internal
+ * Size of the buffers supplied to plcrash_writer_signal_strings().
+ */
+#define PLCRASH_WRITER_SIGNAL_BUFLEN 10
+
 /**
  * @internal
  *
- * Write the crash signal message
+ * Fetch the signal name and code strings recorded for @a siginfo.
  *
- * @param file Output file
  * @param siginfo The signal information
+ * @param name_buf Buffer of PLCRASH_WRITER_SIGNAL_BUFLEN bytes, used if the signal number is unknown.
+ * @param code_buf Buffer of PLCRASH_WRITER_SIGNAL_BUFLEN bytes, used if the signal code is unknown.
+ * @param name On return, the signal name.
+ * @param code On return, the signal code.
  */
-static size_t plcrash_writer_write_signal (plcrash_async_file_t *file, siginfo_t *siginfo) {
-    size_t rv = 0;
-    
+static void plcrash_writer_signal_strings (siginfo_t *siginfo, char *name_buf, char *code_buf, const char **name, const char **code) {
     /* Fetch the signal name */
-    char name_buf[10];
-    const char *name;
-    if ((name = plcrash_async_signal_signame(siginfo->si_signo)) == NULL) {
+    if ((*name = plcrash_async_signal_signame(siginfo->si_signo)) == NULL) {
         PLCF_DEBUG("Warning -- unhandled signal number (signo=%d). This is a bug.", siginfo->si_signo);
-        snprintf(name_buf, sizeof(name_buf), "#%d", siginfo->si_signo);
-        name = name_buf;
+        snprintf(name_buf, PLCRASH_WRITER_SIGNAL_BUFLEN, "#%d", siginfo->si_signo);
+        *name = name_buf;
     }
 
     /* Fetch the signal code string */
-    char code_buf[10];
-    const char *code;
-    if ((code = plcrash_async_signal_sigcode(siginfo->si_signo, siginfo->si_code)) == NULL) {
+    if ((*code = plcrash_async_signal_sigcode(siginfo->si_signo, siginfo->si_code)) == NULL) {
         PLCF_DEBUG("Warning -- unhandled signal sicode (signo=%d, code=%d). This is a bug.", siginfo->si_signo, siginfo->si_code);
-        snprintf(code_buf, sizeof(code_buf), "#%d", siginfo->si_code);
-        code = code_buf;
+        snprintf(code_buf, PLCRASH_WRITER_SIGNAL_BUFLEN, "#%d", siginfo->si_code);
+        *code = code_buf;
     }
+}
+
+/**
+ * @internal
+ *
+ * Write the crash signal message
+ *
+ * @param file Output file
+ * @param siginfo The signal information
+ */
+static size_t plcrash_writer_write_signal (plcrash_async_file_t *file, siginfo_t *siginfo) {
+    size_t rv = 0;
+    char name_buf[PLCRASH_WRITER_SIGNAL_BUFLEN];
+    char code_buf[PLCRASH_WRITER_SIGNAL_BUFLEN];
+    const char *name;
+    const char *code;
+
+    /* Fetch the signal name and code strings */
+    plcrash_writer_signal_strings(siginfo, name_buf, code_buf, &name, &code);
     
     /* Address value */
     uint64_t addr = (intptr_t) siginfo->si_addr;
@@ -980,21 +1250,119 @@ static size_t plcrash_writer_write_signal (plcrash_async_file_t *file, siginfo_t
     return rv;
 }
 
+/**
+ * @internal
+ *
+ * Compute the crashed thread's crash signature (see @ref plcrash_report_signature): a hash of the signal, uncaught
+ * exception name, and the image UUID and image-relative address of the top PLCRASH_REPORT_SIGNATURE_FRAMES frames.
+ * The owning image is the first registered image whose __TEXT segment contains the pc, matching the attribution made
+ * by plcrash_report_signature_compute() from the written report. The signature is independent of the images' load
+ * addresses; the image sizes and UUIDs were recorded when the images were registered.
+ *
+ * @param writer The writer context
+ * @param thread The crashed thread.
+ * @param crashctx Context of the crashed thread, or NULL.
+ * @param siginfo The signal information.
+ * @param summary The summary in which the signature will be recorded.
+ */
+static void plcrash_writer_signatures (plcrash_log_writer_t *writer, thread_t thread, ucontext_t *crashctx, siginfo_t *siginfo,
+                                       plcrash_report_summary_t *summary)
+{
+    plframe_cursor_t cursor;
+    plframe_error_t ferr;
+    plcrash_report_signature_t sig;
+    char name_buf[PLCRASH_WRITER_SIGNAL_BUFLEN];
+    char code_buf[PLCRASH_WRITER_SIGNAL_BUFLEN];
+    const char *name;
+    const char *code;
+
+    /* The crash signature covers the signal and exception even if no frames are available */
+    plcrash_writer_signal_strings(siginfo, name_buf, code_buf, &name, &code);
+    plcrash_report_signature_init(&sig);
+    plcrash_report_signature_add_signal(&sig, name, code, writer->uncaught_exception.has_exception ? writer->uncaught_exception.name : NULL);
+
+    if (crashctx != NULL) {
+        ferr = plframe_cursor_init(&cursor, crashctx);
+    } else {
+        ferr = plframe_cursor_thread_init(&cursor, thread);
+    }
+
+    if (ferr == PLFRAME_ESUCCESS) {
+        plcrash_async_image_list_set_reading(&writer->image_info.image_list, true);
+
+        for (int i = 0; i < PLCRASH_REPORT_SIGNATURE_FRAMES && plframe_cursor_next(&cursor) == PLFRAME_ESUCCESS; i++) {
+            plcrash_async_image_t *image = NULL;
+            plcrash_async_image_t *container = NULL;
+            plframe_greg_t pc;
+
+            if (plframe_get_reg(&cursor, PLFRAME_REG_IP, &pc) != PLFRAME_ESUCCESS)
+                break;
+
+            while ((image = plcrash_async_image_list_next(&writer->image_info.image_list, image)) != NULL) {
+                if ((uintptr_t) image->header <= pc && pc - (uintptr_t) image->header < image->text_size) {
+                    container = image;
+                    break;
+                }
+            }
+
+            if (container != NULL) {
+                plcrash_report_signature_add_frame(&sig, container->has_uuid ? container->uuid : NULL, pc - container->header);
+            } else {
+                plcrash_report_signature_add_frame(&sig, NULL, pc);
+            }
+        }
+
+        plcrash_async_image_list_set_reading(&writer->image_info.image_list, false);
+    }
+
+    summary->frames_signature = plcrash_report_signature_final(&sig);
+}
+
 /**
  * Write the crash report. All other running threads are suspended while the crash report is generated.
  *
+ * The report begins with a fixed-layout summary header (see plcrash_report_summary_header_t), which is
+ * written as a placeholder and filled in once the report has been written. The output file must therefore
+ * be seekable.
+ *
+ * If the report is written from a thread other than the crashed thread (such as a dedicated crash handler
+ * thread), the writing thread is omitted from the report.
+ *
  * @param writer The writer context
+ * @param crashed_thread The thread that triggered the crash.
  * @param file The output file.
  * @param siginfo Signal information
- * @param crashctx Context of the crashed thread.
+ * @param crashctx Context of the crashed thread. If NULL, the crashed thread's complete register state will
+ * be fetched from @a crashed_thread into the writer's preallocated state buffer; this is only possible if
+ * the report is not being written from the crashed thread.
  *
- * @warning This method must only be called from the thread that has triggered the crash. This must correspond
- * to the provided crashctx. Failure to adhere to this requirement will result in an invalid stack trace
- * and thread dump.
+ * @warning The provided crashctx must correspond to @a crashed_thread, and @a crashed_thread must not be
+ * executing while the report is written. Failure to adhere to this requirement will result in an invalid stack
+ * trace and thread dump.
  */
-plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_async_file_t *file, siginfo_t *siginfo, ucontext_t *crashctx) {
+plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, thread_t crashed_thread, plcrash_async_file_t *file, siginfo_t *siginfo, ucontext_t *crashctx) {
     thread_act_array_t threads;
     mach_msg_type_number_t thread_count;
+    plcrash_report_summary_t summary;
+    plcrash_report_summary_header_t summary_header;
+    off_t summary_offset;
+    time_t timestamp;
+
+    /* Host information may still be loading; only read it once published. */
+    bool host_info = writer->host_info_loaded;
+    OSMemoryBarrier();
+
+    /* Must stay the same across the summary and the system info, so get the timestamp here */
+    if (time(&timestamp) == (time_t)-1) {
+        PLCF_DEBUG("Failed to fetch timestamp: %s", strerror(errno));
+        timestamp = 0;
+    }
+
+    memset(&summary, 0, sizeof(summary));
+    summary.timestamp = timestamp;
+    summary.signal = siginfo->si_signo;
+    summary.crashed_thread = PLCRASH_REPORT_SUMMARY_NO_THREAD;
+    summary.app_version_hash = writer->application_info.app_version_hash;
 
     /* File header */
     {
@@ -1003,43 +1371,47 @@ plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_
         /* Write the magic string (with no trailing NULL) and the version number */
         plcrash_async_file_write(file, PLCRASH_REPORT_FILE_MAGIC, strlen(PLCRASH_REPORT_FILE_MAGIC));
         plcrash_async_file_write(file, &version, sizeof(version));
+
+        /* Write a placeholder summary header; it is filled in once the report is complete */
+        summary_offset = plcrash_async_file_offset(file);
+        plcrash_report_summary_encode(&summary, &summary_header);
+        plcrash_async_file_write(file, &summary_header, sizeof(summary_header));
     }
 
     /* System Info */
     {
-        time_t timestamp;
         uint32_t size;
 
-        /* Must stay the same across both calls, so get the timestamp here */
-        if (time(&timestamp) == (time_t)-1) {
-            PLCF_DEBUG("Failed to fetch timestamp: %s", strerror(errno));
-            timestamp = 0;
-        }
+        summary.section_offsets[PLCRASH_REPORT_SECTION_SYSTEM_INFO] = plcrash_async_file_offset(file);
 
         /* Determine size */
-        size = plcrash_writer_write_system_info(NULL, writer, timestamp);
+        size = plcrash_writer_write_system_info(NULL, writer, timestamp, host_info);
         
         /* Write message */
         plcrash_writer_pack(file, PLCRASH_PROTO_SYSTEM_INFO_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
-        plcrash_writer_write_system_info(file, writer, timestamp);
+        plcrash_writer_write_system_info(file, writer, timestamp, host_info);
     }
     
     /* Machine Info */
     {
         uint32_t size;
 
+        summary.section_offsets[PLCRASH_REPORT_SECTION_MACHINE_INFO] = plcrash_async_file_offset(file);
+
         /* Determine size */
-        size = plcrash_writer_write_machine_info(NULL, writer);
+        size = plcrash_writer_write_machine_info(NULL, writer, host_info);
 
         /* Write message */
         plcrash_writer_pack(file, PLCRASH_PROTO_MACHINE_INFO_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
-        plcrash_writer_write_machine_info(file, writer);
+        plcrash_writer_write_machine_info(file, writer, host_info);
     }
 
     /* App info */
     {
         uint32_t size;
 
+        summary.section_offsets[PLCRASH_REPORT_SECTION_APP_INFO] = plcrash_async_file_offset(file);
+
         /* Determine size */
         size = plcrash_writer_write_app_info(NULL, writer->application_info.app_identifier, writer->application_info.app_version);
         
@@ -1051,16 +1423,21 @@ plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_
     /* Process info */
     {
         uint32_t size;
+        const char *process_name = host_info ? writer->process_info.process_name : NULL;
+        const char *process_path = host_info ? writer->process_info.process_path : NULL;
+        const char *parent_process_name = host_info ? writer->process_info.parent_process_name : NULL;
+
+        summary.section_offsets[PLCRASH_REPORT_SECTION_PROCESS_INFO] = plcrash_async_file_offset(file);
         
         /* Determine size */
-        size = plcrash_writer_write_process_info(NULL, writer->process_info.process_name, writer->process_info.process_id, 
-                                                 writer->process_info.process_path, writer->process_info.parent_process_name,
+        size = plcrash_writer_write_process_info(NULL, process_name, writer->process_info.process_id, 
+                                                 process_path, parent_process_name,
                                                  writer->process_info.parent_process_id, writer->process_info.native);
         
         /* Write message */
         plcrash_writer_pack(file, PLCRASH_PROTO_PROCESS_INFO_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
-        plcrash_writer_write_process_info(file, writer->process_info.process_name, writer->process_info.process_id, 
-                                          writer->process_info.process_path, writer->process_info.parent_process_name, 
+        plcrash_writer_write_process_info(file, process_name, writer->process_info.process_id, 
+                                          process_path, parent_process_name, 
                                           writer->process_info.parent_process_id, writer->process_info.native);
     }
     
@@ -1076,6 +1453,8 @@ plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_
         }
 
         /* Suspend each thread and write out its state */
+        uint32_t thread_number = 0;
+        summary.section_offsets[PLCRASH_REPORT_SECTION_THREADS] = plcrash_async_file_offset(file);
         for (mach_msg_type_number_t i = 0; i < thread_count; i++) {
             thread_t thread = threads[i];
             uint32_t size;
@@ -1083,6 +1462,10 @@ plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_
             
             /* Check if we're running on the to be examined thread */
             if (MACH_PORT_INDEX(self_thr) == MACH_PORT_INDEX(threads[i])) {
+                /* Omit the writing thread if it is not the crashed thread */
+                if (MACH_PORT_INDEX(self_thr) != MACH_PORT_INDEX(crashed_thread))
+                    continue;
+
                 suspend_thread = false;
             }
             
@@ -1091,13 +1474,40 @@ plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_
                 PLCF_DEBUG("Could not suspend thread %d", i);
                 continue;
             }
+
+            /* Lazily fetch the full register state of the crashed thread, if required. This is the
+             * only thread for which the complete state is written. */
+            if (crashctx == NULL && suspend_thread && MACH_PORT_INDEX(thread) == MACH_PORT_INDEX(crashed_thread)) {
+                plframe_error_t ferr = plframe_thread_state_fetch(&writer->crashed_thread_state, thread);
+                if (ferr == PLFRAME_ESUCCESS) {
+                    crashctx = &writer->crashed_thread_state.uap;
+                } else {
+                    PLCF_DEBUG("Could not fetch crashed thread state: %s", plframe_strerror(ferr));
+                }
+            }
             
+            /* Record the crashed thread in the summary */
+            if (MACH_PORT_INDEX(thread) == MACH_PORT_INDEX(crashed_thread)) {
+                summary.crashed_thread = thread_number;
+                summary.section_offsets[PLCRASH_REPORT_SECTION_CRASHED_THREAD] = plcrash_async_file_offset(file);
+                plcrash_writer_signatures(writer, thread, crashctx, siginfo, &summary);
+            }
+
+            /* Retain the image list while frames are symbolicated */
+            if (writer->symbolication.enabled)
+                plcrash_async_image_list_set_reading(&writer->image_info.image_list, true);
+
             /* Determine the size */
-            size = plcrash_writer_write_thread(NULL, thread, i, crashctx);
+            size = plcrash_writer_write_thread(NULL, writer, thread, thread_number, crashed_thread, crashctx);
             
             /* Write message */
             plcrash_writer_pack(file, PLCRASH_PROTO_THREADS_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
-            plcrash_writer_write_thread(file, thread, i, crashctx);
+            plcrash_writer_write_thread(file, writer, thread, thread_number, crashed_thread, crashctx);
+
+            if (writer->symbolication.enabled)
+                plcrash_async_image_list_set_reading(&writer->image_info.image_list, false);
+
+            thread_number++;
 
             /* Resume the thread */
             if (suspend_thread)
@@ -1111,6 +1521,7 @@ plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_
     }
 
     /* Binary Images */
+    summary.section_offsets[PLCRASH_REPORT_SECTION_BINARY_IMAGES] = plcrash_async_file_offset(file);
     plcrash_async_image_list_set_reading(&writer->image_info.image_list, true);
 
     plcrash_async_image_t *image = NULL;
@@ -1118,10 +1529,9 @@ plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_
         uint32_t size;
 
         /* Calculate the message size */
-        // TODO - switch to plframe_read_addr()
-        size = plcrash_writer_write_binary_image(NULL, image->name, (const void *) image->header);
+        size = plcrash_writer_write_binary_image(NULL, image);
         plcrash_writer_pack(file, PLCRASH_PROTO_BINARY_IMAGES_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
-        plcrash_writer_write_binary_image(file, image->name, (const void *) image->header);
+        plcrash_writer_write_binary_image(file, image);
     }
 
     plcrash_async_image_list_set_reading(&writer->image_info.image_list, false);
@@ -1130,6 +1540,8 @@ plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_
     if (writer->uncaught_exception.has_exception) {
         uint32_t size;
 
+        summary.section_offsets[PLCRASH_REPORT_SECTION_EXCEPTION] = plcrash_async_file_offset(file);
+
         /* Calculate the message size */
         size = plcrash_writer_write_exception(NULL, writer);
         plcrash_writer_pack(file, PLCRASH_PROTO_EXCEPTION_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
@@ -1139,16 +1551,107 @@ plcrash_error_t plcrash_log_writer_write (plcrash_log_writer_t *writer, plcrash_
     /* Signal */
     {
         uint32_t size;
+
+        summary.section_offsets[PLCRASH_REPORT_SECTION_SIGNAL] = plcrash_async_file_offset(file);
         
         /* Calculate the message size */
         size = plcrash_writer_write_signal(NULL, siginfo);
         plcrash_writer_pack(file, PLCRASH_PROTO_SIGNAL_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
         plcrash_writer_write_signal(file, siginfo);
     }
+
+    /* Fill in the summary header */
+    plcrash_report_summary_encode(&summary, &summary_header);
+    if (!plcrash_async_file_patch(file, summary_offset, &summary_header, sizeof(summary_header))) {
+        PLCF_DEBUG("Could not write the crash report summary header");
+        return PLCRASH_OUTPUT_ERR;
+    }
     
     return PLCRASH_ESUCCESS;
 }
 
+/**
+ * @internal
+ *
+ * Write the handler info message.
+ *
+ * @param file Output file
+ * @param stack_size The handler stack size.
+ * @param stack_used The handler stack high-water mark.
+ */
+static size_t plcrash_writer_write_handler_info (plcrash_async_file_t *file, uint64_t stack_size, uint64_t stack_used) {
+    size_t rv = 0;
+
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_HANDLER_INFO_STACK_SIZE_ID, PLPROTOBUF_C_TYPE_UINT64, &stack_size);
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_HANDLER_INFO_STACK_USED_ID, PLPROTOBUF_C_TYPE_UINT64, &stack_used);
+
+    return rv;
+}
+
+/**
+ * Append the crash handler's stack usage to a crash report previously written via plcrash_log_writer_write().
+ *
+ * This must be called after plcrash_log_writer_write(), so that @a stack_used reflects the stack consumed
+ * while writing the report.
+ *
+ * @param writer The writer context
+ * @param file The output file, positioned at the end of the written report.
+ * @param stack_size The size of the stack on which the crash was handled, in bytes.
+ * @param stack_used The maximum number of bytes of that stack used, in bytes.
+ */
+plcrash_error_t plcrash_log_writer_write_handler_info (plcrash_log_writer_t *writer, plcrash_async_file_t *file, uint64_t stack_size, uint64_t stack_used) {
+    uint32_t size;
+
+    size = plcrash_writer_write_handler_info(NULL, stack_size, stack_used);
+    plcrash_writer_pack(file, PLCRASH_PROTO_HANDLER_INFO_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+    plcrash_writer_write_handler_info(file, stack_size, stack_used);
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * @internal
+ *
+ * Write a secondary crash message.
+ *
+ * @param file Output file
+ * @param siginfo The secondary crash's signal information.
+ * @param pc The secondary crashed thread's instruction pointer.
+ */
+static size_t plcrash_writer_write_secondary_crash (plcrash_async_file_t *file, siginfo_t *siginfo, uint64_t pc) {
+    uint32_t size;
+    size_t rv = 0;
+
+    /* Signal */
+    size = plcrash_writer_write_signal(NULL, siginfo);
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_SECONDARY_CRASHES_SIGNAL_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+    rv += plcrash_writer_write_signal(file, siginfo);
+
+    /* PC */
+    rv += plcrash_writer_pack(file, PLCRASH_PROTO_SECONDARY_CRASHES_PC_ID, PLPROTOBUF_C_TYPE_UINT64, &pc);
+
+    return rv;
+}
+
+/**
+ * Append a crash that occured on another thread while the crash report was being written to a crash report
+ * previously written via plcrash_log_writer_write().
+ *
+ * @param writer The writer context
+ * @param file The output file, positioned at the end of the written report.
+ * @param siginfo The secondary crash's signal information.
+ * @param pc The secondary crashed thread's instruction pointer.
+ */
+plcrash_error_t plcrash_log_writer_write_secondary_crash (plcrash_log_writer_t *writer, plcrash_async_file_t *file, siginfo_t *siginfo, uint64_t pc) {
+    uint32_t size;
+
+    size = plcrash_writer_write_secondary_crash(NULL, siginfo, pc);
+    plcrash_writer_pack(file, PLCRASH_PROTO_SECONDARY_CRASHES_ID, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+    plcrash_writer_write_secondary_crash(file, siginfo, pc);
+
+    return PLCRASH_ESUCCESS;
+}
+
 
 /**
  * @} plcrash_log_writer
@@ -31,6 +31,9 @@
 #import "PLCrashReport.h"
 #import "PLCrashLogWriter.h"
 #import "PLCrashFrameWalker.h"
+#import "PLCrashReportSummary.h"
+#import "PLCrashReportDecoder.h"
+#import "PLCrashReportSignature.h"
 
 #import <sys/stat.h>
 #import <sys/mman.h>
@@ -38,6 +41,12 @@
 
 #import "crash_report.pb-c.h"
 
+#import "PLCrashHandlerThread.h"
+
+#import <libkern/OSAtomic.h>
+#import <mach/mach_time.h>
+#import <mach-o/dyld.h>
+
 @interface PLCrashLogWriterTests : SenTestCase {
 @private
     /* Path to crash log */
@@ -50,6 +59,63 @@
 @end
 
 
+/* Stack usage test state */
+struct stack_usage_ctx {
+    /* Report writer and output path */
+    plcrash_log_writer_t *writer;
+    const char *path;
+
+    /* Faux crash state */
+    siginfo_t *info;
+    ucontext_t *uap;
+
+    /* Measured handler stack usage */
+    size_t stack_used;
+
+    /* The handler thread, used to measure its own stack */
+    plcrash_handler_thread_t *handler;
+};
+
+/* Parked recursion thread state */
+struct recurse_ctx {
+    uint32_t depth;
+    int park_fd;
+    volatile int32_t *parked;
+};
+
+static void stack_usage_callback (int signal, siginfo_t *info, ucontext_t *uap, thread_t crashed_thread, void *context) {
+    struct stack_usage_ctx *ctx = context;
+    plcrash_async_file_t file;
+    void *stack_base;
+    size_t stack_size;
+
+    int fd = open(ctx->path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+    plcrash_log_writer_write(ctx->writer, crashed_thread, &file, ctx->info, ctx->uap);
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+
+    plcrash_handler_thread_get_stack(ctx->handler, &stack_base, &stack_size);
+    ctx->stack_used = plcrash_async_stack_high_water(stack_base, stack_size);
+}
+
+static uint32_t recurse_and_park (struct recurse_ctx *ctx, uint32_t depth) {
+    volatile uint32_t result = depth;
+    char byte;
+
+    if (depth < ctx->depth)
+        return recurse_and_park(ctx, depth + 1) + result;
+
+    OSAtomicIncrement32Barrier(ctx->parked);
+    while (read(ctx->park_fd, &byte, 1) < 0 && errno == EINTR);
+    return result;
+}
+
+static void *recurse_thread (void *arg) {
+    recurse_and_park(arg, 0);
+    return NULL;
+}
+
 @implementation PLCrashLogWriterTests
 
 - (void) setUp {
@@ -163,7 +229,7 @@
 
 - (void) testWriteReport {
     siginfo_t info;
-    plframe_cursor_t cursor;
+    plframe_thread_state_t thread_state;
     plcrash_log_writer_t writer;
     plcrash_async_file_t file;
 
@@ -177,8 +243,8 @@
         info.si_signo = SIGSEGV;
         info.si_status = 0;
         
-        /* Steal the test thread's stack for iteration */
-        plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread));
+        /* Steal the test thread's state for iteration */
+        plframe_thread_state_fetch(&thread_state, pthread_mach_thread_np(_thr_args.thread));
     }
 
     /* Open the output file */
@@ -192,7 +258,7 @@
     plcrash_log_writer_set_exception(&writer, [NSException exceptionWithName: @"TestException" reason: @"TestReason" userInfo: nil]);
 
     /* Write the crash report */
-    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, pthread_mach_thread_np(_thr_args.thread), &file, &info, &thread_state.uap), @"Crash log failed");
 
     /* Close it */
     plcrash_log_writer_close(&writer);
@@ -218,9 +284,35 @@
     STAssertTrue(memcmp(header->magic, PLCRASH_REPORT_FILE_MAGIC, strlen(PLCRASH_REPORT_FILE_MAGIC)) == 0, @"File header is not 'plcrash', is: '%s'", (const char *) &header->magic);
     STAssertEquals(header->version, (uint8_t) PLCRASH_REPORT_FILE_VERSION, @"File version is not equal to 0");
 
+    /* Read the summary header */
+    plcrash_report_summary_t summary;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_summary_read(buf, statbuf.st_size, &summary), @"Could not read summary");
+    STAssertEquals(SIGSEGV, summary.signal, @"Incorrect summary signal");
+    STAssertTrue(summary.timestamp != 0, @"Summary timestamp not set");
+    STAssertTrue(summary.frames_signature != 0, @"Summary frame signature not set");
+
+    uint64_t app_hash = plcrash_report_summary_hash_init();
+    app_hash = plcrash_report_summary_hash(app_hash, "test.id", strlen("test.id") + 1);
+    app_hash = plcrash_report_summary_hash(app_hash, "1.0", strlen("1.0") + 1);
+    STAssertEquals(app_hash, summary.app_version_hash, @"Incorrect application version hash");
+
+    /* Sections are written in order, and the (optional) exception section is present */
+    uint32_t last_offset = 0;
+    for (int i = 0; i < PLCRASH_REPORT_SECTION_COUNT; i++) {
+        if (i == PLCRASH_REPORT_SECTION_CRASHED_THREAD)
+            continue;
+
+        STAssertTrue(summary.section_offsets[i] > last_offset, @"Section %d offset out of order", i);
+        STAssertTrue(summary.section_offsets[i] < statbuf.st_size, @"Section %d offset out of range", i);
+        last_offset = summary.section_offsets[i];
+    }
+
     /* Try to read the crash report */
     Plcrash__CrashReport *crashReport;
-    crashReport = plcrash__crash_report__unpack(&protobuf_c_system_allocator, statbuf.st_size - sizeof(struct PLCrashReportFileHeader), header->data);
+    size_t data_offset;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_data_offset(buf, statbuf.st_size, &data_offset), @"Could not find report data");
+    STAssertEquals(summary.section_offsets[PLCRASH_REPORT_SECTION_SYSTEM_INFO], (uint32_t) data_offset, @"System info should immediately follow the header");
+    crashReport = plcrash__crash_report__unpack(&protobuf_c_system_allocator, statbuf.st_size - data_offset, (const uint8_t *) buf + data_offset);
     
     /* If reading the report didn't fail, test the contents */
     STAssertNotNULL(crashReport, @"Could not decode crash report");
@@ -230,6 +322,11 @@
         [self checkThreads: crashReport];
         [self checkException: crashReport];
 
+        /* The summary's crashed thread index must match the report */
+        STAssertTrue(summary.crashed_thread < crashReport->n_threads, @"Summary crashed thread out of range");
+        if (summary.crashed_thread < crashReport->n_threads)
+            STAssertTrue(crashReport->threads[summary.crashed_thread]->crashed, @"Summary crashed thread is not the crashed thread");
+
         /* Check the signal info */
         STAssertTrue(strcmp(crashReport->signal->name, "SIGSEGV") == 0, @"Signal incorrect");
         STAssertTrue(strcmp(crashReport->signal->code, "SEGV_MAPERR") == 0, @"Signal code incorrect");
@@ -245,4 +342,320 @@
     plcrash_async_file_close(&file);
 }
 
+/* Measure the writer's stack usage across a range of thread counts and stack depths. The report is written on a
+ * fresh, zero-filled handler thread stack, and the high-water mark is compared against the size of the alternate
+ * signal stack used when no handler thread is enabled. */
+- (void) testStackUsage {
+    const uint32_t thread_counts[] = { 1, 8, 32 };
+    const uint32_t depths[] = { 1, 64, 512 };
+    const size_t sigstack_size = 64 * 1024;
+    plcrash_log_writer_t writer;
+    siginfo_t info;
+
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+        for (size_t j = 0; j < sizeof(depths) / sizeof(depths[0]); j++) {
+            uint32_t thread_count = thread_counts[i];
+            volatile int32_t parked = 0;
+            struct recurse_ctx rctx;
+            struct stack_usage_ctx ctx;
+            plcrash_handler_thread_t handler;
+            pthread_t threads[thread_count];
+            int park_fds[2];
+
+            /* Spawn the recursing threads, and wait for them to park */
+            STAssertEquals(0, pipe(park_fds), @"pipe() failed");
+            rctx.depth = depths[j];
+            rctx.park_fd = park_fds[0];
+            rctx.parked = &parked;
+
+            for (uint32_t t = 0; t < thread_count; t++)
+                pthread_create(&threads[t], NULL, recurse_thread, &rctx);
+
+            while (parked < (int32_t) thread_count)
+                usleep(1000);
+
+            /* Write the report from a fresh handler thread */
+            memset(&ctx, 0, sizeof(ctx));
+            ctx.writer = &writer;
+            ctx.path = [_logPath fileSystemRepresentation];
+            ctx.info = &info;
+            /* Treat the first recursing thread as the crashed thread; with no crash context, its full register
+             * state is fetched by the writer */
+            ctx.uap = NULL;
+            ctx.handler = &handler;
+
+            STAssertEquals(PLCRASH_ESUCCESS, plcrash_handler_thread_init(&handler, 1024 * 1024, stack_usage_callback, &ctx), @"Failed to spawn handler thread");
+            STAssertTrue(plcrash_handler_thread_dispatch(&handler, SIGSEGV, &info, NULL, pthread_mach_thread_np(threads[0])), @"Dispatch failed");
+            plcrash_handler_thread_free(&handler);
+
+            NSLog(@"Writer stack usage: threads=%u depth=%u used=%lu bytes", thread_count, depths[j], (unsigned long) ctx.stack_used);
+            STAssertNotEquals((size_t) 0, ctx.stack_used, @"Stack usage was not measured");
+            STAssertTrue(ctx.stack_used < sigstack_size, @"Writer stack usage of %lu bytes exceeds the %lu byte signal stack",
+                         (unsigned long) ctx.stack_used, (unsigned long) sigstack_size);
+
+            /* Release the recursing threads */
+            for (uint32_t t = 0; t < thread_count; t++)
+                write(park_fds[1], "x", 1);
+
+            for (uint32_t t = 0; t < thread_count; t++)
+                pthread_join(threads[t], NULL);
+
+            close(park_fds[0]);
+            close(park_fds[1]);
+        }
+    }
+
+    plcrash_log_writer_free(&writer);
+}
+
+/* A report written before the host information is loaded must still be complete and decodable */
+- (void) testDeferredHostInfo {
+    siginfo_t info;
+    plframe_thread_state_t thread_state;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+    NSError *error = nil;
+
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_thread_state_fetch(&thread_state, pthread_mach_thread_np(_thr_args.thread));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init_minimal(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    STAssertFalse(writer.host_info_loaded, @"Host information should not be loaded");
+    STAssertTrue(writer.machine_info.cpu_type != 0, @"CPU type is required for symbolication and must always be fetched");
+
+    /* Write the report */
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, pthread_mach_thread_np(_thr_args.thread), &file, &info, &thread_state.uap), @"Crash log failed");
+    plcrash_async_file_close(&file);
+
+    PLCrashReport *report = [[[PLCrashReport alloc] initWithData: [NSData dataWithContentsOfFile: _logPath] error: &error] autorelease];
+    STAssertNotNil(report, @"Could not decode report: %@", error);
+    STAssertEqualObjects(@"", report.systemInfo.operatingSystemVersion, @"OS version should be empty until loaded");
+    STAssertNil(report.systemInfo.operatingSystemBuild, @"OS build should be omitted until loaded");
+    STAssertEqualObjects(@"test.id", report.applicationInfo.applicationIdentifier, @"Incorrect app identifier");
+    STAssertEquals((NSUInteger) _dyld_image_count(), [report.images count], @"Loaded images were not registered");
+
+    /* Re-registering an image replaces its entry */
+    plcrash_log_writer_add_image(&writer, _dyld_get_image_header(0));
+    NSUInteger count = 0;
+    plcrash_async_image_t *image = NULL;
+    plcrash_async_image_list_set_reading(&writer.image_info.image_list, true);
+    while ((image = plcrash_async_image_list_next(&writer.image_info.image_list, image)) != NULL)
+        count++;
+    plcrash_async_image_list_set_reading(&writer.image_info.image_list, false);
+    STAssertEquals((NSUInteger) _dyld_image_count(), count, @"Re-registered image was duplicated");
+
+    /* Load and publish the host information */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_load_host_info(&writer), @"Could not load host info");
+    STAssertTrue(writer.host_info_loaded, @"Host information was not published");
+    STAssertNotNULL(writer.system_info.version, @"OS version was not loaded");
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+}
+
+- (void) testSymbolication {
+    siginfo_t info;
+    plframe_thread_state_t thread_state;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+    NSError *error = nil;
+
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_thread_state_fetch(&thread_state, pthread_mach_thread_np(_thr_args.thread));
+
+    /* Register all images with symbolication enabled */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    plcrash_log_writer_enable_symbolication(&writer, PLCRASH_LOG_WRITER_DEFAULT_SYMBOLICATION_LIMIT);
+    for (uint32_t i = 0; i < _dyld_image_count(); i++)
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+
+    STAssertTrue(writer.symbolication.symbol_count > 0, @"No symbols were loaded");
+    STAssertTrue(writer.symbolication.size <= writer.symbolication.limit, @"Symbol tables exceed the limit");
+
+    /* Write the report */
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, pthread_mach_thread_np(_thr_args.thread), &file, &info, &thread_state.uap), @"Crash log failed");
+    plcrash_async_file_close(&file);
+
+    /* Removing an image returns its table to the budget */
+    size_t size = writer.symbolication.size;
+    plcrash_log_writer_remove_image(&writer, _dyld_get_image_header(0));
+    STAssertTrue(writer.symbolication.size <= size, @"Symbol table size was not released");
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    /* The crashed thread's frames are symbolicated, and the symbols are vended with the frames */
+    PLCrashReport *report = [[[PLCrashReport alloc] initWithData: [NSData dataWithContentsOfFile: _logPath] error: &error] autorelease];
+    STAssertNotNil(report, @"Could not decode report: %@", error);
+
+    NSUInteger symbolicated = 0;
+    for (PLCrashReportThreadInfo *thread in report.threads) {
+        if (!thread.crashed)
+            continue;
+
+        for (NSUInteger i = 0; i < thread.stackFrameCount; i++) {
+            NSString *name = [thread symbolNameAtIndex: i];
+            PLCrashReportStackFrameInfo *frame = [thread.stackFrames objectAtIndex: i];
+
+            STAssertEqualObjects(name, frame.symbolName, @"Frame symbol does not match the packed symbol");
+            if (name == nil)
+                continue;
+
+            symbolicated++;
+            STAssertTrue([name length] > 0, @"Empty symbol name");
+            STAssertEquals([thread symbolOffsetAtIndex: i], frame.symbolOffset, @"Frame offset does not match the packed offset");
+        }
+    }
+    STAssertTrue(symbolicated > 0, @"No frames of the crashed thread were symbolicated");
+}
+
+/* The crash signature recorded at crash time must match the signature computed from the written report */
+- (void) testCrashSignature {
+    siginfo_t info;
+    plframe_thread_state_t thread_state;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+
+    memset(&info, 0, sizeof(info));
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_thread_state_fetch(&thread_state, pthread_mach_thread_np(_thr_args.thread));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    for (uint32_t i = 0; i < _dyld_image_count(); i++)
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+    plcrash_log_writer_set_exception(&writer, [NSException exceptionWithName: @"TestException" reason: @"TestReason" userInfo: nil]);
+
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, pthread_mach_thread_np(_thr_args.thread), &file, &info, &thread_state.uap), @"Crash log failed");
+    plcrash_async_file_close(&file);
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    NSData *data = [NSData dataWithContentsOfFile: _logPath];
+    plcrash_report_decoder_t decoder;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_decoder_init(&decoder, [data bytes], [data length]), @"Could not decode report");
+    STAssertTrue(decoder.has_summary, @"Report has no summary");
+    STAssertTrue(decoder.summary.frames_signature != 0, @"Crash signature not recorded");
+
+    /* Recompute the signature from the report, ignoring the summary */
+    plcrash_report_decoder_t unsummarized = decoder;
+    uint64_t signature;
+    unsummarized.has_summary = false;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_signature_compute(&unsummarized, PLCRASH_REPORT_SIGNATURE_FRAMES, &signature), @"Could not compute signature");
+    STAssertEquals(decoder.summary.frames_signature, signature, @"Crash-time and ingestion signatures differ");
+
+    /* The recorded signature is vended without recomputation */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_signature_compute(&decoder, PLCRASH_REPORT_SIGNATURE_FRAMES, &signature), @"Could not compute signature");
+    STAssertEquals(decoder.summary.frames_signature, signature, @"Recorded signature was not used");
+
+    PLCrashReport *report = [[[PLCrashReport alloc] initWithData: data error: NULL] autorelease];
+    STAssertEquals(decoder.summary.frames_signature, report.signature, @"Incorrect report signature");
+
+    plcrash_report_decoder_free(&decoder);
+}
+
+/* Measure the added cost of registering every loaded image with symbolication enabled, and the memory held by the
+ * resulting symbol tables. */
+- (void) testSymbolicationCost {
+    const int iterations = 10;
+    uint32_t image_count = _dyld_image_count();
+    mach_timebase_info_data_t timebase;
+    uint64_t plain_total = 0;
+    uint64_t symbolicated_total = 0;
+    plcrash_log_writer_t writer;
+
+    mach_timebase_info(&timebase);
+
+    for (int i = 0; i < iterations; i++) {
+        uint64_t start;
+
+        plcrash_log_writer_init(&writer, @"test.id", @"1.0");
+        start = mach_absolute_time();
+        for (uint32_t img = 0; img < image_count; img++)
+            plcrash_log_writer_add_image(&writer, _dyld_get_image_header(img));
+        plain_total += mach_absolute_time() - start;
+        plcrash_log_writer_free(&writer);
+
+        plcrash_log_writer_init(&writer, @"test.id", @"1.0");
+        plcrash_log_writer_enable_symbolication(&writer, PLCRASH_LOG_WRITER_DEFAULT_SYMBOLICATION_LIMIT);
+        start = mach_absolute_time();
+        for (uint32_t img = 0; img < image_count; img++)
+            plcrash_log_writer_add_image(&writer, _dyld_get_image_header(img));
+        symbolicated_total += mach_absolute_time() - start;
+
+        STAssertTrue(writer.symbolication.size <= PLCRASH_LOG_WRITER_DEFAULT_SYMBOLICATION_LIMIT, @"Symbol tables exceed the limit");
+        if (i == iterations - 1) {
+            NSLog(@"Symbol tables: images=%u symbols=%lu bytes=%lu skipped=%u", image_count,
+                  (unsigned long) writer.symbolication.symbol_count, (unsigned long) writer.symbolication.size,
+                  writer.symbolication.skipped_images);
+        }
+        plcrash_log_writer_free(&writer);
+    }
+
+    uint64_t plain_us = (plain_total * timebase.numer / timebase.denom) / iterations / 1000;
+    uint64_t symbolicated_us = (symbolicated_total * timebase.numer / timebase.denom) / iterations / 1000;
+    NSLog(@"Image registration: images=%u plain=%llu us symbolicated=%llu us", image_count, plain_us, symbolicated_us);
+}
+
+/* Compare the time spent on the enabling thread by a synchronous enable -- full writer initialization plus
+ * registration of every loaded image -- against a deferred enable, which performs only the minimal writer
+ * initialization on the enabling thread. Measured against an increasing number of loaded images. */
+- (void) testStartupLatency {
+    const int iterations = 10;
+    uint32_t image_count = _dyld_image_count();
+    mach_timebase_info_data_t timebase;
+
+    mach_timebase_info(&timebase);
+
+    for (uint32_t step = 1; step <= 4; step++) {
+        uint32_t images = (image_count * step) / 4;
+        uint64_t sync_total = 0;
+        uint64_t deferred_total = 0;
+
+        for (int i = 0; i < iterations; i++) {
+            plcrash_log_writer_t writer;
+            uint64_t start;
+
+            /* Synchronous */
+            start = mach_absolute_time();
+            plcrash_log_writer_init(&writer, @"test.id", @"1.0");
+            for (uint32_t img = 0; img < images; img++)
+                plcrash_log_writer_add_image(&writer, _dyld_get_image_header(img));
+            sync_total += mach_absolute_time() - start;
+
+            plcrash_log_writer_close(&writer);
+            plcrash_log_writer_free(&writer);
+
+            /* Deferred */
+            start = mach_absolute_time();
+            plcrash_log_writer_init_minimal(&writer, @"test.id", @"1.0");
+            deferred_total += mach_absolute_time() - start;
+
+            plcrash_log_writer_close(&writer);
+            plcrash_log_writer_free(&writer);
+        }
+
+        uint64_t sync_us = (sync_total * timebase.numer / timebase.denom) / iterations / 1000;
+        uint64_t deferred_us = (deferred_total * timebase.numer / timebase.denom) / iterations / 1000;
+        NSLog(@"Enable latency: images=%u synchronous=%llu us deferred=%llu us", images, sync_us, deferred_us);
+    }
+}
+
 @end
@@ -35,6 +35,8 @@
 #import "PLCrashReportThreadInfo.h"
 #import "PLCrashReportBinaryImageInfo.h"
 #import "PLCrashReportExceptionInfo.h"
+#import "PLCrashReportHandlerInfo.h"
+#import "PLCrashReportSecondaryCrashInfo.h"
 
 /** 
  * @ingroup constants
@@ -45,7 +47,7 @@
  * @ingroup constants
  * Crash format version byte identifier. Will not change outside of the introduction of
  * an entirely new crash log format. */
-#define PLCRASH_REPORT_FILE_VERSION 1
+#define PLCRASH_REPORT_FILE_VERSION 2
 
 /**
  * @ingroup types
@@ -55,6 +57,10 @@
  * followed by a single unsigned byte version number (#PLCRASH_REPORT_FILE_VERSION).
  * The crash log message format itself is extensible, so this version number will only
  * be incremented in the event of an incompatible encoding or format change.
+ *
+ * Version 2 files include a fixed-layout summary header between the version number and the
+ * encoded crash log; its first four bytes hold the header's total size, as a little-endian
+ * unsigned integer. Version 1 files are still supported by PLCrashReport.
  */
 struct PLCrashReportFileHeader {
     /** Crash log magic identifier, not NULL terminated */
@@ -79,6 +85,9 @@ typedef struct _PLCrashReportDecoder _PLCrashReportDecoder;
     /** Private implementation variables (used to hide the underlying protobuf parser) */
     _PLCrashReportDecoder *_decoder;
 
+    /** Encoded crash report. Sections are decoded from this data on first access. */
+    NSData *_data;
+
     /** System info */
     PLCrashReportSystemInfo *_systemInfo;
     
@@ -97,11 +106,20 @@ typedef struct _PLCrashReportDecoder _PLCrashReportDecoder;
     /** Thread info (PLCrashReportThreadInfo instances) */
     NSArray *_threads;
 
+    /** The crashed thread */
+    PLCrashReportThreadInfo *_crashedThread;
+
     /** Binary images (PLCrashReportBinaryImageInfo instances */
     NSArray *_images;
 
     /** Exception information (may be nil) */
     PLCrashReportExceptionInfo *_exceptionInfo;
+
+    /** Crash handler diagnostics (may be nil) */
+    PLCrashReportHandlerInfo *_handlerInfo;
+
+    /** Crashes on other threads that occured while the report was written */
+    NSArray *_secondaryCrashes;
 }
 
 - (id) initWithData: (NSData *) encodedData error: (NSError **) outError;
@@ -150,6 +168,12 @@ typedef struct _PLCrashReportDecoder _PLCrashReportDecoder;
  */
 @property(nonatomic, readonly) NSArray *threads;
 
+/**
+ * The thread that crashed, or nil if no crashed thread was recorded. Unlike #threads, this only decodes
+ * the crashed thread.
+ */
+@property(nonatomic, readonly) PLCrashReportThreadInfo *crashedThread;
+
 /**
  * Binary image information. Returns a list of PLCrashReportBinaryImageInfo instances.
  */
@@ -166,4 +190,29 @@ typedef struct _PLCrashReportDecoder _PLCrashReportDecoder;
  */
 @property(nonatomic, readonly) PLCrashReportExceptionInfo *exceptionInfo;
 
+/**
+ * YES if crash handler diagnostics are available.
+ */
+@property(nonatomic, readonly) BOOL hasHandlerInfo;
+
+/**
+ * Crash handler diagnostics, including the crash handler's stack usage. Only available if the crash handler's
+ * stack usage could be measured, otherwise nil.
+ */
+@property(nonatomic, readonly) PLCrashReportHandlerInfo *handlerInfo;
+
+/**
+ * Crashes that occured on other threads while the crash report was being written, as an array of
+ * PLCrashReportSecondaryCrashInfo instances. Empty if no other threads crashed.
+ */
+@property(nonatomic, readonly) NSArray *secondaryCrashes;
+
+/**
+ * A stable 64-bit signature of the crash, suitable for deduplicating and bucketing reports. The signature is
+ * derived from the signal, the uncaught exception name (if any), and the crashed thread's top frames, each
+ * expressed as its image's UUID and image-relative address. Reports of the same crash from different processes
+ * or devices share a signature. Returns 0 if the signature could not be computed.
+ */
+@property(nonatomic, readonly) uint64_t signature;
+
 @end
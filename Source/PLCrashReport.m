@@ -28,36 +28,58 @@
 
 #import "PLCrashReport.h"
 #import "CrashReporter.h"
+#import "PLCrashReportDecoder.h"
+#import "PLCrashReportImageIndex.h"
+#import "PLCrashReportSignature.h"
 
 #import "crash_report.pb-c.h"
 
 struct _PLCrashReportDecoder {
-    Plcrash__CrashReport *crashReport;
+    /** The report decoder. Backed by the report's retained NSData instance. */
+    plcrash_report_decoder_t decoder;
+
+    /** If true, image_index has been built from the report's binary images */
+    bool has_image_index;
+
+    /** Address index of the report's binary images. Only valid if has_image_index is true. */
+    plcrash_report_image_index_t image_index;
+
+    /** If true, signature has been computed */
+    bool has_signature;
+
+    /** The report's crash signature. Only valid if has_signature is true. */
+    uint64_t signature;
 };
 
 #define IMAGE_UUID_DIGEST_LEN 16
 
 @interface PLCrashReport (PrivateMethods)
 
-- (Plcrash__CrashReport *) decodeCrashData: (NSData *) data error: (NSError **) outError;
 - (PLCrashReportSystemInfo *) extractSystemInfo: (Plcrash__CrashReport__SystemInfo *) systemInfo error: (NSError **) outError;
 - (PLCrashReportProcessorInfo *) extractProcessorInfo: (Plcrash__CrashReport__Processor *) processorInfo error: (NSError **) outError;
 - (PLCrashReportMachineInfo *) extractMachineInfo: (Plcrash__CrashReport__MachineInfo *) machineInfo error: (NSError **) outError;
 - (PLCrashReportApplicationInfo *) extractApplicationInfo: (Plcrash__CrashReport__ApplicationInfo *) applicationInfo error: (NSError **) outError;
 - (PLCrashReportProcessInfo *) extractProcessInfo: (Plcrash__CrashReport__ProcessInfo *) processInfo error: (NSError **) outError;
-- (NSArray *) extractThreadInfo: (Plcrash__CrashReport *) crashReport error: (NSError **) outError;
-- (NSArray *) extractImageInfo: (Plcrash__CrashReport *) crashReport error: (NSError **) outError;
+- (PLCrashReportThreadInfo *) extractThreadInfo: (Plcrash__CrashReport__Thread *) thread error: (NSError **) outError;
+- (PLCrashReportBinaryImageInfo *) extractImageInfo: (Plcrash__CrashReport__BinaryImage *) image error: (NSError **) outError;
 - (PLCrashReportExceptionInfo *) extractExceptionInfo: (Plcrash__CrashReport__Exception *) exceptionInfo error: (NSError **) outError;
 - (PLCrashReportSignalInfo *) extractSignalInfo: (Plcrash__CrashReport__Signal *) signalInfo error: (NSError **) outError;
+- (PLCrashReportHandlerInfo *) extractHandlerInfo: (Plcrash__CrashReport__HandlerInfo *) handlerInfo error: (NSError **) outError;
+- (PLCrashReportSecondaryCrashInfo *) extractSecondaryCrashInfo: (Plcrash__CrashReport__SecondaryCrash *) crash error: (NSError **) outError;
 
 @end
 
 
 static void populate_nserror (NSError **error, PLCrashReporterError code, NSString *description);
+static void populate_decoder_nserror (NSError **error, const plcrash_report_decoder_t *decoder);
 
 /**
  * Provides decoding of crash logs generated by the PLCrashReporter framework.
  *
+ * The report's top-level sections are located when the report is initialized, but each section is only
+ * decoded on first access; the decoded result is cached for later use. A section that is present but can
+ * not be decoded is returned as nil.
+ *
  * @warning This API should be considered in-development and subject to change.
  */
 @implementation PLCrashReport
@@ -66,6 +88,9 @@ static void populate_nserror (NSError **error, PLCrashReporterError code, NSStri
  * Initialize with the provided crash log data. On error, nil will be returned, and
  * an NSError instance will be provided via @a error, if non-NULL.
  *
+ * The data's structure and the presence of all required sections are verified immediately. The
+ * sections themselves are decoded on first access.
+ *
  * @param encodedData Encoded plcrash crash log.
  * @param outError If an error occurs, this pointer will contain an NSError object
  * indicating why the crash log could not be parsed. If no error occurs, this parameter
@@ -82,59 +107,20 @@ static void populate_nserror (NSError **error, PLCrashReporterError code, NSStri
         return nil;
     }
 
+    /* Retain the data; sections are decoded from it on demand */
+    _data = [encodedData retain];
 
-    /* Allocate the struct and attempt to parse */
-    _decoder = malloc(sizeof(_PLCrashReportDecoder));
-    _decoder->crashReport = [self decodeCrashData: encodedData error: outError];
-
-    /* Check if decoding failed. If so, outError has already been populated. */
-    if (_decoder->crashReport == NULL) {
-        goto error;
-    }
-
-
-    /* System info */
-    _systemInfo = [[self extractSystemInfo: _decoder->crashReport->system_info error: outError] retain];
-    if (!_systemInfo)
-        goto error;
-    
-    /* Machine info */
-    _machineInfo = [[self extractMachineInfo: _decoder->crashReport->machine_info error: outError] retain];
-    if (!_machineInfo)
-        goto error;
-
-    /* Application info */
-    _applicationInfo = [[self extractApplicationInfo: _decoder->crashReport->application_info error: outError] retain];
-    if (!_applicationInfo)
+    /* Allocate the struct and attempt to locate the report's sections */
+    _decoder = calloc(1, sizeof(_PLCrashReportDecoder));
+    if (_decoder == NULL) {
+        populate_nserror(outError, PLCrashReporterErrorUnknown, @"Could not allocate decoder state");
         goto error;
-    
-    /* Process info. Handle missing info gracefully -- it is only included in v1.1+ crash reports. */
-    if (_decoder->crashReport->process_info != NULL) {
-        _processInfo = [[self extractProcessInfo: _decoder->crashReport->process_info error:outError] retain];
-        if (!_processInfo)
-            goto error;
     }
 
-    /* Signal info */
-    _signalInfo = [[self extractSignalInfo: _decoder->crashReport->signal error: outError] retain];
-    if (!_signalInfo)
-        goto error;
-
-    /* Thread info */
-    _threads = [[self extractThreadInfo: _decoder->crashReport error: outError] retain];
-    if (!_threads)
-        goto error;
-
-    /* Image info */
-    _images = [[self extractImageInfo: _decoder->crashReport error: outError] retain];
-    if (!_images)
+    /* Validates the header, section framing, and presence of all required sections */
+    if (plcrash_report_decoder_init(&_decoder->decoder, [encodedData bytes], [encodedData length]) != PLCRASH_ESUCCESS) {
+        populate_decoder_nserror(outError, &_decoder->decoder);
         goto error;
-
-    /* Exception info, if it is available */
-    if (_decoder->crashReport->exception != NULL) {
-        _exceptionInfo = [[self extractExceptionInfo: _decoder->crashReport->exception error: outError] retain];
-        if (!_exceptionInfo)
-            goto error;
     }
 
     return self;
@@ -147,23 +133,30 @@ error:
 - (void) dealloc {
     /* Free the data objects */
     [_systemInfo release];
+    [_machineInfo release];
     [_applicationInfo release];
     [_processInfo release];
     [_signalInfo release];
     [_threads release];
+    [_crashedThread release];
     [_images release];
     [_exceptionInfo release];
+    [_handlerInfo release];
+    [_secondaryCrashes release];
 
     /* Free the decoder state */
     if (_decoder != NULL) {
-        if (_decoder->crashReport != NULL) {
-            protobuf_c_message_free_unpacked((ProtobufCMessage *) _decoder->crashReport, &protobuf_c_system_allocator);
-        }
+        plcrash_report_decoder_free(&_decoder->decoder);
+
+        if (_decoder->has_image_index)
+            plcrash_report_image_index_free(&_decoder->image_index);
 
         free(_decoder);
         _decoder = NULL;
     }
 
+    [_data release];
+
     [super dealloc];
 }
 
@@ -171,101 +164,318 @@ error:
  * Return the binary image containing the given address, or nil if no binary image
  * is found.
  *
+ * An address index of the binary images is built on first use; subsequent lookups
+ * are O(log n) in the number of images.
+ *
  * @param address The address to search for.
  */
 - (PLCrashReportBinaryImageInfo *) imageForAddress: (uint64_t) address {
-    for (PLCrashReportBinaryImageInfo *imageInfo in self.images) {
-        if (imageInfo.imageBaseAddress <= address && address < (imageInfo.imageBaseAddress + imageInfo.imageSize))
-            return imageInfo;
+    NSArray *images = self.images;
+    size_t image;
+
+    @synchronized (self) {
+        /* Build the address index on first use */
+        if (!_decoder->has_image_index) {
+            NSUInteger count = [images count];
+            plcrash_report_image_range_t *ranges = malloc((count > 0 ? count : 1) * sizeof(plcrash_report_image_range_t));
+            if (ranges == NULL)
+                return nil;
+
+            for (NSUInteger i = 0; i < count; i++) {
+                PLCrashReportBinaryImageInfo *imageInfo = [images objectAtIndex: i];
+                ranges[i].base_address = imageInfo.imageBaseAddress;
+                ranges[i].size = imageInfo.imageSize;
+            }
+
+            plcrash_error_t err = plcrash_report_image_index_init(&_decoder->image_index, ranges, count);
+            free(ranges);
+            if (err != PLCRASH_ESUCCESS)
+                return nil;
+
+            _decoder->has_image_index = true;
+        }
+
+        if (!plcrash_report_image_index_lookup(&_decoder->image_index, address, &image))
+            return nil;
     }
 
-    /* Not found */
-    return nil;
+    return [images objectAtIndex: image];
+}
+
+// property getter. Returns the crash signature recorded at crash time, or computes it on first access.
+- (uint64_t) signature {
+    @synchronized (self) {
+        if (!_decoder->has_signature) {
+            if (plcrash_report_signature_compute(&_decoder->decoder, PLCRASH_REPORT_SIGNATURE_FRAMES, &_decoder->signature) != PLCRASH_ESUCCESS)
+                return 0;
+            _decoder->has_signature = true;
+        }
+
+        return _decoder->signature;
+    }
 }
 
 // property getter. Returns YES if machine information is available.
 - (BOOL) hasMachineInfo {
-    if (_machineInfo != nil)
+    if (plcrash_report_decoder_count(&_decoder->decoder, PLCRASH_REPORT_FIELD_MACHINE_INFO) > 0)
         return YES;
     return NO;
 }
 
 // property getter. Returns YES if process information is available.
 - (BOOL) hasProcessInfo {
-    if (_processInfo != nil)
+    if (plcrash_report_decoder_count(&_decoder->decoder, PLCRASH_REPORT_FIELD_PROCESS_INFO) > 0)
         return YES;
     return NO;
 }
 
 // property getter. Returns YES if exception information is available.
 - (BOOL) hasExceptionInfo {
-    if (_exceptionInfo != nil)
+    if (plcrash_report_decoder_count(&_decoder->decoder, PLCRASH_REPORT_FIELD_EXCEPTION) > 0)
         return YES;
     return NO;
 }
 
-@synthesize systemInfo = _systemInfo;
-@synthesize machineInfo = _machineInfo;
-@synthesize applicationInfo = _applicationInfo;
-@synthesize processInfo = _processInfo;
-@synthesize signalInfo = _signalInfo;
-@synthesize threads = _threads;
-@synthesize images = _images;
-@synthesize exceptionInfo = _exceptionInfo;
+// property getter. Returns YES if crash handler diagnostics are available.
+- (BOOL) hasHandlerInfo {
+    if (plcrash_report_decoder_count(&_decoder->decoder, PLCRASH_REPORT_FIELD_HANDLER_INFO) > 0)
+        return YES;
+    return NO;
+}
 
-@end
+// property getter. Decodes the system info on first access.
+- (PLCrashReportSystemInfo *) systemInfo {
+    @synchronized (self) {
+        if (_systemInfo == nil) {
+            ProtobufCArena arena;
+            Plcrash__CrashReport__SystemInfo *msg;
+            msg = plcrash_report_decoder_system_info(&_decoder->decoder, &arena);
+            if (msg != NULL)
+                _systemInfo = [[self extractSystemInfo: msg error: NULL] retain];
+            protobuf_c_arena_destroy(&arena);
+        }
 
+        return _systemInfo;
+    }
+}
 
-/**
- * @internal
- * Private Methods
- */
-@implementation PLCrashReport (PrivateMethods)
+// property getter. Decodes the machine info on first access.
+- (PLCrashReportMachineInfo *) machineInfo {
+    @synchronized (self) {
+        if (_machineInfo == nil) {
+            ProtobufCArena arena;
+            Plcrash__CrashReport__MachineInfo *msg;
+            msg = plcrash_report_decoder_machine_info(&_decoder->decoder, &arena);
+            if (msg != NULL)
+                _machineInfo = [[self extractMachineInfo: msg error: NULL] retain];
+            protobuf_c_arena_destroy(&arena);
+        }
 
-/**
- * Decode the crash log message.
- *
- * @warning MEMORY WARNING. The caller is responsible for deallocating th ePlcrash__CrashReport instance
- * returned by this method via protobuf_c_message_free_unpacked().
- */
-- (Plcrash__CrashReport *) decodeCrashData: (NSData *) data error: (NSError **) outError {
-    const struct PLCrashReportFileHeader *header;
-    const void *bytes;
+        return _machineInfo;
+    }
+}
+
+// property getter. Decodes the application info on first access.
+- (PLCrashReportApplicationInfo *) applicationInfo {
+    @synchronized (self) {
+        if (_applicationInfo == nil) {
+            ProtobufCArena arena;
+            Plcrash__CrashReport__ApplicationInfo *msg;
+            msg = plcrash_report_decoder_app_info(&_decoder->decoder, &arena);
+            if (msg != NULL)
+                _applicationInfo = [[self extractApplicationInfo: msg error: NULL] retain];
+            protobuf_c_arena_destroy(&arena);
+        }
+
+        return _applicationInfo;
+    }
+}
+
+// property getter. Decodes the process info on first access.
+- (PLCrashReportProcessInfo *) processInfo {
+    @synchronized (self) {
+        if (_processInfo == nil) {
+            ProtobufCArena arena;
+            Plcrash__CrashReport__ProcessInfo *msg;
+            msg = plcrash_report_decoder_process_info(&_decoder->decoder, &arena);
+            if (msg != NULL)
+                _processInfo = [[self extractProcessInfo: msg error: NULL] retain];
+            protobuf_c_arena_destroy(&arena);
+        }
+
+        return _processInfo;
+    }
+}
+
+// property getter. Decodes the signal info on first access.
+- (PLCrashReportSignalInfo *) signalInfo {
+    @synchronized (self) {
+        if (_signalInfo == nil) {
+            ProtobufCArena arena;
+            Plcrash__CrashReport__Signal *msg;
+            msg = plcrash_report_decoder_signal(&_decoder->decoder, &arena);
+            if (msg != NULL)
+                _signalInfo = [[self extractSignalInfo: msg error: NULL] retain];
+            protobuf_c_arena_destroy(&arena);
+        }
+
+        return _signalInfo;
+    }
+}
+
+// property getter. Decodes all threads on first access.
+- (NSArray *) threads {
+    @synchronized (self) {
+        if (_threads != nil)
+            return _threads;
+
+        size_t count = plcrash_report_decoder_count(&_decoder->decoder, PLCRASH_REPORT_FIELD_THREADS);
+        NSMutableArray *threads = [NSMutableArray arrayWithCapacity: count];
+        for (size_t i = 0; i < count; i++) {
+            ProtobufCArena arena;
+            Plcrash__CrashReport__Thread *msg;
+            msg = plcrash_report_decoder_thread(&_decoder->decoder, i, &arena);
+
+            PLCrashReportThreadInfo *threadInfo = nil;
+            if (msg != NULL)
+                threadInfo = [self extractThreadInfo: msg error: NULL];
+            protobuf_c_arena_destroy(&arena);
+            if (threadInfo == nil)
+                return nil;
+
+            [threads addObject: threadInfo];
+        }
+
+        _threads = [threads copy];
+        return _threads;
+    }
+}
 
-    bytes = [data bytes];
-    header = bytes;
+// property getter. Decodes only the crashed thread on first access.
+- (PLCrashReportThreadInfo *) crashedThread {
+    @synchronized (self) {
+        if (_crashedThread != nil)
+            return _crashedThread;
+
+        /* If the threads have already been decoded, use them */
+        if (_threads != nil) {
+            for (PLCrashReportThreadInfo *threadInfo in _threads) {
+                if (threadInfo.crashed) {
+                    _crashedThread = [threadInfo retain];
+                    break;
+                }
+            }
+            return _crashedThread;
+        }
 
-    /* Verify that the crash log is sufficently large */
-    if (sizeof(struct PLCrashReportFileHeader) >= [data length]) {
-        populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, NSLocalizedString(@"Could not decode truncated crash log",
-                                                                                             @"Crash log decoding error message"));
-        return NULL;
+        /* Otherwise, decode threads until the crashed thread is found, starting with the thread named in the summary
+         * header (if any) */
+        ProtobufCArena arena;
+        Plcrash__CrashReport__Thread *msg = plcrash_report_decoder_crashed_thread(&_decoder->decoder, &arena, NULL);
+        if (msg != NULL)
+            _crashedThread = [[self extractThreadInfo: msg error: NULL] retain];
+        protobuf_c_arena_destroy(&arena);
+
+        return _crashedThread;
     }
+}
 
-    /* Check the file magic */
-    if (memcmp(header->magic, PLCRASH_REPORT_FILE_MAGIC, strlen(PLCRASH_REPORT_FILE_MAGIC)) != 0) {
-        populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid,NSLocalizedString(@"Could not decode invalid crash log header",
-                                                                                            @"Crash log decoding error message"));
-        return NULL;
+// property getter. Decodes all binary images on first access.
+- (NSArray *) images {
+    @synchronized (self) {
+        if (_images != nil)
+            return _images;
+
+        size_t count = plcrash_report_decoder_count(&_decoder->decoder, PLCRASH_REPORT_FIELD_BINARY_IMAGES);
+        NSMutableArray *images = [NSMutableArray arrayWithCapacity: count];
+        for (size_t i = 0; i < count; i++) {
+            ProtobufCArena arena;
+            Plcrash__CrashReport__BinaryImage *msg;
+            msg = plcrash_report_decoder_image(&_decoder->decoder, i, &arena);
+
+            PLCrashReportBinaryImageInfo *imageInfo = nil;
+            if (msg != NULL)
+                imageInfo = [self extractImageInfo: msg error: NULL];
+            protobuf_c_arena_destroy(&arena);
+            if (imageInfo == nil)
+                return nil;
+
+            [images addObject: imageInfo];
+        }
+
+        _images = [images copy];
+        return _images;
     }
+}
 
-    /* Check the version */
-    if(header->version != PLCRASH_REPORT_FILE_VERSION) {
-        populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, [NSString stringWithFormat: NSLocalizedString(@"Could not decode unsupported crash report version: %d", 
-                                                                                                                         @"Crash log decoding message"), header->version]);
-        return NULL;
+// property getter. Decodes the exception info on first access.
+- (PLCrashReportExceptionInfo *) exceptionInfo {
+    @synchronized (self) {
+        if (_exceptionInfo == nil) {
+            ProtobufCArena arena;
+            Plcrash__CrashReport__Exception *msg;
+            msg = plcrash_report_decoder_exception(&_decoder->decoder, &arena);
+            if (msg != NULL)
+                _exceptionInfo = [[self extractExceptionInfo: msg error: NULL] retain];
+            protobuf_c_arena_destroy(&arena);
+        }
+
+        return _exceptionInfo;
     }
+}
+
+// property getter. Decodes the crash handler diagnostics on first access.
+- (PLCrashReportHandlerInfo *) handlerInfo {
+    @synchronized (self) {
+        if (_handlerInfo == nil) {
+            ProtobufCArena arena;
+            Plcrash__CrashReport__HandlerInfo *msg;
+            msg = plcrash_report_decoder_handler_info(&_decoder->decoder, &arena);
+            if (msg != NULL)
+                _handlerInfo = [[self extractHandlerInfo: msg error: NULL] retain];
+            protobuf_c_arena_destroy(&arena);
+        }
 
-    Plcrash__CrashReport *crashReport = plcrash__crash_report__unpack(&protobuf_c_system_allocator, [data length] - sizeof(struct PLCrashReportFileHeader), header->data);
-    if (crashReport == NULL) {
-        populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, NSLocalizedString(@"An unknown error occured decoding the crash report", 
-                                                                                             @"Crash log decoding error message"));
-        return NULL;
+        return _handlerInfo;
     }
+}
+
+// property getter. Decodes all secondary crashes on first access.
+- (NSArray *) secondaryCrashes {
+    @synchronized (self) {
+        if (_secondaryCrashes != nil)
+            return _secondaryCrashes;
+
+        size_t count = plcrash_report_decoder_count(&_decoder->decoder, PLCRASH_REPORT_FIELD_SECONDARY_CRASHES);
+        NSMutableArray *crashes = [NSMutableArray arrayWithCapacity: count];
+        for (size_t i = 0; i < count; i++) {
+            ProtobufCArena arena;
+            Plcrash__CrashReport__SecondaryCrash *msg;
+            msg = plcrash_report_decoder_secondary_crash(&_decoder->decoder, i, &arena);
+
+            PLCrashReportSecondaryCrashInfo *crashInfo = nil;
+            if (msg != NULL)
+                crashInfo = [self extractSecondaryCrashInfo: msg error: NULL];
+            protobuf_c_arena_destroy(&arena);
+            if (crashInfo == nil)
+                return nil;
+
+            [crashes addObject: crashInfo];
+        }
 
-    return crashReport;
+        _secondaryCrashes = [crashes copy];
+        return _secondaryCrashes;
+    }
 }
 
+@end
+
+
+/**
+ * @internal
+ * Private Methods
+ */
+@implementation PLCrashReport (PrivateMethods)
 
 /**
  * Extract system information from the crash log. Returns nil on error.
@@ -435,121 +645,115 @@ error:
 }
 
 /**
- * Extract thread information from the crash log. Returns nil on error, or an array of PLCrashLogThreadInfo
- * instances on success.
+ * Extract a thread's information from the crash log. Returns nil on error.
  */
-- (NSArray *) extractThreadInfo: (Plcrash__CrashReport *) crashReport error: (NSError **) outError {
-    /* There should be at least one thread */
-    if (crashReport->n_threads == 0) {
-        populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid,
-                         NSLocalizedString(@"Crash report is missing thread state information",
-                                           @"Missing thread info in crash report"));
-        return nil;
+- (PLCrashReportThreadInfo *) extractThreadInfo: (Plcrash__CrashReport__Thread *) thread error: (NSError **) outError {
+    PLCrashReportThreadInfo *threadInfo = nil;
+
+    /* The thread info copies the frame and register values into packed arrays; gather them here */
+    size_t frameCount = thread->n_frames;
+    size_t registerCount = thread->n_registers;
+    uint64_t *instructionPointers = malloc((frameCount > 0 ? frameCount : 1) * sizeof(uint64_t));
+    const char **symbolNames = malloc((frameCount > 0 ? frameCount : 1) * sizeof(const char *));
+    uint64_t *symbolOffsets = malloc((frameCount > 0 ? frameCount : 1) * sizeof(uint64_t));
+    uint64_t *registerValues = malloc((registerCount > 0 ? registerCount : 1) * sizeof(uint64_t));
+    const char **registerNames = malloc((registerCount > 0 ? registerCount : 1) * sizeof(const char *));
+    BOOL hasSymbols = NO;
+
+    if (instructionPointers == NULL || symbolNames == NULL || symbolOffsets == NULL || registerValues == NULL || registerNames == NULL) {
+        populate_nserror(outError, PLCrashReporterErrorUnknown, @"Could not allocate thread state");
+        goto cleanup;
     }
 
-    /* Handle all threads */
-    NSMutableArray *threadResult = [NSMutableArray arrayWithCapacity: crashReport->n_threads];
-    for (size_t thr_idx = 0; thr_idx < crashReport->n_threads; thr_idx++) {
-        Plcrash__CrashReport__Thread *thread = crashReport->threads[thr_idx];
-        
-        /* Fetch stack frames for this thread */
-        NSMutableArray *frames = [NSMutableArray arrayWithCapacity: thread->n_frames];
-        for (size_t frame_idx = 0; frame_idx < thread->n_frames; frame_idx++) {
-            Plcrash__CrashReport__Thread__StackFrame *frame = thread->frames[frame_idx];
-            PLCrashReportStackFrameInfo *frameInfo;
+    /* Fetch stack frames for this thread */
+    for (size_t frame_idx = 0; frame_idx < frameCount; frame_idx++) {
+        Plcrash__CrashReport__Thread__StackFrame *frame = thread->frames[frame_idx];
 
-            frameInfo = [[[PLCrashReportStackFrameInfo alloc] initWithInstructionPointer: frame->pc] autorelease];
-            [frames addObject: frameInfo];
-        }
-
-        /* Fetch registers for this thread */
-        NSMutableArray *registers = [NSMutableArray arrayWithCapacity: thread->n_registers];
-        for (size_t reg_idx = 0; reg_idx < thread->n_registers; reg_idx++) {
-            Plcrash__CrashReport__Thread__RegisterValue *reg = thread->registers[reg_idx];
-            PLCrashReportRegisterInfo *regInfo;
+        instructionPointers[frame_idx] = frame->pc;
+        symbolNames[frame_idx] = frame->symbol_name;
+        symbolOffsets[frame_idx] = frame->symbol_offset;
+        if (frame->symbol_name != NULL)
+            hasSymbols = YES;
+    }
 
-            /* Handle missing register name (should not occur!) */
-            if (reg->name == NULL) {
-                populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, @"Missing register name in register value");
-                return nil;
-            }
+    /* Fetch registers for this thread */
+    for (size_t reg_idx = 0; reg_idx < registerCount; reg_idx++) {
+        Plcrash__CrashReport__Thread__RegisterValue *reg = thread->registers[reg_idx];
 
-            regInfo = [[[PLCrashReportRegisterInfo alloc] initWithRegisterName: [NSString stringWithUTF8String: reg->name]
-                                                              registerValue: reg->value] autorelease];
-            [registers addObject: regInfo];
+        /* Handle missing register name (should not occur!) */
+        if (reg->name == NULL) {
+            populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, @"Missing register name in register value");
+            goto cleanup;
         }
 
-        /* Create the thread info instance */
-        PLCrashReportThreadInfo *threadInfo = [[[PLCrashReportThreadInfo alloc] initWithThreadNumber: thread->thread_number
-                                                                                   stackFrames: frames 
-                                                                                       crashed: thread->crashed 
-                                                                                     registers: registers] autorelease];
-        [threadResult addObject: threadInfo];
+        registerNames[reg_idx] = reg->name;
+        registerValues[reg_idx] = reg->value;
     }
-    
-    return threadResult;
-}
 
+    /* Create the thread info instance */
+    threadInfo = [[[PLCrashReportThreadInfo alloc] initWithThreadNumber: thread->thread_number
+                                                    instructionPointers: instructionPointers
+                                                            symbolNames: hasSymbols ? symbolNames : NULL
+                                                          symbolOffsets: hasSymbols ? symbolOffsets : NULL
+                                                        stackFrameCount: frameCount
+                                                                crashed: thread->crashed
+                                                          registerNames: registerNames
+                                                         registerValues: registerValues
+                                                          registerCount: registerCount] autorelease];
+    if (threadInfo == nil)
+        populate_nserror(outError, PLCrashReporterErrorUnknown, @"Could not allocate thread state");
+
+cleanup:
+    free(instructionPointers);
+    free(symbolNames);
+    free(symbolOffsets);
+    free(registerValues);
+    free(registerNames);
+
+    return threadInfo;
+}
 
 /**
  * Extract binary image information from the crash log. Returns nil on error.
  */
-- (NSArray *) extractImageInfo: (Plcrash__CrashReport *) crashReport error: (NSError **) outError {
-    /* There should be at least one image */
-    if (crashReport->n_binary_images == 0) {
-        populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid,
-                         NSLocalizedString(@"Crash report is missing binary image information",
-                                           @"Missing image info in crash report"));
+- (PLCrashReportBinaryImageInfo *) extractImageInfo: (Plcrash__CrashReport__BinaryImage *) image error: (NSError **) outError {
+    /* Validate */
+    if (image->name == NULL) {
+        populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, @"Missing image name in image record");
         return nil;
     }
 
-    /* Handle all records */
-    NSMutableArray *images = [NSMutableArray arrayWithCapacity: crashReport->n_binary_images];
-    for (size_t i = 0; i < crashReport->n_binary_images; i++) {
-        Plcrash__CrashReport__BinaryImage *image = crashReport->binary_images[i];
-        PLCrashReportBinaryImageInfo *imageInfo;
+    /* Convert UUID to hex string */
+    NSString *uuid = nil;
+    if (image->uuid.len == 0) {
+        /* No UUID */
+        uuid = nil;
+    } else if (image->uuid.len != IMAGE_UUID_DIGEST_LEN) {
+        /* Invalid UUID */
+        populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, @"Invalid image binary UUID length");
+        return nil;
+    } else if (image->uuid.len != 0) {
+        /* Valid UUID */
 
-        /* Validate */
-        if (image->name == NULL) {
-            populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, @"Missing image name in image record");
-            return nil;
-        }
+        /* Convert to ascii */
+        char output[(IMAGE_UUID_DIGEST_LEN * 2) + 1];
+        const char hex[] = "0123456789abcdef";
 
-        /* Convert UUID to hex string */
-        NSString *uuid = nil;
-        if (image->uuid.len == 0) {
-            /* No UUID */
-            uuid = nil;
-        } else if (image->uuid.len != IMAGE_UUID_DIGEST_LEN) {
-            /* Invalid UUID */
-            populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, @"Invalid image binary UUID length");
-            return nil;
-        } else if (image->uuid.len != 0) {
-            /* Valid UUID */
-    
-            /* Convert to ascii */
-            char output[(IMAGE_UUID_DIGEST_LEN * 2) + 1];
-            const char hex[] = "0123456789abcdef";
-
-            for (int i = 0; i < IMAGE_UUID_DIGEST_LEN; i++) {
-                unsigned char c = ((unsigned char *) image->uuid.data)[i];
-                output[i * 2 + 0] = hex[c >> 4];
-                output[i * 2 + 1] = hex[c & 0x0F];
-            }
-            output[sizeof(output)] = '\0';
-    
-            uuid = [[[NSString alloc] initWithBytes: output length: sizeof(output) - 1 encoding: NSASCIIStringEncoding] autorelease];
+        for (int i = 0; i < IMAGE_UUID_DIGEST_LEN; i++) {
+            unsigned char c = ((unsigned char *) image->uuid.data)[i];
+            output[i * 2 + 0] = hex[c >> 4];
+            output[i * 2 + 1] = hex[c & 0x0F];
         }
+        output[sizeof(output) - 1] = '\0';
 
-        assert(image->uuid.len == 0 || uuid != nil);
-        imageInfo = [[[PLCrashReportBinaryImageInfo alloc] initWithImageBaseAddress: image->base_address 
-                                                                       imageSize: image->size 
-                                                                       imageName: [NSString stringWithUTF8String: image->name]
-                                                                       imageUUID: uuid] autorelease];
-        [images addObject: imageInfo];
+        uuid = [[[NSString alloc] initWithBytes: output length: sizeof(output) - 1 encoding: NSASCIIStringEncoding] autorelease];
     }
 
-    return images;
+    assert(image->uuid.len == 0 || uuid != nil);
+    return [[[PLCrashReportBinaryImageInfo alloc] initWithImageBaseAddress: image->base_address 
+                                                                 imageSize: image->size 
+                                                                 imageName: [NSString stringWithUTF8String: image->name]
+                                                                 imageUUID: uuid] autorelease];
 }
 
 /**
@@ -626,6 +830,36 @@ error:
     return [[[PLCrashReportSignalInfo alloc] initWithSignalName: name code: code address: signalInfo->address] autorelease];
 }
 
+/**
+ * Extract crash handler diagnostics from the crash log. Returns nil on error.
+ */
+- (PLCrashReportHandlerInfo *) extractHandlerInfo: (Plcrash__CrashReport__HandlerInfo *) handlerInfo
+                                            error: (NSError **) outError
+{
+    /* Validate */
+    if (handlerInfo == NULL) {
+        populate_nserror(outError, PLCrashReporterErrorCrashReportInvalid, 
+                         NSLocalizedString(@"Crash report is missing Handler Information section", 
+                                           @"Missing handler info in crash report"));
+        return nil;
+    }
+
+    return [[[PLCrashReportHandlerInfo alloc] initWithStackSize: handlerInfo->stack_size stackUsed: handlerInfo->stack_used] autorelease];
+}
+
+/**
+ * Extract secondary crash information from the crash log. Returns nil on error.
+ */
+- (PLCrashReportSecondaryCrashInfo *) extractSecondaryCrashInfo: (Plcrash__CrashReport__SecondaryCrash *) crash error: (NSError **) outError {
+    PLCrashReportSignalInfo *signalInfo;
+
+    signalInfo = [self extractSignalInfo: crash->signal error: outError];
+    if (signalInfo == nil)
+        return nil;
+
+    return [[[PLCrashReportSecondaryCrashInfo alloc] initWithSignalInfo: signalInfo programCounter: crash->pc] autorelease];
+}
+
 @end
 
 /**
@@ -652,4 +886,78 @@ static void populate_nserror (NSError **error, PLCrashReporterError code, NSStri
                 ];
     
     *error = [NSError errorWithDomain: PLCrashReporterErrorDomain code: code userInfo: userInfo];
-}
\ No newline at end of file
+}
+
+/**
+ * @internal
+ *
+ * Populate an NSError instance describing why @a decoder could not be initialized.
+ *
+ * @param error Error instance to populate. If NULL, this method returns
+ * and nothing is modified.
+ * @param decoder The decoder that failed to initialize.
+ */
+static void populate_decoder_nserror (NSError **error, const plcrash_report_decoder_t *decoder) {
+    NSString *description = nil;
+
+    switch (decoder->error) {
+        case PLCRASH_REPORT_DECODE_TRUNCATED:
+            description = NSLocalizedString(@"Could not decode truncated crash log", @"Crash log decoding error message");
+            break;
+
+        case PLCRASH_REPORT_DECODE_BAD_HEADER:
+            description = NSLocalizedString(@"Could not decode invalid crash log header", @"Crash log decoding error message");
+            break;
+
+        case PLCRASH_REPORT_DECODE_BAD_VERSION:
+            description = [NSString stringWithFormat: NSLocalizedString(@"Could not decode unsupported crash report version: %d",
+                                                                        @"Crash log decoding message"), decoder->version];
+            break;
+
+        case PLCRASH_REPORT_DECODE_NOMEM:
+            populate_nserror(error, PLCrashReporterErrorUnknown, @"Could not allocate decoder state");
+            return;
+
+        case PLCRASH_REPORT_DECODE_MISSING_SECTION:
+            switch (decoder->error_field) {
+                case PLCRASH_REPORT_FIELD_SYSTEM_INFO:
+                    description = NSLocalizedString(@"Crash report is missing System Information section",
+                                                    @"Missing sysinfo in crash report");
+                    break;
+
+                case PLCRASH_REPORT_FIELD_MACHINE_INFO:
+                    description = NSLocalizedString(@"Crash report is missing Machine Information section",
+                                                    @"Missing machine_info in crash report");
+                    break;
+
+                case PLCRASH_REPORT_FIELD_APP_INFO:
+                    description = NSLocalizedString(@"Crash report is missing Application Information section",
+                                                    @"Missing app info in crash report");
+                    break;
+
+                case PLCRASH_REPORT_FIELD_SIGNAL:
+                    description = NSLocalizedString(@"Crash report is missing Signal Information section",
+                                                    @"Missing appinfo in crash report");
+                    break;
+
+                case PLCRASH_REPORT_FIELD_THREADS:
+                    description = NSLocalizedString(@"Crash report is missing thread state information",
+                                                    @"Missing thread info in crash report");
+                    break;
+
+                case PLCRASH_REPORT_FIELD_BINARY_IMAGES:
+                    description = NSLocalizedString(@"Crash report is missing binary image information",
+                                                    @"Missing image info in crash report");
+                    break;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (description == nil)
+        description = NSLocalizedString(@"An unknown error occured decoding the crash report", @"Crash log decoding error message");
+
+    populate_nserror(error, PLCrashReporterErrorCrashReportInvalid, description);
+}
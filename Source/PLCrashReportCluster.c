@@ -0,0 +1,412 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashReportCluster.h"
+#import "PLCrashReportSignature.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <libkern/OSByteOrder.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_report_cluster Crash Report Clustering
+ * @ingroup plcrash_internal
+ *
+ * Near-duplicate crash grouping.
+ *
+ * Crash signatures (see @ref plcrash_report_signature) only group reports whose top frames are identical; a change
+ * in inlining or a rebuilt binary splits one bug across many signatures. Clustering instead groups reports whose
+ * crashed thread frames are mostly the same.
+ *
+ * Each of a report's top crashed thread frames is reduced to a shingle: the frame's image file name, together with
+ * the frame's symbol name as recorded at crash time or, if unavailable, the frame's image-relative offset rounded
+ * down to a coarse bucket. The report's set of shingles is summarized by a fixed-size MinHash sketch, whose values
+ * agree between two reports with a probability equal to the Jaccard similarity of their shingle sets.
+ *
+ * Sketches are split into bands of rows, and reports whose sketches agree on every row of any band are candidates
+ * for grouping (locality-sensitive hashing). Bands are independent, and may be processed concurrently; candidates
+ * whose estimated similarity meets a threshold are merged with a lock-free union-find. Memory use is linear in the
+ * number of reports, and no pairwise comparison of the corpus is performed.
+ *
+ * @{
+ */
+
+/* Golden ratio increment used to derive each MinHash function's seed */
+#define MINHASH_SEED_STEP 0x9E3779B97F4A7C15ULL
+
+/*
+ * 64-bit finalizer (from MurmurHash3). Every input bit affects every output bit, so that distinct seeds yield
+ * independent hash functions.
+ */
+static inline uint64_t mix64 (uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+/**
+ * Initialize @a config with the default clustering parameters.
+ */
+void plcrash_report_cluster_config_init (plcrash_report_cluster_config_t *config) {
+    config->bands = PLCRASH_REPORT_CLUSTER_DEFAULT_BANDS;
+    config->rows = PLCRASH_REPORT_CLUSTER_DEFAULT_ROWS;
+    config->frames = PLCRASH_REPORT_CLUSTER_DEFAULT_FRAMES;
+    config->offset_shift = PLCRASH_REPORT_CLUSTER_DEFAULT_OFFSET_SHIFT;
+    config->threshold = PLCRASH_REPORT_CLUSTER_DEFAULT_THRESHOLD;
+}
+
+/*
+ * Return the shingle of a single frame.
+ */
+static uint64_t frame_shingle (const Plcrash__CrashReport__Thread__StackFrame *frame, const Plcrash__CrashReport__BinaryImage *image,
+                               uint32_t offset_shift)
+{
+    plcrash_report_signature_t sig;
+    const char *name = "";
+    uint64_t offset = frame->pc;
+
+    /* Use the image's file name, rather than its full (possibly install-specific) path */
+    if (image != NULL) {
+        name = image->name;
+        for (const char *p = image->name; *p != '\0'; p++) {
+            if (*p == '/')
+                name = p + 1;
+        }
+
+        offset = frame->pc - image->base_address;
+    }
+
+    plcrash_report_signature_init(&sig);
+    plcrash_report_signature_update(&sig, name, strlen(name) + 1);
+
+    if (frame->symbol_name != NULL) {
+        plcrash_report_signature_update(&sig, "s", 1);
+        plcrash_report_signature_update(&sig, frame->symbol_name, strlen(frame->symbol_name) + 1);
+    } else {
+        offset = (offset_shift < 64) ? offset >> offset_shift : 0;
+        offset = OSSwapHostToLittleInt64(offset);
+        plcrash_report_signature_update(&sig, "o", 1);
+        plcrash_report_signature_update(&sig, &offset, sizeof(offset));
+    }
+
+    return plcrash_report_signature_final(&sig);
+}
+
+/**
+ * Compute the MinHash sketch of a report's crashed thread frames.
+ *
+ * @param decoder The report decoder.
+ * @param config The clustering parameters.
+ * @param sketch On success, the report's config->bands * config->rows MinHash values.
+ * @param shingle_count On success, the number of frames from which the sketch was computed. If zero, the sketch
+ * is meaningless, and the report should not be grouped with others.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or PLCRASH_ENOMEM if memory could not be allocated.
+ */
+plcrash_error_t plcrash_report_minhash_compute (const plcrash_report_decoder_t *decoder, const plcrash_report_cluster_config_t *config,
+                                                uint32_t *sketch, size_t *shingle_count)
+{
+    uint32_t hash_count = config->bands * config->rows;
+    ProtobufCArena thread_arena;
+    ProtobufCArena arena;
+
+    for (uint32_t i = 0; i < hash_count; i++)
+        sketch[i] = UINT32_MAX;
+    *shingle_count = 0;
+
+    Plcrash__CrashReport__Thread *thread = plcrash_report_decoder_crashed_thread(decoder, &thread_arena, NULL);
+    if (thread == NULL || thread->n_frames == 0 || config->frames == 0) {
+        protobuf_c_arena_destroy(&thread_arena);
+        return PLCRASH_ESUCCESS;
+    }
+
+    size_t frame_count = thread->n_frames;
+    if (frame_count > config->frames)
+        frame_count = config->frames;
+
+    Plcrash__CrashReport__BinaryImage **images = calloc(frame_count, sizeof(*images));
+    if (images == NULL) {
+        protobuf_c_arena_destroy(&thread_arena);
+        return PLCRASH_ENOMEM;
+    }
+
+    protobuf_c_arena_init(&arena, decoder->message_len);
+    plcrash_report_decoder_frame_images(decoder, thread, frame_count, &arena.allocator, images);
+
+    for (size_t f = 0; f < frame_count; f++) {
+        uint64_t shingle = frame_shingle(thread->frames[f], images[f], config->offset_shift);
+        uint64_t seed = 0;
+
+        for (uint32_t i = 0; i < hash_count; i++) {
+            seed += MINHASH_SEED_STEP;
+
+            uint32_t value = (uint32_t) (mix64(shingle ^ seed) >> 32);
+            if (value < sketch[i])
+                sketch[i] = value;
+        }
+    }
+
+    *shingle_count = frame_count;
+
+    free(images);
+    protobuf_c_arena_destroy(&arena);
+    protobuf_c_arena_destroy(&thread_arena);
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Return the estimated Jaccard similarity of two MinHash sketches: the fraction of their values that are equal.
+ */
+double plcrash_report_minhash_similarity (const uint32_t *a, const uint32_t *b, uint32_t hash_count) {
+    uint32_t equal = 0;
+
+    if (hash_count == 0)
+        return 0.0;
+
+    for (uint32_t i = 0; i < hash_count; i++) {
+        if (a[i] == b[i])
+            equal++;
+    }
+
+    return (double) equal / hash_count;
+}
+
+/**
+ * Initialize clustering state for @a count reports. Each report is initially in its own cluster.
+ *
+ * @param cluster The clustering state to initialize.
+ * @param config The clustering parameters.
+ * @param count The number of reports.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if the parameters are invalid, or PLCRASH_ENOMEM if
+ * memory could not be allocated.
+ */
+plcrash_error_t plcrash_report_cluster_init (plcrash_report_cluster_t *cluster, const plcrash_report_cluster_config_t *config, size_t count) {
+    memset(cluster, 0, sizeof(*cluster));
+
+    if (config->bands == 0 || config->rows == 0 || config->rows > PLCRASH_REPORT_MINHASH_MAX ||
+        config->bands > PLCRASH_REPORT_MINHASH_MAX / config->rows || count > UINT32_MAX)
+    {
+        return PLCRASH_EINVAL;
+    }
+
+    cluster->config = *config;
+    cluster->hash_count = config->bands * config->rows;
+    cluster->count = count;
+
+    size_t alloc_count = (count > 0) ? count : 1;
+    cluster->sketches = calloc(alloc_count, cluster->hash_count * sizeof(uint32_t));
+    cluster->has_sketch = calloc(alloc_count, sizeof(bool));
+    cluster->parent = calloc(alloc_count, sizeof(uint32_t));
+    if (cluster->sketches == NULL || cluster->has_sketch == NULL || cluster->parent == NULL) {
+        plcrash_report_cluster_free(cluster);
+        return PLCRASH_ENOMEM;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        cluster->parent[i] = (uint32_t) i;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Compute and record the sketch of the report at @a index. Reports with distinct indices may be added
+ * concurrently. All reports must be added before any band is processed.
+ *
+ * @param cluster The clustering state.
+ * @param index The report's index.
+ * @param decoder The report decoder.
+ */
+plcrash_error_t plcrash_report_cluster_add (plcrash_report_cluster_t *cluster, size_t index, const plcrash_report_decoder_t *decoder) {
+    size_t shingle_count;
+    plcrash_error_t err;
+
+    if (index >= cluster->count)
+        return PLCRASH_EINVAL;
+
+    err = plcrash_report_minhash_compute(decoder, &cluster->config, cluster->sketches + index * cluster->hash_count, &shingle_count);
+    if (err != PLCRASH_ESUCCESS)
+        return err;
+
+    cluster->has_sketch[index] = (shingle_count > 0);
+    return PLCRASH_ESUCCESS;
+}
+
+/*
+ * Return the root of @a index's cluster, halving the path as it is walked. Concurrent path halving is safe: a
+ * non-root entry only ever moves to another of its ancestors, and roots are only modified by cluster_union().
+ *
+ * Links are read atomically, and each halving step is a compare and swap that is abandoned if the link was
+ * concurrently updated, so that the walk never races with cluster_union() or another walk.
+ */
+static uint32_t cluster_root (volatile uint32_t *parent, uint32_t index) {
+    uint32_t next;
+
+    while ((next = __atomic_load_n(&parent[index], __ATOMIC_RELAXED)) != index) {
+        uint32_t grandparent = __atomic_load_n(&parent[next], __ATOMIC_RELAXED);
+        if (grandparent != next)
+            __sync_bool_compare_and_swap(&parent[index], next, grandparent);
+
+        index = next;
+    }
+
+    return index;
+}
+
+/*
+ * Merge the clusters of @a a and @a b. The root with the higher index is linked to the root with the lower index
+ * with an atomic compare and swap, which fails (and is retried) if the higher root was concurrently linked
+ * elsewhere.
+ */
+static void cluster_union (volatile uint32_t *parent, uint32_t a, uint32_t b) {
+    for (;;) {
+        a = cluster_root(parent, a);
+        b = cluster_root(parent, b);
+        if (a == b)
+            return;
+
+        if (a < b) {
+            uint32_t tmp = a;
+            a = b;
+            b = tmp;
+        }
+
+        if (__sync_bool_compare_and_swap(&parent[a], a, b))
+            return;
+    }
+}
+
+/*
+ * A report's key within a single band.
+ */
+typedef struct band_entry {
+    /* Hash of the report's rows within the band */
+    uint64_t key;
+
+    /* Report index */
+    uint32_t index;
+} band_entry_t;
+
+static int band_entry_compare (const void *a, const void *b) {
+    const band_entry_t *ea = a;
+    const band_entry_t *eb = b;
+
+    if (ea->key != eb->key)
+        return (ea->key < eb->key) ? -1 : 1;
+
+    return (ea->index < eb->index) ? -1 : (ea->index > eb->index);
+}
+
+/**
+ * Group the reports that agree on every row of @a band, and whose estimated similarity meets the configured
+ * threshold. Distinct bands may be processed concurrently.
+ *
+ * Reports sharing a band key are sorted by index. Each is compared against the first report sharing the key, and,
+ * if that report is not similar enough (a chance collision), against its immediate predecessor.
+ *
+ * @param cluster The clustering state.
+ * @param band The band to process.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if @a band is out of range, or PLCRASH_ENOMEM if
+ * memory could not be allocated.
+ */
+plcrash_error_t plcrash_report_cluster_band (plcrash_report_cluster_t *cluster, uint32_t band) {
+    uint32_t rows = cluster->config.rows;
+    uint32_t hash_count = cluster->hash_count;
+
+    if (band >= cluster->config.bands)
+        return PLCRASH_EINVAL;
+
+    band_entry_t *entries = malloc(((cluster->count > 0) ? cluster->count : 1) * sizeof(band_entry_t));
+    if (entries == NULL)
+        return PLCRASH_ENOMEM;
+
+    size_t count = 0;
+    for (size_t i = 0; i < cluster->count; i++) {
+        if (!cluster->has_sketch[i])
+            continue;
+
+        entries[count].key = plcrash_report_signature_hash(cluster->sketches + i * hash_count + band * rows, rows * sizeof(uint32_t));
+        entries[count].index = (uint32_t) i;
+        count++;
+    }
+
+    qsort(entries, count, sizeof(band_entry_t), band_entry_compare);
+
+    size_t run = 0;
+    for (size_t i = 1; i < count; i++) {
+        if (entries[i].key != entries[run].key) {
+            run = i;
+            continue;
+        }
+
+        const uint32_t *sketch = cluster->sketches + (size_t) entries[i].index * hash_count;
+        uint32_t candidates[2] = { entries[run].index, entries[i - 1].index };
+
+        for (int c = 0; c < 2; c++) {
+            const uint32_t *other = cluster->sketches + (size_t) candidates[c] * hash_count;
+            if (plcrash_report_minhash_similarity(sketch, other, hash_count) >= cluster->config.threshold) {
+                cluster_union(cluster->parent, entries[i].index, candidates[c]);
+                break;
+            }
+        }
+    }
+
+    free(entries);
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Return the cluster of the report at @a index, identified by the lowest report index within the cluster. Must
+ * not be called concurrently with plcrash_report_cluster_band().
+ */
+size_t plcrash_report_cluster_find (plcrash_report_cluster_t *cluster, size_t index) {
+    return cluster_root(cluster->parent, (uint32_t) index);
+}
+
+/**
+ * Free all clustering state.
+ */
+void plcrash_report_cluster_free (plcrash_report_cluster_t *cluster) {
+    free(cluster->sketches);
+    free(cluster->has_sketch);
+    free((void *) cluster->parent);
+
+    cluster->sketches = NULL;
+    cluster->has_sketch = NULL;
+    cluster->parent = NULL;
+}
+
+/**
+ * @} plcrash_report_cluster
+ */
@@ -0,0 +1,143 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#import "PLCrashAsync.h"
+#import "PLCrashReportDecoder.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_report_cluster
+ *
+ * Maximum number of MinHash values in a sketch (bands * rows).
+ */
+#define PLCRASH_REPORT_MINHASH_MAX 64
+
+/**
+ * @internal
+ * @ingroup plcrash_report_cluster
+ *
+ * Default number of LSH bands.
+ */
+#define PLCRASH_REPORT_CLUSTER_DEFAULT_BANDS 8
+
+/**
+ * @internal
+ * @ingroup plcrash_report_cluster
+ *
+ * Default number of MinHash values per LSH band.
+ */
+#define PLCRASH_REPORT_CLUSTER_DEFAULT_ROWS 4
+
+/**
+ * @internal
+ * @ingroup plcrash_report_cluster
+ *
+ * Default number of crashed thread frames from which shingles are formed.
+ */
+#define PLCRASH_REPORT_CLUSTER_DEFAULT_FRAMES 16
+
+/**
+ * @internal
+ * @ingroup plcrash_report_cluster
+ *
+ * Default granularity of the offset buckets used for frames without a symbol name, as a power of two.
+ */
+#define PLCRASH_REPORT_CLUSTER_DEFAULT_OFFSET_SHIFT 8
+
+/**
+ * @internal
+ * @ingroup plcrash_report_cluster
+ *
+ * Default minimum estimated similarity of two reports grouped by a shared LSH band.
+ */
+#define PLCRASH_REPORT_CLUSTER_DEFAULT_THRESHOLD 0.5
+
+/**
+ * @internal
+ * @ingroup plcrash_report_cluster
+ *
+ * Clustering parameters.
+ */
+typedef struct plcrash_report_cluster_config {
+    /** Number of LSH bands */
+    uint32_t bands;
+
+    /** Number of MinHash values per band. bands * rows must not exceed PLCRASH_REPORT_MINHASH_MAX. */
+    uint32_t rows;
+
+    /** Number of crashed thread frames from which shingles are formed */
+    uint32_t frames;
+
+    /** Frames without a symbol name are bucketed by their image-relative offset, shifted right by offset_shift */
+    uint32_t offset_shift;
+
+    /** Minimum fraction of matching MinHash values required to group two reports sharing a band */
+    double threshold;
+} plcrash_report_cluster_config_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_cluster
+ *
+ * Clustering state for a fixed number of reports. Memory use is linear in the number of reports.
+ */
+typedef struct plcrash_report_cluster {
+    /** Clustering parameters */
+    plcrash_report_cluster_config_t config;
+
+    /** Number of MinHash values in each sketch (bands * rows) */
+    uint32_t hash_count;
+
+    /** Number of reports */
+    size_t count;
+
+    /** MinHash sketches, hash_count values per report */
+    uint32_t *sketches;
+
+    /** If false, the report has no shingles, and is not grouped with any other report */
+    bool *has_sketch;
+
+    /** Union-find parent of each report. A root is its own parent, and is the lowest index in its cluster. */
+    volatile uint32_t *parent;
+} plcrash_report_cluster_t;
+
+void plcrash_report_cluster_config_init (plcrash_report_cluster_config_t *config);
+
+plcrash_error_t plcrash_report_minhash_compute (const plcrash_report_decoder_t *decoder, const plcrash_report_cluster_config_t *config,
+                                                uint32_t *sketch, size_t *shingle_count);
+double plcrash_report_minhash_similarity (const uint32_t *a, const uint32_t *b, uint32_t hash_count);
+
+plcrash_error_t plcrash_report_cluster_init (plcrash_report_cluster_t *cluster, const plcrash_report_cluster_config_t *config, size_t count);
+plcrash_error_t plcrash_report_cluster_add (plcrash_report_cluster_t *cluster, size_t index, const plcrash_report_decoder_t *decoder);
+plcrash_error_t plcrash_report_cluster_band (plcrash_report_cluster_t *cluster, uint32_t band);
+size_t plcrash_report_cluster_find (plcrash_report_cluster_t *cluster, size_t index);
+void plcrash_report_cluster_free (plcrash_report_cluster_t *cluster);
@@ -0,0 +1,166 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+#import "PLCrashTestReportBuilder.h"
+#import "CrashReporter.h"
+#import "PLCrashReportCluster.h"
+
+@interface PLCrashReportClusterTests : SenTestCase @end
+
+/* Crashed thread frame offsets of two unrelated crashes */
+static const uint64_t first_offsets[] = { 0x100, 0x2040, 0x3180, 0x4234, 0x5010, 0x6400, 0x7800, 0x8c00 };
+static const uint64_t second_offsets[] = { 0x10100, 0x12040, 0x13180, 0x14234, 0x15010, 0x16400, 0x17800, 0x18c00 };
+
+#define OFFSET_COUNT (sizeof(first_offsets) / sizeof(first_offsets[0]))
+
+/*
+ * Encode a version 1 crash report with a single image loaded at @a base, whose crashed thread's frames are
+ * @a offsets. If @a jitter is non-zero, it is added to every offset.
+ */
+static NSData *cluster_report (uint64_t base, const uint64_t *offsets, size_t count, uint64_t jitter) {
+    NSMutableData *report = plcrash_test_report_header();
+    plcrash_test_append_report_info(report, "com.example.cluster", "SIGSEGV", 0);
+
+    NSMutableData *thread = [NSMutableData data];
+    plcrash_test_append_uint(thread, 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        NSMutableData *frame = [NSMutableData data];
+        plcrash_test_append_uint(frame, 3, base + offsets[i] + jitter);
+        plcrash_test_append_message(thread, 2, frame);
+    }
+    plcrash_test_append_uint(thread, 3, 1);
+    plcrash_test_append_message(report, 3, thread);
+
+    NSMutableData *image = [NSMutableData data];
+    plcrash_test_append_uint(image, 1, base);
+    plcrash_test_append_uint(image, 2, 0x20000);
+    plcrash_test_append_string(image, 3, "/usr/lib/libcluster.dylib");
+    plcrash_test_append_message(report, 4, image);
+
+    return report;
+}
+
+/* Add @a report to @a cluster at @a index */
+static plcrash_error_t cluster_add (plcrash_report_cluster_t *cluster, size_t index, NSData *report) {
+    plcrash_report_decoder_t decoder;
+    plcrash_error_t err;
+
+    err = plcrash_report_decoder_init(&decoder, [report bytes], [report length]);
+    if (err == PLCRASH_ESUCCESS)
+        err = plcrash_report_cluster_add(cluster, index, &decoder);
+
+    plcrash_report_decoder_free(&decoder);
+    return err;
+}
+
+/* Compute the sketch of @a report, returning the number of shingles, or 0 on failure */
+static size_t report_sketch (NSData *report, const plcrash_report_cluster_config_t *config, uint32_t *sketch) {
+    plcrash_report_decoder_t decoder;
+    size_t shingles = 0;
+
+    if (plcrash_report_decoder_init(&decoder, [report bytes], [report length]) == PLCRASH_ESUCCESS) {
+        if (plcrash_report_minhash_compute(&decoder, config, sketch, &shingles) != PLCRASH_ESUCCESS)
+            shingles = 0;
+    }
+
+    plcrash_report_decoder_free(&decoder);
+    return shingles;
+}
+
+@implementation PLCrashReportClusterTests
+
+/* Sketches depend only on image-relative frames, and offsets are compared at bucket granularity */
+- (void) testSketch {
+    plcrash_report_cluster_config_t config;
+    uint32_t first[PLCRASH_REPORT_MINHASH_MAX];
+    uint32_t second[PLCRASH_REPORT_MINHASH_MAX];
+
+    plcrash_report_cluster_config_init(&config);
+    uint32_t hash_count = config.bands * config.rows;
+
+    STAssertEquals((size_t) OFFSET_COUNT, report_sketch(cluster_report(0x1000000, first_offsets, OFFSET_COUNT, 0), &config, first), @"Incorrect shingle count");
+
+    report_sketch(cluster_report(0x7000000, first_offsets, OFFSET_COUNT, 0), &config, second);
+    STAssertEquals(1.0, plcrash_report_minhash_similarity(first, second, hash_count), @"Sketch depends on load address");
+
+    report_sketch(cluster_report(0x1000000, first_offsets, OFFSET_COUNT, 0x10), &config, second);
+    STAssertEquals(1.0, plcrash_report_minhash_similarity(first, second, hash_count), @"Sketch depends on offset within bucket");
+
+    report_sketch(cluster_report(0x1000000, second_offsets, OFFSET_COUNT, 0), &config, second);
+    STAssertTrue(plcrash_report_minhash_similarity(first, second, hash_count) < config.threshold, @"Unrelated crashes are similar");
+}
+
+/* Near-duplicate reports are grouped under the lowest index; unrelated and empty reports are not */
+- (void) testCluster {
+    plcrash_report_cluster_config_t config;
+    plcrash_report_cluster_t cluster;
+    uint64_t mutated[OFFSET_COUNT];
+
+    /* Replace a single frame */
+    memcpy(mutated, first_offsets, sizeof(mutated));
+    mutated[3] = 0x1f000;
+
+    plcrash_report_cluster_config_init(&config);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_cluster_init(&cluster, &config, 5), @"Could not initialize cluster");
+
+    STAssertEquals(PLCRASH_ESUCCESS, cluster_add(&cluster, 0, cluster_report(0x1000000, second_offsets, OFFSET_COUNT, 0)), @"Could not add report");
+    STAssertEquals(PLCRASH_ESUCCESS, cluster_add(&cluster, 1, cluster_report(0x1000000, first_offsets, OFFSET_COUNT, 0)), @"Could not add report");
+    STAssertEquals(PLCRASH_ESUCCESS, cluster_add(&cluster, 2, cluster_report(0x1000000, first_offsets, 0, 0)), @"Could not add report");
+    STAssertEquals(PLCRASH_ESUCCESS, cluster_add(&cluster, 3, cluster_report(0x5000000, mutated, OFFSET_COUNT, 0)), @"Could not add report");
+    STAssertEquals(PLCRASH_ESUCCESS, cluster_add(&cluster, 4, cluster_report(0x3000000, first_offsets, OFFSET_COUNT, 0)), @"Could not add report");
+    STAssertEquals(PLCRASH_EINVAL, cluster_add(&cluster, 5, cluster_report(0x1000000, first_offsets, OFFSET_COUNT, 0)), @"Accepted out-of-range index");
+
+    for (uint32_t band = 0; band < config.bands; band++)
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_cluster_band(&cluster, band), @"Could not process band");
+
+    STAssertEquals((size_t) 0, plcrash_report_cluster_find(&cluster, 0), @"Unrelated report was grouped");
+    STAssertEquals((size_t) 1, plcrash_report_cluster_find(&cluster, 1), @"Root is not the lowest index");
+    STAssertEquals((size_t) 2, plcrash_report_cluster_find(&cluster, 2), @"Report without frames was grouped");
+    STAssertEquals((size_t) 1, plcrash_report_cluster_find(&cluster, 3), @"Near-duplicate report was not grouped");
+    STAssertEquals((size_t) 1, plcrash_report_cluster_find(&cluster, 4), @"Duplicate report was not grouped");
+
+    plcrash_report_cluster_free(&cluster);
+}
+
+/* Band configurations exceeding the sketch size are rejected */
+- (void) testInvalidConfig {
+    plcrash_report_cluster_config_t config;
+    plcrash_report_cluster_t cluster;
+
+    plcrash_report_cluster_config_init(&config);
+    config.rows = 0;
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_cluster_init(&cluster, &config, 1), @"Accepted empty bands");
+
+    plcrash_report_cluster_config_init(&config);
+    config.bands = PLCRASH_REPORT_MINHASH_MAX;
+    config.rows = 2;
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_cluster_init(&cluster, &config, 1), @"Accepted oversized sketch");
+}
+
+@end
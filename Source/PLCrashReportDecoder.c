@@ -0,0 +1,598 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashReportDecoder.h"
+#import "PLCrashReportUnpack.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_report_decoder Crash Report Decoder
+ * @ingroup plcrash_internal
+ *
+ * Foundation-free crash report decoding.
+ *
+ * plcrash_report_decoder_init() validates a crash report file's header, reads its summary (if any), and records
+ * the location of each of the report's top-level sections without decoding them. Individual sections are then
+ * decoded on demand into the plain C structures generated from crash_report.proto, allocated from a
+ * caller-supplied ProtobufCArena.
+ *
+ * The decoder depends only on the C library and the bundled protobuf-c runtime, and may be built for any
+ * platform; PLCrashReport is implemented on top of it. An initialized decoder is never modified, and may be
+ * shared between threads, provided that each thread uses its own arena.
+ *
+ * @{
+ */
+
+/** @internal Crash report file magic. Must match PLCRASH_REPORT_FILE_MAGIC. */
+#define PLCRASH_REPORT_DECODER_MAGIC "plcrash"
+
+/** @internal Length of the file magic and version byte. */
+#define PLCRASH_REPORT_DECODER_PREFIX_LEN (sizeof(PLCRASH_REPORT_DECODER_MAGIC) - 1 + sizeof(uint8_t))
+
+/** @internal Protobuf wire types */
+enum {
+    PLCRASH_REPORT_WIRE_VARINT = 0,
+    PLCRASH_REPORT_WIRE_64BIT = 1,
+    PLCRASH_REPORT_WIRE_LENGTH_DELIMITED = 2,
+    PLCRASH_REPORT_WIRE_32BIT = 5
+};
+
+/** @internal Message descriptors of the known top-level fields, indexed by field number. */
+static const ProtobufCMessageDescriptor *field_descriptors[PLCRASH_REPORT_FIELD_MAX + 1] = {
+    [PLCRASH_REPORT_FIELD_SYSTEM_INFO] = &plcrash__crash_report__system_info__descriptor,
+    [PLCRASH_REPORT_FIELD_APP_INFO] = &plcrash__crash_report__application_info__descriptor,
+    [PLCRASH_REPORT_FIELD_THREADS] = &plcrash__crash_report__thread__descriptor,
+    [PLCRASH_REPORT_FIELD_BINARY_IMAGES] = &plcrash__crash_report__binary_image__descriptor,
+    [PLCRASH_REPORT_FIELD_EXCEPTION] = &plcrash__crash_report__exception__descriptor,
+    [PLCRASH_REPORT_FIELD_SIGNAL] = &plcrash__crash_report__signal__descriptor,
+    [PLCRASH_REPORT_FIELD_PROCESS_INFO] = &plcrash__crash_report__process_info__descriptor,
+    [PLCRASH_REPORT_FIELD_MACHINE_INFO] = &plcrash__crash_report__machine_info__descriptor,
+    [PLCRASH_REPORT_FIELD_HANDLER_INFO] = &plcrash__crash_report__handler_info__descriptor,
+    [PLCRASH_REPORT_FIELD_SECONDARY_CRASHES] = &plcrash__crash_report__secondary_crash__descriptor
+};
+
+/**
+ * @internal
+ *
+ * Top-level sections that must be present in every report, in the order they are checked. A report lacking any of
+ * these is rejected by plcrash_report_decoder_init() and by plcrash_report_validate().
+ */
+const plcrash_report_field_number_t plcrash_report_required_fields[] = {
+    PLCRASH_REPORT_FIELD_SYSTEM_INFO,
+    PLCRASH_REPORT_FIELD_MACHINE_INFO,
+    PLCRASH_REPORT_FIELD_APP_INFO,
+    PLCRASH_REPORT_FIELD_SIGNAL,
+    PLCRASH_REPORT_FIELD_THREADS,
+    PLCRASH_REPORT_FIELD_BINARY_IMAGES
+};
+
+/** @internal Number of entries in plcrash_report_required_fields. */
+const size_t plcrash_report_required_field_count = sizeof(plcrash_report_required_fields) / sizeof(plcrash_report_required_fields[0]);
+
+/**
+ * @internal
+ *
+ * Decode a base 128 varint from @a data, advancing @a pos past the decoded value. Returns false if the
+ * varint is truncated or exceeds 64 bits.
+ *
+ * @param data The data to read from.
+ * @param len The length of @a data.
+ * @param pos The current read position.
+ * @param value On success, the decoded value.
+ */
+static bool scan_varint (const uint8_t *data, size_t len, size_t *pos, uint64_t *value) {
+    uint64_t result = 0;
+
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        if (*pos >= len)
+            return false;
+
+        uint8_t byte = data[(*pos)++];
+        result |= ((uint64_t) (byte & 0x7F)) << shift;
+
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+
+    /* Over-long encoding */
+    return false;
+}
+
+/**
+ * @internal
+ *
+ * Walk the encoded report's top-level fields, recording the location of each known field.
+ */
+static plcrash_report_decode_error_t scan_fields (plcrash_report_decoder_t *decoder) {
+    const uint8_t *message = decoder->message;
+    size_t len = decoder->message_len;
+    size_t capacity = 0;
+    size_t pos = 0;
+
+    while (pos < len) {
+        uint64_t tag;
+        uint64_t value;
+
+        if (!scan_varint(message, len, &pos, &tag) || (tag >> 3) == 0)
+            return PLCRASH_REPORT_DECODE_MALFORMED;
+
+        uint64_t number = tag >> 3;
+        uint32_t wire_type = tag & 0x7;
+
+        /* All known fields are embedded messages */
+        if (number <= PLCRASH_REPORT_FIELD_MAX && wire_type != PLCRASH_REPORT_WIRE_LENGTH_DELIMITED)
+            return PLCRASH_REPORT_DECODE_MALFORMED;
+
+        switch (wire_type) {
+            case PLCRASH_REPORT_WIRE_VARINT:
+                if (!scan_varint(message, len, &pos, &value))
+                    return PLCRASH_REPORT_DECODE_MALFORMED;
+                break;
+
+            case PLCRASH_REPORT_WIRE_64BIT:
+                if (len - pos < 8)
+                    return PLCRASH_REPORT_DECODE_MALFORMED;
+                pos += 8;
+                break;
+
+            case PLCRASH_REPORT_WIRE_32BIT:
+                if (len - pos < 4)
+                    return PLCRASH_REPORT_DECODE_MALFORMED;
+                pos += 4;
+                break;
+
+            case PLCRASH_REPORT_WIRE_LENGTH_DELIMITED:
+                if (!scan_varint(message, len, &pos, &value) || value > len - pos)
+                    return PLCRASH_REPORT_DECODE_MALFORMED;
+
+                /* Record known fields */
+                if (number <= PLCRASH_REPORT_FIELD_MAX) {
+                    if (decoder->field_count == capacity) {
+                        size_t new_capacity = (capacity == 0) ? 64 : capacity * 2;
+                        plcrash_report_field_t *fields = realloc(decoder->fields, new_capacity * sizeof(plcrash_report_field_t));
+                        if (fields == NULL)
+                            return PLCRASH_REPORT_DECODE_NOMEM;
+
+                        decoder->fields = fields;
+                        capacity = new_capacity;
+                    }
+
+                    plcrash_report_field_t *field = &decoder->fields[decoder->field_count++];
+                    field->number = (uint32_t) number;
+                    field->offset = pos;
+                    field->length = (size_t) value;
+                    decoder->occurrences[number]++;
+                }
+
+                pos += (size_t) value;
+                break;
+
+            default:
+                return PLCRASH_REPORT_DECODE_MALFORMED;
+        }
+    }
+
+    return PLCRASH_REPORT_DECODE_OK;
+}
+
+/**
+ * @internal
+ *
+ * Group the recorded fields by field number, allowing the nth occurrence of any field to be found in
+ * constant time.
+ */
+static plcrash_report_decode_error_t index_fields (plcrash_report_decoder_t *decoder) {
+    size_t next[PLCRASH_REPORT_FIELD_MAX + 1];
+    size_t start = 0;
+
+    for (uint32_t number = 0; number <= PLCRASH_REPORT_FIELD_MAX; number++) {
+        decoder->field_index_start[number] = start;
+        next[number] = start;
+        start += decoder->occurrences[number];
+    }
+
+    decoder->field_index = malloc((decoder->field_count > 0 ? decoder->field_count : 1) * sizeof(size_t));
+    if (decoder->field_index == NULL)
+        return PLCRASH_REPORT_DECODE_NOMEM;
+
+    for (size_t i = 0; i < decoder->field_count; i++)
+        decoder->field_index[next[decoder->fields[i].number]++] = i;
+
+    return PLCRASH_REPORT_DECODE_OK;
+}
+
+/**
+ * @internal
+ *
+ * Return the @a index occurrence of top-level field @a number, which must exist.
+ */
+static const plcrash_report_field_t *field_at (const plcrash_report_decoder_t *decoder, plcrash_report_field_number_t number, size_t index) {
+    return &decoder->fields[decoder->field_index[decoder->field_index_start[number] + index]];
+}
+
+/**
+ * Initialize a decoder with the crash report file in @a data. The file header and the framing of the report's
+ * top-level sections are validated, and the presence of all required sections is verified; the sections
+ * themselves are not decoded.
+ *
+ * @param decoder The decoder to initialize.
+ * @param data The crash report file contents. This buffer is not copied, and must remain valid until the decoder
+ * is freed.
+ * @param len The length of @a data.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_ENOMEM if the decoder state could not be allocated, or
+ * PLCRASH_EINVAL if the report could not be decoded; the specific reason is provided by the decoder's error
+ * and error_field members. On failure, the decoder must still be released via plcrash_report_decoder_free().
+ */
+plcrash_error_t plcrash_report_decoder_init (plcrash_report_decoder_t *decoder, const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    size_t offset;
+
+    memset(decoder, 0, sizeof(*decoder));
+
+    /* Verify that the crash log is sufficently large */
+    if (len <= PLCRASH_REPORT_DECODER_PREFIX_LEN) {
+        decoder->error = PLCRASH_REPORT_DECODE_TRUNCATED;
+        return PLCRASH_EINVAL;
+    }
+
+    /* Check the file magic */
+    if (memcmp(bytes, PLCRASH_REPORT_DECODER_MAGIC, strlen(PLCRASH_REPORT_DECODER_MAGIC)) != 0) {
+        decoder->error = PLCRASH_REPORT_DECODE_BAD_HEADER;
+        return PLCRASH_EINVAL;
+    }
+    decoder->version = bytes[PLCRASH_REPORT_DECODER_PREFIX_LEN - 1];
+
+    /* Check the version, and skip any summary header */
+    switch (plcrash_report_data_offset(bytes, len, &offset)) {
+        case PLCRASH_ESUCCESS:
+            break;
+
+        case PLCRASH_ENOTSUP:
+            decoder->error = PLCRASH_REPORT_DECODE_BAD_VERSION;
+            return PLCRASH_EINVAL;
+
+        default:
+            decoder->error = PLCRASH_REPORT_DECODE_BAD_HEADER;
+            return PLCRASH_EINVAL;
+    }
+
+    /* Fetch the summary, if any. Older reports do not include one. */
+    if (plcrash_report_summary_read(bytes, len, &decoder->summary) == PLCRASH_ESUCCESS)
+        decoder->has_summary = true;
+
+    decoder->message = bytes + offset;
+    decoder->message_len = len - offset;
+
+    /* Locate the top-level sections */
+    if ((decoder->error = scan_fields(decoder)) != PLCRASH_REPORT_DECODE_OK ||
+        (decoder->error = index_fields(decoder)) != PLCRASH_REPORT_DECODE_OK)
+    {
+        return (decoder->error == PLCRASH_REPORT_DECODE_NOMEM) ? PLCRASH_ENOMEM : PLCRASH_EINVAL;
+    }
+
+    /* Verify that all required sections are present */
+    for (size_t i = 0; i < plcrash_report_required_field_count; i++) {
+        if (decoder->occurrences[plcrash_report_required_fields[i]] == 0) {
+            decoder->error = PLCRASH_REPORT_DECODE_MISSING_SECTION;
+            decoder->error_field = plcrash_report_required_fields[i];
+            return PLCRASH_EINVAL;
+        }
+    }
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Free all resources associated with @a decoder. Messages previously unpacked from the decoder remain valid
+ * until their arenas are destroyed.
+ */
+void plcrash_report_decoder_free (plcrash_report_decoder_t *decoder) {
+    if (decoder->fields != NULL)
+        free(decoder->fields);
+
+    if (decoder->field_index != NULL)
+        free(decoder->field_index);
+
+    decoder->fields = NULL;
+    decoder->field_index = NULL;
+}
+
+/**
+ * Return a human readable description of @a error.
+ */
+const char *plcrash_report_decode_error_description (plcrash_report_decode_error_t error) {
+    switch (error) {
+        case PLCRASH_REPORT_DECODE_OK:
+            return "No error";
+        case PLCRASH_REPORT_DECODE_TRUNCATED:
+            return "Truncated crash report";
+        case PLCRASH_REPORT_DECODE_BAD_HEADER:
+            return "Invalid crash report header";
+        case PLCRASH_REPORT_DECODE_BAD_VERSION:
+            return "Unsupported crash report version";
+        case PLCRASH_REPORT_DECODE_MALFORMED:
+            return "Malformed crash report";
+        case PLCRASH_REPORT_DECODE_MISSING_SECTION:
+            return "Missing required crash report section";
+        case PLCRASH_REPORT_DECODE_NOMEM:
+            return "Could not allocate decoder state";
+    }
+
+    return "Unknown error";
+}
+
+/**
+ * Return the number of occurrences of top-level field @a number.
+ */
+size_t plcrash_report_decoder_count (const plcrash_report_decoder_t *decoder, plcrash_report_field_number_t number) {
+    if (number < 1 || number > PLCRASH_REPORT_FIELD_MAX)
+        return 0;
+
+    return decoder->occurrences[number];
+}
+
+/**
+ * Unpack the embedded message of the @a index occurrence of top-level field @a number into @a arena, which is
+ * initialized by this function and sized from the field's length. Returns NULL if the field is not present, or
+ * on error.
+ *
+ * @warning MEMORY WARNING. The caller is responsible for releasing the arena, and with it the returned message,
+ * via protobuf_c_arena_destroy(). This must be done even if NULL is returned.
+ */
+ProtobufCMessage *plcrash_report_decoder_unpack (const plcrash_report_decoder_t *decoder, plcrash_report_field_number_t number,
+                                                 size_t index, ProtobufCArena *arena)
+{
+    if (index >= plcrash_report_decoder_count(decoder, number)) {
+        protobuf_c_arena_init(arena, 0);
+        return NULL;
+    }
+
+    protobuf_c_arena_init(arena, field_at(decoder, number, index)->length);
+    return plcrash_report_decoder_unpack_allocator(decoder, number, index, &arena->allocator);
+}
+
+/**
+ * Unpack the embedded message of the @a index occurrence of top-level field @a number using @a allocator. Unlike
+ * plcrash_report_decoder_unpack(), the allocator is managed entirely by the caller, allowing several sections to
+ * be unpacked into a single arena. Returns NULL if the field is not present, or on error.
+ */
+ProtobufCMessage *plcrash_report_decoder_unpack_allocator (const plcrash_report_decoder_t *decoder, plcrash_report_field_number_t number,
+                                                           size_t index, ProtobufCAllocator *allocator)
+{
+    if (index >= plcrash_report_decoder_count(decoder, number))
+        return NULL;
+
+    const plcrash_report_field_t *field = field_at(decoder, number, index);
+    return plcrash_report_unpack_message(field_descriptors[number], allocator, field->length, decoder->message + field->offset);
+}
+
+/**
+ * Unpack the last occurrence of singular top-level field @a number into @a arena, which is initialized by this
+ * function. As with protobuf_c_message_unpack(), the last occurrence of a singular field takes precedence.
+ * Returns NULL if the field is not present, or on error.
+ *
+ * @warning MEMORY WARNING. The caller is responsible for releasing the arena, and with it the returned message,
+ * via protobuf_c_arena_destroy(). This must be done even if NULL is returned.
+ */
+ProtobufCMessage *plcrash_report_decoder_unpack_last (const plcrash_report_decoder_t *decoder, plcrash_report_field_number_t number,
+                                                      ProtobufCArena *arena)
+{
+    size_t count = plcrash_report_decoder_count(decoder, number);
+    return plcrash_report_decoder_unpack(decoder, number, (count > 0) ? count - 1 : 0, arena);
+}
+
+/**
+ * Unpack the report's system information. Returns NULL if unavailable.
+ *
+ * @warning The caller must release @a arena via protobuf_c_arena_destroy(), even if NULL is returned.
+ */
+Plcrash__CrashReport__SystemInfo *plcrash_report_decoder_system_info (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena) {
+    return (Plcrash__CrashReport__SystemInfo *) plcrash_report_decoder_unpack_last(decoder, PLCRASH_REPORT_FIELD_SYSTEM_INFO, arena);
+}
+
+/**
+ * Unpack the report's machine information. Returns NULL if unavailable.
+ *
+ * @warning The caller must release @a arena via protobuf_c_arena_destroy(), even if NULL is returned.
+ */
+Plcrash__CrashReport__MachineInfo *plcrash_report_decoder_machine_info (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena) {
+    return (Plcrash__CrashReport__MachineInfo *) plcrash_report_decoder_unpack_last(decoder, PLCRASH_REPORT_FIELD_MACHINE_INFO, arena);
+}
+
+/**
+ * Unpack the report's application information. Returns NULL if unavailable.
+ *
+ * @warning The caller must release @a arena via protobuf_c_arena_destroy(), even if NULL is returned.
+ */
+Plcrash__CrashReport__ApplicationInfo *plcrash_report_decoder_app_info (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena) {
+    return (Plcrash__CrashReport__ApplicationInfo *) plcrash_report_decoder_unpack_last(decoder, PLCRASH_REPORT_FIELD_APP_INFO, arena);
+}
+
+/**
+ * Unpack the report's process information. Returns NULL if unavailable.
+ *
+ * @warning The caller must release @a arena via protobuf_c_arena_destroy(), even if NULL is returned.
+ */
+Plcrash__CrashReport__ProcessInfo *plcrash_report_decoder_process_info (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena) {
+    return (Plcrash__CrashReport__ProcessInfo *) plcrash_report_decoder_unpack_last(decoder, PLCRASH_REPORT_FIELD_PROCESS_INFO, arena);
+}
+
+/**
+ * Unpack the report's signal information. Returns NULL if unavailable.
+ *
+ * @warning The caller must release @a arena via protobuf_c_arena_destroy(), even if NULL is returned.
+ */
+Plcrash__CrashReport__Signal *plcrash_report_decoder_signal (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena) {
+    return (Plcrash__CrashReport__Signal *) plcrash_report_decoder_unpack_last(decoder, PLCRASH_REPORT_FIELD_SIGNAL, arena);
+}
+
+/**
+ * Unpack the report's exception information. Returns NULL if unavailable.
+ *
+ * @warning The caller must release @a arena via protobuf_c_arena_destroy(), even if NULL is returned.
+ */
+Plcrash__CrashReport__Exception *plcrash_report_decoder_exception (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena) {
+    return (Plcrash__CrashReport__Exception *) plcrash_report_decoder_unpack_last(decoder, PLCRASH_REPORT_FIELD_EXCEPTION, arena);
+}
+
+/**
+ * Unpack the report's crash handler diagnostics. Returns NULL if unavailable.
+ *
+ * @warning The caller must release @a arena via protobuf_c_arena_destroy(), even if NULL is returned.
+ */
+Plcrash__CrashReport__HandlerInfo *plcrash_report_decoder_handler_info (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena) {
+    return (Plcrash__CrashReport__HandlerInfo *) plcrash_report_decoder_unpack_last(decoder, PLCRASH_REPORT_FIELD_HANDLER_INFO, arena);
+}
+
+/**
+ * Unpack the report's @a index thread. Returns NULL if unavailable.
+ *
+ * @warning The caller must release @a arena via protobuf_c_arena_destroy(), even if NULL is returned.
+ */
+Plcrash__CrashReport__Thread *plcrash_report_decoder_thread (const plcrash_report_decoder_t *decoder, size_t index, ProtobufCArena *arena) {
+    return (Plcrash__CrashReport__Thread *) plcrash_report_decoder_unpack(decoder, PLCRASH_REPORT_FIELD_THREADS, index, arena);
+}
+
+/**
+ * Unpack the report's crashed thread, decoding threads until it is found. The thread named by the summary header,
+ * if any, is tried first. Returns NULL if no thread is marked as crashed.
+ *
+ * @param decoder The decoder.
+ * @param arena The arena to unpack into, initialized by this function.
+ * @param index On success, if non-NULL, the index of the crashed thread.
+ *
+ * @warning The caller must release @a arena via protobuf_c_arena_destroy(), even if NULL is returned.
+ */
+Plcrash__CrashReport__Thread *plcrash_report_decoder_crashed_thread (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena, size_t *index) {
+    size_t count = plcrash_report_decoder_count(decoder, PLCRASH_REPORT_FIELD_THREADS);
+    size_t hint = count;
+
+    if (decoder->has_summary && decoder->summary.crashed_thread != PLCRASH_REPORT_SUMMARY_NO_THREAD &&
+        decoder->summary.crashed_thread < count)
+    {
+        hint = decoder->summary.crashed_thread;
+    }
+
+    /* Try the hinted thread first, then the remainder in order */
+    for (size_t i = 0; i <= count; i++) {
+        size_t thr_idx;
+        if (i == 0)
+            thr_idx = hint;
+        else
+            thr_idx = i - 1;
+
+        if (thr_idx >= count || (i > 0 && thr_idx == hint))
+            continue;
+
+        Plcrash__CrashReport__Thread *thread = plcrash_report_decoder_thread(decoder, thr_idx, arena);
+        if (thread != NULL && thread->crashed) {
+            if (index != NULL)
+                *index = thr_idx;
+            return thread;
+        }
+
+        protobuf_c_arena_destroy(arena);
+    }
+
+    protobuf_c_arena_init(arena, 0);
+    return NULL;
+}
+
+/**
+ * Unpack the report's @a index binary image. Returns NULL if unavailable.
+ *
+ * @warning The caller must release @a arena via protobuf_c_arena_destroy(), even if NULL is returned.
+ */
+Plcrash__CrashReport__BinaryImage *plcrash_report_decoder_image (const plcrash_report_decoder_t *decoder, size_t index, ProtobufCArena *arena) {
+    return (Plcrash__CrashReport__BinaryImage *) plcrash_report_decoder_unpack(decoder, PLCRASH_REPORT_FIELD_BINARY_IMAGES, index, arena);
+}
+
+/**
+ * Find the binary image containing each of @a thread's first @a frame_count frames. Each frame is attributed to
+ * the first image, in report order, whose [base_address, base_address + size) range contains the frame's PC.
+ * Images are unpacked only until every frame has been attributed.
+ *
+ * @param decoder The decoder.
+ * @param thread The thread.
+ * @param frame_count The number of frames to attribute. Must not exceed the thread's frame count.
+ * @param allocator The allocator with which the containing images will be unpacked; an arena allocator is
+ * recommended.
+ * @param images On return, the containing image of each frame, or NULL if the frame is not within any image.
+ * If @a allocator is not an arena allocator, the caller is responsible for releasing each distinct image via
+ * protobuf_c_message_free_unpacked().
+ */
+void plcrash_report_decoder_frame_images (const plcrash_report_decoder_t *decoder, const Plcrash__CrashReport__Thread *thread,
+                                          size_t frame_count, ProtobufCAllocator *allocator, Plcrash__CrashReport__BinaryImage **images)
+{
+    size_t image_count = plcrash_report_decoder_count(decoder, PLCRASH_REPORT_FIELD_BINARY_IMAGES);
+    size_t remaining = frame_count;
+
+    for (size_t f = 0; f < frame_count; f++)
+        images[f] = NULL;
+
+    for (size_t i = 0; i < image_count && remaining > 0; i++) {
+        Plcrash__CrashReport__BinaryImage *image = (Plcrash__CrashReport__BinaryImage *)
+            plcrash_report_decoder_unpack_allocator(decoder, PLCRASH_REPORT_FIELD_BINARY_IMAGES, i, allocator);
+        if (image == NULL)
+            continue;
+
+        bool used = false;
+        for (size_t f = 0; f < frame_count; f++) {
+            uint64_t pc = thread->frames[f]->pc;
+            if (images[f] != NULL || pc < image->base_address || pc - image->base_address >= image->size)
+                continue;
+
+            images[f] = image;
+            used = true;
+            remaining--;
+        }
+
+        /* Release images that contain none of the frames */
+        if (!used)
+            protobuf_c_message_free_unpacked((ProtobufCMessage *) image, allocator);
+    }
+}
+
+/**
+ * Unpack the report's @a index secondary crash. Returns NULL if unavailable.
+ *
+ * @warning The caller must release @a arena via protobuf_c_arena_destroy(), even if NULL is returned.
+ */
+Plcrash__CrashReport__SecondaryCrash *plcrash_report_decoder_secondary_crash (const plcrash_report_decoder_t *decoder, size_t index, ProtobufCArena *arena) {
+    return (Plcrash__CrashReport__SecondaryCrash *) plcrash_report_decoder_unpack(decoder, PLCRASH_REPORT_FIELD_SECONDARY_CRASHES, index, arena);
+}
+
+/**
+ * @} plcrash_report_decoder
+ */
@@ -0,0 +1,199 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#import "PLCrashAsync.h"
+#import "PLCrashReportSummary.h"
+
+#include "crash_report.pb-c.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_report_decoder
+ *
+ * Top-level CrashReport field numbers. These must match crash_report.proto.
+ */
+typedef enum {
+    /** CrashReport.system_info */
+    PLCRASH_REPORT_FIELD_SYSTEM_INFO = 1,
+
+    /** CrashReport.application_info */
+    PLCRASH_REPORT_FIELD_APP_INFO = 2,
+
+    /** CrashReport.threads */
+    PLCRASH_REPORT_FIELD_THREADS = 3,
+
+    /** CrashReport.binary_images */
+    PLCRASH_REPORT_FIELD_BINARY_IMAGES = 4,
+
+    /** CrashReport.exception */
+    PLCRASH_REPORT_FIELD_EXCEPTION = 5,
+
+    /** CrashReport.signal */
+    PLCRASH_REPORT_FIELD_SIGNAL = 6,
+
+    /** CrashReport.process_info */
+    PLCRASH_REPORT_FIELD_PROCESS_INFO = 7,
+
+    /** CrashReport.machine_info */
+    PLCRASH_REPORT_FIELD_MACHINE_INFO = 8,
+
+    /** CrashReport.handler_info */
+    PLCRASH_REPORT_FIELD_HANDLER_INFO = 9,
+
+    /** CrashReport.secondary_crashes */
+    PLCRASH_REPORT_FIELD_SECONDARY_CRASHES = 10,
+
+    /** The highest known field number */
+    PLCRASH_REPORT_FIELD_MAX = PLCRASH_REPORT_FIELD_SECONDARY_CRASHES
+} plcrash_report_field_number_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_decoder
+ *
+ * Reasons a report may be rejected by plcrash_report_decoder_init().
+ */
+typedef enum {
+    /** No error */
+    PLCRASH_REPORT_DECODE_OK = 0,
+
+    /** The file is too short to contain a report */
+    PLCRASH_REPORT_DECODE_TRUNCATED,
+
+    /** The file magic or summary header is invalid */
+    PLCRASH_REPORT_DECODE_BAD_HEADER,
+
+    /** The file version is not supported */
+    PLCRASH_REPORT_DECODE_BAD_VERSION,
+
+    /** The report message is malformed */
+    PLCRASH_REPORT_DECODE_MALFORMED,
+
+    /** A required top-level section is missing. The section's field number is provided by error_field. */
+    PLCRASH_REPORT_DECODE_MISSING_SECTION,
+
+    /** The decoder state could not be allocated */
+    PLCRASH_REPORT_DECODE_NOMEM
+} plcrash_report_decode_error_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_decoder
+ *
+ * The location of an encoded top-level field value.
+ */
+typedef struct plcrash_report_field {
+    /** Field number */
+    uint32_t number;
+
+    /** Offset of the field's value, relative to the start of the encoded message */
+    size_t offset;
+
+    /** Length of the field's value */
+    size_t length;
+} plcrash_report_field_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_decoder
+ *
+ * Crash report decoder state. All fields are read-only once initialized.
+ */
+typedef struct plcrash_report_decoder {
+    /** The encoded crash report message. The report data must remain valid for the lifetime of the decoder. */
+    const uint8_t *message;
+
+    /** Length of message, in bytes */
+    size_t message_len;
+
+    /** The report file version */
+    uint8_t version;
+
+    /** Known top-level message fields, in encoded order */
+    plcrash_report_field_t *fields;
+
+    /** Number of entries in fields */
+    size_t field_count;
+
+    /** Number of occurrences of each known field, indexed by field number */
+    size_t occurrences[PLCRASH_REPORT_FIELD_MAX + 1];
+
+    /** Indices into fields, grouped by field number and in encoded order within each group */
+    size_t *field_index;
+
+    /** Start of each field number's group within field_index, indexed by field number */
+    size_t field_index_start[PLCRASH_REPORT_FIELD_MAX + 1];
+
+    /** If true, summary has been populated from the file's summary header */
+    bool has_summary;
+
+    /** The report summary. Only valid if has_summary is true. */
+    plcrash_report_summary_t summary;
+
+    /** If initialization failed, the reason */
+    plcrash_report_decode_error_t error;
+
+    /** If error is PLCRASH_REPORT_DECODE_MISSING_SECTION, the missing field number */
+    uint32_t error_field;
+} plcrash_report_decoder_t;
+
+extern const plcrash_report_field_number_t plcrash_report_required_fields[];
+extern const size_t plcrash_report_required_field_count;
+
+plcrash_error_t plcrash_report_decoder_init (plcrash_report_decoder_t *decoder, const void *data, size_t len);
+void plcrash_report_decoder_free (plcrash_report_decoder_t *decoder);
+
+const char *plcrash_report_decode_error_description (plcrash_report_decode_error_t error);
+
+size_t plcrash_report_decoder_count (const plcrash_report_decoder_t *decoder, plcrash_report_field_number_t number);
+
+ProtobufCMessage *plcrash_report_decoder_unpack (const plcrash_report_decoder_t *decoder, plcrash_report_field_number_t number,
+                                                 size_t index, ProtobufCArena *arena);
+ProtobufCMessage *plcrash_report_decoder_unpack_allocator (const plcrash_report_decoder_t *decoder, plcrash_report_field_number_t number,
+                                                           size_t index, ProtobufCAllocator *allocator);
+ProtobufCMessage *plcrash_report_decoder_unpack_last (const plcrash_report_decoder_t *decoder, plcrash_report_field_number_t number,
+                                                      ProtobufCArena *arena);
+
+Plcrash__CrashReport__SystemInfo *plcrash_report_decoder_system_info (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena);
+Plcrash__CrashReport__MachineInfo *plcrash_report_decoder_machine_info (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena);
+Plcrash__CrashReport__ApplicationInfo *plcrash_report_decoder_app_info (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena);
+Plcrash__CrashReport__ProcessInfo *plcrash_report_decoder_process_info (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena);
+Plcrash__CrashReport__Signal *plcrash_report_decoder_signal (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena);
+Plcrash__CrashReport__Exception *plcrash_report_decoder_exception (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena);
+Plcrash__CrashReport__HandlerInfo *plcrash_report_decoder_handler_info (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena);
+
+Plcrash__CrashReport__Thread *plcrash_report_decoder_thread (const plcrash_report_decoder_t *decoder, size_t index, ProtobufCArena *arena);
+Plcrash__CrashReport__Thread *plcrash_report_decoder_crashed_thread (const plcrash_report_decoder_t *decoder, ProtobufCArena *arena, size_t *index);
+Plcrash__CrashReport__BinaryImage *plcrash_report_decoder_image (const plcrash_report_decoder_t *decoder, size_t index, ProtobufCArena *arena);
+void plcrash_report_decoder_frame_images (const plcrash_report_decoder_t *decoder, const Plcrash__CrashReport__Thread *thread,
+                                          size_t frame_count, ProtobufCAllocator *allocator, Plcrash__CrashReport__BinaryImage **images);
+Plcrash__CrashReport__SecondaryCrash *plcrash_report_decoder_secondary_crash (const plcrash_report_decoder_t *decoder, size_t index, ProtobufCArena *arena);
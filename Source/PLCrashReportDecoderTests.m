@@ -0,0 +1,210 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+#import "PLCrashTestReportBuilder.h"
+#import "CrashReporter.h"
+#import "PLCrashReportDecoder.h"
+
+@interface PLCrashReportDecoderTests : SenTestCase @end
+
+/* Encode a thread message */
+static NSData *thread_message (uint32_t number, bool crashed) {
+    NSMutableData *msg = [NSMutableData data];
+    NSMutableData *frame = [NSMutableData data];
+
+    plcrash_test_append_uint(msg, 1, number);
+    plcrash_test_append_uint(frame, 3, 0x1000 + number);
+    plcrash_test_append_message(msg, 2, frame);
+    plcrash_test_append_uint(msg, 3, crashed);
+    return msg;
+}
+
+/*
+ * Encode a version 1 crash report containing all required sections, with four threads (the third of which
+ * crashed) and two images. If omit is non-zero, the given top-level field is left out.
+ */
+static NSData *test_report (uint32_t omit) {
+    NSMutableData *report = plcrash_test_report_header();
+    plcrash_test_append_report_info(report, "com.example.decoder", "SIGSEGV", omit);
+
+    /* Interleave threads and images, which the decoder must return in encoded order */
+    if (omit != PLCRASH_REPORT_FIELD_THREADS) {
+        plcrash_test_append_message(report, PLCRASH_REPORT_FIELD_THREADS, thread_message(0, false));
+        plcrash_test_append_message(report, PLCRASH_REPORT_FIELD_THREADS, thread_message(1, false));
+    }
+
+    if (omit != PLCRASH_REPORT_FIELD_BINARY_IMAGES) {
+        for (uint32_t i = 0; i < 2; i++) {
+            NSMutableData *msg = [NSMutableData data];
+            plcrash_test_append_uint(msg, 1, 0x1000 * (i + 1));
+            plcrash_test_append_uint(msg, 2, 0x800);
+            plcrash_test_append_string(msg, 3, i == 0 ? "/usr/lib/dyld" : "/usr/lib/libSystem.B.dylib");
+            plcrash_test_append_message(report, PLCRASH_REPORT_FIELD_BINARY_IMAGES, msg);
+        }
+    }
+
+    if (omit != PLCRASH_REPORT_FIELD_THREADS) {
+        plcrash_test_append_message(report, PLCRASH_REPORT_FIELD_THREADS, thread_message(2, true));
+        plcrash_test_append_message(report, PLCRASH_REPORT_FIELD_THREADS, thread_message(3, false));
+    }
+
+    /* An unknown field, which must be skipped */
+    plcrash_test_append_uint(report, 100, 42);
+
+    return report;
+}
+
+@implementation PLCrashReportDecoderTests
+
+- (void) testDecode {
+    NSData *data = test_report(0);
+    plcrash_report_decoder_t decoder;
+    ProtobufCArena arena;
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_decoder_init(&decoder, [data bytes], [data length]), @"Failed to initialize decoder");
+    STAssertEquals((uint8_t) 1, decoder.version, @"Incorrect version");
+    STAssertFalse(decoder.has_summary, @"Version 1 reports have no summary");
+
+    /* Section counts */
+    STAssertEquals((size_t) 4, plcrash_report_decoder_count(&decoder, PLCRASH_REPORT_FIELD_THREADS), @"Incorrect thread count");
+    STAssertEquals((size_t) 2, plcrash_report_decoder_count(&decoder, PLCRASH_REPORT_FIELD_BINARY_IMAGES), @"Incorrect image count");
+    STAssertEquals((size_t) 0, plcrash_report_decoder_count(&decoder, PLCRASH_REPORT_FIELD_EXCEPTION), @"Unexpected exception");
+
+    /* Singular sections */
+    Plcrash__CrashReport__SystemInfo *systemInfo = plcrash_report_decoder_system_info(&decoder, &arena);
+    STAssertNotNULL(systemInfo, @"Failed to decode system info");
+    STAssertEqualCStrings("4.2", systemInfo->os_version, @"Incorrect OS version");
+    protobuf_c_arena_destroy(&arena);
+
+    Plcrash__CrashReport__MachineInfo *machineInfo = plcrash_report_decoder_machine_info(&decoder, &arena);
+    STAssertNotNULL(machineInfo, @"Failed to decode machine info");
+    STAssertEquals((uint64_t) 12, machineInfo->processor->type, @"Incorrect processor type");
+    protobuf_c_arena_destroy(&arena);
+
+    Plcrash__CrashReport__Signal *signal = plcrash_report_decoder_signal(&decoder, &arena);
+    STAssertNotNULL(signal, @"Failed to decode signal info");
+    STAssertEqualCStrings("SIGSEGV", signal->name, @"Incorrect signal name");
+    protobuf_c_arena_destroy(&arena);
+
+    /* Absent sections */
+    STAssertNULL(plcrash_report_decoder_exception(&decoder, &arena), @"Unexpected exception");
+    protobuf_c_arena_destroy(&arena);
+
+    STAssertNULL(plcrash_report_decoder_thread(&decoder, 4, &arena), @"Unexpected thread");
+    protobuf_c_arena_destroy(&arena);
+
+    /* Repeated sections are returned in encoded order */
+    for (size_t i = 0; i < 4; i++) {
+        Plcrash__CrashReport__Thread *thread = plcrash_report_decoder_thread(&decoder, i, &arena);
+        STAssertNotNULL(thread, @"Failed to decode thread");
+        STAssertEquals((uint32_t) i, thread->thread_number, @"Threads returned out of order");
+        protobuf_c_arena_destroy(&arena);
+    }
+
+    Plcrash__CrashReport__BinaryImage *image = plcrash_report_decoder_image(&decoder, 1, &arena);
+    STAssertNotNULL(image, @"Failed to decode image");
+    STAssertEqualCStrings("/usr/lib/libSystem.B.dylib", image->name, @"Images returned out of order");
+    protobuf_c_arena_destroy(&arena);
+
+    /* Crashed thread */
+    size_t index = 0;
+    Plcrash__CrashReport__Thread *crashed = plcrash_report_decoder_crashed_thread(&decoder, &arena, &index);
+    STAssertNotNULL(crashed, @"Failed to find crashed thread");
+    STAssertEquals((size_t) 2, index, @"Incorrect crashed thread index");
+    protobuf_c_arena_destroy(&arena);
+
+    /* A stale summary hint must fall back to a scan */
+    decoder.has_summary = true;
+    decoder.summary.crashed_thread = 1;
+    crashed = plcrash_report_decoder_crashed_thread(&decoder, &arena, &index);
+    STAssertNotNULL(crashed, @"Failed to find crashed thread");
+    STAssertEquals((size_t) 2, index, @"Incorrect crashed thread index");
+    protobuf_c_arena_destroy(&arena);
+
+    plcrash_report_decoder_free(&decoder);
+}
+
+- (void) testMissingSections {
+    static const plcrash_report_field_number_t required[] = {
+        PLCRASH_REPORT_FIELD_SYSTEM_INFO,
+        PLCRASH_REPORT_FIELD_MACHINE_INFO,
+        PLCRASH_REPORT_FIELD_APP_INFO,
+        PLCRASH_REPORT_FIELD_SIGNAL,
+        PLCRASH_REPORT_FIELD_THREADS,
+        PLCRASH_REPORT_FIELD_BINARY_IMAGES
+    };
+    plcrash_report_decoder_t decoder;
+
+    for (size_t i = 0; i < sizeof(required) / sizeof(required[0]); i++) {
+        NSData *data = test_report(required[i]);
+        STAssertEquals(PLCRASH_EINVAL, plcrash_report_decoder_init(&decoder, [data bytes], [data length]), @"Accepted incomplete report");
+        STAssertEquals(PLCRASH_REPORT_DECODE_MISSING_SECTION, decoder.error, @"Incorrect error");
+        STAssertEquals((uint32_t) required[i], decoder.error_field, @"Incorrect missing section");
+        plcrash_report_decoder_free(&decoder);
+    }
+
+    /* The optional sections may be omitted */
+    NSData *data = test_report(PLCRASH_REPORT_FIELD_PROCESS_INFO);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_decoder_init(&decoder, [data bytes], [data length]), @"Rejected valid report");
+    plcrash_report_decoder_free(&decoder);
+}
+
+- (void) testInvalid {
+    plcrash_report_decoder_t decoder;
+
+    /* Truncated */
+    NSData *data = plcrash_test_report_header();
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_decoder_init(&decoder, [data bytes], [data length]), @"Accepted truncated report");
+    STAssertEquals(PLCRASH_REPORT_DECODE_TRUNCATED, decoder.error, @"Incorrect error");
+    plcrash_report_decoder_free(&decoder);
+
+    /* Bad magic */
+    NSMutableData *report = [[test_report(0) mutableCopy] autorelease];
+    ((uint8_t *) [report mutableBytes])[0] = 'x';
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_decoder_init(&decoder, [report bytes], [report length]), @"Accepted bad magic");
+    STAssertEquals(PLCRASH_REPORT_DECODE_BAD_HEADER, decoder.error, @"Incorrect error");
+    plcrash_report_decoder_free(&decoder);
+
+    /* Unsupported version */
+    report = [[test_report(0) mutableCopy] autorelease];
+    ((uint8_t *) [report mutableBytes])[7] = 42;
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_decoder_init(&decoder, [report bytes], [report length]), @"Accepted bad version");
+    STAssertEquals(PLCRASH_REPORT_DECODE_BAD_VERSION, decoder.error, @"Incorrect error");
+    STAssertEquals((uint8_t) 42, decoder.version, @"Incorrect version");
+    plcrash_report_decoder_free(&decoder);
+
+    /* Section length overruns the report */
+    report = [[test_report(0) mutableCopy] autorelease];
+    [report setLength: [report length] - 4];
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_decoder_init(&decoder, [report bytes], [report length]), @"Accepted truncated section");
+    STAssertEquals(PLCRASH_REPORT_DECODE_MALFORMED, decoder.error, @"Incorrect error");
+    plcrash_report_decoder_free(&decoder);
+}
+
+@end
@@ -0,0 +1,58 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashReportHandlerInfo.h"
+
+/**
+ * Crash handler diagnostics.
+ *
+ * Provides the crash handler's measured stack usage, which may be used to size the crash handler's signal
+ * stacks.
+ */
+@implementation PLCrashReportHandlerInfo
+
+@synthesize stackSize = _stackSize;
+@synthesize stackUsed = _stackUsed;
+
+/**
+ * Initialize a new handler info data object.
+ *
+ * @param stackSize The size of the stack on which the crash report was written, in bytes.
+ * @param stackUsed The maximum number of bytes of that stack used while handling the crash.
+ */
+- (id) initWithStackSize: (uint64_t) stackSize stackUsed: (uint64_t) stackUsed {
+    if ((self = [super init]) == nil)
+        return nil;
+
+    _stackSize = stackSize;
+    _stackUsed = stackUsed;
+
+    return self;
+}
+
+@end
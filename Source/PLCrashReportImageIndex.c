@@ -0,0 +1,241 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashReportImageIndex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_report_image_index Crash Report Image Index
+ * @ingroup plcrash_internal
+ *
+ * Address to binary image lookup.
+ *
+ * Symbolicating a report requires finding the image containing each stack frame's PC. The image index sorts the
+ * image base addresses once, and stores them in Eytzinger (breadth-first binary tree) order: the first levels of
+ * every search share the same few cache lines, and each step's next candidates are adjacent in memory. A lookup
+ * is a branch-free descent of the tree, followed by a single range check.
+ *
+ * Lookups return the same image as a linear scan of the ranges in their original order, including when ranges
+ * overlap.
+ *
+ * @{
+ */
+
+/**
+ * @internal
+ * An image range, in address order.
+ */
+typedef struct index_entry {
+    /** Image base address */
+    uint64_t base;
+
+    /** Image end address (exclusive) */
+    uint64_t end;
+
+    /** Caller's image index */
+    uint32_t image;
+} index_entry_t;
+
+/**
+ * @internal
+ * Order entries by base address, then by the caller's image order.
+ */
+static int index_entry_compare (const void *a, const void *b) {
+    const index_entry_t *lhs = a;
+    const index_entry_t *rhs = b;
+
+    if (lhs->base != rhs->base)
+        return (lhs->base < rhs->base) ? -1 : 1;
+
+    if (lhs->image != rhs->image)
+        return (lhs->image < rhs->image) ? -1 : 1;
+
+    return 0;
+}
+
+/**
+ * @internal
+ * Populate the Eytzinger-ordered keys of the subtree rooted at @a k by an in-order traversal of @a sorted,
+ * starting at @a i. Returns the next unused index of @a sorted.
+ */
+static size_t index_fill (plcrash_report_image_index_t *index, const index_entry_t *sorted, size_t i, size_t k) {
+    if (k > index->count)
+        return i;
+
+    i = index_fill(index, sorted, i, 2 * k);
+    index->keys[k] = sorted[i].base;
+    index->ranks[k] = (uint32_t) i;
+    i++;
+
+    return index_fill(index, sorted, i, 2 * k + 1);
+}
+
+/**
+ * Initialize an image index over @a count image @a ranges. The ranges are copied, and need not remain valid.
+ *
+ * @param index The index to initialize.
+ * @param ranges The image ranges.
+ * @param count The number of ranges.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if @a count is too large to index, or
+ * PLCRASH_ENOMEM if the index could not be allocated. On success, the index must be freed with
+ * plcrash_report_image_index_free().
+ */
+plcrash_error_t plcrash_report_image_index_init (plcrash_report_image_index_t *index, const plcrash_report_image_range_t *ranges, size_t count) {
+    index_entry_t *sorted;
+    size_t n = 0;
+
+    memset(index, 0, sizeof(*index));
+
+    if (count >= UINT32_MAX)
+        return PLCRASH_EINVAL;
+
+    /* Sort the non-empty ranges */
+    sorted = malloc((count > 0 ? count : 1) * sizeof(index_entry_t));
+    if (sorted == NULL)
+        return PLCRASH_ENOMEM;
+
+    for (size_t i = 0; i < count; i++) {
+        if (ranges[i].size == 0)
+            continue;
+
+        sorted[n].base = ranges[i].base_address;
+        sorted[n].image = (uint32_t) i;
+
+        /* Clamp ranges that wrap the address space */
+        if (ranges[i].size > UINT64_MAX - ranges[i].base_address) {
+            sorted[n].end = UINT64_MAX;
+        } else {
+            sorted[n].end = ranges[i].base_address + ranges[i].size;
+        }
+
+        n++;
+    }
+
+    qsort(sorted, n, sizeof(index_entry_t), index_entry_compare);
+
+    /* Allocate the keys, ends, ranks and images in a single block; the 64-bit arrays are placed first to preserve
+     * their alignment. */
+    size_t keys_size = (n + 1) * sizeof(uint64_t);
+    size_t ends_size = n * sizeof(uint64_t);
+    size_t ranks_size = (n + 1) * sizeof(uint32_t);
+    uint8_t *block = malloc(keys_size + ends_size + ranks_size + n * sizeof(uint32_t));
+    if (block == NULL) {
+        free(sorted);
+        return PLCRASH_ENOMEM;
+    }
+
+    index->keys = (uint64_t *) block;
+    index->ends = (uint64_t *) (block + keys_size);
+    index->ranks = (uint32_t *) (block + keys_size + ends_size);
+    index->images = (uint32_t *) (block + keys_size + ends_size + ranks_size);
+    index->count = n;
+
+    index->keys[0] = 0;
+    index->ranks[0] = 0;
+    index_fill(index, sorted, 0, 1);
+
+    for (size_t i = 0; i < n; i++) {
+        index->ends[i] = sorted[i].end;
+        index->images[i] = sorted[i].image;
+
+        if (i > 0 && sorted[i].base < sorted[i - 1].end)
+            index->overlapping = true;
+    }
+
+    free(sorted);
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Find the image containing @a address. If more than one image contains @a address, the image that appeared
+ * first in the ranges supplied to plcrash_report_image_index_init() is returned.
+ *
+ * @param index The image index.
+ * @param address The address to search for.
+ * @param image On success, the index of the containing image within the ranges supplied to
+ * plcrash_report_image_index_init().
+ *
+ * @return Returns true if an image containing @a address was found, or false otherwise.
+ */
+bool plcrash_report_image_index_lookup (const plcrash_report_image_index_t *index, uint64_t address, size_t *image) {
+    const uint64_t *keys = index->keys;
+    size_t n = index->count;
+    size_t k = 1;
+
+    /* Descend to the first base address greater than the address. The path taken is recorded in the bits of k;
+     * the last left turn is found by discarding the trailing right turns (one bits), and the left turn itself. */
+    while (k <= n)
+        k = 2 * k + (keys[k] <= address);
+    k >>= __builtin_ffsl(~k);
+
+    /* The candidate is the last image with a base address at or below the address */
+    size_t upper = (k == 0) ? n : index->ranks[k];
+    if (upper == 0)
+        return false;
+
+    size_t candidate = upper - 1;
+    if (!index->overlapping) {
+        if (address >= index->ends[candidate])
+            return false;
+
+        *image = index->images[candidate];
+        return true;
+    }
+
+    /* Any image below the candidate may also contain the address; prefer the earliest supplied image */
+    bool found = false;
+    for (size_t i = 0; i <= candidate; i++) {
+        if (address < index->ends[i] && (!found || index->images[i] < *image)) {
+            *image = index->images[i];
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Free all resources associated with @a index.
+ *
+ * @param index The index to free.
+ */
+void plcrash_report_image_index_free (plcrash_report_image_index_t *index) {
+    /* The index arrays share a single allocation */
+    if (index->keys != NULL)
+        free(index->keys);
+
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * @} plcrash_report_image_index
+ */
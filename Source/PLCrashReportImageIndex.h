@@ -0,0 +1,77 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#import "PLCrashAsync.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_report_image_index
+ *
+ * The address range of a single binary image.
+ */
+typedef struct plcrash_report_image_range {
+    /** Image base address */
+    uint64_t base_address;
+
+    /** Image size, in bytes */
+    uint64_t size;
+} plcrash_report_image_range_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_image_index
+ *
+ * An address-sorted index of binary image ranges.
+ */
+typedef struct plcrash_report_image_index {
+    /** Image base addresses in Eytzinger (breadth-first) order. Slot 0 is unused. */
+    uint64_t *keys;
+
+    /** Image end addresses (exclusive), in address order */
+    uint64_t *ends;
+
+    /** Address order position of each entry in keys */
+    uint32_t *ranks;
+
+    /** Caller's image index for each entry, in address order */
+    uint32_t *images;
+
+    /** Number of indexed images. Images with a size of zero are not indexed. */
+    size_t count;
+
+    /** If true, at least two image ranges overlap, and lookups must consider every candidate image. */
+    bool overlapping;
+} plcrash_report_image_index_t;
+
+plcrash_error_t plcrash_report_image_index_init (plcrash_report_image_index_t *index, const plcrash_report_image_range_t *ranges, size_t count);
+bool plcrash_report_image_index_lookup (const plcrash_report_image_index_t *index, uint64_t address, size_t *image);
+void plcrash_report_image_index_free (plcrash_report_image_index_t *index);
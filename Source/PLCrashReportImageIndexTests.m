@@ -0,0 +1,252 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+#import "PLCrashTestReportBuilder.h"
+#import "CrashReporter.h"
+#import "PLCrashReportImageIndex.h"
+
+#import <mach/mach_time.h>
+
+@interface PLCrashReportImageIndexTests : SenTestCase @end
+
+/* Synthetic report dimensions */
+#define TEST_IMAGE_COUNT 500
+#define TEST_THREAD_COUNT 300
+#define TEST_FRAME_COUNT 100
+
+/* Return the index of the first range containing address, as -[PLCrashReport imageForAddress:] did prior to
+ * the image index. */
+static bool linear_lookup (const plcrash_report_image_range_t *ranges, size_t count, uint64_t address, size_t *image) {
+    for (size_t i = 0; i < count; i++) {
+        if (ranges[i].base_address <= address && address - ranges[i].base_address < ranges[i].size) {
+            *image = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Encode a version 1 crash report with TEST_IMAGE_COUNT shuffled, non-contiguous images, and TEST_THREAD_COUNT threads
+ * of TEST_FRAME_COUNT frames. Most PCs fall within an image; the remainder fall between images.
+ */
+static NSData *synthetic_report (void) {
+    NSMutableData *report = plcrash_test_report_header();
+    plcrash_test_append_report_info(report, "com.example.synthetic", "SIGSEGV", 0);
+
+    /* Images, allocated in address order and then shuffled */
+    uint64_t bases[TEST_IMAGE_COUNT];
+    uint64_t sizes[TEST_IMAGE_COUNT];
+    uint64_t address = 0x1000;
+    for (int i = 0; i < TEST_IMAGE_COUNT; i++) {
+        bases[i] = address;
+        sizes[i] = 0x1000 + (random() % 0x40000);
+        address += sizes[i] + 0x1000;
+    }
+
+    for (int i = TEST_IMAGE_COUNT - 1; i > 0; i--) {
+        int j = random() % (i + 1);
+        uint64_t base = bases[i], size = sizes[i];
+        bases[i] = bases[j]; sizes[i] = sizes[j];
+        bases[j] = base; sizes[j] = size;
+    }
+
+    /* Threads */
+    for (int t = 0; t < TEST_THREAD_COUNT; t++) {
+        NSMutableData *thread = [NSMutableData data];
+        plcrash_test_append_uint(thread, 1, t);
+        for (int f = 0; f < TEST_FRAME_COUNT; f++) {
+            int image = random() % TEST_IMAGE_COUNT;
+            uint64_t pc = bases[image] + (random() % (sizes[image] + 0x800));
+
+            NSMutableData *frame = [NSMutableData data];
+            plcrash_test_append_uint(frame, 3, pc);
+            plcrash_test_append_message(thread, 2, frame);
+        }
+        plcrash_test_append_uint(thread, 3, t == 0);
+        plcrash_test_append_message(report, 3, thread);
+    }
+
+    for (int i = 0; i < TEST_IMAGE_COUNT; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "/usr/lib/libsynthetic%d.dylib", i);
+
+        NSMutableData *image = [NSMutableData data];
+        plcrash_test_append_uint(image, 1, bases[i]);
+        plcrash_test_append_uint(image, 2, sizes[i]);
+        plcrash_test_append_string(image, 3, name);
+        plcrash_test_append_message(report, 4, image);
+    }
+
+    return report;
+}
+
+@implementation PLCrashReportImageIndexTests
+
+/* Verify that lookups match a linear scan for random, possibly overlapping, ranges */
+- (void) testLookup {
+    plcrash_report_image_range_t ranges[64];
+    plcrash_report_image_index_t index;
+
+    srandom(1);
+    for (int iteration = 0; iteration < 500; iteration++) {
+        size_t count = random() % 64;
+        bool disjoint = (iteration % 2) == 0;
+        uint64_t next = 0x1000;
+
+        for (size_t i = 0; i < count; i++) {
+            if (disjoint) {
+                next += random() % 64;
+                ranges[i].base_address = next;
+                ranges[i].size = random() % 64;
+                next += ranges[i].size;
+            } else {
+                ranges[i].base_address = 0x1000 + random() % 512;
+                ranges[i].size = random() % 64;
+            }
+        }
+
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_image_index_init(&index, ranges, count), @"Could not build index");
+        for (uint64_t address = 0xFF0; address < 0x1000 + 64 * 128 + 16; address++) {
+            size_t expected = 0, actual = 0;
+            bool found = linear_lookup(ranges, count, address, &expected);
+
+            STAssertEquals(found, plcrash_report_image_index_lookup(&index, address, &actual), @"Incorrect result for 0x%llx", address);
+            if (found)
+                STAssertEquals(expected, actual, @"Incorrect image for 0x%llx", address);
+        }
+        plcrash_report_image_index_free(&index);
+    }
+}
+
+/* Verify edge cases: empty and zero-sized images, duplicate bases, and ranges at the end of the address space */
+- (void) testEdgeCases {
+    plcrash_report_image_index_t index;
+    size_t image;
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_image_index_init(&index, NULL, 0), @"Could not build empty index");
+    STAssertFalse(plcrash_report_image_index_lookup(&index, 0, &image), @"Found image in empty index");
+    plcrash_report_image_index_free(&index);
+
+    plcrash_report_image_range_t ranges[] = {
+        { 0x1000, 0 },
+        { 0x2000, 0x100 },
+        { 0x2000, 0x1000 },
+        { UINT64_MAX - 0xF, 0x100 }
+    };
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_image_index_init(&index, ranges, 4), @"Could not build index");
+
+    STAssertFalse(plcrash_report_image_index_lookup(&index, 0x1000, &image), @"Found zero-sized image");
+
+    STAssertTrue(plcrash_report_image_index_lookup(&index, 0x2000, &image), @"Image not found");
+    STAssertEquals((size_t) 1, image, @"Earliest image was not returned");
+
+    STAssertTrue(plcrash_report_image_index_lookup(&index, 0x2100, &image), @"Image not found");
+    STAssertEquals((size_t) 2, image, @"Incorrect image");
+
+    STAssertTrue(plcrash_report_image_index_lookup(&index, UINT64_MAX - 1, &image), @"Image not found");
+    STAssertEquals((size_t) 3, image, @"Incorrect image");
+
+    plcrash_report_image_index_free(&index);
+}
+
+/* Verify -[PLCrashReport imageForAddress:] against a linear scan of a large synthetic report, and compare the cost
+ * of formatting the report against the cost of linear image lookups. */
+- (void) testFormatterPerformance {
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+
+    srandom(2);
+    NSError *error = nil;
+    NSData *data = synthetic_report();
+    PLCrashReport *report = [[[PLCrashReport alloc] initWithData: data error: &error] autorelease];
+    STAssertNotNil(report, @"Could not decode synthetic report: %@", error);
+
+    NSArray *images = report.images;
+    STAssertEquals((NSUInteger) TEST_IMAGE_COUNT, [images count], @"Incorrect image count");
+
+    plcrash_report_image_range_t ranges[TEST_IMAGE_COUNT];
+    for (NSUInteger i = 0; i < TEST_IMAGE_COUNT; i++) {
+        PLCrashReportBinaryImageInfo *imageInfo = [images objectAtIndex: i];
+        ranges[i].base_address = imageInfo.imageBaseAddress;
+        ranges[i].size = imageInfo.imageSize;
+    }
+
+    /* Linear lookups */
+    uint64_t start = mach_absolute_time();
+    NSUInteger linear_found = 0;
+    for (PLCrashReportThreadInfo *thread in report.threads) {
+        for (PLCrashReportStackFrameInfo *frame in thread.stackFrames) {
+            size_t image;
+            if (linear_lookup(ranges, TEST_IMAGE_COUNT, frame.instructionPointer, &image))
+                linear_found++;
+        }
+    }
+    uint64_t linear_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    /* Indexed lookups */
+    start = mach_absolute_time();
+    NSUInteger indexed_found = 0;
+    for (PLCrashReportThreadInfo *thread in report.threads) {
+        for (PLCrashReportStackFrameInfo *frame in thread.stackFrames) {
+            PLCrashReportBinaryImageInfo *imageInfo = [report imageForAddress: frame.instructionPointer];
+            size_t image;
+
+            if (linear_lookup(ranges, TEST_IMAGE_COUNT, frame.instructionPointer, &image)) {
+                STAssertTrue(imageInfo == [images objectAtIndex: image], @"Incorrect image for 0x%llx", frame.instructionPointer);
+            } else {
+                STAssertNil(imageInfo, @"Unexpected image for 0x%llx", frame.instructionPointer);
+            }
+
+            if (imageInfo != nil)
+                indexed_found++;
+        }
+    }
+    STAssertEquals(linear_found, indexed_found, @"Lookup results differ");
+
+    start = mach_absolute_time();
+    for (PLCrashReportThreadInfo *thread in report.threads) {
+        for (PLCrashReportStackFrameInfo *frame in thread.stackFrames)
+            [report imageForAddress: frame.instructionPointer];
+    }
+    uint64_t indexed_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    /* Formatting */
+    start = mach_absolute_time();
+    NSString *text = [PLCrashReportTextFormatter stringValueForCrashReport: report withTextFormat: PLCrashReportTextFormatiOS];
+    uint64_t format_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+    STAssertNotNil(text, @"Could not format report");
+
+    NSLog(@"Image lookup for %d frames, %d images: linear=%llu us indexed=%llu us; formatted %lu bytes in %llu us",
+          TEST_THREAD_COUNT * TEST_FRAME_COUNT, TEST_IMAGE_COUNT, linear_ns / 1000, indexed_ns / 1000,
+          (unsigned long) [text length], format_ns / 1000);
+}
+
+@end
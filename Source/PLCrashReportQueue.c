@@ -0,0 +1,594 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PLCrashReportQueue.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libkern/OSAtomic.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_report_queue Crash Report Queue
+ * @ingroup plcrash_internal
+ *
+ * A bounded on-disk queue of pending crash reports.
+ *
+ * Reports are stored in a fixed set of slot files, and a compact index file records each slot's state, report
+ * identifier, timestamp and size. The index is mapped shared into the process; enumerating, loading and purging
+ * reports is performed via the index, without scanning the queue directory, and the cost of determining whether a
+ * report is pending is bounded by PLCRASH_REPORT_QUEUE_MAX_SLOTS.
+ *
+ * A slot is reserved, and a temporary report file opened, prior to any crash via plcrash_report_queue_reserve(). At
+ * crash time, plcrash_report_queue_begin() hands out the pre-opened descriptor, and plcrash_report_queue_commit()
+ * publishes the finished report by atomically renaming the temporary file to the slot's report path; both are
+ * async-safe. A report file at a slot path is therefore always complete, and reports that were interrupted while
+ * being written are discarded.
+ * Count and byte quotas are enforced when reserving a slot by discarding the oldest pending reports.
+ *
+ * @{
+ */
+
+/** @internal Index file magic. */
+#define PLCRASH_REPORT_QUEUE_MAGIC "plqi"
+
+/** @internal Index file version. */
+#define PLCRASH_REPORT_QUEUE_VERSION 1
+
+/** @internal Index file name. */
+#define PLCRASH_REPORT_QUEUE_INDEX_FILE "index"
+
+/** @internal Slot file name format. */
+#define PLCRASH_REPORT_QUEUE_SLOT_FORMAT "report_%02u.plcrash"
+
+/** @internal Slot temporary file name format. */
+#define PLCRASH_REPORT_QUEUE_TEMP_FORMAT "report_%02u.plcrash.tmp"
+
+/**
+ * @internal
+ * Format the path to @a slot's temporary report file.
+ */
+static plcrash_error_t temp_path (plcrash_report_queue_t *queue, uint32_t slot, char *buffer, size_t len) {
+    int ret = snprintf(buffer, len, "%s/" PLCRASH_REPORT_QUEUE_TEMP_FORMAT, queue->path, slot);
+    if (ret < 0 || (size_t) ret >= len)
+        return PLCRASH_EINVAL;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * @internal
+ * Release the reserved slot, if any, removing its unused temporary file.
+ */
+static void release_reservation (plcrash_report_queue_t *queue) {
+    if (queue->reserved_fd >= 0) {
+        close(queue->reserved_fd);
+        unlink(queue->reserved_temp_path);
+    }
+
+    queue->reserved_fd = -1;
+    queue->reserved_slot = -1;
+}
+
+/**
+ * @internal
+ * Reset the index, adopting any non-empty slot files that already exist as pending reports.
+ */
+static void index_reset (plcrash_report_queue_t *queue) {
+    plcrash_report_queue_index_t *index = queue->index;
+
+    memset(index, 0, sizeof(*index));
+    memcpy(index->magic, PLCRASH_REPORT_QUEUE_MAGIC, sizeof(index->magic));
+    index->version = PLCRASH_REPORT_QUEUE_VERSION;
+
+    for (uint32_t i = 0; i < PLCRASH_REPORT_QUEUE_MAX_SLOTS; i++) {
+        plcrash_report_queue_entry_t *entry = &index->entries[i];
+        char path[PATH_MAX];
+        struct stat sb;
+
+        if (plcrash_report_queue_slot_path(queue, i, path, sizeof(path)) != PLCRASH_ESUCCESS)
+            continue;
+
+        if (stat(path, &sb) != 0 || sb.st_size == 0)
+            continue;
+
+        entry->sequence = index->next_sequence++;
+        entry->timestamp = sb.st_mtime;
+        entry->size = sb.st_size;
+        entry->state = PLCRASH_REPORT_QUEUE_SLOT_PENDING;
+    }
+}
+
+/**
+ * @internal
+ * Return the number of pending reports, and their total size.
+ */
+static uint32_t pending_usage (plcrash_report_queue_t *queue, uint64_t *bytes) {
+    uint32_t count = 0;
+
+    *bytes = 0;
+    for (uint32_t i = 0; i < PLCRASH_REPORT_QUEUE_MAX_SLOTS; i++) {
+        plcrash_report_queue_entry_t *entry = &queue->index->entries[i];
+        if (entry->state != PLCRASH_REPORT_QUEUE_SLOT_PENDING)
+            continue;
+
+        count++;
+        *bytes += entry->size;
+    }
+
+    return count;
+}
+
+/**
+ * @internal
+ * Discard the oldest pending reports until a report of @a size bytes may be added without exceeding the
+ * queue's quotas.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or the error returned by plcrash_report_queue_remove() if a report
+ * could not be discarded.
+ */
+static plcrash_error_t make_room (plcrash_report_queue_t *queue, uint64_t size) {
+    plcrash_error_t err;
+    uint32_t oldest;
+    uint64_t bytes;
+    uint32_t count;
+
+    while ((count = pending_usage(queue, &bytes)) > 0) {
+        if (count < queue->max_count && bytes + size <= queue->max_bytes)
+            break;
+
+        /* A report that can not be removed remains pending; stop rather than retrying it indefinitely */
+        plcrash_report_queue_pending(queue, &oldest, 1);
+        if ((err = plcrash_report_queue_remove(queue, oldest)) != PLCRASH_ESUCCESS)
+            return err;
+    }
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * @internal
+ * Return a free slot, or -1 if none is available.
+ */
+static int32_t free_slot (plcrash_report_queue_t *queue) {
+    for (uint32_t i = 0; i < PLCRASH_REPORT_QUEUE_MAX_SLOTS; i++) {
+        if ((int32_t) i == queue->reserved_slot)
+            continue;
+
+        if (queue->index->entries[i].state == PLCRASH_REPORT_QUEUE_SLOT_FREE)
+            return i;
+    }
+
+    return -1;
+}
+
+/**
+ * Open (creating if necessary) the crash report queue at @a path.
+ *
+ * Reports that were interrupted while being written are discarded.
+ *
+ * @param queue The queue to initialize.
+ * @param path The queue directory. The directory must already exist.
+ * @param max_count The maximum number of pending reports. Must be greater than zero, and no greater than
+ * PLCRASH_REPORT_QUEUE_MAX_SLOTS.
+ * @param max_bytes The maximum total size of all pending reports, in bytes.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or an error on failure.
+ */
+plcrash_error_t plcrash_report_queue_open (plcrash_report_queue_t *queue, const char *path, uint32_t max_count, uint64_t max_bytes) {
+    char index_path[PATH_MAX];
+    struct stat sb;
+    bool valid;
+
+    memset(queue, 0, sizeof(*queue));
+    queue->index_fd = -1;
+    queue->reserved_slot = -1;
+    queue->reserved_fd = -1;
+    queue->max_count = max_count;
+    queue->max_bytes = max_bytes;
+
+    if (max_count == 0 || max_count > PLCRASH_REPORT_QUEUE_MAX_SLOTS)
+        return PLCRASH_EINVAL;
+
+    if ((queue->path = strdup(path)) == NULL)
+        return PLCRASH_ENOMEM;
+
+    /* Open and map the index */
+    if (snprintf(index_path, sizeof(index_path), "%s/%s", path, PLCRASH_REPORT_QUEUE_INDEX_FILE) >= (int) sizeof(index_path)) {
+        plcrash_report_queue_close(queue);
+        return PLCRASH_EINVAL;
+    }
+
+    if ((queue->index_fd = open(index_path, O_RDWR|O_CREAT, 0644)) < 0) {
+        PLCF_DEBUG("Could not open the crash report queue index: %s", strerror(errno));
+        plcrash_report_queue_close(queue);
+        return PLCRASH_OUTPUT_ERR;
+    }
+
+    if (fstat(queue->index_fd, &sb) != 0) {
+        plcrash_report_queue_close(queue);
+        return PLCRASH_OUTPUT_ERR;
+    }
+
+    valid = (sb.st_size == sizeof(plcrash_report_queue_index_t));
+    if (!valid && ftruncate(queue->index_fd, sizeof(plcrash_report_queue_index_t)) != 0) {
+        PLCF_DEBUG("Could not size the crash report queue index: %s", strerror(errno));
+        plcrash_report_queue_close(queue);
+        return PLCRASH_OUTPUT_ERR;
+    }
+
+    queue->index = mmap(NULL, sizeof(plcrash_report_queue_index_t), PROT_READ|PROT_WRITE, MAP_SHARED, queue->index_fd, 0);
+    if (queue->index == MAP_FAILED) {
+        PLCF_DEBUG("Could not map the crash report queue index: %s", strerror(errno));
+        queue->index = NULL;
+        plcrash_report_queue_close(queue);
+        return PLCRASH_ENOMEM;
+    }
+
+    /* Validate the index, rebuilding it if necessary */
+    if (!valid || memcmp(queue->index->magic, PLCRASH_REPORT_QUEUE_MAGIC, sizeof(queue->index->magic)) != 0 ||
+        queue->index->version != PLCRASH_REPORT_QUEUE_VERSION)
+    {
+        index_reset(queue);
+    }
+
+    /* Discard any reports that were interrupted while being written, and any unused temporary files */
+    for (uint32_t i = 0; i < PLCRASH_REPORT_QUEUE_MAX_SLOTS; i++) {
+        plcrash_report_queue_entry_t *entry = &queue->index->entries[i];
+        char tmp[PATH_MAX];
+
+        if (temp_path(queue, i, tmp, sizeof(tmp)) == PLCRASH_ESUCCESS)
+            unlink(tmp);
+
+        if (entry->state == PLCRASH_REPORT_QUEUE_SLOT_WRITING) {
+            entry->state = PLCRASH_REPORT_QUEUE_SLOT_FREE;
+            entry->size = 0;
+        }
+    }
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Update the queue's quotas. The new quotas will be applied by the next call to plcrash_report_queue_reserve() or
+ * plcrash_report_queue_add_file().
+ *
+ * @param queue The queue.
+ * @param max_count The maximum number of pending reports. Must be greater than zero, and no greater than
+ * PLCRASH_REPORT_QUEUE_MAX_SLOTS.
+ * @param max_bytes The maximum total size of all pending reports, in bytes.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or PLCRASH_EINVAL if @a max_count is invalid.
+ */
+plcrash_error_t plcrash_report_queue_set_quota (plcrash_report_queue_t *queue, uint32_t max_count, uint64_t max_bytes) {
+    if (max_count == 0 || max_count > PLCRASH_REPORT_QUEUE_MAX_SLOTS)
+        return PLCRASH_EINVAL;
+
+    queue->max_count = max_count;
+    queue->max_bytes = max_bytes;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Reserve a slot for the next crash report and open its temporary file, discarding the oldest pending reports as
+ * required to remain within the queue's quotas. Any previous reservation is released.
+ *
+ * @param queue The queue.
+ * @param report_size The maximum size of the crash report, in bytes.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or an error on failure.
+ */
+plcrash_error_t plcrash_report_queue_reserve (plcrash_report_queue_t *queue, uint64_t report_size) {
+    plcrash_error_t err;
+    int32_t slot;
+
+    /* Release any existing reservation */
+    release_reservation(queue);
+
+    /* Apply the quotas, and find a free slot */
+    if ((err = make_room(queue, report_size)) != PLCRASH_ESUCCESS)
+        return err;
+
+    if ((slot = free_slot(queue)) < 0)
+        return PLCRASH_EINTERNAL;
+
+    /* Format both paths now; the crash-time rename must not format strings. */
+    if (plcrash_report_queue_slot_path(queue, slot, queue->reserved_path, sizeof(queue->reserved_path)) != PLCRASH_ESUCCESS ||
+        temp_path(queue, slot, queue->reserved_temp_path, sizeof(queue->reserved_temp_path)) != PLCRASH_ESUCCESS)
+    {
+        return PLCRASH_EINVAL;
+    }
+
+    if ((queue->reserved_fd = open(queue->reserved_temp_path, O_RDWR|O_CREAT|O_TRUNC, 0644)) < 0) {
+        PLCF_DEBUG("Could not open crash report slot %s: %s", queue->reserved_temp_path, strerror(errno));
+        return PLCRASH_OUTPUT_ERR;
+    }
+
+    queue->reserved_slot = slot;
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Move an existing crash report file into the queue, discarding the oldest pending reports as required to
+ * remain within the queue's quotas.
+ *
+ * @param queue The queue.
+ * @param source_path The crash report to be moved. The file must reside on the same file system as the queue.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or an error on failure.
+ */
+plcrash_error_t plcrash_report_queue_add_file (plcrash_report_queue_t *queue, const char *source_path) {
+    plcrash_report_queue_entry_t *entry;
+    plcrash_error_t err;
+    char path[PATH_MAX];
+    struct stat sb;
+    int32_t slot;
+
+    if (stat(source_path, &sb) != 0)
+        return PLCRASH_EINVAL;
+
+    if ((err = make_room(queue, sb.st_size)) != PLCRASH_ESUCCESS)
+        return err;
+
+    if ((slot = free_slot(queue)) < 0)
+        return PLCRASH_EINTERNAL;
+
+    if (plcrash_report_queue_slot_path(queue, slot, path, sizeof(path)) != PLCRASH_ESUCCESS)
+        return PLCRASH_EINVAL;
+
+    if (rename(source_path, path) != 0) {
+        PLCF_DEBUG("Could not move %s to %s: %s", source_path, path, strerror(errno));
+        return PLCRASH_OUTPUT_ERR;
+    }
+
+    entry = &queue->index->entries[slot];
+    entry->sequence = queue->index->next_sequence++;
+    entry->timestamp = sb.st_mtime;
+    entry->size = sb.st_size;
+    entry->state = PLCRASH_REPORT_QUEUE_SLOT_PENDING;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Mark the reserved slot as being written, and return its file descriptor. Ownership of the descriptor is
+ * transfered to the caller. This function is async-safe.
+ *
+ * @param queue The queue.
+ *
+ * @return Returns the reserved slot's file descriptor, or -1 if no slot has been reserved.
+ */
+int plcrash_report_queue_begin (plcrash_report_queue_t *queue) {
+    plcrash_report_queue_entry_t *entry;
+    int fd = queue->reserved_fd;
+
+    if (queue->reserved_slot < 0 || fd < 0)
+        return -1;
+
+    entry = &queue->index->entries[queue->reserved_slot];
+    entry->sequence = queue->index->next_sequence++;
+    entry->timestamp = time(NULL);
+    entry->size = 0;
+
+    OSMemoryBarrier();
+    entry->state = PLCRASH_REPORT_QUEUE_SLOT_WRITING;
+
+    queue->reserved_fd = -1;
+    return fd;
+}
+
+/**
+ * Publish the report started via plcrash_report_queue_begin(), atomically renaming its temporary file to the
+ * slot's report path and marking the slot as pending. This function is async-safe.
+ *
+ * @param queue The queue.
+ * @param size The size of the written report, in bytes.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or an error if the report could not be published. On failure, the
+ * slot is left in the writing state, and the temporary file will be discarded when the queue is next opened.
+ */
+plcrash_error_t plcrash_report_queue_commit (plcrash_report_queue_t *queue, uint64_t size) {
+    plcrash_report_queue_entry_t *entry;
+
+    if (queue->reserved_slot < 0)
+        return PLCRASH_EINVAL;
+
+    entry = &queue->index->entries[queue->reserved_slot];
+    queue->reserved_slot = -1;
+
+    if (rename(queue->reserved_temp_path, queue->reserved_path) != 0)
+        return PLCRASH_OUTPUT_ERR;
+
+    entry->size = size;
+
+    OSMemoryBarrier();
+    entry->state = PLCRASH_REPORT_QUEUE_SLOT_PENDING;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Return true if the queue contains at least one pending report.
+ *
+ * @param queue The queue.
+ */
+bool plcrash_report_queue_has_pending (plcrash_report_queue_t *queue) {
+    for (uint32_t i = 0; i < PLCRASH_REPORT_QUEUE_MAX_SLOTS; i++) {
+        if (queue->index->entries[i].state == PLCRASH_REPORT_QUEUE_SLOT_PENDING)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Fetch the slots of all pending reports, ordered from oldest to newest.
+ *
+ * @param queue The queue.
+ * @param slots On return, up to @a max_slots slot numbers.
+ * @param max_slots The capacity of @a slots.
+ *
+ * @return Returns the number of slots written to @a slots.
+ */
+uint32_t plcrash_report_queue_pending (plcrash_report_queue_t *queue, uint32_t *slots, uint32_t max_slots) {
+    plcrash_report_queue_entry_t *entries = queue->index->entries;
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < PLCRASH_REPORT_QUEUE_MAX_SLOTS; i++) {
+        if (entries[i].state != PLCRASH_REPORT_QUEUE_SLOT_PENDING)
+            continue;
+
+        /* Insert in sequence order, dropping the newest entries if the output is full */
+        uint32_t pos = count;
+        while (pos > 0 && entries[slots[pos - 1]].sequence > entries[i].sequence) {
+            if (pos < max_slots)
+                slots[pos] = slots[pos - 1];
+            pos--;
+        }
+
+        if (pos < max_slots)
+            slots[pos] = i;
+
+        if (count < max_slots)
+            count++;
+    }
+
+    return count;
+}
+
+/**
+ * Return the index entry for @a slot.
+ *
+ * @param queue The queue.
+ * @param slot The slot number. Must be less than PLCRASH_REPORT_QUEUE_MAX_SLOTS.
+ */
+const plcrash_report_queue_entry_t *plcrash_report_queue_entry (plcrash_report_queue_t *queue, uint32_t slot) {
+    return &queue->index->entries[slot];
+}
+
+/**
+ * Return the slot containing the pending report with identifier @a sequence, or -1 if not found.
+ *
+ * @param queue The queue.
+ * @param sequence The report identifier.
+ */
+int32_t plcrash_report_queue_find (plcrash_report_queue_t *queue, uint64_t sequence) {
+    for (uint32_t i = 0; i < PLCRASH_REPORT_QUEUE_MAX_SLOTS; i++) {
+        plcrash_report_queue_entry_t *entry = &queue->index->entries[i];
+        if (entry->state == PLCRASH_REPORT_QUEUE_SLOT_PENDING && entry->sequence == sequence)
+            return i;
+    }
+
+    return -1;
+}
+
+/**
+ * Format the path to @a slot's report file.
+ *
+ * @param queue The queue.
+ * @param slot The slot number.
+ * @param buffer Output buffer.
+ * @param len The size of @a buffer.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or PLCRASH_EINVAL if the path does not fit in @a buffer.
+ */
+plcrash_error_t plcrash_report_queue_slot_path (plcrash_report_queue_t *queue, uint32_t slot, char *buffer, size_t len) {
+    int ret = snprintf(buffer, len, "%s/" PLCRASH_REPORT_QUEUE_SLOT_FORMAT, queue->path, slot);
+    if (ret < 0 || (size_t) ret >= len)
+        return PLCRASH_EINVAL;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Remove the pending report in @a slot.
+ *
+ * @param queue The queue.
+ * @param slot The slot number.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, or an error on failure.
+ */
+plcrash_error_t plcrash_report_queue_remove (plcrash_report_queue_t *queue, uint32_t slot) {
+    plcrash_report_queue_entry_t *entry;
+    char path[PATH_MAX];
+
+    if (slot >= PLCRASH_REPORT_QUEUE_MAX_SLOTS)
+        return PLCRASH_EINVAL;
+
+    entry = &queue->index->entries[slot];
+    if (entry->state != PLCRASH_REPORT_QUEUE_SLOT_PENDING)
+        return PLCRASH_EINVAL;
+
+    if (plcrash_report_queue_slot_path(queue, slot, path, sizeof(path)) != PLCRASH_ESUCCESS)
+        return PLCRASH_EINVAL;
+
+    if (unlink(path) != 0 && errno != ENOENT) {
+        PLCF_DEBUG("Could not remove crash report %s: %s", path, strerror(errno));
+        return PLCRASH_OUTPUT_ERR;
+    }
+
+    entry->state = PLCRASH_REPORT_QUEUE_SLOT_FREE;
+    entry->size = 0;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Close the queue, releasing any reserved slot.
+ *
+ * @param queue The queue.
+ */
+void plcrash_report_queue_close (plcrash_report_queue_t *queue) {
+    release_reservation(queue);
+
+    if (queue->index != NULL)
+        munmap(queue->index, sizeof(plcrash_report_queue_index_t));
+
+    if (queue->index_fd >= 0)
+        close(queue->index_fd);
+
+    free(queue->path);
+
+    queue->index = NULL;
+    queue->index_fd = -1;
+    queue->path = NULL;
+}
+
+/**
+ * @} plcrash_report_queue
+ */
@@ -0,0 +1,154 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <sys/types.h>
+
+#include "PLCrashAsync.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_report_queue
+ *
+ * Maximum number of report slots supported by a queue index.
+ */
+#define PLCRASH_REPORT_QUEUE_MAX_SLOTS 32
+
+/**
+ * @internal
+ * @ingroup plcrash_report_queue
+ *
+ * Report slot states.
+ */
+typedef enum {
+    /** The slot is unused. */
+    PLCRASH_REPORT_QUEUE_SLOT_FREE = 0,
+
+    /** A crash report is being written to the slot's temporary file. */
+    PLCRASH_REPORT_QUEUE_SLOT_WRITING = 1,
+
+    /** The slot contains a pending crash report. */
+    PLCRASH_REPORT_QUEUE_SLOT_PENDING = 2
+} plcrash_report_queue_slot_state_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_queue
+ *
+ * On-disk index entry. All values are in host byte order.
+ */
+typedef struct plcrash_report_queue_entry {
+    /** The slot state (plcrash_report_queue_slot_state_t). */
+    volatile uint32_t state;
+
+    /** Reserved; must be zero. */
+    uint32_t reserved;
+
+    /** The report's unique, monotonically increasing identifier. */
+    uint64_t sequence;
+
+    /** The time at which the report was written, in seconds since the epoch. */
+    int64_t timestamp;
+
+    /** The report size, in bytes. */
+    uint64_t size;
+} plcrash_report_queue_entry_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_queue
+ *
+ * On-disk index layout.
+ */
+typedef struct plcrash_report_queue_index {
+    /** Index magic (PLCRASH_REPORT_QUEUE_MAGIC) */
+    char magic[4];
+
+    /** Index format version */
+    uint32_t version;
+
+    /** Identifier to be assigned to the next report */
+    uint64_t next_sequence;
+
+    /** Slot entries */
+    plcrash_report_queue_entry_t entries[PLCRASH_REPORT_QUEUE_MAX_SLOTS];
+} plcrash_report_queue_index_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_queue
+ *
+ * A bounded, on-disk crash report queue. All fields are private, and must not be accessed directly.
+ */
+typedef struct plcrash_report_queue {
+    /** The queue directory. */
+    char *path;
+
+    /** The index file descriptor. */
+    int index_fd;
+
+    /** The shared mapping of the index file. */
+    plcrash_report_queue_index_t *index;
+
+    /** Maximum number of pending reports. */
+    uint32_t max_count;
+
+    /** Maximum total size of all pending reports, in bytes. */
+    uint64_t max_bytes;
+
+    /** The slot reserved for the next crash report, or -1. */
+    int32_t reserved_slot;
+
+    /** Open file descriptor for the reserved slot's temporary file, or -1. */
+    int reserved_fd;
+
+    /** Path to the reserved slot's temporary file. Formatted at reservation time. */
+    char reserved_temp_path[PATH_MAX];
+
+    /** Path at which the reserved slot's report is published. Formatted at reservation time. */
+    char reserved_path[PATH_MAX];
+} plcrash_report_queue_t;
+
+plcrash_error_t plcrash_report_queue_open (plcrash_report_queue_t *queue, const char *path, uint32_t max_count, uint64_t max_bytes);
+plcrash_error_t plcrash_report_queue_set_quota (plcrash_report_queue_t *queue, uint32_t max_count, uint64_t max_bytes);
+plcrash_error_t plcrash_report_queue_reserve (plcrash_report_queue_t *queue, uint64_t report_size);
+plcrash_error_t plcrash_report_queue_add_file (plcrash_report_queue_t *queue, const char *source_path);
+
+int plcrash_report_queue_begin (plcrash_report_queue_t *queue);
+plcrash_error_t plcrash_report_queue_commit (plcrash_report_queue_t *queue, uint64_t size);
+
+bool plcrash_report_queue_has_pending (plcrash_report_queue_t *queue);
+uint32_t plcrash_report_queue_pending (plcrash_report_queue_t *queue, uint32_t *slots, uint32_t max_slots);
+const plcrash_report_queue_entry_t *plcrash_report_queue_entry (plcrash_report_queue_t *queue, uint32_t slot);
+int32_t plcrash_report_queue_find (plcrash_report_queue_t *queue, uint64_t sequence);
+plcrash_error_t plcrash_report_queue_slot_path (plcrash_report_queue_t *queue, uint32_t slot, char *buffer, size_t len);
+plcrash_error_t plcrash_report_queue_remove (plcrash_report_queue_t *queue, uint32_t slot);
+
+void plcrash_report_queue_close (plcrash_report_queue_t *queue);
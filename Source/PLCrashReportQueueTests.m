@@ -0,0 +1,245 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+
+#import "PLCrashReportQueue.h"
+
+#import <fcntl.h>
+
+@interface PLCrashReportQueueTests : SenTestCase {
+@private
+    /** Temporary queue directory */
+    NSString *_queuePath;
+
+    /** Queue under test */
+    plcrash_report_queue_t _queue;
+}
+
+- (void) writeReport: (NSString *) contents;
+
+@end
+
+@implementation PLCrashReportQueueTests
+
+- (void) setUp {
+    NSError *error;
+
+    _queuePath = [[NSTemporaryDirectory() stringByAppendingString: [[NSProcessInfo processInfo] globallyUniqueString]] retain];
+    STAssertTrue([[NSFileManager defaultManager] createDirectoryAtPath: _queuePath withIntermediateDirectories: YES attributes: nil error: &error], @"Could not create queue directory");
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_open(&_queue, [_queuePath fileSystemRepresentation], 3, 1000), @"Could not open queue");
+}
+
+- (void) tearDown {
+    NSError *error;
+
+    plcrash_report_queue_close(&_queue);
+
+    STAssertTrue([[NSFileManager defaultManager] removeItemAtPath: _queuePath error: &error], @"Could not remove queue directory");
+    [_queuePath release];
+}
+
+/* Simulate a crash: reserve a slot, then write and commit the report through the async-safe path */
+- (void) writeReport: (NSString *) contents {
+    const char *data = [contents UTF8String];
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_reserve(&_queue, 100), @"Could not reserve a slot");
+
+    int fd = plcrash_report_queue_begin(&_queue);
+    STAssertTrue(fd >= 0, @"Could not begin report");
+    STAssertEquals((ssize_t) strlen(data), write(fd, data, strlen(data)), @"Write failed");
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_commit(&_queue, strlen(data)), @"Could not commit report");
+    close(fd);
+}
+
+- (void) testCommit {
+    uint32_t slots[PLCRASH_REPORT_QUEUE_MAX_SLOTS];
+
+    STAssertFalse(plcrash_report_queue_has_pending(&_queue), @"New queue should be empty");
+
+    [self writeReport: @"one"];
+    [self writeReport: @"two"];
+    STAssertTrue(plcrash_report_queue_has_pending(&_queue), @"Report should be pending");
+
+    STAssertEquals(2U, plcrash_report_queue_pending(&_queue, slots, PLCRASH_REPORT_QUEUE_MAX_SLOTS), @"Incorrect pending count");
+    STAssertEquals(1ULL, plcrash_report_queue_entry(&_queue, slots[0])->sequence, @"Oldest report should be returned first");
+    STAssertEquals(3ULL, plcrash_report_queue_entry(&_queue, slots[0])->size, @"Incorrect report size");
+
+    /* No slot is reserved after commit */
+    STAssertEquals(-1, plcrash_report_queue_begin(&_queue), @"Begin should fail without a reservation");
+}
+
+- (void) testCountQuota {
+    uint32_t slots[PLCRASH_REPORT_QUEUE_MAX_SLOTS];
+
+    [self writeReport: @"one"];
+    [self writeReport: @"two"];
+    [self writeReport: @"three"];
+    [self writeReport: @"four"];
+
+    /* The oldest report is evicted to make room for the newest */
+    STAssertEquals(3U, plcrash_report_queue_pending(&_queue, slots, PLCRASH_REPORT_QUEUE_MAX_SLOTS), @"Incorrect pending count");
+    STAssertEquals(2ULL, plcrash_report_queue_entry(&_queue, slots[0])->sequence, @"Oldest report was not evicted");
+    STAssertEquals(4ULL, plcrash_report_queue_entry(&_queue, slots[2])->sequence, @"Newest report missing");
+
+    /* Output is bounded by the caller's buffer */
+    STAssertEquals(1U, plcrash_report_queue_pending(&_queue, slots, 1), @"Incorrect bounded pending count");
+    STAssertEquals(2ULL, plcrash_report_queue_entry(&_queue, slots[0])->sequence, @"Oldest report should be returned first");
+}
+
+- (void) testByteQuota {
+    uint32_t slots[PLCRASH_REPORT_QUEUE_MAX_SLOTS];
+
+    [self writeReport: @"one"];
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_set_quota(&_queue, 3, 100), @"Could not set quota");
+
+    /* Reserving 100 bytes requires evicting the existing report */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_reserve(&_queue, 100), @"Could not reserve a slot");
+    STAssertEquals(0U, plcrash_report_queue_pending(&_queue, slots, PLCRASH_REPORT_QUEUE_MAX_SLOTS), @"Report was not evicted");
+}
+
+- (void) testQuotaRemoveFailure {
+    uint32_t slots[PLCRASH_REPORT_QUEUE_MAX_SLOTS];
+    char path[PATH_MAX];
+
+    [self writeReport: @"one"];
+
+    /* Replace the pending report with a non-empty directory, which can not be unlinked */
+    plcrash_report_queue_pending(&_queue, slots, 1);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_slot_path(&_queue, slots[0], path, sizeof(path)), @"Could not fetch slot path");
+    NSString *reportPath = [NSString stringWithUTF8String: path];
+    STAssertTrue([[NSFileManager defaultManager] removeItemAtPath: reportPath error: NULL], @"Could not remove report");
+    STAssertTrue([[NSFileManager defaultManager] createDirectoryAtPath: reportPath withIntermediateDirectories: NO attributes: nil error: NULL], @"Could not create directory");
+    STAssertTrue([@"x" writeToFile: [reportPath stringByAppendingPathComponent: @"x"] atomically: NO encoding: NSUTF8StringEncoding error: NULL], @"Could not write file");
+
+    /* Reserving a slot that requires the report's eviction must fail, rather than retry indefinitely */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_set_quota(&_queue, 1, 1000), @"Could not set quota");
+    STAssertEquals(PLCRASH_OUTPUT_ERR, plcrash_report_queue_reserve(&_queue, 100), @"Reservation should fail");
+    STAssertEquals(1U, plcrash_report_queue_pending(&_queue, slots, PLCRASH_REPORT_QUEUE_MAX_SLOTS), @"Report should remain pending");
+}
+
+- (void) testAtomicPublish {
+    char path[PATH_MAX];
+    int32_t slot;
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_reserve(&_queue, 100), @"Could not reserve a slot");
+    int fd = plcrash_report_queue_begin(&_queue);
+    STAssertEquals((ssize_t) 3, write(fd, "one", 3), @"Write failed");
+
+    /* Nothing is visible until the report is committed */
+    STAssertFalse(plcrash_report_queue_has_pending(&_queue), @"Uncommitted report should not be pending");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_slot_path(&_queue, 0, path, sizeof(path)), @"Could not fetch slot path");
+    STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath: [NSString stringWithUTF8String: path]], @"Report file should not exist before commit");
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_commit(&_queue, 3), @"Could not commit report");
+    close(fd);
+
+    slot = plcrash_report_queue_find(&_queue, 1);
+    STAssertEquals(0, slot, @"Report not found");
+    STAssertTrue([[NSFileManager defaultManager] fileExistsAtPath: [NSString stringWithUTF8String: path]], @"Report file was not published");
+
+    /* Only the published report remains in the queue directory */
+    NSArray *files = [[NSFileManager defaultManager] contentsOfDirectoryAtPath: _queuePath error: NULL];
+    STAssertEquals((NSUInteger) 2, [files count], @"Unexpected files in queue directory: %@", files);
+}
+
+- (void) testInterruptedWrite {
+    uint32_t slots[PLCRASH_REPORT_QUEUE_MAX_SLOTS];
+
+    [self writeReport: @"one"];
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_reserve(&_queue, 100), @"Could not reserve a slot");
+    int fd = plcrash_report_queue_begin(&_queue);
+    STAssertEquals((ssize_t) 7, write(fd, "partial", 7), @"Write failed");
+    close(fd);
+
+    /* The partial report is discarded on open */
+    plcrash_report_queue_close(&_queue);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_open(&_queue, [_queuePath fileSystemRepresentation], 3, 1000), @"Could not open queue");
+
+    STAssertEquals(1U, plcrash_report_queue_pending(&_queue, slots, PLCRASH_REPORT_QUEUE_MAX_SLOTS), @"Partial report was not discarded");
+    STAssertEquals(1ULL, plcrash_report_queue_entry(&_queue, slots[0])->sequence, @"Incorrect report retained");
+
+    NSArray *files = [[NSFileManager defaultManager] contentsOfDirectoryAtPath: _queuePath error: NULL];
+    STAssertEquals((NSUInteger) 2, [files count], @"Temporary file was not removed: %@", files);
+}
+
+- (void) testFindRemove {
+    char path[PATH_MAX];
+    int32_t slot;
+
+    [self writeReport: @"one"];
+    [self writeReport: @"two"];
+
+    slot = plcrash_report_queue_find(&_queue, 2);
+    STAssertTrue(slot >= 0, @"Report not found");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_slot_path(&_queue, slot, path, sizeof(path)), @"Could not fetch slot path");
+
+    NSString *contents = [NSString stringWithContentsOfFile: [NSString stringWithUTF8String: path] encoding: NSUTF8StringEncoding error: NULL];
+    STAssertEqualObjects(@"two", contents, @"Incorrect report contents");
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_remove(&_queue, slot), @"Could not remove report");
+    STAssertTrue(plcrash_report_queue_find(&_queue, 2) < 0, @"Report was not removed");
+    STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath: [NSString stringWithUTF8String: path]], @"Report file was not removed");
+    STAssertTrue(plcrash_report_queue_find(&_queue, 1) >= 0, @"Unrelated report was removed");
+}
+
+- (void) testRebuildIndex {
+    uint32_t slots[PLCRASH_REPORT_QUEUE_MAX_SLOTS];
+
+    [self writeReport: @"one"];
+    [self writeReport: @"two"];
+    plcrash_report_queue_close(&_queue);
+
+    /* Corrupt the index magic */
+    NSString *indexPath = [_queuePath stringByAppendingPathComponent: @"index"];
+    int fd = open([indexPath fileSystemRepresentation], O_WRONLY);
+    STAssertTrue(fd >= 0, @"Could not open index");
+    STAssertEquals((ssize_t) 4, write(fd, "xxxx", 4), @"Write failed");
+    close(fd);
+
+    /* The existing report files are adopted */
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_open(&_queue, [_queuePath fileSystemRepresentation], 3, 1000), @"Could not open queue");
+    STAssertEquals(2U, plcrash_report_queue_pending(&_queue, slots, PLCRASH_REPORT_QUEUE_MAX_SLOTS), @"Reports were not adopted");
+}
+
+- (void) testAddFile {
+    uint32_t slots[PLCRASH_REPORT_QUEUE_MAX_SLOTS];
+    NSString *legacyPath = [_queuePath stringByAppendingPathComponent: @"legacy"];
+
+    STAssertTrue([@"legacy" writeToFile: legacyPath atomically: NO encoding: NSUTF8StringEncoding error: NULL], @"Could not write file");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_queue_add_file(&_queue, [legacyPath fileSystemRepresentation]), @"Could not add file");
+
+    STAssertEquals(1U, plcrash_report_queue_pending(&_queue, slots, PLCRASH_REPORT_QUEUE_MAX_SLOTS), @"File was not added");
+    STAssertEquals(6ULL, plcrash_report_queue_entry(&_queue, slots[0])->size, @"Incorrect report size");
+    STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath: legacyPath], @"Source file was not moved");
+}
+
+@end
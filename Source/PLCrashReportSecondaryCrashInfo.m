@@ -0,0 +1,63 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashReportSecondaryCrashInfo.h"
+
+/**
+ * Crash information for a thread that crashed while the crash report was being written.
+ *
+ * Only the first crashed thread writes a crash report; threads that crash while the report is being written
+ * are suspended within the crash handler, and their crashes are recorded in compact form.
+ */
+@implementation PLCrashReportSecondaryCrashInfo
+
+@synthesize signalInfo = _signalInfo;
+@synthesize programCounter = _programCounter;
+
+/**
+ * Initialize a new secondary crash data object.
+ *
+ * @param signalInfo The signal received by the secondary crashed thread.
+ * @param programCounter The instruction pointer of the secondary crashed thread.
+ */
+- (id) initWithSignalInfo: (PLCrashReportSignalInfo *) signalInfo programCounter: (uint64_t) programCounter {
+    if ((self = [super init]) == nil)
+        return nil;
+
+    _signalInfo = [signalInfo retain];
+    _programCounter = programCounter;
+
+    return self;
+}
+
+- (void) dealloc {
+    [_signalInfo release];
+    [super dealloc];
+}
+
+@end
@@ -0,0 +1,360 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashReportSignature.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <libkern/OSByteOrder.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_report_signature Crash Signatures
+ * @ingroup plcrash_internal
+ *
+ * Stable crash signatures for report deduplication and bucketing.
+ *
+ * A crash signature is a 64-bit hash of the signal name and code, the uncaught exception name (if any), and the
+ * crashed thread's top frames. Each frame is expressed as its image's UUID and the frame's offset from the image
+ * base address, and so is independent of where images were loaded; reports of the same crash from different
+ * processes, launches, and machines share a signature, while a rebuilt binary produces a new one.
+ *
+ * The hash is XXH64. Its four independent 64-bit accumulator lanes consume 32 bytes per step without a serial
+ * dependency between lanes, and run several times faster than a byte-at-a-time hash such as FNV-1a. The hash
+ * is not cryptographic, and signatures must not be relied upon where collisions may be induced deliberately.
+ *
+ * Signatures are computed at crash time by the log writer, and recorded in the report's summary header; see
+ * plcrash_report_signature_compute() for computing or retrieving a report's signature at ingestion time.
+ *
+ * @{
+ */
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+/** Number of bytes consumed by each accumulator step */
+#define STRIPE_LEN 32
+
+static inline uint64_t rotl64 (uint64_t value, int count) {
+    return (value << count) | (value >> (64 - count));
+}
+
+/* Read an unaligned little-endian value */
+static inline uint64_t read64 (const uint8_t *p) {
+    uint64_t value;
+    plcrash_async_memcpy(&value, p, sizeof(value));
+    return OSSwapLittleToHostInt64(value);
+}
+
+static inline uint32_t read32 (const uint8_t *p) {
+    uint32_t value;
+    plcrash_async_memcpy(&value, p, sizeof(value));
+    return OSSwapLittleToHostInt32(value);
+}
+
+static inline uint64_t lane_round (uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t lane_merge (uint64_t hash, uint64_t acc) {
+    hash ^= lane_round(0, acc);
+    return hash * PRIME64_1 + PRIME64_4;
+}
+
+/* Consume @a count full stripes from @a p. Each lane is updated independently. */
+static void consume_stripes (uint64_t acc[4], const uint8_t *p, size_t count) {
+    uint64_t a0 = acc[0], a1 = acc[1], a2 = acc[2], a3 = acc[3];
+
+    for (size_t i = 0; i < count; i++, p += STRIPE_LEN) {
+        a0 = lane_round(a0, read64(p));
+        a1 = lane_round(a1, read64(p + 8));
+        a2 = lane_round(a2, read64(p + 16));
+        a3 = lane_round(a3, read64(p + 24));
+    }
+
+    acc[0] = a0; acc[1] = a1; acc[2] = a2; acc[3] = a3;
+}
+
+/**
+ * Initialize an incremental crash signature. This function is async-safe.
+ *
+ * @param sig The signature state to initialize.
+ */
+void plcrash_report_signature_init (plcrash_report_signature_t *sig) {
+    sig->acc[0] = PRIME64_1 + PRIME64_2;
+    sig->acc[1] = PRIME64_2;
+    sig->acc[2] = 0;
+    sig->acc[3] = -PRIME64_1;
+    sig->buffered = 0;
+    sig->total_len = 0;
+}
+
+/**
+ * Hash @a len bytes of @a data into @a sig. This function is async-safe.
+ *
+ * @param sig The signature state.
+ * @param data The data to hash.
+ * @param len The length of @a data.
+ */
+void plcrash_report_signature_update (plcrash_report_signature_t *sig, const void *data, size_t len) {
+    const uint8_t *p = data;
+
+    sig->total_len += len;
+
+    /* Complete a partially buffered stripe */
+    if (sig->buffered > 0) {
+        size_t fill = STRIPE_LEN - sig->buffered;
+        if (len < fill) {
+            plcrash_async_memcpy(sig->buffer + sig->buffered, p, len);
+            sig->buffered += len;
+            return;
+        }
+
+        plcrash_async_memcpy(sig->buffer + sig->buffered, p, fill);
+        consume_stripes(sig->acc, sig->buffer, 1);
+        sig->buffered = 0;
+        p += fill;
+        len -= fill;
+    }
+
+    /* Consume full stripes directly from the input, and buffer the remainder */
+    consume_stripes(sig->acc, p, len / STRIPE_LEN);
+    p += len - (len % STRIPE_LEN);
+    len %= STRIPE_LEN;
+
+    if (len > 0) {
+        plcrash_async_memcpy(sig->buffer, p, len);
+        sig->buffered = len;
+    }
+}
+
+/**
+ * Return the signature of all data hashed into @a sig. The state is not modified, and hashing may continue.
+ * This function is async-safe.
+ *
+ * @param sig The signature state.
+ */
+uint64_t plcrash_report_signature_final (const plcrash_report_signature_t *sig) {
+    const uint8_t *p = sig->buffer;
+    size_t remaining = sig->buffered;
+    uint64_t hash;
+
+    if (sig->total_len >= STRIPE_LEN) {
+        hash = rotl64(sig->acc[0], 1) + rotl64(sig->acc[1], 7) + rotl64(sig->acc[2], 12) + rotl64(sig->acc[3], 18);
+        for (int i = 0; i < 4; i++)
+            hash = lane_merge(hash, sig->acc[i]);
+    } else {
+        hash = PRIME64_5;
+    }
+
+    hash += sig->total_len;
+
+    for (; remaining >= 8; p += 8, remaining -= 8) {
+        hash ^= lane_round(0, read64(p));
+        hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+    }
+
+    if (remaining >= 4) {
+        hash ^= (uint64_t) read32(p) * PRIME64_1;
+        hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+        remaining -= 4;
+    }
+
+    for (; remaining > 0; p++, remaining--) {
+        hash ^= *p * PRIME64_5;
+        hash = rotl64(hash, 11) * PRIME64_1;
+    }
+
+    /* Final avalanche */
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+/**
+ * Return the hash of @a len bytes of @a data. This function is async-safe.
+ */
+uint64_t plcrash_report_signature_hash (const void *data, size_t len) {
+    plcrash_report_signature_t sig;
+
+    plcrash_report_signature_init(&sig);
+    plcrash_report_signature_update(&sig, data, len);
+    return plcrash_report_signature_final(&sig);
+}
+
+/**
+ * Add the crash's signal and uncaught exception to @a sig. This must be called once, before any frames are added.
+ * This function is async-safe.
+ *
+ * @param sig The signature state.
+ * @param name The signal name, as recorded in the report (eg, SIGSEGV).
+ * @param code The signal code, as recorded in the report (eg, SEGV_MAPERR).
+ * @param exception_name The uncaught exception's name, or NULL.
+ */
+void plcrash_report_signature_add_signal (plcrash_report_signature_t *sig, const char *name, const char *code, const char *exception_name) {
+    uint8_t has_exception = (exception_name != NULL);
+
+    plcrash_report_signature_update(sig, name, strlen(name) + 1);
+    plcrash_report_signature_update(sig, code, strlen(code) + 1);
+
+    plcrash_report_signature_update(sig, &has_exception, sizeof(has_exception));
+    if (exception_name != NULL)
+        plcrash_report_signature_update(sig, exception_name, strlen(exception_name) + 1);
+}
+
+/**
+ * Add a stack frame to @a sig. Frames must be added in order, starting with the top frame. This function is
+ * async-safe.
+ *
+ * @param sig The signature state.
+ * @param uuid The PLCRASH_REPORT_SIGNATURE_UUID_LEN byte UUID of the image containing the frame, or NULL if the
+ * image has no UUID, or if the frame is not within any image.
+ * @param offset The frame's offset from its image's base address, or the frame's absolute address if it is not
+ * within any image.
+ */
+void plcrash_report_signature_add_frame (plcrash_report_signature_t *sig, const uint8_t *uuid, uint64_t offset) {
+    /* Frames are fixed-size records, and two frames fill exactly one stripe */
+    uint8_t frame[PLCRASH_REPORT_SIGNATURE_UUID_LEN + sizeof(uint64_t)];
+
+    if (uuid != NULL) {
+        plcrash_async_memcpy(frame, uuid, PLCRASH_REPORT_SIGNATURE_UUID_LEN);
+    } else {
+        memset(frame, 0, PLCRASH_REPORT_SIGNATURE_UUID_LEN);
+    }
+
+    offset = OSSwapHostToLittleInt64(offset);
+    plcrash_async_memcpy(frame + PLCRASH_REPORT_SIGNATURE_UUID_LEN, &offset, sizeof(offset));
+
+    plcrash_report_signature_update(sig, frame, sizeof(frame));
+}
+
+/* Unpack the last occurrence of singular field @a number into @a arena. Returns NULL if the field is not present. */
+static ProtobufCMessage *unpack_last (const plcrash_report_decoder_t *decoder, plcrash_report_field_number_t number, ProtobufCArena *arena) {
+    size_t count = plcrash_report_decoder_count(decoder, number);
+    if (count == 0)
+        return NULL;
+
+    return plcrash_report_decoder_unpack_allocator(decoder, number, count - 1, &arena->allocator);
+}
+
+/**
+ * Compute the crash signature of a decoded report, from its signal, exception, crashed thread, and binary images.
+ *
+ * Each frame is attributed to the first image, in report order, whose [base_address, base_address + size) range
+ * contains the frame's PC, matching the attribution made by the log writer at crash time. If the report's
+ * summary header records a signature computed at crash time over @a frame_count frames, it is returned without
+ * decoding the report.
+ *
+ * @param decoder The report decoder.
+ * @param frame_count The maximum number of crashed thread frames to include; PLCRASH_REPORT_SIGNATURE_FRAMES is
+ * recommended, and is the value used at crash time.
+ * @param signature On success, the report's crash signature.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if the report has no signal, or PLCRASH_ENOMEM
+ * if memory could not be allocated.
+ */
+plcrash_error_t plcrash_report_signature_compute (const plcrash_report_decoder_t *decoder, size_t frame_count, uint64_t *signature) {
+    plcrash_report_signature_t sig;
+    ProtobufCArena arena;
+    ProtobufCArena thread_arena;
+    plcrash_error_t err = PLCRASH_ESUCCESS;
+    Plcrash__CrashReport__BinaryImage **images = NULL;
+
+    /* Prefer the signature recorded at crash time */
+    if (decoder->has_summary && decoder->summary.frames_signature != 0 && frame_count == PLCRASH_REPORT_SIGNATURE_FRAMES) {
+        *signature = decoder->summary.frames_signature;
+        return PLCRASH_ESUCCESS;
+    }
+
+    protobuf_c_arena_init(&arena, decoder->message_len);
+
+    Plcrash__CrashReport__Signal *signal = (Plcrash__CrashReport__Signal *) unpack_last(decoder, PLCRASH_REPORT_FIELD_SIGNAL, &arena);
+    if (signal == NULL) {
+        protobuf_c_arena_destroy(&arena);
+        return PLCRASH_EINVAL;
+    }
+
+    Plcrash__CrashReport__Exception *exception = (Plcrash__CrashReport__Exception *) unpack_last(decoder, PLCRASH_REPORT_FIELD_EXCEPTION, &arena);
+
+    plcrash_report_signature_init(&sig);
+    plcrash_report_signature_add_signal(&sig, signal->name, signal->code, (exception != NULL) ? exception->name : NULL);
+
+    Plcrash__CrashReport__Thread *thread = plcrash_report_decoder_crashed_thread(decoder, &thread_arena, NULL);
+    if (thread != NULL && frame_count > thread->n_frames)
+        frame_count = thread->n_frames;
+    if (thread == NULL)
+        frame_count = 0;
+
+    if (frame_count > 0) {
+        images = calloc(frame_count, sizeof(*images));
+        if (images == NULL) {
+            err = PLCRASH_ENOMEM;
+            goto cleanup;
+        }
+
+        plcrash_report_decoder_frame_images(decoder, thread, frame_count, &arena.allocator, images);
+
+        /* Frames outside of any image are recorded by absolute address, and frames in images without a UUID are
+         * recorded with a zero UUID */
+        for (size_t f = 0; f < frame_count; f++) {
+            Plcrash__CrashReport__BinaryImage *image = images[f];
+            uint64_t pc = thread->frames[f]->pc;
+
+            if (image == NULL) {
+                plcrash_report_signature_add_frame(&sig, NULL, pc);
+            } else if (image->has_uuid && image->uuid.len == PLCRASH_REPORT_SIGNATURE_UUID_LEN) {
+                plcrash_report_signature_add_frame(&sig, image->uuid.data, pc - image->base_address);
+            } else {
+                plcrash_report_signature_add_frame(&sig, NULL, pc - image->base_address);
+            }
+        }
+    }
+
+    *signature = plcrash_report_signature_final(&sig);
+
+cleanup:
+    free(images);
+    protobuf_c_arena_destroy(&thread_arena);
+    protobuf_c_arena_destroy(&arena);
+
+    return err;
+}
+
+/**
+ * @} plcrash_report_signature
+ */
@@ -0,0 +1,80 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#import "PLCrashAsync.h"
+#import "PLCrashReportDecoder.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_report_signature
+ *
+ * Number of crashed thread frames included in a crash signature by default.
+ */
+#define PLCRASH_REPORT_SIGNATURE_FRAMES 5
+
+/**
+ * @internal
+ * @ingroup plcrash_report_signature
+ *
+ * Size of a binary image UUID, in bytes.
+ */
+#define PLCRASH_REPORT_SIGNATURE_UUID_LEN 16
+
+/**
+ * @internal
+ * @ingroup plcrash_report_signature
+ *
+ * Incremental crash signature state. The state may be placed on the stack, and requires no cleanup.
+ */
+typedef struct plcrash_report_signature {
+    /** Per-lane accumulators */
+    uint64_t acc[4];
+
+    /** Bytes not yet consumed by a full stripe */
+    uint8_t buffer[32];
+
+    /** Number of valid bytes in buffer */
+    size_t buffered;
+
+    /** Total number of bytes hashed */
+    uint64_t total_len;
+} plcrash_report_signature_t;
+
+void plcrash_report_signature_init (plcrash_report_signature_t *sig);
+void plcrash_report_signature_update (plcrash_report_signature_t *sig, const void *data, size_t len);
+uint64_t plcrash_report_signature_final (const plcrash_report_signature_t *sig);
+uint64_t plcrash_report_signature_hash (const void *data, size_t len);
+
+void plcrash_report_signature_add_signal (plcrash_report_signature_t *sig, const char *name, const char *code, const char *exception_name);
+void plcrash_report_signature_add_frame (plcrash_report_signature_t *sig, const uint8_t *uuid, uint64_t offset);
+
+plcrash_error_t plcrash_report_signature_compute (const plcrash_report_decoder_t *decoder, size_t frame_count, uint64_t *signature);
@@ -0,0 +1,196 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+#import "PLCrashTestReportBuilder.h"
+#import "CrashReporter.h"
+#import "PLCrashReportSignature.h"
+#import "PLCrashReportSummary.h"
+
+#import <mach/mach_time.h>
+
+@interface PLCrashReportSignatureTests : SenTestCase @end
+
+/* Image UUIDs used by signature_report() */
+static const uint8_t test_uuids[2][PLCRASH_REPORT_SIGNATURE_UUID_LEN] = {
+    { 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f },
+    { 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f }
+};
+
+/* Image-relative frame addresses used by signature_report(), and the image containing each */
+static const uint64_t test_offsets[] = { 0x100, 0x2040, 0x180, 0x1234, 0x10 };
+static const int test_images[] = { 0, 1, 0, 1, 0 };
+
+/*
+ * Encode a version 1 crash report with two images loaded at @a base, whose crashed thread's top frames are
+ * test_offsets, followed by a frame outside of any image. If @a exception is non-NULL, an uncaught exception
+ * with the given name is included.
+ */
+static NSData *signature_report (uint64_t base, const char *signal, const char *exception) {
+    NSMutableData *report = plcrash_test_report_header();
+    plcrash_test_append_report_info(report, "com.example.signature", signal, 0);
+
+    /* An idle thread, followed by the crashed thread */
+    NSMutableData *thread = [NSMutableData data];
+    NSMutableData *frame = [NSMutableData data];
+    plcrash_test_append_uint(thread, 1, 0);
+    plcrash_test_append_uint(frame, 3, base + 0x42);
+    plcrash_test_append_message(thread, 2, frame);
+    plcrash_test_append_uint(thread, 3, 0);
+    plcrash_test_append_message(report, 3, thread);
+
+    thread = [NSMutableData data];
+    plcrash_test_append_uint(thread, 1, 1);
+    for (size_t i = 0; i < sizeof(test_offsets) / sizeof(test_offsets[0]); i++) {
+        frame = [NSMutableData data];
+        plcrash_test_append_uint(frame, 3, base + test_images[i] * 0x10000 + test_offsets[i]);
+        plcrash_test_append_message(thread, 2, frame);
+    }
+    frame = [NSMutableData data];
+    plcrash_test_append_uint(frame, 3, 0x42);
+    plcrash_test_append_message(thread, 2, frame);
+    plcrash_test_append_uint(thread, 3, 1);
+    plcrash_test_append_message(report, 3, thread);
+
+    for (int i = 0; i < 2; i++) {
+        NSMutableData *image = [NSMutableData data];
+        plcrash_test_append_uint(image, 1, base + i * 0x10000);
+        plcrash_test_append_uint(image, 2, 0x8000);
+        plcrash_test_append_string(image, 3, i == 0 ? "/usr/lib/libfirst.dylib" : "/usr/lib/libsecond.dylib");
+        plcrash_test_append_bytes(image, 4, test_uuids[i], sizeof(test_uuids[i]));
+        plcrash_test_append_message(report, 4, image);
+    }
+
+    if (exception != NULL) {
+        NSMutableData *msg = [NSMutableData data];
+        plcrash_test_append_string(msg, 1, exception);
+        plcrash_test_append_string(msg, 2, "reason");
+        plcrash_test_append_message(report, 5, msg);
+    }
+
+    return report;
+}
+
+/* Compute the signature of @a report over @a frames frames, or 0 on failure */
+static uint64_t report_signature (NSData *report, size_t frames) {
+    plcrash_report_decoder_t decoder;
+    uint64_t signature = 0;
+
+    if (plcrash_report_decoder_init(&decoder, [report bytes], [report length]) == PLCRASH_ESUCCESS) {
+        if (plcrash_report_signature_compute(&decoder, frames, &signature) != PLCRASH_ESUCCESS)
+            signature = 0;
+    }
+
+    plcrash_report_decoder_free(&decoder);
+    return signature;
+}
+
+@implementation PLCrashReportSignatureTests
+
+- (void) testHash {
+    /* XXH64 reference values */
+    STAssertEquals(0xEF46DB3751D8E999ULL, plcrash_report_signature_hash("", 0), @"Incorrect empty hash");
+    STAssertEquals(0x44BC2CF5AD770999ULL, plcrash_report_signature_hash("abc", 3), @"Incorrect hash");
+}
+
+/* Hashing data incrementally, in any split, must match hashing it at once */
+- (void) testIncremental {
+    uint8_t data[200];
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = (uint8_t) (i * 7 + 3);
+
+    for (size_t len = 0; len <= sizeof(data); len++) {
+        uint64_t expected = plcrash_report_signature_hash(data, len);
+
+        for (size_t chunk = 1; chunk <= 40; chunk += 13) {
+            plcrash_report_signature_t sig;
+            plcrash_report_signature_init(&sig);
+            for (size_t offset = 0; offset < len; offset += chunk)
+                plcrash_report_signature_update(&sig, data + offset, (len - offset < chunk) ? len - offset : chunk);
+
+            STAssertEquals(expected, plcrash_report_signature_final(&sig), @"Incremental hash of %zu bytes in %zu byte chunks differs", len, chunk);
+        }
+    }
+}
+
+/* The signature covers the signal, exception, and each frame's image UUID and image-relative address */
+- (void) testCompute {
+    plcrash_report_signature_t sig;
+
+    plcrash_report_signature_init(&sig);
+    plcrash_report_signature_add_signal(&sig, "SIGSEGV", "SEGV_MAPERR", "TestException");
+    for (size_t i = 0; i < PLCRASH_REPORT_SIGNATURE_FRAMES; i++)
+        plcrash_report_signature_add_frame(&sig, test_uuids[test_images[i]], test_offsets[i]);
+
+    STAssertEquals(plcrash_report_signature_final(&sig), report_signature(signature_report(0x1000000, "SIGSEGV", "TestException"), PLCRASH_REPORT_SIGNATURE_FRAMES),
+                   @"Incorrect report signature");
+
+    /* A frame outside of any image is recorded by address */
+    plcrash_report_signature_add_frame(&sig, NULL, 0x42);
+    STAssertEquals(plcrash_report_signature_final(&sig), report_signature(signature_report(0x1000000, "SIGSEGV", "TestException"), 100),
+                   @"Incorrect report signature");
+}
+
+/* Reports of the same crash share a signature regardless of load address; other crashes do not */
+- (void) testStability {
+    uint64_t signature = report_signature(signature_report(0x1000000, "SIGSEGV", NULL), PLCRASH_REPORT_SIGNATURE_FRAMES);
+
+    STAssertTrue(signature != 0, @"Could not compute signature");
+    STAssertEquals(signature, report_signature(signature_report(0x7000000, "SIGSEGV", NULL), PLCRASH_REPORT_SIGNATURE_FRAMES), @"Signature depends on load address");
+
+    STAssertTrue(signature != report_signature(signature_report(0x1000000, "SIGBUS", NULL), PLCRASH_REPORT_SIGNATURE_FRAMES), @"Signal not included");
+    STAssertTrue(signature != report_signature(signature_report(0x1000000, "SIGSEGV", "TestException"), PLCRASH_REPORT_SIGNATURE_FRAMES), @"Exception not included");
+    STAssertTrue(signature != report_signature(signature_report(0x1000000, "SIGSEGV", NULL), 1), @"Frame count not respected");
+}
+
+/* Compare hash throughput against the summary's byte-at-a-time FNV-1a hash */
+- (void) testPerformance {
+    const size_t len = 4 * 1024 * 1024;
+    uint8_t *data = malloc(len);
+    mach_timebase_info_data_t timebase;
+    uint64_t start, signature_ns, fnv_ns;
+
+    memset(data, 0x5a, len);
+    mach_timebase_info(&timebase);
+
+    start = mach_absolute_time();
+    uint64_t signature = plcrash_report_signature_hash(data, len);
+    signature_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    start = mach_absolute_time();
+    uint64_t fnv = plcrash_report_summary_hash(plcrash_report_summary_hash_init(), data, len);
+    fnv_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    NSLog(@"Hashed %zu bytes: signature %llu us (%016llx), FNV-1a %llu us (%016llx)", len,
+          (unsigned long long) signature_ns / 1000, (unsigned long long) signature,
+          (unsigned long long) fnv_ns / 1000, (unsigned long long) fnv);
+
+    free(data);
+}
+
+@end
@@ -0,0 +1,957 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PLCrashReportStream.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_report_stream Streaming Crash Report Decoder
+ * @ingroup plcrash_internal
+ *
+ * An event-based, push-style crash report decoder.
+ *
+ * The report file is fed to the decoder in arbitrarily sized chunks, and the decoder invokes a callback for each
+ * decoded section, thread, frame, register, and binary image. The decoder's state is a fixed-size structure;
+ * no memory is allocated, and memory use does not depend on the size of the report. Strings longer than
+ * PLCRASH_REPORT_STREAM_STRING_MAX - 1 bytes are truncated.
+ *
+ * Unlike protobuf_c_message_unpack(), the decoder does not require the report to be complete. Top-level sections
+ * and frames are emitted as soon as they have been decoded; a trailing, partially written section is dropped,
+ * with the exception of a partially written thread, whose completed frames and registers are emitted before
+ * a PLCRASH_REPORT_STREAM_THREAD_END event marked as incomplete. Required fields are not enforced; the
+ * plcrash_report_stream_event_t::present mask records which fields were decoded.
+ *
+ * plcrash_report_stream_finish() reports how much of the report was recovered. Decoding stops at the first
+ * malformed field, and everything decoded before it remains valid.
+ *
+ * Unknown fields, and fields encoded with an unexpected wire type, are skipped.
+ *
+ * @{
+ */
+
+/** @internal Crash report file magic. Must match PLCRASH_REPORT_FILE_MAGIC. */
+#define STREAM_FILE_MAGIC "plcrash"
+
+/** @internal Length of the file magic and version byte. */
+#define STREAM_PREFIX_LEN (sizeof(STREAM_FILE_MAGIC) - 1 + sizeof(uint8_t))
+
+/** @internal Length of the summary header's size field. */
+#define STREAM_SUMMARY_SIZE_LEN 4
+
+/** @internal Minimum summary header size. Must match sizeof(plcrash_report_summary_header_t). */
+#define STREAM_SUMMARY_MIN_SIZE 72
+
+/** @internal Read buffer size used by plcrash_report_stream_feed_fd(). */
+#define STREAM_READ_BUFFER_SIZE 4096
+
+/** @internal Parser states */
+enum {
+    /** Reading the file magic and version */
+    STATE_HEADER = 0,
+
+    /** Reading the summary header size */
+    STATE_SUMMARY_SIZE,
+
+    /** Skipping the summary header */
+    STATE_SUMMARY,
+
+    /** Reading a field key */
+    STATE_KEY,
+
+    /** Reading a varint field value */
+    STATE_VARINT,
+
+    /** Reading a length prefix */
+    STATE_LENGTH,
+
+    /** Reading (or skipping) length-delimited data */
+    STATE_BYTES,
+
+    /** Skipping a fixed-width value */
+    STATE_FIXED,
+
+    /** Decoding failed */
+    STATE_FAILED
+};
+
+/** @internal Protobuf wire types */
+enum {
+    WIRE_TYPE_VARINT = 0,
+    WIRE_TYPE_64BIT = 1,
+    WIRE_TYPE_LENGTH_DELIMITED = 2,
+    WIRE_TYPE_32BIT = 5
+};
+
+/** @internal Message types of crash_report.proto */
+enum {
+    MSG_NONE = 0,
+    MSG_REPORT,
+    MSG_SYSTEM_INFO,
+    MSG_APP_INFO,
+    MSG_THREAD,
+    MSG_FRAME,
+    MSG_REGISTER,
+    MSG_IMAGE,
+    MSG_EXCEPTION,
+    MSG_SIGNAL,
+    MSG_PROCESS_INFO,
+    MSG_MACHINE_INFO,
+    MSG_HANDLER_INFO,
+    MSG_SECONDARY_CRASH,
+    MSG_PROCESSOR
+};
+
+/**
+ * @internal
+ * Reset @a string to the empty string.
+ */
+static void reset_string (plcrash_report_stream_string_t *string) {
+    string->value[0] = '\0';
+    string->length = 0;
+    string->truncated = false;
+}
+
+/**
+ * @internal
+ * Reset @a signal to its default values.
+ */
+static void reset_signal (plcrash_report_stream_signal_t *signal) {
+    signal->present = 0;
+    reset_string(&signal->name);
+    reset_string(&signal->code);
+    signal->address = 0;
+}
+
+/**
+ * @internal
+ * Reset the pending event to an event of @a type for the message at the current level.
+ */
+static void reset_event (plcrash_report_stream_t *stream, plcrash_report_stream_event_type_t type) {
+    plcrash_report_stream_event_t *event = &stream->event;
+
+    event->type = type;
+    event->offset = stream->levels[stream->depth].start;
+    event->length = stream->levels[stream->depth].end - stream->levels[stream->depth].start;
+    event->present = 0;
+}
+
+/**
+ * @internal
+ * Emit the pending event.
+ */
+static void emit (plcrash_report_stream_t *stream) {
+    stream->callback(&stream->event, stream->context);
+}
+
+/**
+ * @internal
+ * Emit a PLCRASH_REPORT_STREAM_THREAD_END event for the thread at level 1.
+ */
+static void emit_thread_end (plcrash_report_stream_t *stream, bool complete) {
+    plcrash_report_stream_event_t *event = &stream->event;
+
+    event->type = PLCRASH_REPORT_STREAM_THREAD_END;
+    event->offset = stream->levels[1].start;
+    event->length = stream->levels[1].end - stream->levels[1].start;
+    event->present = 0;
+    event->data.thread.index = stream->thread_count - 1;
+    event->data.thread.number = stream->thread_number;
+    event->data.thread.crashed = stream->thread_crashed;
+    event->data.thread.frame_count = stream->frame_count;
+    event->data.thread.register_count = stream->register_count;
+    event->data.thread.complete = complete;
+    emit(stream);
+}
+
+/**
+ * @internal
+ * Return the presence mask for the message at the current level, or NULL if the message does not track presence.
+ */
+static uint32_t *presence (plcrash_report_stream_t *stream) {
+    switch (stream->levels[stream->depth].type) {
+        case MSG_REPORT:
+        case MSG_THREAD:
+            return NULL;
+
+        case MSG_PROCESSOR:
+            return &((plcrash_report_stream_processor_t *) stream->levels[stream->depth].target)->present;
+
+        case MSG_SIGNAL:
+            return &((plcrash_report_stream_signal_t *) stream->levels[stream->depth].target)->present;
+
+        default:
+            return &stream->event.present;
+    }
+}
+
+/**
+ * @internal
+ * Record field @a field of the current message as present.
+ */
+static void mark_present (plcrash_report_stream_t *stream, uint32_t field) {
+    uint32_t *mask = presence(stream);
+    if (mask != NULL)
+        *mask |= (1U << field);
+}
+
+/**
+ * @internal
+ * Begin decoding a message of @a type at the current level.
+ */
+static void begin_message (plcrash_report_stream_t *stream, int type) {
+    plcrash_report_stream_event_t *event = &stream->event;
+    void *target = stream->levels[stream->depth].target;
+
+    switch (type) {
+        case MSG_SYSTEM_INFO:
+            reset_event(stream, PLCRASH_REPORT_STREAM_SYSTEM_INFO);
+            event->data.system_info.operating_system = 3; /* OS_UNKNOWN */
+            reset_string(&event->data.system_info.os_version);
+            event->data.system_info.architecture = 6; /* ARCHITECTURE_UNKNOWN */
+            event->data.system_info.timestamp = 0;
+            reset_string(&event->data.system_info.os_build);
+            break;
+
+        case MSG_MACHINE_INFO:
+            reset_event(stream, PLCRASH_REPORT_STREAM_MACHINE_INFO);
+            reset_string(&event->data.machine_info.model);
+            memset(&event->data.machine_info.processor, 0, sizeof(event->data.machine_info.processor));
+            event->data.machine_info.processor_count = 0;
+            event->data.machine_info.logical_processor_count = 0;
+            break;
+
+        case MSG_APP_INFO:
+            reset_event(stream, PLCRASH_REPORT_STREAM_APP_INFO);
+            reset_string(&event->data.app_info.identifier);
+            reset_string(&event->data.app_info.version);
+            break;
+
+        case MSG_PROCESS_INFO:
+            reset_event(stream, PLCRASH_REPORT_STREAM_PROCESS_INFO);
+            reset_string(&event->data.process_info.process_name);
+            event->data.process_info.process_id = 0;
+            reset_string(&event->data.process_info.process_path);
+            reset_string(&event->data.process_info.parent_process_name);
+            event->data.process_info.parent_process_id = 0;
+            event->data.process_info.native = false;
+            break;
+
+        case MSG_THREAD:
+            stream->thread_count++;
+            stream->thread_number = 0;
+            stream->thread_crashed = false;
+            stream->frame_count = 0;
+            stream->register_count = 0;
+
+            reset_event(stream, PLCRASH_REPORT_STREAM_THREAD_BEGIN);
+            memset(&event->data.thread, 0, sizeof(event->data.thread));
+            event->data.thread.index = stream->thread_count - 1;
+            emit(stream);
+            break;
+
+        case MSG_FRAME:
+            reset_event(stream, PLCRASH_REPORT_STREAM_FRAME);
+            event->data.frame.pc = 0;
+            break;
+
+        case MSG_REGISTER:
+            reset_event(stream, PLCRASH_REPORT_STREAM_REGISTER);
+            reset_string(&event->data.reg.name);
+            event->data.reg.value = 0;
+            break;
+
+        case MSG_IMAGE:
+            reset_event(stream, PLCRASH_REPORT_STREAM_IMAGE);
+            event->data.image.base_address = 0;
+            event->data.image.size = 0;
+            reset_string(&event->data.image.name);
+            memset(event->data.image.uuid, 0, sizeof(event->data.image.uuid));
+            event->data.image.uuid_length = 0;
+            memset(&event->data.image.code_type, 0, sizeof(event->data.image.code_type));
+            break;
+
+        case MSG_EXCEPTION:
+            reset_event(stream, PLCRASH_REPORT_STREAM_EXCEPTION);
+            reset_string(&event->data.exception.name);
+            reset_string(&event->data.exception.reason);
+            break;
+
+        case MSG_SIGNAL:
+            /* Top-level signals are emitted as events; nested signals populate their parent */
+            if (stream->depth == 1)
+                reset_event(stream, PLCRASH_REPORT_STREAM_SIGNAL);
+            reset_signal(target);
+            break;
+
+        case MSG_HANDLER_INFO:
+            reset_event(stream, PLCRASH_REPORT_STREAM_HANDLER_INFO);
+            event->data.handler_info.stack_size = 0;
+            event->data.handler_info.stack_used = 0;
+            break;
+
+        case MSG_SECONDARY_CRASH:
+            reset_event(stream, PLCRASH_REPORT_STREAM_SECONDARY_CRASH);
+            reset_signal(&event->data.secondary_crash.signal);
+            event->data.secondary_crash.pc = 0;
+            break;
+
+        case MSG_PROCESSOR:
+            memset(target, 0, sizeof(plcrash_report_stream_processor_t));
+            break;
+    }
+}
+
+/**
+ * @internal
+ * Complete the message at the current level, emitting any event, and pop it from the message stack.
+ */
+static void end_message (plcrash_report_stream_t *stream) {
+    switch (stream->levels[stream->depth].type) {
+        case MSG_THREAD:
+            emit_thread_end(stream, true);
+            break;
+
+        case MSG_FRAME:
+            stream->event.data.frame.thread_index = stream->thread_count - 1;
+            stream->event.data.frame.index = stream->frame_count++;
+            emit(stream);
+            break;
+
+        case MSG_REGISTER:
+            stream->event.data.reg.thread_index = stream->thread_count - 1;
+            stream->event.data.reg.index = stream->register_count++;
+            emit(stream);
+            break;
+
+        case MSG_SIGNAL:
+            if (stream->depth == 1)
+                emit(stream);
+            break;
+
+        case MSG_PROCESSOR:
+            break;
+
+        default:
+            emit(stream);
+            break;
+    }
+
+    stream->depth--;
+}
+
+/**
+ * @internal
+ * Return the message type of embedded message field @a field within the current message, or MSG_NONE. If the
+ * message populates a nested value of its parent's event, @a target is set to that value.
+ */
+static int submessage_type (plcrash_report_stream_t *stream, uint32_t field, void **target) {
+    plcrash_report_stream_event_t *event = &stream->event;
+
+    *target = NULL;
+    switch (stream->levels[stream->depth].type) {
+        case MSG_REPORT:
+            switch (field) {
+                case 1: return MSG_SYSTEM_INFO;
+                case 2: return MSG_APP_INFO;
+                case 3: return MSG_THREAD;
+                case 4: return MSG_IMAGE;
+                case 5: return MSG_EXCEPTION;
+                case 6: *target = &event->data.signal; return MSG_SIGNAL;
+                case 7: return MSG_PROCESS_INFO;
+                case 8: return MSG_MACHINE_INFO;
+                case 9: return MSG_HANDLER_INFO;
+                case 10: return MSG_SECONDARY_CRASH;
+            }
+            break;
+
+        case MSG_THREAD:
+            switch (field) {
+                case 2: return MSG_FRAME;
+                case 4: return MSG_REGISTER;
+            }
+            break;
+
+        case MSG_IMAGE:
+            if (field == 5) {
+                *target = &event->data.image.code_type;
+                return MSG_PROCESSOR;
+            }
+            break;
+
+        case MSG_MACHINE_INFO:
+            if (field == 2) {
+                *target = &event->data.machine_info.processor;
+                return MSG_PROCESSOR;
+            }
+            break;
+
+        case MSG_SECONDARY_CRASH:
+            if (field == 1) {
+                *target = &event->data.secondary_crash.signal;
+                return MSG_SIGNAL;
+            }
+            break;
+    }
+
+    return MSG_NONE;
+}
+
+/**
+ * @internal
+ * Return the string populated by length-delimited field @a field within the current message, or NULL.
+ */
+static plcrash_report_stream_string_t *string_field (plcrash_report_stream_t *stream, uint32_t field) {
+    plcrash_report_stream_event_t *event = &stream->event;
+    void *target = stream->levels[stream->depth].target;
+
+    switch (stream->levels[stream->depth].type) {
+        case MSG_SYSTEM_INFO:
+            if (field == 2) return &event->data.system_info.os_version;
+            if (field == 5) return &event->data.system_info.os_build;
+            break;
+
+        case MSG_MACHINE_INFO:
+            if (field == 1) return &event->data.machine_info.model;
+            break;
+
+        case MSG_APP_INFO:
+            if (field == 1) return &event->data.app_info.identifier;
+            if (field == 2) return &event->data.app_info.version;
+            break;
+
+        case MSG_PROCESS_INFO:
+            if (field == 1) return &event->data.process_info.process_name;
+            if (field == 3) return &event->data.process_info.process_path;
+            if (field == 4) return &event->data.process_info.parent_process_name;
+            break;
+
+        case MSG_REGISTER:
+            if (field == 1) return &event->data.reg.name;
+            break;
+
+        case MSG_IMAGE:
+            if (field == 3) return &event->data.image.name;
+            break;
+
+        case MSG_EXCEPTION:
+            if (field == 1) return &event->data.exception.name;
+            if (field == 2) return &event->data.exception.reason;
+            break;
+
+        case MSG_SIGNAL:
+            if (field == 1) return &((plcrash_report_stream_signal_t *) target)->name;
+            if (field == 2) return &((plcrash_report_stream_signal_t *) target)->code;
+            break;
+    }
+
+    return NULL;
+}
+
+/**
+ * @internal
+ * Apply varint field @a field of the current message.
+ */
+static void apply_varint (plcrash_report_stream_t *stream, uint32_t field, uint64_t value) {
+    plcrash_report_stream_event_t *event = &stream->event;
+    void *target = stream->levels[stream->depth].target;
+
+    switch (stream->levels[stream->depth].type) {
+        case MSG_SYSTEM_INFO:
+            switch (field) {
+                case 1: event->data.system_info.operating_system = (uint32_t) value; break;
+                case 3: event->data.system_info.architecture = (uint32_t) value; break;
+                case 4: event->data.system_info.timestamp = (int64_t) value; break;
+                default: return;
+            }
+            break;
+
+        case MSG_MACHINE_INFO:
+            switch (field) {
+                case 3: event->data.machine_info.processor_count = (uint32_t) value; break;
+                case 4: event->data.machine_info.logical_processor_count = (uint32_t) value; break;
+                default: return;
+            }
+            break;
+
+        case MSG_PROCESS_INFO:
+            switch (field) {
+                case 2: event->data.process_info.process_id = (uint32_t) value; break;
+                case 5: event->data.process_info.parent_process_id = (uint32_t) value; break;
+                case 6: event->data.process_info.native = (value != 0); break;
+                default: return;
+            }
+            break;
+
+        case MSG_THREAD:
+            switch (field) {
+                case 1: stream->thread_number = (uint32_t) value; break;
+                case 3: stream->thread_crashed = (value != 0); break;
+            }
+            return;
+
+        case MSG_FRAME:
+            if (field != 3)
+                return;
+            event->data.frame.pc = value;
+            break;
+
+        case MSG_REGISTER:
+            if (field != 2)
+                return;
+            event->data.reg.value = value;
+            break;
+
+        case MSG_IMAGE:
+            switch (field) {
+                case 1: event->data.image.base_address = value; break;
+                case 2: event->data.image.size = value; break;
+                default: return;
+            }
+            break;
+
+        case MSG_SIGNAL:
+            if (field != 3)
+                return;
+            ((plcrash_report_stream_signal_t *) target)->address = value;
+            break;
+
+        case MSG_HANDLER_INFO:
+            switch (field) {
+                case 1: event->data.handler_info.stack_size = value; break;
+                case 2: event->data.handler_info.stack_used = value; break;
+                default: return;
+            }
+            break;
+
+        case MSG_SECONDARY_CRASH:
+            if (field != 2)
+                return;
+            event->data.secondary_crash.pc = value;
+            break;
+
+        case MSG_PROCESSOR:
+            switch (field) {
+                case 1: ((plcrash_report_stream_processor_t *) target)->encoding = (uint32_t) value; break;
+                case 2: ((plcrash_report_stream_processor_t *) target)->type = value; break;
+                case 3: ((plcrash_report_stream_processor_t *) target)->subtype = value; break;
+                default: return;
+            }
+            break;
+
+        default:
+            return;
+    }
+
+    mark_present(stream, field);
+}
+
+/**
+ * @internal
+ * Record a decoding failure.
+ */
+static plcrash_error_t fail (plcrash_report_stream_t *stream, plcrash_error_t error) {
+    stream->error = error;
+    stream->state = STATE_FAILED;
+    return error;
+}
+
+/**
+ * @internal
+ * Called after each field has been fully consumed. Closes any messages ending at the current offset, and
+ * updates the recovered offset.
+ */
+static plcrash_error_t field_done (plcrash_report_stream_t *stream) {
+    stream->state = STATE_KEY;
+
+    while (stream->depth > 0 && stream->offset >= stream->levels[stream->depth].end) {
+        /* The field overran its enclosing message */
+        if (stream->offset > stream->levels[stream->depth].end)
+            return fail(stream, PLCRASH_EINVAL);
+
+        end_message(stream);
+    }
+
+    if (stream->depth == 0)
+        stream->recovered = stream->offset;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * @internal
+ * Begin decoding the top-level message, following the file header.
+ */
+static void begin_report (plcrash_report_stream_t *stream) {
+    stream->state = STATE_KEY;
+    stream->depth = 0;
+    stream->levels[0].type = MSG_REPORT;
+    stream->levels[0].field = 0;
+    stream->levels[0].start = stream->offset;
+    stream->levels[0].end = UINT64_MAX;
+    stream->levels[0].target = NULL;
+    stream->recovered = stream->offset;
+}
+
+/**
+ * @internal
+ * Handle a complete field key.
+ */
+static plcrash_error_t handle_key (plcrash_report_stream_t *stream, uint64_t key) {
+    if ((key >> 3) == 0 || (key >> 3) > UINT32_MAX)
+        return fail(stream, PLCRASH_EINVAL);
+
+    stream->field = (uint32_t) (key >> 3);
+    switch (key & 0x7) {
+        case WIRE_TYPE_VARINT:
+            stream->state = STATE_VARINT;
+            break;
+
+        case WIRE_TYPE_64BIT:
+            stream->remaining = 8;
+            stream->state = STATE_FIXED;
+            break;
+
+        case WIRE_TYPE_32BIT:
+            stream->remaining = 4;
+            stream->state = STATE_FIXED;
+            break;
+
+        case WIRE_TYPE_LENGTH_DELIMITED:
+            stream->state = STATE_LENGTH;
+            break;
+
+        default:
+            /* Groups are not used by crash_report.proto */
+            return fail(stream, PLCRASH_EINVAL);
+    }
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * @internal
+ * Handle a complete length prefix.
+ */
+static plcrash_error_t handle_length (plcrash_report_stream_t *stream, uint64_t len) {
+    uint64_t end = stream->levels[stream->depth].end;
+    plcrash_report_stream_string_t *string;
+    void *target;
+    int type;
+
+    /* The field must fit within its enclosing message */
+    if (stream->offset > end || len > end - stream->offset)
+        return fail(stream, PLCRASH_EINVAL);
+
+    /* Embedded message. The schema bounds the nesting depth. */
+    if ((type = submessage_type(stream, stream->field, &target)) != MSG_NONE) {
+        mark_present(stream, stream->field);
+
+        stream->depth++;
+        stream->levels[stream->depth].type = type;
+        stream->levels[stream->depth].field = stream->field;
+        stream->levels[stream->depth].start = stream->offset;
+        stream->levels[stream->depth].end = stream->offset + len;
+        stream->levels[stream->depth].target = target;
+        begin_message(stream, type);
+
+        return field_done(stream);
+    }
+
+    /* Strings and bytes */
+    stream->dest = NULL;
+    stream->dest_remaining = 0;
+    stream->string = NULL;
+
+    if ((string = string_field(stream, stream->field)) != NULL) {
+        mark_present(stream, stream->field);
+
+        string->truncated = (len > PLCRASH_REPORT_STREAM_STRING_MAX - 1);
+        string->length = string->truncated ? PLCRASH_REPORT_STREAM_STRING_MAX - 1 : (size_t) len;
+        stream->dest = (uint8_t *) string->value;
+        stream->dest_remaining = string->length;
+        stream->string = string;
+    } else if (stream->levels[stream->depth].type == MSG_IMAGE && stream->field == 4) {
+        mark_present(stream, stream->field);
+
+        stream->event.data.image.uuid_length = len;
+        stream->dest = stream->event.data.image.uuid;
+        stream->dest_remaining = (len < PLCRASH_REPORT_STREAM_UUID_MAX) ? len : PLCRASH_REPORT_STREAM_UUID_MAX;
+    }
+
+    stream->remaining = len;
+    stream->state = STATE_BYTES;
+
+    if (len == 0) {
+        if (stream->string != NULL)
+            stream->string->value[0] = '\0';
+        return field_done(stream);
+    }
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Initialize a streaming decoder.
+ *
+ * @param stream The decoder to initialize.
+ * @param callback The callback to be invoked for each decoded event.
+ * @param context Context to be passed to @a callback.
+ */
+void plcrash_report_stream_init (plcrash_report_stream_t *stream, plcrash_report_stream_callback_t callback, void *context) {
+    memset(stream, 0, sizeof(*stream));
+    stream->callback = callback;
+    stream->context = context;
+    stream->state = STATE_HEADER;
+    stream->error = PLCRASH_ESUCCESS;
+}
+
+/**
+ * Feed the next @a len bytes of the report file to the decoder. Events are emitted as sections are decoded.
+ *
+ * @param stream The decoder.
+ * @param data The next bytes of the report file, starting with the file header.
+ * @param len The length of @a data.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_ENOTSUP if the file version is not supported, or
+ * PLCRASH_EINVAL if the data is malformed. Once an error has been returned, all further calls will return
+ * the same error.
+ */
+plcrash_error_t plcrash_report_stream_feed (plcrash_report_stream_t *stream, const void *data, size_t len) {
+    const uint8_t *p = data;
+    const uint8_t *end = p + len;
+    plcrash_error_t err;
+
+    if (stream->error != PLCRASH_ESUCCESS)
+        return stream->error;
+
+    while (p < end) {
+        size_t avail = end - p;
+
+        switch (stream->state) {
+            case STATE_HEADER:
+            case STATE_SUMMARY_SIZE: {
+                size_t want = (stream->state == STATE_HEADER) ? STREAM_PREFIX_LEN : STREAM_PREFIX_LEN + STREAM_SUMMARY_SIZE_LEN;
+                size_t n = want - stream->header_len;
+                if (n > avail)
+                    n = avail;
+
+                memcpy(stream->header + stream->header_len, p, n);
+                stream->header_len += n;
+                stream->offset += n;
+                p += n;
+
+                if (stream->header_len < want)
+                    break;
+
+                if (stream->state == STATE_SUMMARY_SIZE) {
+                    const uint8_t *s = stream->header + STREAM_PREFIX_LEN;
+                    uint32_t size = s[0] | (s[1] << 8) | (s[2] << 16) | ((uint32_t) s[3] << 24);
+                    if (size < STREAM_SUMMARY_MIN_SIZE)
+                        return fail(stream, PLCRASH_EINVAL);
+
+                    stream->remaining = size - STREAM_SUMMARY_SIZE_LEN;
+                    stream->state = STATE_SUMMARY;
+                    break;
+                }
+
+                if (memcmp(stream->header, STREAM_FILE_MAGIC, STREAM_PREFIX_LEN - 1) != 0)
+                    return fail(stream, PLCRASH_EINVAL);
+
+                switch (stream->header[STREAM_PREFIX_LEN - 1]) {
+                    case 1:
+                        begin_report(stream);
+                        break;
+                    case 2:
+                        stream->state = STATE_SUMMARY_SIZE;
+                        break;
+                    default:
+                        return fail(stream, PLCRASH_ENOTSUP);
+                }
+                break;
+            }
+
+            case STATE_SUMMARY: {
+                size_t n = (stream->remaining < avail) ? (size_t) stream->remaining : avail;
+                stream->remaining -= n;
+                stream->offset += n;
+                p += n;
+
+                if (stream->remaining == 0)
+                    begin_report(stream);
+                break;
+            }
+
+            case STATE_KEY:
+            case STATE_VARINT:
+            case STATE_LENGTH: {
+                uint8_t byte = *p++;
+                stream->offset++;
+
+                if (stream->shift < 64)
+                    stream->varint |= (uint64_t) (byte & 0x7F) << stream->shift;
+                stream->shift += 7;
+
+                if (byte & 0x80) {
+                    /* Varints may not exceed 10 bytes */
+                    if (stream->shift >= 70)
+                        return fail(stream, PLCRASH_EINVAL);
+                    break;
+                }
+
+                uint64_t value = stream->varint;
+                stream->varint = 0;
+                stream->shift = 0;
+
+                if (stream->state == STATE_KEY) {
+                    err = handle_key(stream, value);
+                } else if (stream->state == STATE_VARINT) {
+                    apply_varint(stream, stream->field, value);
+                    err = field_done(stream);
+                } else {
+                    err = handle_length(stream, value);
+                }
+
+                if (err != PLCRASH_ESUCCESS)
+                    return err;
+                break;
+            }
+
+            case STATE_BYTES:
+            case STATE_FIXED: {
+                size_t n = (stream->remaining < avail) ? (size_t) stream->remaining : avail;
+
+                if (stream->state == STATE_BYTES && stream->dest_remaining > 0) {
+                    size_t copy = (stream->dest_remaining < n) ? (size_t) stream->dest_remaining : n;
+                    memcpy(stream->dest, p, copy);
+                    stream->dest += copy;
+                    stream->dest_remaining -= copy;
+                }
+
+                stream->remaining -= n;
+                stream->offset += n;
+                p += n;
+
+                if (stream->remaining > 0)
+                    break;
+
+                if (stream->state == STATE_BYTES && stream->string != NULL)
+                    stream->string->value[stream->string->length] = '\0';
+
+                if ((err = field_done(stream)) != PLCRASH_ESUCCESS)
+                    return err;
+                break;
+            }
+
+            case STATE_FAILED:
+                return stream->error;
+        }
+    }
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Read @a fd to end of file, feeding its contents to the decoder. The file is read through a fixed-size buffer.
+ *
+ * @param stream The decoder.
+ * @param fd The file descriptor to read.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINTERNAL if reading fails, or an error returned
+ * by plcrash_report_stream_feed().
+ */
+plcrash_error_t plcrash_report_stream_feed_fd (plcrash_report_stream_t *stream, int fd) {
+    uint8_t buffer[STREAM_READ_BUFFER_SIZE];
+    plcrash_error_t err;
+    ssize_t n;
+
+    for (;;) {
+        n = read(fd, buffer, sizeof(buffer));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return PLCRASH_EINTERNAL;
+        }
+
+        if (n == 0)
+            return PLCRASH_ESUCCESS;
+
+        if ((err = plcrash_report_stream_feed(stream, buffer, n)) != PLCRASH_ESUCCESS)
+            return err;
+    }
+}
+
+/**
+ * Complete decoding, reporting how much of the report was recovered. If the input ended within a thread,
+ * or decoding failed within a thread, a PLCRASH_REPORT_STREAM_THREAD_END event marked as incomplete is emitted.
+ * This function must only be called once.
+ *
+ * @param stream The decoder.
+ * @param status On return, the decoding status.
+ *
+ * @return Returns PLCRASH_ESUCCESS if the report was readable, even if truncated; PLCRASH_EINVAL if the data
+ * is not a crash report, or is malformed; or PLCRASH_ENOTSUP if the file version is not supported. In all
+ * cases, @a status is populated, and events emitted up to status->recovered remain valid.
+ */
+plcrash_error_t plcrash_report_stream_finish (plcrash_report_stream_t *stream, plcrash_report_stream_status_t *status) {
+    bool in_header = (stream->state == STATE_HEADER || stream->state == STATE_SUMMARY_SIZE || stream->state == STATE_SUMMARY);
+
+    status->consumed = stream->offset;
+    status->recovered = stream->recovered;
+    status->complete = (stream->error == PLCRASH_ESUCCESS && !in_header && stream->state == STATE_KEY &&
+                        stream->shift == 0 && stream->depth == 0);
+    status->partial_section = 0;
+
+    if (!status->complete && !in_header) {
+        if (stream->depth > 0) {
+            status->partial_section = stream->levels[1].field;
+        } else if (stream->state != STATE_KEY && stream->state != STATE_FAILED) {
+            status->partial_section = stream->field;
+        }
+    }
+
+    /* Close any partial thread */
+    if (stream->depth > 0 && stream->levels[1].type == MSG_THREAD)
+        emit_thread_end(stream, false);
+    stream->depth = 0;
+
+    if (stream->error != PLCRASH_ESUCCESS)
+        return stream->error;
+
+    if (in_header)
+        return PLCRASH_EINVAL;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * @} plcrash_report_stream
+ */
@@ -0,0 +1,436 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "PLCrashAsync.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_report_stream
+ *
+ * Maximum length of a decoded string, including the NUL terminator. Longer strings are truncated.
+ */
+#define PLCRASH_REPORT_STREAM_STRING_MAX 1024
+
+/**
+ * @internal
+ * @ingroup plcrash_report_stream
+ *
+ * Number of UUID bytes retained for a binary image.
+ */
+#define PLCRASH_REPORT_STREAM_UUID_MAX 16
+
+/**
+ * @internal
+ * @ingroup plcrash_report_stream
+ *
+ * Maximum message nesting depth of crash_report.proto, not including the top-level message.
+ */
+#define PLCRASH_REPORT_STREAM_MAX_DEPTH 2
+
+/**
+ * @internal
+ * @ingroup plcrash_report_stream
+ *
+ * Stream event types.
+ */
+typedef enum {
+    /** System info. Uses plcrash_report_stream_event_t.data.system_info */
+    PLCRASH_REPORT_STREAM_SYSTEM_INFO = 0,
+
+    /** Machine info. Uses plcrash_report_stream_event_t.data.machine_info */
+    PLCRASH_REPORT_STREAM_MACHINE_INFO,
+
+    /** Application info. Uses plcrash_report_stream_event_t.data.app_info */
+    PLCRASH_REPORT_STREAM_APP_INFO,
+
+    /** Process info. Uses plcrash_report_stream_event_t.data.process_info */
+    PLCRASH_REPORT_STREAM_PROCESS_INFO,
+
+    /** Start of a thread. Uses plcrash_report_stream_event_t.data.thread */
+    PLCRASH_REPORT_STREAM_THREAD_BEGIN,
+
+    /** A stack frame of the current thread. Uses plcrash_report_stream_event_t.data.frame */
+    PLCRASH_REPORT_STREAM_FRAME,
+
+    /** A register of the current thread. Uses plcrash_report_stream_event_t.data.reg */
+    PLCRASH_REPORT_STREAM_REGISTER,
+
+    /** End of a thread. Uses plcrash_report_stream_event_t.data.thread */
+    PLCRASH_REPORT_STREAM_THREAD_END,
+
+    /** A binary image. Uses plcrash_report_stream_event_t.data.image */
+    PLCRASH_REPORT_STREAM_IMAGE,
+
+    /** Uncaught exception. Uses plcrash_report_stream_event_t.data.exception */
+    PLCRASH_REPORT_STREAM_EXCEPTION,
+
+    /** Signal. Uses plcrash_report_stream_event_t.data.signal */
+    PLCRASH_REPORT_STREAM_SIGNAL,
+
+    /** Crash handler diagnostics. Uses plcrash_report_stream_event_t.data.handler_info */
+    PLCRASH_REPORT_STREAM_HANDLER_INFO,
+
+    /** A secondary crash. Uses plcrash_report_stream_event_t.data.secondary_crash */
+    PLCRASH_REPORT_STREAM_SECONDARY_CRASH
+} plcrash_report_stream_event_type_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_stream
+ *
+ * A decoded string.
+ */
+typedef struct plcrash_report_stream_string {
+    /** NUL-terminated string value. */
+    char value[PLCRASH_REPORT_STREAM_STRING_MAX];
+
+    /** Length of value, not including the NUL terminator. */
+    size_t length;
+
+    /** True if the encoded string was longer than PLCRASH_REPORT_STREAM_STRING_MAX - 1 bytes, and was truncated. */
+    bool truncated;
+} plcrash_report_stream_string_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_stream
+ *
+ * Processor info (CrashReport.Processor).
+ */
+typedef struct plcrash_report_stream_processor {
+    /** Bitmask of the fields present, indexed by field number. */
+    uint32_t present;
+
+    /** CPU type encoding */
+    uint32_t encoding;
+
+    /** CPU type */
+    uint64_t type;
+
+    /** CPU subtype */
+    uint64_t subtype;
+} plcrash_report_stream_processor_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_stream
+ *
+ * Signal info (CrashReport.Signal).
+ */
+typedef struct plcrash_report_stream_signal {
+    /** Bitmask of the fields present, indexed by field number. */
+    uint32_t present;
+
+    /** Signal name */
+    plcrash_report_stream_string_t name;
+
+    /** Signal code */
+    plcrash_report_stream_string_t code;
+
+    /** Faulting address */
+    uint64_t address;
+} plcrash_report_stream_signal_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_stream
+ *
+ * A single stream event. Field values are only valid for the duration of the event callback.
+ */
+typedef struct plcrash_report_stream_event {
+    /** Event type */
+    plcrash_report_stream_event_type_t type;
+
+    /** File offset of the event's encoded message. */
+    uint64_t offset;
+
+    /** Encoded length of the event's message, in bytes. */
+    uint64_t length;
+
+    /**
+     * Bitmask of the fields present in the event's message, indexed by field number (bit 1 << n is set if field n
+     * was decoded). Required fields may be missing from damaged reports, and should be checked here.
+     */
+    uint32_t present;
+
+    /** Event data */
+    union {
+        /** PLCRASH_REPORT_STREAM_SYSTEM_INFO */
+        struct {
+            uint32_t operating_system;
+            plcrash_report_stream_string_t os_version;
+            uint32_t architecture;
+            int64_t timestamp;
+            plcrash_report_stream_string_t os_build;
+        } system_info;
+
+        /** PLCRASH_REPORT_STREAM_MACHINE_INFO */
+        struct {
+            plcrash_report_stream_string_t model;
+            plcrash_report_stream_processor_t processor;
+            uint32_t processor_count;
+            uint32_t logical_processor_count;
+        } machine_info;
+
+        /** PLCRASH_REPORT_STREAM_APP_INFO */
+        struct {
+            plcrash_report_stream_string_t identifier;
+            plcrash_report_stream_string_t version;
+        } app_info;
+
+        /** PLCRASH_REPORT_STREAM_PROCESS_INFO */
+        struct {
+            plcrash_report_stream_string_t process_name;
+            uint32_t process_id;
+            plcrash_report_stream_string_t process_path;
+            plcrash_report_stream_string_t parent_process_name;
+            uint32_t parent_process_id;
+            bool native;
+        } process_info;
+
+        /** PLCRASH_REPORT_STREAM_THREAD_BEGIN and PLCRASH_REPORT_STREAM_THREAD_END */
+        struct {
+            /** Index of the thread within the report. */
+            uint32_t index;
+
+            /** Thread number. Valid for PLCRASH_REPORT_STREAM_THREAD_END only. */
+            uint32_t number;
+
+            /** True if this is the crashed thread. Valid for PLCRASH_REPORT_STREAM_THREAD_END only. */
+            bool crashed;
+
+            /** Number of frames emitted. Valid for PLCRASH_REPORT_STREAM_THREAD_END only. */
+            uint32_t frame_count;
+
+            /** Number of registers emitted. Valid for PLCRASH_REPORT_STREAM_THREAD_END only. */
+            uint32_t register_count;
+
+            /**
+             * False if the thread was truncated or malformed. Its frames and registers up to that point were
+             * emitted. Valid for PLCRASH_REPORT_STREAM_THREAD_END only.
+             */
+            bool complete;
+        } thread;
+
+        /** PLCRASH_REPORT_STREAM_FRAME */
+        struct {
+            /** Index of the containing thread within the report. */
+            uint32_t thread_index;
+
+            /** Index of the frame within its thread. */
+            uint32_t index;
+
+            /** Instruction pointer */
+            uint64_t pc;
+        } frame;
+
+        /** PLCRASH_REPORT_STREAM_REGISTER */
+        struct {
+            /** Index of the containing thread within the report. */
+            uint32_t thread_index;
+
+            /** Index of the register within its thread. */
+            uint32_t index;
+
+            /** Register name */
+            plcrash_report_stream_string_t name;
+
+            /** Register value */
+            uint64_t value;
+        } reg;
+
+        /** PLCRASH_REPORT_STREAM_IMAGE */
+        struct {
+            uint64_t base_address;
+            uint64_t size;
+            plcrash_report_stream_string_t name;
+
+            /** The first PLCRASH_REPORT_STREAM_UUID_MAX bytes of the UUID. */
+            uint8_t uuid[PLCRASH_REPORT_STREAM_UUID_MAX];
+
+            /** The encoded UUID length. A well-formed UUID is PLCRASH_REPORT_STREAM_UUID_MAX bytes. */
+            uint64_t uuid_length;
+
+            plcrash_report_stream_processor_t code_type;
+        } image;
+
+        /** PLCRASH_REPORT_STREAM_EXCEPTION */
+        struct {
+            plcrash_report_stream_string_t name;
+            plcrash_report_stream_string_t reason;
+        } exception;
+
+        /** PLCRASH_REPORT_STREAM_SIGNAL */
+        plcrash_report_stream_signal_t signal;
+
+        /** PLCRASH_REPORT_STREAM_HANDLER_INFO */
+        struct {
+            uint64_t stack_size;
+            uint64_t stack_used;
+        } handler_info;
+
+        /** PLCRASH_REPORT_STREAM_SECONDARY_CRASH */
+        struct {
+            plcrash_report_stream_signal_t signal;
+            uint64_t pc;
+        } secondary_crash;
+    } data;
+} plcrash_report_stream_event_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_stream
+ *
+ * Stream event callback.
+ *
+ * @param event The decoded event. The event is only valid for the duration of the callback.
+ * @param context The context supplied to plcrash_report_stream_init().
+ */
+typedef void (*plcrash_report_stream_callback_t) (const plcrash_report_stream_event_t *event, void *context);
+
+/**
+ * @internal
+ * @ingroup plcrash_report_stream
+ *
+ * Result of a streaming decode, as returned by plcrash_report_stream_finish().
+ */
+typedef struct plcrash_report_stream_status {
+    /** Total number of bytes consumed. */
+    uint64_t consumed;
+
+    /**
+     * File offset up to which the report was recovered. All top-level sections ending at or before this
+     * offset were fully decoded and emitted.
+     */
+    uint64_t recovered;
+
+    /** True if the input ended cleanly, at the end of a top-level section. */
+    bool complete;
+
+    /**
+     * The field number (as defined in crash_report.proto) of the top-level section that was truncated or
+     * malformed, or 0 if none.
+     */
+    uint32_t partial_section;
+} plcrash_report_stream_status_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_stream
+ *
+ * Streaming decoder state. The decoder's memory use is fixed, and independent of the size of the report.
+ * All fields are private.
+ */
+typedef struct plcrash_report_stream {
+    /** @internal Event callback */
+    plcrash_report_stream_callback_t callback;
+
+    /** @internal Callback context */
+    void *context;
+
+    /** @internal Current parser state */
+    int state;
+
+    /** @internal Number of bytes consumed */
+    uint64_t offset;
+
+    /** @internal End offset of the last complete top-level field */
+    uint64_t recovered;
+
+    /** @internal Error, or PLCRASH_ESUCCESS */
+    plcrash_error_t error;
+
+    /** @internal File header bytes read so far */
+    uint8_t header[12];
+
+    /** @internal Number of valid bytes in header */
+    size_t header_len;
+
+    /** @internal Varint being decoded */
+    uint64_t varint;
+
+    /** @internal Bit shift of the next varint byte */
+    unsigned int shift;
+
+    /** @internal Current field number */
+    uint32_t field;
+
+    /** @internal Bytes remaining in the current length-delimited or fixed-width field */
+    uint64_t remaining;
+
+    /** @internal Destination for the current length-delimited field, or NULL if it is being skipped */
+    uint8_t *dest;
+
+    /** @internal Number of bytes remaining to be copied to dest */
+    uint64_t dest_remaining;
+
+    /** @internal String being decoded, or NULL */
+    plcrash_report_stream_string_t *string;
+
+    /** @internal Open message stack. Level 0 is the top-level message. */
+    struct {
+        /** Message type */
+        int type;
+
+        /** Field number of the message within its parent */
+        uint32_t field;
+
+        /** File offset of the message's encoded payload */
+        uint64_t start;
+
+        /** File offset of the end of the message */
+        uint64_t end;
+
+        /** Nested value being populated (a processor or signal), if any */
+        void *target;
+    } levels[PLCRASH_REPORT_STREAM_MAX_DEPTH + 1];
+
+    /** @internal Index of the innermost open message */
+    unsigned int depth;
+
+    /** @internal Number of threads started */
+    uint32_t thread_count;
+
+    /** @internal Current thread state */
+    uint32_t thread_number;
+    bool thread_crashed;
+    uint32_t frame_count;
+    uint32_t register_count;
+
+    /** @internal Event being decoded */
+    plcrash_report_stream_event_t event;
+} plcrash_report_stream_t;
+
+void plcrash_report_stream_init (plcrash_report_stream_t *stream, plcrash_report_stream_callback_t callback, void *context);
+plcrash_error_t plcrash_report_stream_feed (plcrash_report_stream_t *stream, const void *data, size_t len);
+plcrash_error_t plcrash_report_stream_feed_fd (plcrash_report_stream_t *stream, int fd);
+plcrash_error_t plcrash_report_stream_finish (plcrash_report_stream_t *stream, plcrash_report_stream_status_t *status);
@@ -0,0 +1,318 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+#import "CrashReporter.h"
+#import "PLCrashReportStream.h"
+#import "PLCrashFrameWalker.h"
+#import "PLCrashLogWriter.h"
+
+#import <fcntl.h>
+
+#import <mach-o/dyld.h>
+
+@interface PLCrashReportStreamTests : SenTestCase {
+@private
+    /* Path to crash log */
+    NSString *_logPath;
+
+    /* Test thread */
+    plframe_test_thead_t _thr_args;
+
+    /* Encoded report file */
+    NSData *_data;
+}
+
+@end
+
+/* Maximum number of threads recorded by the test callback */
+#define TEST_MAX_THREADS 128
+
+/* Events recorded by the test callback */
+typedef struct stream_test_events {
+    /* Number of events of each type */
+    NSUInteger counts[PLCRASH_REPORT_STREAM_SECONDARY_CRASH + 1];
+
+    /* Total number of events */
+    NSUInteger total;
+
+    /* Frames recorded per thread, and the PC of each thread's first frame */
+    uint32_t frame_counts[TEST_MAX_THREADS];
+    uint64_t first_pcs[TEST_MAX_THREADS];
+
+    /* Crashed thread number, or UINT32_MAX */
+    uint32_t crashed_thread;
+
+    /* Whether the last THREAD_END was complete */
+    bool last_thread_complete;
+
+    /* Selected values */
+    char signal_name[PLCRASH_REPORT_STREAM_STRING_MAX];
+    char app_identifier[PLCRASH_REPORT_STREAM_STRING_MAX];
+    uint64_t handler_stack_size;
+} stream_test_events_t;
+
+/* Record stream events */
+static void record_event (const plcrash_report_stream_event_t *event, void *context) {
+    stream_test_events_t *events = context;
+
+    events->counts[event->type]++;
+    events->total++;
+
+    switch (event->type) {
+        case PLCRASH_REPORT_STREAM_FRAME:
+            if (event->data.frame.thread_index < TEST_MAX_THREADS) {
+                if (event->data.frame.index == 0)
+                    events->first_pcs[event->data.frame.thread_index] = event->data.frame.pc;
+                events->frame_counts[event->data.frame.thread_index]++;
+            }
+            break;
+
+        case PLCRASH_REPORT_STREAM_THREAD_END:
+            if (event->data.thread.crashed)
+                events->crashed_thread = event->data.thread.number;
+            events->last_thread_complete = event->data.thread.complete;
+            break;
+
+        case PLCRASH_REPORT_STREAM_SIGNAL:
+            strlcpy(events->signal_name, event->data.signal.name.value, sizeof(events->signal_name));
+            break;
+
+        case PLCRASH_REPORT_STREAM_APP_INFO:
+            strlcpy(events->app_identifier, event->data.app_info.identifier.value, sizeof(events->app_identifier));
+            break;
+
+        case PLCRASH_REPORT_STREAM_HANDLER_INFO:
+            events->handler_stack_size = event->data.handler_info.stack_size;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* Stream len bytes of data to a new decoder in chunk_size pieces */
+static plcrash_error_t stream_report (const uint8_t *data, size_t len, size_t chunk_size, stream_test_events_t *events,
+                                      plcrash_report_stream_status_t *status)
+{
+    plcrash_report_stream_t stream;
+
+    memset(events, 0, sizeof(*events));
+    events->crashed_thread = UINT32_MAX;
+
+    plcrash_report_stream_init(&stream, record_event, events);
+    for (size_t offset = 0; offset < len; offset += chunk_size) {
+        size_t n = (len - offset < chunk_size) ? len - offset : chunk_size;
+        if (plcrash_report_stream_feed(&stream, data + offset, n) != PLCRASH_ESUCCESS)
+            break;
+    }
+
+    return plcrash_report_stream_finish(&stream, status);
+}
+
+@implementation PLCrashReportStreamTests
+
+- (void) setUp {
+    siginfo_t info;
+    plframe_thread_state_t thread_state;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+
+    /* Create a temporary log path */
+    _logPath = [[NSTemporaryDirectory() stringByAppendingString: [[NSProcessInfo processInfo] globallyUniqueString]] retain];
+
+    /* Create the test thread */
+    plframe_test_thread_spawn(&_thr_args);
+
+    /* Initialze faux crash data */
+    {
+        info.si_addr = 0x0;
+        info.si_errno = 0;
+        info.si_pid = getpid();
+        info.si_uid = getuid();
+        info.si_code = SEGV_MAPERR;
+        info.si_signo = SIGSEGV;
+        info.si_status = 0;
+
+        /* Steal the test thread's state for iteration */
+        plframe_thread_state_fetch(&thread_state, pthread_mach_thread_np(_thr_args.thread));
+    }
+
+    /* Write the report */
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    plcrash_log_writer_set_exception(&writer, [NSException exceptionWithName: @"TestException" reason: @"TestReason" userInfo: nil]);
+
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++)
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, pthread_mach_thread_np(_thr_args.thread), &file, &info, &thread_state.uap), @"Crash log failed");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write_handler_info(&writer, &file, 65536, 4096), @"Writing handler info failed");
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+
+    _data = [[NSData dataWithContentsOfFile: _logPath] retain];
+}
+
+- (void) tearDown {
+    NSError *error;
+
+    /* Delete the file */
+    STAssertTrue([[NSFileManager defaultManager] removeItemAtPath: _logPath error: &error], @"Could not remove log file");
+    [_logPath release];
+    [_data release];
+
+    /* Stop the test thread */
+    plframe_test_thread_stop(&_thr_args);
+}
+
+/* Verify that a complete report streams identically to the Objective-C decoder, regardless of chunk size */
+- (void) testStream {
+    NSError *error = nil;
+    PLCrashReport *report = [[[PLCrashReport alloc] initWithData: _data error: &error] autorelease];
+    STAssertNotNil(report, @"Could not decode crash log: %@", error);
+
+    const size_t chunk_sizes[] = { 1, 3, 7, 64, 4096, [_data length] };
+    stream_test_events_t events;
+    plcrash_report_stream_status_t status;
+    NSUInteger total = 0;
+
+    for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
+        STAssertEquals(PLCRASH_ESUCCESS, stream_report([_data bytes], [_data length], chunk_sizes[i], &events, &status), @"Stream failed");
+        STAssertTrue(status.complete, @"Report was not complete");
+        STAssertEquals((uint64_t) [_data length], status.recovered, @"Report was not fully recovered");
+        STAssertEquals((uint32_t) 0, status.partial_section, @"Unexpected partial section");
+
+        /* Every chunk size must produce the same events */
+        if (i > 0)
+            STAssertEquals(total, events.total, @"Event count differs for chunk size %zu", chunk_sizes[i]);
+        total = events.total;
+
+        STAssertEquals((NSUInteger) 1, events.counts[PLCRASH_REPORT_STREAM_SYSTEM_INFO], @"Missing system info");
+        STAssertEquals((NSUInteger) 1, events.counts[PLCRASH_REPORT_STREAM_MACHINE_INFO], @"Missing machine info");
+        STAssertEquals((NSUInteger) 1, events.counts[PLCRASH_REPORT_STREAM_PROCESS_INFO], @"Missing process info");
+        STAssertEquals((NSUInteger) 1, events.counts[PLCRASH_REPORT_STREAM_EXCEPTION], @"Missing exception");
+        STAssertEqualStrings(report.signalInfo.name, [NSString stringWithUTF8String: events.signal_name], @"Incorrect signal");
+        STAssertEqualStrings(report.applicationInfo.applicationIdentifier, [NSString stringWithUTF8String: events.app_identifier], @"Incorrect app identifier");
+        STAssertEquals((uint64_t) 65536, events.handler_stack_size, @"Incorrect handler stack size");
+
+        STAssertEquals([report.threads count], events.counts[PLCRASH_REPORT_STREAM_THREAD_BEGIN], @"Incorrect thread count");
+        STAssertEquals([report.threads count], events.counts[PLCRASH_REPORT_STREAM_THREAD_END], @"Incorrect thread count");
+        STAssertEquals([report.images count], events.counts[PLCRASH_REPORT_STREAM_IMAGE], @"Incorrect image count");
+        STAssertEquals((uint32_t) report.crashedThread.threadNumber, events.crashed_thread, @"Incorrect crashed thread");
+
+        for (NSUInteger t = 0; t < [report.threads count] && t < TEST_MAX_THREADS; t++) {
+            PLCrashReportThreadInfo *thread = [report.threads objectAtIndex: t];
+            STAssertEquals((uint32_t) [thread.stackFrames count], events.frame_counts[t], @"Incorrect frame count");
+            if ([thread.stackFrames count] > 0) {
+                PLCrashReportStackFrameInfo *frame = [thread.stackFrames objectAtIndex: 0];
+                STAssertEquals(frame.instructionPointer, events.first_pcs[t], @"Incorrect PC");
+            }
+        }
+    }
+}
+
+/* Verify that truncated reports are recovered up to the truncation point */
+- (void) testTruncated {
+    const uint8_t *bytes = [_data bytes];
+    size_t len = [_data length];
+    stream_test_events_t events;
+    plcrash_report_stream_status_t status;
+    uint64_t last_recovered = 0;
+
+    for (size_t truncated = 0; truncated < len; truncated++) {
+        plcrash_error_t err = stream_report(bytes, truncated, 256, &events, &status);
+
+        /* A file truncated within its header is not a report */
+        if (status.recovered == 0) {
+            STAssertEquals(PLCRASH_EINVAL, err, @"Truncated header was accepted");
+            continue;
+        }
+
+        STAssertEquals(PLCRASH_ESUCCESS, err, @"Truncated report at %zu was rejected", truncated);
+        STAssertTrue(status.recovered <= truncated, @"Recovered past the end of the data");
+        STAssertTrue(status.recovered >= last_recovered, @"Recovered offset decreased");
+        STAssertEquals((uint64_t) truncated, status.consumed, @"Not all data consumed");
+        if (status.complete)
+            STAssertEquals((uint64_t) truncated, status.recovered, @"Complete report was not fully recovered");
+        else
+            STAssertTrue(status.partial_section != 0 || status.recovered == truncated, @"No partial section reported");
+
+        /* Partial threads are always closed */
+        STAssertEquals(events.counts[PLCRASH_REPORT_STREAM_THREAD_BEGIN], events.counts[PLCRASH_REPORT_STREAM_THREAD_END], @"Unbalanced thread events");
+        if (status.partial_section == 3)
+            STAssertFalse(events.last_thread_complete, @"Partial thread reported as complete");
+
+        last_recovered = status.recovered;
+    }
+
+    /* The signal is written before the threads; a report truncated within the threads is rejected by
+     * PLCrashReport, but its signal is recovered by the stream decoder. */
+    NSError *error = nil;
+    NSData *truncatedData = [_data subdataWithRange: NSMakeRange(0, len - 1)];
+    STAssertNil([[[PLCrashReport alloc] initWithData: truncatedData error: &error] autorelease], @"Truncated report was accepted");
+    STAssertEquals(PLCRASH_ESUCCESS, stream_report([truncatedData bytes], [truncatedData length], 256, &events, &status), @"Stream failed");
+    STAssertFalse(status.complete, @"Truncated report reported as complete");
+    STAssertEqualStrings(@"SIGSEGV", [NSString stringWithUTF8String: events.signal_name], @"Signal was not recovered");
+}
+
+/* Verify that malformed data stops decoding, and that the recovered offset is preserved */
+- (void) testMalformed {
+    stream_test_events_t events;
+    plcrash_report_stream_status_t status;
+
+    /* Bad magic */
+    const uint8_t bad_magic[] = { 'p', 'l', 'c', 'r', 'a', 's', 'x', 1 };
+    STAssertEquals(PLCRASH_EINVAL, stream_report(bad_magic, sizeof(bad_magic), 1, &events, &status), @"Accepted bad magic");
+
+    /* Unsupported version */
+    const uint8_t bad_version[] = { 'p', 'l', 'c', 'r', 'a', 's', 'h', 9 };
+    STAssertEquals(PLCRASH_ENOTSUP, stream_report(bad_version, sizeof(bad_version), 1, &events, &status), @"Accepted bad version");
+
+    /* An empty exception (field 5), followed by a group wire type */
+    const uint8_t bad_field[] = { 'p', 'l', 'c', 'r', 'a', 's', 'h', 1, 0x2A, 0x00, 0x0B };
+    STAssertEquals(PLCRASH_EINVAL, stream_report(bad_field, sizeof(bad_field), 1, &events, &status), @"Accepted bad field");
+    STAssertEquals((uint64_t) 10, status.recovered, @"Incorrect recovered offset");
+    STAssertEquals((NSUInteger) 1, events.counts[PLCRASH_REPORT_STREAM_EXCEPTION], @"Exception was not emitted");
+
+    /* A thread (field 3) containing a frame that overruns the thread */
+    const uint8_t overrun[] = { 'p', 'l', 'c', 'r', 'a', 's', 'h', 1, 0x1A, 0x03, 0x12, 0x03, 0x18, 0x01, 0x00 };
+    STAssertEquals(PLCRASH_EINVAL, stream_report(overrun, sizeof(overrun), 1, &events, &status), @"Accepted overrun");
+    STAssertEquals((uint32_t) 3, status.partial_section, @"Incorrect partial section");
+    STAssertEquals((NSUInteger) 1, events.counts[PLCRASH_REPORT_STREAM_THREAD_END], @"Thread was not closed");
+    STAssertFalse(events.last_thread_complete, @"Malformed thread reported as complete");
+}
+
+@end
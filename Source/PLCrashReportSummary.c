@@ -0,0 +1,203 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PLCrashReportSummary.h"
+
+#include <string.h>
+#include <libkern/OSByteOrder.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_report_summary Crash Report Summary
+ * @ingroup plcrash_internal
+ *
+ * Fixed-layout crash report summary header.
+ *
+ * Starting with file version 2, crash reports include a small fixed-layout header between the file magic/version
+ * and the protobuf-encoded report. The header records the values most often required to list and triage pending
+ * reports -- the crash time, signal, crashed thread, an application version hash, a signature of the crashed
+ * thread's top frames, and the file offsets of the report's top-level sections -- and may be read in constant
+ * time from a memory mapped file, without decoding the report.
+ *
+ * @{
+ */
+
+/** @internal Crash report file magic. Must match PLCRASH_REPORT_FILE_MAGIC. */
+#define PLCRASH_REPORT_SUMMARY_MAGIC "plcrash"
+
+/** @internal Length of the file magic and version byte. */
+#define PLCRASH_REPORT_SUMMARY_PREFIX_LEN (sizeof(PLCRASH_REPORT_SUMMARY_MAGIC) - 1 + sizeof(uint8_t))
+
+/** @internal FNV-1a 64-bit offset basis. */
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+
+/** @internal FNV-1a 64-bit prime. */
+#define FNV_PRIME 0x100000001b3ULL
+
+/**
+ * Return the initial value for plcrash_report_summary_hash().
+ */
+uint64_t plcrash_report_summary_hash_init (void) {
+    return FNV_OFFSET_BASIS;
+}
+
+/**
+ * Update a 64-bit FNV-1a hash with @a len bytes of @a data. This function is async-safe.
+ *
+ * @param hash The current hash value, initially plcrash_report_summary_hash_init().
+ * @param data The data to hash.
+ * @param len The length of @a data.
+ *
+ * @return Returns the updated hash.
+ */
+uint64_t plcrash_report_summary_hash (uint64_t hash, const void *data, size_t len) {
+    const uint8_t *p = data;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/**
+ * Encode @a summary as an on-disk summary header. This function is async-safe.
+ *
+ * @param summary The summary to encode.
+ * @param header The header to populate.
+ */
+void plcrash_report_summary_encode (const plcrash_report_summary_t *summary, plcrash_report_summary_header_t *header) {
+    header->size = OSSwapHostToLittleInt32(sizeof(*header));
+    header->timestamp = OSSwapHostToLittleInt64(summary->timestamp);
+    header->signal = OSSwapHostToLittleInt32(summary->signal);
+    header->crashed_thread = OSSwapHostToLittleInt32(summary->crashed_thread);
+    header->app_version_hash = OSSwapHostToLittleInt64(summary->app_version_hash);
+    header->frames_signature = OSSwapHostToLittleInt64(summary->frames_signature);
+
+    for (int i = 0; i < PLCRASH_REPORT_SECTION_COUNT; i++)
+        header->section_offsets[i] = OSSwapHostToLittleInt32(summary->section_offsets[i]);
+}
+
+/**
+ * @internal
+ * Validate the file magic, returning the file version, or 0 if @a data is not a crash report.
+ */
+static uint8_t report_version (const void *data, size_t len) {
+    if (len < PLCRASH_REPORT_SUMMARY_PREFIX_LEN)
+        return 0;
+
+    if (memcmp(data, PLCRASH_REPORT_SUMMARY_MAGIC, PLCRASH_REPORT_SUMMARY_PREFIX_LEN - 1) != 0)
+        return 0;
+
+    return ((const uint8_t *) data)[PLCRASH_REPORT_SUMMARY_PREFIX_LEN - 1];
+}
+
+/**
+ * Read the summary header of the crash report in @a data. Only the fixed-size header is examined, and the
+ * report itself is not decoded; @a data will generally be a memory mapped report file.
+ *
+ * @param data The crash report file contents.
+ * @param len The length of @a data.
+ * @param summary On success, the decoded summary.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_ENOTSUP if the report predates the summary header,
+ * or PLCRASH_EINVAL if @a data is not a valid crash report.
+ */
+plcrash_error_t plcrash_report_summary_read (const void *data, size_t len, plcrash_report_summary_t *summary) {
+    plcrash_report_summary_header_t header;
+    uint8_t version = report_version(data, len);
+
+    if (version == 0)
+        return PLCRASH_EINVAL;
+
+    if (version < PLCRASH_REPORT_SUMMARY_FILE_VERSION)
+        return PLCRASH_ENOTSUP;
+
+    /* Copy out the header; the mapped header is not necessarily aligned */
+    if (len - PLCRASH_REPORT_SUMMARY_PREFIX_LEN < sizeof(header))
+        return PLCRASH_EINVAL;
+    memcpy(&header, (const uint8_t *) data + PLCRASH_REPORT_SUMMARY_PREFIX_LEN, sizeof(header));
+
+    if (OSSwapLittleToHostInt32(header.size) < sizeof(header))
+        return PLCRASH_EINVAL;
+
+    summary->timestamp = OSSwapLittleToHostInt64(header.timestamp);
+    summary->signal = OSSwapLittleToHostInt32(header.signal);
+    summary->crashed_thread = OSSwapLittleToHostInt32(header.crashed_thread);
+    summary->app_version_hash = OSSwapLittleToHostInt64(header.app_version_hash);
+    summary->frames_signature = OSSwapLittleToHostInt64(header.frames_signature);
+
+    for (int i = 0; i < PLCRASH_REPORT_SECTION_COUNT; i++)
+        summary->section_offsets[i] = OSSwapLittleToHostInt32(header.section_offsets[i]);
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Determine the offset of the encoded report within the crash report file in @a data, skipping the file
+ * header and, if present, the summary header.
+ *
+ * @param data The crash report file contents.
+ * @param len The length of @a data.
+ * @param offset On success, the offset of the encoded report.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_ENOTSUP if the file version is unsupported, or
+ * PLCRASH_EINVAL if @a data is not a valid crash report.
+ */
+plcrash_error_t plcrash_report_data_offset (const void *data, size_t len, size_t *offset) {
+    uint32_t size;
+
+    switch (report_version(data, len)) {
+        case 0:
+            return PLCRASH_EINVAL;
+
+        case 1:
+            *offset = PLCRASH_REPORT_SUMMARY_PREFIX_LEN;
+            return PLCRASH_ESUCCESS;
+
+        case PLCRASH_REPORT_SUMMARY_FILE_VERSION:
+            if (len - PLCRASH_REPORT_SUMMARY_PREFIX_LEN < sizeof(size))
+                return PLCRASH_EINVAL;
+
+            memcpy(&size, (const uint8_t *) data + PLCRASH_REPORT_SUMMARY_PREFIX_LEN, sizeof(size));
+            size = OSSwapLittleToHostInt32(size);
+            if (size < sizeof(plcrash_report_summary_header_t) || size > len - PLCRASH_REPORT_SUMMARY_PREFIX_LEN)
+                return PLCRASH_EINVAL;
+
+            *offset = PLCRASH_REPORT_SUMMARY_PREFIX_LEN + size;
+            return PLCRASH_ESUCCESS;
+
+        default:
+            return PLCRASH_ENOTSUP;
+    }
+}
+
+/**
+ * @} plcrash_report_summary
+ */
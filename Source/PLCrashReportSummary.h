@@ -0,0 +1,151 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "PLCrashAsync.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_report_summary
+ *
+ * The first crash report file version to include a summary header.
+ */
+#define PLCRASH_REPORT_SUMMARY_FILE_VERSION 2
+
+/**
+ * @internal
+ * @ingroup plcrash_report_summary
+ *
+ * Crashed thread index used when the crashed thread was not found.
+ */
+#define PLCRASH_REPORT_SUMMARY_NO_THREAD UINT32_MAX
+
+/**
+ * @internal
+ * @ingroup plcrash_report_summary
+ *
+ * Report sections for which the summary records a file offset.
+ */
+typedef enum {
+    /** System info */
+    PLCRASH_REPORT_SECTION_SYSTEM_INFO = 0,
+
+    /** Machine info */
+    PLCRASH_REPORT_SECTION_MACHINE_INFO,
+
+    /** Application info */
+    PLCRASH_REPORT_SECTION_APP_INFO,
+
+    /** Process info */
+    PLCRASH_REPORT_SECTION_PROCESS_INFO,
+
+    /** The first thread */
+    PLCRASH_REPORT_SECTION_THREADS,
+
+    /** The crashed thread */
+    PLCRASH_REPORT_SECTION_CRASHED_THREAD,
+
+    /** The first binary image */
+    PLCRASH_REPORT_SECTION_BINARY_IMAGES,
+
+    /** Uncaught exception */
+    PLCRASH_REPORT_SECTION_EXCEPTION,
+
+    /** Signal */
+    PLCRASH_REPORT_SECTION_SIGNAL,
+
+    /** Number of sections */
+    PLCRASH_REPORT_SECTION_COUNT
+} plcrash_report_section_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_summary
+ *
+ * On-disk summary header layout. The header immediately follows the file magic and version byte. All
+ * values are little-endian.
+ */
+typedef struct plcrash_report_summary_header {
+    /** Total size of the summary header, in bytes, including this field. Later versions may append fields. */
+    uint32_t size;
+
+    /** Crash timestamp, in seconds since the epoch, or 0 if unknown */
+    int64_t timestamp;
+
+    /** Signal number */
+    int32_t signal;
+
+    /** Index of the crashed thread within the report, or PLCRASH_REPORT_SUMMARY_NO_THREAD */
+    uint32_t crashed_thread;
+
+    /** Hash of the application identifier and version; see plcrash_report_summary_hash() */
+    uint64_t app_version_hash;
+
+    /** Crash signature of the report (see @ref plcrash_report_signature), or 0 if not computed */
+    uint64_t frames_signature;
+
+    /** File offsets of each plcrash_report_section_t, or 0 if the section is absent */
+    uint32_t section_offsets[PLCRASH_REPORT_SECTION_COUNT];
+} __attribute__((packed)) plcrash_report_summary_header_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_summary
+ *
+ * A decoded crash report summary, in host byte order.
+ */
+typedef struct plcrash_report_summary {
+    /** Crash timestamp, in seconds since the epoch, or 0 if unknown */
+    int64_t timestamp;
+
+    /** Signal number */
+    int32_t signal;
+
+    /** Index of the crashed thread within the report, or PLCRASH_REPORT_SUMMARY_NO_THREAD */
+    uint32_t crashed_thread;
+
+    /** Hash of the application identifier and version */
+    uint64_t app_version_hash;
+
+    /** Crash signature of the report, or 0 if not computed */
+    uint64_t frames_signature;
+
+    /** File offsets of each plcrash_report_section_t, or 0 if the section is absent */
+    uint32_t section_offsets[PLCRASH_REPORT_SECTION_COUNT];
+} plcrash_report_summary_t;
+
+uint64_t plcrash_report_summary_hash (uint64_t hash, const void *data, size_t len);
+uint64_t plcrash_report_summary_hash_init (void);
+
+void plcrash_report_summary_encode (const plcrash_report_summary_t *summary, plcrash_report_summary_header_t *header);
+
+plcrash_error_t plcrash_report_summary_read (const void *data, size_t len, plcrash_report_summary_t *summary);
+plcrash_error_t plcrash_report_data_offset (const void *data, size_t len, size_t *offset);
@@ -0,0 +1,114 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+
+#import "PLCrashReportSummary.h"
+
+@interface PLCrashReportSummaryTests : SenTestCase @end
+
+@implementation PLCrashReportSummaryTests
+
+/* Build a version 2 file image containing @a summary, followed by @a trailer bytes of report data */
+static NSMutableData *summary_file (const plcrash_report_summary_t *summary, size_t trailer) {
+    plcrash_report_summary_header_t header;
+    uint8_t version = PLCRASH_REPORT_SUMMARY_FILE_VERSION;
+
+    NSMutableData *data = [NSMutableData dataWithBytes: "plcrash" length: 7];
+    [data appendBytes: &version length: sizeof(version)];
+
+    plcrash_report_summary_encode(summary, &header);
+    [data appendBytes: &header length: sizeof(header)];
+    [data increaseLengthBy: trailer];
+
+    return data;
+}
+
+- (void) testHash {
+    /* FNV-1a reference values */
+    STAssertEquals(0xcbf29ce484222325ULL, plcrash_report_summary_hash(plcrash_report_summary_hash_init(), "", 0), @"Incorrect empty hash");
+    STAssertEquals(0xaf63dc4c8601ec8cULL, plcrash_report_summary_hash(plcrash_report_summary_hash_init(), "a", 1), @"Incorrect hash");
+    STAssertEquals(0x85944171f73967e8ULL, plcrash_report_summary_hash(plcrash_report_summary_hash_init(), "foobar", 6), @"Incorrect hash");
+}
+
+- (void) testRoundTrip {
+    plcrash_report_summary_t summary;
+    plcrash_report_summary_t result;
+    size_t offset;
+
+    memset(&summary, 0, sizeof(summary));
+    summary.timestamp = 1300000000;
+    summary.signal = SIGBUS;
+    summary.crashed_thread = 3;
+    summary.app_version_hash = 0x0102030405060708ULL;
+    summary.frames_signature = 0x1112131415161718ULL;
+    for (int i = 0; i < PLCRASH_REPORT_SECTION_COUNT; i++)
+        summary.section_offsets[i] = 100 + i;
+
+    NSData *data = summary_file(&summary, 16);
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_summary_read([data bytes], [data length], &result), @"Could not read summary");
+    STAssertTrue(memcmp(&summary, &result, sizeof(summary)) == 0, @"Summary did not round trip");
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_data_offset([data bytes], [data length], &offset), @"Could not find report data");
+    STAssertEquals((size_t) [data length] - 16, offset, @"Incorrect report data offset");
+}
+
+- (void) testVersion1 {
+    plcrash_report_summary_t summary;
+    size_t offset;
+    const char v1[] = "plcrash\x01" "data";
+
+    STAssertEquals(PLCRASH_ENOTSUP, plcrash_report_summary_read(v1, sizeof(v1) - 1, &summary), @"Version 1 reports have no summary");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_data_offset(v1, sizeof(v1) - 1, &offset), @"Could not find report data");
+    STAssertEquals((size_t) 8, offset, @"Incorrect version 1 data offset");
+}
+
+- (void) testInvalid {
+    plcrash_report_summary_t summary;
+    size_t offset;
+
+    memset(&summary, 0, sizeof(summary));
+    NSMutableData *data = summary_file(&summary, 0);
+
+    /* Truncated */
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_summary_read([data bytes], [data length] - 1, &summary), @"Truncated summary accepted");
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_data_offset([data bytes], [data length] - 1, &offset), @"Truncated summary accepted");
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_data_offset([data bytes], 4, &offset), @"Truncated magic accepted");
+
+    /* Bad magic */
+    ((uint8_t *) [data mutableBytes])[0] = 'x';
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_summary_read([data bytes], [data length], &summary), @"Bad magic accepted");
+
+    /* Unknown version */
+    ((uint8_t *) [data mutableBytes])[0] = 'p';
+    ((uint8_t *) [data mutableBytes])[7] = 0xFF;
+    STAssertEquals(PLCRASH_ENOTSUP, plcrash_report_data_offset([data bytes], [data length], &offset), @"Unknown version accepted");
+}
+
+@end
@@ -27,15 +27,20 @@
  */
 
 #import "GTMSenTestCase.h"
+#import "CrashReporter.h"
 #import "PLCrashReport.h"
 #import "PLCrashReporter.h"
 #import "PLCrashFrameWalker.h"
 #import "PLCrashLogWriter.h"
+#import "PLCrashLogWriterEncoding.h"
+
+#import "crash_report.pb-c.h"
 
 #import <fcntl.h>
 
 #import <mach-o/arch.h>
 #import <mach-o/dyld.h>
+#import <mach/mach_time.h>
 
 @interface PLCrashReportTests : SenTestCase {
 @private
@@ -48,6 +53,53 @@
 
 @end
 
+/* Benchmark report dimensions. Produces an encoded report of roughly 1MB. */
+#define BENCH_THREAD_COUNT 300
+#define BENCH_FRAME_COUNT 256
+#define BENCH_REGISTER_COUNT 16
+
+/* Write (or, if file is NULL, size) a benchmark register message */
+static size_t write_bench_register (plcrash_async_file_t *file, uint32_t index) {
+    char name[8];
+    uint64_t value = UINT64_MAX - index;
+    size_t rv = 0;
+
+    snprintf(name, sizeof(name), "r%u", index);
+    rv += plcrash_writer_pack(file, 1, PLPROTOBUF_C_TYPE_STRING, name);
+    rv += plcrash_writer_pack(file, 2, PLPROTOBUF_C_TYPE_UINT64, &value);
+    return rv;
+}
+
+/* Write (or, if file is NULL, size) a benchmark frame message */
+static size_t write_bench_frame (plcrash_async_file_t *file, uint32_t index) {
+    uint64_t pc = 0xFFFFFF8000000000ULL + (index * 4);
+    return plcrash_writer_pack(file, 3, PLPROTOBUF_C_TYPE_UINT64, &pc);
+}
+
+/* Write (or, if file is NULL, size) a benchmark thread message */
+static size_t write_bench_thread (plcrash_async_file_t *file, uint32_t number) {
+    size_t rv = 0;
+
+    rv += plcrash_writer_pack(file, 1, PLPROTOBUF_C_TYPE_UINT32, &number);
+
+    for (uint32_t i = 0; i < BENCH_FRAME_COUNT; i++) {
+        uint32_t size = write_bench_frame(NULL, i);
+        rv += plcrash_writer_pack(file, 2, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+        rv += write_bench_frame(file, i);
+    }
+
+    bool crashed = (number == 0);
+    rv += plcrash_writer_pack(file, 3, PLPROTOBUF_C_TYPE_BOOL, &crashed);
+
+    for (uint32_t i = 0; i < BENCH_REGISTER_COUNT; i++) {
+        uint32_t size = write_bench_register(NULL, i);
+        rv += plcrash_writer_pack(file, 4, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+        rv += write_bench_register(file, i);
+    }
+
+    return rv;
+}
+
 @implementation PLCrashReportTests
 
 - (void) setUp {
@@ -71,7 +123,7 @@
 
 - (void) testWriteReport {
     siginfo_t info;
-    plframe_cursor_t cursor;
+    plframe_thread_state_t thread_state;
     plcrash_log_writer_t writer;
     plcrash_async_file_t file;
     NSError *error = nil;
@@ -86,8 +138,8 @@
         info.si_signo = SIGSEGV;
         info.si_status = 0;
         
-        /* Steal the test thread's stack for iteration */
-        plframe_cursor_thread_init(&cursor, pthread_mach_thread_np(_thr_args.thread));
+        /* Steal the test thread's state for iteration */
+        plframe_thread_state_fetch(&thread_state, pthread_mach_thread_np(_thr_args.thread));
     }
     
     /* Open the output file */
@@ -107,7 +159,9 @@
     }            
 
     /* Write the crash report */
-    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, &file, &info, cursor.uap), @"Crash log failed");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, pthread_mach_thread_np(_thr_args.thread), &file, &info, &thread_state.uap), @"Crash log failed");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write_secondary_crash(&writer, &file, &info, 0x42), @"Writing secondary crash failed");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write_handler_info(&writer, &file, 65536, 4096), @"Writing handler info failed");
     
     /* Close it */
     plcrash_log_writer_close(&writer);
@@ -166,6 +220,20 @@
         STAssertNotNil(threadInfo.registers, @"Thread register list is nil");
         STAssertEquals((NSInteger)thrNumber, threadInfo.threadNumber, @"Threads are listed out of order.");
 
+        /* The bulk accessors must match the vended objects */
+        STAssertEquals([threadInfo.stackFrames count], threadInfo.stackFrameCount, @"Incorrect frame count");
+        for (NSUInteger i = 0; i < threadInfo.stackFrameCount; i++) {
+            PLCrashReportStackFrameInfo *frameInfo = [threadInfo.stackFrames objectAtIndex: i];
+            STAssertEquals(frameInfo.instructionPointer, [threadInfo instructionPointerAtIndex: i], @"Incorrect instruction pointer");
+        }
+
+        STAssertEquals([threadInfo.registers count], threadInfo.registerCount, @"Incorrect register count");
+        for (NSUInteger i = 0; i < threadInfo.registerCount; i++) {
+            PLCrashReportRegisterInfo *registerInfo = [threadInfo.registers objectAtIndex: i];
+            STAssertEqualStrings(registerInfo.registerName, [threadInfo registerNameAtIndex: i], @"Incorrect register name");
+            STAssertEquals(registerInfo.registerValue, [threadInfo registerValueAtIndex: i], @"Incorrect register value");
+        }
+
         if (threadInfo.crashed) {
             STAssertNotEquals((NSUInteger)0, [threadInfo.registers count], @"No registers recorded for the crashed thread");
             for (PLCrashReportRegisterInfo *registerInfo in threadInfo.registers) {
@@ -178,6 +246,26 @@
     }
     STAssertTrue(crashedFound, @"No crashed thread was found in the crash log");
 
+    /* Crashed thread. Decode from a fresh instance, so that only the crashed thread is decoded. */
+    PLCrashReport *lazyLog = [[[PLCrashReport alloc] initWithData: [NSData dataWithContentsOfMappedFile: _logPath] error: &error] autorelease];
+    STAssertNotNil(lazyLog, @"Could not decode crash log: %@", error);
+    STAssertNotNil(lazyLog.crashedThread, @"No crashed thread was found in the crash log");
+    STAssertTrue(lazyLog.crashedThread.crashed, @"Returned thread did not crash");
+    STAssertNotEquals((NSUInteger)0, [lazyLog.crashedThread.registers count], @"No registers recorded for the crashed thread");
+    STAssertEquals(lazyLog.crashedThread.threadNumber, crashLog.crashedThread.threadNumber, @"Crashed thread differs from the fully decoded report");
+    STAssertTrue(lazyLog.crashedThread == lazyLog.crashedThread, @"Crashed thread was not cached");
+
+    /* Handler info */
+    STAssertTrue(crashLog.hasHandlerInfo, @"No handler information available");
+    STAssertEquals((uint64_t) 65536, crashLog.handlerInfo.stackSize, @"Incorrect handler stack size");
+    STAssertEquals((uint64_t) 4096, crashLog.handlerInfo.stackUsed, @"Incorrect handler stack usage");
+
+    /* Secondary crashes */
+    STAssertEquals((NSUInteger) 1, [crashLog.secondaryCrashes count], @"Incorrect secondary crash count");
+    PLCrashReportSecondaryCrashInfo *secondary = [crashLog.secondaryCrashes objectAtIndex: 0];
+    STAssertEqualStrings(@"SIGSEGV", secondary.signalInfo.name, @"Incorrect secondary crash signal name");
+    STAssertEquals((uint64_t) 0x42, secondary.programCounter, @"Incorrect secondary crash PC");
+
     /* Image info */
     STAssertNotEquals((NSUInteger)0, [crashLog.images count], @"Crash log should contain at least one image");
     for (PLCrashReportBinaryImageInfo *imageInfo in crashLog.images) {
@@ -191,5 +279,153 @@
     }
 }
 
+/**
+ * Verify that structurally invalid reports, and reports missing required sections, are rejected at
+ * initialization.
+ */
+- (void) testInvalidReport {
+    NSError *error = nil;
+    PLCrashReport *report;
+
+    /* Magic and version, followed by a system_info field whose length exceeds the available data */
+    const uint8_t truncated[] = { 'p', 'l', 'c', 'r', 'a', 's', 'h', 1, 0x0A, 0x7F, 0x00 };
+    STAssertTrue([[NSData dataWithBytes: truncated length: sizeof(truncated)] writeToFile: _logPath atomically: NO], @"Could not write test data");
+
+    report = [[[PLCrashReport alloc] initWithData: [NSData dataWithContentsOfFile: _logPath] error: &error] autorelease];
+    STAssertNil(report, @"Truncated report was accepted");
+    STAssertEquals((NSInteger) PLCrashReporterErrorCrashReportInvalid, [error code], @"Incorrect error code");
+
+    /* A well-formed, empty system_info field, with all other required sections missing */
+    const uint8_t incomplete[] = { 'p', 'l', 'c', 'r', 'a', 's', 'h', 1, 0x0A, 0x00 };
+    error = nil;
+    report = [[[PLCrashReport alloc] initWithData: [NSData dataWithBytes: incomplete length: sizeof(incomplete)] error: &error] autorelease];
+    STAssertNil(report, @"Incomplete report was accepted");
+    STAssertEquals((NSInteger) PLCrashReporterErrorCrashReportInvalid, [error code], @"Incorrect error code");
+}
+
+/* Verify the packed thread storage and its bulk accessors */
+- (void) testThreadInfo {
+    const uint64_t pcs[] = { 0x1000, 0x2000, 0x3000 };
+    const char *names[] = { "r0", "sp", "pc" };
+    const uint64_t values[] = { 1, 2, UINT64_MAX };
+    uint64_t buffer[3];
+
+    PLCrashReportThreadInfo *thread = [[[PLCrashReportThreadInfo alloc] initWithThreadNumber: 7
+                                                                         instructionPointers: pcs
+                                                                             stackFrameCount: 3
+                                                                                     crashed: YES
+                                                                               registerNames: names
+                                                                              registerValues: values
+                                                                               registerCount: 3] autorelease];
+    STAssertNotNil(thread, @"Could not create thread info");
+    STAssertEquals((NSInteger) 7, thread.threadNumber, @"Incorrect thread number");
+    STAssertTrue(thread.crashed, @"Thread should be marked as crashed");
+
+    /* Frames */
+    STAssertEquals((NSUInteger) 3, thread.stackFrameCount, @"Incorrect frame count");
+    STAssertEquals((uint64_t) 0x2000, [thread instructionPointerAtIndex: 1], @"Incorrect instruction pointer");
+    [thread getInstructionPointers: buffer range: NSMakeRange(1, 2)];
+    STAssertEquals((uint64_t) 0x2000, buffer[0], @"Incorrect instruction pointer");
+    STAssertEquals((uint64_t) 0x3000, buffer[1], @"Incorrect instruction pointer");
+    STAssertThrows([thread instructionPointerAtIndex: 3], @"Out of range frame index was accepted");
+    STAssertThrows([thread getInstructionPointers: buffer range: NSMakeRange(2, 2)], @"Out of range frame range was accepted");
+
+    /* Registers */
+    STAssertEquals((NSUInteger) 3, thread.registerCount, @"Incorrect register count");
+    STAssertEqualStrings(@"sp", [thread registerNameAtIndex: 1], @"Incorrect register name");
+    STAssertEquals(UINT64_MAX, [thread registerValueAtIndex: 2], @"Incorrect register value");
+    [thread getRegisterValues: buffer range: NSMakeRange(0, 3)];
+    STAssertEquals((uint64_t) 1, buffer[0], @"Incorrect register value");
+    STAssertThrows([thread registerNameAtIndex: 3], @"Out of range register index was accepted");
+
+    /* Legacy objects are created on first access, and cached */
+    NSArray *frames = thread.stackFrames;
+    STAssertEquals((NSUInteger) 3, [frames count], @"Incorrect frame count");
+    STAssertEquals((uint64_t) 0x3000, [(PLCrashReportStackFrameInfo *) [frames objectAtIndex: 2] instructionPointer], @"Incorrect instruction pointer");
+    STAssertTrue(frames == thread.stackFrames, @"Frames were not cached");
+
+    PLCrashReportRegisterInfo *reg = [thread.registers objectAtIndex: 0];
+    STAssertEqualStrings(@"r0", reg.registerName, @"Incorrect register name");
+    STAssertEquals((uint64_t) 1, reg.registerValue, @"Incorrect register value");
+
+    /* The object-based initializer populates the packed storage */
+    PLCrashReportThreadInfo *legacy = [[[PLCrashReportThreadInfo alloc] initWithThreadNumber: 1
+                                                                                 stackFrames: thread.stackFrames
+                                                                                     crashed: NO
+                                                                                   registers: thread.registers] autorelease];
+    STAssertEquals((NSUInteger) 3, legacy.stackFrameCount, @"Incorrect frame count");
+    STAssertEquals((uint64_t) 0x1000, [legacy instructionPointerAtIndex: 0], @"Incorrect instruction pointer");
+    STAssertEqualStrings(@"pc", [legacy registerNameAtIndex: 2], @"Incorrect register name");
+
+    /* An empty thread */
+    PLCrashReportThreadInfo *empty = [[[PLCrashReportThreadInfo alloc] initWithThreadNumber: 0
+                                                                        instructionPointers: NULL
+                                                                            stackFrameCount: 0
+                                                                                    crashed: NO
+                                                                              registerNames: NULL
+                                                                             registerValues: NULL
+                                                                              registerCount: 0] autorelease];
+    STAssertEquals((NSUInteger) 0, [empty.stackFrames count], @"Unexpected frames");
+    STAssertEquals((NSUInteger) 0, [empty.registers count], @"Unexpected registers");
+}
+
+/* Compare unpack-and-free throughput of a 1MB, 300 thread report using the system allocator against the arena
+ * allocator. */
+- (void) testDecodeAllocatorPerformance {
+    const int iterations = 20;
+    plcrash_async_file_t file;
+    mach_timebase_info_data_t timebase;
+
+    /* Write the report message */
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    STAssertTrue(fd >= 0, @"Could not open output file");
+    plcrash_async_file_init(&file, fd, 0);
+
+    for (uint32_t i = 0; i < BENCH_THREAD_COUNT; i++) {
+        uint32_t size = write_bench_thread(NULL, i);
+        plcrash_writer_pack(&file, 3, PLPROTOBUF_C_TYPE_MESSAGE, &size);
+        write_bench_thread(&file, i);
+    }
+
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+
+    NSData *data = [NSData dataWithContentsOfFile: _logPath];
+    const uint8_t *bytes = [data bytes];
+    size_t len = [data length];
+
+    mach_timebase_info(&timebase);
+
+    /* System allocator */
+    uint64_t system_total = 0;
+    for (int i = 0; i < iterations; i++) {
+        uint64_t start = mach_absolute_time();
+        Plcrash__CrashReport *report = plcrash__crash_report__unpack(&protobuf_c_system_allocator, len, bytes);
+        STAssertNotNULL(report, @"Could not decode report");
+        STAssertEquals((size_t) BENCH_THREAD_COUNT, report->n_threads, @"Incorrect thread count");
+        protobuf_c_message_free_unpacked((ProtobufCMessage *) report, &protobuf_c_system_allocator);
+        system_total += mach_absolute_time() - start;
+    }
+
+    /* Arena allocator */
+    uint64_t arena_total = 0;
+    for (int i = 0; i < iterations; i++) {
+        uint64_t start = mach_absolute_time();
+        ProtobufCArena arena;
+        protobuf_c_arena_init(&arena, len);
+        Plcrash__CrashReport *report = plcrash__crash_report__unpack(&arena.allocator, len, bytes);
+        STAssertNotNULL(report, @"Could not decode report");
+        STAssertEquals((size_t) BENCH_THREAD_COUNT, report->n_threads, @"Incorrect thread count");
+        protobuf_c_arena_destroy(&arena);
+        arena_total += mach_absolute_time() - start;
+    }
+
+    uint64_t system_us = (system_total * timebase.numer / timebase.denom) / iterations / 1000;
+    uint64_t arena_us = (arena_total * timebase.numer / timebase.denom) / iterations / 1000;
+    NSLog(@"Decode and free: bytes=%zu threads=%u system=%llu us (%.1f MB/s) arena=%llu us (%.1f MB/s)",
+          len, BENCH_THREAD_COUNT,
+          system_us, system_us ? (len / (double) system_us) : 0.0,
+          arena_us, arena_us ? (len / (double) arena_us) : 0.0);
+}
 
 @end
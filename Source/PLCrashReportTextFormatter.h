@@ -53,10 +53,14 @@ typedef enum {
 
     /** Encoding to use for string output. */
     NSStringEncoding _stringEncoding;
+
+    /** Symbol cache used to symbolicate stack frames, or NULL. */
+    struct plcrash_symbol_cache *_symbolCache;
 }
 
 + (NSString *) stringValueForCrashReport: (PLCrashReport *) report withTextFormat: (PLCrashReportTextFormat) textFormat;
 
 - (id) initWithTextFormat: (PLCrashReportTextFormat) textFormat stringEncoding: (NSStringEncoding) stringEncoding;
+- (id) initWithTextFormat: (PLCrashReportTextFormat) textFormat stringEncoding: (NSStringEncoding) stringEncoding symbolCachePath: (NSString *) symbolCachePath;
 
 @end
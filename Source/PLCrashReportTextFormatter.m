@@ -32,12 +32,48 @@
 #import "CrashReporter/CrashReporter.h"
 
 #import "PLCrashReportTextFormatter.h"
+#import "PLCrashSymbolCache.h"
 
 
 @interface PLCrashReportTextFormatter (PrivateAPI)
 NSInteger binaryImageSort(id binary1, id binary2, void *context);
++ (NSString *) stringValueForCrashReport: (PLCrashReport *) report withTextFormat: (PLCrashReportTextFormat) textFormat
+                             symbolCache: (plcrash_symbol_cache_t *) symbolCache;
 @end
 
+/**
+ * @internal
+ *
+ * Parse the hex string representation of an image UUID, as returned by PLCrashReportBinaryImageInfo.imageUUID.
+ */
+static BOOL parse_image_uuid (NSString *string, uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN]) {
+    const char *str = [string UTF8String];
+
+    if (str == NULL || strlen(str) != PLCRASH_SYMBOL_INDEX_UUID_LEN * 2)
+        return NO;
+
+    for (size_t i = 0; i < PLCRASH_SYMBOL_INDEX_UUID_LEN * 2; i++) {
+        char c = str[i];
+        uint8_t nibble;
+
+        if (c >= '0' && c <= '9')
+            nibble = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            nibble = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            nibble = c - 'A' + 10;
+        else
+            return NO;
+
+        if (i % 2 == 0)
+            uuid[i / 2] = nibble << 4;
+        else
+            uuid[i / 2] |= nibble;
+    }
+
+    return YES;
+}
+
 
 /**
  * Formats PLCrashReport data as human-readable text.
@@ -55,6 +91,24 @@ NSInteger binaryImageSort(id binary1, id binary2, void *context);
  * @return Returns the formatted result on success, or nil if an error occurs.
  */
 + (NSString *) stringValueForCrashReport: (PLCrashReport *) report withTextFormat: (PLCrashReportTextFormat) textFormat {
+    return [self stringValueForCrashReport: report withTextFormat: textFormat symbolCache: NULL];
+}
+
+/**
+ * @internal
+ *
+ * Formats the provided @a report as human-readable text in the given @a textFormat, symbolicating stack frames
+ * using @a symbolCache.
+ *
+ * @param report The report to format.
+ * @param textFormat The text format to use.
+ * @param symbolCache The symbol cache to use, or NULL to disable symbolication.
+ *
+ * @return Returns the formatted result on success, or nil if an error occurs.
+ */
++ (NSString *) stringValueForCrashReport: (PLCrashReport *) report withTextFormat: (PLCrashReportTextFormat) textFormat
+                             symbolCache: (plcrash_symbol_cache_t *) symbolCache
+{
 	NSMutableString* text = [NSMutableString string];
 	boolean_t lp64;
     
@@ -185,8 +239,9 @@ NSInteger binaryImageSort(id binary1, id binary2, void *context);
         } else {
             [text appendFormat: @"Thread %ld:\n", (long) thread.threadNumber];
         }
-        for (NSUInteger frame_idx = 0; frame_idx < [thread.stackFrames count]; frame_idx++) {
-            PLCrashReportStackFrameInfo *frameInfo = [thread.stackFrames objectAtIndex: frame_idx];
+        NSUInteger frameCount = thread.stackFrameCount;
+        for (NSUInteger frame_idx = 0; frame_idx < frameCount; frame_idx++) {
+            uint64_t instructionPointer = [thread instructionPointerAtIndex: frame_idx];
             PLCrashReportBinaryImageInfo *imageInfo;
             
             /* Base image address containing instrumention pointer, offset of the IP from that base
@@ -194,16 +249,40 @@ NSInteger binaryImageSort(id binary1, id binary2, void *context);
             uint64_t baseAddress = 0x0;
             uint64_t pcOffset = 0x0;
             NSString *imageName = @"\?\?\?";
+            uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+            plcrash_symbol_t symbol;
             
-            imageInfo = [report imageForAddress: frameInfo.instructionPointer];
+            imageInfo = [report imageForAddress: instructionPointer];
             if (imageInfo != nil) {
                 imageName = [imageInfo.imageName lastPathComponent];
                 baseAddress = imageInfo.imageBaseAddress;
-                pcOffset = frameInfo.instructionPointer - imageInfo.imageBaseAddress;
+                pcOffset = instructionPointer - imageInfo.imageBaseAddress;
+            }
+            
+            /* Symbolicate the frame, if the image's symbols are cached */
+            if (symbolCache != NULL && imageInfo.hasImageUUID && parse_image_uuid(imageInfo.imageUUID, uuid) &&
+                plcrash_symbol_cache_lookup(symbolCache, uuid, pcOffset, &symbol))
+            {
+                [text appendFormat: @"%-4ld%-36s0x%08" PRIx64 " %s + %" PRIu64,
+                        (long) frame_idx, [imageName UTF8String], instructionPointer, symbol.name, symbol.offset];
+
+                if (symbol.file[0] != '\0')
+                    [text appendFormat: @" (%@:%" PRIu32 ")", [[NSString stringWithUTF8String: symbol.file] lastPathComponent], symbol.line];
+
+                [text appendString: @"\n"];
+                continue;
+            }
+
+            /* Otherwise, fall back on the symbol recorded in-process at crash time */
+            NSString *symbolName = [thread symbolNameAtIndex: frame_idx];
+            if (symbolName != nil) {
+                [text appendFormat: @"%-4ld%-36s0x%08" PRIx64 " %@ + %" PRIu64 "\n",
+                        (long) frame_idx, [imageName UTF8String], instructionPointer, symbolName, [thread symbolOffsetAtIndex: frame_idx]];
+                continue;
             }
             
             [text appendFormat: @"%-4ld%-36s0x%08" PRIx64 " 0x%" PRIx64 " + %" PRId64 "\n", 
-                    (long) frame_idx, [imageName UTF8String], frameInfo.instructionPointer, baseAddress, pcOffset];
+                    (long) frame_idx, [imageName UTF8String], instructionPointer, baseAddress, pcOffset];
         }
         [text appendString: @"\n"];
     }
@@ -213,7 +292,8 @@ NSInteger binaryImageSort(id binary1, id binary2, void *context);
         [text appendFormat: @"Thread %ld crashed with %@ Thread State:\n", (long) crashed_thread.threadNumber, codeType];
         
         int regColumn = 1;
-        for (PLCrashReportRegisterInfo *reg in crashed_thread.registers) {
+        NSUInteger registerCount = crashed_thread.registerCount;
+        for (NSUInteger reg_idx = 0; reg_idx < registerCount; reg_idx++) {
             NSString *reg_fmt;
             
             /* Use 32-bit or 64-bit fixed width format for the register values */
@@ -222,7 +302,7 @@ NSInteger binaryImageSort(id binary1, id binary2, void *context);
             else
                 reg_fmt = @"%6s:\t0x%08" PRIx64 " ";
             
-            [text appendFormat: reg_fmt, [reg.registerName UTF8String], reg.registerValue];
+            [text appendFormat: reg_fmt, [[crashed_thread registerNameAtIndex: reg_idx] UTF8String], [crashed_thread registerValueAtIndex: reg_idx]];
             
             if (regColumn % 4 == 0)
                 [text appendString: @"\n"];
@@ -274,9 +354,48 @@ NSInteger binaryImageSort(id binary1, id binary2, void *context);
     return self;
 }
 
+/**
+ * Initialize with the request string encoding and output format, symbolicating stack frames using the symbol
+ * cache at @a symbolCachePath.
+ *
+ * Stack frames within images whose symbols have been cached (for example, by the plcrashutil symbolicate command)
+ * are formatted as "<symbol> + <offset>", followed by the source file and line if the image's DWARF line information
+ * is available.
+ *
+ * @param textFormat Format to use for the generated text crash report.
+ * @param stringEncoding Encoding to use when writing to the output stream.
+ * @param symbolCachePath Path to the symbol cache directory. The directory will be created if it does not exist.
+ *
+ * @return Returns nil if the symbol cache could not be opened.
+ */
+- (id) initWithTextFormat: (PLCrashReportTextFormat) textFormat stringEncoding: (NSStringEncoding) stringEncoding symbolCachePath: (NSString *) symbolCachePath {
+    if ((self = [self initWithTextFormat: textFormat stringEncoding: stringEncoding]) == nil)
+        return nil;
+
+    _symbolCache = malloc(sizeof(*_symbolCache));
+    if (_symbolCache == NULL || plcrash_symbol_cache_init(_symbolCache, [symbolCachePath fileSystemRepresentation]) != PLCRASH_ESUCCESS) {
+        free(_symbolCache);
+        _symbolCache = NULL;
+
+        [self release];
+        return nil;
+    }
+
+    return self;
+}
+
+- (void) dealloc {
+    if (_symbolCache != NULL) {
+        plcrash_symbol_cache_free(_symbolCache);
+        free(_symbolCache);
+    }
+
+    [super dealloc];
+}
+
 // from PLCrashReportFormatter protocol
 - (NSData *) formatReport: (PLCrashReport *) report error: (NSError **) outError {
-    NSString *text = [PLCrashReportTextFormatter stringValueForCrashReport: report withTextFormat: _textFormat];
+    NSString *text = [PLCrashReportTextFormatter stringValueForCrashReport: report withTextFormat: _textFormat symbolCache: _symbolCache];
     return [text dataUsingEncoding: _stringEncoding allowLossyConversion: YES];
 }
 		 
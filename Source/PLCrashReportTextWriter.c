@@ -0,0 +1,856 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashReportTextWriter.h"
+#import "PLCrashReportImageIndex.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_report_text_writer Crash Report Text Writer
+ * @ingroup plcrash_internal
+ *
+ * Streaming plain C crash report text formatting.
+ *
+ * plcrash_report_text_write() formats a decoded report directly into a fixed-size buffer or a file descriptor,
+ * producing output that is byte-for-byte identical to the UTF-8 encoding of PLCrashReportTextFormatter's output for
+ * the same report. No Foundation objects are created; numbers are formatted by hand rather than through printf-style
+ * format parsing, and the report's threads and images are each unpacked into a single arena.
+ *
+ * If a symbol cache is supplied (see plcrash_report_text_writer_set_symbol_cache()), stack frames are symbolicated
+ * using the cached symbol index and DWARF line information of each image.
+ *
+ * @{
+ */
+
+/** @internal Placeholder for unknown values. */
+#define UNKNOWN_STRING "???"
+
+/** @internal Output of a nil object in PLCrashReportTextFormatter. */
+#define NIL_STRING "(null)"
+
+/** @internal Length of a binary image UUID. */
+#define IMAGE_UUID_LEN 16
+
+/**
+ * @internal
+ *
+ * Decoded state required to format a report.
+ */
+typedef struct text_report {
+    /** The report decoder */
+    const plcrash_report_decoder_t *decoder;
+
+    /** Arena holding all decoded sections */
+    ProtobufCArena arena;
+
+    /** Decoded threads, or NULL if the threads could not be decoded */
+    Plcrash__CrashReport__Thread **threads;
+
+    /** Number of entries in threads */
+    size_t thread_count;
+
+    /** Decoded images, or NULL if the images could not be decoded */
+    Plcrash__CrashReport__BinaryImage **images;
+
+    /** Number of entries in images */
+    size_t image_count;
+
+    /** Image indices, ordered by base address */
+    size_t *sorted_images;
+
+    /** Address index of images. Only valid if has_image_index is true. */
+    plcrash_report_image_index_t image_index;
+
+    /** If true, image_index has been initialized */
+    bool has_image_index;
+} text_report_t;
+
+/**
+ * Initialize @a writer to write to @a buffer. If the output does not fit, it is truncated, and the writer's total
+ * member provides the length required. The output is NUL terminated if space permits.
+ *
+ * @param writer The writer to initialize.
+ * @param buffer The output buffer.
+ * @param size The size of @a buffer, in bytes.
+ */
+void plcrash_report_text_writer_init_buffer (plcrash_report_text_writer_t *writer, char *buffer, size_t size) {
+    writer->fd = -1;
+    writer->buffer = buffer;
+    writer->size = size;
+    writer->used = 0;
+    writer->total = 0;
+    writer->failed = false;
+    writer->symbol_cache = NULL;
+    writer->frame_count = 0;
+    writer->symbolicated_count = 0;
+}
+
+/**
+ * Initialize @a writer to write to @a fd. Output is buffered; plcrash_report_text_write() flushes all output before
+ * returning.
+ *
+ * @param writer The writer to initialize.
+ * @param fd The file descriptor to write to. The descriptor is not closed by the writer.
+ */
+void plcrash_report_text_writer_init_fd (plcrash_report_text_writer_t *writer, int fd) {
+    writer->fd = fd;
+    writer->buffer = writer->storage;
+    writer->size = sizeof(writer->storage);
+    writer->used = 0;
+    writer->total = 0;
+    writer->failed = false;
+    writer->symbol_cache = NULL;
+    writer->frame_count = 0;
+    writer->symbolicated_count = 0;
+}
+
+/**
+ * Symbolicate stack frames using the symbol indexes of @a cache. Frames for which a symbol is found are written as
+ * "<pc> <symbol> + <offset>", rather than relative to the image base address, followed by " (<file>:<line>)" if the
+ * source line is known. The output matches that of a PLCrashReportTextFormatter using the same cache directory.
+ *
+ * @param writer The writer.
+ * @param cache The symbol cache to use, or NULL to disable symbolication. The cache must remain valid for the lifetime
+ * of the writer.
+ */
+void plcrash_report_text_writer_set_symbol_cache (plcrash_report_text_writer_t *writer, plcrash_symbol_cache_t *cache) {
+    writer->symbol_cache = cache;
+}
+
+/**
+ * Write any buffered output. If writing to a caller-supplied buffer, NUL terminates the output if space permits.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_OUTPUT_ERR if a write to the file descriptor failed, or
+ * PLCRASH_ENOMEM if the output did not fit in the caller-supplied buffer.
+ */
+plcrash_error_t plcrash_report_text_writer_flush (plcrash_report_text_writer_t *writer) {
+    if (writer->fd < 0) {
+        if (writer->used < writer->size)
+            writer->buffer[writer->used] = '\0';
+        return writer->failed ? PLCRASH_ENOMEM : PLCRASH_ESUCCESS;
+    }
+
+    size_t written = 0;
+    while (written < writer->used && !writer->failed) {
+        ssize_t rv = write(writer->fd, writer->buffer + written, writer->used - written);
+        if (rv > 0) {
+            written += rv;
+        } else if (rv == 0 || errno != EINTR) {
+            writer->failed = true;
+        }
+    }
+
+    writer->used = 0;
+    return writer->failed ? PLCRASH_OUTPUT_ERR : PLCRASH_ESUCCESS;
+}
+
+/**
+ * @internal
+ *
+ * Append @a len bytes of @a data to the output.
+ */
+static void put (plcrash_report_text_writer_t *writer, const char *data, size_t len) {
+    writer->total += len;
+
+    while (len > 0) {
+        size_t avail = writer->size - writer->used;
+        if (avail == 0) {
+            /* Drain to the descriptor, or discard the remainder of the output */
+            if (writer->fd < 0 || writer->failed) {
+                writer->failed = true;
+                return;
+            }
+
+            plcrash_report_text_writer_flush(writer);
+            continue;
+        }
+
+        size_t n = (len < avail) ? len : avail;
+        memcpy(writer->buffer + writer->used, data, n);
+        writer->used += n;
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * @internal
+ *
+ * Append a NUL-terminated string, or NIL_STRING if @a str is NULL.
+ */
+static void put_str (plcrash_report_text_writer_t *writer, const char *str) {
+    if (str == NULL)
+        str = NIL_STRING;
+    put(writer, str, strlen(str));
+}
+
+/**
+ * @internal
+ *
+ * Append @a str, left-justified and padded with spaces to at least @a width bytes.
+ */
+static void put_padded (plcrash_report_text_writer_t *writer, const char *str, size_t len, size_t width) {
+    static const char spaces[] = "                                        ";
+
+    put(writer, str, len);
+    while (len < width) {
+        size_t n = width - len;
+        if (n > sizeof(spaces) - 1)
+            n = sizeof(spaces) - 1;
+        put(writer, spaces, n);
+        len += n;
+    }
+}
+
+/**
+ * @internal
+ *
+ * Format @a value in decimal into the end of @a buf, returning a pointer to the first digit.
+ */
+static char *format_udec (char *end, uint64_t value) {
+    char *p = end;
+    do {
+        *--p = '0' + (value % 10);
+        value /= 10;
+    } while (value != 0);
+    return p;
+}
+
+/**
+ * @internal
+ *
+ * Append @a value in decimal, left-justified and padded with spaces to at least @a width bytes.
+ */
+static void put_sdec (plcrash_report_text_writer_t *writer, int64_t value, size_t width) {
+    char buf[21];
+    char *end = buf + sizeof(buf);
+    char *p = format_udec(end, (value < 0) ? -(uint64_t) value : (uint64_t) value);
+
+    if (value < 0)
+        *--p = '-';
+    put_padded(writer, p, end - p, width);
+}
+
+/**
+ * @internal
+ *
+ * Append @a value in decimal.
+ */
+static void put_udec (plcrash_report_text_writer_t *writer, uint64_t value) {
+    char buf[20];
+    char *end = buf + sizeof(buf);
+    char *p = format_udec(end, value);
+    put(writer, p, end - p);
+}
+
+/**
+ * @internal
+ *
+ * Append "0x" followed by @a value in lower-case hexadecimal, zero-padded to at least @a digits digits.
+ */
+static void put_hex (plcrash_report_text_writer_t *writer, uint64_t value, unsigned int digits) {
+    static const char hex[] = "0123456789abcdef";
+    char buf[18];
+    char *end = buf + sizeof(buf);
+    char *p = end;
+    unsigned int n = 0;
+
+    do {
+        *--p = hex[value & 0xF];
+        value >>= 4;
+        n++;
+    } while (value != 0 || n < digits);
+
+    *--p = 'x';
+    *--p = '0';
+    put(writer, p, end - p);
+}
+
+/**
+ * @internal
+ *
+ * Return the last path component of @a path, with the semantics of -[NSString lastPathComponent].
+ */
+static const char *last_path_component (const char *path, size_t *len) {
+    size_t end = strlen(path);
+
+    /* Trailing separators are ignored, unless the path consists only of separators */
+    while (end > 1 && path[end - 1] == '/')
+        end--;
+
+    if (end == 1 && path[0] == '/') {
+        *len = 1;
+        return path;
+    }
+
+    size_t start = end;
+    while (start > 0 && path[start - 1] != '/')
+        start--;
+
+    *len = end - start;
+    return path + start;
+}
+
+/**
+ * @internal
+ *
+ * Sort @a count image indices by base address, preserving the report order of images with equal base addresses.
+ * A bottom-up merge sort is used in place of qsort_r(), whose signature differs between platforms.
+ */
+static bool sort_images (text_report_t *report, size_t *indices, size_t count) {
+    size_t *tmp = malloc((count > 0 ? count : 1) * sizeof(size_t));
+    if (tmp == NULL)
+        return false;
+
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t lo = 0; lo < count; lo += 2 * width) {
+            size_t mid = (lo + width < count) ? lo + width : count;
+            size_t hi = (lo + 2 * width < count) ? lo + 2 * width : count;
+            size_t i = lo, j = mid, k = lo;
+
+            while (i < mid && j < hi) {
+                if (report->images[indices[j]]->base_address < report->images[indices[i]]->base_address)
+                    tmp[k++] = indices[j++];
+                else
+                    tmp[k++] = indices[i++];
+            }
+            while (i < mid)
+                tmp[k++] = indices[i++];
+            while (j < hi)
+                tmp[k++] = indices[j++];
+        }
+        memcpy(indices, tmp, count * sizeof(size_t));
+    }
+
+    free(tmp);
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Unpack the last occurrence of singular top-level field @a number into the report's arena. Returns NULL if the field
+ * is not present, or on error.
+ */
+static void *unpack_last (text_report_t *report, plcrash_report_field_number_t number) {
+    size_t count = plcrash_report_decoder_count(report->decoder, number);
+    if (count == 0)
+        return NULL;
+
+    return plcrash_report_decoder_unpack_allocator(report->decoder, number, count - 1, &report->arena.allocator);
+}
+
+/**
+ * @internal
+ *
+ * Decode the report's threads and images into @a report. As with PLCrashReport, if any thread (or image) can not be
+ * decoded, none are used.
+ */
+static plcrash_error_t text_report_init (text_report_t *report, const plcrash_report_decoder_t *decoder) {
+    memset(report, 0, sizeof(*report));
+    report->decoder = decoder;
+    protobuf_c_arena_init(&report->arena, decoder->message_len);
+
+    /* Threads */
+    size_t count = plcrash_report_decoder_count(decoder, PLCRASH_REPORT_FIELD_THREADS);
+    report->threads = malloc((count > 0 ? count : 1) * sizeof(*report->threads));
+    if (report->threads == NULL)
+        return PLCRASH_ENOMEM;
+
+    for (size_t i = 0; i < count && report->threads != NULL; i++) {
+        Plcrash__CrashReport__Thread *thread;
+        thread = (Plcrash__CrashReport__Thread *) plcrash_report_decoder_unpack_allocator(decoder, PLCRASH_REPORT_FIELD_THREADS, i,
+                                                                                            &report->arena.allocator);
+        bool valid = (thread != NULL);
+        for (size_t r = 0; valid && r < thread->n_registers; r++) {
+            if (thread->registers[r]->name == NULL)
+                valid = false;
+        }
+
+        if (!valid) {
+            free(report->threads);
+            report->threads = NULL;
+            break;
+        }
+
+        report->threads[i] = thread;
+        report->thread_count++;
+    }
+
+    /* Images */
+    count = plcrash_report_decoder_count(decoder, PLCRASH_REPORT_FIELD_BINARY_IMAGES);
+    report->images = malloc((count > 0 ? count : 1) * sizeof(*report->images));
+    if (report->images == NULL)
+        return PLCRASH_ENOMEM;
+
+    for (size_t i = 0; i < count; i++) {
+        Plcrash__CrashReport__BinaryImage *image;
+        image = (Plcrash__CrashReport__BinaryImage *) plcrash_report_decoder_unpack_allocator(decoder, PLCRASH_REPORT_FIELD_BINARY_IMAGES, i,
+                                                                                               &report->arena.allocator);
+        if (image == NULL || image->name == NULL || (image->uuid.len != 0 && image->uuid.len != IMAGE_UUID_LEN)) {
+            free(report->images);
+            report->images = NULL;
+            return PLCRASH_ESUCCESS;
+        }
+
+        report->images[i] = image;
+        report->image_count++;
+    }
+
+    /* Sort and index the images */
+    report->sorted_images = malloc((count > 0 ? count : 1) * sizeof(size_t));
+    plcrash_report_image_range_t *ranges = malloc((count > 0 ? count : 1) * sizeof(plcrash_report_image_range_t));
+    if (report->sorted_images == NULL || ranges == NULL) {
+        free(ranges);
+        return PLCRASH_ENOMEM;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        report->sorted_images[i] = i;
+        ranges[i].base_address = report->images[i]->base_address;
+        ranges[i].size = report->images[i]->size;
+    }
+
+    plcrash_error_t err = plcrash_report_image_index_init(&report->image_index, ranges, count);
+    free(ranges);
+    if (err != PLCRASH_ESUCCESS)
+        return err;
+    report->has_image_index = true;
+
+    if (!sort_images(report, report->sorted_images, count))
+        return PLCRASH_ENOMEM;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * @internal
+ *
+ * Free all resources associated with @a report.
+ */
+static void text_report_free (text_report_t *report) {
+    if (report->has_image_index)
+        plcrash_report_image_index_free(&report->image_index);
+
+    free(report->threads);
+    free(report->images);
+    free(report->sorted_images);
+    protobuf_c_arena_destroy(&report->arena);
+}
+
+/**
+ * @internal
+ *
+ * Write the iOS-format text report.
+ */
+static void write_ios (plcrash_report_text_writer_t *writer, text_report_t *report) {
+    const plcrash_report_decoder_t *decoder = report->decoder;
+    Plcrash__CrashReport__SystemInfo *systemInfo;
+    Plcrash__CrashReport__ApplicationInfo *appInfo;
+    Plcrash__CrashReport__Signal *signal;
+    int operatingSystem = 0;
+    int architecture = 0;
+    const char *codeType;
+    bool lp64;
+
+    /* Fetch the singular sections, discarding any that PLCrashReport would reject */
+    systemInfo = unpack_last(report, PLCRASH_REPORT_FIELD_SYSTEM_INFO);
+    if (systemInfo != NULL && systemInfo->os_version == NULL)
+        systemInfo = NULL;
+    if (systemInfo != NULL) {
+        operatingSystem = systemInfo->operating_system;
+        architecture = systemInfo->architecture;
+    }
+
+    appInfo = unpack_last(report, PLCRASH_REPORT_FIELD_APP_INFO);
+    if (appInfo != NULL && (appInfo->identifier == NULL || appInfo->version == NULL))
+        appInfo = NULL;
+
+    signal = unpack_last(report, PLCRASH_REPORT_FIELD_SIGNAL);
+    if (signal != NULL && (signal->name == NULL || signal->code == NULL))
+        signal = NULL;
+
+    /* Map to Apple-style code type, and mark whether architecture is LP64 (64-bit) */
+    switch (architecture) {
+        case PLCRASH__ARCHITECTURE__ARMV6:
+        case PLCRASH__ARCHITECTURE__ARMV7:
+            codeType = "ARM";
+            lp64 = false;
+            break;
+        case PLCRASH__ARCHITECTURE__X86_32:
+            codeType = "X86";
+            lp64 = false;
+            break;
+        case PLCRASH__ARCHITECTURE__X86_64:
+            codeType = "X86-64";
+            lp64 = true;
+            break;
+        case PLCRASH__ARCHITECTURE__PPC:
+            codeType = "PPC";
+            lp64 = false;
+            break;
+        default:
+            codeType = NULL;
+            lp64 = true;
+            break;
+    }
+
+#define PUT_LITERAL(literal) put(writer, literal, sizeof(literal) - 1)
+#define PUT_CODE_TYPE() do { \
+    if (codeType != NULL) { \
+        put_str(writer, codeType); \
+    } else { \
+        PUT_LITERAL("Unknown ("); \
+        put_sdec(writer, architecture, 0); \
+        PUT_LITERAL(")"); \
+    } \
+} while (0)
+
+    PUT_LITERAL("Incident Identifier: [TODO]\n");
+    PUT_LITERAL("CrashReporter Key:   [TODO]\n");
+
+    /* Application and process info */
+    {
+        const char *processName = UNKNOWN_STRING;
+        const char *processPath = UNKNOWN_STRING;
+        const char *parentProcessName = UNKNOWN_STRING;
+        bool hasProcessInfo = plcrash_report_decoder_count(decoder, PLCRASH_REPORT_FIELD_PROCESS_INFO) > 0;
+        uint32_t processId = 0;
+        uint32_t parentProcessId = 0;
+
+        /* Process information was not available in earlier crash report versions */
+        if (hasProcessInfo) {
+            Plcrash__CrashReport__ProcessInfo *processInfo;
+            processInfo = unpack_last(report, PLCRASH_REPORT_FIELD_PROCESS_INFO);
+            if (processInfo != NULL) {
+                if (processInfo->process_name != NULL)
+                    processName = processInfo->process_name;
+                if (processInfo->process_path != NULL)
+                    processPath = processInfo->process_path;
+                if (processInfo->parent_process_name != NULL)
+                    parentProcessName = processInfo->parent_process_name;
+
+                processId = processInfo->process_id;
+                parentProcessId = processInfo->parent_process_id;
+            }
+        }
+
+        PUT_LITERAL("Process:         ");
+        put_str(writer, processName);
+        PUT_LITERAL(" [");
+        if (hasProcessInfo)
+            put_udec(writer, processId);
+        else
+            PUT_LITERAL(UNKNOWN_STRING);
+        PUT_LITERAL("]\n");
+
+        PUT_LITERAL("Path:            ");
+        put_str(writer, processPath);
+        PUT_LITERAL("\n");
+
+        PUT_LITERAL("Identifier:      ");
+        put_str(writer, appInfo != NULL ? appInfo->identifier : NULL);
+        PUT_LITERAL("\n");
+
+        PUT_LITERAL("Version:         ");
+        put_str(writer, appInfo != NULL ? appInfo->version : NULL);
+        PUT_LITERAL("\n");
+
+        PUT_LITERAL("Code Type:       ");
+        PUT_CODE_TYPE();
+        PUT_LITERAL("\n");
+
+        PUT_LITERAL("Parent Process:  ");
+        put_str(writer, parentProcessName);
+        PUT_LITERAL(" [");
+        if (hasProcessInfo)
+            put_udec(writer, parentProcessId);
+        else
+            PUT_LITERAL(UNKNOWN_STRING);
+        PUT_LITERAL("]\n");
+    }
+
+    PUT_LITERAL("\n");
+
+    /* System info. The timestamp is formatted as by -[NSDate description]. */
+    PUT_LITERAL("Date/Time:       ");
+    if (systemInfo != NULL && systemInfo->timestamp != 0) {
+        time_t timestamp = (time_t) systemInfo->timestamp;
+        struct tm tm;
+        char date[64];
+        size_t len = 0;
+
+        if (localtime_r(&timestamp, &tm) != NULL)
+            len = strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S %z", &tm);
+        put(writer, date, len);
+    } else {
+        PUT_LITERAL(NIL_STRING);
+    }
+    PUT_LITERAL("\n");
+
+    /* Map to apple style OS name */
+    PUT_LITERAL("OS Version:      ");
+    switch (operatingSystem) {
+        case PLCRASH__CRASH_REPORT__SYSTEM_INFO__OPERATING_SYSTEM__MAC_OS_X:
+            PUT_LITERAL("Mac OS X");
+            break;
+        case PLCRASH__CRASH_REPORT__SYSTEM_INFO__OPERATING_SYSTEM__IPHONE_OS:
+            PUT_LITERAL("iPhone OS");
+            break;
+        case PLCRASH__CRASH_REPORT__SYSTEM_INFO__OPERATING_SYSTEM__IPHONE_SIMULATOR:
+            PUT_LITERAL("Mac OS X");
+            break;
+        default:
+            PUT_LITERAL("Unknown (");
+            put_sdec(writer, operatingSystem, 0);
+            PUT_LITERAL(")");
+            break;
+    }
+    PUT_LITERAL(" ");
+    put_str(writer, systemInfo != NULL ? systemInfo->os_version : NULL);
+    PUT_LITERAL(" (TODO)\n");
+    PUT_LITERAL("Report Version:  103\n");
+
+    PUT_LITERAL("\n");
+
+    /* Exception code */
+    PUT_LITERAL("Exception Type:  ");
+    put_str(writer, signal != NULL ? signal->name : NULL);
+    PUT_LITERAL("\n");
+    PUT_LITERAL("Exception Codes: ");
+    put_str(writer, signal != NULL ? signal->code : NULL);
+    PUT_LITERAL(" at ");
+    put_hex(writer, signal != NULL ? signal->address : 0, 0);
+    PUT_LITERAL("\n");
+
+    for (size_t i = 0; report->threads != NULL && i < report->thread_count; i++) {
+        if (report->threads[i]->crashed) {
+            PUT_LITERAL("Crashed Thread:  ");
+            put_udec(writer, report->threads[i]->thread_number);
+            PUT_LITERAL("\n");
+            break;
+        }
+    }
+
+    PUT_LITERAL("\n");
+
+    /* Uncaught Exception */
+    if (plcrash_report_decoder_count(decoder, PLCRASH_REPORT_FIELD_EXCEPTION) > 0) {
+        Plcrash__CrashReport__Exception *exception;
+        exception = unpack_last(report, PLCRASH_REPORT_FIELD_EXCEPTION);
+        if (exception != NULL && (exception->name == NULL || exception->reason == NULL))
+            exception = NULL;
+
+        PUT_LITERAL("Application Specific Information:\n");
+        PUT_LITERAL("*** Terminating app due to uncaught exception '");
+        put_str(writer, exception != NULL ? exception->name : NULL);
+        PUT_LITERAL("', reason: '");
+        put_str(writer, exception != NULL ? exception->reason : NULL);
+        PUT_LITERAL("'\n");
+
+        PUT_LITERAL("\n");
+    }
+
+    /* Threads. If several threads are marked as crashed, the registers of the last are written. */
+    Plcrash__CrashReport__Thread *crashedThread = NULL;
+    for (size_t i = 0; report->threads != NULL && i < report->thread_count; i++) {
+        Plcrash__CrashReport__Thread *thread = report->threads[i];
+
+        PUT_LITERAL("Thread ");
+        put_udec(writer, thread->thread_number);
+        if (thread->crashed) {
+            PUT_LITERAL(" Crashed:\n");
+            crashedThread = thread;
+        } else {
+            PUT_LITERAL(":\n");
+        }
+
+        for (size_t frame_idx = 0; frame_idx < thread->n_frames; frame_idx++) {
+            uint64_t instructionPointer = thread->frames[frame_idx]->pc;
+
+            /* Base image address containing instrumention pointer, offset of the IP from that base
+             * address, and the associated image name */
+            uint64_t baseAddress = 0x0;
+            uint64_t pcOffset = 0x0;
+            const char *imageName = UNKNOWN_STRING;
+            size_t imageNameLen = strlen(UNKNOWN_STRING);
+            const uint8_t *uuid = NULL;
+            plcrash_symbol_t symbol;
+            size_t image;
+
+            if (report->images != NULL && plcrash_report_image_index_lookup(&report->image_index, instructionPointer, &image)) {
+                imageName = last_path_component(report->images[image]->name, &imageNameLen);
+                baseAddress = report->images[image]->base_address;
+                pcOffset = instructionPointer - baseAddress;
+
+                if (writer->symbol_cache != NULL && report->images[image]->uuid.len == IMAGE_UUID_LEN)
+                    uuid = report->images[image]->uuid.data;
+            }
+
+            put_sdec(writer, frame_idx, 4);
+            put_padded(writer, imageName, imageNameLen, 36);
+            put_hex(writer, instructionPointer, 8);
+            PUT_LITERAL(" ");
+            writer->frame_count++;
+            if (uuid != NULL && plcrash_symbol_cache_lookup(writer->symbol_cache, uuid, pcOffset, &symbol)) {
+                writer->symbolicated_count++;
+                put_str(writer, symbol.name);
+                PUT_LITERAL(" + ");
+                put_udec(writer, symbol.offset);
+
+                if (symbol.file[0] != '\0') {
+                    size_t fileLen;
+                    const char *file = last_path_component(symbol.file, &fileLen);
+
+                    PUT_LITERAL(" (");
+                    put(writer, file, fileLen);
+                    PUT_LITERAL(":");
+                    put_udec(writer, symbol.line);
+                    PUT_LITERAL(")");
+                }
+            } else if (thread->frames[frame_idx]->symbol_name != NULL) {
+                /* Fall back on the symbol recorded in-process at crash time */
+                writer->symbolicated_count++;
+                put_str(writer, thread->frames[frame_idx]->symbol_name);
+                PUT_LITERAL(" + ");
+                put_udec(writer, thread->frames[frame_idx]->symbol_offset);
+            } else {
+                put_hex(writer, baseAddress, 0);
+                PUT_LITERAL(" + ");
+                put_sdec(writer, (int64_t) pcOffset, 0);
+            }
+            PUT_LITERAL("\n");
+        }
+        PUT_LITERAL("\n");
+    }
+
+    /* Registers */
+    if (crashedThread != NULL) {
+        PUT_LITERAL("Thread ");
+        put_udec(writer, crashedThread->thread_number);
+        PUT_LITERAL(" crashed with ");
+        PUT_CODE_TYPE();
+        PUT_LITERAL(" Thread State:\n");
+
+        int regColumn = 1;
+        for (size_t reg_idx = 0; reg_idx < crashedThread->n_registers; reg_idx++) {
+            const char *name = crashedThread->registers[reg_idx]->name;
+            size_t len = strlen(name);
+
+            /* Right-justify the name in six columns, and use a 32-bit or 64-bit fixed width value */
+            for (size_t pad = len; pad < 6; pad++)
+                PUT_LITERAL(" ");
+            put(writer, name, len);
+            PUT_LITERAL(":\t");
+            put_hex(writer, crashedThread->registers[reg_idx]->value, lp64 ? 16 : 8);
+            PUT_LITERAL(" ");
+
+            if (regColumn % 4 == 0)
+                PUT_LITERAL("\n");
+            regColumn++;
+        }
+
+        if (regColumn % 3 != 0)
+            PUT_LITERAL("\n");
+
+        PUT_LITERAL("\n");
+    }
+
+    /* Images. The iPhone crash report format sorts these in ascending order, by the base address */
+    PUT_LITERAL("Binary Images:\n");
+    for (size_t i = 0; report->images != NULL && i < report->image_count; i++) {
+        Plcrash__CrashReport__BinaryImage *image = report->images[report->sorted_images[i]];
+        size_t nameLen;
+        const char *name = last_path_component(image->name, &nameLen);
+
+        /* base_address - terminating_address file_name identifier (<version>) <uuid> file_path */
+        put_hex(writer, image->base_address, 0);
+        PUT_LITERAL(" - ");
+        put_hex(writer, image->base_address + image->size, 0);
+        PUT_LITERAL("  ");
+        put(writer, name, nameLen);
+        PUT_LITERAL(" " UNKNOWN_STRING " (" UNKNOWN_STRING ") <");
+        if (image->uuid.len == IMAGE_UUID_LEN) {
+            static const char hex[] = "0123456789abcdef";
+            char uuid[IMAGE_UUID_LEN * 2];
+            for (size_t b = 0; b < IMAGE_UUID_LEN; b++) {
+                uuid[b * 2 + 0] = hex[image->uuid.data[b] >> 4];
+                uuid[b * 2 + 1] = hex[image->uuid.data[b] & 0x0F];
+            }
+            put(writer, uuid, sizeof(uuid));
+        } else {
+            PUT_LITERAL(UNKNOWN_STRING);
+        }
+        PUT_LITERAL("> ");
+        put_str(writer, image->name);
+        PUT_LITERAL("\n");
+    }
+
+#undef PUT_CODE_TYPE
+#undef PUT_LITERAL
+}
+
+/**
+ * Format the report decoded by @a decoder as text, writing the result to @a writer. The output is identical to the
+ * UTF-8 encoding of the output of PLCrashReportTextFormatter.
+ *
+ * @param writer The output writer.
+ * @param decoder An initialized report decoder.
+ * @param format The text format to use.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_ENOTSUP if @a format is not supported, PLCRASH_ENOMEM if
+ * state could not be allocated or a caller-supplied buffer was exhausted, or PLCRASH_OUTPUT_ERR if writing to the
+ * file descriptor failed.
+ */
+plcrash_error_t plcrash_report_text_write (plcrash_report_text_writer_t *writer, const plcrash_report_decoder_t *decoder,
+                                           plcrash_report_text_format_t format)
+{
+    text_report_t report;
+    plcrash_error_t err;
+
+    if (format != PLCRASH_REPORT_TEXT_FORMAT_IOS)
+        return PLCRASH_ENOTSUP;
+
+    if ((err = text_report_init(&report, decoder)) == PLCRASH_ESUCCESS) {
+        write_ios(writer, &report);
+        err = plcrash_report_text_writer_flush(writer);
+    }
+
+    text_report_free(&report);
+    return err;
+}
+
+/**
+ * @} plcrash_report_text_writer
+ */
@@ -0,0 +1,101 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#import "PLCrashAsync.h"
+#import "PLCrashReportDecoder.h"
+#import "PLCrashSymbolCache.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_report_text_writer
+ *
+ * Size of the output buffer used when writing to a file descriptor.
+ */
+#define PLCRASH_REPORT_TEXT_WRITER_BUFSIZE 8192
+
+/**
+ * @internal
+ * @ingroup plcrash_report_text_writer
+ *
+ * Supported text formats. Values match PLCrashReportTextFormat.
+ */
+typedef enum {
+    /** An iOS-compatible crash log text format. Matches PLCrashReportTextFormatiOS. */
+    PLCRASH_REPORT_TEXT_FORMAT_IOS = 0
+} plcrash_report_text_format_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_text_writer
+ *
+ * Text report output. Writes either to a caller-supplied fixed-size buffer, or through an internal buffer to a
+ * file descriptor.
+ */
+typedef struct plcrash_report_text_writer {
+    /** Output file descriptor, or -1 if writing to a caller-supplied buffer */
+    int fd;
+
+    /** Output buffer */
+    char *buffer;
+
+    /** Size of buffer, in bytes */
+    size_t size;
+
+    /** Number of bytes currently held in buffer */
+    size_t used;
+
+    /** Total number of bytes of output produced, including any that did not fit in a caller-supplied buffer */
+    size_t total;
+
+    /** True if output was discarded, either because a caller-supplied buffer was exhausted or a write failed */
+    bool failed;
+
+    /** Symbol cache used to symbolicate stack frames, or NULL */
+    plcrash_symbol_cache_t *symbol_cache;
+
+    /** Number of stack frames written */
+    size_t frame_count;
+
+    /** Number of stack frames written with a symbol name */
+    size_t symbolicated_count;
+
+    /** Output buffer storage, if writing to a file descriptor */
+    char storage[PLCRASH_REPORT_TEXT_WRITER_BUFSIZE];
+} plcrash_report_text_writer_t;
+
+void plcrash_report_text_writer_init_buffer (plcrash_report_text_writer_t *writer, char *buffer, size_t size);
+void plcrash_report_text_writer_init_fd (plcrash_report_text_writer_t *writer, int fd);
+void plcrash_report_text_writer_set_symbol_cache (plcrash_report_text_writer_t *writer, plcrash_symbol_cache_t *cache);
+plcrash_error_t plcrash_report_text_writer_flush (plcrash_report_text_writer_t *writer);
+
+plcrash_error_t plcrash_report_text_write (plcrash_report_text_writer_t *writer, const plcrash_report_decoder_t *decoder,
+                                           plcrash_report_text_format_t format);
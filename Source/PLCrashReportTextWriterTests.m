@@ -0,0 +1,369 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+#import "PLCrashTestReportBuilder.h"
+#import "CrashReporter.h"
+#import "PLCrashReportTextWriter.h"
+#import "PLCrashFrameWalker.h"
+#import "PLCrashLogWriter.h"
+
+#import <fcntl.h>
+#import <mach-o/dyld.h>
+#import <mach/mach_time.h>
+
+@interface PLCrashReportTextWriterTests : SenTestCase {
+@private
+    /* Path to crash log */
+    NSString *_logPath;
+
+    /* Test thread */
+    plframe_test_thead_t _thr_args;
+}
+@end
+
+/* Number of reports in the benchmark corpus */
+#define BENCH_REPORT_COUNT 1000
+
+/*
+ * Encode a pseudo-random version 1 crash report. The report varies the operating system, architecture, image
+ * layout, register set, and optional sections, so that a corpus of reports exercises every branch of the
+ * formatters.
+ */
+static NSData *corpus_report (void) {
+    static const char *registers[] = { "r0", "r1", "r2", "r3", "ip", "sp", "lr", "pc", "rax", "rbx", "rip", "cpsr" };
+    static const uint32_t archs[] = { PLCrashReportArchitectureX86_32, PLCrashReportArchitectureX86_64, PLCrashReportArchitectureARMv6,
+                                      PLCrashReportArchitectureARMv7, PLCrashReportArchitecturePPC };
+    NSMutableData *report = plcrash_test_report_header();
+
+    /* System, application, and machine info */
+    NSMutableData *msg = [NSMutableData data];
+    plcrash_test_append_uint(msg, 1, random() % 3);
+    plcrash_test_append_string(msg, 2, "4.2.1");
+    plcrash_test_append_uint(msg, 3, archs[random() % (sizeof(archs) / sizeof(archs[0]))]);
+    plcrash_test_append_uint(msg, 4, 1290000000 + random() % 10000000);
+    if (random() % 2)
+        plcrash_test_append_string(msg, 5, "8C148");
+    plcrash_test_append_message(report, 1, msg);
+
+    msg = [NSMutableData data];
+    plcrash_test_append_string(msg, 1, "com.example.corpus");
+    plcrash_test_append_string(msg, 2, "1.0");
+    plcrash_test_append_message(report, 2, msg);
+
+    NSMutableData *processor = [NSMutableData data];
+    plcrash_test_append_uint(processor, 2, (random() % 2) ? 12 : 7);
+    plcrash_test_append_uint(processor, 3, random() % 10);
+
+    msg = [NSMutableData data];
+    if (random() % 2)
+        plcrash_test_append_string(msg, 1, "iPhone3,1");
+    plcrash_test_append_message(msg, 2, processor);
+    plcrash_test_append_uint(msg, 3, 1 + random() % 4);
+    plcrash_test_append_uint(msg, 4, 1 + random() % 8);
+    plcrash_test_append_message(report, 8, msg);
+
+    /* Process info, which was added in v1.1 */
+    if (random() % 4) {
+        msg = [NSMutableData data];
+        plcrash_test_append_string(msg, 1, "Corpus");
+        plcrash_test_append_uint(msg, 2, random() % 65536);
+        plcrash_test_append_string(msg, 3, "/var/mobile/Applications/Corpus.app/Corpus");
+        plcrash_test_append_string(msg, 4, "launchd");
+        plcrash_test_append_uint(msg, 5, 1);
+        plcrash_test_append_uint(msg, 6, random() % 2);
+        plcrash_test_append_message(report, 7, msg);
+    }
+
+    /* Images */
+    uint32_t image_count = 1 + random() % 64;
+    for (uint32_t i = 0; i < image_count; i++) {
+        char name[64];
+        uint8_t uuid[16];
+
+        snprintf(name, sizeof(name), "/usr/lib/libcorpus%u.dylib", (unsigned int) i);
+        for (size_t j = 0; j < sizeof(uuid); j++)
+            uuid[j] = random();
+
+        msg = [NSMutableData data];
+        plcrash_test_append_uint(msg, 1, 0x1000 + (random() % 0x100000) * 0x1000);
+        plcrash_test_append_uint(msg, 2, 0x1000 + random() % 0x40000);
+        plcrash_test_append_string(msg, 3, name);
+        if (random() % 4)
+            plcrash_test_append_bytes(msg, 4, uuid, sizeof(uuid));
+        plcrash_test_append_message(report, 4, msg);
+    }
+
+    /* Threads */
+    uint32_t thread_count = 1 + random() % 16;
+    uint32_t crashed = random() % thread_count;
+    for (uint32_t t = 0; t < thread_count; t++) {
+        NSMutableData *thread = [NSMutableData data];
+        plcrash_test_append_uint(thread, 1, t);
+
+        uint32_t frame_count = random() % 64;
+        for (uint32_t f = 0; f < frame_count; f++) {
+            NSMutableData *frame = [NSMutableData data];
+            plcrash_test_append_uint(frame, 3, 0x1000 + (random() % 0x100000) * 0x100);
+            plcrash_test_append_message(thread, 2, frame);
+        }
+
+        plcrash_test_append_uint(thread, 3, t == crashed);
+        if (t == crashed) {
+            uint32_t register_count = random() % (sizeof(registers) / sizeof(registers[0]));
+            for (uint32_t r = 0; r < register_count; r++) {
+                NSMutableData *reg = [NSMutableData data];
+                plcrash_test_append_string(reg, 1, registers[r]);
+                plcrash_test_append_uint(reg, 2, ((uint64_t) random() << 32) | random());
+                plcrash_test_append_message(thread, 4, reg);
+            }
+        }
+        plcrash_test_append_message(report, 3, thread);
+    }
+
+    /* Signal and, optionally, exception */
+    msg = [NSMutableData data];
+    plcrash_test_append_string(msg, 1, (random() % 2) ? "SIGSEGV" : "SIGABRT");
+    plcrash_test_append_string(msg, 2, "SEGV_MAPERR");
+    plcrash_test_append_uint(msg, 3, random());
+    plcrash_test_append_message(report, 6, msg);
+
+    if (random() % 2) {
+        msg = [NSMutableData data];
+        plcrash_test_append_string(msg, 1, "NSInvalidArgumentException");
+        plcrash_test_append_string(msg, 2, "-[NSObject corpus]: unrecognized selector");
+        plcrash_test_append_message(report, 5, msg);
+    }
+
+    return report;
+}
+
+/* Format data with PLCrashReportTextFormatter, returning the UTF-8 encoded result */
+static NSData *objc_format (NSData *data) {
+    PLCrashReport *report = [[[PLCrashReport alloc] initWithData: data error: NULL] autorelease];
+    if (report == nil)
+        return nil;
+
+    NSString *text = [PLCrashReportTextFormatter stringValueForCrashReport: report withTextFormat: PLCrashReportTextFormatiOS];
+    return [text dataUsingEncoding: NSUTF8StringEncoding];
+}
+
+/* Format data with the C text writer, returning the result */
+static NSData *c_format (NSData *data) {
+    plcrash_report_decoder_t decoder;
+    plcrash_report_text_writer_t writer;
+    NSMutableData *output = nil;
+
+    if (plcrash_report_decoder_init(&decoder, [data bytes], [data length]) != PLCRASH_ESUCCESS)
+        return nil;
+
+    /* Size the output, then write it */
+    plcrash_report_text_writer_init_buffer(&writer, NULL, 0);
+    if (plcrash_report_text_write(&writer, &decoder, PLCRASH_REPORT_TEXT_FORMAT_IOS) == PLCRASH_ENOMEM) {
+        output = [NSMutableData dataWithLength: writer.total];
+        plcrash_report_text_writer_init_buffer(&writer, [output mutableBytes], [output length]);
+        if (plcrash_report_text_write(&writer, &decoder, PLCRASH_REPORT_TEXT_FORMAT_IOS) != PLCRASH_ESUCCESS)
+            output = nil;
+    }
+
+    plcrash_report_decoder_free(&decoder);
+    return output;
+}
+
+@implementation PLCrashReportTextWriterTests
+
+- (void) setUp {
+    /* Create a temporary log path */
+    _logPath = [[NSTemporaryDirectory() stringByAppendingString: [[NSProcessInfo processInfo] globallyUniqueString]] retain];
+
+    /* Create the test thread */
+    plframe_test_thread_spawn(&_thr_args);
+}
+
+- (void) tearDown {
+    /* Delete the file, if any */
+    [[NSFileManager defaultManager] removeItemAtPath: _logPath error: NULL];
+    [_logPath release];
+
+    /* Stop the test thread */
+    plframe_test_thread_stop(&_thr_args);
+}
+
+/* Verify that a report written by the crash log writer formats identically */
+- (void) testWrittenReport {
+    siginfo_t info;
+    plframe_thread_state_t thread_state;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+
+    /* Initialze faux crash data */
+    memset(&info, 0, sizeof(info));
+    info.si_addr = 0x0;
+    info.si_pid = getpid();
+    info.si_uid = getuid();
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_thread_state_fetch(&thread_state, pthread_mach_thread_np(_thr_args.thread));
+
+    /* Write the report */
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    plcrash_log_writer_set_exception(&writer, [NSException exceptionWithName: @"TestException" reason: @"TestReason" userInfo: nil]);
+
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++)
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, pthread_mach_thread_np(_thr_args.thread), &file, &info, &thread_state.uap), @"Crash log failed");
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+
+    /* Compare the formatters */
+    NSData *data = [NSData dataWithContentsOfMappedFile: _logPath];
+    NSData *expected = objc_format(data);
+    NSData *actual = c_format(data);
+
+    STAssertNotNil(expected, @"Could not format report");
+    STAssertNotNil(actual, @"Could not write report");
+    STAssertTrue([expected isEqualToData: actual], @"Output differs: %@", [[[NSString alloc] initWithData: actual encoding: NSUTF8StringEncoding] autorelease]);
+}
+
+/* Verify that synthetic reports format identically */
+- (void) testCorpus {
+    srandom(1);
+    for (int i = 0; i < 200; i++) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        NSData *data = corpus_report();
+        NSData *expected = objc_format(data);
+        NSData *actual = c_format(data);
+
+        STAssertNotNil(expected, @"Could not format report %d", i);
+        STAssertTrue([expected isEqualToData: actual], @"Output differs for report %d", i);
+        [pool release];
+    }
+}
+
+/* Verify handling of an exhausted output buffer */
+- (void) testBufferExhausted {
+    plcrash_report_decoder_t decoder;
+    plcrash_report_text_writer_t writer;
+    char buffer[64];
+
+    srandom(2);
+    NSData *data = corpus_report();
+    NSData *expected = objc_format(data);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_decoder_init(&decoder, [data bytes], [data length]), @"Could not decode report");
+
+    plcrash_report_text_writer_init_buffer(&writer, buffer, sizeof(buffer));
+    STAssertEquals(PLCRASH_ENOMEM, plcrash_report_text_write(&writer, &decoder, PLCRASH_REPORT_TEXT_FORMAT_IOS), @"Buffer exhaustion not reported");
+    STAssertEquals((size_t) [expected length], writer.total, @"Incorrect required length");
+    STAssertTrue(memcmp(buffer, [expected bytes], sizeof(buffer)) == 0, @"Incorrect partial output");
+
+    plcrash_report_text_writer_init_buffer(&writer, buffer, sizeof(buffer));
+    STAssertEquals(PLCRASH_ENOTSUP, plcrash_report_text_write(&writer, &decoder, 42), @"Unsupported format not reported");
+
+    plcrash_report_decoder_free(&decoder);
+}
+
+/* Verify writing to a file descriptor */
+- (void) testFileDescriptor {
+    plcrash_report_decoder_t decoder;
+    plcrash_report_text_writer_t writer;
+
+    srandom(3);
+    NSData *data = corpus_report();
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_decoder_init(&decoder, [data bytes], [data length]), @"Could not decode report");
+
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    STAssertTrue(fd >= 0, @"Could not open output file");
+
+    plcrash_report_text_writer_init_fd(&writer, fd);
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_text_write(&writer, &decoder, PLCRASH_REPORT_TEXT_FORMAT_IOS), @"Could not write report");
+    close(fd);
+    plcrash_report_decoder_free(&decoder);
+
+    NSData *actual = [NSData dataWithContentsOfFile: _logPath];
+    STAssertTrue([objc_format(data) isEqualToData: actual], @"Output differs");
+}
+
+/* Compare the Objective-C formatter and the C writer over a corpus of reports */
+- (void) testFormatPerformance {
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+
+    srandom(4);
+    NSMutableArray *corpus = [NSMutableArray arrayWithCapacity: BENCH_REPORT_COUNT];
+    size_t input_bytes = 0;
+    for (int i = 0; i < BENCH_REPORT_COUNT; i++) {
+        NSData *data = corpus_report();
+        input_bytes += [data length];
+        [corpus addObject: data];
+    }
+
+    /* Objective-C formatter, including parsing */
+    size_t objc_bytes = 0;
+    uint64_t start = mach_absolute_time();
+    for (NSData *data in corpus) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        objc_bytes += [objc_format(data) length];
+        [pool release];
+    }
+    uint64_t objc_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    /* C writer, including decoding, into a single reused buffer */
+    size_t c_bytes = 0;
+    size_t buffer_size = 1024 * 1024;
+    char *buffer = malloc(buffer_size);
+    start = mach_absolute_time();
+    for (NSData *data in corpus) {
+        plcrash_report_decoder_t decoder;
+        plcrash_report_text_writer_t writer;
+
+        if (plcrash_report_decoder_init(&decoder, [data bytes], [data length]) != PLCRASH_ESUCCESS)
+            continue;
+
+        plcrash_report_text_writer_init_buffer(&writer, buffer, buffer_size);
+        if (plcrash_report_text_write(&writer, &decoder, PLCRASH_REPORT_TEXT_FORMAT_IOS) == PLCRASH_ESUCCESS)
+            c_bytes += writer.total;
+        plcrash_report_decoder_free(&decoder);
+    }
+    uint64_t c_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+    free(buffer);
+
+    STAssertEquals(objc_bytes, c_bytes, @"Output lengths differ");
+    NSLog(@"Formatted %d reports (%lu bytes in, %lu bytes out): PLCrashReportTextFormatter=%llu us, C writer=%llu us (%.1fx)",
+          BENCH_REPORT_COUNT, (unsigned long) input_bytes, (unsigned long) c_bytes, objc_ns / 1000, c_ns / 1000,
+          c_ns > 0 ? (double) objc_ns / c_ns : 0.0);
+}
+
+@end
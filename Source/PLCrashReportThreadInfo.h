@@ -32,15 +32,33 @@
 @private
     /** Frame instruction pointer. */
     uint64_t _instructionPointer;
+
+    /** Nearest preceding symbol name, or nil. */
+    NSString *_symbolName;
+
+    /** Offset of the instruction pointer from the symbol. */
+    uint64_t _symbolOffset;
 }
 
 - (id) initWithInstructionPointer: (uint64_t) instructionPointer;
+- (id) initWithInstructionPointer: (uint64_t) instructionPointer symbolName: (NSString *) symbolName symbolOffset: (uint64_t) symbolOffset;
 
 /**
  * Frame's instruction pointer.
  */
 @property(nonatomic, readonly) uint64_t instructionPointer;
 
+/**
+ * Name of the nearest preceding exported symbol, as resolved in-process at crash time, or nil if the frame
+ * was not symbolicated.
+ */
+@property(nonatomic, readonly) NSString *symbolName;
+
+/**
+ * Offset of the instruction pointer from the symbol. Only valid if symbolName is not nil.
+ */
+@property(nonatomic, readonly) uint64_t symbolOffset;
+
 @end
 
 
@@ -73,29 +91,95 @@
     /** The thread number. Should be unique within a given crash log. */
     NSInteger _threadNumber;
 
-    /** Ordered list of PLCrashReportStackFrame instances */
-    NSArray *_stackFrames;
-
     /** YES if this thread crashed. */
     BOOL _crashed;
 
-    /** List of PLCrashReportRegister instances. Will be empty if _crashed is NO. */
+    /** Frame instruction pointers, ordered last callee to first. */
+    uint64_t *_instructionPointers;
+
+    /** Number of entries in _instructionPointers */
+    NSUInteger _stackFrameCount;
+
+    /** Frame symbol offsets, or NULL if no frame has a symbol. _symbolNameOffsets and _symbolNames share this
+     * allocation. */
+    uint64_t *_symbolOffsets;
+
+    /** Offsets of each frame's NUL-terminated symbol name within _symbolNames, or UINT32_MAX if the frame has
+     * no symbol */
+    uint32_t *_symbolNameOffsets;
+
+    /** Packed, NUL-terminated symbol names */
+    char *_symbolNames;
+
+    /** Register values. _registerNameOffsets and _registerNames share this allocation. */
+    uint64_t *_registerValues;
+
+    /** Offsets of each register's NUL-terminated name within _registerNames */
+    uint32_t *_registerNameOffsets;
+
+    /** Packed, NUL-terminated register names */
+    char *_registerNames;
+
+    /** Number of registers */
+    NSUInteger _registerCount;
+
+    /** Ordered list of PLCrashReportStackFrame instances. Created on first access. */
+    NSArray *_stackFrames;
+
+    /** List of PLCrashReportRegister instances. Created on first access. */
     NSArray *_registers;
 }
 
+- (id) initWithThreadNumber: (NSInteger) threadNumber
+        instructionPointers: (const uint64_t *) instructionPointers
+            stackFrameCount: (NSUInteger) stackFrameCount
+                    crashed: (BOOL) crashed
+              registerNames: (const char * const *) registerNames
+             registerValues: (const uint64_t *) registerValues
+              registerCount: (NSUInteger) registerCount;
+
+- (id) initWithThreadNumber: (NSInteger) threadNumber
+        instructionPointers: (const uint64_t *) instructionPointers
+                symbolNames: (const char * const *) symbolNames
+              symbolOffsets: (const uint64_t *) symbolOffsets
+            stackFrameCount: (NSUInteger) stackFrameCount
+                    crashed: (BOOL) crashed
+              registerNames: (const char * const *) registerNames
+             registerValues: (const uint64_t *) registerValues
+              registerCount: (NSUInteger) registerCount;
+
 - (id) initWithThreadNumber: (NSInteger) threadNumber
                 stackFrames: (NSArray *) stackFrames
                     crashed: (BOOL) crashed
                   registers: (NSArray *) registers;
 
+- (uint64_t) instructionPointerAtIndex: (NSUInteger) index;
+- (void) getInstructionPointers: (uint64_t *) buffer range: (NSRange) range;
+
+- (NSString *) symbolNameAtIndex: (NSUInteger) index;
+- (uint64_t) symbolOffsetAtIndex: (NSUInteger) index;
+
+- (NSString *) registerNameAtIndex: (NSUInteger) index;
+- (uint64_t) registerValueAtIndex: (NSUInteger) index;
+- (void) getRegisterValues: (uint64_t *) buffer range: (NSRange) range;
+
 /**
  * Application thread number.
  */
 @property(nonatomic, readonly) NSInteger threadNumber;
 
+/**
+ * Number of frames in the thread's backtrace.
+ */
+@property(nonatomic, readonly) NSUInteger stackFrameCount;
+
 /**
  * Thread backtrace. Provides an array of PLCrashReportStackFrameInfo instances.
  * The array is ordered, last callee to first.
+ *
+ * The frame objects are created on first access. Where only the instruction pointers
+ * are required, use stackFrameCount and instructionPointerAtIndex: or
+ * getInstructionPointers:range:, which do not allocate.
  */
 @property(nonatomic, readonly) NSArray *stackFrames;
 
@@ -104,10 +188,18 @@
  */
 @property(nonatomic, readonly) BOOL crashed;
 
+/**
+ * Number of registers recorded for this thread.
+ */
+@property(nonatomic, readonly) NSUInteger registerCount;
+
 /**
  * State of the general purpose and related registers, as a list of
  * PLCrashReportRegister instances. If this thead did not crash (crashed returns NO),
  * this list will be empty.
+ *
+ * The register objects are created on first access. Where only the register values
+ * are required, use registerCount and registerValueAtIndex: or getRegisterValues:range:.
  */
 @property(nonatomic, readonly) NSArray *registers;
 
@@ -32,39 +32,396 @@
  * Crash log per-thread state information.
  *
  * Provides thread state information, including a backtrace and register state.
+ *
+ * Instruction pointers and register values are stored in contiguous arrays, and may be read in bulk. The
+ * PLCrashReportStackFrameInfo and PLCrashReportRegisterInfo instances vended by the stackFrames and registers
+ * properties are only created when those properties are first accessed.
  */
 @implementation PLCrashReportThreadInfo
 
 /**
- * Initialize the crash log thread information.
+ * Initialize the crash log thread information, without frame symbols. The instruction pointers, register names and
+ * register values are copied.
+ *
+ * @param threadNumber The thread number.
+ * @param instructionPointers The thread's frame instruction pointers, ordered last callee to first.
+ * @param stackFrameCount The number of entries in @a instructionPointers.
+ * @param crashed YES if this thread crashed.
+ * @param registerNames The NUL-terminated UTF-8 name of each register.
+ * @param registerValues The value of each register.
+ * @param registerCount The number of entries in @a registerNames and @a registerValues.
  */
 - (id) initWithThreadNumber: (NSInteger) threadNumber
-                stackFrames: (NSArray *) stackFrames
+        instructionPointers: (const uint64_t *) instructionPointers
+            stackFrameCount: (NSUInteger) stackFrameCount
                     crashed: (BOOL) crashed
-                  registers: (NSArray *) registers
+              registerNames: (const char * const *) registerNames
+             registerValues: (const uint64_t *) registerValues
+              registerCount: (NSUInteger) registerCount
+{
+    return [self initWithThreadNumber: threadNumber
+                  instructionPointers: instructionPointers
+                          symbolNames: NULL
+                        symbolOffsets: NULL
+                      stackFrameCount: stackFrameCount
+                              crashed: crashed
+                        registerNames: registerNames
+                       registerValues: registerValues
+                        registerCount: registerCount];
+}
+
+/**
+ * Initialize the crash log thread information. The instruction pointers, symbols, register names and register
+ * values are copied.
+ *
+ * @param threadNumber The thread number.
+ * @param instructionPointers The thread's frame instruction pointers, ordered last callee to first.
+ * @param symbolNames The NUL-terminated UTF-8 name of each frame's nearest preceding symbol, or NULL for a frame
+ * without a symbol. May be NULL if no frame has a symbol.
+ * @param symbolOffsets The offset of each frame's instruction pointer from its symbol. May be NULL if
+ * @a symbolNames is NULL.
+ * @param stackFrameCount The number of entries in @a instructionPointers, @a symbolNames and @a symbolOffsets.
+ * @param crashed YES if this thread crashed.
+ * @param registerNames The NUL-terminated UTF-8 name of each register.
+ * @param registerValues The value of each register.
+ * @param registerCount The number of entries in @a registerNames and @a registerValues.
+ *
+ * @par Designated Initializer
+ * This method is the designated initializer for the PLCrashReportThreadInfo class.
+ */
+- (id) initWithThreadNumber: (NSInteger) threadNumber
+        instructionPointers: (const uint64_t *) instructionPointers
+                symbolNames: (const char * const *) symbolNames
+              symbolOffsets: (const uint64_t *) symbolOffsets
+            stackFrameCount: (NSUInteger) stackFrameCount
+                    crashed: (BOOL) crashed
+              registerNames: (const char * const *) registerNames
+             registerValues: (const uint64_t *) registerValues
+              registerCount: (NSUInteger) registerCount
 {
     if ((self = [super init]) == nil)
         return nil;
 
     _threadNumber = threadNumber;
-    _stackFrames = [stackFrames retain];
     _crashed = crashed;
-    _registers = [registers retain];
+
+    /* Frames */
+    if (stackFrameCount > 0) {
+        _instructionPointers = malloc(stackFrameCount * sizeof(uint64_t));
+        if (_instructionPointers == NULL) {
+            [self release];
+            return nil;
+        }
+
+        memcpy(_instructionPointers, instructionPointers, stackFrameCount * sizeof(uint64_t));
+    }
+    _stackFrameCount = stackFrameCount;
+
+    /* Symbols. As with the registers, the offsets, name offsets, and names share a single allocation, which is
+     * only made if at least one frame has a symbol. */
+    if (symbolNames != NULL) {
+        size_t namesLength = 0;
+        for (NSUInteger i = 0; i < stackFrameCount; i++) {
+            if (symbolNames[i] != NULL)
+                namesLength += strlen(symbolNames[i]) + 1;
+        }
+
+        if (namesLength >= UINT32_MAX) {
+            [self release];
+            return nil;
+        }
+
+        if (namesLength > 0) {
+            uint8_t *block = malloc(stackFrameCount * (sizeof(uint64_t) + sizeof(uint32_t)) + namesLength);
+            if (block == NULL) {
+                [self release];
+                return nil;
+            }
+
+            _symbolOffsets = (uint64_t *) block;
+            _symbolNameOffsets = (uint32_t *) (block + stackFrameCount * sizeof(uint64_t));
+            _symbolNames = (char *) (block + stackFrameCount * (sizeof(uint64_t) + sizeof(uint32_t)));
+
+            uint32_t offset = 0;
+            for (NSUInteger i = 0; i < stackFrameCount; i++) {
+                if (symbolNames[i] == NULL) {
+                    _symbolOffsets[i] = 0;
+                    _symbolNameOffsets[i] = UINT32_MAX;
+                    continue;
+                }
+
+                size_t len = strlen(symbolNames[i]) + 1;
+                _symbolOffsets[i] = symbolOffsets[i];
+                _symbolNameOffsets[i] = offset;
+                memcpy(_symbolNames + offset, symbolNames[i], len);
+                offset += len;
+            }
+        }
+    }
+
+    /* Registers. The values, name offsets, and names are stored in a single allocation, with the 64-bit values
+     * first to preserve their alignment. */
+    if (registerCount > 0) {
+        size_t namesLength = 0;
+        for (NSUInteger i = 0; i < registerCount; i++)
+            namesLength += strlen(registerNames[i]) + 1;
+
+        if (namesLength > UINT32_MAX) {
+            [self release];
+            return nil;
+        }
+
+        uint8_t *block = malloc(registerCount * (sizeof(uint64_t) + sizeof(uint32_t)) + namesLength);
+        if (block == NULL) {
+            [self release];
+            return nil;
+        }
+
+        _registerValues = (uint64_t *) block;
+        _registerNameOffsets = (uint32_t *) (block + registerCount * sizeof(uint64_t));
+        _registerNames = (char *) (block + registerCount * (sizeof(uint64_t) + sizeof(uint32_t)));
+
+        memcpy(_registerValues, registerValues, registerCount * sizeof(uint64_t));
+
+        uint32_t offset = 0;
+        for (NSUInteger i = 0; i < registerCount; i++) {
+            size_t len = strlen(registerNames[i]) + 1;
+            _registerNameOffsets[i] = offset;
+            memcpy(_registerNames + offset, registerNames[i], len);
+            offset += len;
+        }
+    }
+    _registerCount = registerCount;
+
+    return self;
+}
+
+/**
+ * Initialize the crash log thread information from PLCrashReportStackFrameInfo and PLCrashReportRegisterInfo
+ * instances.
+ */
+- (id) initWithThreadNumber: (NSInteger) threadNumber
+                stackFrames: (NSArray *) stackFrames
+                    crashed: (BOOL) crashed
+                  registers: (NSArray *) registers
+{
+    NSUInteger frameCount = [stackFrames count];
+    NSUInteger registerCount = [registers count];
+    uint64_t *instructionPointers = malloc((frameCount > 0 ? frameCount : 1) * sizeof(uint64_t));
+    const char **symbolNames = malloc((frameCount > 0 ? frameCount : 1) * sizeof(const char *));
+    uint64_t *symbolOffsets = malloc((frameCount > 0 ? frameCount : 1) * sizeof(uint64_t));
+    uint64_t *registerValues = malloc((registerCount > 0 ? registerCount : 1) * sizeof(uint64_t));
+    const char **registerNames = malloc((registerCount > 0 ? registerCount : 1) * sizeof(const char *));
+
+    if (instructionPointers == NULL || symbolNames == NULL || symbolOffsets == NULL || registerValues == NULL || registerNames == NULL) {
+        free(instructionPointers);
+        free(symbolNames);
+        free(symbolOffsets);
+        free(registerValues);
+        free(registerNames);
+
+        [self release];
+        return nil;
+    }
+
+    for (NSUInteger i = 0; i < frameCount; i++) {
+        PLCrashReportStackFrameInfo *frame = [stackFrames objectAtIndex: i];
+        instructionPointers[i] = frame.instructionPointer;
+        symbolNames[i] = (frame.symbolName != nil) ? [frame.symbolName UTF8String] : NULL;
+        symbolOffsets[i] = frame.symbolOffset;
+    }
+
+    for (NSUInteger i = 0; i < registerCount; i++) {
+        PLCrashReportRegisterInfo *reg = [registers objectAtIndex: i];
+        registerValues[i] = reg.registerValue;
+        registerNames[i] = (reg.registerName != nil) ? [reg.registerName UTF8String] : "";
+    }
+
+    self = [self initWithThreadNumber: threadNumber
+                  instructionPointers: instructionPointers
+                          symbolNames: symbolNames
+                        symbolOffsets: symbolOffsets
+                      stackFrameCount: frameCount
+                              crashed: crashed
+                        registerNames: registerNames
+                       registerValues: registerValues
+                        registerCount: registerCount];
+
+    free(instructionPointers);
+    free(symbolNames);
+    free(symbolOffsets);
+    free(registerValues);
+    free(registerNames);
+
+    /* The supplied instances are vended as-is */
+    if (self != nil) {
+        _stackFrames = [stackFrames copy];
+        _registers = [registers copy];
+    }
 
     return self;
 }
 
 - (void) dealloc {
+    /* The symbol and register names and offsets share the symbol offset and register value allocations */
+    if (_instructionPointers != NULL)
+        free(_instructionPointers);
+
+    if (_symbolOffsets != NULL)
+        free(_symbolOffsets);
+
+    if (_registerValues != NULL)
+        free(_registerValues);
+
     [_stackFrames release];
     [_registers release];
     [super dealloc];
 }
 
+/**
+ * Return the instruction pointer of the frame at @a index. Raises an NSRangeException if @a index is beyond
+ * the end of the backtrace.
+ *
+ * @param index The frame index.
+ */
+- (uint64_t) instructionPointerAtIndex: (NSUInteger) index {
+    if (index >= _stackFrameCount)
+        [NSException raise: NSRangeException format: @"Frame index %lu beyond bounds %lu", (unsigned long) index, (unsigned long) _stackFrameCount];
+
+    return _instructionPointers[index];
+}
+
+/**
+ * Copy the instruction pointers of the frames in @a range into @a buffer. Raises an NSRangeException if
+ * @a range extends beyond the end of the backtrace.
+ *
+ * @param buffer A buffer large enough to hold range.length values.
+ * @param range The range of frames to copy.
+ */
+- (void) getInstructionPointers: (uint64_t *) buffer range: (NSRange) range {
+    if (range.location > _stackFrameCount || range.length > _stackFrameCount - range.location)
+        [NSException raise: NSRangeException format: @"Frame range %@ beyond bounds %lu", NSStringFromRange(range), (unsigned long) _stackFrameCount];
+
+    if (range.length > 0)
+        memcpy(buffer, _instructionPointers + range.location, range.length * sizeof(uint64_t));
+}
+
+/**
+ * Return the name of the nearest preceding symbol of the frame at @a index, as resolved in-process at crash time,
+ * or nil if the frame has no symbol. Raises an NSRangeException if @a index is beyond the end of the backtrace.
+ *
+ * @param index The frame index.
+ */
+- (NSString *) symbolNameAtIndex: (NSUInteger) index {
+    if (index >= _stackFrameCount)
+        [NSException raise: NSRangeException format: @"Frame index %lu beyond bounds %lu", (unsigned long) index, (unsigned long) _stackFrameCount];
+
+    if (_symbolOffsets == NULL || _symbolNameOffsets[index] == UINT32_MAX)
+        return nil;
+
+    return [NSString stringWithUTF8String: _symbolNames + _symbolNameOffsets[index]];
+}
+
+/**
+ * Return the offset of the frame at @a index from its symbol, or 0 if the frame has no symbol. Raises an
+ * NSRangeException if @a index is beyond the end of the backtrace.
+ *
+ * @param index The frame index.
+ */
+- (uint64_t) symbolOffsetAtIndex: (NSUInteger) index {
+    if (index >= _stackFrameCount)
+        [NSException raise: NSRangeException format: @"Frame index %lu beyond bounds %lu", (unsigned long) index, (unsigned long) _stackFrameCount];
+
+    if (_symbolOffsets == NULL)
+        return 0;
+
+    return _symbolOffsets[index];
+}
+
+/**
+ * Return the name of the register at @a index. Raises an NSRangeException if @a index is beyond the end of
+ * the register list.
+ *
+ * @param index The register index.
+ */
+- (NSString *) registerNameAtIndex: (NSUInteger) index {
+    if (index >= _registerCount)
+        [NSException raise: NSRangeException format: @"Register index %lu beyond bounds %lu", (unsigned long) index, (unsigned long) _registerCount];
+
+    return [NSString stringWithUTF8String: _registerNames + _registerNameOffsets[index]];
+}
+
+/**
+ * Return the value of the register at @a index. Raises an NSRangeException if @a index is beyond the end of
+ * the register list.
+ *
+ * @param index The register index.
+ */
+- (uint64_t) registerValueAtIndex: (NSUInteger) index {
+    if (index >= _registerCount)
+        [NSException raise: NSRangeException format: @"Register index %lu beyond bounds %lu", (unsigned long) index, (unsigned long) _registerCount];
+
+    return _registerValues[index];
+}
+
+/**
+ * Copy the values of the registers in @a range into @a buffer. Raises an NSRangeException if @a range extends
+ * beyond the end of the register list.
+ *
+ * @param buffer A buffer large enough to hold range.length values.
+ * @param range The range of registers to copy.
+ */
+- (void) getRegisterValues: (uint64_t *) buffer range: (NSRange) range {
+    if (range.location > _registerCount || range.length > _registerCount - range.location)
+        [NSException raise: NSRangeException format: @"Register range %@ beyond bounds %lu", NSStringFromRange(range), (unsigned long) _registerCount];
+
+    if (range.length > 0)
+        memcpy(buffer, _registerValues + range.location, range.length * sizeof(uint64_t));
+}
+
+// property getter. Creates the frame instances on first access.
+- (NSArray *) stackFrames {
+    @synchronized (self) {
+        if (_stackFrames != nil)
+            return _stackFrames;
+
+        NSMutableArray *frames = [NSMutableArray arrayWithCapacity: _stackFrameCount];
+        for (NSUInteger i = 0; i < _stackFrameCount; i++) {
+            PLCrashReportStackFrameInfo *frameInfo = [[PLCrashReportStackFrameInfo alloc] initWithInstructionPointer: _instructionPointers[i]
+                                                                                                   symbolName: [self symbolNameAtIndex: i]
+                                                                                                 symbolOffset: [self symbolOffsetAtIndex: i]];
+            [frames addObject: frameInfo];
+            [frameInfo release];
+        }
+
+        _stackFrames = [frames copy];
+        return _stackFrames;
+    }
+}
+
+// property getter. Creates the register instances on first access.
+- (NSArray *) registers {
+    @synchronized (self) {
+        if (_registers != nil)
+            return _registers;
+
+        NSMutableArray *registers = [NSMutableArray arrayWithCapacity: _registerCount];
+        for (NSUInteger i = 0; i < _registerCount; i++) {
+            PLCrashReportRegisterInfo *regInfo = [[PLCrashReportRegisterInfo alloc] initWithRegisterName: [self registerNameAtIndex: i]
+                                                                                          registerValue: _registerValues[i]];
+            [registers addObject: regInfo];
+            [regInfo release];
+        }
+
+        _registers = [registers copy];
+        return _registers;
+    }
+}
+
 @synthesize threadNumber = _threadNumber;
-@synthesize stackFrames = _stackFrames;
+@synthesize stackFrameCount = _stackFrameCount;
 @synthesize crashed = _crashed;
-@synthesize registers = _registers;
-
+@synthesize registerCount = _registerCount;
 
 @end
 
@@ -78,15 +435,35 @@
  * Initialize with the provided instruction pointer value.
  */
 - (id) initWithInstructionPointer: (uint64_t) instructionPointer {
+    return [self initWithInstructionPointer: instructionPointer symbolName: nil symbolOffset: 0];
+}
+
+/**
+ * Initialize with the provided instruction pointer value, and the frame's nearest preceding symbol.
+ *
+ * @param instructionPointer The frame's instruction pointer.
+ * @param symbolName The symbol name, or nil.
+ * @param symbolOffset The offset of @a instructionPointer from the symbol.
+ */
+- (id) initWithInstructionPointer: (uint64_t) instructionPointer symbolName: (NSString *) symbolName symbolOffset: (uint64_t) symbolOffset {
     if ((self = [super init]) == nil)
         return nil;
 
     _instructionPointer = instructionPointer;
+    _symbolName = [symbolName copy];
+    _symbolOffset = symbolOffset;
 
     return self;
 }
 
+- (void) dealloc {
+    [_symbolName release];
+    [super dealloc];
+}
+
 @synthesize instructionPointer = _instructionPointer;
+@synthesize symbolName = _symbolName;
+@synthesize symbolOffset = _symbolOffset;
 
 @end
 
@@ -0,0 +1,446 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PLCrashReportUnpack.h"
+
+#include <string.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_report_unpack Crash Report Decoder
+ * @ingroup plcrash_internal
+ *
+ * A decoder specialized for the plcrash.CrashReport schema.
+ *
+ * protobuf_c_message_unpack() is descriptor-driven: it looks up every tag in the message descriptor, buffers
+ * each scanned member, and then makes a second pass to convert the buffered members. The decoder implemented here
+ * dispatches directly on each message's known tags and writes values straight into the generated protobuf-c
+ * structures, which may be released with protobuf_c_message_free_unpacked() (or by destroying the arena they
+ * were allocated from) exactly as if they had been produced by protobuf_c_message_unpack().
+ *
+ * The decoder accepts and rejects exactly the same input as protobuf_c_message_unpack(), and produces the same
+ * field values, with one exception: unknown fields are validated and skipped, rather than being copied into
+ * the message's unknown_fields array.
+ *
+ * The per-message decoders are generated at build time from crash_report.proto by Tools/plcrash-unpack-gen.py,
+ * alongside the protoc-c output, so that they always cover every field in the schema. Only the wire-level
+ * helpers used by the generated code are implemented here.
+ *
+ * @{
+ */
+
+/**
+ * @internal
+ * A single scanned field.
+ */
+typedef struct plcrash_unpack_field {
+    /** Field number */
+    uint32_t tag;
+
+    /** Wire type */
+    uint8_t wire_type;
+
+    /** Field data. For length-delimited fields, this includes the length prefix. */
+    const uint8_t *data;
+
+    /** Length of data, in bytes. */
+    size_t len;
+
+    /** Length of the length prefix, or 0 if the field is not length-delimited. */
+    size_t prefix_len;
+} plcrash_unpack_field_t;
+
+/**
+ * @internal
+ * A specialized message decoder. Decodes @a len bytes of @a data into @a message, which must have been
+ * initialized with message_new(). Returns false on error, in which case @a message may be partially populated.
+ */
+typedef bool (*plcrash_unpack_fn) (ProtobufCAllocator *allocator, const uint8_t *data, size_t len, ProtobufCMessage *message);
+
+/* Value decoding. These mirror the (private) value parsers of protobuf-c.c, including their handling of
+ * over-long values, so that the results are identical. */
+
+static inline uint32_t parse_uint32 (size_t len, const uint8_t *data) {
+    uint32_t rv = data[0] & 0x7f;
+    if (len > 1) {
+        rv |= ((uint32_t) (data[1] & 0x7f) << 7);
+        if (len > 2) {
+            rv |= ((uint32_t) (data[2] & 0x7f) << 14);
+            if (len > 3) {
+                rv |= ((uint32_t) (data[3] & 0x7f) << 21);
+                if (len > 4)
+                    rv |= ((uint32_t) data[4] << 28);
+            }
+        }
+    }
+    return rv;
+}
+
+static inline uint64_t parse_uint64 (size_t len, const uint8_t *data) {
+    if (len < 5)
+        return parse_uint32(len, data);
+
+    uint64_t rv = ((uint64_t) (data[0] & 0x7f))
+                | ((uint64_t) (data[1] & 0x7f) << 7)
+                | ((uint64_t) (data[2] & 0x7f) << 14)
+                | ((uint64_t) (data[3] & 0x7f) << 21);
+    unsigned int shift = 28;
+    for (size_t i = 4; i < len; i++) {
+        rv |= ((uint64_t) (data[i] & 0x7f)) << shift;
+        shift += 7;
+    }
+    return rv;
+}
+
+static inline protobuf_c_boolean parse_boolean (size_t len, const uint8_t *data) {
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] & 0x7f)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @internal
+ * Scan the next field from @a at, advancing @a at and @a rem past the field. Returns false if the field
+ * is malformed.
+ */
+static bool next_field (const uint8_t **at, size_t *rem, plcrash_unpack_field_t *field) {
+    const uint8_t *data = *at;
+    size_t len = *rem;
+    size_t used;
+
+    /* Tag and wire type; at most 5 bytes */
+    {
+        size_t max = len > 5 ? 5 : len;
+        uint32_t tag = (data[0] & 0x7f) >> 3;
+        unsigned int shift = 4;
+
+        field->wire_type = data[0] & 7;
+        for (used = 1; (data[used - 1] & 0x80) != 0; used++) {
+            if (used == max)
+                return false;
+
+            if (data[used] & 0x80)
+                tag |= (uint32_t) (data[used] & 0x7f) << shift;
+            else
+                tag |= (uint32_t) data[used] << shift;
+            shift += 7;
+        }
+        field->tag = tag;
+    }
+
+    data += used;
+    len -= used;
+
+    field->data = data;
+    field->prefix_len = 0;
+
+    switch (field->wire_type) {
+        case PROTOBUF_C_WIRE_TYPE_VARINT: {
+            size_t max = len < 10 ? len : 10;
+            size_t i;
+            for (i = 0; i < max; i++) {
+                if ((data[i] & 0x80) == 0)
+                    break;
+            }
+            if (i == max)
+                return false;
+            field->len = i + 1;
+            break;
+        }
+
+        case PROTOBUF_C_WIRE_TYPE_64BIT:
+            if (len < 8)
+                return false;
+            field->len = 8;
+            break;
+
+        case PROTOBUF_C_WIRE_TYPE_32BIT:
+            if (len < 4)
+                return false;
+            field->len = 4;
+            break;
+
+        case PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED: {
+            size_t max = len < 5 ? len : 5;
+            uint32_t val = 0;
+            unsigned int shift = 0;
+            size_t i;
+            for (i = 0; i < max; i++) {
+                val |= (uint32_t) (data[i] & 0x7f) << shift;
+                shift += 7;
+                if ((data[i] & 0x80) == 0)
+                    break;
+            }
+            if (i == max)
+                return false;
+
+            field->prefix_len = i + 1;
+            if (val > len - field->prefix_len)
+                return false;
+            field->len = field->prefix_len + val;
+            break;
+        }
+
+        case PROTOBUF_C_WIRE_TYPE_START_GROUP:
+        case PROTOBUF_C_WIRE_TYPE_END_GROUP:
+            /* Groups are not supported */
+            return false;
+
+        default:
+            /* protobuf-c accepts the two undefined wire types as zero-length values */
+            field->len = 0;
+            break;
+    }
+
+    *at = data + field->len;
+    *rem = len - field->len;
+    return true;
+}
+
+static inline bool read_uint32 (const plcrash_unpack_field_t *field, uint32_t *value) {
+    if (field->wire_type != PROTOBUF_C_WIRE_TYPE_VARINT)
+        return false;
+    *value = parse_uint32(field->len, field->data);
+    return true;
+}
+
+static inline bool read_uint64 (const plcrash_unpack_field_t *field, uint64_t *value) {
+    if (field->wire_type != PROTOBUF_C_WIRE_TYPE_VARINT)
+        return false;
+    *value = parse_uint64(field->len, field->data);
+    return true;
+}
+
+static inline bool read_int64 (const plcrash_unpack_field_t *field, int64_t *value) {
+    if (field->wire_type != PROTOBUF_C_WIRE_TYPE_VARINT)
+        return false;
+    *value = (int64_t) parse_uint64(field->len, field->data);
+    return true;
+}
+
+/* Like protobuf-c, booleans are accepted with any wire type */
+static inline bool read_bool (const plcrash_unpack_field_t *field, protobuf_c_boolean *value) {
+    *value = parse_boolean(field->len, field->data);
+    return true;
+}
+
+static bool read_string (ProtobufCAllocator *allocator, const plcrash_unpack_field_t *field, char **value) {
+    if (field->wire_type != PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+        return false;
+
+    /* Replace any previous value */
+    if (*value != NULL)
+        allocator->free(allocator->allocator_data, *value);
+
+    size_t len = field->len - field->prefix_len;
+    *value = allocator->alloc(allocator->allocator_data, len + 1);
+    memcpy(*value, field->data + field->prefix_len, len);
+    (*value)[len] = '\0';
+    return true;
+}
+
+static bool read_bytes (ProtobufCAllocator *allocator, const plcrash_unpack_field_t *field, ProtobufCBinaryData *value) {
+    if (field->wire_type != PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+        return false;
+
+    /* Replace any previous value */
+    if (value->data != NULL)
+        allocator->free(allocator->allocator_data, value->data);
+
+    value->len = field->len - field->prefix_len;
+    value->data = allocator->alloc(allocator->allocator_data, value->len);
+    if (value->len > 0)
+        memcpy(value->data, field->data + field->prefix_len, value->len);
+    return true;
+}
+
+/**
+ * @internal
+ * Allocate and initialize a message, including any default field values.
+ */
+static ProtobufCMessage *message_new (ProtobufCAllocator *allocator, const ProtobufCMessageDescriptor *descriptor) {
+    ProtobufCMessage *message = allocator->alloc(allocator->allocator_data, descriptor->sizeof_message);
+    if (message == NULL)
+        return NULL;
+
+    memset(message, 0, descriptor->sizeof_message);
+    message->descriptor = descriptor;
+
+    /* The only defaults in this schema are enum defaults */
+    for (unsigned int i = 0; i < descriptor->n_fields; i++) {
+        const ProtobufCFieldDescriptor *field = &descriptor->fields[i];
+        if (field->default_value != NULL && field->label != PROTOBUF_C_LABEL_REPEATED && field->type == PROTOBUF_C_TYPE_ENUM)
+            memcpy((uint8_t *) message + field->offset, field->default_value, 4);
+    }
+
+    return message;
+}
+
+/**
+ * @internal
+ * Decode an embedded message into @a slot, replacing any previous value.
+ */
+static bool read_message (ProtobufCAllocator *allocator, const plcrash_unpack_field_t *field,
+                          const ProtobufCMessageDescriptor *descriptor, plcrash_unpack_fn unpack, void *slot)
+{
+    ProtobufCMessage **pmessage = slot;
+
+    if (field->wire_type != PROTOBUF_C_WIRE_TYPE_LENGTH_PREFIXED)
+        return false;
+
+    /* Replace any previous value */
+    if (*pmessage != NULL) {
+        protobuf_c_message_free_unpacked(*pmessage, allocator);
+        *pmessage = NULL;
+    }
+
+    ProtobufCMessage *message = message_new(allocator, descriptor);
+    if (message == NULL)
+        return false;
+
+    if (!unpack(allocator, field->data + field->prefix_len, field->len - field->prefix_len, message)) {
+        protobuf_c_message_free_unpacked(message, allocator);
+        return false;
+    }
+
+    *pmessage = message;
+    return true;
+}
+
+/**
+ * @internal
+ * Allocate a repeated field's array of @a count message pointers. The element count is left at zero, and
+ * incremented as each element is decoded, so that a partially decoded message may always be freed.
+ */
+static bool alloc_repeated (ProtobufCAllocator *allocator, size_t count, void *array) {
+    void **parray = array;
+
+    if (count == 0)
+        return true;
+
+    *parray = allocator->alloc(allocator->allocator_data, count * sizeof(ProtobufCMessage *));
+    return (*parray != NULL);
+}
+
+/**
+ * @internal
+ * Decode a repeated embedded message element, appending it to @a array.
+ */
+static bool read_repeated_message (ProtobufCAllocator *allocator, const plcrash_unpack_field_t *field,
+                                   const ProtobufCMessageDescriptor *descriptor, plcrash_unpack_fn unpack,
+                                   void *array, size_t *count)
+{
+    ProtobufCMessage **elements = *(ProtobufCMessage ***) array;
+
+    elements[*count] = NULL;
+    if (!read_message(allocator, field, descriptor, unpack, &elements[*count]))
+        return false;
+
+    (*count)++;
+    return true;
+}
+
+/**
+ * @internal
+ * Maps a message descriptor to its specialized decoder.
+ */
+typedef struct plcrash_unpack_entry {
+    /** Message descriptor */
+    const ProtobufCMessageDescriptor *descriptor;
+
+    /** Decoder */
+    plcrash_unpack_fn unpack;
+} plcrash_unpack_entry_t;
+
+/* The message decoders, and the unpack_table mapping each message descriptor to its decoder, are generated from
+ * crash_report.proto by Tools/plcrash-unpack-gen.py */
+#include "crash_report.unpack.h"
+
+/**
+ * Decode a plcrash.CrashReport message, or any of its nested message types, using the specialized decoder.
+ * This is a drop-in replacement for protobuf_c_message_unpack(); messages of any other type are passed
+ * through to protobuf_c_message_unpack().
+ *
+ * @param descriptor The message descriptor.
+ * @param allocator The allocator to use for the message and all of its fields. If NULL,
+ * protobuf_c_default_allocator will be used.
+ * @param len The length of @a data.
+ * @param data The encoded message.
+ *
+ * @return The decoded message, or NULL on error. The message must be released with
+ * protobuf_c_message_free_unpacked(), or by destroying the arena it was allocated from.
+ */
+ProtobufCMessage *plcrash_report_unpack_message (const ProtobufCMessageDescriptor *descriptor, ProtobufCAllocator *allocator,
+                                                 size_t len, const uint8_t *data)
+{
+    plcrash_unpack_fn unpack = NULL;
+
+    if (allocator == NULL)
+        allocator = &protobuf_c_default_allocator;
+
+    for (size_t i = 0; i < sizeof(unpack_table) / sizeof(unpack_table[0]); i++) {
+        if (unpack_table[i].descriptor == descriptor) {
+            unpack = unpack_table[i].unpack;
+            break;
+        }
+    }
+
+    if (unpack == NULL)
+        return protobuf_c_message_unpack(descriptor, allocator, len, data);
+
+    ProtobufCMessage *message = message_new(allocator, descriptor);
+    if (message == NULL)
+        return NULL;
+
+    if (!unpack(allocator, data, len, message)) {
+        protobuf_c_message_free_unpacked(message, allocator);
+        return NULL;
+    }
+
+    return message;
+}
+
+/**
+ * Decode a complete plcrash.CrashReport message. Equivalent to plcrash__crash_report__unpack().
+ *
+ * @param allocator The allocator to use. If NULL, protobuf_c_default_allocator will be used.
+ * @param len The length of @a data.
+ * @param data The encoded crash report message.
+ *
+ * @return The decoded message, or NULL on error. The message must be released with
+ * protobuf_c_message_free_unpacked(), or by destroying the arena it was allocated from.
+ */
+Plcrash__CrashReport *plcrash_report_unpack (ProtobufCAllocator *allocator, size_t len, const uint8_t *data) {
+    return (Plcrash__CrashReport *) plcrash_report_unpack_message(&plcrash__crash_report__descriptor, allocator, len, data);
+}
+
+/**
+ * @} plcrash_report_unpack
+ */
@@ -0,0 +1,510 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2010 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+#import "PLCrashReportUnpack.h"
+#import "PLCrashReportSummary.h"
+#import "PLCrashFrameWalker.h"
+#import "PLCrashLogWriter.h"
+
+#import <fcntl.h>
+
+#import <mach-o/dyld.h>
+#import <mach/mach_time.h>
+
+@interface PLCrashReportUnpackTests : SenTestCase {
+@private
+    /* Path to crash log */
+    NSString *_logPath;
+
+    /* Test thread */
+    plframe_test_thead_t _thr_args;
+
+    /* Encoded report message, without the file header */
+    NSData *_message;
+}
+
+@end
+
+/* Fuzzing iteration count, and the maximum number of bytes a mutation may insert */
+#define FUZZ_ITERATIONS 20000
+#define FUZZ_MAX_GROWTH 64
+
+/*
+ * Compare two unpacked messages field by field, driven by the message descriptor. Unknown fields are not compared,
+ * as the specialized decoder does not retain them.
+ */
+static bool message_equal (const ProtobufCMessage *a, const ProtobufCMessage *b) {
+    if (a == NULL || b == NULL)
+        return a == b;
+
+    const ProtobufCMessageDescriptor *desc = a->descriptor;
+    if (desc != b->descriptor)
+        return false;
+
+    for (unsigned i = 0; i < desc->n_fields; i++) {
+        const ProtobufCFieldDescriptor *field = &desc->fields[i];
+        const uint8_t *pa = (const uint8_t *) a + field->offset;
+        const uint8_t *pb = (const uint8_t *) b + field->offset;
+
+        /* Repeated fields are all messages in crash_report.proto */
+        if (field->label == PROTOBUF_C_LABEL_REPEATED) {
+            size_t count = *(const size_t *) ((const uint8_t *) a + field->quantifier_offset);
+            if (count != *(const size_t *) ((const uint8_t *) b + field->quantifier_offset))
+                return false;
+
+            for (size_t j = 0; j < count; j++) {
+                if (!message_equal((*(ProtobufCMessage * const *const *) pa)[j], (*(ProtobufCMessage * const *const *) pb)[j]))
+                    return false;
+            }
+            continue;
+        }
+
+        if (field->label == PROTOBUF_C_LABEL_OPTIONAL && field->quantifier_offset != 0) {
+            protobuf_c_boolean has_a = *(const protobuf_c_boolean *) ((const uint8_t *) a + field->quantifier_offset);
+            protobuf_c_boolean has_b = *(const protobuf_c_boolean *) ((const uint8_t *) b + field->quantifier_offset);
+            if (has_a != has_b)
+                return false;
+        }
+
+        switch (field->type) {
+            case PROTOBUF_C_TYPE_UINT32:
+            case PROTOBUF_C_TYPE_ENUM:
+                if (memcmp(pa, pb, sizeof(uint32_t)) != 0)
+                    return false;
+                break;
+
+            case PROTOBUF_C_TYPE_UINT64:
+            case PROTOBUF_C_TYPE_INT64:
+                if (memcmp(pa, pb, sizeof(uint64_t)) != 0)
+                    return false;
+                break;
+
+            case PROTOBUF_C_TYPE_BOOL:
+                if (*(const protobuf_c_boolean *) pa != *(const protobuf_c_boolean *) pb)
+                    return false;
+                break;
+
+            case PROTOBUF_C_TYPE_STRING: {
+                const char *sa = *(char * const *) pa;
+                const char *sb = *(char * const *) pb;
+                if (sa == NULL || sb == NULL) {
+                    if (sa != sb)
+                        return false;
+                } else if (strcmp(sa, sb) != 0) {
+                    return false;
+                }
+                break;
+            }
+
+            case PROTOBUF_C_TYPE_BYTES: {
+                const ProtobufCBinaryData *ba = (const ProtobufCBinaryData *) pa;
+                const ProtobufCBinaryData *bb = (const ProtobufCBinaryData *) pb;
+                if (ba->len != bb->len || (ba->len > 0 && memcmp(ba->data, bb->data, ba->len) != 0))
+                    return false;
+                break;
+            }
+
+            case PROTOBUF_C_TYPE_MESSAGE:
+                if (!message_equal(*(ProtobufCMessage * const *) pa, *(ProtobufCMessage * const *) pb))
+                    return false;
+                break;
+
+            default:
+                /* Not used by crash_report.proto */
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Allocate a message of type @a descriptor with every field set, recursing into embedded messages and populating
+ * each repeated field with two elements. Values are derived from @a seed, so that no two fields share a value.
+ * Returns NULL if the schema uses a field type this function does not support.
+ */
+static ProtobufCMessage *populated_message (const ProtobufCMessageDescriptor *descriptor, uint64_t *seed) {
+    ProtobufCMessage *message = calloc(1, descriptor->sizeof_message);
+    message->descriptor = descriptor;
+
+    for (unsigned i = 0; i < descriptor->n_fields; i++) {
+        const ProtobufCFieldDescriptor *field = &descriptor->fields[i];
+        uint8_t *member = (uint8_t *) message + field->offset;
+
+        /* Repeated fields are all messages in crash_report.proto */
+        if (field->label == PROTOBUF_C_LABEL_REPEATED) {
+            if (field->type != PROTOBUF_C_TYPE_MESSAGE) {
+                protobuf_c_message_free_unpacked(message, &protobuf_c_system_allocator);
+                return NULL;
+            }
+
+            ProtobufCMessage **elements = calloc(2, sizeof(ProtobufCMessage *));
+            *(ProtobufCMessage ***) member = elements;
+            for (size_t j = 0; j < 2; j++) {
+                if ((elements[j] = populated_message(field->descriptor, seed)) == NULL) {
+                    protobuf_c_message_free_unpacked(message, &protobuf_c_system_allocator);
+                    return NULL;
+                }
+                *(size_t *) ((uint8_t *) message + field->quantifier_offset) = j + 1;
+            }
+            continue;
+        }
+
+        if (field->label == PROTOBUF_C_LABEL_OPTIONAL && field->quantifier_offset != 0)
+            *(protobuf_c_boolean *) ((uint8_t *) message + field->quantifier_offset) = 1;
+
+        (*seed)++;
+        switch (field->type) {
+            case PROTOBUF_C_TYPE_UINT32:
+                *(uint32_t *) member = (uint32_t) (*seed * 0x01010101);
+                break;
+
+            case PROTOBUF_C_TYPE_ENUM:
+                /* A defined, non-default value of every enum in crash_report.proto */
+                *(uint32_t *) member = 1;
+                break;
+
+            case PROTOBUF_C_TYPE_UINT64:
+            case PROTOBUF_C_TYPE_INT64:
+                *(uint64_t *) member = *seed * 0x0101010101010101ULL;
+                break;
+
+            case PROTOBUF_C_TYPE_BOOL:
+                *(protobuf_c_boolean *) member = 1;
+                break;
+
+            case PROTOBUF_C_TYPE_STRING: {
+                char *value = malloc(32);
+                snprintf(value, 32, "%s-%llu", field->name, (unsigned long long) *seed);
+                *(char **) member = value;
+                break;
+            }
+
+            case PROTOBUF_C_TYPE_BYTES: {
+                ProtobufCBinaryData *value = (ProtobufCBinaryData *) member;
+                value->len = 16;
+                value->data = malloc(value->len);
+                for (size_t j = 0; j < value->len; j++)
+                    value->data[j] = (uint8_t) (*seed + j);
+                break;
+            }
+
+            case PROTOBUF_C_TYPE_MESSAGE:
+                if ((*(ProtobufCMessage **) member = populated_message(field->descriptor, seed)) == NULL) {
+                    protobuf_c_message_free_unpacked(message, &protobuf_c_system_allocator);
+                    return NULL;
+                }
+                break;
+
+            default:
+                protobuf_c_message_free_unpacked(message, &protobuf_c_system_allocator);
+                return NULL;
+        }
+    }
+
+    return message;
+}
+
+/* Apply between one and four random mutations to buf, returning the new length. The buffer must have
+ * FUZZ_MAX_GROWTH bytes of spare capacity beyond orig_len. */
+static size_t mutate (uint8_t *buf, size_t len, size_t orig_len) {
+    /* Bytes likely to land on a tag, length prefix, or varint continuation boundary */
+    static const uint8_t interesting[] = { 0x00, 0x7F, 0x80, 0xFF, 0x0A, 0x12, 0x1A, 0x22, 0x06, 0x07, 0x0B, 0x0C };
+    int count = 1 + (random() % 4);
+
+    for (int i = 0; i < count; i++) {
+        switch (random() % 5) {
+            case 0:
+                buf[random() % len] ^= 1 << (random() % 8);
+                break;
+
+            case 1:
+                buf[random() % len] = random();
+                break;
+
+            case 2:
+                len = random() % (len + 1);
+                if (len == 0)
+                    len = 1;
+                break;
+
+            case 3:
+                if (len < orig_len + FUZZ_MAX_GROWTH) {
+                    size_t pos = random() % len;
+                    memmove(buf + pos + 1, buf + pos, len - pos);
+                    buf[pos] = random();
+                    len++;
+                }
+                break;
+
+            case 4:
+                buf[random() % len] = interesting[random() % sizeof(interesting)];
+                break;
+        }
+    }
+
+    return len;
+}
+
+@implementation PLCrashReportUnpackTests
+
+- (void) setUp {
+    siginfo_t info;
+    plframe_thread_state_t thread_state;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+
+    /* Create a temporary log path */
+    _logPath = [[NSTemporaryDirectory() stringByAppendingString: [[NSProcessInfo processInfo] globallyUniqueString]] retain];
+
+    /* Create the test thread */
+    plframe_test_thread_spawn(&_thr_args);
+
+    /* Initialze faux crash data */
+    {
+        info.si_addr = 0x0;
+        info.si_errno = 0;
+        info.si_pid = getpid();
+        info.si_uid = getuid();
+        info.si_code = SEGV_MAPERR;
+        info.si_signo = SIGSEGV;
+        info.si_status = 0;
+
+        /* Steal the test thread's state for iteration */
+        plframe_thread_state_fetch(&thread_state, pthread_mach_thread_np(_thr_args.thread));
+    }
+
+    /* Write a complete report, including every optional section */
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    plcrash_log_writer_set_exception(&writer, [NSException exceptionWithName: @"TestException" reason: @"TestReason" userInfo: nil]);
+    plcrash_log_writer_enable_symbolication(&writer, PLCRASH_LOG_WRITER_DEFAULT_SYMBOLICATION_LIMIT);
+
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++)
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, pthread_mach_thread_np(_thr_args.thread), &file, &info, &thread_state.uap), @"Crash log failed");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write_secondary_crash(&writer, &file, &info, 0x42), @"Writing secondary crash failed");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write_handler_info(&writer, &file, 65536, 4096), @"Writing handler info failed");
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+
+    /* Strip the file header and summary */
+    NSData *data = [NSData dataWithContentsOfFile: _logPath];
+    size_t offset;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_data_offset([data bytes], [data length], &offset), @"Invalid report header");
+    _message = [[data subdataWithRange: NSMakeRange(offset, [data length] - offset)] retain];
+}
+
+- (void) tearDown {
+    NSError *error;
+
+    /* Delete the file */
+    STAssertTrue([[NSFileManager defaultManager] removeItemAtPath: _logPath error: &error], @"Could not remove log file");
+    [_logPath release];
+    [_message release];
+
+    /* Stop the test thread */
+    plframe_test_thread_stop(&_thr_args);
+}
+
+/* Verify that an unmodified report decodes identically via both decoders */
+- (void) testUnpack {
+    ProtobufCMessage *generic;
+    Plcrash__CrashReport *specialized;
+
+    generic = protobuf_c_message_unpack(&plcrash__crash_report__descriptor, &protobuf_c_system_allocator, [_message length], [_message bytes]);
+    specialized = plcrash_report_unpack(&protobuf_c_system_allocator, [_message length], [_message bytes]);
+
+    STAssertNotNULL(generic, @"Generic decoder failed");
+    STAssertNotNULL(specialized, @"Specialized decoder failed");
+    STAssertTrue(message_equal(generic, &specialized->base), @"Decoded reports differ");
+
+    STAssertNotNULL(specialized->exception, @"Missing exception");
+    STAssertNotNULL(specialized->handler_info, @"Missing handler info");
+    STAssertEquals((size_t) 1, specialized->n_secondary_crashes, @"Incorrect secondary crash count");
+    STAssertEquals((uint64_t) 0x42, specialized->secondary_crashes[0]->pc, @"Incorrect secondary crash PC");
+
+    protobuf_c_message_free_unpacked(generic, &protobuf_c_system_allocator);
+    protobuf_c_message_free_unpacked(&specialized->base, &protobuf_c_system_allocator);
+
+    /* Individual sections are dispatched by descriptor */
+    {
+        ProtobufCArena arena;
+        protobuf_c_arena_init(&arena, [_message length]);
+        Plcrash__CrashReport *report = plcrash_report_unpack(&arena.allocator, [_message length], [_message bytes]);
+        STAssertNotNULL(report, @"Arena decode failed");
+
+        /* Re-encode the system info, and decode it as a standalone message */
+        size_t len = protobuf_c_message_get_packed_size(&report->system_info->base);
+        uint8_t *buf = malloc(len);
+        protobuf_c_message_pack(&report->system_info->base, buf);
+
+        ProtobufCMessage *info = plcrash_report_unpack_message(&plcrash__crash_report__system_info__descriptor, &protobuf_c_system_allocator, len, buf);
+        STAssertNotNULL(info, @"Section decode failed");
+        STAssertTrue(message_equal(info, &report->system_info->base), @"Decoded sections differ");
+
+        protobuf_c_message_free_unpacked(info, &protobuf_c_system_allocator);
+        free(buf);
+        protobuf_c_arena_destroy(&arena);
+    }
+}
+
+/*
+ * Verify that every field in the schema is decoded. A report with every descriptor field set must decode to the
+ * encoded message via both decoders.
+ */
+- (void) testAllFields {
+    uint64_t seed = 0;
+    ProtobufCMessage *report = populated_message(&plcrash__crash_report__descriptor, &seed);
+    STAssertNotNULL(report, @"Schema uses a field type not supported by populated_message()");
+    if (report == NULL)
+        return;
+
+    size_t len = protobuf_c_message_get_packed_size(report);
+    uint8_t *buf = malloc(len);
+    protobuf_c_message_pack(report, buf);
+
+    ProtobufCMessage *generic = protobuf_c_message_unpack(&plcrash__crash_report__descriptor, &protobuf_c_system_allocator, len, buf);
+    Plcrash__CrashReport *specialized = plcrash_report_unpack(&protobuf_c_system_allocator, len, buf);
+
+    STAssertNotNULL(generic, @"Generic decoder failed");
+    STAssertNotNULL(specialized, @"Specialized decoder failed");
+    STAssertTrue(message_equal(report, generic), @"Generic decoder did not reproduce the encoded report");
+    STAssertTrue(message_equal(report, &specialized->base), @"Specialized decoder dropped or altered a field");
+
+    if (generic != NULL)
+        protobuf_c_message_free_unpacked(generic, &protobuf_c_system_allocator);
+    if (specialized != NULL)
+        protobuf_c_message_free_unpacked(&specialized->base, &protobuf_c_system_allocator);
+    protobuf_c_message_free_unpacked(report, &protobuf_c_system_allocator);
+    free(buf);
+}
+
+/*
+ * Differential fuzz test. Randomly mutated reports must be accepted or rejected identically by the generic and
+ * specialized decoders, and accepted reports must decode to identical messages.
+ */
+- (void) testDifferentialFuzz {
+    size_t orig_len = [_message length];
+    uint8_t *buf = malloc(orig_len + FUZZ_MAX_GROWTH);
+    NSUInteger accepted = 0;
+
+    /* Fixed seed, for reproducible failures */
+    srandom(1234);
+
+    for (NSUInteger i = 0; i < FUZZ_ITERATIONS; i++) {
+        memcpy(buf, [_message bytes], orig_len);
+        size_t len = mutate(buf, orig_len, orig_len);
+
+        /* Copy to an exact-length allocation, so that any over-read is caught by the guard malloc */
+        uint8_t *input = malloc(len);
+        memcpy(input, buf, len);
+
+        ProtobufCArena arena;
+        protobuf_c_arena_init(&arena, len);
+
+        ProtobufCMessage *generic = protobuf_c_message_unpack(&plcrash__crash_report__descriptor, &protobuf_c_system_allocator, len, input);
+        Plcrash__CrashReport *specialized = plcrash_report_unpack(&protobuf_c_system_allocator, len, input);
+        Plcrash__CrashReport *arena_specialized = plcrash_report_unpack(&arena.allocator, len, input);
+
+        if (generic == NULL) {
+            STAssertNULL(specialized, @"Iteration %lu: specialized decoder accepted a report rejected by the generic decoder", (unsigned long) i);
+            STAssertNULL(arena_specialized, @"Iteration %lu: specialized decoder accepted a report rejected by the generic decoder", (unsigned long) i);
+        } else {
+            STAssertNotNULL(specialized, @"Iteration %lu: specialized decoder rejected a report accepted by the generic decoder", (unsigned long) i);
+            STAssertNotNULL(arena_specialized, @"Iteration %lu: specialized decoder rejected a report accepted by the generic decoder", (unsigned long) i);
+            if (specialized != NULL)
+                STAssertTrue(message_equal(generic, &specialized->base), @"Iteration %lu: decoded reports differ", (unsigned long) i);
+            if (arena_specialized != NULL)
+                STAssertTrue(message_equal(generic, &arena_specialized->base), @"Iteration %lu: decoded reports differ", (unsigned long) i);
+            accepted++;
+        }
+
+        if (generic != NULL)
+            protobuf_c_message_free_unpacked(generic, &protobuf_c_system_allocator);
+        if (specialized != NULL)
+            protobuf_c_message_free_unpacked(&specialized->base, &protobuf_c_system_allocator);
+        protobuf_c_arena_destroy(&arena);
+        free(input);
+    }
+
+    free(buf);
+    NSLog(@"Differential fuzz: %u iterations, %lu mutated reports accepted", FUZZ_ITERATIONS, (unsigned long) accepted);
+}
+
+/* Compare decode-and-free throughput of the generic and specialized decoders, using the arena allocator */
+- (void) testDecodePerformance {
+    const int iterations = 500;
+    const uint8_t *bytes = [_message bytes];
+    size_t len = [_message length];
+    mach_timebase_info_data_t timebase;
+
+    mach_timebase_info(&timebase);
+
+    /* Generic, reflective decoder */
+    uint64_t generic_total = 0;
+    for (int i = 0; i < iterations; i++) {
+        uint64_t start = mach_absolute_time();
+        ProtobufCArena arena;
+        protobuf_c_arena_init(&arena, len);
+        Plcrash__CrashReport *report = plcrash__crash_report__unpack(&arena.allocator, len, bytes);
+        STAssertNotNULL(report, @"Could not decode report");
+        protobuf_c_arena_destroy(&arena);
+        generic_total += mach_absolute_time() - start;
+    }
+
+    /* Specialized decoder */
+    uint64_t specialized_total = 0;
+    for (int i = 0; i < iterations; i++) {
+        uint64_t start = mach_absolute_time();
+        ProtobufCArena arena;
+        protobuf_c_arena_init(&arena, len);
+        Plcrash__CrashReport *report = plcrash_report_unpack(&arena.allocator, len, bytes);
+        STAssertNotNULL(report, @"Could not decode report");
+        protobuf_c_arena_destroy(&arena);
+        specialized_total += mach_absolute_time() - start;
+    }
+
+    uint64_t generic_ns = (generic_total * timebase.numer / timebase.denom) / iterations;
+    uint64_t specialized_ns = (specialized_total * timebase.numer / timebase.denom) / iterations;
+    NSLog(@"Decode and free: bytes=%zu generic=%llu ns (%.1f MB/s) specialized=%llu ns (%.1f MB/s)",
+          len,
+          generic_ns, generic_ns ? (len * 1000.0 / generic_ns) : 0.0,
+          specialized_ns, specialized_ns ? (len * 1000.0 / specialized_ns) : 0.0);
+}
+
+@end
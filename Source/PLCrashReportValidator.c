@@ -0,0 +1,652 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashReportValidator.h"
+#import "PLCrashReportDecoder.h"
+#import "PLCrashReportSummary.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_report_validator Crash Report Validator
+ * @ingroup plcrash_internal
+ *
+ * Structural validation of encoded crash reports.
+ *
+ * plcrash_report_validate() walks the wire format of a crash report file once, without allocating memory or
+ * decoding any values, and verifies that:
+ *
+ * - The file magic, version, and summary header are valid.
+ * - All keys, varints and length prefixes are well-formed, and every field lies within its enclosing message.
+ * - Every known field is encoded with the wire type declared in crash_report.proto.
+ * - Every required field declared in crash_report.proto is present, as is every top-level section required by
+ *   plcrash_report_decoder_init() (see plcrash_report_required_fields).
+ * - Every binary image UUID is 16 bytes.
+ * - The summary header's section offsets and crashed thread index refer to the corresponding sections of the
+ *   report.
+ *
+ * The first error found is reported with its file offset and the path of the enclosing messages. A report
+ * that passes validation will be accepted by protobuf_c_message_unpack() and plcrash_report_decoder_init().
+ * Unknown fields are checked for well-formedness only.
+ *
+ * @{
+ */
+
+/** @internal Protobuf wire types */
+enum {
+    WIRE_TYPE_VARINT = 0,
+    WIRE_TYPE_64BIT = 1,
+    WIRE_TYPE_LENGTH_DELIMITED = 2,
+    WIRE_TYPE_32BIT = 5
+};
+
+/** @internal Field labels */
+enum {
+    LABEL_OPTIONAL = 0,
+    LABEL_REQUIRED,
+    LABEL_REPEATED
+};
+
+/** @internal Message types of crash_report.proto */
+enum {
+    MSG_NONE = -1,
+    MSG_REPORT = 0,
+    MSG_PROCESSOR,
+    MSG_SYSTEM_INFO,
+    MSG_APP_INFO,
+    MSG_THREAD,
+    MSG_FRAME,
+    MSG_REGISTER,
+    MSG_IMAGE,
+    MSG_EXCEPTION,
+    MSG_SIGNAL,
+    MSG_PROCESS_INFO,
+    MSG_MACHINE_INFO,
+    MSG_HANDLER_INFO,
+    MSG_SECONDARY_CRASH,
+    MSG_COUNT
+};
+
+/** @internal Largest field number declared in crash_report.proto */
+#define SCHEMA_MAX_FIELD 10
+
+/** @internal Top-level field number of the threads */
+#define REPORT_THREADS_FIELD 3
+
+/** @internal Binary image field number of the UUID */
+#define IMAGE_UUID_FIELD 4
+
+/** @internal Required UUID length */
+#define IMAGE_UUID_LENGTH 16
+
+/**
+ * @internal
+ * A field declaration.
+ */
+typedef struct schema_field {
+    /** Field number */
+    uint32_t number;
+
+    /** Field name */
+    const char *name;
+
+    /** Expected wire type */
+    uint8_t wire_type;
+
+    /** Field label */
+    uint8_t label;
+
+    /** Embedded message type, or MSG_NONE */
+    int message;
+} schema_field_t;
+
+/**
+ * @internal
+ * A message declaration.
+ */
+typedef struct schema_message {
+    /** Field declarations */
+    const schema_field_t *fields;
+
+    /** Number of fields */
+    size_t field_count;
+} schema_message_t;
+
+/** @internal CrashReport */
+static const schema_field_t report_fields[] = {
+    { 1, "system_info", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_SYSTEM_INFO },
+    { 2, "application_info", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_APP_INFO },
+    { 3, "threads", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REPEATED, MSG_THREAD },
+    { 4, "binary_images", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REPEATED, MSG_IMAGE },
+    { 5, "exception", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_EXCEPTION },
+    { 6, "signal", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_SIGNAL },
+    { 7, "process_info", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_PROCESS_INFO },
+    { 8, "machine_info", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_MACHINE_INFO },
+    { 9, "handler_info", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_HANDLER_INFO },
+    { 10, "secondary_crashes", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REPEATED, MSG_SECONDARY_CRASH }
+};
+
+/** @internal CrashReport.Processor */
+static const schema_field_t processor_fields[] = {
+    { 1, "encoding", WIRE_TYPE_VARINT, LABEL_OPTIONAL, MSG_NONE },
+    { 2, "type", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 3, "subtype", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE }
+};
+
+/** @internal CrashReport.SystemInfo */
+static const schema_field_t system_info_fields[] = {
+    { 1, "operating_system", WIRE_TYPE_VARINT, LABEL_OPTIONAL, MSG_NONE },
+    { 2, "os_version", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_NONE },
+    { 3, "architecture", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 4, "timestamp", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 5, "os_build", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_NONE }
+};
+
+/** @internal CrashReport.ApplicationInfo */
+static const schema_field_t app_info_fields[] = {
+    { 1, "identifier", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_NONE },
+    { 2, "version", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_NONE }
+};
+
+/** @internal CrashReport.Thread */
+static const schema_field_t thread_fields[] = {
+    { 1, "thread_number", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 2, "frames", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REPEATED, MSG_FRAME },
+    { 3, "crashed", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 4, "registers", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REPEATED, MSG_REGISTER }
+};
+
+/** @internal CrashReport.Thread.StackFrame */
+static const schema_field_t frame_fields[] = {
+    { 3, "pc", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 4, "symbol_name", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_NONE },
+    { 5, "symbol_offset", WIRE_TYPE_VARINT, LABEL_OPTIONAL, MSG_NONE }
+};
+
+/** @internal CrashReport.Thread.RegisterValue */
+static const schema_field_t register_fields[] = {
+    { 1, "name", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_NONE },
+    { 2, "value", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE }
+};
+
+/** @internal CrashReport.BinaryImage */
+static const schema_field_t image_fields[] = {
+    { 1, "base_address", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 2, "size", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 3, "name", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_NONE },
+    { 4, "uuid", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_NONE },
+    { 5, "code_type", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_PROCESSOR }
+};
+
+/** @internal CrashReport.Exception */
+static const schema_field_t exception_fields[] = {
+    { 1, "name", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_NONE },
+    { 2, "reason", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_NONE }
+};
+
+/** @internal CrashReport.Signal */
+static const schema_field_t signal_fields[] = {
+    { 1, "name", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_NONE },
+    { 2, "code", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_NONE },
+    { 3, "address", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE }
+};
+
+/** @internal CrashReport.ProcessInfo */
+static const schema_field_t process_info_fields[] = {
+    { 1, "process_name", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_NONE },
+    { 2, "process_id", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 3, "process_path", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_NONE },
+    { 4, "parent_process_name", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_NONE },
+    { 5, "parent_process_id", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 6, "native", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE }
+};
+
+/** @internal CrashReport.MachineInfo */
+static const schema_field_t machine_info_fields[] = {
+    { 1, "model", WIRE_TYPE_LENGTH_DELIMITED, LABEL_OPTIONAL, MSG_NONE },
+    { 2, "processor", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_PROCESSOR },
+    { 3, "processor_count", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 4, "logical_processor_count", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE }
+};
+
+/** @internal CrashReport.HandlerInfo */
+static const schema_field_t handler_info_fields[] = {
+    { 1, "stack_size", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE },
+    { 2, "stack_used", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE }
+};
+
+/** @internal CrashReport.SecondaryCrash */
+static const schema_field_t secondary_crash_fields[] = {
+    { 1, "signal", WIRE_TYPE_LENGTH_DELIMITED, LABEL_REQUIRED, MSG_SIGNAL },
+    { 2, "pc", WIRE_TYPE_VARINT, LABEL_REQUIRED, MSG_NONE }
+};
+
+#define SCHEMA_MESSAGE(fields) { fields, sizeof(fields) / sizeof(fields[0]) }
+
+/** @internal Message declarations, indexed by message type */
+static const schema_message_t schema[MSG_COUNT] = {
+    [MSG_REPORT] = SCHEMA_MESSAGE(report_fields),
+    [MSG_PROCESSOR] = SCHEMA_MESSAGE(processor_fields),
+    [MSG_SYSTEM_INFO] = SCHEMA_MESSAGE(system_info_fields),
+    [MSG_APP_INFO] = SCHEMA_MESSAGE(app_info_fields),
+    [MSG_THREAD] = SCHEMA_MESSAGE(thread_fields),
+    [MSG_FRAME] = SCHEMA_MESSAGE(frame_fields),
+    [MSG_REGISTER] = SCHEMA_MESSAGE(register_fields),
+    [MSG_IMAGE] = SCHEMA_MESSAGE(image_fields),
+    [MSG_EXCEPTION] = SCHEMA_MESSAGE(exception_fields),
+    [MSG_SIGNAL] = SCHEMA_MESSAGE(signal_fields),
+    [MSG_PROCESS_INFO] = SCHEMA_MESSAGE(process_info_fields),
+    [MSG_MACHINE_INFO] = SCHEMA_MESSAGE(machine_info_fields),
+    [MSG_HANDLER_INFO] = SCHEMA_MESSAGE(handler_info_fields),
+    [MSG_SECONDARY_CRASH] = SCHEMA_MESSAGE(secondary_crash_fields)
+};
+
+/** @internal Top-level field numbers of each plcrash_report_section_t */
+static const uint32_t section_fields[PLCRASH_REPORT_SECTION_COUNT] = {
+    [PLCRASH_REPORT_SECTION_SYSTEM_INFO] = 1,
+    [PLCRASH_REPORT_SECTION_MACHINE_INFO] = 8,
+    [PLCRASH_REPORT_SECTION_APP_INFO] = 2,
+    [PLCRASH_REPORT_SECTION_PROCESS_INFO] = 7,
+    [PLCRASH_REPORT_SECTION_THREADS] = 3,
+    [PLCRASH_REPORT_SECTION_CRASHED_THREAD] = 3,
+    [PLCRASH_REPORT_SECTION_BINARY_IMAGES] = 4,
+    [PLCRASH_REPORT_SECTION_EXCEPTION] = 5,
+    [PLCRASH_REPORT_SECTION_SIGNAL] = 6
+};
+
+/**
+ * @internal
+ * Validation state.
+ */
+typedef struct validator {
+    /** Start of the report file */
+    const uint8_t *file;
+
+    /** Result */
+    plcrash_report_validation_t *result;
+
+    /** True if the report includes a summary header */
+    bool has_summary;
+
+    /** The summary header, if any */
+    plcrash_report_summary_t summary;
+
+    /** Bitmask of summary sections whose offsets matched a top-level field */
+    uint32_t matched_sections;
+
+    /** Bitmask of summary sections whose offsets referred to a different field */
+    uint32_t mismatched_sections;
+} validator_t;
+
+/**
+ * @internal
+ * Look up field @a number of message @a type, returning NULL if the field is not declared.
+ */
+static const schema_field_t *schema_field (int type, uint32_t number) {
+    const schema_message_t *message = &schema[type];
+
+    /* Fields are declared in order, and most messages number them densely from 1 */
+    if (number > 0 && number <= message->field_count && message->fields[number - 1].number == number)
+        return &message->fields[number - 1];
+
+    for (size_t i = 0; i < message->field_count; i++) {
+        if (message->fields[i].number == number)
+            return &message->fields[i];
+    }
+    return NULL;
+}
+
+/**
+ * @internal
+ * Record a validation failure at @a p, and return false.
+ */
+static bool fail (validator_t *v, plcrash_report_validation_code_t code, const uint8_t *p, uint32_t field) {
+    v->result->code = code;
+    v->result->offset = p - v->file;
+    v->result->field = field;
+    return false;
+}
+
+/**
+ * @internal
+ * Read a varint of at most 10 bytes, advancing @a p. Returns false if the varint is truncated or overlong.
+ */
+static bool read_varint (const uint8_t **p, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+
+    for (unsigned int shift = 0; shift < 70 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        if (shift < 64)
+            result |= (uint64_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @internal
+ * Check a top-level field beginning at @a p against the summary header's section offsets.
+ */
+static bool check_summary_section (validator_t *v, const uint8_t *p, uint32_t number, uint32_t thread_index) {
+    uint64_t offset = p - v->file;
+
+    for (int s = 0; s < PLCRASH_REPORT_SECTION_COUNT; s++) {
+        if (v->summary.section_offsets[s] == 0 || v->summary.section_offsets[s] != offset)
+            continue;
+
+        v->matched_sections |= (1U << s);
+        if (number == section_fields[s]) {
+            /* The crashed thread offset must refer to the thread at the crashed thread index */
+            if (s == PLCRASH_REPORT_SECTION_CRASHED_THREAD && thread_index != v->summary.crashed_thread)
+                return fail(v, PLCRASH_REPORT_VALIDATION_BAD_SUMMARY, p, number);
+            continue;
+        }
+
+        /* The offsets of the repeated sections are recorded even if no elements are written; this is checked
+         * once the element counts are known. */
+        if (s == PLCRASH_REPORT_SECTION_THREADS || s == PLCRASH_REPORT_SECTION_BINARY_IMAGES) {
+            v->mismatched_sections |= (1U << s);
+            continue;
+        }
+
+        return fail(v, PLCRASH_REPORT_VALIDATION_BAD_SUMMARY, p, number);
+    }
+
+    return true;
+}
+
+/**
+ * @internal
+ * Validate the remaining summary header constraints, once the top-level message has been walked.
+ */
+static bool check_summary (validator_t *v, const uint8_t *end, const uint32_t *counts) {
+    /* Every recorded offset must refer to a top-level field, or to the end of the report */
+    for (int s = 0; s < PLCRASH_REPORT_SECTION_COUNT; s++) {
+        uint32_t offset = v->summary.section_offsets[s];
+        if (offset == 0 || (v->matched_sections & (1U << s)) || offset == (uint64_t) (end - v->file))
+            continue;
+
+        return fail(v, PLCRASH_REPORT_VALIDATION_BAD_SUMMARY, end, section_fields[s]);
+    }
+
+    if ((v->mismatched_sections & (1U << PLCRASH_REPORT_SECTION_THREADS)) && counts[REPORT_THREADS_FIELD] > 0)
+        return fail(v, PLCRASH_REPORT_VALIDATION_BAD_SUMMARY, v->file + v->summary.section_offsets[PLCRASH_REPORT_SECTION_THREADS], REPORT_THREADS_FIELD);
+
+    if ((v->mismatched_sections & (1U << PLCRASH_REPORT_SECTION_BINARY_IMAGES)) && counts[section_fields[PLCRASH_REPORT_SECTION_BINARY_IMAGES]] > 0)
+        return fail(v, PLCRASH_REPORT_VALIDATION_BAD_SUMMARY, v->file + v->summary.section_offsets[PLCRASH_REPORT_SECTION_BINARY_IMAGES], section_fields[PLCRASH_REPORT_SECTION_BINARY_IMAGES]);
+
+    /* The crashed thread index must be in range */
+    if (v->summary.crashed_thread != PLCRASH_REPORT_SUMMARY_NO_THREAD && v->summary.crashed_thread >= counts[REPORT_THREADS_FIELD])
+        return fail(v, PLCRASH_REPORT_VALIDATION_BAD_SUMMARY, end, REPORT_THREADS_FIELD);
+
+    return true;
+}
+
+/**
+ * @internal
+ * Validate the encoded message of @a type spanning [@a start, @a end).
+ */
+static bool validate_message (validator_t *v, int type, const uint8_t *start, const uint8_t *end, unsigned int depth) {
+    uint32_t counts[SCHEMA_MAX_FIELD + 1];
+    uint32_t seen = 0;
+    const uint8_t *p = start;
+
+    memset(counts, 0, sizeof(counts));
+
+    while (p < end) {
+        const uint8_t *field_start = p;
+        const uint8_t *payload = NULL;
+        uint64_t key;
+        uint64_t value = 0;
+
+        /* Key */
+        if (!read_varint(&p, end, &key) || (key >> 3) == 0 || (key >> 3) > UINT32_MAX)
+            return fail(v, PLCRASH_REPORT_VALIDATION_MALFORMED, field_start, 0);
+
+        uint32_t number = (uint32_t) (key >> 3);
+        uint8_t wire_type = key & 0x7;
+        const schema_field_t *field = schema_field(type, number);
+
+        if (field != NULL && field->wire_type != wire_type)
+            return fail(v, PLCRASH_REPORT_VALIDATION_WIRE_TYPE, field_start, number);
+
+        /* Value */
+        switch (wire_type) {
+            case WIRE_TYPE_VARINT:
+                if (!read_varint(&p, end, &value))
+                    return fail(v, PLCRASH_REPORT_VALIDATION_MALFORMED, field_start, number);
+                break;
+
+            case WIRE_TYPE_64BIT:
+            case WIRE_TYPE_32BIT: {
+                size_t width = (wire_type == WIRE_TYPE_64BIT) ? 8 : 4;
+                if ((size_t) (end - p) < width)
+                    return fail(v, PLCRASH_REPORT_VALIDATION_MALFORMED, field_start, number);
+                p += width;
+                break;
+            }
+
+            case WIRE_TYPE_LENGTH_DELIMITED:
+                if (!read_varint(&p, end, &value) || value > (uint64_t) (end - p))
+                    return fail(v, PLCRASH_REPORT_VALIDATION_MALFORMED, field_start, number);
+                payload = p;
+                p += value;
+                break;
+
+            default:
+                return fail(v, PLCRASH_REPORT_VALIDATION_MALFORMED, field_start, number);
+        }
+
+        if (field == NULL)
+            continue;
+
+        seen |= (1U << number);
+        uint32_t index = counts[number]++;
+
+        if (type == MSG_REPORT && v->has_summary) {
+            if (!check_summary_section(v, field_start, number, index))
+                return false;
+        }
+
+        if (type == MSG_IMAGE && number == IMAGE_UUID_FIELD && value != IMAGE_UUID_LENGTH)
+            return fail(v, PLCRASH_REPORT_VALIDATION_BAD_UUID, field_start, number);
+
+        if (field->message != MSG_NONE) {
+            v->result->path[depth].field = number;
+            v->result->path[depth].index = (field->label == LABEL_REPEATED) ? index : 0;
+            v->result->depth = depth + 1;
+
+            if (!validate_message(v, field->message, payload, p, depth + 1))
+                return false;
+
+            v->result->depth = depth;
+        }
+    }
+
+    /* Required fields */
+    const schema_message_t *message = &schema[type];
+    for (size_t i = 0; i < message->field_count; i++) {
+        if (message->fields[i].label == LABEL_REQUIRED && !(seen & (1U << message->fields[i].number)))
+            return fail(v, PLCRASH_REPORT_VALIDATION_MISSING_FIELD, start, message->fields[i].number);
+    }
+
+    /* Sections that are optional in crash_report.proto, but required by the decoder */
+    if (type == MSG_REPORT) {
+        for (size_t i = 0; i < plcrash_report_required_field_count; i++) {
+            if (counts[plcrash_report_required_fields[i]] == 0)
+                return fail(v, PLCRASH_REPORT_VALIDATION_MISSING_FIELD, start, plcrash_report_required_fields[i]);
+        }
+    }
+
+    if (type == MSG_REPORT && v->has_summary)
+        return check_summary(v, end, counts);
+
+    return true;
+}
+
+/**
+ * Validate the structure of the crash report file in @a data, without decoding it. No memory is allocated.
+ *
+ * @param data The crash report file contents, including the file header. This will generally be a
+ * memory mapped file.
+ * @param len The length of @a data.
+ * @param result On return, the validation result. If the report is invalid, the location of the first error.
+ *
+ * @return Returns PLCRASH_ESUCCESS if the report is valid, or PLCRASH_EINVAL if it is not.
+ */
+plcrash_error_t plcrash_report_validate (const void *data, size_t len, plcrash_report_validation_t *result) {
+    validator_t v;
+    size_t offset;
+
+    memset(result, 0, sizeof(*result));
+    memset(&v, 0, sizeof(v));
+    v.file = data;
+    v.result = result;
+
+    /* File header and summary */
+    switch (plcrash_report_data_offset(data, len, &offset)) {
+        case PLCRASH_ESUCCESS:
+            break;
+
+        case PLCRASH_ENOTSUP:
+            fail(&v, PLCRASH_REPORT_VALIDATION_BAD_VERSION, v.file, 0);
+            return PLCRASH_EINVAL;
+
+        default:
+            fail(&v, PLCRASH_REPORT_VALIDATION_BAD_HEADER, v.file, 0);
+            return PLCRASH_EINVAL;
+    }
+
+    v.has_summary = (plcrash_report_summary_read(data, len, &v.summary) == PLCRASH_ESUCCESS);
+
+    /* Report */
+    if (!validate_message(&v, MSG_REPORT, v.file + offset, v.file + len, 0))
+        return PLCRASH_EINVAL;
+
+    result->code = PLCRASH_REPORT_VALIDATION_OK;
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Return a description of validation result @a code.
+ *
+ * @param code The result code.
+ */
+const char *plcrash_report_validation_description (plcrash_report_validation_code_t code) {
+    switch (code) {
+        case PLCRASH_REPORT_VALIDATION_OK:
+            return "Valid";
+        case PLCRASH_REPORT_VALIDATION_BAD_HEADER:
+            return "Invalid file header";
+        case PLCRASH_REPORT_VALIDATION_BAD_VERSION:
+            return "Unsupported file version";
+        case PLCRASH_REPORT_VALIDATION_MALFORMED:
+            return "Malformed or truncated field";
+        case PLCRASH_REPORT_VALIDATION_WIRE_TYPE:
+            return "Unexpected wire type";
+        case PLCRASH_REPORT_VALIDATION_MISSING_FIELD:
+            return "Missing required field";
+        case PLCRASH_REPORT_VALIDATION_BAD_UUID:
+            return "Invalid image UUID length";
+        case PLCRASH_REPORT_VALIDATION_BAD_SUMMARY:
+            return "Summary header does not match report";
+    }
+
+    return "Unknown validation error";
+}
+
+/**
+ * @internal
+ * Append a formatted string to @a buffer at @a *pos, tracking the total length that would have been written.
+ */
+static void path_append (char *buffer, size_t len, size_t *pos, const char *format, const char *name, uint32_t value) {
+    size_t avail = (*pos < len) ? len - *pos : 0;
+    int written = snprintf(avail > 0 ? buffer + *pos : NULL, avail, format, name, value);
+    if (written > 0)
+        *pos += written;
+}
+
+/**
+ * Format the location of a validation error as a field path, such as "threads[2].frames[5].pc", into @a buffer.
+ * The output is truncated and NUL-terminated if it does not fit.
+ *
+ * @param result A validation result.
+ * @param buffer The output buffer.
+ * @param len The size of @a buffer.
+ *
+ * @return Returns the length of the full path, not including the NUL terminator, as with snprintf().
+ */
+size_t plcrash_report_validation_path (const plcrash_report_validation_t *result, char *buffer, size_t len) {
+    int type = MSG_REPORT;
+    size_t pos = 0;
+
+    if (len > 0)
+        buffer[0] = '\0';
+
+    for (unsigned int i = 0; i < result->depth && i < PLCRASH_REPORT_VALIDATION_MAX_DEPTH; i++) {
+        const schema_field_t *field = schema_field(type, result->path[i].field);
+
+        /* The path only includes declared message fields */
+        if (field == NULL || field->message == MSG_NONE)
+            break;
+
+        if (field->label == LABEL_REPEATED) {
+            path_append(buffer, len, &pos, "%s[%u].", field->name, result->path[i].index);
+        } else {
+            path_append(buffer, len, &pos, "%s.", field->name, 0);
+        }
+
+        type = field->message;
+    }
+
+    if (result->field != 0) {
+        const schema_field_t *field = schema_field(type, result->field);
+        if (field != NULL) {
+            path_append(buffer, len, &pos, "%s", field->name, 0);
+        } else {
+            path_append(buffer, len, &pos, "%sfield %u", "", result->field);
+        }
+    } else if (pos > 0) {
+        /* Drop the trailing separator */
+        pos--;
+        if (pos < len)
+            buffer[pos] = '\0';
+    }
+
+    return pos;
+}
+
+/**
+ * @} plcrash_report_validator
+ */
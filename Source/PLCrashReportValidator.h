@@ -0,0 +1,104 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#import "PLCrashAsync.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_report_validator
+ *
+ * Maximum number of enclosing messages recorded in a validation error path.
+ */
+#define PLCRASH_REPORT_VALIDATION_MAX_DEPTH 2
+
+/**
+ * @internal
+ * @ingroup plcrash_report_validator
+ *
+ * Validation result codes.
+ */
+typedef enum {
+    /** The report is structurally valid. */
+    PLCRASH_REPORT_VALIDATION_OK = 0,
+
+    /** The file magic or summary header is invalid. */
+    PLCRASH_REPORT_VALIDATION_BAD_HEADER,
+
+    /** The file version is not supported. */
+    PLCRASH_REPORT_VALIDATION_BAD_VERSION,
+
+    /** A field key, varint, or length prefix is malformed or truncated, or a field overruns its message. */
+    PLCRASH_REPORT_VALIDATION_MALFORMED,
+
+    /** A known field is encoded with an unexpected wire type. */
+    PLCRASH_REPORT_VALIDATION_WIRE_TYPE,
+
+    /** A required field is missing. */
+    PLCRASH_REPORT_VALIDATION_MISSING_FIELD,
+
+    /** A binary image UUID is not 16 bytes. */
+    PLCRASH_REPORT_VALIDATION_BAD_UUID,
+
+    /** The summary header does not match the report. */
+    PLCRASH_REPORT_VALIDATION_BAD_SUMMARY
+} plcrash_report_validation_code_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_report_validator
+ *
+ * A validation result, locating the first error found.
+ */
+typedef struct plcrash_report_validation {
+    /** Result code */
+    plcrash_report_validation_code_t code;
+
+    /** File offset of the error. For missing fields, this is the offset of the enclosing message. */
+    uint64_t offset;
+
+    /** Number of the offending (or missing) field within the innermost message of the path, or 0. */
+    uint32_t field;
+
+    /** Enclosing messages, outermost first, as (field number, index) pairs. The index is 0 for singular fields. */
+    struct {
+        uint32_t field;
+        uint32_t index;
+    } path[PLCRASH_REPORT_VALIDATION_MAX_DEPTH];
+
+    /** Number of valid path entries */
+    unsigned int depth;
+} plcrash_report_validation_t;
+
+plcrash_error_t plcrash_report_validate (const void *data, size_t len, plcrash_report_validation_t *result);
+
+const char *plcrash_report_validation_description (plcrash_report_validation_code_t code);
+size_t plcrash_report_validation_path (const plcrash_report_validation_t *result, char *buffer, size_t len);
@@ -0,0 +1,309 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+#import "CrashReporter.h"
+#import "PLCrashReportValidator.h"
+#import "PLCrashReportDecoder.h"
+#import "PLCrashReportSummary.h"
+#import "PLCrashFrameWalker.h"
+#import "PLCrashLogWriter.h"
+
+#import <fcntl.h>
+
+#import <mach-o/dyld.h>
+#import <mach/mach_time.h>
+#import <libkern/OSByteOrder.h>
+
+@interface PLCrashReportValidatorTests : SenTestCase {
+@private
+    /* Path to crash log */
+    NSString *_logPath;
+
+    /* Test thread */
+    plframe_test_thead_t _thr_args;
+
+    /* Encoded report file */
+    NSData *_data;
+}
+
+@end
+
+/* Version 1 file header */
+#define TEST_HEADER 'p', 'l', 'c', 'r', 'a', 's', 'h', 1
+
+/* Minimal system info (field 1): os_version, architecture, timestamp */
+#define TEST_SYSTEM_INFO 0x0A, 0x07, 0x12, 0x01, '1', 0x18, 0x00, 0x20, 0x00
+
+/* Minimal application info (field 2): identifier, version */
+#define TEST_APP_INFO 0x12, 0x06, 0x0A, 0x01, 'a', 0x12, 0x01, '1'
+
+/* Minimal signal (field 6): name, code, address */
+#define TEST_SIGNAL 0x32, 0x08, 0x0A, 0x01, 'S', 0x12, 0x01, 'C', 0x18, 0x00
+
+/* Minimal machine info (field 8): processor (type, subtype), processor_count, logical_processor_count */
+#define TEST_MACHINE_INFO 0x42, 0x0A, 0x12, 0x04, 0x10, 0x00, 0x18, 0x00, 0x18, 0x01, 0x20, 0x01
+
+/* Minimal thread (field 3): thread_number, crashed */
+#define TEST_THREAD 0x1A, 0x04, 0x08, 0x00, 0x18, 0x01
+
+/* Minimal binary image (field 4): base_address, size, name */
+#define TEST_IMAGE 0x22, 0x07, 0x08, 0x00, 0x10, 0x00, 0x1A, 0x01, 'x'
+
+/* All sections required by the decoder, other than the system info, application info and signal */
+#define TEST_REQUIRED TEST_MACHINE_INFO, TEST_THREAD, TEST_IMAGE
+
+@implementation PLCrashReportValidatorTests
+
+- (void) setUp {
+    siginfo_t info;
+    plframe_thread_state_t thread_state;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+
+    /* Create a temporary log path */
+    _logPath = [[NSTemporaryDirectory() stringByAppendingString: [[NSProcessInfo processInfo] globallyUniqueString]] retain];
+
+    /* Create the test thread */
+    plframe_test_thread_spawn(&_thr_args);
+
+    /* Initialze faux crash data */
+    {
+        info.si_addr = 0x0;
+        info.si_errno = 0;
+        info.si_pid = getpid();
+        info.si_uid = getuid();
+        info.si_code = SEGV_MAPERR;
+        info.si_signo = SIGSEGV;
+        info.si_status = 0;
+
+        /* Steal the test thread's state for iteration */
+        plframe_thread_state_fetch(&thread_state, pthread_mach_thread_np(_thr_args.thread));
+    }
+
+    /* Write the report */
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    plcrash_log_writer_set_exception(&writer, [NSException exceptionWithName: @"TestException" reason: @"TestReason" userInfo: nil]);
+
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++)
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, pthread_mach_thread_np(_thr_args.thread), &file, &info, &thread_state.uap), @"Crash log failed");
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write_handler_info(&writer, &file, 65536, 4096), @"Writing handler info failed");
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+
+    _data = [[NSData dataWithContentsOfFile: _logPath] retain];
+}
+
+- (void) tearDown {
+    NSError *error;
+
+    /* Delete the file */
+    STAssertTrue([[NSFileManager defaultManager] removeItemAtPath: _logPath error: &error], @"Could not remove log file");
+    [_logPath release];
+    [_data release];
+
+    /* Stop the test thread */
+    plframe_test_thread_stop(&_thr_args);
+}
+
+/* Verify that a written report is valid */
+- (void) testValid {
+    plcrash_report_validation_t result;
+    char path[128];
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_validate([_data bytes], [_data length], &result), @"Report was rejected");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_OK, result.code, @"Incorrect result code");
+    STAssertEquals((size_t) 0, plcrash_report_validation_path(&result, path, sizeof(path)), @"Unexpected error path");
+
+    /* The minimal version 1 report is accepted by the decoder */
+    const uint8_t minimal[] = { TEST_HEADER, TEST_SYSTEM_INFO, TEST_APP_INFO, TEST_SIGNAL, TEST_REQUIRED };
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_validate(minimal, sizeof(minimal), &result), @"Minimal report was rejected");
+
+    plcrash_report_decoder_t decoder;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_decoder_init(&decoder, minimal, sizeof(minimal)), @"Minimal report could not be decoded");
+    plcrash_report_decoder_free(&decoder);
+
+    /* Unknown fields are skipped */
+    const uint8_t unknown[] = { TEST_HEADER, TEST_SYSTEM_INFO, TEST_APP_INFO, TEST_SIGNAL, TEST_REQUIRED, 0x98, 0x06, 0x01, 0x7D, 1, 2, 3, 4 };
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_validate(unknown, sizeof(unknown), &result), @"Unknown fields were rejected");
+}
+
+/* Verify that truncated reports are rejected, and that any report accepted by the validator can be decoded */
+- (void) testTruncated {
+    const uint8_t *bytes = [_data bytes];
+    size_t len = [_data length];
+    plcrash_report_validation_t result;
+    char path[128];
+
+    for (size_t truncated = 0; truncated < len; truncated++) {
+        if (plcrash_report_validate(bytes, truncated, &result) != PLCRASH_ESUCCESS) {
+            STAssertTrue(result.offset <= truncated, @"Error offset past the end of the data");
+            continue;
+        }
+
+        /* The report may be truncated on a field boundary after all required fields */
+        NSError *error = nil;
+        NSData *data = [NSData dataWithBytesNoCopy: (void *) bytes length: truncated freeWhenDone: NO];
+        STAssertNotNil([[[PLCrashReport alloc] initWithData: data error: &error] autorelease], @"Valid report at %zu could not be decoded: %@", truncated, error);
+    }
+
+    /* The handler info is written last */
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_validate(bytes, len - 1, &result), @"Truncated report was accepted");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_MALFORMED, result.code, @"Incorrect result code");
+    plcrash_report_validation_path(&result, path, sizeof(path));
+    STAssertEqualStrings(@"handler_info", [NSString stringWithUTF8String: path], @"Incorrect error path");
+
+    /* Truncated within the header */
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_validate(bytes, 4, &result), @"Truncated header was accepted");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_BAD_HEADER, result.code, @"Incorrect result code");
+}
+
+/* Verify the location reported for malformed reports */
+- (void) testMalformed {
+    plcrash_report_validation_t result;
+    char path[128];
+
+    /* Unsupported version */
+    const uint8_t bad_version[] = { 'p', 'l', 'c', 'r', 'a', 's', 'h', 9 };
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_validate(bad_version, sizeof(bad_version), &result), @"Accepted bad version");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_BAD_VERSION, result.code, @"Incorrect result code");
+
+    /* System info without an architecture */
+    const uint8_t missing[] = { TEST_HEADER, 0x0A, 0x05, 0x12, 0x01, '1', 0x20, 0x00, TEST_APP_INFO, TEST_SIGNAL };
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_validate(missing, sizeof(missing), &result), @"Accepted missing field");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_MISSING_FIELD, result.code, @"Incorrect result code");
+    STAssertEquals((uint64_t) 10, result.offset, @"Incorrect offset");
+    plcrash_report_validation_path(&result, path, sizeof(path));
+    STAssertEqualStrings(@"system_info.architecture", [NSString stringWithUTF8String: path], @"Incorrect error path");
+
+    /* No signal */
+    const uint8_t no_signal[] = { TEST_HEADER, TEST_SYSTEM_INFO, TEST_APP_INFO };
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_validate(no_signal, sizeof(no_signal), &result), @"Accepted missing signal");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_MISSING_FIELD, result.code, @"Incorrect result code");
+    STAssertEquals((uint32_t) 6, result.field, @"Incorrect field");
+
+    /* Sections required by the decoder, but optional in crash_report.proto */
+    const uint8_t no_threads[] = { TEST_HEADER, TEST_SYSTEM_INFO, TEST_APP_INFO, TEST_SIGNAL, TEST_MACHINE_INFO, TEST_IMAGE };
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_validate(no_threads, sizeof(no_threads), &result), @"Accepted missing threads");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_MISSING_FIELD, result.code, @"Incorrect result code");
+    STAssertEquals((uint32_t) 3, result.field, @"Incorrect field");
+
+    const uint8_t no_images[] = { TEST_HEADER, TEST_SYSTEM_INFO, TEST_APP_INFO, TEST_SIGNAL, TEST_MACHINE_INFO, TEST_THREAD };
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_validate(no_images, sizeof(no_images), &result), @"Accepted missing images");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_MISSING_FIELD, result.code, @"Incorrect result code");
+    STAssertEquals((uint32_t) 4, result.field, @"Incorrect field");
+
+    /* A binary image with a two byte UUID */
+    const uint8_t bad_uuid[] = { TEST_HEADER, TEST_SYSTEM_INFO, TEST_APP_INFO,
+        0x22, 0x0B, 0x08, 0x00, 0x10, 0x00, 0x1A, 0x01, 'x', 0x22, 0x02, 0xAA, 0xBB,
+        TEST_SIGNAL };
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_validate(bad_uuid, sizeof(bad_uuid), &result), @"Accepted bad UUID");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_BAD_UUID, result.code, @"Incorrect result code");
+    STAssertEquals((uint64_t) 34, result.offset, @"Incorrect offset");
+    plcrash_report_validation_path(&result, path, sizeof(path));
+    STAssertEqualStrings(@"binary_images[0].uuid", [NSString stringWithUTF8String: path], @"Incorrect error path");
+
+    /* A stack frame with a length-delimited PC */
+    const uint8_t bad_wire_type[] = { TEST_HEADER, TEST_SYSTEM_INFO, TEST_APP_INFO,
+        0x1A, 0x08, 0x08, 0x00, 0x12, 0x02, 0x1A, 0x00, 0x18, 0x00,
+        TEST_SIGNAL };
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_validate(bad_wire_type, sizeof(bad_wire_type), &result), @"Accepted bad wire type");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_WIRE_TYPE, result.code, @"Incorrect result code");
+    STAssertEquals((uint64_t) 31, result.offset, @"Incorrect offset");
+    plcrash_report_validation_path(&result, path, sizeof(path));
+    STAssertEqualStrings(@"threads[0].frames[0].pc", [NSString stringWithUTF8String: path], @"Incorrect error path");
+
+    /* The path is truncated to fit, but its full length is returned */
+    char small[8];
+    STAssertEquals(strlen("threads[0].frames[0].pc"), plcrash_report_validation_path(&result, small, sizeof(small)), @"Incorrect path length");
+    STAssertEqualStrings(@"threads", [NSString stringWithUTF8String: small], @"Incorrect truncated path");
+}
+
+/* Verify that the summary header is checked against the report */
+- (void) testSummary {
+    plcrash_report_summary_t summary;
+    plcrash_report_validation_t result;
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_summary_read([_data bytes], [_data length], &summary), @"Could not read summary");
+
+    /* Point the signal section at the system info */
+    NSMutableData *data = [[_data mutableCopy] autorelease];
+    uint32_t offset = OSSwapHostToLittleInt32(summary.section_offsets[PLCRASH_REPORT_SECTION_SYSTEM_INFO]);
+    [data replaceBytesInRange: NSMakeRange(8 + offsetof(plcrash_report_summary_header_t, section_offsets[PLCRASH_REPORT_SECTION_SIGNAL]), sizeof(offset)) withBytes: &offset];
+
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_validate([data bytes], [data length], &result), @"Accepted bad section offset");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_BAD_SUMMARY, result.code, @"Incorrect result code");
+    STAssertEquals((uint64_t) summary.section_offsets[PLCRASH_REPORT_SECTION_SYSTEM_INFO], result.offset, @"Incorrect offset");
+
+    /* An out-of-range crashed thread */
+    data = [[_data mutableCopy] autorelease];
+    uint32_t crashed_thread = OSSwapHostToLittleInt32(10000);
+    [data replaceBytesInRange: NSMakeRange(8 + offsetof(plcrash_report_summary_header_t, crashed_thread), sizeof(crashed_thread)) withBytes: &crashed_thread];
+
+    STAssertEquals(PLCRASH_EINVAL, plcrash_report_validate([data bytes], [data length], &result), @"Accepted bad crashed thread");
+    STAssertEquals(PLCRASH_REPORT_VALIDATION_BAD_SUMMARY, result.code, @"Incorrect result code");
+}
+
+/* Compare validation throughput against a full decode */
+- (void) testValidatePerformance {
+    const NSUInteger iterations = 100;
+    plcrash_report_validation_t result;
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+
+    uint64_t start = mach_absolute_time();
+    for (NSUInteger i = 0; i < iterations; i++)
+        plcrash_report_validate([_data bytes], [_data length], &result);
+    uint64_t validate_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    start = mach_absolute_time();
+    for (NSUInteger i = 0; i < iterations; i++) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        PLCrashReport *report = [[PLCrashReport alloc] initWithData: _data error: NULL];
+        [report.threads count];
+        [report.images count];
+        [report release];
+        [pool release];
+    }
+    uint64_t decode_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    NSLog(@"Validated %lu byte report in %llu ns, decoded in %llu ns", (unsigned long) [_data length],
+          (unsigned long long) (validate_ns / iterations), (unsigned long long) (decode_ns / iterations));
+}
+
+@end
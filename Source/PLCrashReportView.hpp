@@ -0,0 +1,821 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2010 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PLCRASH_REPORT_VIEW_HPP
+#define PLCRASH_REPORT_VIEW_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <iterator>
+
+#include "PLCrashReportSummary.h"
+
+/**
+ * @internal
+ * @defgroup plcrash_report_view Crash Report View
+ * @ingroup plcrash_internal
+ *
+ * A header-only, zero-copy C++ view over an encoded crash report file.
+ *
+ * Nothing is decoded up front. Each accessor walks the wire format in place, repeated fields are exposed as
+ * lazy forward ranges, and strings and bytes are returned as references into the caller's buffer. The view
+ * performs no heap allocation and does not depend on Foundation or protobuf-c, and is intended for bulk,
+ * server-side processing of mapped report files.
+ *
+ * The caller's buffer must remain valid for the lifetime of the view and of any value obtained from it.
+ *
+ * Field numbers are those defined in crash_report.proto. Only the structure of the top-level message is
+ * validated by ReportView; malformed data within a nested message terminates iteration of that message,
+ * and fields that are missing, or encoded with an unexpected wire type, are returned as their default values.
+ * As with protobuf, the last occurrence of a singular field takes precedence.
+ *
+ * @{
+ */
+
+namespace plcrash {
+
+/**
+ * A borrowed, immutable byte range.
+ */
+class ByteRange {
+public:
+    /** Construct an empty range. */
+    ByteRange () : _data(NULL), _size(0) {}
+
+    /**
+     * Construct a range over @a size bytes at @a data.
+     *
+     * @param data Range start.
+     * @param size Range length, in bytes.
+     */
+    ByteRange (const uint8_t *data, size_t size) : _data(data), _size(size) {}
+
+    /** Return a pointer to the first byte of the range. */
+    const uint8_t *data () const { return _data; }
+
+    /** Return the length of the range, in bytes. */
+    size_t size () const { return _size; }
+
+    /** Return true if the range is empty. */
+    bool empty () const { return _size == 0; }
+
+    /** Return a pointer to the first byte of the range. */
+    const uint8_t *begin () const { return _data; }
+
+    /** Return a pointer one past the last byte of the range. */
+    const uint8_t *end () const { return _data + _size; }
+
+private:
+    /** Range start */
+    const uint8_t *_data;
+
+    /** Range length */
+    size_t _size;
+};
+
+/**
+ * A borrowed, immutable string. The referenced bytes are not NUL terminated.
+ */
+class StringRef {
+public:
+    /** Construct an empty string. */
+    StringRef () : _data(NULL), _size(0) {}
+
+    /**
+     * Construct a string over @a size bytes at @a data.
+     *
+     * @param data String start.
+     * @param size String length, in bytes.
+     */
+    StringRef (const char *data, size_t size) : _data(data), _size(size) {}
+
+    /** Return a pointer to the first character. The string is not NUL terminated. */
+    const char *data () const { return _data; }
+
+    /** Return the length of the string, in bytes. */
+    size_t size () const { return _size; }
+
+    /** Return true if the string is empty. */
+    bool empty () const { return _size == 0; }
+
+    /** Return a pointer to the first character. */
+    const char *begin () const { return _data; }
+
+    /** Return a pointer one past the last character. */
+    const char *end () const { return _data + _size; }
+
+    /**
+     * Return true if this string is equal to the NUL terminated string @a str.
+     *
+     * @param str String to compare.
+     */
+    bool equals (const char *str) const {
+        size_t len = strlen(str);
+        return len == _size && (len == 0 || memcmp(_data, str, len) == 0);
+    }
+
+private:
+    /** String start */
+    const char *_data;
+
+    /** String length */
+    size_t _size;
+};
+
+namespace detail {
+
+/** Protobuf wire types supported by the view. */
+enum WireType {
+    WIRE_TYPE_VARINT = 0,
+    WIRE_TYPE_64BIT = 1,
+    WIRE_TYPE_LENGTH_DELIMITED = 2,
+    WIRE_TYPE_32BIT = 5
+};
+
+/**
+ * Decode a varint of at most 10 bytes at @a pos, advancing @a pos past it. Returns false if the varint is
+ * truncated or overlong.
+ */
+inline bool read_varint (const uint8_t *&pos, const uint8_t *end, uint64_t &value) {
+    /* Single byte values (tags, small lengths and counts) are the common case */
+    if (pos < end && *pos < 0x80) {
+        value = *pos++;
+        return true;
+    }
+
+    const uint8_t *p = pos;
+    uint64_t result = 0;
+    for (unsigned int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        result |= (uint64_t) (byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            pos = p;
+            value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/** Decode a little-endian fixed width integer of @a len bytes. */
+inline uint64_t read_fixed (const uint8_t *pos, size_t len) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < len; i++)
+        value |= (uint64_t) pos[i] << (i * 8);
+    return value;
+}
+
+/** A single decoded field. */
+struct Field {
+    /** Field number */
+    uint32_t number;
+
+    /** Wire type */
+    uint32_t wire_type;
+
+    /** Value of a varint or fixed width field */
+    uint64_t value;
+
+    /** Payload of a length-delimited field */
+    ByteRange payload;
+};
+
+/**
+ * Sequential reader over the fields of a single encoded message.
+ */
+class FieldReader {
+public:
+    /** Construct a reader at the end of an empty message. */
+    FieldReader () : _pos(NULL), _end(NULL), _error(false) {}
+
+    /**
+     * Construct a reader over the encoded message @a body.
+     *
+     * @param body The encoded message, without its tag or length prefix.
+     */
+    explicit FieldReader (ByteRange body) : _pos(body.begin()), _end(body.end()), _error(false) {}
+
+    /**
+     * Read the next field into @a field. Returns false at the end of the message, or if the remaining data is
+     * malformed; the two cases may be distinguished via error().
+     */
+    bool next (Field &field) {
+        uint64_t key;
+
+        if (_pos == _end)
+            return false;
+
+        if (!read_varint(_pos, _end, key) || (key >> 3) == 0 || (key >> 3) > (uint64_t) 0xFFFFFFFFU)
+            return fail();
+
+        field.number = (uint32_t) (key >> 3);
+        field.wire_type = (uint32_t) (key & 0x7);
+
+        switch (field.wire_type) {
+            case WIRE_TYPE_VARINT:
+                if (!read_varint(_pos, _end, field.value))
+                    return fail();
+                return true;
+
+            case WIRE_TYPE_64BIT:
+                if ((size_t) (_end - _pos) < 8)
+                    return fail();
+                field.value = read_fixed(_pos, 8);
+                _pos += 8;
+                return true;
+
+            case WIRE_TYPE_32BIT:
+                if ((size_t) (_end - _pos) < 4)
+                    return fail();
+                field.value = read_fixed(_pos, 4);
+                _pos += 4;
+                return true;
+
+            case WIRE_TYPE_LENGTH_DELIMITED: {
+                uint64_t len;
+                if (!read_varint(_pos, _end, len) || len > (uint64_t) (_end - _pos))
+                    return fail();
+                field.value = len;
+                field.payload = ByteRange(_pos, (size_t) len);
+                _pos += len;
+                return true;
+            }
+
+            default:
+                /* Groups are not used by crash_report.proto */
+                return fail();
+        }
+    }
+
+    /** Return true if iteration stopped on malformed data. */
+    bool error () const { return _error; }
+
+    /** Return the current read position. */
+    const uint8_t *position () const { return _pos; }
+
+private:
+    /** Mark the reader as failed, and return false. */
+    bool fail () {
+        _pos = _end;
+        _error = true;
+        return false;
+    }
+
+    /** Current read position */
+    const uint8_t *_pos;
+
+    /** End of the message */
+    const uint8_t *_end;
+
+    /** True if malformed data was encountered */
+    bool _error;
+};
+
+/**
+ * Find the last occurrence of field @a number with wire type @a wire_type in @a body. Returns false if not found.
+ */
+inline bool find_field (ByteRange body, uint32_t number, uint32_t wire_type, Field &result) {
+    FieldReader reader(body);
+    Field field;
+    bool found = false;
+
+    while (reader.next(field)) {
+        if (field.number == number && field.wire_type == wire_type) {
+            result = field;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+} /* namespace detail */
+
+/**
+ * Lazy forward range over a repeated embedded message field. Each element is constructed as a view of type
+ * @a T over the element's encoded bytes. Iteration stops early if malformed data is encountered.
+ */
+template <typename T, uint32_t Number> class RepeatedRange {
+public:
+    /**
+     * Multi-pass forward iterator. Dereferencing yields a new view by value.
+     */
+    class iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const T *pointer;
+        typedef T reference;
+
+        /** Construct an end iterator. */
+        iterator () : _done(true) {}
+
+        /** Construct an iterator positioned at the first element within @a body. */
+        explicit iterator (ByteRange body) : _reader(body), _done(false) { advance(); }
+
+        /** Return a view of the current element. */
+        T operator* () const { return T(_field.payload); }
+
+        /** Advance to the next element. */
+        iterator &operator++ () {
+            advance();
+            return *this;
+        }
+
+        /** Advance to the next element, returning the previous position. */
+        iterator operator++ (int) {
+            iterator prev = *this;
+            advance();
+            return prev;
+        }
+
+        /** Return true if both iterators are at the end, or at the same element. */
+        bool operator== (const iterator &other) const {
+            if (_done || other._done)
+                return _done == other._done;
+            return _reader.position() == other._reader.position();
+        }
+
+        /** Return true if the iterators differ. */
+        bool operator!= (const iterator &other) const { return !(*this == other); }
+
+    private:
+        /** Advance to the next occurrence of the field, or to the end. */
+        void advance () {
+            while (_reader.next(_field)) {
+                if (_field.number == Number && _field.wire_type == detail::WIRE_TYPE_LENGTH_DELIMITED)
+                    return;
+            }
+            _done = true;
+        }
+
+        /** Field reader, positioned after the current element */
+        detail::FieldReader _reader;
+
+        /** The current element's field */
+        detail::Field _field;
+
+        /** True if iteration has completed */
+        bool _done;
+    };
+
+    /** Construct an empty range. */
+    RepeatedRange () {}
+
+    /**
+     * Construct a range over the elements of field @a Number within @a body.
+     *
+     * @param body The enclosing message.
+     */
+    explicit RepeatedRange (ByteRange body) : _body(body) {}
+
+    /** Return an iterator positioned at the first element. */
+    iterator begin () const { return iterator(_body); }
+
+    /** Return the end iterator. */
+    iterator end () const { return iterator(); }
+
+    /** Return true if the range is empty. */
+    bool empty () const { return begin() == end(); }
+
+    /** Count the elements of the range. This walks the enclosing message. */
+    size_t count () const {
+        size_t n = 0;
+        for (iterator i = begin(); i != end(); ++i)
+            n++;
+        return n;
+    }
+
+private:
+    /** The enclosing message */
+    ByteRange _body;
+};
+
+/**
+ * Base class for views of an encoded message.
+ */
+class MessageView {
+public:
+    /** Construct a view of an empty message. */
+    MessageView () {}
+
+    /**
+     * Construct a view over the encoded message @a body.
+     *
+     * @param body The encoded message, without its tag or length prefix.
+     */
+    explicit MessageView (ByteRange body) : _body(body) {}
+
+    /** Return the encoded message. */
+    ByteRange body () const { return _body; }
+
+protected:
+    /** Return true if field @a number is present with wire type @a wire_type. */
+    bool has (uint32_t number, uint32_t wire_type) const {
+        detail::Field field;
+        return detail::find_field(_body, number, wire_type, field);
+    }
+
+    /** Return the value of varint field @a number, or @a def if not present. */
+    uint64_t varint (uint32_t number, uint64_t def = 0) const {
+        detail::Field field;
+        if (!detail::find_field(_body, number, detail::WIRE_TYPE_VARINT, field))
+            return def;
+        return field.value;
+    }
+
+    /** Return the payload of length-delimited field @a number, or an empty range if not present. */
+    ByteRange bytes (uint32_t number) const {
+        detail::Field field;
+        if (!detail::find_field(_body, number, detail::WIRE_TYPE_LENGTH_DELIMITED, field))
+            return ByteRange();
+        return field.payload;
+    }
+
+    /** Return the value of string field @a number, or an empty string if not present. */
+    StringRef string (uint32_t number) const {
+        ByteRange value = bytes(number);
+        return StringRef((const char *) value.data(), value.size());
+    }
+
+private:
+    /** The encoded message */
+    ByteRange _body;
+};
+
+/** Processor view (CrashReport.Processor). */
+class ProcessorView : public MessageView {
+public:
+    ProcessorView () {}
+    explicit ProcessorView (ByteRange body) : MessageView(body) {}
+
+    /** CPU type encoding. 0 (unknown) if not present. */
+    uint32_t encoding () const { return (uint32_t) varint(1); }
+
+    /** CPU type. */
+    uint64_t type () const { return varint(2); }
+
+    /** CPU subtype. */
+    uint64_t subtype () const { return varint(3); }
+};
+
+/** System info view (CrashReport.SystemInfo). */
+class SystemInfoView : public MessageView {
+public:
+    SystemInfoView () {}
+    explicit SystemInfoView (ByteRange body) : MessageView(body) {}
+
+    /** Operating system. 3 (unknown) if not present. */
+    uint32_t operating_system () const { return (uint32_t) varint(1, 3); }
+
+    /** OS version. */
+    StringRef os_version () const { return string(2); }
+
+    /** Deprecated architecture code. 6 (unknown) if not present. */
+    uint32_t architecture () const { return (uint32_t) varint(3, 6); }
+
+    /** Crash timestamp, in seconds since the epoch, or 0 if unknown. */
+    int64_t timestamp () const { return (int64_t) varint(4); }
+
+    /** OS build number. */
+    StringRef os_build () const { return string(5); }
+};
+
+/** Application info view (CrashReport.ApplicationInfo). */
+class ApplicationInfoView : public MessageView {
+public:
+    ApplicationInfoView () {}
+    explicit ApplicationInfoView (ByteRange body) : MessageView(body) {}
+
+    /** Application identifier. */
+    StringRef identifier () const { return string(1); }
+
+    /** Application version. */
+    StringRef version () const { return string(2); }
+};
+
+/** Stack frame view (CrashReport.Thread.StackFrame). */
+class FrameView : public MessageView {
+public:
+    FrameView () {}
+    explicit FrameView (ByteRange body) : MessageView(body) {}
+
+    /** Instruction pointer. */
+    uint64_t pc () const { return varint(3); }
+
+    /** True if the frame's in-process symbol is present. */
+    bool has_symbol () const { return has(4, detail::WIRE_TYPE_LENGTH_DELIMITED); }
+
+    /** Name of the nearest preceding exported symbol, or an empty string if not present. */
+    StringRef symbol_name () const { return string(4); }
+
+    /** Offset of the instruction pointer from symbol_name. */
+    uint64_t symbol_offset () const { return varint(5); }
+};
+
+/** Register view (CrashReport.Thread.RegisterValue). */
+class RegisterView : public MessageView {
+public:
+    RegisterView () {}
+    explicit RegisterView (ByteRange body) : MessageView(body) {}
+
+    /** Register name. */
+    StringRef name () const { return string(1); }
+
+    /** Register value. */
+    uint64_t value () const { return varint(2); }
+};
+
+/** Thread view (CrashReport.Thread). */
+class ThreadView : public MessageView {
+public:
+    /** Range of stack frames */
+    typedef RepeatedRange<FrameView, 2> FrameRange;
+
+    /** Range of registers */
+    typedef RepeatedRange<RegisterView, 4> RegisterRange;
+
+    ThreadView () {}
+    explicit ThreadView (ByteRange body) : MessageView(body) {}
+
+    /** Thread number. */
+    uint32_t number () const { return (uint32_t) varint(1); }
+
+    /** Backtrace stack frames, innermost first. */
+    FrameRange frames () const { return FrameRange(body()); }
+
+    /** True if this is the crashed thread. */
+    bool crashed () const { return varint(3) != 0; }
+
+    /** Thread registers. */
+    RegisterRange registers () const { return RegisterRange(body()); }
+};
+
+/** Binary image view (CrashReport.BinaryImage). */
+class ImageView : public MessageView {
+public:
+    ImageView () {}
+    explicit ImageView (ByteRange body) : MessageView(body) {}
+
+    /** Image base address. */
+    uint64_t base_address () const { return varint(1); }
+
+    /** Image size. */
+    uint64_t size () const { return varint(2); }
+
+    /** Image path. */
+    StringRef name () const { return string(3); }
+
+    /** True if the image UUID is present. */
+    bool has_uuid () const { return has(4, detail::WIRE_TYPE_LENGTH_DELIMITED); }
+
+    /** Image UUID bytes, or an empty range if not present. */
+    ByteRange uuid () const { return bytes(4); }
+
+    /** True if the image code type is present. */
+    bool has_code_type () const { return has(5, detail::WIRE_TYPE_LENGTH_DELIMITED); }
+
+    /** Image code type. */
+    ProcessorView code_type () const { return ProcessorView(bytes(5)); }
+};
+
+/** Exception view (CrashReport.Exception). */
+class ExceptionView : public MessageView {
+public:
+    ExceptionView () {}
+    explicit ExceptionView (ByteRange body) : MessageView(body) {}
+
+    /** Exception name. */
+    StringRef name () const { return string(1); }
+
+    /** Exception reason. */
+    StringRef reason () const { return string(2); }
+};
+
+/** Signal view (CrashReport.Signal). */
+class SignalView : public MessageView {
+public:
+    SignalView () {}
+    explicit SignalView (ByteRange body) : MessageView(body) {}
+
+    /** Signal name. */
+    StringRef name () const { return string(1); }
+
+    /** Signal code. */
+    StringRef code () const { return string(2); }
+
+    /** Faulting address. */
+    uint64_t address () const { return varint(3); }
+};
+
+/**
+ * View of a complete crash report file.
+ */
+class ReportView {
+public:
+    /** Range of threads */
+    typedef RepeatedRange<ThreadView, 3> ThreadRange;
+
+    /** Range of binary images */
+    typedef RepeatedRange<ImageView, 4> ImageRange;
+
+    /** Crashed thread index used when the report does not include a summary. */
+    static const uint32_t NO_THREAD = PLCRASH_REPORT_SUMMARY_NO_THREAD;
+
+    /**
+     * Construct a view over an encoded crash report file. The file header and the structure of the top-level
+     * message are validated; use valid() to determine whether validation succeeded.
+     *
+     * @param file The complete report file, including the file header.
+     */
+    explicit ReportView (ByteRange file) : _valid(false), _version(0), _crashed_thread(NO_THREAD) {
+        /* Must match PLCRASH_REPORT_FILE_MAGIC. */
+        static const char magic[] = "plcrash";
+        const size_t prefix_len = sizeof(magic);
+
+        if (file.size() <= prefix_len || memcmp(file.data(), magic, sizeof(magic) - 1) != 0)
+            return;
+
+        _version = file.data()[prefix_len - 1];
+        size_t offset = prefix_len;
+
+        /* Version 2 reports insert a fixed-layout summary header; see plcrash_report_summary_header_t. The
+         * header's first field is its own size. */
+        if (_version == PLCRASH_REPORT_SUMMARY_FILE_VERSION) {
+            const size_t crashed_thread_offset = offsetof(plcrash_report_summary_header_t, crashed_thread);
+            const size_t min_summary_size = sizeof(plcrash_report_summary_header_t);
+            if (file.size() - offset < min_summary_size)
+                return;
+
+            uint64_t size = detail::read_fixed(file.data() + offset, sizeof(uint32_t));
+            if (size < min_summary_size || size > file.size() - offset)
+                return;
+
+            _crashed_thread = (uint32_t) detail::read_fixed(file.data() + offset + crashed_thread_offset, sizeof(uint32_t));
+            offset += (size_t) size;
+        } else if (_version != 1) {
+            return;
+        }
+
+        _message = ByteRange(file.data() + offset, file.size() - offset);
+
+        /* Verify that the top-level fields are well-formed */
+        detail::FieldReader reader(_message);
+        detail::Field field;
+        while (reader.next(field));
+        _valid = !reader.error();
+    }
+
+    /** Return true if the file header and top-level message are well-formed. */
+    bool valid () const { return _valid; }
+
+    /** Return the report file format version. */
+    uint8_t version () const { return _version; }
+
+    /** Return the encoded top-level message, without the file header. */
+    ByteRange message () const { return _message; }
+
+    /** System info. */
+    SystemInfoView system_info () const { return SystemInfoView(field(1)); }
+
+    /** Application info. */
+    ApplicationInfoView application_info () const { return ApplicationInfoView(field(2)); }
+
+    /** All threads. */
+    ThreadRange threads () const { return ThreadRange(_message); }
+
+    /** All binary images. */
+    ImageRange images () const { return ImageRange(_message); }
+
+    /** True if the report includes an uncaught exception. */
+    bool has_exception () const { return has_field(5); }
+
+    /** The uncaught exception. */
+    ExceptionView exception () const { return ExceptionView(field(5)); }
+
+    /** The signal. */
+    SignalView signal () const { return SignalView(field(6)); }
+
+    /** True if the report includes machine info. */
+    bool has_machine_info () const { return has_field(8); }
+
+    /**
+     * Find the crashed thread. If the report includes a summary, the thread at its recorded index is returned
+     * if it is marked as crashed; otherwise, as with plcrash_report_decoder_crashed_thread(), the threads are
+     * scanned for the crashed flag.
+     *
+     * @param thread On success, the crashed thread.
+     * @return Returns true if the crashed thread was found.
+     */
+    bool crashed_thread (ThreadView &thread) const {
+        ThreadRange range = threads();
+
+        /* Try the summary's thread first */
+        if (_crashed_thread != NO_THREAD) {
+            uint32_t index = 0;
+            for (ThreadRange::iterator i = range.begin(); i != range.end(); ++i, ++index) {
+                if (index != _crashed_thread)
+                    continue;
+
+                if ((*i).crashed()) {
+                    thread = *i;
+                    return true;
+                }
+                break;
+            }
+        }
+
+        for (ThreadRange::iterator i = range.begin(); i != range.end(); ++i) {
+            if ((*i).crashed()) {
+                thread = *i;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * Find the image containing @a address.
+     *
+     * @param address The address to look up.
+     * @param image On success, the containing image.
+     * @return Returns true if an image was found.
+     */
+    bool image_for_address (uint64_t address, ImageView &image) const {
+        ImageRange range = images();
+        for (ImageRange::iterator i = range.begin(); i != range.end(); ++i) {
+            ImageView candidate = *i;
+            uint64_t base = candidate.base_address();
+            if (address >= base && address - base < candidate.size()) {
+                image = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    /** Return true if top-level message field @a number is present. */
+    bool has_field (uint32_t number) const {
+        detail::Field result;
+        return detail::find_field(_message, number, detail::WIRE_TYPE_LENGTH_DELIMITED, result);
+    }
+
+    /** Return the payload of top-level message field @a number, or an empty range if not present. */
+    ByteRange field (uint32_t number) const {
+        detail::Field result;
+        if (!detail::find_field(_message, number, detail::WIRE_TYPE_LENGTH_DELIMITED, result))
+            return ByteRange();
+        return result.payload;
+    }
+
+    /** True if the header and top-level message are well-formed */
+    bool _valid;
+
+    /** File format version */
+    uint8_t _version;
+
+    /** Crashed thread index from the summary header, or NO_THREAD */
+    uint32_t _crashed_thread;
+
+    /** Encoded top-level message */
+    ByteRange _message;
+};
+
+} /* namespace plcrash */
+
+/**
+ * @} plcrash_report_view
+ */
+
+#endif /* PLCRASH_REPORT_VIEW_HPP */
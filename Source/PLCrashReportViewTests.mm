@@ -0,0 +1,288 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2010 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+#import "CrashReporter.h"
+#import "PLCrashFrameWalker.h"
+#import "PLCrashLogWriter.h"
+
+#import "PLCrashReportView.hpp"
+
+#import <fcntl.h>
+
+#import <mach-o/dyld.h>
+#import <mach/mach_time.h>
+#import <libkern/OSByteOrder.h>
+
+using namespace plcrash;
+
+@interface PLCrashReportViewTests : SenTestCase {
+@private
+    /* Path to crash log */
+    NSString *_logPath;
+
+    /* Test thread */
+    plframe_test_thead_t _thr_args;
+
+    /* Encoded report file */
+    NSData *_data;
+}
+
+@end
+
+/* Return the given string reference as an NSString */
+static NSString *string_value (StringRef str) {
+    return [[[NSString alloc] initWithBytes: str.data() length: str.size() encoding: NSUTF8StringEncoding] autorelease];
+}
+
+@implementation PLCrashReportViewTests
+
+- (void) setUp {
+    siginfo_t info;
+    plframe_thread_state_t thread_state;
+    plcrash_log_writer_t writer;
+    plcrash_async_file_t file;
+
+    /* Create a temporary log path */
+    _logPath = [[NSTemporaryDirectory() stringByAppendingString: [[NSProcessInfo processInfo] globallyUniqueString]] retain];
+
+    /* Create the test thread */
+    plframe_test_thread_spawn(&_thr_args);
+
+    /* Initialze faux crash data */
+    {
+        info.si_addr = 0x0;
+        info.si_errno = 0;
+        info.si_pid = getpid();
+        info.si_uid = getuid();
+        info.si_code = SEGV_MAPERR;
+        info.si_signo = SIGSEGV;
+        info.si_status = 0;
+
+        /* Steal the test thread's state for iteration */
+        plframe_thread_state_fetch(&thread_state, pthread_mach_thread_np(_thr_args.thread));
+    }
+
+    /* Write the report */
+    int fd = open([_logPath UTF8String], O_RDWR|O_CREAT|O_EXCL, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&writer, @"test.id", @"1.0"), @"Initialization failed");
+    plcrash_log_writer_set_exception(&writer, [NSException exceptionWithName: @"TestException" reason: @"TestReason" userInfo: nil]);
+
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++)
+        plcrash_log_writer_add_image(&writer, _dyld_get_image_header(i));
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&writer, pthread_mach_thread_np(_thr_args.thread), &file, &info, &thread_state.uap), @"Crash log failed");
+
+    plcrash_log_writer_close(&writer);
+    plcrash_log_writer_free(&writer);
+
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+
+    _data = [[NSData dataWithContentsOfMappedFile: _logPath] retain];
+}
+
+- (void) tearDown {
+    NSError *error;
+
+    /* Delete the file */
+    STAssertTrue([[NSFileManager defaultManager] removeItemAtPath: _logPath error: &error], @"Could not remove log file");
+    [_logPath release];
+    [_data release];
+
+    /* Stop the test thread */
+    plframe_test_thread_stop(&_thr_args);
+}
+
+/* Verify that the view matches the Objective-C decoder */
+- (void) testView {
+    NSError *error = nil;
+    PLCrashReport *report = [[[PLCrashReport alloc] initWithData: _data error: &error] autorelease];
+    STAssertNotNil(report, @"Could not decode crash log: %@", error);
+
+    ReportView view(ByteRange((const uint8_t *) [_data bytes], [_data length]));
+    STAssertTrue(view.valid(), @"View rejected a valid report");
+    STAssertEquals((uint8_t) PLCRASH_REPORT_FILE_VERSION, view.version(), @"Incorrect version");
+
+    /* Top-level sections */
+    STAssertEqualStrings(report.systemInfo.operatingSystemVersion, string_value(view.system_info().os_version()), @"Incorrect OS version");
+    STAssertEquals((int64_t) [report.systemInfo.timestamp timeIntervalSince1970], view.system_info().timestamp(), @"Incorrect timestamp");
+    STAssertEqualStrings(report.applicationInfo.applicationIdentifier, string_value(view.application_info().identifier()), @"Incorrect application identifier");
+    STAssertEqualStrings(report.signalInfo.name, string_value(view.signal().name()), @"Incorrect signal name");
+    STAssertEqualStrings(report.signalInfo.code, string_value(view.signal().code()), @"Incorrect signal code");
+    STAssertTrue(view.has_exception(), @"Missing exception");
+    STAssertEqualStrings(@"TestReason", string_value(view.exception().reason()), @"Incorrect exception reason");
+
+    /* Threads */
+    STAssertEquals([report.threads count], (NSUInteger) view.threads().count(), @"Incorrect thread count");
+
+    NSUInteger index = 0;
+    ReportView::ThreadRange threads = view.threads();
+    for (ReportView::ThreadRange::iterator i = threads.begin(); i != threads.end(); ++i, ++index) {
+        PLCrashReportThreadInfo *expected = [report.threads objectAtIndex: index];
+        ThreadView thread = *i;
+
+        STAssertEquals((uint32_t) expected.threadNumber, thread.number(), @"Incorrect thread number");
+        STAssertEquals(expected.crashed, (BOOL) thread.crashed(), @"Incorrect crashed flag");
+
+        NSUInteger frameIndex = 0;
+        ThreadView::FrameRange frames = thread.frames();
+        for (ThreadView::FrameRange::iterator f = frames.begin(); f != frames.end(); ++f, ++frameIndex) {
+            PLCrashReportStackFrameInfo *frame = [expected.stackFrames objectAtIndex: frameIndex];
+            STAssertEquals(frame.instructionPointer, (*f).pc(), @"Incorrect PC");
+        }
+        STAssertEquals([expected.stackFrames count], frameIndex, @"Incorrect frame count");
+
+        NSUInteger registerIndex = 0;
+        ThreadView::RegisterRange registers = thread.registers();
+        for (ThreadView::RegisterRange::iterator r = registers.begin(); r != registers.end(); ++r, ++registerIndex) {
+            PLCrashReportRegisterInfo *reg = [expected.registers objectAtIndex: registerIndex];
+            STAssertEqualStrings(reg.registerName, string_value((*r).name()), @"Incorrect register name");
+            STAssertEquals(reg.registerValue, (*r).value(), @"Incorrect register value");
+        }
+        STAssertEquals([expected.registers count], registerIndex, @"Incorrect register count");
+    }
+
+    /* Crashed thread */
+    ThreadView crashed;
+    STAssertTrue(view.crashed_thread(crashed), @"No crashed thread found");
+    STAssertEquals((uint32_t) report.crashedThread.threadNumber, crashed.number(), @"Incorrect crashed thread");
+
+    /* Images */
+    STAssertEquals([report.images count], (NSUInteger) view.images().count(), @"Incorrect image count");
+
+    index = 0;
+    ReportView::ImageRange images = view.images();
+    for (ReportView::ImageRange::iterator i = images.begin(); i != images.end(); ++i, ++index) {
+        PLCrashReportBinaryImageInfo *expected = [report.images objectAtIndex: index];
+        ImageView image = *i;
+
+        STAssertEquals(expected.imageBaseAddress, image.base_address(), @"Incorrect base address");
+        STAssertEquals(expected.imageSize, image.size(), @"Incorrect image size");
+        STAssertEqualStrings(expected.imageName, string_value(image.name()), @"Incorrect image name");
+        STAssertEquals(expected.hasImageUUID, (BOOL) image.has_uuid(), @"Incorrect UUID presence");
+        if (image.has_uuid())
+            STAssertEquals((size_t) 16, image.uuid().size(), @"Incorrect UUID length");
+
+        ImageView found;
+        STAssertTrue(view.image_for_address(image.base_address(), found), @"Image lookup failed");
+    }
+}
+
+/* Verify that the crashed thread is found by its flag if the summary's index is out of range, or names a thread
+ * that is not marked as crashed */
+- (void) testCrashedThreadFallback {
+    NSMutableData *data = [NSMutableData dataWithData: _data];
+    uint8_t *header = (uint8_t *) [data mutableBytes] + offsetof(struct PLCrashReportFileHeader, data);
+    const uint32_t indices[] = { 1000, 0, 1 };
+
+    ReportView original(ByteRange((const uint8_t *) [_data bytes], [_data length]));
+    ThreadView expected;
+    STAssertTrue(original.crashed_thread(expected), @"No crashed thread found");
+
+    for (size_t i = 0; i < sizeof(indices) / sizeof(indices[0]); i++) {
+        uint32_t index = OSSwapHostToLittleInt32(indices[i]);
+        memcpy(header + offsetof(plcrash_report_summary_header_t, crashed_thread), &index, sizeof(index));
+
+        ReportView view(ByteRange((const uint8_t *) [data bytes], [data length]));
+        ThreadView crashed;
+        STAssertTrue(view.crashed_thread(crashed), @"No crashed thread found for summary index %u", indices[i]);
+        STAssertEquals(expected.number(), crashed.number(), @"Incorrect crashed thread for summary index %u", indices[i]);
+    }
+}
+
+/* Verify that invalid headers and truncated reports are handled */
+- (void) testInvalid {
+    const uint8_t *bytes = (const uint8_t *) [_data bytes];
+
+    /* Bad magic */
+    const uint8_t bad_magic[] = { 'p', 'l', 'c', 'r', 'a', 's', 'x', 1, 0x0A, 0x00 };
+    STAssertFalse(ReportView(ByteRange(bad_magic, sizeof(bad_magic))).valid(), @"Accepted bad magic");
+
+    /* Unsupported version */
+    const uint8_t bad_version[] = { 'p', 'l', 'c', 'r', 'a', 's', 'h', 9, 0x0A, 0x00 };
+    STAssertFalse(ReportView(ByteRange(bad_version, sizeof(bad_version))).valid(), @"Accepted unsupported version");
+
+    /* Truncated top-level field */
+    STAssertFalse(ReportView(ByteRange(bytes, [_data length] - 1)).valid(), @"Accepted truncated report");
+
+    /* Truncated reports must be safely iterable, even if rejected */
+    for (size_t len = 0; len < [_data length]; len += 13) {
+        ReportView view(ByteRange(bytes, len));
+        ReportView::ThreadRange threads = view.threads();
+        for (ReportView::ThreadRange::iterator i = threads.begin(); i != threads.end(); ++i)
+            (*i).frames().count();
+    }
+}
+
+/* Measure scan throughput */
+- (void) testScanPerformance {
+    const int iterations = 1000;
+    const uint8_t *bytes = (const uint8_t *) [_data bytes];
+    size_t len = [_data length];
+    mach_timebase_info_data_t timebase;
+    uint64_t sum = 0;
+
+    mach_timebase_info(&timebase);
+
+    /* Find the crashed thread and walk its frames */
+    uint64_t crashed_start = mach_absolute_time();
+    for (int i = 0; i < iterations; i++) {
+        ReportView view(ByteRange(bytes, len));
+        ThreadView thread;
+        STAssertTrue(view.crashed_thread(thread), @"No crashed thread found");
+
+        ThreadView::FrameRange frames = thread.frames();
+        for (ThreadView::FrameRange::iterator f = frames.begin(); f != frames.end(); ++f)
+            sum += (*f).pc();
+    }
+    uint64_t crashed_ns = (mach_absolute_time() - crashed_start) * timebase.numer / timebase.denom;
+
+    /* Walk every frame of every thread */
+    uint64_t full_start = mach_absolute_time();
+    for (int i = 0; i < iterations; i++) {
+        ReportView view(ByteRange(bytes, len));
+        ReportView::ThreadRange threads = view.threads();
+        for (ReportView::ThreadRange::iterator t = threads.begin(); t != threads.end(); ++t) {
+            ThreadView::FrameRange frames = (*t).frames();
+            for (ThreadView::FrameRange::iterator f = frames.begin(); f != frames.end(); ++f)
+                sum += (*f).pc();
+        }
+    }
+    uint64_t full_ns = (mach_absolute_time() - full_start) * timebase.numer / timebase.denom;
+
+    NSLog(@"Report view scan: bytes=%zu crashed thread=%.1f MB/s all frames=%.1f MB/s (%llx)", len,
+          crashed_ns ? (len * (double) iterations * 1000.0 / crashed_ns) : 0.0,
+          full_ns ? (len * (double) iterations * 1000.0 / full_ns) : 0.0,
+          sum);
+}
+
+@end
@@ -77,6 +77,24 @@ typedef struct PLCrashReporterCallbacks {
 
     /** Path to the crash reporter internal data directory */
     NSString *_crashReportDirectory;
+
+    /** YES if crashes should be handled on a dedicated handler thread */
+    BOOL _handlerThreadEnabled;
+
+    /** YES if host information and binary image registration should be completed on a background thread */
+    BOOL _deferredInitializationEnabled;
+
+    /** YES if stack frames should be symbolicated in-process at crash time */
+    BOOL _symbolicationEnabled;
+
+    /** YES if the pending crash report queue has been opened */
+    BOOL _queueOpen;
+
+    /** Maximum number of pending crash reports */
+    NSUInteger _maxPendingReports;
+
+    /** Maximum total size of all pending crash reports, in bytes */
+    uint64_t _maxPendingBytes;
 }
 
 + (PLCrashReporter *) sharedReporter;
@@ -89,9 +107,24 @@ typedef struct PLCrashReporterCallbacks {
 - (BOOL) purgePendingCrashReport;
 - (BOOL) purgePendingCrashReportAndReturnError: (NSError **) outError;
 
+- (NSArray *) pendingCrashReportIdentifiers;
+- (NSData *) loadPendingCrashReportDataWithIdentifier: (NSNumber *) identifier error: (NSError **) outError;
+- (BOOL) purgePendingCrashReportWithIdentifier: (NSNumber *) identifier error: (NSError **) outError;
+
+- (void) setMaximumPendingCrashReports: (NSUInteger) count maximumBytes: (uint64_t) bytes;
+
 - (BOOL) enableCrashReporter;
 - (BOOL) enableCrashReporterAndReturnError: (NSError **) outError;
 
+- (BOOL) registerCurrentThread;
+- (BOOL) registerCurrentThreadAndReturnError: (NSError **) outError;
+
 - (void) setCrashCallbacks: (PLCrashReporterCallbacks *) callbacks;
 
+- (void) setHandlerThreadEnabled: (BOOL) enabled;
+
+- (void) setDeferredInitializationEnabled: (BOOL) enabled;
+
+- (void) setSymbolicationEnabled: (BOOL) enabled;
+
 @end
\ No newline at end of file
@@ -32,6 +32,7 @@
 
 #import "PLCrashAsync.h"
 #import "PLCrashLogWriter.h"
+#import "PLCrashReportQueue.h"
 
 #import <fcntl.h>
 #import <mach-o/dyld.h>
@@ -45,7 +46,7 @@
 static NSString *PLCRASH_CACHE_DIR = @"com.plausiblelabs.crashreporter.data";
 
 /** @internal
- * Crash Report file name. */
+ * Legacy crash report file name. Reports written by earlier releases are moved into the report queue. */
 static NSString *PLCRASH_LIVE_CRASHREPORT = @"live_report.plcrash";
 
 /** @internal
@@ -61,6 +62,14 @@ static NSString *PLCRASH_QUEUED_DIR = @"queued_reports";
  */
 #define MAX_REPORT_BYTES (64 * 1024)
 
+/** @internal
+ * Default maximum number of pending crash reports. */
+#define DEFAULT_MAX_PENDING_REPORTS 8
+
+/** @internal
+ * Default maximum total size of all pending crash reports. */
+#define DEFAULT_MAX_PENDING_BYTES (DEFAULT_MAX_PENDING_REPORTS * MAX_REPORT_BYTES)
+
 /**
  * @internal
  * Crash reporter singleton.
@@ -76,8 +85,8 @@ typedef struct signal_handler_ctx {
     /** PLCrashLogWriter instance */
     plcrash_log_writer_t writer;
 
-    /** Path to the output file */
-    const char *path;
+    /** Pending crash report queue. A slot is reserved for the next crash report when the reporter is enabled. */
+    plcrash_report_queue_t queue;
 } plcrashreporter_handler_ctx_t;
 
 
@@ -105,14 +114,14 @@ static PLCrashReporterCallbacks crashCallbacks = {
  *
  * Signal handler callback.
  */
-static void signal_handler_callback (int signal, siginfo_t *info, ucontext_t *uap, void *context) {
+static void signal_handler_callback (int signal, siginfo_t *info, ucontext_t *uap, thread_t crashed_thread, void *context) {
     plcrashreporter_handler_ctx_t *sigctx = context;
     plcrash_async_file_t file;
 
-    /* Open the output file */
-    int fd = open(sigctx->path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+    /* Claim the pre-opened report slot */
+    int fd = plcrash_report_queue_begin(&sigctx->queue);
     if (fd < 0) {
-        PLCF_DEBUG("Could not open the crashlog output file: %s", strerror(errno));
+        PLCF_DEBUG("No crash report slot has been reserved");
         return;
     }
 
@@ -120,11 +129,32 @@ static void signal_handler_callback (int signal, siginfo_t *info, ucontext_t *ua
     plcrash_async_file_init(&file, fd, MAX_REPORT_BYTES);
 
     /* Write the crash log using the already-initialized writer */
-    plcrash_log_writer_write(&sigctx->writer, &file, info, uap);
+    plcrash_log_writer_write(&sigctx->writer, crashed_thread, &file, info, uap);
+
+    /* Append any crashes that occured on other threads while the report was being written */
+    plcrash_signal_gate_t *gate = plcrash_signal_handler_gate();
+    size_t secondary_count = plcrash_signal_gate_record_count(gate);
+    for (size_t i = 0; i < secondary_count; i++) {
+        plcrash_signal_gate_record_t *record = plcrash_signal_gate_get_record(gate, i);
+        if (record != NULL)
+            plcrash_log_writer_write_secondary_crash(&sigctx->writer, &file, &record->info, record->pc);
+    }
+
+    /* Record the crash handler's stack usage */
+    size_t stack_size, stack_used;
+    if (plcrash_signal_handler_stack_usage(&stack_size, &stack_used))
+        plcrash_log_writer_write_handler_info(&sigctx->writer, &file, stack_size, stack_used);
+
     plcrash_log_writer_close(&sigctx->writer);
 
     /* Finished */
     plcrash_async_file_flush(&file);
+
+    /* Publish the report */
+    off_t size = lseek(fd, 0, SEEK_CUR);
+    if (plcrash_report_queue_commit(&sigctx->queue, size > 0 ? size : 0) != PLCRASH_ESUCCESS)
+        PLCF_DEBUG("Could not publish the crash report");
+
     plcrash_async_file_close(&file);
 
     /* Call any post-crash callback */
@@ -167,6 +197,7 @@ static void uncaught_exception_handler (NSException *exception) {
     abort();
 }
 
+static void populate_nserror (NSError **error, PLCrashReporterError code, NSString *description);
 
 @interface PLCrashReporter (PrivateMethods)
 
@@ -178,6 +209,11 @@ static void uncaught_exception_handler (NSException *exception) {
 - (NSString *) queuedCrashReportDirectory;
 - (NSString *) crashReportPath;
 
+- (BOOL) openReportQueueAndReturnError: (NSError **) outError;
+- (void) completeDeferredInitialization;
+- (NSString *) pathForReportSlot: (uint32_t) slot;
+- (int32_t) slotForReportIdentifier: (NSNumber *) identifier error: (NSError **) outError;
+
 @end
 
 
@@ -200,16 +236,20 @@ static void uncaught_exception_handler (NSException *exception) {
 /**
  * Returns YES if the application has previously crashed and
  * an pending crash report is available.
+ *
+ * Pending reports are tracked by a fixed-size index; this method does not scan the file system.
  */
 - (BOOL) hasPendingCrashReport {
-    /* Check for a live crash report file */
-    return [[NSFileManager defaultManager] fileExistsAtPath: [self crashReportPath]];
+    if (![self openReportQueueAndReturnError: NULL])
+        return NO;
+
+    return plcrash_report_queue_has_pending(&signal_handler_context.queue);
 }
 
 
 /**
  * If an application has a pending crash report, this method returns the crash
- * report data.
+ * report data. If multiple reports are pending, the oldest report is returned.
  *
  * You may use this to submit the report to your own HTTP server, over e-mail, or even parse and
  * introspect the report locally using the PLCrashReport API.
@@ -223,7 +263,7 @@ static void uncaught_exception_handler (NSException *exception) {
 
 /**
  * If an application has a pending crash report, this method returns the crash
- * report data.
+ * report data. If multiple reports are pending, the oldest report is returned.
  *
  * You may use this to submit the report to your own HTTP server, over e-mail, or even parse and
  * introspect the report locally using the PLCrashReport API.
@@ -236,13 +276,19 @@ static void uncaught_exception_handler (NSException *exception) {
  * @return Returns nil if the crash report data could not be loaded.
  */
 - (NSData *) loadPendingCrashReportDataAndReturnError: (NSError **) outError {
-    /* Load the (memory mapped) data */
-    return [NSData dataWithContentsOfFile: [self crashReportPath] options: NSMappedRead error: outError];
+    NSNumber *identifier = [[self pendingCrashReportIdentifiers] lastObject];
+    if (identifier == nil) {
+        populate_nserror(outError, PLCrashReporterErrorCrashReportNotFound, NSLocalizedString(@"No crash report is pending",
+                                                                                              @"No pending crash report"));
+        return nil;
+    }
+
+    return [self loadPendingCrashReportDataWithIdentifier: identifier error: outError];
 }
 
 
 /**
- * Purge a pending crash report.
+ * Purge a pending crash report. If multiple reports are pending, the oldest report is purged.
  *
  * @return Returns YES on success, or NO on error.
  */
@@ -252,12 +298,93 @@ static void uncaught_exception_handler (NSException *exception) {
 
 
 /**
- * Purge a pending crash report.
+ * Purge a pending crash report. If multiple reports are pending, the oldest report is purged.
  *
  * @return Returns YES on success, or NO on error.
  */
 - (BOOL) purgePendingCrashReportAndReturnError: (NSError **) outError {
-    return [[NSFileManager defaultManager] removeItemAtPath: [self crashReportPath] error: outError];
+    NSNumber *identifier = [[self pendingCrashReportIdentifiers] lastObject];
+    if (identifier == nil) {
+        populate_nserror(outError, PLCrashReporterErrorCrashReportNotFound, NSLocalizedString(@"No crash report is pending",
+                                                                                              @"No pending crash report"));
+        return NO;
+    }
+
+    return [self purgePendingCrashReportWithIdentifier: identifier error: outError];
+}
+
+
+/**
+ * Return the identifiers of all pending crash reports, as an array of NSNumber instances, ordered from newest to
+ * oldest. Report identifiers are unique, and increase monotonically.
+ *
+ * @return Returns the pending report identifiers. If no reports are pending, or the pending report queue can not
+ * be opened, an empty array is returned.
+ */
+- (NSArray *) pendingCrashReportIdentifiers {
+    uint32_t slots[PLCRASH_REPORT_QUEUE_MAX_SLOTS];
+    uint32_t count;
+
+    if (![self openReportQueueAndReturnError: NULL])
+        return [NSArray array];
+
+    count = plcrash_report_queue_pending(&signal_handler_context.queue, slots, PLCRASH_REPORT_QUEUE_MAX_SLOTS);
+
+    NSMutableArray *identifiers = [NSMutableArray arrayWithCapacity: count];
+    for (uint32_t i = count; i > 0; i--) {
+        const plcrash_report_queue_entry_t *entry = plcrash_report_queue_entry(&signal_handler_context.queue, slots[i - 1]);
+        [identifiers addObject: [NSNumber numberWithUnsignedLongLong: entry->sequence]];
+    }
+
+    return identifiers;
+}
+
+
+/**
+ * Return the crash report data for the pending crash report with the given identifier.
+ *
+ * @param identifier A report identifier, as returned by PLCrashReporter::pendingCrashReportIdentifiers.
+ * @param outError A pointer to an NSError object variable. If an error occurs, this pointer
+ * will contain an error object indicating why the pending crash report could not be
+ * loaded. If no error occurs, this parameter will be left unmodified. You may specify
+ * nil for this parameter, and no error information will be provided.
+ *
+ * @return Returns nil if the crash report data could not be loaded.
+ */
+- (NSData *) loadPendingCrashReportDataWithIdentifier: (NSNumber *) identifier error: (NSError **) outError {
+    int32_t slot = [self slotForReportIdentifier: identifier error: outError];
+    if (slot < 0)
+        return nil;
+
+    /* Load the (memory mapped) data */
+    return [NSData dataWithContentsOfFile: [self pathForReportSlot: slot] options: NSMappedRead error: outError];
+}
+
+
+/**
+ * Purge the pending crash report with the given identifier.
+ *
+ * @param identifier A report identifier, as returned by PLCrashReporter::pendingCrashReportIdentifiers.
+ * @param outError A pointer to an NSError object variable. If an error occurs, this pointer
+ * will contain an error object indicating why the pending crash report could not be
+ * purged. If no error occurs, this parameter will be left unmodified. You may specify
+ * nil for this parameter, and no error information will be provided.
+ *
+ * @return Returns YES on success, or NO on error.
+ */
+- (BOOL) purgePendingCrashReportWithIdentifier: (NSNumber *) identifier error: (NSError **) outError {
+    plcrash_error_t err;
+
+    int32_t slot = [self slotForReportIdentifier: identifier error: outError];
+    if (slot < 0)
+        return NO;
+
+    if ((err = plcrash_report_queue_remove(&signal_handler_context.queue, slot)) != PLCRASH_ESUCCESS) {
+        populate_nserror(outError, PLCrashReporterErrorOperatingSystem, [NSString stringWithFormat: @"Could not remove crash report: %s", plcrash_strerror(err)]);
+        return NO;
+    }
+
+    return YES;
 }
 
 
@@ -294,32 +421,84 @@ static void uncaught_exception_handler (NSException *exception) {
     if (_enabled)
         [NSException raise: PLCrashReporterException format: @"The crash reporter has alread been enabled"];
 
-    /* Create the directory tree */
-    if (![self populateCrashReportDirectoryAndReturnError: outError])
+    /* Open the report queue, and reserve a slot for the next crash report */
+    if (![self openReportQueueAndReturnError: outError])
         return NO;
 
+    plcrash_error_t err = plcrash_report_queue_reserve(&signal_handler_context.queue, MAX_REPORT_BYTES);
+    if (err != PLCRASH_ESUCCESS) {
+        populate_nserror(outError, PLCrashReporterErrorOperatingSystem, [NSString stringWithFormat: @"Could not reserve a crash report slot: %s", plcrash_strerror(err)]);
+        return NO;
+    }
+
     /* Set up the signal handler context */
-    signal_handler_context.path = strdup([[self crashReportPath] UTF8String]); // NOTE: would leak if this were not a singleton struct
     assert(_applicationIdentifier != nil);
     assert(_applicationVersion != nil);
-    plcrash_log_writer_init(&signal_handler_context.writer, _applicationIdentifier, _applicationVersion);
+    if (_deferredInitializationEnabled) {
+        /* The loaded images are registered without symbols; host information, symbol tables and dyld image
+         * monitoring are populated by completeDeferredInitialization */
+        plcrash_log_writer_init_minimal(&signal_handler_context.writer, _applicationIdentifier, _applicationVersion);
+        if (_symbolicationEnabled)
+            plcrash_log_writer_enable_symbolication(&signal_handler_context.writer, PLCRASH_LOG_WRITER_DEFAULT_SYMBOLICATION_LIMIT);
+    } else {
+        plcrash_log_writer_init(&signal_handler_context.writer, _applicationIdentifier, _applicationVersion);
+        if (_symbolicationEnabled)
+            plcrash_log_writer_enable_symbolication(&signal_handler_context.writer, PLCRASH_LOG_WRITER_DEFAULT_SYMBOLICATION_LIMIT);
     
-    /* Enable dyld image monitoring */
-    _dyld_register_func_for_add_image(image_add_callback);
-    _dyld_register_func_for_remove_image(image_remove_callback);
+        /* Enable dyld image monitoring */
+        _dyld_register_func_for_add_image(image_add_callback);
+        _dyld_register_func_for_remove_image(image_remove_callback);
+    }
 
     /* Enable the signal handler */
-    if (![[PLCrashSignalHandler sharedHandler] registerHandlerWithCallback: &signal_handler_callback context: &signal_handler_context error: outError])
+    if (![[PLCrashSignalHandler sharedHandler] registerHandlerWithCallback: &signal_handler_callback
+                                                                   context: &signal_handler_context
+                                                             handlerThread: _handlerThreadEnabled
+                                                                     error: outError])
         return NO;
 
     /* Set the uncaught exception handler */
     NSSetUncaughtExceptionHandler(&uncaught_exception_handler);
 
+    /* Now that the handler is armed, complete any deferred initialization off the calling thread */
+    if (_deferredInitializationEnabled)
+        [NSThread detachNewThreadSelector: @selector(completeDeferredInitialization) toTarget: self withObject: nil];
+
     /* Success */
     _enabled = YES;
     return YES;
 }
 
+/**
+ * Install an alternate signal stack on the calling thread, allowing crashes caused by stack overflow on this
+ * thread to be reported. The thread that enables the crash reporter is registered automatically; other threads
+ * should call this method when they start. The signal stack is released when the thread exits.
+ *
+ * @return Returns YES on success, or NO if no signal stack could be installed.
+ */
+- (BOOL) registerCurrentThread {
+    return [self registerCurrentThreadAndReturnError: nil];
+}
+
+/**
+ * Install an alternate signal stack on the calling thread, allowing crashes caused by stack overflow on this
+ * thread to be reported. The thread that enables the crash reporter is registered automatically; other threads
+ * should call this method when they start. The signal stack is released when the thread exits.
+ *
+ * Signal stacks are allocated from a fixed-size pool. If the pool has been exhausted, this method will
+ * return NO.
+ *
+ * @param outError A pointer to an NSError object variable. If an error occurs, this pointer
+ * will contain an error object indicating why the signal stack could not be installed.
+ * If no error occurs, this parameter will be left unmodified. You may specify nil for this
+ * parameter, and no error information will be provided.
+ *
+ * @return Returns YES on success, or NO if no signal stack could be installed.
+ */
+- (BOOL) registerCurrentThreadAndReturnError: (NSError **) outError {
+    return [[PLCrashSignalHandler sharedHandler] registerCurrentThreadAndReturnError: outError];
+}
+
 /**
  * Set the callbacks that will be executed by the receiver after a crash has occured and been recorded by PLCrashReporter.
  *
@@ -346,6 +525,105 @@ static void uncaught_exception_handler (NSException *exception) {
     crashCallbacks.handleSignal = callbacks->handleSignal;
 }
 
+/**
+ * Enable or disable use of a dedicated crash handler thread. Disabled by default.
+ *
+ * When enabled, a thread with a large, preallocated stack is spawned when the crash reporter is enabled. Upon
+ * a crash, the crashed thread hands off its context to the handler thread and waits, and the crash report (and
+ * any post-crash callbacks) are executed on the handler thread. This avoids running the report writer on the
+ * crashed thread's limited alternate signal stack.
+ *
+ * @param enabled YES to enable the dedicated handler thread.
+ *
+ * @note This method must be called prior to PLCrashReporter::enableCrashReporter or
+ * PLCrashReporter::enableCrashReporterAndReturnError:
+ */
+- (void) setHandlerThreadEnabled: (BOOL) enabled {
+    /* Check for programmer error */
+    if (_enabled)
+        [NSException raise: PLCrashReporterException format: @"The crash reporter has alread been enabled"];
+
+    _handlerThreadEnabled = enabled;
+}
+
+/**
+ * Enable or disable deferred initialization. Disabled by default.
+ *
+ * When enabled, PLCrashReporter::enableCrashReporterAndReturnError: arms the signal handler with only the
+ * information that is inexpensive to fetch, and a background thread then fetches the host information (OS
+ * version, machine model, process names) and registers for dyld image notifications, building any symbol tables.
+ * The binary images loaded at the time the reporter is enabled are always recorded. This substantially reduces
+ * the time spent enabling the reporter at application launch, particularly for processes with many loaded
+ * images.
+ *
+ * A crash that occurs before the background initialization completes is still reported, but the report may
+ * omit the host information, symbols, and any binary images loaded after the crash reporter was enabled.
+ *
+ * @param enabled YES to enable deferred initialization.
+ *
+ * @note This method must be called prior to PLCrashReporter::enableCrashReporter or
+ * PLCrashReporter::enableCrashReporterAndReturnError:
+ */
+- (void) setDeferredInitializationEnabled: (BOOL) enabled {
+    /* Check for programmer error */
+    if (_enabled)
+        [NSException raise: PLCrashReporterException format: @"The crash reporter has alread been enabled"];
+
+    _deferredInitializationEnabled = enabled;
+}
+
+/**
+ * Enable or disable in-process symbolication. Disabled by default.
+ *
+ * When enabled, a table of each loaded image's exported symbols is built as the image is registered, and each
+ * stack frame of a crash report records the name of its nearest preceding exported symbol, and the frame's offset
+ * from that symbol. This allows a report to be read without the application's dSYM or the system's symbols,
+ * but frames within non-exported functions are attributed to the preceding exported symbol.
+ *
+ * The tables cost 8 bytes per exported symbol, and their total size is limited to
+ * PLCRASH_LOG_WRITER_DEFAULT_SYMBOLICATION_LIMIT; images registered beyond that limit are not symbolicated. Building
+ * the tables adds to the cost of registering each image; see setDeferredInitializationEnabled: to move this work
+ * off of the calling thread.
+ *
+ * @param enabled YES to enable in-process symbolication.
+ *
+ * @note This method must be called prior to PLCrashReporter::enableCrashReporter or
+ * PLCrashReporter::enableCrashReporterAndReturnError:
+ */
+- (void) setSymbolicationEnabled: (BOOL) enabled {
+    /* Check for programmer error */
+    if (_enabled)
+        [NSException raise: PLCrashReporterException format: @"The crash reporter has alread been enabled"];
+
+    _symbolicationEnabled = enabled;
+}
+
+/**
+ * Set the maximum number and total size of pending crash reports. When the limits would be exceeded by a new
+ * crash report, the oldest pending reports are discarded. By default, up to 8 reports, totalling no more than
+ * 512KB, are retained.
+ *
+ * @param count The maximum number of pending crash reports. Must be at least 1, and no greater than 32.
+ * @param bytes The maximum total size of all pending crash reports, in bytes.
+ *
+ * @note This method must be called prior to PLCrashReporter::enableCrashReporter or
+ * PLCrashReporter::enableCrashReporterAndReturnError:
+ */
+- (void) setMaximumPendingCrashReports: (NSUInteger) count maximumBytes: (uint64_t) bytes {
+    /* Check for programmer error */
+    if (_enabled)
+        [NSException raise: PLCrashReporterException format: @"The crash reporter has alread been enabled"];
+
+    if (count == 0 || count > PLCRASH_REPORT_QUEUE_MAX_SLOTS)
+        [NSException raise: PLCrashReporterException format: @"Pending crash report count must be between 1 and %d", PLCRASH_REPORT_QUEUE_MAX_SLOTS];
+
+    _maxPendingReports = count;
+    _maxPendingBytes = bytes;
+
+    if (_queueOpen)
+        plcrash_report_queue_set_quota(&signal_handler_context.queue, _maxPendingReports, _maxPendingBytes);
+}
+
 
 @end
 
@@ -376,6 +654,10 @@ static void uncaught_exception_handler (NSException *exception) {
     /* Save application ID and version */
     _applicationIdentifier = [applicationIdentifier retain];
     _applicationVersion = [applicationVersion retain];
+
+    /* Default report queue quotas */
+    _maxPendingReports = DEFAULT_MAX_PENDING_REPORTS;
+    _maxPendingBytes = DEFAULT_MAX_PENDING_BYTES;
     
     /* No occurances of '/' should ever be in a bundle ID, but just to be safe, we escape them */
     NSString *appIdPath = [applicationIdentifier stringByReplacingOccurrencesOfString: @"/" withString: @"_"];
@@ -471,12 +753,115 @@ static void uncaught_exception_handler (NSException *exception) {
 
 
 /**
- * Return the path to live crash report (which may not yet, or ever, exist).
+ * Return the path to the legacy live crash report (which may not exist).
  */
 - (NSString *) crashReportPath {
     return [[self crashReportDirectory] stringByAppendingPathComponent: PLCRASH_LIVE_CRASHREPORT];
 }
 
+/**
+ * Open the pending crash report queue, if it has not already been opened. Any crash report written to the legacy
+ * live crash report path is moved into the queue.
+ */
+- (BOOL) openReportQueueAndReturnError: (NSError **) outError {
+    plcrash_error_t err;
+
+    if (_queueOpen)
+        return YES;
+
+    /* Create the directory tree */
+    if (![self populateCrashReportDirectoryAndReturnError: outError])
+        return NO;
+
+    err = plcrash_report_queue_open(&signal_handler_context.queue, [[self queuedCrashReportDirectory] fileSystemRepresentation], _maxPendingReports, _maxPendingBytes);
+    if (err != PLCRASH_ESUCCESS) {
+        populate_nserror(outError, PLCrashReporterErrorOperatingSystem, [NSString stringWithFormat: @"Could not open the crash report queue: %s", plcrash_strerror(err)]);
+        return NO;
+    }
+    _queueOpen = YES;
+
+    /* Import any legacy crash report */
+    if ([[NSFileManager defaultManager] fileExistsAtPath: [self crashReportPath]]) {
+        if ((err = plcrash_report_queue_add_file(&signal_handler_context.queue, [[self crashReportPath] fileSystemRepresentation])) != PLCRASH_ESUCCESS)
+            NSDEBUG(@"Could not import legacy crash report: %s", plcrash_strerror(err));
+    }
+
+    return YES;
+}
+
+/**
+ * Complete a deferred enable: fetch the writer's host information, and register for dyld image notifications.
+ * Registration invokes the add callback for every image that is already loaded. Executed on a background thread.
+ */
+- (void) completeDeferredInitialization {
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+    plcrash_error_t err = plcrash_log_writer_load_host_info(&signal_handler_context.writer);
+    if (err != PLCRASH_ESUCCESS)
+        NSDEBUG(@"Could not load host information: %s", plcrash_strerror(err));
+
+    /* Enable dyld image monitoring */
+    _dyld_register_func_for_add_image(image_add_callback);
+    _dyld_register_func_for_remove_image(image_remove_callback);
+
+    [pool release];
+}
+
+/**
+ * Return the path to the report file for @a slot.
+ */
+- (NSString *) pathForReportSlot: (uint32_t) slot {
+    char path[PATH_MAX];
+
+    if (plcrash_report_queue_slot_path(&signal_handler_context.queue, slot, path, sizeof(path)) != PLCRASH_ESUCCESS)
+        return nil;
+
+    return [[NSFileManager defaultManager] stringWithFileSystemRepresentation: path length: strlen(path)];
+}
+
+/**
+ * Return the queue slot holding the pending report with @a identifier, or -1 if not found.
+ */
+- (int32_t) slotForReportIdentifier: (NSNumber *) identifier error: (NSError **) outError {
+    int32_t slot;
+
+    if (![self openReportQueueAndReturnError: outError])
+        return -1;
+
+    slot = plcrash_report_queue_find(&signal_handler_context.queue, [identifier unsignedLongLongValue]);
+    if (slot < 0) {
+        populate_nserror(outError, PLCrashReporterErrorCrashReportNotFound, [NSString stringWithFormat: NSLocalizedString(@"No pending crash report with identifier %@", @"Missing crash report"), identifier]);
+        return -1;
+    }
+
+    return slot;
+}
+
 
 
 @end
+
+/**
+ * @internal
+ 
+ * Populate an NSError instance with the provided information.
+ *
+ * @param error Error instance to populate. If NULL, this method returns
+ * and nothing is modified.
+ * @param code The error code corresponding to this error.
+ * @param description A localized error description.
+ */
+static void populate_nserror (NSError **error, PLCrashReporterError code, NSString *description) {
+    NSMutableDictionary *userInfo;
+    
+    if (error == NULL)
+        return;
+    
+    /* Create the userInfo dictionary */
+    userInfo = [NSDictionary dictionaryWithObjectsAndKeys:
+                description, NSLocalizedDescriptionKey,
+                nil
+                ];
+    
+    *error = [NSError errorWithDomain: PLCrashReporterErrorDomain code: code userInfo: userInfo];
+}
@@ -0,0 +1,126 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PLCrashSignalGate.h"
+#include "PLCrashAsync.h"
+
+#include <libkern/OSAtomic.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_signal_gate Crash Arbitration
+ * @ingroup plcrash_internal
+ *
+ * Async-safe arbitration between threads that crash concurrently.
+ *
+ * If multiple threads crash at nearly the same time, each will enter the fatal signal handler. Only one
+ * thread may write the crash report; the first thread to enter the gate acquires it, and all later crashing
+ * threads are expected to record a compact secondary crash record and then park until the process terminates.
+ * Records are written into preallocated slots, and may be appended to the crash report by the gate owner.
+ *
+ * @{
+ */
+
+/**
+ * Attempt to acquire the gate on behalf of @a thread.
+ *
+ * @param gate The gate.
+ * @param thread The crashed thread.
+ *
+ * @return Returns PLCRASH_SIGNAL_GATE_ACQUIRED if @a thread is the first thread to enter the gate,
+ * PLCRASH_SIGNAL_GATE_RECURSIVE if @a thread already holds the gate, or PLCRASH_SIGNAL_GATE_SECONDARY
+ * if another thread holds the gate.
+ */
+plcrash_signal_gate_result_t plcrash_signal_gate_enter (plcrash_signal_gate_t *gate, thread_t thread) {
+    if (OSAtomicCompareAndSwap32Barrier(MACH_PORT_NULL, (int32_t) thread, &gate->owner))
+        return PLCRASH_SIGNAL_GATE_ACQUIRED;
+
+    if (MACH_PORT_INDEX(gate->owner) == MACH_PORT_INDEX(thread))
+        return PLCRASH_SIGNAL_GATE_RECURSIVE;
+
+    return PLCRASH_SIGNAL_GATE_SECONDARY;
+}
+
+/**
+ * Record a secondary crash. This function is async-safe, and may be called concurrently from multiple threads.
+ *
+ * @param gate The gate.
+ * @param info The secondary crash's signal info.
+ * @param pc The secondary crashed thread's instruction pointer.
+ *
+ * @return Returns true if the crash was recorded, or false if all record slots are in use.
+ */
+bool plcrash_signal_gate_record (plcrash_signal_gate_t *gate, siginfo_t *info, uint64_t pc) {
+    int32_t index = OSAtomicIncrement32Barrier(&gate->record_count) - 1;
+    if (index >= PLCRASH_SIGNAL_GATE_SLOTS)
+        return false;
+
+    plcrash_signal_gate_record_t *record = &gate->records[index];
+    plcrash_async_memcpy(&record->info, info, sizeof(record->info));
+    record->pc = pc;
+
+    /* Publish the record */
+    OSMemoryBarrier();
+    record->complete = 1;
+
+    return true;
+}
+
+/**
+ * Return the number of record slots that have been claimed. Some records may not yet be complete; see
+ * plcrash_signal_gate_get_record().
+ *
+ * @param gate The gate.
+ */
+size_t plcrash_signal_gate_record_count (plcrash_signal_gate_t *gate) {
+    int32_t count = gate->record_count;
+    if (count > PLCRASH_SIGNAL_GATE_SLOTS)
+        return PLCRASH_SIGNAL_GATE_SLOTS;
+
+    return count;
+}
+
+/**
+ * Return the record at @a index, or NULL if the record has not yet been completely written.
+ *
+ * @param gate The gate.
+ * @param index The record index. Must be less than the value returned by plcrash_signal_gate_record_count().
+ */
+plcrash_signal_gate_record_t *plcrash_signal_gate_get_record (plcrash_signal_gate_t *gate, size_t index) {
+    plcrash_signal_gate_record_t *record = &gate->records[index];
+
+    if (!record->complete)
+        return NULL;
+
+    OSMemoryBarrier();
+    return record;
+}
+
+/**
+ * @} plcrash_signal_gate
+ */
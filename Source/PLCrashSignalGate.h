@@ -0,0 +1,96 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <mach/mach.h>
+
+/**
+ * @internal
+ * @ingroup plcrash_signal_gate
+ *
+ * Maximum number of secondary crashes that will be recorded.
+ */
+#define PLCRASH_SIGNAL_GATE_SLOTS 8
+
+/**
+ * @internal
+ * @ingroup plcrash_signal_gate
+ *
+ * Gate arbitration result.
+ */
+typedef enum {
+    /** The calling thread is the first to crash, and is responsible for writing the crash report. */
+    PLCRASH_SIGNAL_GATE_ACQUIRED = 0,
+
+    /** The calling thread already owns the gate; the crash occured while the report was being written. */
+    PLCRASH_SIGNAL_GATE_RECURSIVE,
+
+    /** Another thread owns the gate. */
+    PLCRASH_SIGNAL_GATE_SECONDARY
+} plcrash_signal_gate_result_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_signal_gate
+ *
+ * A compact record of a crash received while another thread held the gate.
+ */
+typedef struct plcrash_signal_gate_record {
+    /** Non-zero once the record has been completely written. */
+    volatile uint32_t complete;
+
+    /** The signal info. */
+    siginfo_t info;
+
+    /** The instruction pointer of the crashed thread. */
+    uint64_t pc;
+} plcrash_signal_gate_record_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_signal_gate
+ *
+ * First-crasher gate. A zero-filled instance is a valid, open gate.
+ */
+typedef struct plcrash_signal_gate {
+    /** The thread holding the gate, or MACH_PORT_NULL. */
+    volatile int32_t owner;
+
+    /** The number of record slots claimed. May exceed PLCRASH_SIGNAL_GATE_SLOTS. */
+    volatile int32_t record_count;
+
+    /** Preallocated secondary crash records. */
+    plcrash_signal_gate_record_t records[PLCRASH_SIGNAL_GATE_SLOTS];
+} plcrash_signal_gate_t;
+
+plcrash_signal_gate_result_t plcrash_signal_gate_enter (plcrash_signal_gate_t *gate, thread_t thread);
+bool plcrash_signal_gate_record (plcrash_signal_gate_t *gate, siginfo_t *info, uint64_t pc);
+size_t plcrash_signal_gate_record_count (plcrash_signal_gate_t *gate);
+plcrash_signal_gate_record_t *plcrash_signal_gate_get_record (plcrash_signal_gate_t *gate, size_t index);
@@ -0,0 +1,149 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+
+#import "PLCrashSignalGate.h"
+
+#import <pthread.h>
+#import <sched.h>
+#import <libkern/OSAtomic.h>
+
+@interface PLCrashSignalGateTests : SenTestCase {
+@private
+    plcrash_signal_gate_t _gate;
+}
+@end
+
+/* Concurrently crashing thread state */
+struct crash_thread_args {
+    plcrash_signal_gate_t *gate;
+    plcrash_signal_gate_result_t result;
+
+    /* If non-NULL, the thread waits until ready_count threads are running before entering the gate */
+    volatile int32_t *ready;
+    int32_t ready_count;
+};
+
+static void *crash_thread (void *arg) {
+    struct crash_thread_args *args = arg;
+
+    if (args->ready != NULL) {
+        OSAtomicIncrement32Barrier(args->ready);
+        while (*args->ready < args->ready_count)
+            sched_yield();
+    }
+
+    args->result = plcrash_signal_gate_enter(args->gate, pthread_mach_thread_np(pthread_self()));
+    if (args->result == PLCRASH_SIGNAL_GATE_SECONDARY) {
+        siginfo_t info;
+
+        memset(&info, 0, sizeof(info));
+        info.si_signo = SIGBUS;
+        plcrash_signal_gate_record(args->gate, &info, (uint64_t) (uintptr_t) &crash_thread);
+    }
+
+    return NULL;
+}
+
+@implementation PLCrashSignalGateTests
+
+- (void) setUp {
+    memset(&_gate, 0, sizeof(_gate));
+}
+
+- (void) testEnter {
+    thread_t self = pthread_mach_thread_np(pthread_self());
+    struct crash_thread_args args;
+    pthread_t thr;
+
+    STAssertEquals(PLCRASH_SIGNAL_GATE_ACQUIRED, plcrash_signal_gate_enter(&_gate, self), @"First crasher did not acquire the gate");
+    STAssertEquals(PLCRASH_SIGNAL_GATE_RECURSIVE, plcrash_signal_gate_enter(&_gate, self), @"Recursive crash was not detected");
+
+    /* A crash on another thread must be reported as secondary */
+    args.gate = &_gate;
+    args.ready = NULL;
+    pthread_create(&thr, NULL, crash_thread, &args);
+    pthread_join(thr, NULL);
+    STAssertEquals(PLCRASH_SIGNAL_GATE_SECONDARY, args.result, @"Crash on another thread was not reported as secondary");
+}
+
+- (void) testConcurrentEnter {
+    const size_t thread_count = 16;
+    struct crash_thread_args args[thread_count];
+    pthread_t threads[thread_count];
+    volatile int32_t ready = 0;
+    size_t acquired = 0;
+
+    /* All threads are running before any enters the gate, ensuring that no thread port name is reused */
+    for (size_t i = 0; i < thread_count; i++) {
+        args[i].gate = &_gate;
+        args[i].ready = &ready;
+        args[i].ready_count = thread_count;
+        pthread_create(&threads[i], NULL, crash_thread, &args[i]);
+    }
+
+    for (size_t i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+        if (args[i].result == PLCRASH_SIGNAL_GATE_ACQUIRED)
+            acquired++;
+    }
+
+    /* Exactly one thread may acquire the gate; all others record a secondary crash, up to the slot limit */
+    STAssertEquals((size_t) 1, acquired, @"Gate was acquired by more than one thread");
+    STAssertEquals((size_t) PLCRASH_SIGNAL_GATE_SLOTS, plcrash_signal_gate_record_count(&_gate), @"Incorrect record count");
+}
+
+- (void) testRecords {
+    siginfo_t info;
+
+    memset(&info, 0, sizeof(info));
+    info.si_signo = SIGSEGV;
+    info.si_addr = (void *) 0x42;
+
+    STAssertEquals((size_t) 0, plcrash_signal_gate_record_count(&_gate), @"Gate should be empty");
+
+    /* Fill all slots */
+    for (uint64_t i = 0; i < PLCRASH_SIGNAL_GATE_SLOTS; i++)
+        STAssertTrue(plcrash_signal_gate_record(&_gate, &info, i), @"Failed to record crash");
+
+    /* Verify that exhaustion is handled */
+    STAssertFalse(plcrash_signal_gate_record(&_gate, &info, 0), @"Recorded crash beyond the slot limit");
+    STAssertEquals((size_t) PLCRASH_SIGNAL_GATE_SLOTS, plcrash_signal_gate_record_count(&_gate), @"Incorrect record count");
+
+    /* Verify the records */
+    for (size_t i = 0; i < plcrash_signal_gate_record_count(&_gate); i++) {
+        plcrash_signal_gate_record_t *record = plcrash_signal_gate_get_record(&_gate, i);
+        STAssertNotNULL(record, @"Record is not complete");
+        STAssertEquals((uint64_t) i, record->pc, @"Incorrect PC");
+        STAssertEquals(SIGSEGV, record->info.si_signo, @"Incorrect signal");
+        STAssertEquals((void *) 0x42, record->info.si_addr, @"Incorrect address");
+    }
+}
+
+@end
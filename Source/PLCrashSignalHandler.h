@@ -27,20 +27,35 @@
  */
 
 #import <Foundation/Foundation.h>
+#import <mach/mach.h>
 
-@interface PLCrashSignalHandler : NSObject {
-@private
-    /** Signal stack */
-    stack_t _sigstk;
-}
+#import "PLCrashSignalGate.h"
+
+@interface PLCrashSignalHandler : NSObject
 
 /**
  * @internal
  * Signal handler callback.
+ *
+ * @param signal The received signal.
+ * @param info The signal info.
+ * @param uap The crashed thread's context.
+ * @param crashed_thread The crashed thread. If a dedicated handler thread is in use, this will not be the
+ * calling thread.
+ * @param context The context value supplied at registration.
  */
-typedef void (*PLCrashSignalHandlerCallback)(int signal, siginfo_t *info, ucontext_t *uap, void *context);
+typedef void (*PLCrashSignalHandlerCallback)(int signal, siginfo_t *info, ucontext_t *uap, thread_t crashed_thread, void *context);
 
 + (PLCrashSignalHandler *) sharedHandler;
 - (BOOL) registerHandlerWithCallback: (PLCrashSignalHandlerCallback) crashCallback context: (void *) context error: (NSError **) outError;
+- (BOOL) registerHandlerWithCallback: (PLCrashSignalHandlerCallback) crashCallback
+                             context: (void *) context
+                       handlerThread: (BOOL) useHandlerThread
+                               error: (NSError **) outError;
+
+- (BOOL) registerCurrentThreadAndReturnError: (NSError **) outError;
 
 @end
+
+bool plcrash_signal_handler_stack_usage (size_t *stack_size, size_t *stack_used);
+plcrash_signal_gate_t *plcrash_signal_handler_gate (void);
@@ -30,9 +30,13 @@
 #import "PLCrashAsync.h"
 #import "PLCrashSignalHandler.h"
 #import "PLCrashFrameWalker.h"
+#import "PLCrashHandlerThread.h"
+#import "PLCrashSignalStackPool.h"
+#import "PLCrashSignalGate.h"
 
 #import <signal.h>
 #import <unistd.h>
+#import <libkern/OSAtomic.h>
 
 /**
  * @internal
@@ -51,6 +55,21 @@ static int fatal_signals[] = {
  * number of signals in the fatal signals list */
 static int n_fatal_signals = (sizeof(fatal_signals) / sizeof(fatal_signals[0]));
 
+/** @internal
+ * Stack size of the dedicated crash handler thread. The handler thread's stack is not shared with the
+ * crashed thread, and may be considerably larger than the alternate signal stack. */
+#define HANDLER_THREAD_STACK_SIZE (1024 * 1024)
+
+/** @internal
+ * Size of each thread's alternate signal stack. Only 64k is reserved, and the crash dump path must be sparing
+ * in its use of stack space. */
+#define SIGNAL_STACK_SIZE (64 * 1024)
+
+/** @internal
+ * Maximum number of threads that may concurrently hold an alternate signal stack. Stack pages are only
+ * committed once used, so the pool's resident cost is proportional to the number of registered threads. */
+#define SIGNAL_STACK_POOL_SLOTS 256
+
 
 /**
  * Signal handler context that must be global for async-safe
@@ -72,19 +91,77 @@ static struct {
     /** @internal
      * Crash signal callback context */
     void *crashCallbackContext;
+
+    /** @internal
+     * If true, crashes are dispatched to handlerThread. */
+    bool handlerThreadEnabled;
+
+    /** @internal
+     * Dedicated crash handler thread. Only initialized if handlerThreadEnabled is true. */
+    plcrash_handler_thread_t handlerThread;
+
+    /** @internal
+     * Per-thread alternate signal stacks. */
+    plcrash_sigstack_pool_t stackPool;
+
+    /** @internal
+     * First-crasher gate, and secondary crash records. */
+    plcrash_signal_gate_t gate;
 } SharedHandlerContext = {
     .handlerRegistered = NO,
     .sharedHandler = nil,
     .crashCallback = NULL,
-    .crashCallbackContext = NULL
+    .crashCallbackContext = NULL,
+    .handlerThreadEnabled = false
 };
 
 
+/**
+ * @internal
+ *
+ * Measure the stack usage of the current crash handler. Must be called from within the crash callback; if the
+ * crash is being handled on the dedicated handler thread, the handler thread's stack is measured, otherwise the
+ * crashed thread's alternate signal stack is measured.
+ *
+ * @param stack_size On success, the total size of the handler's stack.
+ * @param stack_used On success, the maximum number of bytes of the handler's stack that have been used.
+ *
+ * @return Returns true on success, or false if the current stack was not allocated by the signal handler, and its
+ * usage can not be measured.
+ */
+bool plcrash_signal_handler_stack_usage (size_t *stack_size, size_t *stack_used) {
+    void *stack_base;
+
+    if (SharedHandlerContext.handlerThreadEnabled && plcrash_handler_thread_is_current(&SharedHandlerContext.handlerThread)) {
+        plcrash_handler_thread_get_stack(&SharedHandlerContext.handlerThread, &stack_base, stack_size);
+    } else {
+        stack_t ss;
+
+        /* Verify that we're running on our alternate signal stack */
+        if (sigaltstack(NULL, &ss) != 0 || !(ss.ss_flags & SS_ONSTACK))
+            return false;
+
+        if (!plcrash_sigstack_pool_current_stack(&SharedHandlerContext.stackPool, &stack_base, stack_size))
+            return false;
+    }
+
+    *stack_used = plcrash_async_stack_high_water(stack_base, *stack_size);
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Return the secondary crashes recorded while the current crash report was written. Records may be fetched
+ * via plcrash_signal_gate_get_record(); as other threads may still be crashing, some records may be incomplete.
+ */
+plcrash_signal_gate_t *plcrash_signal_handler_gate (void) {
+    return &SharedHandlerContext.gate;
+}
+
 /** @internal
- * Root fatal signal handler */
-static void fatal_signal_handler (int signal, siginfo_t *info, void *uapVoid) {
-    /* Remove all signal handlers -- if the dump code fails, the default terminate
-     * action will occur */
+ * Restore the default action for all fatal signals. */
+static void reset_fatal_signals (void) {
     for (int i = 0; i < n_fatal_signals; i++) {
         struct sigaction sa;
         
@@ -94,12 +171,66 @@ static void fatal_signal_handler (int signal, siginfo_t *info, void *uapVoid) {
         
         sigaction(fatal_signals[i], &sa, NULL);
     }
+}
 
-    /* Call the callback handler */
-    if (SharedHandlerContext.crashCallback != NULL)
-        SharedHandlerContext.crashCallback(signal, info, uapVoid, SharedHandlerContext.crashCallbackContext);
-    
-    /* Re-raise the signal */
+/** @internal
+ * Record a crash received while another thread is writing the crash report, and park the calling thread. The
+ * process will be terminated by the thread writing the report once it has completed. */
+static void secondary_crash_handler (int signal, siginfo_t *info, ucontext_t *uap) {
+    plframe_cursor_t cursor;
+    plframe_greg_t pc = 0;
+
+    if (plframe_cursor_init(&cursor, uap) == PLFRAME_ESUCCESS)
+        plframe_get_reg(&cursor, PLFRAME_REG_IP, &pc);
+
+    plcrash_signal_gate_record(&SharedHandlerContext.gate, info, pc);
+
+    for (;;)
+        pause();
+}
+
+/** @internal
+ * Root fatal signal handler */
+static void fatal_signal_handler (int signal, siginfo_t *info, void *uapVoid) {
+    thread_t crashed_thread = mach_thread_self();
+
+    /* Only the first crashed thread may write a report. The signal handlers remain registered until the report
+     * has been written, so that crashes on other threads are recorded rather than terminating the process while
+     * the report is incomplete. */
+    switch (plcrash_signal_gate_enter(&SharedHandlerContext.gate, crashed_thread)) {
+        case PLCRASH_SIGNAL_GATE_ACQUIRED:
+            break;
+
+        case PLCRASH_SIGNAL_GATE_SECONDARY:
+            /* If the handler thread has crashed, the report can never be completed */
+            if (!SharedHandlerContext.handlerThreadEnabled || !plcrash_handler_thread_is_current(&SharedHandlerContext.handlerThread)) {
+                secondary_crash_handler(signal, info, uapVoid);
+                return;
+            }
+
+            /* Fallthrough */
+
+        case PLCRASH_SIGNAL_GATE_RECURSIVE:
+            /* The crash handler itself has crashed; let the default terminate action occur */
+            reset_fatal_signals();
+            raise(signal);
+            return;
+    }
+
+    /* Call the callback handler, preferring the dedicated handler thread. If the crash can not be dispatched
+     * (eg, the handler thread itself has crashed), the callback is executed directly. */
+    if (SharedHandlerContext.crashCallback != NULL) {
+        bool dispatched = false;
+
+        if (SharedHandlerContext.handlerThreadEnabled)
+            dispatched = plcrash_handler_thread_dispatch(&SharedHandlerContext.handlerThread, signal, info, uapVoid, crashed_thread);
+
+        if (!dispatched)
+            SharedHandlerContext.crashCallback(signal, info, uapVoid, crashed_thread, SharedHandlerContext.crashCallbackContext);
+    }
+
+    /* Remove all signal handlers, and re-raise the signal to trigger the default terminate action */
+    reset_fatal_signals();
     raise(signal);
 }
 
@@ -147,14 +278,8 @@ static void fatal_signal_handler (int signal, siginfo_t *info, void *uapVoid) {
     if ((self = [super init]) == nil)
         return nil;
     
-    /* Set up an alternate signal stack for crash dumps. Only 64k is reserved, and the
-     * crash dump path must be sparing in its use of stack space. */
-    _sigstk.ss_size = MAX(MINSIGSTKSZ, 64 * 1024);
-    _sigstk.ss_sp = malloc(_sigstk.ss_size);
-    _sigstk.ss_flags = 0;
-
-    /* (Unlikely) malloc failure */
-    if (_sigstk.ss_sp == NULL) {
+    /* Set up the pool of per-thread alternate signal stacks for crash dumps. */
+    if (plcrash_sigstack_pool_init(&SharedHandlerContext.stackPool, SIGNAL_STACK_SIZE, SIGNAL_STACK_POOL_SLOTS) != PLCRASH_ESUCCESS) {
         [self release];
         return nil;
     }
@@ -208,6 +333,31 @@ static void fatal_signal_handler (int signal, siginfo_t *info, void *uapVoid) {
  * NULL for this parameter, and no error information will be provided. 
  */
 - (BOOL) registerHandlerWithCallback: (PLCrashSignalHandlerCallback) crashCallback context: (void *) context error: (NSError **) outError {
+    return [self registerHandlerWithCallback: crashCallback context: context handlerThread: NO error: outError];
+}
+
+/**
+ * Register the process signal handlers with the provided callback.
+ * Should not be called more than once.
+ *
+ * @note If this method returns NO, some signal handlers may have been registered
+ * successfully.
+ *
+ * @param crashCallback Callback called upon receipt of a signal.
+ * @param context Context to be passed to the callback. May be NULL.
+ * @param useHandlerThread If YES, a dedicated handler thread with a large, preallocated stack is spawned,
+ * and the callback will execute on that thread while the crashed thread waits. Otherwise, the callback will
+ * execute on the crashed thread, using an alternate, limited stack.
+ * @param outError A pointer to an NSError object variable. If an error occurs, this
+ * pointer will contain an error object indicating why the signal handlers could not be
+ * registered. If no error occurs, this parameter will be left unmodified. You may specify
+ * NULL for this parameter, and no error information will be provided. 
+ */
+- (BOOL) registerHandlerWithCallback: (PLCrashSignalHandlerCallback) crashCallback
+                             context: (void *) context
+                       handlerThread: (BOOL) useHandlerThread
+                               error: (NSError **) outError
+{
     /* Prevent duplicate registrations */
     if (SharedHandlerContext.handlerRegistered)
         [NSException raise: PLCrashReporterException format: @"Signal handler has already been registered"];
@@ -217,12 +367,28 @@ static void fatal_signal_handler (int signal, siginfo_t *info, void *uapVoid) {
     SharedHandlerContext.crashCallback = crashCallback;
     SharedHandlerContext.crashCallbackContext = context;
 
-    /* Register our signal stack */
-    if (sigaltstack(&_sigstk, 0) < 0) {
-        [self populateError: outError errnoVal: errno description: @"Could not initialize alternative signal stack"];
-        return NO;
+    /* Spawn the handler thread, if requested */
+    if (useHandlerThread) {
+        plcrash_error_t err;
+
+        err = plcrash_handler_thread_init(&SharedHandlerContext.handlerThread, HANDLER_THREAD_STACK_SIZE, crashCallback, context);
+        if (err != PLCRASH_ESUCCESS) {
+            [self populateError: outError
+                      errorCode: PLCrashReporterErrorOperatingSystem
+                    description: [NSString stringWithFormat: @"Could not create crash handler thread: %s", plcrash_strerror(err)]
+                          cause: nil];
+            return NO;
+        }
+
+        /* Ensure the handler thread state is visible before the signal handlers are registered */
+        OSMemoryBarrier();
+        SharedHandlerContext.handlerThreadEnabled = true;
     }
 
+    /* Register a signal stack for the current thread */
+    if (![self registerCurrentThreadAndReturnError: outError])
+        return NO;
+
     /* Register handler for signals */
     for (int i = 0; i < n_fatal_signals; i++) {
         if (![self registerHandlerForSignal: fatal_signals[i] error: outError])
@@ -232,6 +398,32 @@ static void fatal_signal_handler (int signal, siginfo_t *info, void *uapVoid) {
     return YES;
 }
 
+/**
+ * Install an alternate signal stack on the current thread, allowing crashes caused by stack exhaustion on
+ * this thread to be handled. The stack is allocated from a fixed, preallocated pool, and is returned to the
+ * pool when the thread exits.
+ *
+ * If the current thread has already been registered, or has an alternate signal stack installed by other
+ * code, no changes are made and YES is returned.
+ *
+ * @param outError A pointer to an NSError object variable. If an error occurs, this
+ * pointer will contain an error object indicating why the signal stack could not be
+ * installed. If no error occurs, this parameter will be left unmodified. You may specify
+ * NULL for this parameter, and no error information will be provided. 
+ */
+- (BOOL) registerCurrentThreadAndReturnError: (NSError **) outError {
+    plcrash_error_t err = plcrash_sigstack_pool_register_current_thread(&SharedHandlerContext.stackPool);
+    if (err != PLCRASH_ESUCCESS) {
+        [self populateError: outError
+                  errorCode: PLCrashReporterErrorOperatingSystem
+                description: [NSString stringWithFormat: @"Could not initialize alternative signal stack: %s", plcrash_strerror(err)]
+                      cause: nil];
+        return NO;
+    }
+
+    return YES;
+}
+
 @end
 
 
@@ -32,7 +32,7 @@
 
 @interface PLCrashSignalHandlerTests : SenTestCase @end
 
-static void crash_callback (int signal, siginfo_t *siginfo, ucontext_t *uap, void *context) {
+static void crash_callback (int signal, siginfo_t *siginfo, ucontext_t *uap, thread_t crashed_thread, void *context) {
     // Do nothing
 }
 
@@ -0,0 +1,294 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PLCrashSignalStackPool.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <libkern/OSAtomic.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_sigstack_pool Alternate Signal Stack Pool
+ * @ingroup plcrash_internal
+ *
+ * Manages a fixed pool of per-thread alternate signal stacks.
+ *
+ * sigaltstack(2) configuration is per-thread; a thread without an alternate signal stack can not handle a crash
+ * triggered by stack exhaustion. All stacks are carved out of a single mapping, with a guard page below each stack;
+ * stack pages are only committed once touched. Slots are allocated lock-free from an atomic bitmap, and are
+ * returned to the pool by a thread-specific data destructor when the owning thread exits. No allocation is
+ * performed when registering a thread.
+ *
+ * @{
+ */
+
+/**
+ * @internal
+ * Return the stack base address for @a index.
+ */
+static void *slot_stack (plcrash_sigstack_pool_t *pool, uint32_t index) {
+    return (uint8_t *) pool->arena + (index * pool->slot_size) + (pool->slot_size - pool->stack_size);
+}
+
+/**
+ * @internal
+ * Return @a slot to its pool.
+ */
+static void slot_release (plcrash_sigstack_slot_t *slot) {
+    OSAtomicTestAndClearBarrier(slot->index, (volatile void *) slot->pool->bitmap);
+}
+
+/**
+ * @internal
+ * Thread exit destructor. Disables the thread's alternate signal stack before returning its slot to the pool.
+ */
+static void slot_destructor (void *value) {
+    plcrash_sigstack_slot_t *slot = value;
+    plcrash_sigstack_pool_t *pool = slot->pool;
+    stack_t ss;
+
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_flags = SS_DISABLE;
+    if (sigaltstack(&ss, NULL) != 0) {
+        /* Either the stack is in use, or the thread has replaced it; in either case, the slot can not be reused. */
+        PLCF_DEBUG("Could not disable alternate signal stack, leaking slot %u: %s", slot->index, strerror(errno));
+        return;
+    }
+
+    /* Replace the stack's pages with fresh zero-filled pages. This returns any committed pages to the system,
+     * and ensures that the stack high-water mark may be measured by the slot's next owner. */
+    if (mmap(slot_stack(pool, slot->index), pool->stack_size, PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE|MAP_FIXED, -1, 0) == MAP_FAILED) {
+        PLCF_DEBUG("Could not reset alternate signal stack, leaking slot %u: %s", slot->index, strerror(errno));
+        return;
+    }
+
+    slot_release(slot);
+}
+
+/**
+ * Initialize a new alternate signal stack pool.
+ *
+ * @param pool The pool to be initialized.
+ * @param stack_size The usable size of each stack. Will be rounded up to the page size, and to no less than
+ * MINSIGSTKSZ.
+ * @param slot_count The maximum number of threads that may be registered concurrently.
+ *
+ * @warning This method is not async safe.
+ */
+plcrash_error_t plcrash_sigstack_pool_init (plcrash_sigstack_pool_t *pool, size_t stack_size, uint32_t slot_count) {
+    size_t page_size = getpagesize();
+
+    memset(pool, 0, sizeof(*pool));
+
+    if (slot_count == 0)
+        return PLCRASH_EINVAL;
+
+    if (stack_size < MINSIGSTKSZ)
+        stack_size = MINSIGSTKSZ;
+
+    pool->stack_size = (stack_size + page_size - 1) & ~(page_size - 1);
+    pool->slot_size = pool->stack_size + page_size;
+    pool->slot_count = slot_count;
+    pool->arena_size = pool->slot_size * slot_count;
+
+    /* Allocate the bookkeeping */
+    pool->bitmap = calloc((slot_count + 7) / 8, 1);
+    pool->slots = calloc(slot_count, sizeof(plcrash_sigstack_slot_t));
+    if (pool->bitmap == NULL || pool->slots == NULL) {
+        plcrash_sigstack_pool_free(pool);
+        return PLCRASH_ENOMEM;
+    }
+
+    for (uint32_t i = 0; i < slot_count; i++) {
+        pool->slots[i].pool = pool;
+        pool->slots[i].index = i;
+    }
+
+    /* Map the arena and install the guard pages */
+    pool->arena = mmap(NULL, pool->arena_size, PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE, -1, 0);
+    if (pool->arena == MAP_FAILED) {
+        PLCF_DEBUG("Could not map alternate signal stack arena: %s", strerror(errno));
+        pool->arena = NULL;
+        plcrash_sigstack_pool_free(pool);
+        return PLCRASH_ENOMEM;
+    }
+
+    for (uint32_t i = 0; i < slot_count; i++) {
+        if (mprotect((uint8_t *) pool->arena + (i * pool->slot_size), page_size, PROT_NONE) != 0) {
+            PLCF_DEBUG("Could not protect alternate signal stack guard page: %s", strerror(errno));
+            plcrash_sigstack_pool_free(pool);
+            return PLCRASH_EINTERNAL;
+        }
+    }
+
+    if (pthread_key_create(&pool->key, slot_destructor) != 0) {
+        plcrash_sigstack_pool_free(pool);
+        return PLCRASH_EINTERNAL;
+    }
+    pool->key_created = true;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Install an alternate signal stack from @a pool on the current thread. The stack will be returned to the pool
+ * when the thread exits.
+ *
+ * If the current thread has already been registered, or already has an alternate signal stack configured, no
+ * changes are made and PLCRASH_ESUCCESS is returned.
+ *
+ * @param pool The pool from which the stack will be allocated.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_ENOMEM if no free slots are available, or
+ * PLCRASH_EINTERNAL if the stack could not be installed.
+ */
+plcrash_error_t plcrash_sigstack_pool_register_current_thread (plcrash_sigstack_pool_t *pool) {
+    stack_t ss;
+
+    /* Already registered? */
+    if (pthread_getspecific(pool->key) != NULL)
+        return PLCRASH_ESUCCESS;
+
+    /* Leave any existing alternate stack in place */
+    if (sigaltstack(NULL, &ss) == 0 && !(ss.ss_flags & SS_DISABLE))
+        return PLCRASH_ESUCCESS;
+
+    /* Claim a free slot */
+    for (uint32_t i = 0; i < pool->slot_count; i++) {
+        if (OSAtomicTestAndSetBarrier(i, (volatile void *) pool->bitmap))
+            continue;
+
+        plcrash_sigstack_slot_t *slot = &pool->slots[i];
+
+        ss.ss_sp = slot_stack(pool, i);
+        ss.ss_size = pool->stack_size;
+        ss.ss_flags = 0;
+        if (sigaltstack(&ss, NULL) != 0) {
+            PLCF_DEBUG("Could not install alternate signal stack: %s", strerror(errno));
+            slot_release(slot);
+            return PLCRASH_EINTERNAL;
+        }
+
+        if (pthread_setspecific(pool->key, slot) != 0) {
+            ss.ss_flags = SS_DISABLE;
+            sigaltstack(&ss, NULL);
+            slot_release(slot);
+            return PLCRASH_EINTERNAL;
+        }
+
+        return PLCRASH_ESUCCESS;
+    }
+
+    return PLCRASH_ENOMEM;
+}
+
+/**
+ * Disable the current thread's pool-allocated alternate signal stack, and return it to the pool. If the
+ * thread is not registered with @a pool, no changes are made.
+ *
+ * @param pool The pool with which the current thread was registered.
+ */
+void plcrash_sigstack_pool_unregister_current_thread (plcrash_sigstack_pool_t *pool) {
+    plcrash_sigstack_slot_t *slot = pthread_getspecific(pool->key);
+    if (slot == NULL)
+        return;
+
+    pthread_setspecific(pool->key, NULL);
+    slot_destructor(slot);
+}
+
+/**
+ * Fetch the bounds of the current thread's pool-allocated alternate signal stack. Pool stacks are zero-filled
+ * prior to use, and their high-water mark may be measured with plcrash_async_stack_high_water().
+ *
+ * @param pool The pool with which the current thread was registered.
+ * @param stack_base On success, will be set to the stack's lowest address.
+ * @param stack_size On success, will be set to the stack's size.
+ *
+ * @return Returns true if the current thread holds a stack from @a pool, false otherwise.
+ *
+ * @note This function relies on pthread_getspecific(), which is not declared async-safe by POSIX, but does
+ * not lock or allocate on Mac OS X and iOS.
+ */
+bool plcrash_sigstack_pool_current_stack (plcrash_sigstack_pool_t *pool, void **stack_base, size_t *stack_size) {
+    if (!pool->key_created)
+        return false;
+
+    plcrash_sigstack_slot_t *slot = pthread_getspecific(pool->key);
+    if (slot == NULL)
+        return false;
+
+    *stack_base = slot_stack(pool, slot->index);
+    *stack_size = pool->stack_size;
+    return true;
+}
+
+/**
+ * Return the number of slots currently allocated from @a pool.
+ */
+uint32_t plcrash_sigstack_pool_count (plcrash_sigstack_pool_t *pool) {
+    uint32_t count = 0;
+
+    OSMemoryBarrier();
+    for (uint32_t i = 0; i < pool->slot_count; i++) {
+        if (pool->bitmap[i / 8] & (0x80 >> (i % 8)))
+            count++;
+    }
+
+    return count;
+}
+
+/**
+ * Free all pool resources.
+ *
+ * @warning This method is not async safe, and must not be called while any threads remain registered.
+ */
+void plcrash_sigstack_pool_free (plcrash_sigstack_pool_t *pool) {
+    if (pool->key_created)
+        pthread_key_delete(pool->key);
+
+    if (pool->arena != NULL)
+        munmap(pool->arena, pool->arena_size);
+
+    if (pool->bitmap != NULL)
+        free((void *) pool->bitmap);
+
+    if (pool->slots != NULL)
+        free(pool->slots);
+
+    memset(pool, 0, sizeof(*pool));
+}
+
+/**
+ * @} plcrash_sigstack_pool
+ */
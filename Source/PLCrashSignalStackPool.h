@@ -0,0 +1,89 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "PLCrashAsync.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_sigstack_pool
+ *
+ * Per-thread slot record. Used as the thread-specific value for registered threads.
+ */
+typedef struct plcrash_sigstack_slot {
+    /** The owning pool. */
+    struct plcrash_sigstack_pool *pool;
+
+    /** The slot's index within the pool. */
+    uint32_t index;
+} plcrash_sigstack_slot_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_sigstack_pool
+ *
+ * A fixed-size pool of guard-paged alternate signal stacks, carved from a single mapping.
+ */
+typedef struct plcrash_sigstack_pool {
+    /** The stack arena. Each slot consists of a guard page followed by the stack. */
+    void *arena;
+
+    /** The total size of the arena, in bytes. */
+    size_t arena_size;
+
+    /** The usable size of each stack, in bytes. */
+    size_t stack_size;
+
+    /** The size of each slot (guard page + stack), in bytes. */
+    size_t slot_size;
+
+    /** The number of slots in the pool. */
+    uint32_t slot_count;
+
+    /** Allocation bitmap; one bit per slot, updated atomically. */
+    volatile uint8_t *bitmap;
+
+    /** Per-slot records. */
+    plcrash_sigstack_slot_t *slots;
+
+    /** Thread-specific key used to release a thread's slot on thread exit. */
+    pthread_key_t key;
+
+    /** True if key has been created. */
+    bool key_created;
+} plcrash_sigstack_pool_t;
+
+plcrash_error_t plcrash_sigstack_pool_init (plcrash_sigstack_pool_t *pool, size_t stack_size, uint32_t slot_count);
+plcrash_error_t plcrash_sigstack_pool_register_current_thread (plcrash_sigstack_pool_t *pool);
+void plcrash_sigstack_pool_unregister_current_thread (plcrash_sigstack_pool_t *pool);
+bool plcrash_sigstack_pool_current_stack (plcrash_sigstack_pool_t *pool, void **stack_base, size_t *stack_size);
+uint32_t plcrash_sigstack_pool_count (plcrash_sigstack_pool_t *pool);
+void plcrash_sigstack_pool_free (plcrash_sigstack_pool_t *pool);
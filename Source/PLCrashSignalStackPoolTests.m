@@ -0,0 +1,134 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+
+#import "PLCrashSignalStackPool.h"
+
+#import <signal.h>
+#import <libkern/OSAtomic.h>
+
+@interface PLCrashSignalStackPoolTests : SenTestCase {
+@private
+    plcrash_sigstack_pool_t _pool;
+}
+@end
+
+/* Result of registering a thread */
+struct register_result {
+    plcrash_sigstack_pool_t *pool;
+    plcrash_error_t err;
+    stack_t ss;
+};
+
+static void *register_thread (void *arg) {
+    struct register_result *result = arg;
+
+    result->err = plcrash_sigstack_pool_register_current_thread(result->pool);
+    sigaltstack(NULL, &result->ss);
+
+    return NULL;
+}
+
+static void *unregister_thread (void *arg) {
+    struct register_result *result = arg;
+
+    result->err = plcrash_sigstack_pool_register_current_thread(result->pool);
+    if (result->err != PLCRASH_ESUCCESS)
+        return NULL;
+
+    /* A duplicate registration must not consume a slot */
+    if (plcrash_sigstack_pool_register_current_thread(result->pool) != PLCRASH_ESUCCESS || plcrash_sigstack_pool_count(result->pool) != 1) {
+        result->err = PLCRASH_EINTERNAL;
+        return NULL;
+    }
+
+    plcrash_sigstack_pool_unregister_current_thread(result->pool);
+    sigaltstack(NULL, &result->ss);
+
+    return NULL;
+}
+
+@implementation PLCrashSignalStackPoolTests
+
+- (void) setUp {
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_sigstack_pool_init(&_pool, 16 * 1024, 2), @"Failed to initialize pool");
+}
+
+- (void) tearDown {
+    plcrash_sigstack_pool_free(&_pool);
+}
+
+/* Verify that a registered thread receives a stack from the arena, and that it is returned on thread exit */
+- (void) testRegisterThread {
+    struct register_result result = { .pool = &_pool };
+    pthread_t thr;
+
+    pthread_create(&thr, NULL, register_thread, &result);
+    pthread_join(thr, NULL);
+
+    STAssertEquals(PLCRASH_ESUCCESS, result.err, @"Registration failed");
+    STAssertFalse((result.ss.ss_flags & SS_DISABLE) != 0, @"Alternate signal stack is disabled");
+    STAssertTrue((uint8_t *) result.ss.ss_sp >= (uint8_t *) _pool.arena, @"Stack is outside the arena");
+    STAssertTrue((uint8_t *) result.ss.ss_sp + result.ss.ss_size <= (uint8_t *) _pool.arena + _pool.arena_size, @"Stack is outside the arena");
+    STAssertEquals(_pool.stack_size, (size_t) result.ss.ss_size, @"Incorrect stack size");
+
+    STAssertEquals((uint32_t) 0, plcrash_sigstack_pool_count(&_pool), @"Slot was not released on thread exit");
+}
+
+/* Verify that explicit unregistration disables the stack and releases the slot */
+- (void) testUnregisterThread {
+    struct register_result result = { .pool = &_pool };
+    pthread_t thr;
+
+    pthread_create(&thr, NULL, unregister_thread, &result);
+    pthread_join(thr, NULL);
+
+    STAssertEquals(PLCRASH_ESUCCESS, result.err, @"Registration failed");
+    STAssertTrue((result.ss.ss_flags & SS_DISABLE) != 0, @"Alternate signal stack was not disabled");
+    STAssertEquals((uint32_t) 0, plcrash_sigstack_pool_count(&_pool), @"Slot was not released");
+}
+
+/* Verify that registration fails cleanly once all slots are allocated */
+- (void) testExhaustion {
+    struct register_result result = { .pool = &_pool };
+    pthread_t thr;
+
+    /* Mark all slots as allocated */
+    for (uint32_t i = 0; i < _pool.slot_count; i++)
+        OSAtomicTestAndSetBarrier(i, (volatile void *) _pool.bitmap);
+
+    pthread_create(&thr, NULL, register_thread, &result);
+    pthread_join(thr, NULL);
+    STAssertEquals(PLCRASH_ENOMEM, result.err, @"Exhausted pool did not return ENOMEM");
+
+    for (uint32_t i = 0; i < _pool.slot_count; i++)
+        OSAtomicTestAndClearBarrier(i, (volatile void *) _pool.bitmap);
+}
+
+@end
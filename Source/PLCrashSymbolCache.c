@@ -0,0 +1,570 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashSymbolCache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_symbol_cache Symbol Cache
+ * @ingroup plcrash_internal
+ *
+ * An on-disk cache of symbol indexes, keyed by image UUID.
+ *
+ * Indexes are built from Mach-O binaries and dSYM bundles with plcrash_symbol_cache_add(), and are stored in the
+ * cache directory as <uuid>.plsym files. Once built, an index is reused by every report referencing the same image
+ * UUID; plcrash_symbol_cache_lookup() maps each index on first use.
+ *
+ * For images with DWARF line information, a <uuid>.dwarf symbolic link to the added file is also created. The
+ * debug information is not copied, as it may be very large; plcrash_symbol_cache_lookup() maps it on first use,
+ * and decodes line tables on demand (see @ref plcrash_dwarf_lines).
+ *
+ * At most mapped_limit images are mapped at once. When the limit is reached, the least recently used image's index
+ * and line information are unmapped, to be mapped again if the image is later looked up. Memory use is thus
+ * bounded by the limit, rather than by the number of images referenced by the symbolicated reports.
+ *
+ * Lookups may be performed concurrently from multiple threads. Lookups of mapped images hold the cache lock for
+ * reading, and only serialize on the decoding of each image's line tables; mapping and unmapping images requires
+ * the lock for writing. plcrash_symbol_cache_add() may be called concurrently with lookups.
+ *
+ * @{
+ */
+
+/** @internal Path of the DWARF directory within a dSYM bundle. */
+#define DSYM_DWARF_PATH "Contents/Resources/DWARF"
+
+/**
+ * @internal
+ *
+ * Format the cache path of the file with @a extension for @a uuid into @a path.
+ */
+static bool cache_path (const plcrash_symbol_cache_t *cache, const uint8_t *uuid, const char *extension, char *path, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    char uuid_str[PLCRASH_SYMBOL_INDEX_UUID_LEN * 2 + 1];
+
+    for (size_t i = 0; i < PLCRASH_SYMBOL_INDEX_UUID_LEN; i++) {
+        uuid_str[i * 2] = hex[uuid[i] >> 4];
+        uuid_str[i * 2 + 1] = hex[uuid[i] & 0xf];
+    }
+    uuid_str[sizeof(uuid_str) - 1] = '\0';
+
+    int rv = snprintf(path, len, "%s/%s.%s", cache->directory, uuid_str, extension);
+    return rv > 0 && (size_t) rv < len;
+}
+
+/**
+ * @internal
+ *
+ * Find the position of @a uuid within the cache's entries. Returns true if an entry exists; otherwise, position is
+ * set to the insertion point.
+ */
+static bool entry_position (const plcrash_symbol_cache_t *cache, const uint8_t *uuid, size_t *position) {
+    size_t lo = 0;
+    size_t hi = cache->count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = memcmp(cache->entries[mid]->uuid, uuid, PLCRASH_SYMBOL_INDEX_UUID_LEN);
+        if (cmp == 0) {
+            *position = mid;
+            return true;
+        } else if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    *position = lo;
+    return false;
+}
+
+/**
+ * @internal
+ *
+ * Map the cached index of @a entry, if available. If no index is available, the entry is marked as missing. The
+ * cache lock must be held for writing.
+ */
+static void entry_map (plcrash_symbol_cache_t *cache, plcrash_symbol_cache_entry_t *entry) {
+    plcrash_symbol_index_t *index;
+    char path[PATH_MAX];
+
+    entry->index = NULL;
+    entry->missing = true;
+    if (!cache_path(cache, entry->uuid, PLCRASH_SYMBOL_CACHE_EXTENSION, path, sizeof(path)))
+        return;
+
+    if ((index = malloc(sizeof(*index))) == NULL)
+        return;
+
+    if (plcrash_symbol_index_open(index, path) != PLCRASH_ESUCCESS) {
+        free(index);
+        return;
+    }
+
+    /* Guard against a misnamed index */
+    if (memcmp(index->header->uuid, entry->uuid, PLCRASH_SYMBOL_INDEX_UUID_LEN) != 0) {
+        plcrash_symbol_index_close(index);
+        free(index);
+        return;
+    }
+
+    entry->index = index;
+    entry->missing = false;
+    cache->mapped_count++;
+}
+
+/**
+ * @internal
+ *
+ * Unmap the index and line information of @a entry. The cache lock must be held for writing.
+ */
+static void entry_unmap (plcrash_symbol_cache_t *cache, plcrash_symbol_cache_entry_t *entry) {
+    if (entry->index != NULL) {
+        plcrash_symbol_index_close(entry->index);
+        free(entry->index);
+        entry->index = NULL;
+        cache->mapped_count--;
+    }
+
+    if (entry->lines != NULL) {
+        plcrash_dwarf_lines_free(entry->lines);
+        free(entry->lines);
+        entry->lines = NULL;
+    }
+
+    entry->lines_loaded = false;
+}
+
+/**
+ * @internal
+ *
+ * Unmap least recently used images until fewer than mapped_limit images are mapped. The cache lock must be held
+ * for writing.
+ */
+static void evict (plcrash_symbol_cache_t *cache) {
+    while (cache->mapped_count > 0 && cache->mapped_count >= cache->mapped_limit) {
+        plcrash_symbol_cache_entry_t *lru = NULL;
+
+        for (size_t i = 0; i < cache->count; i++) {
+            plcrash_symbol_cache_entry_t *entry = cache->entries[i];
+            if (entry->index != NULL && (lru == NULL || entry->last_used < lru->last_used))
+                lru = entry;
+        }
+
+        entry_unmap(cache, lru);
+    }
+}
+
+/**
+ * @internal
+ *
+ * Return the entry for @a uuid, inserting it and mapping its index as necessary. Returns NULL if the entry could
+ * not be allocated. The cache lock must be held for writing.
+ */
+static plcrash_symbol_cache_entry_t *entry_open (plcrash_symbol_cache_t *cache, const uint8_t *uuid) {
+    plcrash_symbol_cache_entry_t *entry;
+    size_t position;
+
+    if (entry_position(cache, uuid, &position)) {
+        entry = cache->entries[position];
+    } else {
+        /* Record the result, including misses, so that each image is only looked up once */
+        if (cache->count == cache->capacity) {
+            size_t capacity = (cache->capacity > 0) ? cache->capacity * 2 : 16;
+            plcrash_symbol_cache_entry_t **entries = realloc(cache->entries, capacity * sizeof(*entries));
+            if (entries == NULL)
+                return NULL;
+
+            cache->entries = entries;
+            cache->capacity = capacity;
+        }
+
+        if ((entry = calloc(1, sizeof(*entry))) == NULL)
+            return NULL;
+
+        if (pthread_mutex_init(&entry->lines_lock, NULL) != 0) {
+            free(entry);
+            return NULL;
+        }
+
+        memcpy(entry->uuid, uuid, PLCRASH_SYMBOL_INDEX_UUID_LEN);
+        memmove(&cache->entries[position + 1], &cache->entries[position], (cache->count - position) * sizeof(*cache->entries));
+        cache->entries[position] = entry;
+        cache->count++;
+    }
+
+    if (entry->index == NULL && !entry->missing) {
+        evict(cache);
+        entry_map(cache, entry);
+    }
+
+    return entry;
+}
+
+/**
+ * @internal
+ *
+ * Map the line information of @a entry, if available. The entry's lines lock must be held.
+ */
+static void entry_map_lines (const plcrash_symbol_cache_t *cache, plcrash_symbol_cache_entry_t *entry) {
+    plcrash_dwarf_lines_t *lines;
+    char path[PATH_MAX];
+
+    entry->lines_loaded = true;
+    if (!cache_path(cache, entry->uuid, PLCRASH_SYMBOL_CACHE_DWARF_EXTENSION, path, sizeof(path)))
+        return;
+
+    if ((lines = malloc(sizeof(*lines))) == NULL)
+        return;
+
+    if (plcrash_dwarf_lines_open(lines, path, entry->uuid, cache->line_memory_limit) != PLCRASH_ESUCCESS) {
+        free(lines);
+        return;
+    }
+
+    entry->lines = lines;
+}
+
+/**
+ * @internal
+ *
+ * Look up @a address within the mapped image of @a entry. The cache lock must be held for reading or writing.
+ */
+static bool entry_lookup (plcrash_symbol_cache_t *cache, plcrash_symbol_cache_entry_t *entry, uint64_t address, plcrash_symbol_t *symbol) {
+    const char *file;
+    uint32_t line;
+
+    if (entry->index == NULL)
+        return false;
+
+    /* Concurrent lookups may race to record their use; any of the values is sufficiently recent */
+    __sync_lock_test_and_set(&entry->last_used, __sync_add_and_fetch(&cache->use_counter, 1));
+
+    if (!plcrash_symbol_index_lookup(entry->index, address, symbol))
+        return false;
+
+    /* Line tables are decoded on demand, and may only be used by one thread at a time */
+    pthread_mutex_lock(&entry->lines_lock);
+    if (!entry->lines_loaded)
+        entry_map_lines(cache, entry);
+
+    if (entry->lines != NULL && plcrash_dwarf_lines_lookup(entry->lines, address, &file, &line)) {
+        snprintf(symbol->file, sizeof(symbol->file), "%s", file);
+        symbol->line = line;
+    }
+    pthread_mutex_unlock(&entry->lines_lock);
+
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Link the DWARF debug information of the image with @a uuid within the file at @a path into the cache, if the
+ * image has line information and is not already linked.
+ */
+static plcrash_error_t link_lines (plcrash_symbol_cache_t *cache, const char *path, const uint8_t *uuid) {
+    char target[PATH_MAX];
+    char source[PATH_MAX];
+    size_t position;
+
+    if (!cache_path(cache, uuid, PLCRASH_SYMBOL_CACHE_DWARF_EXTENSION, target, sizeof(target)))
+        return PLCRASH_EINVAL;
+
+    /* Replace any dangling link left by a moved or deleted file */
+    if (access(target, R_OK) == 0)
+        return PLCRASH_ESUCCESS;
+    unlink(target);
+
+    if (realpath(path, source) == NULL || symlink(source, target) != 0)
+        return PLCRASH_OUTPUT_ERR;
+
+    /* Retry any earlier failed lookup */
+    pthread_rwlock_wrlock(&cache->lock);
+    if (entry_position(cache, uuid, &position) && cache->entries[position]->lines == NULL)
+        cache->entries[position]->lines_loaded = false;
+    pthread_rwlock_unlock(&cache->lock);
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Initialize a symbol cache, creating @a directory if it does not exist.
+ *
+ * @param cache The cache to initialize.
+ * @param directory Cache directory path.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_OUTPUT_ERR if the directory could not be created, or
+ * PLCRASH_ENOMEM if state could not be allocated.
+ */
+plcrash_error_t plcrash_symbol_cache_init (plcrash_symbol_cache_t *cache, const char *directory) {
+    memset(cache, 0, sizeof(*cache));
+
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST)
+        return PLCRASH_OUTPUT_ERR;
+
+    if ((cache->directory = strdup(directory)) == NULL)
+        return PLCRASH_ENOMEM;
+
+    if (pthread_rwlock_init(&cache->lock, NULL) != 0) {
+        free(cache->directory);
+        cache->directory = NULL;
+        return PLCRASH_ENOMEM;
+    }
+
+    cache->line_memory_limit = PLCRASH_DWARF_LINES_DEFAULT_LIMIT;
+    cache->mapped_limit = PLCRASH_SYMBOL_CACHE_DEFAULT_MAPPED_LIMIT;
+
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * @internal
+ *
+ * Return true if a readable index of the current version exists at @a path. Indexes written by earlier versions
+ * are rebuilt.
+ */
+static bool index_current (const char *path) {
+    plcrash_symbol_index_t index;
+
+    if (plcrash_symbol_index_open(&index, path) != PLCRASH_ESUCCESS)
+        return false;
+
+    plcrash_symbol_index_close(&index);
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Index every image within the Mach-O file at @a path that is not already cached.
+ */
+static plcrash_error_t add_file (plcrash_symbol_cache_t *cache, const char *path, size_t *added) {
+    struct stat sb;
+    plcrash_error_t err = PLCRASH_ESUCCESS;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return PLCRASH_EINVAL;
+
+    if (fstat(fd, &sb) != 0 || sb.st_size == 0 || (uint64_t) sb.st_size > SIZE_MAX) {
+        close(fd);
+        return PLCRASH_EINVAL;
+    }
+
+    size_t len = (size_t) sb.st_size;
+    void *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return PLCRASH_EINVAL;
+
+    size_t slice_count = plcrash_symbol_index_slice_count(data, len);
+    if (slice_count == 0)
+        err = PLCRASH_EINVAL;
+
+    for (size_t slice = 0; slice < slice_count && err == PLCRASH_ESUCCESS; slice++) {
+        uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+        char target[PATH_MAX];
+        char temp[PATH_MAX];
+
+        plcrash_symbol_index_section_t debug_line;
+
+        /* Images without a UUID can not be matched to a report */
+        if (plcrash_symbol_index_slice_uuid(data, len, slice, uuid) != PLCRASH_ESUCCESS)
+            continue;
+
+        if (plcrash_symbol_index_slice_section(data, len, slice, "__DWARF", "__debug_line", &debug_line) == PLCRASH_ESUCCESS &&
+            (err = link_lines(cache, path, uuid)) != PLCRASH_ESUCCESS)
+        {
+            break;
+        }
+
+        if (!cache_path(cache, uuid, PLCRASH_SYMBOL_CACHE_EXTENSION, target, sizeof(target)) || snprintf(temp, sizeof(temp), "%s.XXXXXX", target) >= (int) sizeof(temp)) {
+            err = PLCRASH_EINVAL;
+            break;
+        }
+
+        if (index_current(target))
+            continue;
+
+        /* Write to a temporary file, and then move it into place, so that readers never see a partial index */
+        int out = mkstemp(temp);
+        if (out < 0) {
+            err = PLCRASH_OUTPUT_ERR;
+            break;
+        }
+
+        plcrash_error_t write_err = plcrash_symbol_index_write(data, len, slice, out);
+        if (close(out) != 0 && write_err == PLCRASH_ESUCCESS)
+            write_err = PLCRASH_OUTPUT_ERR;
+
+        if (write_err == PLCRASH_ESUCCESS && chmod(temp, 0644) == 0 && rename(temp, target) == 0) {
+            size_t position;
+
+            /* Retry any earlier failed lookup */
+            pthread_rwlock_wrlock(&cache->lock);
+            if (entry_position(cache, uuid, &position))
+                cache->entries[position]->missing = false;
+            pthread_rwlock_unlock(&cache->lock);
+
+            if (added != NULL)
+                (*added)++;
+        } else {
+            unlink(temp);
+
+            /* Images without a symbol table are skipped */
+            if (write_err != PLCRASH_EINVAL)
+                err = (write_err == PLCRASH_ESUCCESS) ? PLCRASH_OUTPUT_ERR : write_err;
+        }
+    }
+
+    munmap(data, len);
+    return err;
+}
+
+/**
+ * Build and cache symbol indexes for the Mach-O binary or dSYM bundle at @a path. For fat binaries, an index is
+ * built for each architecture. Images with DWARF line information are also linked into the cache. Images that are
+ * already cached are skipped.
+ *
+ * @param cache The symbol cache.
+ * @param path Path to a Mach-O binary, a dSYM bundle, or the DWARF file within a dSYM bundle.
+ * @param added If non-NULL, incremented by the number of indexes built.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if @a path is not a Mach-O binary or dSYM bundle,
+ * PLCRASH_OUTPUT_ERR if an index or link could not be written, or PLCRASH_ENOMEM if state could not be allocated.
+ */
+plcrash_error_t plcrash_symbol_cache_add (plcrash_symbol_cache_t *cache, const char *path, size_t *added) {
+    char dwarf[PATH_MAX];
+    struct stat sb;
+
+    if (stat(path, &sb) != 0)
+        return PLCRASH_EINVAL;
+
+    if (!S_ISDIR(sb.st_mode))
+        return add_file(cache, path, added);
+
+    /* A dSYM bundle; index each DWARF file */
+    if (snprintf(dwarf, sizeof(dwarf), "%s/" DSYM_DWARF_PATH, path) >= (int) sizeof(dwarf))
+        return PLCRASH_EINVAL;
+
+    DIR *dir = opendir(dwarf);
+    if (dir == NULL)
+        return PLCRASH_EINVAL;
+
+    plcrash_error_t err = PLCRASH_EINVAL;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        char file[PATH_MAX];
+
+        if (ent->d_name[0] == '.')
+            continue;
+
+        if (snprintf(file, sizeof(file), "%s/%s", dwarf, ent->d_name) >= (int) sizeof(file))
+            continue;
+
+        plcrash_error_t file_err = add_file(cache, file, added);
+        if (file_err == PLCRASH_ESUCCESS && err == PLCRASH_EINVAL) {
+            err = PLCRASH_ESUCCESS;
+        } else if (file_err != PLCRASH_ESUCCESS && file_err != PLCRASH_EINVAL) {
+            err = file_err;
+            break;
+        }
+    }
+
+    closedir(dir);
+    return err;
+}
+
+/**
+ * Look up the symbol containing @a address within the image with @a uuid, and, if the image's DWARF line information
+ * is cached, the source file and line of @a address. The image's index is mapped on first use, unmapping the least
+ * recently used image if mapped_limit images are already mapped.
+ *
+ * This function may be called concurrently from multiple threads.
+ *
+ * @param cache The symbol cache.
+ * @param uuid The PLCRASH_SYMBOL_INDEX_UUID_LEN byte image UUID.
+ * @param address The address to look up, relative to the image's load address.
+ * @param symbol On success, the symbol. If no line information is available, the symbol's file is an empty string.
+ *
+ * @return Returns true if a symbol was found.
+ */
+bool plcrash_symbol_cache_lookup (plcrash_symbol_cache_t *cache, const uint8_t *uuid, uint64_t address, plcrash_symbol_t *symbol) {
+    plcrash_symbol_cache_entry_t *entry = NULL;
+    size_t position;
+
+    /* Mapped images, and images without an index, only require the read lock */
+    pthread_rwlock_rdlock(&cache->lock);
+    if (entry_position(cache, uuid, &position) && (cache->entries[position]->index != NULL || cache->entries[position]->missing))
+        entry = cache->entries[position];
+
+    if (entry == NULL) {
+        pthread_rwlock_unlock(&cache->lock);
+        pthread_rwlock_wrlock(&cache->lock);
+        entry = entry_open(cache, uuid);
+    }
+
+    bool found = (entry != NULL && entry_lookup(cache, entry, address, symbol));
+    pthread_rwlock_unlock(&cache->lock);
+
+    return found;
+}
+
+/**
+ * Unmap all indexes and line information, and free all resources associated with @a cache.
+ */
+void plcrash_symbol_cache_free (plcrash_symbol_cache_t *cache) {
+    for (size_t i = 0; i < cache->count; i++) {
+        entry_unmap(cache, cache->entries[i]);
+        pthread_mutex_destroy(&cache->entries[i]->lines_lock);
+        free(cache->entries[i]);
+    }
+
+    if (cache->directory != NULL)
+        pthread_rwlock_destroy(&cache->lock);
+
+    free(cache->entries);
+    free(cache->directory);
+    memset(cache, 0, sizeof(*cache));
+}
+
+/**
+ * @} plcrash_symbol_cache
+ */
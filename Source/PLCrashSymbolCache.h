@@ -0,0 +1,129 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#import "PLCrashAsync.h"
+#import "PLCrashSymbolIndex.h"
+#import "PLCrashDWARFLines.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_cache
+ *
+ * File name extension of cached symbol indexes.
+ */
+#define PLCRASH_SYMBOL_CACHE_EXTENSION "plsym"
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_cache
+ *
+ * File name extension of links to cached images' DWARF debug information.
+ */
+#define PLCRASH_SYMBOL_CACHE_DWARF_EXTENSION "dwarf"
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_cache
+ *
+ * Default limit on the number of images whose indexes and line information are mapped at once.
+ */
+#define PLCRASH_SYMBOL_CACHE_DEFAULT_MAPPED_LIMIT 64
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_cache
+ *
+ * A cached symbol index.
+ */
+typedef struct plcrash_symbol_cache_entry {
+    /** Image UUID */
+    uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+
+    /** The mapped index, or NULL if the index is not mapped */
+    plcrash_symbol_index_t *index;
+
+    /** If true, no index is available for the image */
+    bool missing;
+
+    /** Value of the cache's use counter at the most recent lookup */
+    uint64_t last_used;
+
+    /** Lock guarding the line information, which is decoded on demand */
+    pthread_mutex_t lines_lock;
+
+    /** If true, loading of the image's line information has been attempted */
+    bool lines_loaded;
+
+    /** The image's line information, or NULL if none is available */
+    plcrash_dwarf_lines_t *lines;
+} plcrash_symbol_cache_entry_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_cache
+ *
+ * A directory of symbol indexes, keyed by image UUID.
+ */
+typedef struct plcrash_symbol_cache {
+    /** Cache directory path */
+    char *directory;
+
+    /** Images that have been looked up, sorted by UUID */
+    plcrash_symbol_cache_entry_t **entries;
+
+    /** Number of entries */
+    size_t count;
+
+    /** Allocated size of entries */
+    size_t capacity;
+
+    /** Limit on the memory used by each image's decoded line tables, in bytes */
+    size_t line_memory_limit;
+
+    /** Limit on the number of images that are mapped at once */
+    size_t mapped_limit;
+
+    /** Number of images that are mapped */
+    size_t mapped_count;
+
+    /** Use counter, incremented by each lookup */
+    uint64_t use_counter;
+
+    /** Lock guarding the entries; held for reading by lookups of mapped images */
+    pthread_rwlock_t lock;
+} plcrash_symbol_cache_t;
+
+plcrash_error_t plcrash_symbol_cache_init (plcrash_symbol_cache_t *cache, const char *directory);
+plcrash_error_t plcrash_symbol_cache_add (plcrash_symbol_cache_t *cache, const char *path, size_t *added);
+bool plcrash_symbol_cache_lookup (plcrash_symbol_cache_t *cache, const uint8_t *uuid, uint64_t address, plcrash_symbol_t *symbol);
+void plcrash_symbol_cache_free (plcrash_symbol_cache_t *cache);
@@ -0,0 +1,1033 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashSymbolIndex.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @internal
+ * @defgroup plcrash_symbol_index Symbol Index
+ * @ingroup plcrash_internal
+ *
+ * Compact, memory mappable symbol tables for offline symbolication.
+ *
+ * A symbol index is built once from the symbol table of a Mach-O binary or dSYM, and is then written to disk in a
+ * compressed form: symbols are sorted by address and grouped into fixed-size blocks, with each symbol's address
+ * stored as the distance from its predecessor, and each name stored as the suffix that differs from its
+ * predecessor's name. Adjacent symbols commonly share long name prefixes (Objective-C class names, C++ namespaces,
+ * and Swift module names), which are stored only once per block.
+ *
+ * Opening an index maps the file without reading or validating its contents. A lookup binary searches the block
+ * table, and decodes a single block, so that the cost of reusing an index is limited to the pages touched by the
+ * lookup. Lookups only read the mapping, and may be performed concurrently.
+ *
+ * Mach-O files are parsed without the system headers, allowing indexes to be built on any host. Thin and fat
+ * (universal) files of either byte order are supported.
+ *
+ * @{
+ */
+
+/* Mach-O constants. See <mach-o/loader.h>, <mach-o/nlist.h>, and <mach-o/fat.h>. */
+#define MACHO_MH_MAGIC          0xfeedface
+#define MACHO_MH_CIGAM          0xcefaedfe
+#define MACHO_MH_MAGIC_64       0xfeedfacf
+#define MACHO_MH_CIGAM_64       0xcffaedfe
+#define MACHO_FAT_MAGIC         0xcafebabe
+#define MACHO_FAT_MAGIC_64      0xcafebabf
+
+#define MACHO_LC_SEGMENT        0x1
+#define MACHO_LC_SYMTAB         0x2
+#define MACHO_LC_SEGMENT_64     0x19
+#define MACHO_LC_UUID           0x1b
+
+#define MACHO_N_STAB            0xe0
+#define MACHO_N_TYPE            0x0e
+#define MACHO_N_EXT             0x01
+#define MACHO_N_SECT            0x0e
+
+#define MACHO_S_ATTR_PURE_INSTRUCTIONS  0x80000000
+#define MACHO_S_ATTR_SOME_INSTRUCTIONS  0x00000400
+
+/** @internal Maximum number of sections addressable by an nlist entry. */
+#define MACHO_MAX_SECT 255
+
+/** @internal Maximum number of fat architectures accepted. */
+#define MACHO_MAX_FAT_ARCH 64
+
+/**
+ * @internal
+ *
+ * A Mach-O section.
+ */
+typedef struct macho_section {
+    /** Section start address, relative to the __TEXT segment */
+    uint64_t start;
+
+    /** Section end address, relative to the __TEXT segment */
+    uint64_t end;
+
+    /** If true, the section contains instructions */
+    bool code;
+} macho_section_t;
+
+/**
+ * @internal
+ *
+ * A parsed Mach-O image.
+ */
+typedef struct macho_image {
+    /** Image data */
+    const uint8_t *data;
+
+    /** Length of data */
+    size_t len;
+
+    /** If true, the image byte order is the opposite of the host's */
+    bool swap;
+
+    /** If true, the image is a 64-bit image */
+    bool m64;
+
+    /** Number of load commands */
+    uint32_t ncmds;
+
+    /** Offset of the first load command */
+    uint64_t cmds_offset;
+
+    /** Offset of the end of the load commands */
+    uint64_t cmds_end;
+
+    /** If true, uuid is valid */
+    bool has_uuid;
+
+    /** Image UUID */
+    uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+
+    /** If true, the symtab_ fields are valid */
+    bool has_symtab;
+
+    /** Symbol table file offset */
+    uint32_t symtab_offset;
+
+    /** Number of symbol table entries */
+    uint32_t symtab_count;
+
+    /** String table file offset */
+    uint32_t strtab_offset;
+
+    /** String table size */
+    uint32_t strtab_size;
+
+    /** __TEXT segment address */
+    uint64_t text_vmaddr;
+
+    /** Sections, in load command order */
+    macho_section_t sections[MACHO_MAX_SECT];
+
+    /** Number of entries in sections */
+    size_t section_count;
+} macho_image_t;
+
+/**
+ * @internal
+ *
+ * A symbol table entry collected while building an index.
+ */
+typedef struct build_symbol {
+    /** Address, relative to the __TEXT segment */
+    uint64_t address;
+
+    /** End of the containing section, relative to the __TEXT segment */
+    uint64_t section_end;
+
+    /** Symbol name */
+    const char *name;
+
+    /** Length of name */
+    size_t name_len;
+
+    /** True if the symbol is external */
+    bool external;
+
+    /** Symbol table position, used to order otherwise equal symbols */
+    uint32_t position;
+} build_symbol_t;
+
+/**
+ * @internal
+ *
+ * Read a 32-bit value at @a offset, which must lie within @a len bytes of @a data.
+ */
+static bool read_u32 (const uint8_t *data, size_t len, uint64_t offset, bool swap, uint32_t *value) {
+    uint32_t v;
+
+    if (offset > len || len - offset < sizeof(v))
+        return false;
+
+    memcpy(&v, data + offset, sizeof(v));
+    *value = swap ? (((v & 0xff) << 24) | ((v & 0xff00) << 8) | ((v >> 8) & 0xff00) | (v >> 24)) : v;
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Read a 64-bit value at @a offset, which must lie within @a len bytes of @a data.
+ */
+static bool read_u64 (const uint8_t *data, size_t len, uint64_t offset, bool swap, uint64_t *value) {
+    uint32_t lo, hi;
+
+    if (!read_u32(data, len, offset, swap, &lo) || !read_u32(data, len, offset + 4, swap, &hi))
+        return false;
+
+    if (swap)
+        *value = ((uint64_t) lo << 32) | hi;
+    else
+        *value = ((uint64_t) hi << 32) | lo;
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Read a 32-bit or 64-bit value at @a offset, depending on @a m64.
+ */
+static bool read_word (const uint8_t *data, size_t len, uint64_t offset, bool swap, bool m64, uint64_t *value) {
+    uint32_t v32;
+
+    if (m64)
+        return read_u64(data, len, offset, swap, value);
+
+    if (!read_u32(data, len, offset, swap, &v32))
+        return false;
+
+    *value = v32;
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Return true if the host is little-endian.
+ */
+static bool host_little_endian (void) {
+    const uint16_t value = 1;
+    return *(const uint8_t *) &value == 1;
+}
+
+/**
+ * @internal
+ *
+ * Return true if @a data is a big-endian fat header. Fat headers are always big-endian.
+ */
+static bool fat_header (const uint8_t *data, size_t len, bool *fat64, uint32_t *nfat_arch) {
+    bool swap = host_little_endian();
+    uint32_t magic;
+
+    if (!read_u32(data, len, 0, swap, &magic) || (magic != MACHO_FAT_MAGIC && magic != MACHO_FAT_MAGIC_64))
+        return false;
+
+    if (!read_u32(data, len, 4, swap, nfat_arch) || *nfat_arch > MACHO_MAX_FAT_ARCH)
+        return false;
+
+    *fat64 = (magic == MACHO_FAT_MAGIC_64);
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Locate the Mach-O image for @a slice within @a data.
+ */
+static bool find_slice (const uint8_t *data, size_t len, size_t slice, const uint8_t **slice_data, size_t *slice_len) {
+    bool swap = host_little_endian();
+    uint32_t nfat_arch;
+    bool fat64;
+
+    if (!fat_header(data, len, &fat64, &nfat_arch)) {
+        if (slice != 0)
+            return false;
+
+        *slice_data = data;
+        *slice_len = len;
+        return true;
+    }
+
+    if (slice >= nfat_arch)
+        return false;
+
+    /* struct fat_arch or fat_arch_64 */
+    uint64_t entry = 8 + slice * (fat64 ? 32 : 20);
+    uint64_t offset, size;
+    if (fat64) {
+        if (!read_u64(data, len, entry + 8, swap, &offset) || !read_u64(data, len, entry + 16, swap, &size))
+            return false;
+    } else {
+        uint32_t offset32, size32;
+        if (!read_u32(data, len, entry + 8, swap, &offset32) || !read_u32(data, len, entry + 12, swap, &size32))
+            return false;
+        offset = offset32;
+        size = size32;
+    }
+
+    if (offset > len || size > len - offset)
+        return false;
+
+    *slice_data = data + offset;
+    *slice_len = size;
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Parse the header and load commands of the Mach-O image at @a data.
+ */
+static bool macho_parse (macho_image_t *image, const uint8_t *data, size_t len) {
+    uint32_t magic, ncmds, sizeofcmds;
+
+    memset(image, 0, sizeof(*image));
+    image->data = data;
+    image->len = len;
+
+    if (!read_u32(data, len, 0, false, &magic))
+        return false;
+
+    switch (magic) {
+        case MACHO_MH_MAGIC:    break;
+        case MACHO_MH_CIGAM:    image->swap = true; break;
+        case MACHO_MH_MAGIC_64: image->m64 = true; break;
+        case MACHO_MH_CIGAM_64: image->m64 = true; image->swap = true; break;
+        default:
+            return false;
+    }
+
+    /* struct mach_header or mach_header_64 */
+    uint64_t header_size = image->m64 ? 32 : 28;
+    if (!read_u32(data, len, 16, image->swap, &ncmds) || !read_u32(data, len, 20, image->swap, &sizeofcmds))
+        return false;
+
+    if (header_size + sizeofcmds > len)
+        return false;
+
+    uint64_t cmds_end = header_size + sizeofcmds;
+    uint64_t offset = header_size;
+    image->ncmds = ncmds;
+    image->cmds_offset = header_size;
+    image->cmds_end = cmds_end;
+    bool has_text = false;
+    for (uint32_t i = 0; i < ncmds; i++) {
+        uint32_t cmd, cmdsize;
+
+        if (!read_u32(data, cmds_end, offset, image->swap, &cmd) || !read_u32(data, cmds_end, offset + 4, image->swap, &cmdsize))
+            return false;
+        if (cmdsize < 8 || cmdsize > cmds_end - offset)
+            return false;
+
+        switch (cmd) {
+            case MACHO_LC_SEGMENT:
+            case MACHO_LC_SEGMENT_64: {
+                bool seg64 = (cmd == MACHO_LC_SEGMENT_64);
+                uint64_t vmaddr, vmsize;
+                uint32_t nsects;
+
+                /* struct segment_command or segment_command_64, followed by nsects sections */
+                if (cmdsize < (seg64 ? 72 : 56))
+                    return false;
+                if (!read_word(data, cmds_end, offset + 24, image->swap, seg64, &vmaddr) ||
+                    !read_word(data, cmds_end, offset + (seg64 ? 32 : 28), image->swap, seg64, &vmsize) ||
+                    !read_u32(data, cmds_end, offset + (seg64 ? 64 : 48), image->swap, &nsects))
+                {
+                    return false;
+                }
+
+                if (!has_text && strncmp((const char *) data + offset + 8, "__TEXT", 16) == 0) {
+                    image->text_vmaddr = vmaddr;
+                    has_text = true;
+                }
+
+                uint64_t section_size = seg64 ? 80 : 68;
+                uint64_t section = offset + (seg64 ? 72 : 56);
+                if (nsects > (cmdsize - (section - offset)) / section_size)
+                    return false;
+
+                for (uint32_t s = 0; s < nsects && image->section_count < MACHO_MAX_SECT; s++, section += section_size) {
+                    macho_section_t *sect = &image->sections[image->section_count++];
+                    uint64_t addr, size;
+                    uint32_t flags;
+
+                    if (!read_word(data, cmds_end, section + 32, image->swap, seg64, &addr) ||
+                        !read_word(data, cmds_end, section + (seg64 ? 40 : 36), image->swap, seg64, &size) ||
+                        !read_u32(data, cmds_end, section + (seg64 ? 64 : 56), image->swap, &flags))
+                    {
+                        return false;
+                    }
+
+                    /* Stored as absolute addresses until the __TEXT segment address is known */
+                    sect->start = addr;
+                    sect->end = addr + size;
+                    sect->code = (flags & (MACHO_S_ATTR_PURE_INSTRUCTIONS | MACHO_S_ATTR_SOME_INSTRUCTIONS)) != 0;
+                }
+                break;
+            }
+
+            case MACHO_LC_SYMTAB:
+                /* struct symtab_command */
+                if (cmdsize < 24)
+                    return false;
+                if (!read_u32(data, cmds_end, offset + 8, image->swap, &image->symtab_offset) ||
+                    !read_u32(data, cmds_end, offset + 12, image->swap, &image->symtab_count) ||
+                    !read_u32(data, cmds_end, offset + 16, image->swap, &image->strtab_offset) ||
+                    !read_u32(data, cmds_end, offset + 20, image->swap, &image->strtab_size))
+                {
+                    return false;
+                }
+                image->has_symtab = true;
+                break;
+
+            case MACHO_LC_UUID:
+                /* struct uuid_command */
+                if (cmdsize < 8 + PLCRASH_SYMBOL_INDEX_UUID_LEN)
+                    return false;
+                memcpy(image->uuid, data + offset + 8, PLCRASH_SYMBOL_INDEX_UUID_LEN);
+                image->has_uuid = true;
+                break;
+
+            default:
+                break;
+        }
+
+        offset += cmdsize;
+    }
+
+    /* Sections outside of the __TEXT segment's address space cannot be symbolicated */
+    for (size_t i = 0; i < image->section_count; i++) {
+        macho_section_t *sect = &image->sections[i];
+        if (!has_text || sect->start < image->text_vmaddr || sect->end < sect->start) {
+            sect->start = sect->end = 0;
+            sect->code = false;
+        } else {
+            sect->start -= image->text_vmaddr;
+            sect->end -= image->text_vmaddr;
+        }
+    }
+
+    return has_text;
+}
+
+/**
+ * Return the number of Mach-O images within @a data. A thin Mach-O file contains a single image; a fat file contains
+ * one image per architecture. Returns 0 if @a data is not a Mach-O file.
+ *
+ * @param data File contents.
+ * @param len Length of @a data.
+ */
+size_t plcrash_symbol_index_slice_count (const void *data, size_t len) {
+    uint32_t nfat_arch;
+    bool fat64;
+
+    if (fat_header(data, len, &fat64, &nfat_arch))
+        return nfat_arch;
+
+    macho_image_t *image = malloc(sizeof(*image));
+    if (image == NULL)
+        return 0;
+
+    size_t count = macho_parse(image, data, len) ? 1 : 0;
+    free(image);
+    return count;
+}
+
+/**
+ * Fetch the UUID of Mach-O image @a slice within @a data.
+ *
+ * @param data File contents.
+ * @param len Length of @a data.
+ * @param slice Image index, less than plcrash_symbol_index_slice_count().
+ * @param uuid On success, the image UUID.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if the image is invalid or does not have a UUID, or
+ * PLCRASH_ENOMEM if state could not be allocated.
+ */
+plcrash_error_t plcrash_symbol_index_slice_uuid (const void *data, size_t len, size_t slice, uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN]) {
+    const uint8_t *slice_data;
+    size_t slice_len;
+    plcrash_error_t err = PLCRASH_EINVAL;
+
+    if (!find_slice(data, len, slice, &slice_data, &slice_len))
+        return PLCRASH_EINVAL;
+
+    macho_image_t *image = malloc(sizeof(*image));
+    if (image == NULL)
+        return PLCRASH_ENOMEM;
+
+    if (macho_parse(image, slice_data, slice_len) && image->has_uuid) {
+        memcpy(uuid, image->uuid, PLCRASH_SYMBOL_INDEX_UUID_LEN);
+        err = PLCRASH_ESUCCESS;
+    }
+
+    free(image);
+    return err;
+}
+
+/**
+ * @internal
+ *
+ * Return true if the 16 byte, NUL-padded name at @a name matches @a expected.
+ */
+static bool name_equals (const uint8_t *name, const char *expected) {
+    size_t len = strlen(expected);
+    return len <= 16 && memcmp(name, expected, len) == 0 && (len == 16 || name[len] == '\0');
+}
+
+/**
+ * Locate a segment or section of Mach-O image @a slice within @a data.
+ *
+ * @param data File contents.
+ * @param len Length of @a data.
+ * @param slice Image index, less than plcrash_symbol_index_slice_count().
+ * @param segname Segment name.
+ * @param sectname Section name, or NULL to locate the segment itself.
+ * @param section On success, the segment or section.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if the image is invalid, or if the segment or section was
+ * not found or its contents lie outside of @a data, or PLCRASH_ENOMEM if state could not be allocated.
+ */
+plcrash_error_t plcrash_symbol_index_slice_section (const void *data, size_t len, size_t slice, const char *segname, const char *sectname,
+                                                    plcrash_symbol_index_section_t *section)
+{
+    const uint8_t *slice_data;
+    size_t slice_len;
+    plcrash_error_t err = PLCRASH_EINVAL;
+
+    if (!find_slice(data, len, slice, &slice_data, &slice_len))
+        return PLCRASH_EINVAL;
+
+    macho_image_t *image = malloc(sizeof(*image));
+    if (image == NULL)
+        return PLCRASH_ENOMEM;
+
+    if (!macho_parse(image, slice_data, slice_len))
+        goto cleanup;
+
+    /* The load commands were validated by macho_parse() */
+    uint64_t offset = image->cmds_offset;
+    for (uint32_t i = 0; i < image->ncmds && err != PLCRASH_ESUCCESS; i++) {
+        uint32_t cmd, cmdsize;
+
+        if (!read_u32(slice_data, image->cmds_end, offset, image->swap, &cmd) ||
+            !read_u32(slice_data, image->cmds_end, offset + 4, image->swap, &cmdsize))
+        {
+            break;
+        }
+
+        if ((cmd == MACHO_LC_SEGMENT || cmd == MACHO_LC_SEGMENT_64) && name_equals(slice_data + offset + 8, segname)) {
+            bool seg64 = (cmd == MACHO_LC_SEGMENT_64);
+            uint64_t vmaddr, fileoff, filesize;
+            uint32_t nsects;
+
+            if (!read_word(slice_data, image->cmds_end, offset + 24, image->swap, seg64, &vmaddr) ||
+                !read_word(slice_data, image->cmds_end, offset + (seg64 ? 40 : 32), image->swap, seg64, &fileoff) ||
+                !read_word(slice_data, image->cmds_end, offset + (seg64 ? 48 : 36), image->swap, seg64, &filesize) ||
+                !read_u32(slice_data, image->cmds_end, offset + (seg64 ? 64 : 48), image->swap, &nsects))
+            {
+                break;
+            }
+
+            uint64_t section_size = seg64 ? 80 : 68;
+            uint64_t sect = offset + (seg64 ? 72 : 56);
+            for (uint32_t s = 0; s < nsects && sectname != NULL; s++, sect += section_size) {
+                uint32_t sectoff;
+
+                if (!name_equals(slice_data + sect, sectname))
+                    continue;
+
+                if (!read_word(slice_data, image->cmds_end, sect + 32, image->swap, seg64, &vmaddr) ||
+                    !read_word(slice_data, image->cmds_end, sect + (seg64 ? 40 : 36), image->swap, seg64, &filesize) ||
+                    !read_u32(slice_data, image->cmds_end, sect + (seg64 ? 48 : 40), image->swap, &sectoff))
+                {
+                    nsects = 0;
+                    break;
+                }
+
+                fileoff = sectoff;
+                break;
+            }
+
+            if (sectname == NULL || sect < offset + (seg64 ? 72 : 56) + nsects * section_size) {
+                if (fileoff > slice_len || filesize > slice_len - fileoff)
+                    break;
+
+                section->data = slice_data + fileoff;
+                section->size = (size_t) filesize;
+                section->vmaddr = vmaddr;
+                section->swap = image->swap;
+                err = PLCRASH_ESUCCESS;
+            }
+        }
+
+        offset += cmdsize;
+    }
+
+cleanup:
+    free(image);
+    return err;
+}
+
+/**
+ * @internal
+ *
+ * Order symbols by address, preferring external symbols, and then symbol table order.
+ */
+static int build_symbol_compare (const void *a, const void *b) {
+    const build_symbol_t *lhs = a;
+    const build_symbol_t *rhs = b;
+
+    if (lhs->address != rhs->address)
+        return (lhs->address < rhs->address) ? -1 : 1;
+
+    if (lhs->external != rhs->external)
+        return lhs->external ? -1 : 1;
+
+    return (lhs->position < rhs->position) ? -1 : (lhs->position > rhs->position);
+}
+
+/**
+ * @internal
+ *
+ * Encode @a value as an unsigned LEB128 value at @a p, returning the number of bytes written (at most 10).
+ */
+static size_t write_uleb128 (uint8_t *p, uint64_t value) {
+    size_t len = 0;
+
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        p[len++] = byte | (value != 0 ? 0x80 : 0);
+    } while (value != 0);
+
+    return len;
+}
+
+/**
+ * @internal
+ *
+ * Decode an unsigned LEB128 value at @a *pos, which must lie before @a end, advancing @a *pos past the value.
+ */
+static bool read_uleb128 (const uint8_t *data, size_t end, size_t *pos, uint64_t *value) {
+    uint64_t result = 0;
+
+    for (unsigned shift = 0; *pos < end && shift < 64; shift += 7) {
+        uint8_t byte = data[(*pos)++];
+
+        /* Reject bits beyond the 64th */
+        if (shift == 63 && (byte & 0x7e) != 0)
+            return false;
+
+        result |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @internal
+ *
+ * Write @a len bytes of @a data to @a fd.
+ */
+static bool write_all (int fd, const void *data, size_t len) {
+    const uint8_t *p = data;
+
+    while (len > 0) {
+        ssize_t rv = write(fd, p, len);
+        if (rv > 0) {
+            p += rv;
+            len -= rv;
+        } else if (rv == 0 || errno != EINTR) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @internal
+ *
+ * Collect the defined code symbols of @a image into @a symbols, which must have room for the image's full
+ * symbol table. Returns the number of collected symbols.
+ */
+static size_t collect_symbols (const macho_image_t *image, build_symbol_t *symbols) {
+    const char *strtab = (const char *) image->data + image->strtab_offset;
+    uint64_t nlist_size = image->m64 ? 16 : 12;
+    size_t count = 0;
+
+    for (uint32_t i = 0; i < image->symtab_count; i++) {
+        uint64_t entry = image->symtab_offset + i * nlist_size;
+        uint32_t strx;
+        uint64_t value;
+
+        /* struct nlist or nlist_64 */
+        if (!read_u32(image->data, image->len, entry, image->swap, &strx) ||
+            !read_word(image->data, image->len, entry + 8, image->swap, image->m64, &value))
+        {
+            break;
+        }
+
+        uint8_t type = image->data[entry + 4];
+        uint8_t sect = image->data[entry + 5];
+
+        /* Only defined, non-debugging symbols within code sections */
+        if ((type & MACHO_N_STAB) != 0 || (type & MACHO_N_TYPE) != MACHO_N_SECT)
+            continue;
+        if (sect == 0 || sect > image->section_count || !image->sections[sect - 1].code)
+            continue;
+        if (value < image->text_vmaddr || strx == 0 || strx >= image->strtab_size)
+            continue;
+
+        const char *name = strtab + strx;
+        const char *end = memchr(name, '\0', image->strtab_size - strx);
+        if (end == NULL || end == name)
+            continue;
+
+        /* C symbols carry a leading underscore, which is not displayed */
+        if (name[0] == '_' && end - name > 1)
+            name++;
+
+        build_symbol_t *symbol = &symbols[count++];
+        symbol->address = value - image->text_vmaddr;
+        symbol->section_end = image->sections[sect - 1].end;
+        symbol->name = name;
+        symbol->name_len = end - name;
+        symbol->external = (type & MACHO_N_EXT) != 0;
+        symbol->position = i;
+    }
+
+    return count;
+}
+
+/**
+ * Build a symbol index from the symbol table of Mach-O image @a slice within @a data, and write it to @a fd.
+ *
+ * Only defined symbols within code sections are indexed. Each symbol is assumed to extend to the next symbol or to
+ * the end of its section, whichever comes first. Where several symbols share an address, the first external symbol
+ * is used. Names longer than PLCRASH_SYMBOL_NAME_MAX - 1 bytes are truncated.
+ *
+ * @param data File contents.
+ * @param len Length of @a data.
+ * @param slice Image index, less than plcrash_symbol_index_slice_count().
+ * @param fd Output file descriptor.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if the image is invalid or has no UUID or symbol table,
+ * PLCRASH_ENOMEM if state could not be allocated, or PLCRASH_OUTPUT_ERR if writing to @a fd failed.
+ */
+plcrash_error_t plcrash_symbol_index_write (const void *data, size_t len, size_t slice, int fd) {
+    build_symbol_t *symbols = NULL;
+    uint8_t *output = NULL;
+    plcrash_error_t err = PLCRASH_EINVAL;
+    const uint8_t *slice_data;
+    size_t slice_len;
+
+    if (!find_slice(data, len, slice, &slice_data, &slice_len))
+        return PLCRASH_EINVAL;
+
+    macho_image_t *image = malloc(sizeof(*image));
+    if (image == NULL)
+        return PLCRASH_ENOMEM;
+
+    if (!macho_parse(image, slice_data, slice_len) || !image->has_uuid || !image->has_symtab)
+        goto cleanup;
+
+    if ((uint64_t) image->strtab_offset + image->strtab_size > slice_len)
+        goto cleanup;
+
+    uint64_t nlist_size = image->m64 ? 16 : 12;
+    if ((uint64_t) image->symtab_offset + image->symtab_count * nlist_size > slice_len)
+        goto cleanup;
+
+    /* Collect and sort the symbols */
+    symbols = malloc((image->symtab_count > 0 ? image->symtab_count : 1) * sizeof(*symbols));
+    if (symbols == NULL) {
+        err = PLCRASH_ENOMEM;
+        goto cleanup;
+    }
+
+    size_t symbol_count = collect_symbols(image, symbols);
+    qsort(symbols, symbol_count, sizeof(*symbols), build_symbol_compare);
+
+    /* Drop duplicate addresses and compute sizes, measuring the worst case encoded size */
+    size_t entry_count = 0;
+    uint64_t data_max = 0;
+    for (size_t i = 0; i < symbol_count; i++) {
+        if (i > 0 && symbols[i].address == symbols[i - 1].address)
+            continue;
+
+        uint64_t end = symbols[i].section_end;
+        for (size_t next = i + 1; next < symbol_count; next++) {
+            if (symbols[next].address != symbols[i].address) {
+                if (symbols[next].address < end)
+                    end = symbols[next].address;
+                break;
+            }
+        }
+
+        if (end <= symbols[i].address)
+            continue;
+
+        uint64_t size = end - symbols[i].address;
+        symbols[entry_count] = symbols[i];
+        symbols[entry_count].section_end = (size > UINT32_MAX) ? UINT32_MAX : size;
+        if (symbols[entry_count].name_len >= PLCRASH_SYMBOL_NAME_MAX)
+            symbols[entry_count].name_len = PLCRASH_SYMBOL_NAME_MAX - 1;
+
+        /* Four LEB128 values, and the name */
+        data_max += 4 * 10 + symbols[entry_count].name_len;
+        entry_count++;
+    }
+
+    if (data_max > UINT32_MAX) {
+        err = PLCRASH_ENOTSUP;
+        goto cleanup;
+    }
+
+    /* Assemble the index */
+    size_t block_count = (entry_count + PLCRASH_SYMBOL_INDEX_BLOCK_SIZE - 1) / PLCRASH_SYMBOL_INDEX_BLOCK_SIZE;
+    plcrash_symbol_index_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PLCRASH_SYMBOL_INDEX_MAGIC, sizeof(header.magic));
+    header.version = PLCRASH_SYMBOL_INDEX_VERSION;
+    header.symbol_count = entry_count;
+    memcpy(header.uuid, image->uuid, sizeof(header.uuid));
+    header.block_count = block_count;
+    header.data_offset = sizeof(header) + block_count * sizeof(plcrash_symbol_index_block_t);
+
+    output = malloc(header.data_offset + data_max);
+    if (output == NULL) {
+        err = PLCRASH_ENOMEM;
+        goto cleanup;
+    }
+
+    plcrash_symbol_index_block_t *blocks = (plcrash_symbol_index_block_t *) (output + sizeof(header));
+    uint8_t *encoded = output + header.data_offset;
+    size_t data_size = 0;
+
+    for (size_t i = 0; i < entry_count; i++) {
+        const build_symbol_t *symbol = &symbols[i];
+        size_t prefix = 0;
+
+        if (i % PLCRASH_SYMBOL_INDEX_BLOCK_SIZE == 0) {
+            plcrash_symbol_index_block_t *block = &blocks[i / PLCRASH_SYMBOL_INDEX_BLOCK_SIZE];
+            block->address = symbol->address;
+            block->offset = (uint32_t) data_size;
+            block->count = (entry_count - i < PLCRASH_SYMBOL_INDEX_BLOCK_SIZE) ? entry_count - i : PLCRASH_SYMBOL_INDEX_BLOCK_SIZE;
+        } else {
+            const build_symbol_t *previous = &symbols[i - 1];
+            while (prefix < symbol->name_len && prefix < previous->name_len && symbol->name[prefix] == previous->name[prefix])
+                prefix++;
+        }
+
+        uint64_t delta = (i % PLCRASH_SYMBOL_INDEX_BLOCK_SIZE == 0) ? 0 : symbol->address - symbols[i - 1].address;
+        data_size += write_uleb128(encoded + data_size, delta);
+        data_size += write_uleb128(encoded + data_size, symbol->section_end);
+        data_size += write_uleb128(encoded + data_size, prefix);
+        data_size += write_uleb128(encoded + data_size, symbol->name_len - prefix);
+        memcpy(encoded + data_size, symbol->name + prefix, symbol->name_len - prefix);
+        data_size += symbol->name_len - prefix;
+    }
+
+    header.data_size = data_size;
+    memcpy(output, &header, sizeof(header));
+
+    size_t output_len = header.data_offset + data_size;
+    err = write_all(fd, output, output_len) ? PLCRASH_ESUCCESS : PLCRASH_OUTPUT_ERR;
+
+cleanup:
+    free(output);
+    free(symbols);
+    free(image);
+    return err;
+}
+
+/**
+ * Map the symbol index at @a path.
+ *
+ * Only the header is validated; the symbol data is not read until it is looked up.
+ *
+ * @param index The index to initialize.
+ * @param path Index file path.
+ *
+ * @return Returns PLCRASH_ESUCCESS on success, PLCRASH_EINVAL if the file could not be opened or is not a valid
+ * index, or PLCRASH_ENOTSUP if the index was written with an unsupported version or byte order.
+ */
+plcrash_error_t plcrash_symbol_index_open (plcrash_symbol_index_t *index, const char *path) {
+    struct stat sb;
+    int fd;
+
+    memset(index, 0, sizeof(*index));
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return PLCRASH_EINVAL;
+
+    if (fstat(fd, &sb) != 0 || sb.st_size < (off_t) sizeof(plcrash_symbol_index_header_t) || (uint64_t) sb.st_size > SIZE_MAX) {
+        close(fd);
+        return PLCRASH_EINVAL;
+    }
+
+    void *map = mmap(NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return PLCRASH_EINVAL;
+
+    const plcrash_symbol_index_header_t *header = map;
+    plcrash_error_t err = PLCRASH_ESUCCESS;
+    uint64_t blocks_end = sizeof(*header) + (uint64_t) header->block_count * sizeof(plcrash_symbol_index_block_t);
+
+    if (memcmp(header->magic, PLCRASH_SYMBOL_INDEX_MAGIC, sizeof(header->magic)) != 0) {
+        err = PLCRASH_EINVAL;
+    } else if (header->version != PLCRASH_SYMBOL_INDEX_VERSION) {
+        err = PLCRASH_ENOTSUP;
+    } else if (header->data_offset < blocks_end || header->data_offset > (uint64_t) sb.st_size ||
+               header->data_size > (uint64_t) sb.st_size - header->data_offset)
+    {
+        err = PLCRASH_EINVAL;
+    }
+
+    if (err != PLCRASH_ESUCCESS) {
+        munmap(map, (size_t) sb.st_size);
+        return err;
+    }
+
+    index->map = map;
+    index->map_len = (size_t) sb.st_size;
+    index->header = header;
+    index->blocks = (const plcrash_symbol_index_block_t *) ((const uint8_t *) map + sizeof(*header));
+    index->data = (const uint8_t *) map + header->data_offset;
+    return PLCRASH_ESUCCESS;
+}
+
+/**
+ * Look up the symbol containing @a address.
+ *
+ * The index is only read, and lookups may be performed concurrently from multiple threads.
+ *
+ * @param index An open symbol index.
+ * @param address The address to look up, relative to the image's load address.
+ * @param symbol On success, the symbol containing @a address. The symbol's file is set to an empty string.
+ *
+ * @return Returns true if a symbol was found.
+ */
+bool plcrash_symbol_index_lookup (const plcrash_symbol_index_t *index, uint64_t address, plcrash_symbol_t *symbol) {
+    const plcrash_symbol_index_block_t *blocks = index->blocks;
+    size_t block_count = index->header->block_count;
+    size_t lo = 0;
+    size_t hi = block_count;
+
+    /* Find the last block with an address <= address */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (blocks[mid].address <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == 0)
+        return false;
+
+    const plcrash_symbol_index_block_t *block = &blocks[lo - 1];
+    uint64_t end = (lo < block_count) ? blocks[lo].offset : index->header->data_size;
+    size_t pos = block->offset;
+    if (pos > end || end > index->header->data_size)
+        return false;
+
+    /* Decode the block up to the last symbol with an address <= address */
+    uint64_t symbol_address = block->address;
+    uint64_t symbol_size = 0;
+    size_t name_len = 0;
+    bool found = false;
+
+    for (uint32_t i = 0; i < block->count && i < PLCRASH_SYMBOL_INDEX_BLOCK_SIZE; i++) {
+        uint64_t delta, size, prefix, suffix;
+
+        if (!read_uleb128(index->data, end, &pos, &delta) || !read_uleb128(index->data, end, &pos, &size) ||
+            !read_uleb128(index->data, end, &pos, &prefix) || !read_uleb128(index->data, end, &pos, &suffix))
+        {
+            return false;
+        }
+
+        if (delta > UINT64_MAX - symbol_address)
+            return false;
+
+        if (symbol_address + delta > address)
+            break;
+
+        if (prefix > name_len || suffix > end - pos || prefix + suffix >= PLCRASH_SYMBOL_NAME_MAX)
+            return false;
+
+        memcpy(symbol->name + prefix, index->data + pos, suffix);
+        pos += suffix;
+        name_len = prefix + suffix;
+
+        symbol_address += delta;
+        symbol_size = size;
+        found = true;
+    }
+
+    if (!found || address - symbol_address >= symbol_size)
+        return false;
+
+    symbol->name[name_len] = '\0';
+    symbol->offset = address - symbol_address;
+    symbol->file[0] = '\0';
+    symbol->line = 0;
+    return true;
+}
+
+/**
+ * Unmap @a index.
+ */
+void plcrash_symbol_index_close (plcrash_symbol_index_t *index) {
+    if (index->map != NULL)
+        munmap(index->map, index->map_len);
+
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * @} plcrash_symbol_index
+ */
@@ -0,0 +1,204 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#import "PLCrashAsync.h"
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_index
+ *
+ * Length of a Mach-O image UUID, in bytes.
+ */
+#define PLCRASH_SYMBOL_INDEX_UUID_LEN 16
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_index
+ *
+ * Symbol index file magic.
+ */
+#define PLCRASH_SYMBOL_INDEX_MAGIC "plsymidx"
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_index
+ *
+ * Symbol index file format version. Indexes are written in host byte order; an index written with the opposite
+ * byte order is rejected as having an unsupported version.
+ */
+#define PLCRASH_SYMBOL_INDEX_VERSION 2
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_index
+ *
+ * Number of symbols encoded within each index block.
+ */
+#define PLCRASH_SYMBOL_INDEX_BLOCK_SIZE 32
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_index
+ *
+ * Maximum length of a symbol or source file name returned by a lookup, including the NUL terminator. Longer
+ * names are truncated.
+ */
+#define PLCRASH_SYMBOL_NAME_MAX 1024
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_index
+ *
+ * Symbol index file header. The header is followed by block_count plcrash_symbol_index_block_t records, sorted by
+ * address, and then by the encoded symbol data.
+ *
+ * Each block encodes up to PLCRASH_SYMBOL_INDEX_BLOCK_SIZE address-sorted symbols as a sequence of unsigned LEB128
+ * values: the distance from the previous symbol's address (0 for the first symbol of a block), the symbol size,
+ * the number of leading bytes shared with the previous symbol's name (0 for the first symbol of a block), and the
+ * length of the remaining name bytes, which follow.
+ */
+typedef struct plcrash_symbol_index_header {
+    /** PLCRASH_SYMBOL_INDEX_MAGIC, without a NUL terminator */
+    char magic[8];
+
+    /** PLCRASH_SYMBOL_INDEX_VERSION */
+    uint32_t version;
+
+    /** Number of symbols */
+    uint32_t symbol_count;
+
+    /** UUID of the indexed image */
+    uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+
+    /** Number of blocks */
+    uint32_t block_count;
+
+    /** Reserved; always 0 */
+    uint32_t reserved;
+
+    /** Offset of the symbol data from the start of the file */
+    uint64_t data_offset;
+
+    /** Size of the symbol data, in bytes */
+    uint64_t data_size;
+} plcrash_symbol_index_header_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_index
+ *
+ * A symbol index block.
+ */
+typedef struct plcrash_symbol_index_block {
+    /** Address of the block's first symbol, relative to the image's load address */
+    uint64_t address;
+
+    /** Offset of the block's encoded symbols within the symbol data */
+    uint32_t offset;
+
+    /** Number of symbols within the block */
+    uint32_t count;
+} plcrash_symbol_index_block_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_index
+ *
+ * A memory mapped symbol index.
+ */
+typedef struct plcrash_symbol_index {
+    /** Mapped file */
+    void *map;
+
+    /** Size of the mapping, in bytes */
+    size_t map_len;
+
+    /** Index header */
+    const plcrash_symbol_index_header_t *header;
+
+    /** Address-sorted blocks */
+    const plcrash_symbol_index_block_t *blocks;
+
+    /** Encoded symbol data */
+    const uint8_t *data;
+} plcrash_symbol_index_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_index
+ *
+ * A resolved symbol. Names are copied into the symbol, and remain valid after the index they were read from is
+ * closed.
+ */
+typedef struct plcrash_symbol {
+    /** Symbol name */
+    char name[PLCRASH_SYMBOL_NAME_MAX];
+
+    /** Offset of the looked up address from the start of the symbol */
+    uint64_t offset;
+
+    /** Source file name, or an empty string if unknown */
+    char file[PLCRASH_SYMBOL_NAME_MAX];
+
+    /** Source line number, or 0 if unknown */
+    uint32_t line;
+} plcrash_symbol_t;
+
+/**
+ * @internal
+ * @ingroup plcrash_symbol_index
+ *
+ * A Mach-O segment or section.
+ */
+typedef struct plcrash_symbol_index_section {
+    /** Section contents */
+    const uint8_t *data;
+
+    /** Size of the section contents, in bytes */
+    size_t size;
+
+    /** Section address */
+    uint64_t vmaddr;
+
+    /** If true, the image byte order is the opposite of the host's */
+    bool swap;
+} plcrash_symbol_index_section_t;
+
+size_t plcrash_symbol_index_slice_count (const void *data, size_t len);
+plcrash_error_t plcrash_symbol_index_slice_uuid (const void *data, size_t len, size_t slice, uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN]);
+plcrash_error_t plcrash_symbol_index_slice_section (const void *data, size_t len, size_t slice, const char *segname, const char *sectname,
+                                                    plcrash_symbol_index_section_t *section);
+plcrash_error_t plcrash_symbol_index_write (const void *data, size_t len, size_t slice, int fd);
+
+plcrash_error_t plcrash_symbol_index_open (plcrash_symbol_index_t *index, const char *path);
+bool plcrash_symbol_index_lookup (const plcrash_symbol_index_t *index, uint64_t address, plcrash_symbol_t *symbol);
+void plcrash_symbol_index_close (plcrash_symbol_index_t *index);
@@ -0,0 +1,364 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "GTMSenTestCase.h"
+#import "CrashReporter.h"
+#import "PLCrashSymbolIndex.h"
+#import "PLCrashSymbolCache.h"
+#import "PLCrashReportTextWriter.h"
+#import "PLCrashFrameWalker.h"
+#import "PLCrashLogWriter.h"
+
+#import <dlfcn.h>
+#import <fcntl.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <mach-o/dyld.h>
+#import <mach-o/loader.h>
+#import <mach/mach_time.h>
+#import <pthread.h>
+
+@interface PLCrashSymbolIndexTests : SenTestCase {
+@private
+    /* Temporary directory for indexes and reports */
+    NSString *_tempPath;
+
+    /* Test thread */
+    plframe_test_thead_t _thr_args;
+}
+@end
+
+/* Number of passes over the report in the symbolication benchmark */
+#define BENCH_ITERATIONS 1000
+
+/* Number of threads, and lookups per thread, in the concurrent lookup test */
+#define LOOKUP_THREADS 8
+#define LOOKUP_ITERATIONS 10000
+
+/* Concurrent lookup thread arguments */
+typedef struct lookup_args {
+    plcrash_symbol_cache_t *cache;
+    const uint8_t *uuid;
+    uint64_t address;
+    const char *name;
+    size_t failures;
+} lookup_args_t;
+
+/* Repeatedly look up a symbol, counting incorrect results */
+static void *lookup_thread (void *arg) {
+    lookup_args_t *args = arg;
+    plcrash_symbol_t symbol;
+
+    for (int i = 0; i < LOOKUP_ITERATIONS; i++) {
+        if (!plcrash_symbol_cache_lookup(args->cache, args->uuid, args->address, &symbol) || strcmp(symbol.name, args->name) != 0)
+            args->failures++;
+    }
+
+    return NULL;
+}
+
+/* Read the LC_UUID of the loaded image with the given header */
+static bool image_uuid (const void *header, uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN]) {
+    const struct mach_header *mh = header;
+    const uint8_t *cmd = (const uint8_t *) header + ((mh->magic == MH_MAGIC_64) ? sizeof(struct mach_header_64) : sizeof(struct mach_header));
+
+    for (uint32_t i = 0; i < mh->ncmds; i++) {
+        const struct load_command *lc = (const struct load_command *) cmd;
+        if (lc->cmd == LC_UUID) {
+            memcpy(uuid, ((const struct uuid_command *) lc)->uuid, PLCRASH_SYMBOL_INDEX_UUID_LEN);
+            return true;
+        }
+        cmd += lc->cmdsize;
+    }
+
+    return false;
+}
+
+@implementation PLCrashSymbolIndexTests
+
+- (void) setUp {
+    _tempPath = [[NSTemporaryDirectory() stringByAppendingPathComponent: [[NSProcessInfo processInfo] globallyUniqueString]] retain];
+    [[NSFileManager defaultManager] createDirectoryAtPath: _tempPath withIntermediateDirectories: YES attributes: nil error: NULL];
+
+    plframe_test_thread_spawn(&_thr_args);
+}
+
+- (void) tearDown {
+    STAssertTrue([[NSFileManager defaultManager] removeItemAtPath: _tempPath error: NULL], @"Could not remove temporary directory");
+    [_tempPath release];
+
+    plframe_test_thread_stop(&_thr_args);
+}
+
+/* Build an index for the image containing function, and verify that it resolves function as dladdr() does */
+- (void) assertIndexResolvesFunction: (void *) function {
+    Dl_info info;
+    STAssertTrue(dladdr(function, &info) != 0 && info.dli_sname != NULL, @"dladdr() failed");
+
+    /* Map the image's file */
+    int fd = open(info.dli_fname, O_RDONLY);
+    STAssertTrue(fd >= 0, @"Could not open %s", info.dli_fname);
+
+    struct stat sb;
+    STAssertEquals(0, fstat(fd, &sb), @"Could not stat %s", info.dli_fname);
+    void *data = mmap(NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    STAssertTrue(data != MAP_FAILED, @"Could not map %s", info.dli_fname);
+
+    /* Index the slice with the loaded image's UUID */
+    size_t slice_count = plcrash_symbol_index_slice_count(data, (size_t) sb.st_size);
+    STAssertTrue(slice_count > 0, @"Not a Mach-O file: %s", info.dli_fname);
+
+    NSString *indexPath = [_tempPath stringByAppendingPathComponent: @"test.plsym"];
+    [[NSFileManager defaultManager] removeItemAtPath: indexPath error: NULL];
+
+    bool found = false;
+    for (size_t slice = 0; slice < slice_count && !found; slice++) {
+        plcrash_symbol_index_t index;
+        plcrash_symbol_t symbol;
+
+        fd = open([indexPath fileSystemRepresentation], O_RDWR|O_CREAT|O_TRUNC, 0644);
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_index_write(data, (size_t) sb.st_size, slice, fd), @"Could not write index");
+        close(fd);
+
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_index_open(&index, [indexPath fileSystemRepresentation]), @"Could not open index");
+
+        /* Thumb function pointers have the low bit set */
+        uint64_t address = (uintptr_t) function - (uintptr_t) info.dli_fbase;
+        if (plcrash_symbol_index_lookup(&index, address, &symbol) && symbol.offset <= 1) {
+            STAssertTrue(strcmp(symbol.name, info.dli_sname) == 0, @"Incorrect symbol %s for %s", symbol.name, info.dli_sname);
+            found = true;
+        }
+
+        plcrash_symbol_index_close(&index);
+    }
+
+    STAssertTrue(found, @"Could not resolve %s", info.dli_sname);
+    munmap(data, (size_t) sb.st_size);
+}
+
+/* Verify index lookups against dladdr() */
+- (void) testIndex {
+    [self assertIndexResolvesFunction: (void *) &strlen];
+    [self assertIndexResolvesFunction: (void *) &NSLog];
+    [self assertIndexResolvesFunction: (void *) &plcrash_symbol_index_lookup];
+}
+
+/* Verify that invalid files are rejected */
+- (void) testInvalid {
+    uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+    plcrash_symbol_index_t index;
+    char garbage[64];
+
+    memset(garbage, 0x42, sizeof(garbage));
+    STAssertEquals((size_t) 0, plcrash_symbol_index_slice_count(garbage, sizeof(garbage)), @"Accepted a non-Mach-O file");
+    STAssertEquals(PLCRASH_EINVAL, plcrash_symbol_index_slice_uuid(garbage, sizeof(garbage), 0, uuid), @"Accepted a non-Mach-O file");
+
+    NSString *indexPath = [_tempPath stringByAppendingPathComponent: @"garbage.plsym"];
+    [[NSData dataWithBytes: garbage length: sizeof(garbage)] writeToFile: indexPath atomically: NO];
+    STAssertEquals(PLCRASH_EINVAL, plcrash_symbol_index_open(&index, [indexPath fileSystemRepresentation]), @"Accepted an invalid index");
+}
+
+/* Verify that the cache indexes binaries by UUID, and that reports are symbolicated using the cache */
+- (void) testCache {
+    plcrash_symbol_cache_t cache;
+    Dl_info info;
+
+    STAssertTrue(dladdr((void *) &plcrash_symbol_index_lookup, &info) != 0, @"dladdr() failed");
+
+    NSString *cachePath = [_tempPath stringByAppendingPathComponent: @"cache"];
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_cache_init(&cache, [cachePath fileSystemRepresentation]), @"Could not create cache");
+
+    size_t added = 0;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_cache_add(&cache, info.dli_fname, &added), @"Could not index %s", info.dli_fname);
+    STAssertTrue(added > 0, @"No indexes built");
+
+    /* Adding the same binary again must reuse the cached indexes */
+    size_t readded = 0;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_cache_add(&cache, info.dli_fname, &readded), @"Could not index %s", info.dli_fname);
+    STAssertEquals((size_t) 0, readded, @"Cached indexes were rebuilt");
+
+    /* Unknown UUIDs are not found */
+    uint8_t uuid[PLCRASH_SYMBOL_INDEX_UUID_LEN];
+    memset(uuid, 0, sizeof(uuid));
+    plcrash_symbol_t symbol;
+    STAssertFalse(plcrash_symbol_cache_lookup(&cache, uuid, 0, &symbol), @"Found a symbol for an unknown UUID");
+
+    plcrash_symbol_cache_free(&cache);
+}
+
+/* Verify that no more than mapped_limit images are mapped, and that unmapped images are mapped again on use */
+- (void) testCacheMappedLimit {
+    void *functions[] = { (void *) &strlen, (void *) &NSLog, (void *) &plcrash_symbol_index_lookup };
+    const size_t count = sizeof(functions) / sizeof(functions[0]);
+    uint8_t uuids[count][PLCRASH_SYMBOL_INDEX_UUID_LEN];
+    uint64_t addresses[count];
+    Dl_info infos[count];
+    plcrash_symbol_cache_t cache;
+
+    NSString *cachePath = [_tempPath stringByAppendingPathComponent: @"cache"];
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_cache_init(&cache, [cachePath fileSystemRepresentation]), @"Could not create cache");
+    cache.mapped_limit = 1;
+
+    for (size_t i = 0; i < count; i++) {
+        STAssertTrue(dladdr(functions[i], &infos[i]) != 0 && infos[i].dli_sname != NULL, @"dladdr() failed");
+        STAssertTrue(image_uuid(infos[i].dli_fbase, uuids[i]), @"No UUID for %s", infos[i].dli_fname);
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_cache_add(&cache, infos[i].dli_fname, NULL), @"Could not index %s", infos[i].dli_fname);
+        addresses[i] = (uintptr_t) infos[i].dli_saddr - (uintptr_t) infos[i].dli_fbase;
+    }
+
+    /* Alternate between the images */
+    for (int pass = 0; pass < 3; pass++) {
+        for (size_t i = 0; i < count; i++) {
+            plcrash_symbol_t symbol;
+
+            STAssertTrue(plcrash_symbol_cache_lookup(&cache, uuids[i], addresses[i], &symbol), @"Lookup failed for %s", infos[i].dli_sname);
+            STAssertEqualCStrings(infos[i].dli_sname, symbol.name, @"Incorrect symbol");
+            STAssertEquals((size_t) 1, cache.mapped_count, @"Mapped limit exceeded");
+        }
+    }
+
+    plcrash_symbol_cache_free(&cache);
+}
+
+/* Verify concurrent lookups across images, with fewer images mapped than are looked up */
+- (void) testConcurrentLookup {
+    void *functions[] = { (void *) &strlen, (void *) &plcrash_symbol_index_lookup };
+    const size_t count = sizeof(functions) / sizeof(functions[0]);
+    uint8_t uuids[count][PLCRASH_SYMBOL_INDEX_UUID_LEN];
+    lookup_args_t args[LOOKUP_THREADS];
+    pthread_t threads[LOOKUP_THREADS];
+    Dl_info infos[count];
+    plcrash_symbol_cache_t cache;
+
+    NSString *cachePath = [_tempPath stringByAppendingPathComponent: @"cache"];
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_cache_init(&cache, [cachePath fileSystemRepresentation]), @"Could not create cache");
+    cache.mapped_limit = 1;
+
+    for (size_t i = 0; i < count; i++) {
+        STAssertTrue(dladdr(functions[i], &infos[i]) != 0 && infos[i].dli_sname != NULL, @"dladdr() failed");
+        STAssertTrue(image_uuid(infos[i].dli_fbase, uuids[i]), @"No UUID for %s", infos[i].dli_fname);
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_cache_add(&cache, infos[i].dli_fname, NULL), @"Could not index %s", infos[i].dli_fname);
+    }
+
+    for (int i = 0; i < LOOKUP_THREADS; i++) {
+        const Dl_info *info = &infos[i % count];
+
+        args[i].cache = &cache;
+        args[i].uuid = uuids[i % count];
+        args[i].address = (uintptr_t) info->dli_saddr - (uintptr_t) info->dli_fbase;
+        args[i].name = info->dli_sname;
+        args[i].failures = 0;
+        STAssertEquals(0, pthread_create(&threads[i], NULL, lookup_thread, &args[i]), @"Could not create thread");
+    }
+
+    for (int i = 0; i < LOOKUP_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        STAssertEquals((size_t) 0, args[i].failures, @"Incorrect lookups on thread %d", i);
+    }
+
+    STAssertTrue(cache.mapped_count <= 1, @"Mapped limit exceeded");
+    plcrash_symbol_cache_free(&cache);
+}
+
+/* Measure symbolication throughput of a written report */
+- (void) testSymbolicatePerformance {
+    siginfo_t info;
+    plframe_thread_state_t thread_state;
+    plcrash_log_writer_t log_writer;
+    plcrash_async_file_t file;
+    plcrash_symbol_cache_t cache;
+
+    /* Index every loaded image */
+    NSString *cachePath = [_tempPath stringByAppendingPathComponent: @"cache"];
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_symbol_cache_init(&cache, [cachePath fileSystemRepresentation]), @"Could not create cache");
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+
+    size_t added = 0;
+    uint64_t start = mach_absolute_time();
+    uint32_t image_count = _dyld_image_count();
+    for (uint32_t i = 0; i < image_count; i++)
+        plcrash_symbol_cache_add(&cache, _dyld_get_image_name(i), &added);
+    uint64_t index_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    /* Write a report of the test thread */
+    memset(&info, 0, sizeof(info));
+    info.si_pid = getpid();
+    info.si_uid = getuid();
+    info.si_code = SEGV_MAPERR;
+    info.si_signo = SIGSEGV;
+    plframe_thread_state_fetch(&thread_state, pthread_mach_thread_np(_thr_args.thread));
+
+    NSString *reportPath = [_tempPath stringByAppendingPathComponent: @"report.plcrash"];
+    int fd = open([reportPath fileSystemRepresentation], O_RDWR|O_CREAT|O_EXCL, 0644);
+    plcrash_async_file_init(&file, fd, 0);
+
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_init(&log_writer, @"test.id", @"1.0"), @"Initialization failed");
+    for (uint32_t i = 0; i < image_count; i++)
+        plcrash_log_writer_add_image(&log_writer, _dyld_get_image_header(i));
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_log_writer_write(&log_writer, pthread_mach_thread_np(_thr_args.thread), &file, &info, &thread_state.uap), @"Crash log failed");
+    plcrash_log_writer_close(&log_writer);
+    plcrash_log_writer_free(&log_writer);
+    plcrash_async_file_flush(&file);
+    plcrash_async_file_close(&file);
+
+    /* Symbolicate it repeatedly */
+    NSData *data = [NSData dataWithContentsOfFile: reportPath];
+    plcrash_report_decoder_t decoder;
+    STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_decoder_init(&decoder, [data bytes], [data length]), @"Could not decode report");
+
+    size_t buffer_size = 1024 * 1024;
+    char *buffer = malloc(buffer_size);
+    size_t frames = 0;
+    size_t symbolicated = 0;
+    start = mach_absolute_time();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        plcrash_report_text_writer_t writer;
+
+        plcrash_report_text_writer_init_buffer(&writer, buffer, buffer_size);
+        plcrash_report_text_writer_set_symbol_cache(&writer, &cache);
+        STAssertEquals(PLCRASH_ESUCCESS, plcrash_report_text_write(&writer, &decoder, PLCRASH_REPORT_TEXT_FORMAT_IOS), @"Could not write report");
+
+        frames += writer.frame_count;
+        symbolicated += writer.symbolicated_count;
+    }
+    uint64_t symbolicate_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    STAssertTrue(symbolicated > 0, @"No frames were symbolicated");
+    NSLog(@"Indexed %lu images in %llu ms; symbolicated %lu of %lu frames in %llu us (%.0f frames/s)",
+          (unsigned long) added, index_ns / 1000000, (unsigned long) symbolicated, (unsigned long) frames,
+          symbolicate_ns / 1000, symbolicate_ns > 0 ? frames / (symbolicate_ns / 1e9) : 0.0);
+
+    free(buffer);
+    plcrash_report_decoder_free(&decoder);
+    plcrash_symbol_cache_free(&cache);
+}
+
+@end
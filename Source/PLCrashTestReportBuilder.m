@@ -0,0 +1,129 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PLCrashTestReportBuilder.h"
+#import "CrashReporter.h"
+#import "PLCrashReportDecoder.h"
+
+/*
+ * Protobuf encoding helpers, used by the unit tests to build synthetic crash reports without going through
+ * the crash log writer.
+ */
+
+/* Return a version 1 crash report file header, to which the encoded report message may be appended */
+NSMutableData *plcrash_test_report_header (void) {
+    NSMutableData *report = [NSMutableData dataWithBytes: PLCRASH_REPORT_FILE_MAGIC length: strlen(PLCRASH_REPORT_FILE_MAGIC)];
+    uint8_t version = 1;
+    [report appendBytes: &version length: sizeof(version)];
+    return report;
+}
+
+/* Append a protobuf varint */
+void plcrash_test_append_varint (NSMutableData *data, uint64_t value) {
+    uint8_t buf[10];
+    size_t len = 0;
+
+    do {
+        buf[len] = value & 0x7F;
+        value >>= 7;
+        if (value != 0)
+            buf[len] |= 0x80;
+        len++;
+    } while (value != 0);
+
+    [data appendBytes: buf length: len];
+}
+
+/* Append a varint field */
+void plcrash_test_append_uint (NSMutableData *data, uint32_t number, uint64_t value) {
+    plcrash_test_append_varint(data, (number << 3) | 0);
+    plcrash_test_append_varint(data, value);
+}
+
+/* Append a length-delimited field */
+void plcrash_test_append_bytes (NSMutableData *data, uint32_t number, const void *bytes, size_t len) {
+    plcrash_test_append_varint(data, (number << 3) | 2);
+    plcrash_test_append_varint(data, len);
+    [data appendBytes: bytes length: len];
+}
+
+/* Append a string field */
+void plcrash_test_append_string (NSMutableData *data, uint32_t number, const char *string) {
+    plcrash_test_append_bytes(data, number, string, strlen(string));
+}
+
+/* Append an embedded message field */
+void plcrash_test_append_message (NSMutableData *data, uint32_t number, NSData *message) {
+    plcrash_test_append_bytes(data, number, [message bytes], [message length]);
+}
+
+/*
+ * Append the system info, application info, signal, and machine info sections required of every report, describing
+ * an iPhoneOS 4.2 ARMv6 device. The application is identified as @a identifier, and the crash as signal @a signal.
+ * If @a omit is non-zero, the given top-level field is left out. The caller appends the threads and images.
+ */
+void plcrash_test_append_report_info (NSMutableData *report, const char *identifier, const char *signal, uint32_t omit) {
+    NSMutableData *msg;
+
+    if (omit != PLCRASH_REPORT_FIELD_SYSTEM_INFO) {
+        msg = [NSMutableData data];
+        plcrash_test_append_uint(msg, 1, PLCrashReportOperatingSystemiPhoneOS);
+        plcrash_test_append_string(msg, 2, "4.2");
+        plcrash_test_append_uint(msg, 3, PLCrashReportArchitectureARMv6);
+        plcrash_test_append_uint(msg, 4, 1290000000);
+        plcrash_test_append_message(report, PLCRASH_REPORT_FIELD_SYSTEM_INFO, msg);
+    }
+
+    if (omit != PLCRASH_REPORT_FIELD_APP_INFO) {
+        msg = [NSMutableData data];
+        plcrash_test_append_string(msg, 1, identifier);
+        plcrash_test_append_string(msg, 2, "1.0");
+        plcrash_test_append_message(report, PLCRASH_REPORT_FIELD_APP_INFO, msg);
+    }
+
+    if (omit != PLCRASH_REPORT_FIELD_SIGNAL) {
+        msg = [NSMutableData data];
+        plcrash_test_append_string(msg, 1, signal);
+        plcrash_test_append_string(msg, 2, "SEGV_MAPERR");
+        plcrash_test_append_uint(msg, 3, 0);
+        plcrash_test_append_message(report, PLCRASH_REPORT_FIELD_SIGNAL, msg);
+    }
+
+    if (omit != PLCRASH_REPORT_FIELD_MACHINE_INFO) {
+        NSMutableData *processor = [NSMutableData data];
+        plcrash_test_append_uint(processor, 2, 12);
+        plcrash_test_append_uint(processor, 3, 6);
+
+        msg = [NSMutableData data];
+        plcrash_test_append_string(msg, 1, "iPhone1,2");
+        plcrash_test_append_message(msg, 2, processor);
+        plcrash_test_append_uint(msg, 3, 1);
+        plcrash_test_append_uint(msg, 4, 1);
+        plcrash_test_append_message(report, PLCRASH_REPORT_FIELD_MACHINE_INFO, msg);
+    }
+}
@@ -0,0 +1,268 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "bucket_command.h"
+#import "report_queue.h"
+#import "PLCrashReportDecoder.h"
+#import "PLCrashReportSignature.h"
+
+#import <stdio.h>
+#import <stdlib.h>
+#import <string.h>
+#import <getopt.h>
+#import <unistd.h>
+
+/*
+ * A single file's signature state.
+ */
+typedef struct bucket_file {
+    /* File path */
+    const char *path;
+
+    /* Non-zero if the file could not be read or decoded; error holds a description. */
+    int failed;
+
+    /* Description of the failure */
+    const char *error;
+
+    /* Crash signature */
+    uint64_t signature;
+} bucket_file_t;
+
+/*
+ * State shared by the worker threads.
+ */
+typedef struct bucket_queue {
+    /* All files, in input order */
+    bucket_file_t *files;
+
+    /* Number of files */
+    int32_t count;
+
+    /* Number of crashed thread frames included in each signature */
+    size_t frame_count;
+} bucket_queue_t;
+
+/*
+ * A bucket of files sharing a signature.
+ */
+typedef struct bucket {
+    /* Crash signature */
+    uint64_t signature;
+
+    /* Number of files */
+    int32_t count;
+
+    /* Index of the first file, in input order */
+    int32_t first;
+} bucket_t;
+
+/*
+ * Map a single file and compute its signature. The context is the bucket queue.
+ */
+static void bucket_file (void *context, int32_t index) {
+    bucket_queue_t *queue = context;
+    bucket_file_t *file = &queue->files[index];
+    void *mapped;
+    size_t len;
+    int errnum;
+
+    if ((errnum = report_queue_map_file(file->path, &mapped, &len)) != 0) {
+        file->failed = 1;
+        file->error = strerror(errnum);
+        return;
+    }
+
+    if (len == 0) {
+        file->failed = 1;
+        file->error = "Could not read file";
+        return;
+    }
+
+    /* Reports written with a summary header already carry their signature, and are not decoded further */
+    plcrash_report_decoder_t decoder;
+    if (plcrash_report_decoder_init(&decoder, mapped, len) != PLCRASH_ESUCCESS) {
+        file->failed = 1;
+        file->error = plcrash_report_decode_error_description(decoder.error);
+    } else {
+        plcrash_error_t err = plcrash_report_signature_compute(&decoder, queue->frame_count, &file->signature);
+        if (err != PLCRASH_ESUCCESS) {
+            file->failed = 1;
+            file->error = plcrash_strerror(err);
+        }
+    }
+
+    plcrash_report_decoder_free(&decoder);
+    report_queue_unmap_file(mapped, len);
+}
+
+/* Order file indices by signature, and then by input order. The context is the file array. */
+static const bucket_file_t *sort_files;
+
+static int compare_files (const void *a, const void *b) {
+    const bucket_file_t *fa = &sort_files[*(const int32_t *) a];
+    const bucket_file_t *fb = &sort_files[*(const int32_t *) b];
+
+    if (fa->signature != fb->signature)
+        return (fa->signature < fb->signature) ? -1 : 1;
+
+    return *(const int32_t *) a - *(const int32_t *) b;
+}
+
+/* Order buckets by descending size, and then by first appearance */
+static int compare_buckets (const void *a, const void *b) {
+    const bucket_t *ba = a;
+    const bucket_t *bb = b;
+
+    if (ba->count != bb->count)
+        return bb->count - ba->count;
+
+    return ba->first - bb->first;
+}
+
+/*
+ * Group one or more reports, or all reports within the given directories, by crash signature, using a pool of
+ * worker threads. Buckets are printed largest first, with the number of reports and the first report in each.
+ */
+int bucket_command (int argc, char *argv[]) {
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    long frames = PLCRASH_REPORT_SIGNATURE_FRAMES;
+    int ret = 0;
+
+    /* options descriptor */
+    static struct option longopts[] = {
+        { "jobs",       required_argument,      NULL,          'j' },
+        { "frames",     required_argument,      NULL,          'f' },
+        { NULL,         0,                      NULL,           0 }
+    };
+
+    /* Read the options */
+    int ch;
+    while ((ch = getopt_long(argc, argv, "j:f:", longopts, NULL)) != -1) {
+        switch (ch) {
+            case 'j':
+                jobs = strtol(optarg, NULL, 10);
+                if (jobs < 1) {
+                    fprintf(stderr, "Invalid job count: %s\n", optarg);
+                    [pool release];
+                    return 1;
+                }
+                break;
+            case 'f':
+                frames = strtol(optarg, NULL, 10);
+                if (frames < 0) {
+                    fprintf(stderr, "Invalid frame count: %s\n", optarg);
+                    [pool release];
+                    return 1;
+                }
+                break;
+            default:
+                [pool release];
+                return 1;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1) {
+        fprintf(stderr, "No input file supplied\n");
+        [pool release];
+        return 1;
+    }
+
+    /* Gather the input files */
+    NSMutableArray *paths = [NSMutableArray array];
+    for (int i = 0; i < argc; i++)
+        report_queue_collect_paths(paths, [NSString stringWithUTF8String: argv[i]]);
+
+    bucket_queue_t queue;
+    queue.count = (int32_t) [paths count];
+    queue.frame_count = (size_t) frames;
+    queue.files = calloc(queue.count > 0 ? queue.count : 1, sizeof(bucket_file_t));
+    int32_t *order = calloc(queue.count > 0 ? queue.count : 1, sizeof(int32_t));
+    bucket_t *buckets = calloc(queue.count > 0 ? queue.count : 1, sizeof(bucket_t));
+    if (queue.files == NULL || order == NULL || buckets == NULL) {
+        fprintf(stderr, "Could not allocate file list\n");
+        free(queue.files);
+        free(order);
+        free(buckets);
+        [pool release];
+        return 1;
+    }
+
+    for (int32_t i = 0; i < queue.count; i++)
+        queue.files[i].path = [[paths objectAtIndex: i] fileSystemRepresentation];
+
+    /* Compute signatures */
+    report_queue_run(queue.count, jobs, bucket_file, &queue);
+
+    /* Group the readable files by signature */
+    int32_t valid = 0;
+    for (int32_t i = 0; i < queue.count; i++) {
+        if (queue.files[i].failed) {
+            fprintf(stderr, "%s: %s\n", queue.files[i].path, queue.files[i].error);
+            ret = 1;
+            continue;
+        }
+
+        order[valid++] = i;
+    }
+
+    sort_files = queue.files;
+    qsort(order, valid, sizeof(int32_t), compare_files);
+
+    int32_t bucket_count = 0;
+    for (int32_t i = 0; i < valid; i++) {
+        const bucket_file_t *file = &queue.files[order[i]];
+        if (bucket_count == 0 || buckets[bucket_count - 1].signature != file->signature) {
+            buckets[bucket_count].signature = file->signature;
+            buckets[bucket_count].first = order[i];
+            bucket_count++;
+        }
+
+        buckets[bucket_count - 1].count++;
+    }
+
+    /* Report */
+    qsort(buckets, bucket_count, sizeof(bucket_t), compare_buckets);
+    for (int32_t i = 0; i < bucket_count; i++) {
+        fprintf(stdout, "%016llx\t%d\t%s\n", (unsigned long long) buckets[i].signature, buckets[i].count,
+                queue.files[buckets[i].first].path);
+    }
+
+    fprintf(stdout, "%d reports in %d buckets\n", valid, bucket_count);
+
+    free(buckets);
+    free(order);
+    free(queue.files);
+    [pool release];
+    return ret;
+}
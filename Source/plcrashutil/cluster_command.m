@@ -0,0 +1,300 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "cluster_command.h"
+#import "report_queue.h"
+#import "PLCrashReportDecoder.h"
+#import "PLCrashReportCluster.h"
+
+#import <stdio.h>
+#import <stdlib.h>
+#import <string.h>
+#import <getopt.h>
+#import <unistd.h>
+
+/*
+ * A single file's state.
+ */
+typedef struct cluster_file {
+    /* File path */
+    const char *path;
+
+    /* Non-zero if the file could not be read or decoded; error holds a description. */
+    int failed;
+
+    /* Description of the failure */
+    const char *error;
+} cluster_file_t;
+
+/*
+ * State shared by the worker threads.
+ */
+typedef struct cluster_queue {
+    /* All files, in input order */
+    cluster_file_t *files;
+
+    /* Number of files */
+    int32_t count;
+
+    /* Clustering state */
+    plcrash_report_cluster_t cluster;
+} cluster_queue_t;
+
+/*
+ * Map a single file and record its sketch. The context is the cluster queue.
+ */
+static void cluster_file (void *context, int32_t index) {
+    cluster_queue_t *queue = context;
+    cluster_file_t *file = &queue->files[index];
+    void *mapped;
+    size_t len;
+    int errnum;
+
+    if ((errnum = report_queue_map_file(file->path, &mapped, &len)) != 0) {
+        file->failed = 1;
+        file->error = strerror(errnum);
+        return;
+    }
+
+    if (len == 0) {
+        file->failed = 1;
+        file->error = "Could not read file";
+        return;
+    }
+
+    plcrash_report_decoder_t decoder;
+    if (plcrash_report_decoder_init(&decoder, mapped, len) != PLCRASH_ESUCCESS) {
+        file->failed = 1;
+        file->error = plcrash_report_decode_error_description(decoder.error);
+    } else {
+        plcrash_error_t err = plcrash_report_cluster_add(&queue->cluster, index, &decoder);
+        if (err != PLCRASH_ESUCCESS) {
+            file->failed = 1;
+            file->error = plcrash_strerror(err);
+        }
+    }
+
+    plcrash_report_decoder_free(&decoder);
+    report_queue_unmap_file(mapped, len);
+}
+
+/*
+ * Group the sketched reports that share a single LSH band. The context is the cluster queue.
+ */
+static void cluster_band (void *context, int32_t band) {
+    cluster_queue_t *queue = context;
+
+    if (plcrash_report_cluster_band(&queue->cluster, band) != PLCRASH_ESUCCESS)
+        fprintf(stderr, "Could not process band %d: out of memory\n", band);
+}
+
+/*
+ * A cluster, identified by its lowest file index.
+ */
+typedef struct cluster_group {
+    /* Index of the first file */
+    int32_t first;
+
+    /* Number of files */
+    int32_t count;
+} cluster_group_t;
+
+/* Order clusters by descending size, and then by first appearance */
+static int compare_groups (const void *a, const void *b) {
+    const cluster_group_t *ga = a;
+    const cluster_group_t *gb = b;
+
+    if (ga->count != gb->count)
+        return gb->count - ga->count;
+
+    return ga->first - gb->first;
+}
+
+/*
+ * Group one or more reports, or all reports within the given directories, into clusters of near-duplicate crashes,
+ * using a pool of worker threads. Clusters are printed largest first, with the number of reports and the first
+ * report in each, and optionally every member.
+ */
+int cluster_command (int argc, char *argv[]) {
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    plcrash_report_cluster_config_t config;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int members = 0;
+    int ret = 0;
+
+    plcrash_report_cluster_config_init(&config);
+
+    /* options descriptor */
+    static struct option longopts[] = {
+        { "jobs",       required_argument,      NULL,          'j' },
+        { "bands",      required_argument,      NULL,          'b' },
+        { "rows",       required_argument,      NULL,          'r' },
+        { "frames",     required_argument,      NULL,          'f' },
+        { "threshold",  required_argument,      NULL,          't' },
+        { "members",    no_argument,            NULL,          'm' },
+        { NULL,         0,                      NULL,           0 }
+    };
+
+    /* Read the options */
+    int ch;
+    while ((ch = getopt_long(argc, argv, "j:b:r:f:t:m", longopts, NULL)) != -1) {
+        switch (ch) {
+            case 'j':
+                jobs = strtol(optarg, NULL, 10);
+                if (jobs < 1) {
+                    fprintf(stderr, "Invalid job count: %s\n", optarg);
+                    [pool release];
+                    return 1;
+                }
+                break;
+            case 'b':
+                config.bands = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                config.rows = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                config.frames = (uint32_t) strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                config.threshold = strtod(optarg, NULL);
+                break;
+            case 'm':
+                members = 1;
+                break;
+            default:
+                [pool release];
+                return 1;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1) {
+        fprintf(stderr, "No input file supplied\n");
+        [pool release];
+        return 1;
+    }
+
+    /* Gather the input files */
+    NSMutableArray *paths = [NSMutableArray array];
+    for (int i = 0; i < argc; i++)
+        report_queue_collect_paths(paths, [NSString stringWithUTF8String: argv[i]]);
+
+    cluster_queue_t queue;
+    queue.count = (int32_t) [paths count];
+
+    plcrash_error_t err = plcrash_report_cluster_init(&queue.cluster, &config, queue.count);
+    if (err != PLCRASH_ESUCCESS) {
+        if (err == PLCRASH_EINVAL) {
+            fprintf(stderr, "Invalid band configuration: bands * rows must be between 1 and %d\n", PLCRASH_REPORT_MINHASH_MAX);
+        } else {
+            fprintf(stderr, "Could not allocate cluster state\n");
+        }
+        [pool release];
+        return 1;
+    }
+
+    queue.files = calloc(queue.count > 0 ? queue.count : 1, sizeof(cluster_file_t));
+    int32_t *counts = calloc(queue.count > 0 ? queue.count : 1, sizeof(int32_t));
+    int32_t *order = calloc(queue.count > 0 ? queue.count : 1, sizeof(int32_t));
+    cluster_group_t *groups = calloc(queue.count > 0 ? queue.count : 1, sizeof(cluster_group_t));
+    if (queue.files == NULL || counts == NULL || order == NULL || groups == NULL) {
+        fprintf(stderr, "Could not allocate file list\n");
+        ret = 1;
+        goto cleanup;
+    }
+
+    for (int32_t i = 0; i < queue.count; i++)
+        queue.files[i].path = [[paths objectAtIndex: i] fileSystemRepresentation];
+
+    /* Compute each report's sketch, and then group reports sharing a band, with each worker processing one band
+     * at a time */
+    report_queue_run(queue.count, jobs, cluster_file, &queue);
+    report_queue_run((int32_t) config.bands, jobs, cluster_band, &queue);
+
+    /* Count the members of each cluster, omitting unreadable files */
+    int32_t valid = 0;
+    for (int32_t i = 0; i < queue.count; i++) {
+        if (queue.files[i].failed) {
+            fprintf(stderr, "%s: %s\n", queue.files[i].path, queue.files[i].error);
+            ret = 1;
+            continue;
+        }
+
+        counts[plcrash_report_cluster_find(&queue.cluster, i)]++;
+        valid++;
+    }
+
+    /* Order the members by cluster; each cluster's members are stored from the offset of its first member */
+    int32_t group_count = 0;
+    int32_t offset = 0;
+    for (int32_t i = 0; i < queue.count; i++) {
+        if (counts[i] == 0)
+            continue;
+
+        groups[group_count].first = i;
+        groups[group_count].count = counts[i];
+        group_count++;
+
+        int32_t count = counts[i];
+        counts[i] = offset;
+        offset += count;
+    }
+
+    for (int32_t i = 0; i < queue.count; i++) {
+        if (!queue.files[i].failed)
+            order[counts[plcrash_report_cluster_find(&queue.cluster, i)]++] = i;
+    }
+
+    /* Report */
+    qsort(groups, group_count, sizeof(cluster_group_t), compare_groups);
+    for (int32_t i = 0; i < group_count; i++) {
+        fprintf(stdout, "%d\t%d\t%s\n", i + 1, groups[i].count, queue.files[groups[i].first].path);
+
+        if (members) {
+            /* The cluster's members end at its (advanced) offset */
+            int32_t end = counts[groups[i].first];
+            for (int32_t m = end - groups[i].count; m < end; m++)
+                fprintf(stdout, "\t%s\n", queue.files[order[m]].path);
+        }
+    }
+
+    fprintf(stdout, "%d reports in %d clusters\n", valid, group_count);
+
+cleanup:
+    free(groups);
+    free(order);
+    free(counts);
+    free(queue.files);
+    plcrash_report_cluster_free(&queue.cluster);
+    [pool release];
+    return ret;
+}
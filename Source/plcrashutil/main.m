@@ -29,6 +29,12 @@
 #import <Foundation/Foundation.h>
 #import <CrashReporter/CrashReporter.h>
 
+#import "bucket_command.h"
+#import "cluster_command.h"
+#import "scan_command.h"
+#import "symbolicate_command.h"
+#import "validate_command.h"
+
 #import <stdlib.h>
 #import <stdio.h>
 #import <getopt.h>
@@ -39,11 +45,36 @@
 void print_usage () {
     fprintf(stderr, "Usage: plcrashutil <command> <options>\n"
                     "Commands:\n"
+                    "  bucket [--jobs=<count>] [--frames=<count>] <file or directory> ...\n"
+                    "      Group plcrash files by crash signature: the signal, exception name, and the\n"
+                    "      image UUID and offset of the crashed thread's top frames. Prints each bucket's\n"
+                    "      signature, report count, and first report, largest bucket first. Directories\n"
+                    "      are searched for .plcrash files, which are processed in parallel.\n\n"
+                    "  cluster [--jobs=<count>] [--bands=<count>] [--rows=<count>] [--frames=<count>]\n"
+                    "          [--threshold=<similarity>] [--members] <file or directory> ...\n"
+                    "      Group plcrash files whose crashed thread stacks are near-duplicates, comparing\n"
+                    "      MinHash sketches of their (image, symbol or offset) frames. Prints each cluster's\n"
+                    "      report count and first report, largest cluster first, and optionally every\n"
+                    "      member. Directories are searched for .plcrash files.\n\n"
                     "  convert --format=<format> <file>\n"
                     "      Covert a plcrash file to the given format.\n\n"
                     "      Supported formats:\n"
                     "        ios - Standard Apple iOS-compatible text crash log\n"
-                    "        iphone - Synonym for 'iOS'.\n");
+                    "        iphone - Synonym for 'iOS'.\n\n"
+                    "  scan <file> ...\n"
+                    "      Print a one-line, tab-separated summary of each plcrash file.\n\n"
+                    "  symbolicate [--symbols=<binary or dSYM>] ... [--cache=<dir>] [--jobs=<count>]\n"
+                    "              [--max-images=<count>] [--stats] <file> ...\n"
+                    "      Convert each plcrash file to an iOS-compatible text crash log, symbolicating\n"
+                    "      stack frames. Symbol indexes are built from the given binaries and dSYM\n"
+                    "      bundles, and are cached by image UUID for use by later runs. Frames are\n"
+                    "      annotated with their source file and line if DWARF line information is\n"
+                    "      available. Reports are symbolicated in parallel; at most --max-images\n"
+                    "      images' symbols are held in memory at once.\n\n"
+                    "  validate [--jobs=<count>] [--quiet] <file or directory> ...\n"
+                    "      Check the structure of each plcrash file, reporting the location of the first\n"
+                    "      error found. Directories are searched for .plcrash files, which are validated\n"
+                    "      in parallel.\n");
 }
 
 /*
@@ -128,6 +159,16 @@ int main (int argc, char *argv[]) {
     /* Convert command */
     if (strcmp(argv[1], "convert") == 0) {
         ret = convert_command(argc - 2, argv + 2);
+    } else if (strcmp(argv[1], "bucket") == 0) {
+        ret = bucket_command(argc - 1, argv + 1);
+    } else if (strcmp(argv[1], "cluster") == 0) {
+        ret = cluster_command(argc - 1, argv + 1);
+    } else if (strcmp(argv[1], "scan") == 0) {
+        ret = scan_command(argc - 2, argv + 2);
+    } else if (strcmp(argv[1], "symbolicate") == 0) {
+        ret = symbolicate_command(argc - 1, argv + 1);
+    } else if (strcmp(argv[1], "validate") == 0) {
+        ret = validate_command(argc - 1, argv + 1);
     } else {
         print_usage();
         ret = 1;
@@ -0,0 +1,55 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Upper bound on the number of worker threads */
+#define REPORT_QUEUE_MAX_JOBS 64
+
+/* Crash report file extension, used when enumerating directories */
+#define REPORT_QUEUE_EXTENSION @"plcrash"
+
+/*
+ * Work function invoked by report_queue_run() on a worker thread, once for each index.
+ */
+typedef void (*report_queue_fn) (void *context, int32_t index);
+
+void report_queue_collect_paths (NSMutableArray *paths, NSString *path);
+
+int report_queue_map_file (const char *path, void **data, size_t *len);
+void report_queue_unmap_file (void *data, size_t len);
+
+void report_queue_run (int32_t count, long jobs, report_queue_fn fn, void *context);
+
+#ifdef __cplusplus
+}
+#endif
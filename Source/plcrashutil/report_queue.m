@@ -0,0 +1,169 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "report_queue.h"
+
+#import <errno.h>
+#import <fcntl.h>
+#import <pthread.h>
+#import <unistd.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <libkern/OSAtomic.h>
+
+/*
+ * State shared by the worker threads of a single report_queue_run().
+ */
+typedef struct report_queue {
+    /* Number of items */
+    int32_t count;
+
+    /* Index of the next item to be claimed by a worker */
+    volatile int32_t next;
+
+    /* Work function, and its context */
+    report_queue_fn fn;
+    void *context;
+} report_queue_t;
+
+/*
+ * Append @a path to @a paths. If @a path is a directory, all crash report files beneath it are appended instead,
+ * in a stable order.
+ */
+void report_queue_collect_paths (NSMutableArray *paths, NSString *path) {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    BOOL isDirectory;
+
+    if (![fileManager fileExistsAtPath: path isDirectory: &isDirectory] || !isDirectory) {
+        [paths addObject: path];
+        return;
+    }
+
+    NSDirectoryEnumerator *enumerator = [fileManager enumeratorAtPath: path];
+    NSMutableArray *found = [NSMutableArray array];
+    NSString *file;
+    while ((file = [enumerator nextObject]) != nil) {
+        if ([[file pathExtension] isEqualToString: REPORT_QUEUE_EXTENSION])
+            [found addObject: [path stringByAppendingPathComponent: file]];
+    }
+
+    /* Report in a stable order */
+    [paths addObjectsFromArray: [found sortedArrayUsingSelector: @selector(compare:)]];
+}
+
+/*
+ * Map the file at @a path read-only. An empty file can't be mapped; it is returned with a NULL @a data and a zero
+ * @a len. Returns 0 on success, or an errno value on failure. The mapping must be released with
+ * report_queue_unmap_file().
+ */
+int report_queue_map_file (const char *path, void **data, size_t *len) {
+    struct stat statbuf;
+    int fd;
+
+    *data = NULL;
+    *len = 0;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return errno;
+
+    if (fstat(fd, &statbuf) != 0) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+
+    if (statbuf.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void *mapped = mmap(NULL, (size_t) statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+    close(fd);
+
+    *data = mapped;
+    *len = (size_t) statbuf.st_size;
+    return 0;
+}
+
+/*
+ * Release a mapping returned by report_queue_map_file().
+ */
+void report_queue_unmap_file (void *data, size_t len) {
+    if (len > 0)
+        munmap(data, len);
+}
+
+/*
+ * Worker thread entry point. Claims items until the queue is exhausted.
+ */
+static void *report_queue_worker (void *arg) {
+    report_queue_t *queue = arg;
+    int32_t index;
+
+    while ((index = OSAtomicIncrement32Barrier(&queue->next) - 1) < queue->count)
+        queue->fn(queue->context, index);
+
+    return NULL;
+}
+
+/*
+ * Call @a fn for every index in [0, @a count), using a pool of up to @a jobs worker threads that each claim the
+ * next unprocessed index. Returns once every index has been processed. If no worker threads can be started, the
+ * work is performed on the calling thread.
+ */
+void report_queue_run (int32_t count, long jobs, report_queue_fn fn, void *context) {
+    pthread_t threads[REPORT_QUEUE_MAX_JOBS];
+    report_queue_t queue;
+    long started = 0;
+
+    queue.count = count;
+    queue.next = 0;
+    queue.fn = fn;
+    queue.context = context;
+
+    if (jobs > REPORT_QUEUE_MAX_JOBS)
+        jobs = REPORT_QUEUE_MAX_JOBS;
+    if (jobs > count)
+        jobs = count;
+
+    for (; started < jobs; started++) {
+        if (pthread_create(&threads[started], NULL, report_queue_worker, &queue) != 0)
+            break;
+    }
+
+    if (started == 0)
+        report_queue_worker(&queue);
+
+    for (long i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+}
@@ -0,0 +1,152 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2008-2010 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "scan_command.h"
+#import "PLCrashReportView.hpp"
+
+#import <stdio.h>
+#import <string.h>
+#import <errno.h>
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+
+using namespace plcrash;
+
+/* Maximum number of crashed thread frames to print */
+#define SCAN_FRAME_COUNT 5
+
+/* Write a string reference, without its trailing NUL */
+static void print_string (FILE *output, StringRef str) {
+    fwrite(str.data(), 1, str.size(), output);
+}
+
+/*
+ * Print a single tab-separated summary line for the report at @a path:
+ *
+ *   path  app-id  app-version  signal  code  crashed-thread  frame...
+ *
+ * Frames are printed as image+offset where the image is known, or as an absolute address otherwise.
+ */
+static int scan_file (FILE *output, const char *path) {
+    struct stat statbuf;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    if (fstat(fd, &statbuf) != 0 || statbuf.st_size == 0) {
+        fprintf(stderr, "Could not read %s\n", path);
+        close(fd);
+        return 1;
+    }
+
+    void *mapped = mmap(NULL, (size_t) statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        fprintf(stderr, "Could not map %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    int ret = 0;
+    ReportView view(ByteRange((const uint8_t *) mapped, (size_t) statbuf.st_size));
+    if (!view.valid()) {
+        fprintf(stderr, "Could not decode crash log: %s\n", path);
+        ret = 1;
+        goto cleanup;
+    }
+
+    fprintf(output, "%s\t", path);
+    print_string(output, view.application_info().identifier());
+    fputc('\t', output);
+    print_string(output, view.application_info().version());
+    fputc('\t', output);
+    print_string(output, view.signal().name());
+    fputc('\t', output);
+    print_string(output, view.signal().code());
+
+    {
+        ThreadView thread;
+        if (!view.crashed_thread(thread)) {
+            fprintf(output, "\t-\n");
+            goto cleanup;
+        }
+
+        fprintf(output, "\t%u", thread.number());
+
+        ThreadView::FrameRange frames = thread.frames();
+        unsigned int count = 0;
+        for (ThreadView::FrameRange::iterator f = frames.begin(); f != frames.end() && count < SCAN_FRAME_COUNT; ++f, ++count) {
+            uint64_t pc = (*f).pc();
+            ImageView image;
+
+            fputc('\t', output);
+            if (view.image_for_address(pc, image)) {
+                /* Print the image's file name, rather than its full path */
+                StringRef name = image.name();
+                const char *base = name.data();
+                for (const char *p = name.begin(); p != name.end(); p++) {
+                    if (*p == '/')
+                        base = p + 1;
+                }
+
+                fwrite(base, 1, name.end() - base, output);
+                fprintf(output, "+0x%llx", (unsigned long long) (pc - image.base_address()));
+            } else {
+                fprintf(output, "0x%llx", (unsigned long long) pc);
+            }
+        }
+        fputc('\n', output);
+    }
+
+cleanup:
+    munmap(mapped, (size_t) statbuf.st_size);
+    return ret;
+}
+
+/*
+ * Scan one or more reports, printing a summary line for each.
+ */
+int scan_command (int argc, char *argv[]) {
+    int ret = 0;
+
+    if (argc < 1) {
+        fprintf(stderr, "No input file supplied\n");
+        return 1;
+    }
+
+    for (int i = 0; i < argc; i++) {
+        if (scan_file(stdout, argv[i]) != 0)
+            ret = 1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,367 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "symbolicate_command.h"
+#import "PLCrashReportTextWriter.h"
+#import "PLCrashSymbolCache.h"
+
+#import <stdio.h>
+#import <stdlib.h>
+#import <string.h>
+#import <errno.h>
+#import <fcntl.h>
+#import <getopt.h>
+#import <pthread.h>
+#import <unistd.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <mach/mach_time.h>
+#import <libkern/OSAtomic.h>
+
+/* Default cache directory, relative to the user's caches directory */
+#define SYMBOLICATE_CACHE_PATH @"PLCrashReporter/Symbols"
+
+/* Upper bound on the number of worker threads */
+#define SYMBOLICATE_MAX_JOBS 64
+
+/*
+ * A single report's symbolication state.
+ */
+typedef struct symbolicate_job {
+    /* Report path */
+    const char *path;
+
+    /* Temporary file holding the formatted report, or NULL if none could be created */
+    FILE *output;
+
+    /* Non-zero if the report could not be symbolicated */
+    int failed;
+
+    /* Number of frames written */
+    size_t frames;
+
+    /* Number of frames symbolicated */
+    size_t symbolicated;
+} symbolicate_job_t;
+
+/*
+ * State shared by the worker threads.
+ */
+typedef struct symbolicate_queue {
+    /* The shared symbol cache */
+    plcrash_symbol_cache_t *cache;
+
+    /* All reports, in input order */
+    symbolicate_job_t *jobs;
+
+    /* Number of reports */
+    int32_t count;
+
+    /* Index of the next report to be claimed by a worker */
+    volatile int32_t next;
+} symbolicate_queue_t;
+
+/*
+ * Format a single report with symbolication, writing the result to @a fd and adding its frame counts to
+ * @a frames and @a symbolicated.
+ */
+static int symbolicate_file (int fd, plcrash_symbol_cache_t *cache, const char *path, size_t *frames, size_t *symbolicated) {
+    struct stat statbuf;
+    int input;
+
+    if ((input = open(path, O_RDONLY)) < 0) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    if (fstat(input, &statbuf) != 0 || statbuf.st_size == 0) {
+        fprintf(stderr, "Could not read %s\n", path);
+        close(input);
+        return 1;
+    }
+
+    void *mapped = mmap(NULL, (size_t) statbuf.st_size, PROT_READ, MAP_PRIVATE, input, 0);
+    close(input);
+    if (mapped == MAP_FAILED) {
+        fprintf(stderr, "Could not map %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    plcrash_report_decoder_t decoder;
+    plcrash_report_text_writer_t writer;
+    int ret = 0;
+
+    if (plcrash_report_decoder_init(&decoder, mapped, (size_t) statbuf.st_size) != PLCRASH_ESUCCESS) {
+        fprintf(stderr, "Could not decode crash log %s: %s\n", path, plcrash_report_decode_error_description(decoder.error));
+        ret = 1;
+    } else {
+        plcrash_report_text_writer_init_fd(&writer, fd);
+        plcrash_report_text_writer_set_symbol_cache(&writer, cache);
+
+        plcrash_error_t err = plcrash_report_text_write(&writer, &decoder, PLCRASH_REPORT_TEXT_FORMAT_IOS);
+        if (err != PLCRASH_ESUCCESS) {
+            fprintf(stderr, "Could not format crash log %s: %s\n", path, plcrash_strerror(err));
+            ret = 1;
+        }
+
+        *frames += writer.frame_count;
+        *symbolicated += writer.symbolicated_count;
+    }
+
+    plcrash_report_decoder_free(&decoder);
+    munmap(mapped, (size_t) statbuf.st_size);
+    return ret;
+}
+
+/*
+ * Worker thread entry point. Claims and symbolicates reports until the queue is exhausted, formatting each into a
+ * temporary file.
+ */
+static void *symbolicate_worker (void *arg) {
+    symbolicate_queue_t *queue = arg;
+    int32_t index;
+
+    while ((index = OSAtomicIncrement32Barrier(&queue->next) - 1) < queue->count) {
+        symbolicate_job_t *job = &queue->jobs[index];
+
+        if ((job->output = tmpfile()) == NULL) {
+            fprintf(stderr, "Could not create temporary file for %s: %s\n", job->path, strerror(errno));
+            job->failed = 1;
+            continue;
+        }
+
+        job->failed = symbolicate_file(fileno(job->output), queue->cache, job->path, &job->frames, &job->symbolicated);
+    }
+
+    return NULL;
+}
+
+/*
+ * Copy the contents of @a input to @a output. Returns non-zero on failure.
+ */
+static int copy_output (FILE *input, FILE *output) {
+    char buffer[16 * 1024];
+    size_t len;
+
+    rewind(input);
+    while ((len = fread(buffer, 1, sizeof(buffer), input)) > 0) {
+        if (fwrite(buffer, 1, len, output) != len)
+            return 1;
+    }
+
+    return ferror(input) ? 1 : 0;
+}
+
+/*
+ * Symbolicate and format one or more reports, using symbol indexes built from the given binaries and dSYM bundles.
+ * Indexes are cached by image UUID, and are reused by later runs. Reports are symbolicated in parallel, sharing a
+ * single cache, and are written in input order.
+ */
+int symbolicate_command (int argc, char *argv[]) {
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    NSMutableArray *symbolPaths = [NSMutableArray array];
+    NSString *cachePath = nil;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    long maxImages = PLCRASH_SYMBOL_CACHE_DEFAULT_MAPPED_LIMIT;
+    int stats = 0;
+    int ret = 0;
+
+    /* options descriptor */
+    static struct option longopts[] = {
+        { "cache",      required_argument,      NULL,          'c' },
+        { "jobs",       required_argument,      NULL,          'j' },
+        { "max-images", required_argument,      NULL,          'm' },
+        { "symbols",    required_argument,      NULL,          's' },
+        { "stats",      no_argument,            NULL,          't' },
+        { NULL,         0,                      NULL,           0 }
+    };
+
+    /* Read the options */
+    int ch;
+    while ((ch = getopt_long(argc, argv, "c:j:m:s:t", longopts, NULL)) != -1) {
+        switch (ch) {
+            case 'c':
+                cachePath = [NSString stringWithUTF8String: optarg];
+                break;
+            case 'j':
+                jobs = strtol(optarg, NULL, 10);
+                if (jobs < 1) {
+                    fprintf(stderr, "Invalid job count: %s\n", optarg);
+                    [pool release];
+                    return 1;
+                }
+                break;
+            case 'm':
+                maxImages = strtol(optarg, NULL, 10);
+                if (maxImages < 1) {
+                    fprintf(stderr, "Invalid image count: %s\n", optarg);
+                    [pool release];
+                    return 1;
+                }
+                break;
+            case 's':
+                [symbolPaths addObject: [NSString stringWithUTF8String: optarg]];
+                break;
+            case 't':
+                stats = 1;
+                break;
+            default:
+                [pool release];
+                return 1;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1 && [symbolPaths count] == 0) {
+        fprintf(stderr, "No input file supplied\n");
+        [pool release];
+        return 1;
+    }
+
+    /* Open the cache */
+    if (cachePath == nil) {
+        NSArray *caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+        if ([caches count] == 0) {
+            fprintf(stderr, "Could not locate the user's caches directory; specify --cache\n");
+            [pool release];
+            return 1;
+        }
+
+        cachePath = [[caches objectAtIndex: 0] stringByAppendingPathComponent: SYMBOLICATE_CACHE_PATH];
+        [[NSFileManager defaultManager] createDirectoryAtPath: [cachePath stringByDeletingLastPathComponent]
+                                  withIntermediateDirectories: YES attributes: nil error: NULL];
+    }
+
+    plcrash_symbol_cache_t cache;
+    plcrash_error_t err = plcrash_symbol_cache_init(&cache, [cachePath fileSystemRepresentation]);
+    if (err != PLCRASH_ESUCCESS) {
+        fprintf(stderr, "Could not open symbol cache %s: %s\n", [cachePath fileSystemRepresentation], plcrash_strerror(err));
+        [pool release];
+        return 1;
+    }
+    cache.mapped_limit = (size_t) maxImages;
+
+    /* Index the supplied symbols */
+    size_t added = 0;
+    for (NSString *path in symbolPaths) {
+        err = plcrash_symbol_cache_add(&cache, [path fileSystemRepresentation], &added);
+        if (err == PLCRASH_EINVAL) {
+            fprintf(stderr, "Not a Mach-O binary or dSYM bundle: %s\n", [path fileSystemRepresentation]);
+            ret = 1;
+        } else if (err != PLCRASH_ESUCCESS) {
+            fprintf(stderr, "Could not index %s: %s\n", [path fileSystemRepresentation], plcrash_strerror(err));
+            ret = 1;
+        }
+    }
+
+    /* Symbolicate */
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+
+    size_t frames = 0;
+    size_t symbolicated = 0;
+    uint64_t start = mach_absolute_time();
+
+    if (jobs > SYMBOLICATE_MAX_JOBS)
+        jobs = SYMBOLICATE_MAX_JOBS;
+    if (jobs > argc)
+        jobs = argc;
+
+    if (jobs <= 1) {
+        /* Write directly to the output */
+        for (int i = 0; i < argc; i++) {
+            if (symbolicate_file(STDOUT_FILENO, &cache, argv[i], &frames, &symbolicated) != 0)
+                ret = 1;
+        }
+    } else {
+        symbolicate_queue_t queue;
+        queue.cache = &cache;
+        queue.count = argc;
+        queue.next = 0;
+        queue.jobs = calloc(argc, sizeof(symbolicate_job_t));
+        if (queue.jobs == NULL) {
+            fprintf(stderr, "Could not allocate report list\n");
+            plcrash_symbol_cache_free(&cache);
+            [pool release];
+            return 1;
+        }
+
+        for (int i = 0; i < argc; i++)
+            queue.jobs[i].path = argv[i];
+
+        pthread_t threads[SYMBOLICATE_MAX_JOBS];
+        long started = 0;
+        for (; started < jobs; started++) {
+            if (pthread_create(&threads[started], NULL, symbolicate_worker, &queue) != 0)
+                break;
+        }
+
+        /* If no workers could be started, symbolicate on this thread */
+        if (started == 0)
+            symbolicate_worker(&queue);
+
+        for (long i = 0; i < started; i++)
+            pthread_join(threads[i], NULL);
+
+        /* Write the reports in input order */
+        fflush(stdout);
+        for (int i = 0; i < argc; i++) {
+            symbolicate_job_t *job = &queue.jobs[i];
+
+            if (job->output != NULL) {
+                if (copy_output(job->output, stdout) != 0) {
+                    fprintf(stderr, "Could not write report %s\n", job->path);
+                    job->failed = 1;
+                }
+                fclose(job->output);
+            }
+
+            if (job->failed)
+                ret = 1;
+
+            frames += job->frames;
+            symbolicated += job->symbolicated;
+        }
+        fflush(stdout);
+
+        free(queue.jobs);
+    }
+    uint64_t elapsed_ns = (mach_absolute_time() - start) * timebase.numer / timebase.denom;
+
+    if (stats) {
+        fprintf(stderr, "%zu indexes built, %d reports, %zu of %zu frames symbolicated in %.3f s (%.0f frames/s)\n",
+                added, argc, symbolicated, frames, elapsed_ns / 1e9, elapsed_ns > 0 ? frames / (elapsed_ns / 1e9) : 0.0);
+    }
+
+    plcrash_symbol_cache_free(&cache);
+    [pool release];
+    return ret;
+}
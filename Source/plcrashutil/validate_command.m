@@ -0,0 +1,184 @@
+/*
+ * Author: Landon Fuller <landonf@plausiblelabs.com>
+ *
+ * Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "validate_command.h"
+#import "report_queue.h"
+#import "PLCrashReportValidator.h"
+
+#import <stdio.h>
+#import <stdlib.h>
+#import <string.h>
+#import <getopt.h>
+#import <unistd.h>
+
+/*
+ * A single file's validation state.
+ */
+typedef struct validate_file {
+    /* File path */
+    const char *path;
+
+    /* Non-zero if the file could not be read; errno_value holds the error. */
+    int read_failed;
+
+    /* The errno value of a failed read */
+    int errno_value;
+
+    /* Validation result */
+    plcrash_report_validation_t result;
+} validate_file_t;
+
+/*
+ * Map and validate a single file. The context is the file array.
+ */
+static void validate_file (void *context, int32_t index) {
+    validate_file_t *file = &((validate_file_t *) context)[index];
+    void *mapped;
+    size_t len;
+    int err;
+
+    if ((err = report_queue_map_file(file->path, &mapped, &len)) != 0) {
+        file->read_failed = 1;
+        file->errno_value = err;
+        return;
+    }
+
+    /* An empty file can't be mapped; validate it as an empty report */
+    plcrash_report_validate(len > 0 ? mapped : "", len, &file->result);
+    report_queue_unmap_file(mapped, len);
+}
+
+/*
+ * Print the result for a single file. Returns non-zero if the file is invalid.
+ */
+static int print_result (FILE *output, const validate_file_t *file, int quiet) {
+    if (file->read_failed) {
+        fprintf(output, "%s: Could not read file: %s\n", file->path, strerror(file->errno_value));
+        return 1;
+    }
+
+    if (file->result.code == PLCRASH_REPORT_VALIDATION_OK) {
+        if (!quiet)
+            fprintf(output, "%s: OK\n", file->path);
+        return 0;
+    }
+
+    char location[256];
+    plcrash_report_validation_path(&file->result, location, sizeof(location));
+
+    fprintf(output, "%s: %s at offset %llu", file->path, plcrash_report_validation_description(file->result.code),
+            (unsigned long long) file->result.offset);
+    if (location[0] != '\0')
+        fprintf(output, " (%s)", location);
+    fputc('\n', output);
+
+    return 1;
+}
+
+/*
+ * Validate the structure of one or more reports, or of all reports within the given directories, using a
+ * pool of worker threads. Results are printed in input order.
+ */
+int validate_command (int argc, char *argv[]) {
+    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int quiet = 0;
+    int ret = 0;
+
+    /* options descriptor */
+    static struct option longopts[] = {
+        { "jobs",       required_argument,      NULL,          'j' },
+        { "quiet",      no_argument,            NULL,          'q' },
+        { NULL,         0,                      NULL,           0 }
+    };
+
+    /* Read the options */
+    int ch;
+    while ((ch = getopt_long(argc, argv, "j:q", longopts, NULL)) != -1) {
+        switch (ch) {
+            case 'j':
+                jobs = strtol(optarg, NULL, 10);
+                if (jobs < 1) {
+                    fprintf(stderr, "Invalid job count: %s\n", optarg);
+                    [pool release];
+                    return 1;
+                }
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            default:
+                [pool release];
+                return 1;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 1) {
+        fprintf(stderr, "No input file supplied\n");
+        [pool release];
+        return 1;
+    }
+
+    /* Gather the input files */
+    NSMutableArray *paths = [NSMutableArray array];
+    for (int i = 0; i < argc; i++)
+        report_queue_collect_paths(paths, [NSString stringWithUTF8String: argv[i]]);
+
+    int32_t count = (int32_t) [paths count];
+    validate_file_t *files = calloc(count > 0 ? count : 1, sizeof(validate_file_t));
+    if (files == NULL) {
+        fprintf(stderr, "Could not allocate file list\n");
+        [pool release];
+        return 1;
+    }
+
+    for (int32_t i = 0; i < count; i++)
+        files[i].path = [[paths objectAtIndex: i] fileSystemRepresentation];
+
+    /* Validate */
+    report_queue_run(count, jobs, validate_file, files);
+
+    /* Report */
+    int invalid = 0;
+    for (int32_t i = 0; i < count; i++)
+        invalid += print_result(stdout, &files[i], quiet);
+
+    if (count > 1)
+        fprintf(stdout, "%d of %d files invalid\n", invalid, count);
+
+    if (invalid > 0)
+        ret = 1;
+
+    free(files);
+    [pool release];
+    return ret;
+}
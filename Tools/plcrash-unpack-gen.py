@@ -0,0 +1,364 @@
+#!/usr/bin/env python
+#
+# Author: Landon Fuller <landonf@plausiblelabs.com>
+#
+# Copyright (c) 2011 Plausible Labs Cooperative, Inc.
+# All rights reserved.
+#
+# Permission is hereby granted, free of charge, to any person
+# obtaining a copy of this software and associated documentation
+# files (the "Software"), to deal in the Software without
+# restriction, including without limitation the rights to use,
+# copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following
+# conditions:
+#
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+# OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+# HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+# OTHER DEALINGS IN THE SOFTWARE.
+#
+
+"""
+Generate the specialized message decoders used by PLCrashReportUnpack.c from a .proto schema.
+
+    plcrash-unpack-gen.py crash_report.proto -o crash_report.unpack.h
+
+For every message in the schema, a decoder is emitted that dispatches directly on the message's field numbers and
+writes into the protobuf-c 0.6 structures generated by protoc-c from the same schema, followed by the table mapping
+message descriptors to decoders. The decoders rely on the wire-level helpers defined in PLCrashReportUnpack.c.
+
+Only the subset of the protobuf language used by crash_report.proto is supported; any other field type or label
+is rejected, rather than being silently skipped by the generated code.
+"""
+
+import re
+import sys
+
+# Scalar field types, mapped to the PLCrashReportUnpack.c reader and whether the reader takes an allocator
+SCALAR_READERS = {
+    'uint32': ('read_uint32', False),
+    'uint64': ('read_uint64', False),
+    'int64':  ('read_int64', False),
+    'bool':   ('read_bool', False),
+    'string': ('read_string', True),
+    'bytes':  ('read_bytes', True),
+}
+
+# Types for which protoc-c 0.6 emits a has_ flag when the field is optional
+HAS_FLAG_TYPES = ('uint32', 'uint64', 'int64', 'bool', 'bytes')
+
+
+class SchemaError(Exception):
+    pass
+
+
+class Enum(object):
+    def __init__(self, name, parent):
+        self.name = name
+        self.parent = parent
+
+
+class Field(object):
+    def __init__(self, label, type_name, name, number):
+        self.label = label
+        self.type_name = type_name
+        self.name = name
+        self.number = number
+        self.resolved = None
+
+
+class Message(object):
+    def __init__(self, name, parent):
+        self.name = name
+        self.parent = parent
+        self.fields = []
+        self.messages = []
+        self.enums = []
+
+
+def strip_comments(text):
+    text = re.sub(r'/\*.*?\*/', ' ', text, flags=re.S)
+    return re.sub(r'//[^\n]*', ' ', text)
+
+
+def tokenize(text):
+    return re.findall(r'[A-Za-z_][A-Za-z0-9_.]*|-?\d+|"[^"]*"|[{}\[\]=;]', strip_comments(text))
+
+
+def parse(text):
+    """Parse a schema, returning its package name, and its top-level messages and enums."""
+    tokens = tokenize(text)
+    package = None
+    root = Message(None, None)
+    stack = [root]
+    pos = 0
+
+    def expect(token):
+        if tokens[pos] != token:
+            raise SchemaError('expected "%s", found "%s"' % (token, tokens[pos]))
+
+    while pos < len(tokens):
+        token = tokens[pos]
+        scope = stack[-1]
+
+        if token == 'package':
+            package = tokens[pos + 1]
+            pos += 2
+            expect(';')
+            pos += 1
+        elif token == 'option':
+            while tokens[pos] != ';':
+                pos += 1
+            pos += 1
+        elif token == 'message':
+            message = Message(tokens[pos + 1], scope if scope is not root else None)
+            scope.messages.append(message)
+            stack.append(message)
+            pos += 2
+            expect('{')
+            pos += 1
+        elif token == 'enum':
+            scope.enums.append(Enum(tokens[pos + 1], scope if scope is not root else None))
+            pos += 2
+            expect('{')
+            while tokens[pos] != '}':
+                pos += 1
+            pos += 1
+        elif token == '}':
+            if len(stack) == 1:
+                raise SchemaError('unbalanced "}"')
+            stack.pop()
+            pos += 1
+        elif token in ('required', 'optional', 'repeated'):
+            if scope is root:
+                raise SchemaError('field outside of a message')
+            label, type_name, name = tokens[pos:pos + 3]
+            pos += 3
+            expect('=')
+            field = Field(label, type_name, name, int(tokens[pos + 1]))
+            pos += 2
+
+            # Skip any field options; the only option used by the schema is the default value, which is applied
+            # from the message descriptor.
+            if tokens[pos] == '[':
+                while tokens[pos] != ']':
+                    pos += 1
+                pos += 1
+            expect(';')
+            pos += 1
+            scope.fields.append(field)
+        else:
+            raise SchemaError('unsupported statement "%s"' % token)
+
+    if len(stack) != 1:
+        raise SchemaError('unterminated message "%s"' % stack[-1].name)
+    if package is None:
+        raise SchemaError('missing package declaration')
+
+    return package, root
+
+
+def path(node):
+    """The names of @a node and its enclosing messages, outermost first."""
+    names = []
+    while node is not None:
+        names.insert(0, node.name)
+        node = node.parent
+    return names
+
+
+def lower_name(name):
+    """protoc-c's conversion of a CamelCase name to lower_case."""
+    return re.sub(r'(?<!^)([A-Z])', r'_\1', name).lower()
+
+
+def c_type(package, node):
+    return '__'.join([package.capitalize()] + path(node))
+
+
+def c_lower(package, node):
+    return '__'.join([package] + [lower_name(n) for n in path(node)])
+
+
+def resolve(root, scope, type_name):
+    """Resolve a field type name using the protobuf scoping rules."""
+    parts = type_name.lstrip('.').split('.')
+    while True:
+        container = scope if scope is not None else root
+        node = container
+        for part in parts:
+            matches = [m for m in getattr(node, 'messages', []) + getattr(node, 'enums', []) if m.name == part]
+            if not matches:
+                node = None
+                break
+            node = matches[0]
+        if node is not None and node is not container:
+            return node
+        if scope is None:
+            raise SchemaError('unknown type "%s"' % type_name)
+        scope = scope.parent
+
+
+def all_messages(node):
+    for message in node.messages:
+        yield message
+        for nested in all_messages(message):
+            yield nested
+
+
+def unpack_fn(package, message):
+    return 'unpack_' + c_lower(package, message)[len(package) + 2:]
+
+
+def emit_field(out, package, message, field):
+    target = field.resolved
+    indent = ' ' * 16
+    out.append('            case %d:' % field.number)
+
+    if isinstance(target, Message):
+        descriptor = '&%s__descriptor' % c_lower(package, target)
+        if field.label == 'repeated':
+            out.append('%sif (!read_repeated_message(allocator, &field, %s, %s,' % (indent, descriptor, unpack_fn(package, target)))
+            out.append('%s                           &msg->%s, &msg->n_%s))' % (indent, field.name, field.name))
+        else:
+            out.append('%sif (!read_message(allocator, &field, %s, %s, &msg->%s))' % (indent, descriptor, unpack_fn(package, target), field.name))
+        out.append('%s    return false;' % indent)
+    elif isinstance(target, Enum):
+        if field.label == 'repeated':
+            raise SchemaError('%s.%s: repeated enums are not supported' % (message.name, field.name))
+        out.append('%sif (!read_uint32(&field, &u32))' % indent)
+        out.append('%s    return false;' % indent)
+        out.append('%smsg->%s = (%s) u32;' % (indent, field.name, c_type(package, target)))
+        if field.label == 'optional':
+            out.append('%smsg->has_%s = 1;' % (indent, field.name))
+    else:
+        if field.type_name not in SCALAR_READERS:
+            raise SchemaError('%s.%s: unsupported type "%s"' % (message.name, field.name, field.type_name))
+        if field.label == 'repeated':
+            raise SchemaError('%s.%s: repeated scalars are not supported' % (message.name, field.name))
+        reader, takes_allocator = SCALAR_READERS[field.type_name]
+        args = 'allocator, &field' if takes_allocator else '&field'
+        out.append('%sif (!%s(%s, &msg->%s))' % (indent, reader, args, field.name))
+        out.append('%s    return false;' % indent)
+        if field.label == 'optional' and field.type_name in HAS_FLAG_TYPES:
+            out.append('%smsg->has_%s = 1;' % (indent, field.name))
+
+    out.append('                break;')
+
+
+def emit_message(out, package, message):
+    repeated = [f for f in message.fields if f.label == 'repeated']
+    uses_enum = any(isinstance(f.resolved, Enum) for f in message.fields)
+
+    out.append('static bool %s (ProtobufCAllocator *allocator, const uint8_t *data, size_t len, ProtobufCMessage *message) {' % unpack_fn(package, message))
+    out.append('    %s *msg = (%s *) message;' % (c_type(package, message), c_type(package, message)))
+    out.append('    plcrash_unpack_field_t field;')
+    if uses_enum:
+        out.append('    uint32_t u32;')
+    for field in repeated:
+        out.append('    size_t n_%s = 0;' % field.name)
+    out.append('')
+
+    if repeated:
+        out.append('    /* Size the repeated fields */')
+        out.append('    {')
+        out.append('        const uint8_t *at = data;')
+        out.append('        size_t rem = len;')
+        out.append('        while (rem > 0) {')
+        out.append('            if (!next_field(&at, &rem, &field))')
+        out.append('                return false;')
+        out.append('')
+        out.append('            switch (field.tag) {')
+        for field in repeated:
+            out.append('                case %d:' % field.number)
+            out.append('                    n_%s++;' % field.name)
+            out.append('                    break;')
+        out.append('            }')
+        out.append('        }')
+        out.append('    }')
+        out.append('')
+        for i, field in enumerate(repeated):
+            prefix = '    if (' if i == 0 else '        '
+            suffix = ')' if i == len(repeated) - 1 else ' ||'
+            out.append('%s!alloc_repeated(allocator, n_%s, &msg->%s)%s' % (prefix, field.name, field.name, suffix))
+        out.append('        return false;')
+        out.append('')
+
+    out.append('    while (len > 0) {')
+    out.append('        if (!next_field(&data, &len, &field))')
+    out.append('            return false;')
+    out.append('')
+    out.append('        switch (field.tag) {')
+    for field in sorted(message.fields, key=lambda f: f.number):
+        emit_field(out, package, message, field)
+    out.append('        }')
+    out.append('    }')
+    out.append('')
+    out.append('    return true;')
+    out.append('}')
+    out.append('')
+
+
+def generate(source_name, text):
+    package, root = parse(text)
+    messages = list(all_messages(root))
+
+    for message in messages:
+        numbers = set()
+        for field in message.fields:
+            if field.number in numbers:
+                raise SchemaError('%s: duplicate field number %d' % (message.name, field.number))
+            numbers.add(field.number)
+            if field.type_name not in SCALAR_READERS:
+                field.resolved = resolve(root, message, field.type_name)
+
+    out = []
+    out.append('/* Generated by plcrash-unpack-gen.py from %s. DO NOT EDIT. */' % source_name)
+    out.append('')
+    for message in messages:
+        out.append('static bool %s (ProtobufCAllocator *allocator, const uint8_t *data, size_t len, ProtobufCMessage *message);' % unpack_fn(package, message))
+    out.append('')
+
+    for message in messages:
+        emit_message(out, package, message)
+
+    width = max(len(c_lower(package, m)) for m in messages) + len('&__descriptor,')
+    out.append('static const plcrash_unpack_entry_t unpack_table[] = {')
+    for message in messages:
+        descriptor = ('&%s__descriptor,' % c_lower(package, message)).ljust(width)
+        out.append('    { %s %s },' % (descriptor, unpack_fn(package, message)))
+    out.append('};')
+
+    return '\n'.join(out) + '\n'
+
+
+def main(argv):
+    if len(argv) != 4 or argv[2] != '-o':
+        sys.stderr.write('Usage: %s <file.proto> -o <output>\n' % argv[0])
+        return 1
+
+    with open(argv[1]) as f:
+        text = f.read()
+
+    try:
+        output = generate(argv[1].split('/')[-1], text)
+    except SchemaError as e:
+        sys.stderr.write('%s: %s\n' % (argv[1], e))
+        return 1
+
+    with open(argv[3], 'w') as f:
+        f.write(output)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))